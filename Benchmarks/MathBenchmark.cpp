@@ -0,0 +1,509 @@
+//--------------------------------------------------------------------------------------
+// Maths library microbenchmark
+//--------------------------------------------------------------------------------------
+// Standalone program timing the Math/ and CVector4 routines, so maths optimisations can be shown
+// to help (or caught making things worse). Uses no DirectX or Windows headers.
+//
+// Build from the repository root, e.g. on Linux:
+//     g++ -std=c++14 -O2 -IMath -I. Benchmarks/MathBenchmark.cpp Math/*.cpp CVector4.cpp -pthread -o MathBenchmark
+// or with Visual Studio (x64 Native Tools prompt):
+//     cl /std:c++14 /O2 /EHsc /IMath /I. Benchmarks\MathBenchmark.cpp Math\*.cpp CVector4.cpp /Fe:MathBenchmark.exe
+//
+// Usage:
+//     MathBenchmark [--quick] [--csv file] [--json file] [--baseline file] [--tolerance percent]
+//         --quick      Shorter timing runs (noisier), e.g. for a quick check before committing
+//         --csv        Save results as CSV (the format read back by --baseline)
+//         --json       Save results as JSON
+//         --baseline   Compare against the CSV from an earlier run, listing changes beyond the tolerance.
+//                      Exit code is 1 if anything got slower by more than the tolerance
+//         --tolerance  Percentage change treated as noise when comparing with a baseline (default 10)
+//
+// Two kinds of measurement:
+//     throughput - independent operations on arrays of each batch size, in ns per item
+//     latency    - a chain of operations where each uses the result of the last, in ns per operation
+// Routines with SIMD versions are timed with each instruction set the CPU supports. Each result is the
+// best of several runs, which is the most repeatable figure on a busy machine
+
+#include "CVector3.hpp"
+#include "CVector4.hpp"
+#include "CMatrix4x4.hpp"
+#include "MathHelpers.hpp"
+#include "BatchTransform.hpp"
+#include "FastTrig.hpp"
+#include "Geometry.hpp"
+#include "CRandom.hpp"
+#include "MathTables.hpp"
+#include "MatrixKernels.hpp"
+#include "SIMD.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace umbra_engine;
+using namespace umbra_engine::maths;
+
+namespace
+{
+//---------------------------------------
+// Results
+//---------------------------------------
+
+struct SResult
+{
+	std::string benchmark;
+	std::string instructionSet;
+	std::string mode;   // "throughput" or "latency"
+	size_t      batch;  // Items per call (1 for latency)
+	double      nsPerItem;
+};
+
+std::vector<SResult> gResults;
+
+// Written to after each timed run so the compiler can't remove the work being timed
+volatile float gSink;
+
+
+//---------------------------------------
+// Settings
+//---------------------------------------
+
+const size_t BATCH_SIZES[] = { 16, 256, 4096, 65536 };
+const size_t LATENCY_CHAIN = 4096;
+
+double gMinRunTime = 0.05; // Seconds per timed run, --quick reduces it
+const int NUM_RUNS = 5;    // Best of this many runs is reported
+
+
+//---------------------------------------
+// Timing
+//---------------------------------------
+
+// Time a function that processes itemsPerCall items, return the best ns per item over several runs
+// Each run repeats the call until it has taken at least gMinRunTime
+double Time(const std::function<void()>& fn, size_t itemsPerCall)
+{
+	using Clock = std::chrono::steady_clock;
+
+	// Warm up caches and find how many calls fill a run
+	fn();
+	size_t calls = 1;
+	for (;;)
+	{
+		Clock::time_point start = Clock::now();
+		for (size_t i = 0; i < calls; ++i) fn();
+		double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+		if (seconds >= gMinRunTime * 0.5) break;
+		calls *= 2;
+	}
+
+	double best = 1e30;
+	for (int run = 0; run < NUM_RUNS; ++run)
+	{
+		Clock::time_point start = Clock::now();
+		for (size_t i = 0; i < calls; ++i) fn();
+		double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+		best = std::min(best, ns / static_cast<double>(calls * itemsPerCall));
+	}
+	return best;
+}
+
+void Record(const std::string& benchmark, simd::EInstructionSet instructionSet, const char* mode, size_t batch, double nsPerItem)
+{
+	SResult result{ benchmark, simd::InstructionSetName(instructionSet), mode, batch, nsPerItem };
+	std::printf("%-28s %-7s %-10s %6zu %10.3f ns\n", result.benchmark.c_str(), result.instructionSet.c_str(), mode, batch, nsPerItem);
+	gResults.push_back(result);
+}
+
+// Instruction sets supported by this CPU, narrowest first
+std::vector<simd::EInstructionSet> SupportedInstructionSets()
+{
+	std::vector<simd::EInstructionSet> sets;
+	simd::EInstructionSet widest = simd::DetectInstructionSet();
+	for (int i = 0; i <= static_cast<int>(widest); ++i)
+	{
+		sets.push_back(static_cast<simd::EInstructionSet>(i));
+	}
+	return sets;
+}
+
+
+//---------------------------------------
+// Test data
+//---------------------------------------
+
+CRandom gRandom(12345);
+
+CVector3 RandomVector(float range)
+{
+	return CVector3{ gRandom.Range(-range, range), gRandom.Range(-range, range), gRandom.Range(-range, range) };
+}
+
+// A random rotation, scale and translation
+CMatrix4x4 RandomAffine()
+{
+	return MatrixScaling(gRandom.Range(0.5f, 2.0f)) * MatrixRotationZ(gRandom.Range(-PI, PI)) *
+	       MatrixRotationX(gRandom.Range(-PI, PI)) * MatrixRotationY(gRandom.Range(-PI, PI)) * MatrixTranslation(RandomVector(100.0f));
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Throughput benchmarks
+-----------------------------------------------------------------------------------------*/
+
+void MatrixThroughput(size_t batch)
+{
+	std::vector<CMatrix4x4> a(batch), out(batch);
+	for (auto& m : a) m = RandomAffine();
+	CMatrix4x4 b = RandomAffine();
+
+	// CMatrix4x4's operators always use the SSE kernels (see MatrixKernels.hpp), so the single matrix kernels of
+	// each instruction set are timed directly
+	for (simd::EInstructionSet set : SupportedInstructionSets())
+	{
+		simd::SetInstructionSet(set);
+		const simd::SMatrixKernels& kernels = simd::MatrixKernels(set);
+		Record("Matrix multiply", set, "throughput", batch, Time([&]
+		{
+			for (size_t i = 0; i < batch; ++i) kernels.multiply(&a[i].e00, &b.e00, &out[i].e00);
+			gSink = out[0].e00;
+		}, batch));
+		Record("Matrix multiply (batch)", set, "throughput", batch, Time([&]
+		{
+			MultiplyMatrices(a.data(), b, out.data(), batch);
+			gSink = out[0].e00;
+		}, batch));
+		Record("InverseAffine", set, "throughput", batch, Time([&]
+		{
+			for (size_t i = 0; i < batch; ++i) kernels.inverseAffine(&a[i].e00, &out[i].e00);
+			gSink = out[0].e00;
+		}, batch));
+		Record("Transpose", set, "throughput", batch, Time([&]
+		{
+			for (size_t i = 0; i < batch; ++i) kernels.transpose(&a[i].e00, &out[i].e00);
+			gSink = out[0].e00;
+		}, batch));
+	}
+	simd::SetInstructionSet(simd::DetectInstructionSet());
+}
+
+void VectorThroughput(size_t batch)
+{
+	std::vector<CVector3> a(batch), b(batch), out(batch);
+	std::vector<CVector4> a4(batch), out4(batch);
+	std::vector<float> scalars(batch);
+	for (size_t i = 0; i < batch; ++i)
+	{
+		a[i] = RandomVector(10.0f);
+		b[i] = RandomVector(10.0f);
+		a4[i] = CVector4{ a[i].x, a[i].y, a[i].z, gRandom.Range(-10.0f, 10.0f) };
+	}
+	const simd::EInstructionSet scalar = simd::EInstructionSet::Scalar;
+
+	Record("CVector3 Normalise", scalar, "throughput", batch, Time([&]
+	{
+		for (size_t i = 0; i < batch; ++i) out[i] = Normalise(a[i]);
+		gSink = out[0].x;
+	}, batch));
+	Record("CVector3 Length", scalar, "throughput", batch, Time([&]
+	{
+		for (size_t i = 0; i < batch; ++i) scalars[i] = Length(a[i]);
+		gSink = scalars[0];
+	}, batch));
+	Record("CVector3 Cross", scalar, "throughput", batch, Time([&]
+	{
+		for (size_t i = 0; i < batch; ++i) out[i] = Cross(a[i], b[i]);
+		gSink = out[0].x;
+	}, batch));
+	Record("CVector3 Dot", scalar, "throughput", batch, Time([&]
+	{
+		for (size_t i = 0; i < batch; ++i) scalars[i] = Dot(a[i], b[i]);
+		gSink = scalars[0];
+	}, batch));
+	Record("Distance", scalar, "throughput", batch, Time([&]
+	{
+		for (size_t i = 0; i < batch; ++i) scalars[i] = Distance(a[i], b[i]);
+		gSink = scalars[0];
+	}, batch));
+	Record("CVector4 Normalise", scalar, "throughput", batch, Time([&]
+	{
+		for (size_t i = 0; i < batch; ++i) out4[i] = Normalise(a4[i]);
+		gSink = out4[0].x;
+	}, batch));
+	Record("CVector4 Dot", scalar, "throughput", batch, Time([&]
+	{
+		for (size_t i = 0; i < batch; ++i) scalars[i] = Dot(a4[i], a4[batch - 1 - i]);
+		gSink = scalars[0];
+	}, batch));
+}
+
+void BatchThroughput(size_t batch)
+{
+	CMatrix4x4 m = RandomAffine();
+	std::vector<CVector3> points(batch), out(batch);
+	std::vector<float> x(batch), y(batch), z(batch), outX(batch), outY(batch), outZ(batch);
+	std::vector<float> angles(batch), sines(batch), cosines(batch);
+	std::vector<CAABB> boxes(batch);
+	std::vector<unsigned char> visible(batch);
+	for (size_t i = 0; i < batch; ++i)
+	{
+		points[i] = RandomVector(100.0f);
+		x[i] = points[i].x;
+		y[i] = points[i].y;
+		z[i] = points[i].z;
+		angles[i] = gRandom.Range(-10.0f, 10.0f);
+		CVector3 extents{ gRandom.Range(0.1f, 5.0f), gRandom.Range(0.1f, 5.0f), gRandom.Range(0.1f, 5.0f) };
+		boxes[i] = CAABB{ points[i] - extents, points[i] + extents };
+	}
+	CFrustum frustum = FrustumFromMatrix(InverseAffine(MatrixTranslation({ 0, 0, -50 })) *
+	                                     MatrixPerspective(16.0f / 9.0f, std::tan(ToRadians(30.0f)), 0.1f, 1000.0f));
+	CRandom random(1);
+
+	// std::sin/std::cos as the reference for SinCos
+	Record("std::sin + std::cos", simd::EInstructionSet::Scalar, "throughput", batch, Time([&]
+	{
+		for (size_t i = 0; i < batch; ++i)
+		{
+			sines[i] = std::sin(angles[i]);
+			cosines[i] = std::cos(angles[i]);
+		}
+		gSink = sines[0];
+	}, batch));
+
+	for (simd::EInstructionSet set : SupportedInstructionSets())
+	{
+		simd::SetInstructionSet(set);
+		Record("TransformPoints AoS", set, "throughput", batch, Time([&]
+		{
+			TransformPoints(m, points.data(), out.data(), batch);
+			gSink = out[0].x;
+		}, batch));
+		Record("TransformPoints SoA", set, "throughput", batch, Time([&]
+		{
+			TransformPoints(m, x.data(), y.data(), z.data(), outX.data(), outY.data(), outZ.data(), batch);
+			gSink = outX[0];
+		}, batch));
+		Record("SinCos", set, "throughput", batch, Time([&]
+		{
+			SinCos(angles.data(), sines.data(), cosines.data(), batch);
+			gSink = sines[0];
+		}, batch));
+		Record("IntersectFrustumBoxes", set, "throughput", batch, Time([&]
+		{
+			gSink = static_cast<float>(IntersectFrustumBoxes(frustum, boxes.data(), visible.data(), batch));
+		}, batch));
+		Record("CRandom Fill", set, "throughput", batch, Time([&]
+		{
+			random.Fill(sines.data(), 0.0f, 1.0f, batch);
+			gSink = sines[0];
+		}, batch));
+	}
+	simd::SetInstructionSet(simd::DetectInstructionSet());
+
+	// rand() as the reference for CRandom
+	Record("rand()", simd::EInstructionSet::Scalar, "throughput", batch, Time([&]
+	{
+		for (size_t i = 0; i < batch; ++i) sines[i] = static_cast<float>(rand()) / RAND_MAX;
+		gSink = sines[0];
+	}, batch));
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Latency benchmarks
+-----------------------------------------------------------------------------------------*/
+
+void Latency()
+{
+	// Rotation only so the chain of multiplies stays well scaled
+	CMatrix4x4 rotation = MatrixRotationY(0.01f) * MatrixRotationX(0.02f);
+	CMatrix4x4 affine = RandomAffine();
+	CVector3 v = RandomVector(10.0f);
+	CVector3 w = RandomVector(10.0f);
+
+	for (simd::EInstructionSet set : SupportedInstructionSets())
+	{
+		const simd::SMatrixKernels& kernels = simd::MatrixKernels(set);
+		Record("Matrix multiply", set, "latency", 1, Time([&]
+		{
+			CMatrix4x4 m = rotation;
+			for (size_t i = 0; i < LATENCY_CHAIN; ++i) kernels.multiply(&m.e00, &rotation.e00, &m.e00);
+			gSink = m.e00;
+		}, LATENCY_CHAIN));
+		Record("InverseAffine", set, "latency", 1, Time([&]
+		{
+			CMatrix4x4 m = affine;
+			for (size_t i = 0; i < LATENCY_CHAIN; ++i) kernels.inverseAffine(&m.e00, &m.e00);
+			gSink = m.e00;
+		}, LATENCY_CHAIN));
+	}
+
+	const simd::EInstructionSet scalar = simd::EInstructionSet::Scalar;
+	Record("CVector3 Normalise", scalar, "latency", 1, Time([&]
+	{
+		CVector3 r = v;
+		for (size_t i = 0; i < LATENCY_CHAIN; ++i) r = Normalise(r * 2.0f);
+		gSink = r.x;
+	}, LATENCY_CHAIN));
+	Record("CVector3 Cross", scalar, "latency", 1, Time([&]
+	{
+		CVector3 r = v;
+		for (size_t i = 0; i < LATENCY_CHAIN; ++i) r = Cross(r, w) * 0.01f;
+		gSink = r.x;
+	}, LATENCY_CHAIN));
+	Record("Distance", scalar, "latency", 1, Time([&]
+	{
+		CVector3 r = v;
+		for (size_t i = 0; i < LATENCY_CHAIN; ++i) r.x = Distance(r, w) * 0.5f;
+		gSink = r.x;
+	}, LATENCY_CHAIN));
+	Record("std::sin + std::cos", scalar, "latency", 1, Time([&]
+	{
+		float a = 0.5f;
+		for (size_t i = 0; i < LATENCY_CHAIN; ++i) a = std::sin(a) + std::cos(a);
+		gSink = a;
+	}, LATENCY_CHAIN));
+	Record("SinCos", scalar, "latency", 1, Time([&]
+	{
+		float a = 0.5f;
+		for (size_t i = 0; i < LATENCY_CHAIN; ++i)
+		{
+			float s, c;
+			SinCos(a, s, c);
+			a = s + c;
+		}
+		gSink = a;
+	}, LATENCY_CHAIN));
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Output
+-----------------------------------------------------------------------------------------*/
+
+std::string Key(const std::string& benchmark, const std::string& instructionSet, const std::string& mode, size_t batch)
+{
+	return benchmark + "|" + instructionSet + "|" + mode + "|" + std::to_string(batch);
+}
+
+bool SaveCSV(const std::string& fileName)
+{
+	std::ofstream file(fileName);
+	if (!file) return false;
+	file << "benchmark,instruction_set,mode,batch,ns_per_item\n";
+	for (const SResult& r : gResults)
+	{
+		file << r.benchmark << "," << r.instructionSet << "," << r.mode << "," << r.batch << "," << r.nsPerItem << "\n";
+	}
+	return true;
+}
+
+bool SaveJSON(const std::string& fileName)
+{
+	std::ofstream file(fileName);
+	if (!file) return false;
+	file << "{\n  \"instruction_set\": \"" << simd::InstructionSetName(simd::DetectInstructionSet()) << "\",\n  \"results\": [\n";
+	for (size_t i = 0; i < gResults.size(); ++i)
+	{
+		const SResult& r = gResults[i];
+		file << "    { \"benchmark\": \"" << r.benchmark << "\", \"instruction_set\": \"" << r.instructionSet
+		     << "\", \"mode\": \"" << r.mode << "\", \"batch\": " << r.batch << ", \"ns_per_item\": " << r.nsPerItem
+		     << (i + 1 < gResults.size() ? " },\n" : " }\n");
+	}
+	file << "  ]\n}\n";
+	return true;
+}
+
+// Compare with a CSV saved by an earlier run. Return the number of benchmarks slower by more than the tolerance
+int CompareBaseline(const std::string& fileName, double tolerance)
+{
+	std::ifstream file(fileName);
+	if (!file)
+	{
+		std::fprintf(stderr, "Can't read baseline %s\n", fileName.c_str());
+		return -1;
+	}
+
+	std::map<std::string, double> baseline;
+	std::string line;
+	std::getline(file, line); // Header
+	while (std::getline(file, line))
+	{
+		std::stringstream fields(line);
+		std::string benchmark, instructionSet, mode, batch, ns;
+		if (std::getline(fields, benchmark, ',') && std::getline(fields, instructionSet, ',') &&
+		    std::getline(fields, mode, ',') && std::getline(fields, batch, ',') && std::getline(fields, ns, ','))
+		{
+			baseline[benchmark + "|" + instructionSet + "|" + mode + "|" + batch] = std::atof(ns.c_str());
+		}
+	}
+
+	int numSlower = 0;
+	std::printf("\nChanges against %s beyond %.0f%%:\n", fileName.c_str(), tolerance);
+	for (const SResult& r : gResults)
+	{
+		auto old = baseline.find(Key(r.benchmark, r.instructionSet, r.mode, r.batch));
+		if (old == baseline.end() || old->second <= 0.0) continue;
+
+		double change = (r.nsPerItem - old->second) / old->second * 100.0;
+		if (std::abs(change) > tolerance)
+		{
+			std::printf("%-28s %-7s %-10s %6zu %10.3f -> %10.3f ns (%+.1f%%) %s\n", r.benchmark.c_str(), r.instructionSet.c_str(),
+			            r.mode.c_str(), r.batch, old->second, r.nsPerItem, change, change > 0.0 ? "SLOWER" : "faster");
+			if (change > 0.0) ++numSlower;
+		}
+	}
+	std::printf("%d slower\n", numSlower);
+	return numSlower;
+}
+}
+
+
+int main(int argc, char* argv[])
+{
+	std::string csvFile, jsonFile, baselineFile;
+	double tolerance = 10.0;
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--quick") gMinRunTime = 0.01;
+		else if (arg == "--csv" && hasValue) csvFile = argv[++i];
+		else if (arg == "--json" && hasValue) jsonFile = argv[++i];
+		else if (arg == "--baseline" && hasValue) baselineFile = argv[++i];
+		else if (arg == "--tolerance" && hasValue) tolerance = std::atof(argv[++i]);
+		else
+		{
+			std::fprintf(stderr, "Usage: %s [--quick] [--csv file] [--json file] [--baseline file] [--tolerance percent]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	std::printf("Widest instruction set: %s\n\n", simd::InstructionSetName(simd::DetectInstructionSet()));
+
+	for (size_t batch : BATCH_SIZES)
+	{
+		MatrixThroughput(batch);
+		VectorThroughput(batch);
+		BatchThroughput(batch);
+	}
+	Latency();
+
+	if (!csvFile.empty() && !SaveCSV(csvFile)) std::fprintf(stderr, "Can't write %s\n", csvFile.c_str());
+	if (!jsonFile.empty() && !SaveJSON(jsonFile)) std::fprintf(stderr, "Can't write %s\n", jsonFile.c_str());
+
+	if (!baselineFile.empty())
+	{
+		int numSlower = CompareBaseline(baselineFile, tolerance);
+		if (numSlower != 0) return 1;
+	}
+	return 0;
+}
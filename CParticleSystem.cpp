@@ -1,5 +1,6 @@
 #include "CParticleSystem.hpp"
 #include "DirectX11Engine.hpp"
+#include "BatchTransform.hpp"
 
 namespace umbra_engine
 {
@@ -16,12 +17,15 @@ D3D11_INPUT_ELEMENT_DESC ParticleElts[] =
 };
 const unsigned int NumParticleElts = sizeof(ParticleElts) / sizeof(D3D11_INPUT_ELEMENT_DESC);
 
+int CParticleSystem::mEmitterCount = 0;
+
 CParticleSystem::CParticleSystem(int particleAmount, maths::CVector3 emitterPos, std::string textureFile, IEngine* engine)
 {
 	mNumberParticles = particleAmount;
 	mEmitterPos = emitterPos;
 	mTextureFile = textureFile;
 	myEngine = engine;
+	mRandom.Seed(mEmitterCount++);
 
 	mParticlePoints.resize(mNumberParticles);
 	mParticleUpdates.resize(mNumberParticles);
@@ -67,19 +71,19 @@ bool CParticleSystem::InitParticles()
 	myEngine->GetDevice()->CreateInputLayout(ParticleElts, NumParticleElts, signature->GetBufferPointer(), signature->GetBufferSize(), &mParticleLayout);
 
 
-	// Set up the initial particle data
+	// Set up the initial particle data. Random values are written straight into the particle structures
 	for (auto& particle : mParticlePoints)
 	{
 		particle.position = mEmitterPos;
-		particle.alpha = maths::Random(0.0f, 1.0f);
 		particle.scale = 5.0f;
-		particle.rotation = maths::Random(maths::ToRadians(0), maths::ToRadians(360));
-	}
-	for (auto& particleUpdate : mParticleUpdates)
-	{
-		particleUpdate.velocity = { maths::Random(-1.0f, 1.0f), maths::Random(2.5f, 5.0f), maths::Random(-1.0f, 1.0f) };
-		particleUpdate.rotationSpeed = maths::Random(maths::ToRadians(-10), maths::ToRadians(10));
 	}
+	mRandom.Fill(&mParticlePoints[0].alpha, sizeof(ParticlePoint), 0.0f, 1.0f, mNumberParticles);
+	mRandom.Fill(&mParticlePoints[0].rotation, sizeof(ParticlePoint), maths::ToRadians(0), maths::ToRadians(360), mNumberParticles);
+
+	mRandom.Fill(&mParticleUpdates[0].velocity.x, sizeof(ParticleUpdate), -1.0f, 1.0f, mNumberParticles);
+	mRandom.Fill(&mParticleUpdates[0].velocity.y, sizeof(ParticleUpdate), 2.5f, 5.0f, mNumberParticles);
+	mRandom.Fill(&mParticleUpdates[0].velocity.z, sizeof(ParticleUpdate), -1.0f, 1.0f, mNumberParticles);
+	mRandom.Fill(&mParticleUpdates[0].rotationSpeed, sizeof(ParticleUpdate), maths::ToRadians(-10), maths::ToRadians(10), mNumberParticles);
 
 
 	// Create the particle vertex buffer in GPU memory and copy over the contents just created (from CPU-memory)
@@ -111,39 +115,39 @@ void CParticleSystem::Render()
 
 	// Unbind the depth buffer (the NULL) as we're now going to use it as a texture instead of writing to it normally
 	// Then allow access to the depth buffer as a texture in the pixel shader
-	myEngine->GetContext()->OMSetRenderTargets(1, &mBackBufferRenderTarget, nullptr);
-	myEngine->GetContext()->PSSetShaderResources(1, 1, &mDepthShaderView);
-	myEngine->GetContext()->PSSetSamplers(1, 1, &mPointSampler);
+	myEngine->GetStateContext()->OMSetRenderTargets(1, &mBackBufferRenderTarget, nullptr);
+	myEngine->GetStateContext()->PSSetShaderResources(1, 1, &mDepthShaderView);
+	myEngine->GetStateContext()->PSSetSamplers(1, 1, &mPointSampler);
 
 	// Set shaders for particle rendering - the vertex shader just passes the data to the 
 	// geometry shader, which generates a camera-facing 2D quad from the particle world position 
 	// The pixel shader is very simple and just draws a tinted texture for each particle
-	myEngine->GetContext()->VSSetShader(mParticlePassThruVertexShader, nullptr, 0);
-	myEngine->GetContext()->GSSetShader(mParticleGeometryShader, nullptr, 0);
-	myEngine->GetContext()->PSSetShader(mSoftParticlePixelShader, nullptr, 0);
+	myEngine->GetStateContext()->VSSetShader(mParticlePassThruVertexShader, nullptr, 0);
+	myEngine->GetStateContext()->GSSetShader(mParticleGeometryShader, nullptr, 0);
+	myEngine->GetStateContext()->PSSetShader(mSoftParticlePixelShader, nullptr, 0);
 
 	// Select the texture and sampler to use in the pixel shader
-	myEngine->GetContext()->PSSetShaderResources(0, 1, &mParticleSRV);
+	myEngine->GetStateContext()->PSSetShaderResources(0, 1, &mParticleSRV);
 
 	// States - alpha blending and no culling
-	myEngine->GetContext()->OMSetBlendState(myEngine->GetScene()->GetAlphaBlendState(), nullptr, 0xffffff);
-	myEngine->GetContext()->OMSetDepthStencilState(myEngine->GetScene()->GetDepthReadOnlyState(), 0);
-	myEngine->GetContext()->RSSetState(myEngine->GetScene()->GetCullNoneState());
+	myEngine->GetStateContext()->OMSetBlendState(myEngine->GetScene()->GetAlphaBlendState(), nullptr, 0xffffff);
+	myEngine->GetStateContext()->OMSetDepthStencilState(myEngine->GetScene()->GetDepthReadOnlyState(), 0);
+	myEngine->GetStateContext()->RSSetState(myEngine->GetScene()->GetCullNoneState());
 
 	// Set up particle vertex buffer / layout
 	unsigned int particleVertexSize = sizeof(ParticlePoint);
 	unsigned int offset = 0;
-	myEngine->GetContext()->IASetVertexBuffers(0, 1, &mParticleVertexBuffer.p, &particleVertexSize, &offset);
-	myEngine->GetContext()->IASetInputLayout(mParticleLayout.p);
+	myEngine->GetStateContext()->IASetVertexBuffers(0, 1, &mParticleVertexBuffer.p, &particleVertexSize, &offset);
+	myEngine->GetStateContext()->IASetInputLayout(mParticleLayout.p);
 
 	// Indicate that this is a point list and render it
-	myEngine->GetContext()->IASetPrimitiveTopology(D3D10_PRIMITIVE_TOPOLOGY_POINTLIST);
-	myEngine->GetContext()->Draw(mNumberParticles, 0);
+	myEngine->GetStateContext()->IASetPrimitiveTopology(D3D10_PRIMITIVE_TOPOLOGY_POINTLIST);
+	myEngine->GetStateContext()->Draw(mNumberParticles, 0);
 
 	// Detach depth buffer from shader and set it back to its normal usage
 	ID3D11ShaderResourceView* nullSRV = nullptr;
-	myEngine->GetContext()->PSSetShaderResources(1, 1, &nullSRV);
-	myEngine->GetContext()->OMSetRenderTargets(1, &mBackBufferRenderTarget, myEngine->GetDepthStencil());
+	myEngine->GetStateContext()->PSSetShaderResources(1, 1, &nullSRV);
+	myEngine->GetStateContext()->OMSetRenderTargets(1, &mBackBufferRenderTarget, myEngine->GetDepthStencil());
 
 
 	//*************************************************************************
@@ -153,43 +157,63 @@ void CParticleSystem::Update(float frameTime)
 {
 	// Particle update
 
-	// Update particle instance data
+	// Decrease alpha, reset particle to new starting position when it disappears (i.e. number of particles stays constant)
+	mRespawnIndices.clear();
 	for (int i = 0; i < mNumberParticles; ++i)
 	{
-		// Decrease alpha, reset particle to new starting position when it disappears (i.e. number of particles stays constant)
 		mParticlePoints[i].alpha -= 0.08f * frameTime;
 		if (mParticlePoints[i].alpha <= 0.0f)
 		{
-			mParticlePoints[i].position = mEmitterPos;
-			mParticlePoints[i].alpha = maths::Random(0.5f, 1.0f);
-			mParticlePoints[i].scale = 5.0f;
-			mParticlePoints[i].rotation = maths::Random(maths::ToRadians(0), maths::ToRadians(360));
+			mRespawnIndices.push_back(i);
 		}
+	}
+
+	// Random alpha and rotation for all respawned particles generated in one go
+	if (!mRespawnIndices.empty())
+	{
+		size_t numRespawns = mRespawnIndices.size();
+		mRespawnValues.resize(numRespawns * 2);
+		mRandom.Fill(&mRespawnValues[0], 0.5f, 1.0f, numRespawns);
+		mRandom.Fill(&mRespawnValues[numRespawns], maths::ToRadians(0), maths::ToRadians(360), numRespawns);
 
+		for (size_t r = 0; r < numRespawns; ++r)
+		{
+			ParticlePoint& particle = mParticlePoints[mRespawnIndices[r]];
+			particle.position = mEmitterPos;
+			particle.alpha = mRespawnValues[r];
+			particle.scale = 5.0f;
+			particle.rotation = mRespawnValues[numRespawns + r];
+		}
+	}
+
+	// Update particle instance data
+	for (int i = 0; i < mNumberParticles; ++i)
+	{
 		// Increase scale, the particles expand as they fade
 		mParticlePoints[i].scale *= pow(1.15f, frameTime);
 
 		// Slowly rotate
 		mParticlePoints[i].rotation += mParticleUpdates[i].rotationSpeed * frameTime;
-
-		// Move particle
-		mParticlePoints[i].position += mParticleUpdates[i].velocity * frameTime;
 	}
 
+	// Move particles - positions and velocities are read straight out of the particle structures
+	maths::AddScaled(&mParticleUpdates[0].velocity, sizeof(ParticleUpdate), frameTime,
+	                 &mParticlePoints[0].position, sizeof(ParticlePoint), mNumberParticles);
+
 
 	//----
 	// Sort particles on camera depth
 
 	// Recalculate the array of particle camera depths
 	maths::CVector3 cameraFacing = myEngine->GetScene()->GetCamera()->WorldMatrix().GetZAxis(); // Facing direction of camera
+	maths::CVector3 cameraPosition = myEngine->GetScene()->GetCamera()->Position();
+
+	// Depth of particle is distance from camera to particle in the direction that the camera is facing
+	// Calculate this with dot product of (vector from camera position to particle position) and (camera facing vector - calculated above)
+	maths::ProjectOntoAxis(&mParticlePoints[0].position, sizeof(ParticlePoint), cameraPosition, cameraFacing,
+	                       &mParticleDepths[0].depth, sizeof(SParticleDepth), mNumberParticles);
 	for (int i = 0; i < mNumberParticles; ++i)
 	{
-		// Depth of particle is distance from camera to particle in the direction that the camera is facing
-		// Calculate this with dot product of (vector from camera position to particle position) and (camera facing vector - calculated above)
-		//**** MISSING calculate particle depth using above comment
-		maths::CVector3 cameraToParticle = mParticlePoints[i].position - myEngine->GetScene()->GetCamera()->Position();
-		mParticleDepths[i].depth = maths::Dot(cameraFacing, cameraToParticle);
-
 		// Store index of each particle, these will be reordered when we sort the depths and will then provide the correct order to render the particles
 		mParticleDepths[i].index = i;
 	}
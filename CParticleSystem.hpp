@@ -9,6 +9,7 @@
 #include "Common.hpp"
 #include "ITexture.h"
 #include "CTexture.h"
+#include "CRandom.hpp"
 #include <atlbase.h>
 
 
@@ -75,6 +76,7 @@ private:
 //---------------------------------------
 // Private Member Variables
 //---------------------------------------
+	static int mEmitterCount; // Used to give each emitter its own random seed
 	int mNumberParticles;
 	maths::CVector3 mEmitterPos;
 	std::string mTextureFile;
@@ -84,6 +86,12 @@ private:
 	std::vector<ParticleUpdate> mParticleUpdates;
 	std::vector<SParticleDepth> mParticleDepths;
 
+	// Each emitter has its own generator so particle spawning is repeatable and doesn't share state
+	// Respawned particles are collected each update so their random values can be generated in bulk
+	maths::CRandom mRandom;
+	std::vector<int> mRespawnIndices;
+	std::vector<float> mRespawnValues;
+
 	// Vertex layout and buffer for the particles (rendering data only, we are not doing update on the GPU in this example)
 	ID3D11RenderTargetView* mBackBufferRenderTarget = nullptr;
 	ID3D11ShaderResourceView* mDepthShaderView = nullptr;
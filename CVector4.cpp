@@ -61,38 +61,10 @@ CVector4& CVector4::operator*= (const float s)
 }
 
 
-// Vector-vector addition
-CVector4 operator+ (const CVector4& v, const CVector4& w)
-{
-	return CVector4{ v.x + w.x, v.y + w.y, v.z + w.z, v.w + w.w };
-}
-
-// Vector-vector subtraction
-CVector4 operator- (const CVector4& v, const CVector4& w)
-{
-	return CVector4{ v.x - w.x, v.y - w.y, v.z - w.z, v.w - w.w };
-}
-
-// Vector-scalar multiplication
-CVector4 operator* (const CVector4& v, float s)
-{
-	return CVector4{ v.x * s, v.y * s, v.z * s, v.w * s };
-}
-CVector4 operator* (float s, const CVector4& v)
-{
-	return CVector4{ v.x * s, v.y * s, v.z * s, v.w * s };
-}
-
 /*-----------------------------------------------------------------------------------------
 	Non-member functions
 -----------------------------------------------------------------------------------------*/
 
-// Dot product of two given vectors (order not important) - non-member version
-float Dot(const CVector4& v1, const CVector4& v2)
-{
-	return v1.x * v2.x + v1.y * v2.y + v1.z * v2.z;
-}
-
 // Cross product of two given vectors (order is important) - non-member version
 //CVector3 Cross(const CVector4& v1, const CVector4& v2)
 //{
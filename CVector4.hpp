@@ -32,22 +32,12 @@ public:
 	CVector4() {}
 
 	// Construct with 3 values
-	CVector4(const float xIn, const float yIn, const float zIn, const float wIn)
-	{
-		x = xIn;
-		y = yIn;
-		z = zIn;
-		w = wIn;
-	}
+	constexpr CVector4(const float xIn, const float yIn, const float zIn, const float wIn)
+		: x(xIn), y(yIn), z(zIn), w(wIn) {}
 
 	// Construct using a pointer to four floats
-	CVector4(const float* pfElts)
-	{
-		x = pfElts[0];
-		y = pfElts[1];
-		z = pfElts[2];
-		w = pfElts[3];
-	}
+	constexpr CVector4(const float* pfElts)
+		: x(pfElts[0]), y(pfElts[1]), z(pfElts[2]), w(pfElts[3]) {}
 
 
 	/*-----------------------------------------------------------------------------------------
@@ -75,22 +65,39 @@ public:
 	Non-member operators
 -----------------------------------------------------------------------------------------*/
 
+// The simple operators and functions are constexpr so they can be used to build constant data at compile time
+
 // Vector-vector addition
-CVector4 operator+ (const CVector4& v, const CVector4& w);
+constexpr CVector4 operator+ (const CVector4& v, const CVector4& w)
+{
+	return CVector4{ v.x + w.x, v.y + w.y, v.z + w.z, v.w + w.w };
+}
 
 // Vector-vector subtraction
-CVector4 operator- (const CVector4& v, const CVector4& w);
+constexpr CVector4 operator- (const CVector4& v, const CVector4& w)
+{
+	return CVector4{ v.x - w.x, v.y - w.y, v.z - w.z, v.w - w.w };
+}
 
 // Vector-scalar multiplication
-CVector4 operator* (const CVector4& v, float s);
-CVector4 operator* (float s, const CVector4& v);
+constexpr CVector4 operator* (const CVector4& v, float s)
+{
+	return CVector4{ v.x * s, v.y * s, v.z * s, v.w * s };
+}
+constexpr CVector4 operator* (float s, const CVector4& v)
+{
+	return CVector4{ v.x * s, v.y * s, v.z * s, v.w * s };
+}
 
 /*-----------------------------------------------------------------------------------------
 	Non-member functions
 -----------------------------------------------------------------------------------------*/
 
 // Dot product of two given vectors (order not important) - non-member version
-float Dot(const CVector4& v1, const CVector4& v2);
+constexpr float Dot(const CVector4& v1, const CVector4& v2)
+{
+	return v1.x * v2.x + v1.y * v2.y + v1.z * v2.z;
+}
 
 // Cross product of two given vectors (order is important) - non-member version
 //CVector4 Cross(const CVector4& v1, const CVector4& v2);
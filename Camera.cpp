@@ -4,6 +4,7 @@
 // Holds position, rotation, near/far clip and field of view. These to a view and projection matrices as required
 
 #include "Camera.hpp"
+#include "MathTables.hpp"
 
 namespace umbra_engine
 {
@@ -36,109 +37,107 @@ void CCamera::Control(float frameTime, KeyCode turnUp, KeyCode turnDown, KeyCode
 		SetCursorPos(gViewportWidth / 2, gViewportHeight / 2);
 		if (GetMouseX() > gViewportWidth / 2 - 5)
 		{
-			mRotation.y += ROTATION_SPEED * frameTime * 2.0f; // Use of frameTime to ensure same speed on different machines
+			mTransform.RotateWorld(maths::QuaternionRotationY(ROTATION_SPEED * frameTime * 2.0f)); // Use of frameTime to ensure same speed on different machines
 		}
 		if (GetMouseX() < gViewportWidth / 2 - 10)
 		{
-			mRotation.y -= ROTATION_SPEED * frameTime * 2.0f; // Use of frameTime to ensure same speed on different machines
+			mTransform.RotateWorld(maths::QuaternionRotationY(-ROTATION_SPEED * frameTime * 2.0f)); // Use of frameTime to ensure same speed on different machines
 		}
 		if (GetMouseY() > gViewportHeight / 2 - 30)
 		{
-			mRotation.x += ROTATION_SPEED * frameTime * 2.0f; // Use of frameTime to ensure same speed on different machines
+			mTransform.RotateLocal(maths::QuaternionRotationX(ROTATION_SPEED * frameTime * 2.0f)); // Use of frameTime to ensure same speed on different machines
 		}
 		if (GetMouseY() < gViewportHeight / 2 - 32)
 		{
-			mRotation.x -= ROTATION_SPEED * frameTime * 2.0f; // Use of frameTime to ensure same speed on different machines
+			mTransform.RotateLocal(maths::QuaternionRotationX(-ROTATION_SPEED * frameTime * 2.0f)); // Use of frameTime to ensure same speed on different machines
 		}
 	}
 
 
 	//**** ROTATION ****
+	// Pitch around the camera's own X axis, turn around the world Y axis, so the camera never rolls
 	if (KeyHeld(turnDown))
 	{
-		mRotation.x += ROTATION_SPEED * frameTime; // Use of frameTime to ensure same speed on different machines
+		mTransform.RotateLocal(maths::QuaternionRotationX(ROTATION_SPEED * frameTime)); // Use of frameTime to ensure same speed on different machines
 	}
 	if (KeyHeld(turnUp))
 	{
-		mRotation.x -= ROTATION_SPEED * frameTime;
+		mTransform.RotateLocal(maths::QuaternionRotationX(-ROTATION_SPEED * frameTime));
 	}
 	if (KeyHeld(turnRight))
 	{
-		mRotation.y += ROTATION_SPEED * frameTime;
+		mTransform.RotateWorld(maths::QuaternionRotationY(ROTATION_SPEED * frameTime));
 	}
 	if (KeyHeld(turnLeft))
 	{
-		mRotation.y -= ROTATION_SPEED * frameTime;
+		mTransform.RotateWorld(maths::QuaternionRotationY(-ROTATION_SPEED * frameTime));
 	}
 
 
 
 	//**** LOCAL MOVEMENT ****
+	mViewDirty = true;
+	UpdateMatrices(); // Local axes for the rotation above
 	if (KeyHeld(moveRight))
 	{
-		mPosition.x += MOVEMENT_SPEED * frameTime * mWorldMatrix.e00 * mRun;//TO DO: Implement run mode
-		mPosition.y += MOVEMENT_SPEED * frameTime * mWorldMatrix.e01 * mRun;
-		mPosition.z += MOVEMENT_SPEED * frameTime * mWorldMatrix.e02 * mRun;
+		mTransform.position.x += MOVEMENT_SPEED * frameTime * mWorldMatrix.e00 * mRun;//TO DO: Implement run mode
+		mTransform.position.y += MOVEMENT_SPEED * frameTime * mWorldMatrix.e01 * mRun;
+		mTransform.position.z += MOVEMENT_SPEED * frameTime * mWorldMatrix.e02 * mRun;
 	}
 	if (KeyHeld(moveLeft))
 	{
-		mPosition.x -= MOVEMENT_SPEED * frameTime * mWorldMatrix.e00 * mRun;
-		mPosition.y -= MOVEMENT_SPEED * frameTime * mWorldMatrix.e01 * mRun;
-		mPosition.z -= MOVEMENT_SPEED * frameTime * mWorldMatrix.e02 * mRun;
+		mTransform.position.x -= MOVEMENT_SPEED * frameTime * mWorldMatrix.e00 * mRun;
+		mTransform.position.y -= MOVEMENT_SPEED * frameTime * mWorldMatrix.e01 * mRun;
+		mTransform.position.z -= MOVEMENT_SPEED * frameTime * mWorldMatrix.e02 * mRun;
 	}
 	if (KeyHeld(moveForward))
 	{
-		mPosition.x += MOVEMENT_SPEED * frameTime * mWorldMatrix.e20 * mRun;
-		mPosition.y += MOVEMENT_SPEED * frameTime * mWorldMatrix.e21 * mRun;
-		mPosition.z += MOVEMENT_SPEED * frameTime * mWorldMatrix.e22 * mRun;
+		mTransform.position.x += MOVEMENT_SPEED * frameTime * mWorldMatrix.e20 * mRun;
+		mTransform.position.y += MOVEMENT_SPEED * frameTime * mWorldMatrix.e21 * mRun;
+		mTransform.position.z += MOVEMENT_SPEED * frameTime * mWorldMatrix.e22 * mRun;
 	}
 	if (KeyHeld(moveBackward))
 	{
-		mPosition.x -= MOVEMENT_SPEED * frameTime * mWorldMatrix.e20 * mRun;
-		mPosition.y -= MOVEMENT_SPEED * frameTime * mWorldMatrix.e21 * mRun;
-		mPosition.z -= MOVEMENT_SPEED * frameTime * mWorldMatrix.e22 * mRun;
+		mTransform.position.x -= MOVEMENT_SPEED * frameTime * mWorldMatrix.e20 * mRun;
+		mTransform.position.y -= MOVEMENT_SPEED * frameTime * mWorldMatrix.e21 * mRun;
+		mTransform.position.z -= MOVEMENT_SPEED * frameTime * mWorldMatrix.e22 * mRun;
 	}
+	mViewDirty = true;
 }
 
-// Update the matrices used for the camera in the rendering pipeline
+// Update the matrices used for the camera in the rendering pipeline. Only rebuilds the matrices that are out of date
 void CCamera::UpdateMatrices()
 {
-	// "World" matrix for the camera - treat it like a model at first
-	mWorldMatrix = maths::MatrixRotationZ(mRotation.z) * maths::MatrixRotationX(mRotation.x) * maths::MatrixRotationY(mRotation.y) * MatrixTranslation(mPosition);
+	if (!mViewDirty && !mProjectionDirty) return;
 
-	// View matrix is the usual matrix used for the camera in shaders, it is the inverse of the world matrix (see lectures)
-	mViewMatrix = InverseAffine(mWorldMatrix);
+	if (mViewDirty)
+	{
+		// "World" matrix for the camera - treat it like a model at first
+		mWorldMatrix = mTransform.ToMatrix();
 
-	// Projection matrix, how to flatten the 3D world onto the screen (needs field of view, near and far clip, aspect ratio)
-	float tanFOVx = std::tan(mFOVx * 0.5f);
-	float scaleX = 1.0f / tanFOVx;
-	float scaleY = mAspectRatio / tanFOVx;
-	float scaleZa = mFarClip / (mFarClip - mNearClip);
-	float scaleZb = -mNearClip * scaleZa;
+		// View matrix is the usual matrix used for the camera in shaders, it is the inverse of the world matrix (see lectures)
+		// Inverting the transform (transpose the rotation, rotate the position back) is cheaper than a general matrix inverse
+		mViewMatrix = maths::Inverse(mTransform).ToMatrix();
+	}
 
-	mProjectionMatrix = maths::CMatrix4x4{ scaleX,   0.0f,    0.0f,   0.0f,
-									  0.0f, scaleY,    0.0f,   0.0f,
-									  0.0f,   0.0f, scaleZa,   1.0f,
-									  0.0f,   0.0f, scaleZb,   0.0f };
+	if (mProjectionDirty)
+	{
+		// Projection matrix, how to flatten the 3D world onto the screen (needs field of view, near and far clip, aspect ratio)
+		mProjectionMatrix = MakeProjectionMatrix(mAspectRatio, mFOVx, mNearClip, mFarClip);
+	}
 
 	// The view-projection matrix combines the two matrices usually used for the camera into one, which can save a multiply in the shaders (optional)
 	mViewProjectionMatrix = mViewMatrix * mProjectionMatrix;
+
+	mViewDirty = false;
+	mProjectionDirty = false;
 }
 
 
 maths::CMatrix4x4 MakeProjectionMatrix(float aspectRatio /*= 4.0f / 3.0f*/, float FOVx /*= maths::ToRadians(60)*/,
 	float nearClip /*= 0.1f*/, float farClip /*= 10000.0f*/)
 {
-	float tanFOVx = std::tan(FOVx * 0.5f);
-	float scaleX = 1.0f / tanFOVx;
-	float scaleY = aspectRatio / tanFOVx;
-	float scaleZa = farClip / (farClip - nearClip);
-	float scaleZb = -nearClip * scaleZa;
-
-	return maths::CMatrix4x4{ scaleX,   0.0f,    0.0f,   0.0f,
-						 0.0f, scaleY,    0.0f,   0.0f,
-						 0.0f,   0.0f, scaleZa,   1.0f,
-						 0.0f,   0.0f, scaleZb,   0.0f };
+	return maths::MatrixPerspective(aspectRatio, std::tan(FOVx * 0.5f), nearClip, farClip);
 }
 
 }//Namespace
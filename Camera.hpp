@@ -10,6 +10,7 @@
 #include "ICamera.hpp"
 #include "CVector3.hpp"
 #include "CMatrix4x4.hpp"
+#include "CTransform.hpp"
 
 //======================================================================================
 namespace umbra_engine
@@ -24,7 +25,7 @@ public:
 	// Constructor - initialise all settings, sensible defaults provided for everything.
 	CCamera(maths::CVector3 position = { 0,0,0 }, maths::CVector3 rotation = { 0,0,0 },
 		float fov = maths::PI / 3, float aspectRatio = 4.0f / 3.0f, float nearClip = 0.1f, float farClip = 10000.0f)
-		: mPosition(position), mRotation(rotation), mFOVx(fov), mAspectRatio(aspectRatio), mNearClip(nearClip), mFarClip(farClip)
+		: mTransform(position, maths::QuaternionFromEuler(rotation), { 1, 1, 1 }), mFOVx(fov), mAspectRatio(aspectRatio), mNearClip(nearClip), mFarClip(farClip)
 	{
 	}
 	~CCamera() = default;
@@ -33,8 +34,8 @@ public:
 // Data access
 //---------------------------------------
 	// Getters
-	maths::CVector3 Position() { return mPosition; }
-	maths::CVector3 Rotation() { return mRotation; }
+	maths::CVector3 Position() { return mTransform.position; }
+	maths::CVector3 Rotation() { return maths::EulerAngles(mTransform.rotation); }
 	float FOV() { return mFOVx; }
 	float NearClip() { return mNearClip; }
 	float FarClip() { return mFarClip; }
@@ -43,13 +44,14 @@ public:
 	maths::CMatrix4x4 ProjectionMatrix() { UpdateMatrices(); return mProjectionMatrix; }
 	maths::CMatrix4x4 ViewProjectionMatrix() { UpdateMatrices(); return mViewProjectionMatrix; }
 	maths::CMatrix4x4 WorldMatrix() { UpdateMatrices(); return mWorldMatrix; }
+	maths::CFrustum Frustum() { UpdateMatrices(); return maths::FrustumFromMatrix(mViewProjectionMatrix); }
 
 	//Setters
-	void SetPosition(maths::CVector3 position) { mPosition = position; }
-	void SetRotation(maths::CVector3 rotation) { mRotation = rotation; }
-	void SetFOV(float fov) { mFOVx = fov; }
-	void SetNearClip(float nearClip) { mNearClip = nearClip; }
-	void SetFarClip(float farClip) { mFarClip = farClip; }
+	void SetPosition(maths::CVector3 position) { mTransform.position = position; mViewDirty = true; }
+	void SetRotation(maths::CVector3 rotation) { mTransform.rotation = maths::QuaternionFromEuler(rotation); mViewDirty = true; }
+	void SetFOV(float fov) { mFOVx = fov; mProjectionDirty = true; }
+	void SetNearClip(float nearClip) { mNearClip = nearClip; mProjectionDirty = true; }
+	void SetFarClip(float farClip) { mFarClip = farClip; mProjectionDirty = true; }
 
 //---------------------------------------
 // Operational Methods
@@ -61,16 +63,15 @@ private:
 //---------------------------------------
 // Private Member Functions
 //---------------------------------------
-	// Update the matrices used for the camera in the rendering pipeline
+	// Update the matrices used for the camera in the rendering pipeline. Only rebuilds the matrices that are out of date
 	void UpdateMatrices();
 
 //---------------------------------------
 // Private members
 //---------------------------------------
 
-	// Postition and rotations for the camera (rarely scale cameras)
-	maths::CVector3 mPosition;
-	maths::CVector3 mRotation;
+	// Postition and rotation for the camera (rarely scale cameras, scale is kept at 1)
+	maths::CTransform mTransform;
 
 	// Camera settings: field of view, aspect ratio, near and far clip plane distances.
 	// Note that the FOVx angle is measured in radians (radians = degrees * PI/180) from left to right of screen
@@ -87,6 +88,10 @@ private:
 	maths::CMatrix4x4 mViewProjectionMatrix; // Combine (multiply) the view and projection matrices together, which
 									  // can sometimes save a matrix multiply in the shader (optional)
 
+	// Set when the position/rotation or the camera settings change, so the matrices are only rebuilt when needed
+	bool mViewDirty = true;
+	bool mProjectionDirty = true;
+
 	float mRun = 10.0f;
 };//Class
 
@@ -14,6 +14,34 @@ struct TangentVertex
     float2 uv : uv;
 };
 
+// The same vertex data plus the world matrix of the instance being drawn, for instanced rendering. The rows of the
+// C++ world matrix are read from a second vertex buffer, once per instance (see Mesh::RenderInstanced)
+struct InstancedTangentVertex
+{
+    float3 position : position;
+    float3 normal : normal;
+    float3 tangent : tangent;
+    float2 uv : uv;
+
+    float4 world0 : instanceWorld0;
+    float4 world1 : instanceWorld1;
+    float4 world2 : instanceWorld2;
+    float4 world3 : instanceWorld3;
+};
+
+// The same vertex data plus up to 4 bones for skinned meshes. Bone indexes point into the bone palette (gBoneMatrices or
+// gBoneDualQuaternions), weights add up to 1 (see Mesh::Mesh)
+struct SkinningVertex
+{
+    float3 position : position;
+    float3 normal : normal;
+    float3 tangent : tangent;
+    float2 uv : uv;
+
+    uint4  bones : bones;
+    float4 weights : weights;
+};
+
 struct VertexInput
 {
     float3 position : position;
@@ -149,6 +177,7 @@ struct PixelShaderInput
 cbuffer PerFrameConstants : register(b0) // The b0 gives this constant buffer the number 0 - used in the C++ code
 {
     const static int MAX_LIGHTS = 20;
+    const static int MAX_CASCADES = 4;
 
     float4x4 gViewMatrix;
     float4x4 gProjectionMatrix;
@@ -185,7 +214,7 @@ cbuffer PerFrameConstants : register(b0) // The b0 gives this constant buffer th
     float4 lightPositions[MAX_LIGHTS];
     float4 lightColours[MAX_LIGHTS];
 
-    float4 cubeViewProj[6];
+    float4x4 cubeViewProj[6];
 
     float gViewportWidth;
     float gViewportHeight;
@@ -193,6 +222,16 @@ cbuffer PerFrameConstants : register(b0) // The b0 gives this constant buffer th
     
     float4x4 gCameraMatrix;
 
+    float4x4 cascadeViewProj[MAX_CASCADES];
+    int numCascades;
+    int cascadeLightIndex;
+    float2 padding4;
+
+    float4 lightShadowTiles[MAX_LIGHTS];
+
+    int4 pointShadowLights; // One per PointShadowMaps slot, MAX_POINT_SHADOWS in C++
+    float2 pointShadowDepth;
+    float2 padding5;
 }
 // Note constant buffers are not structs: we don't use the name of the constant buffer, these are really just a collection of global variables (hence the 'g')
 static const int MAX_BONES = 64;
@@ -207,8 +246,60 @@ cbuffer PerModelConstants : register(b1) // The b1 gives this constant buffer th
 
     float4   gObjectColour;
     //float    padding6;  // See notes on padding in structure above
+}
+
+// Bone palettes for skinned meshes, only updated by meshes with bones. A mesh uses one or the other
+// These variables must match exactly the PerBoneConstants / PerBoneDualQuaternionConstants structures in Common.hpp
+cbuffer PerBoneConstants : register(b2)
+{
     float4x4 gBoneMatrices[MAX_BONES];
 }
 
+// Two float4s per bone: rotation quaternion (real part) then dual part. Bones are relative to gWorldMatrix
+cbuffer PerBoneDualQuaternionConstants : register(b3)
+{
+    float4 gBoneDualQuaternions[MAX_BONES * 2];
+}
+
+
+//--------------------------------------------------------------------------------------
+// Dual quaternion skinning
+//--------------------------------------------------------------------------------------
+// Same calculations as BlendBones / TransformPoint in Math/CDualQuaternion.cpp. Blend the bones of a vertex, then
+// skin the position (and normal) into model space before applying gWorldMatrix as for a rigid model
+
+// Blend up to 4 bones from gBoneDualQuaternions. Bones are flipped into the same hemisphere as the first one
+void BlendBoneDualQuaternions(uint4 bones, float4 weights, out float4 real, out float4 dual)
+{
+    float4 firstReal = gBoneDualQuaternions[bones.x * 2];
+    real = 0;
+    dual = 0;
+    [unroll] for (int i = 0; i < 4; ++i)
+    {
+        float4 boneReal = gBoneDualQuaternions[bones[i] * 2];
+        float4 boneDual = gBoneDualQuaternions[bones[i] * 2 + 1];
+        float weight = dot(boneReal, firstReal) < 0 ? -weights[i] : weights[i];
+        real += boneReal * weight;
+        dual += boneDual * weight;
+    }
+    float invLength = rsqrt(dot(real, real));
+    real *= invLength;
+    dual *= invLength;
+}
+
+// Rotate a vector by a normalised quaternion
+float3 QuaternionRotate(float4 q, float3 v)
+{
+    float3 t = 2 * cross(q.xyz, v);
+    return v + t * q.w + cross(q.xyz, t);
+}
+
+// Transform a point by a normalised dual quaternion: rotate then add the translation 2dr*
+float3 DualQuaternionTransformPoint(float4 real, float4 dual, float3 p)
+{
+    float3 translation = 2 * (dual.xyz * real.w - real.xyz * dual.w + cross(real.xyz, dual.xyz));
+    return QuaternionRotate(real, p) + translation;
+}
+
 
 
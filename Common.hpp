@@ -11,6 +11,7 @@
 #include "CVector2.hpp"
 
 #include "CMatrix4x4.hpp"
+#include "CDualQuaternion.hpp"
 #include "MathHelpers.hpp"
 
 #include <wrl/client.h>
@@ -36,6 +37,14 @@ enum EBlendingType { None, Add, Multi, Alpha };
 enum EShadowEffect { ZBuffer, PCF };
 enum class ETextureTypes { Diffuse, Normal, Height, Unknown };
 
+// How a model using a skinned mesh sends its bones to the GPU (see IModel::SetSkinning)
+enum class ESkinning
+{
+	Matrices,        // Linear blend skinning, a matrix per bone in PerBoneConstants, drawn with Skinning_vs
+	DualQuaternions, // Dual quaternion skinning, half the size (PerBoneDualQuaternionConstants), drawn with
+	                 // DualQuaternionSkinning_vs. Bones lose any scale
+};
+
 enum ELightType
 {
 	Point,
@@ -76,6 +85,8 @@ const float MOVEMENT_SPEED = 15.0f;
 struct PerFrameConstants
 {
 	const static int MAX_LIGHTS = 20;//statics work differently therefore padding isn't neccessary here
+	const static int MAX_CASCADES = 4;
+	const static int MAX_POINT_SHADOWS = 4; // Cube shadow maps bound at once, must match pointShadowLights in Common.hlsli
 
 	// These are the matrices used to position the camera
 	maths::CMatrix4x4 viewMatrix;
@@ -125,6 +136,22 @@ struct PerFrameConstants
 	maths::CVector2 padding;
 
 	maths::CMatrix4x4 cameraMatrix;
+
+	// Cascaded shadow maps of the directional light cascadeLightIndex, nearest the camera first (see Light.cpp)
+	maths::CMatrix4x4 cascadeViewProjMatrix[MAX_CASCADES];
+	int numCascades = 0; // No cascaded shadows when 0
+	int cascadeLightIndex = 0;
+	maths::CVector2 padding4;
+
+	// Tile of each light's shadow map in the shadow atlas: UV offset in x, y and scale in z, w. All 0 for lights
+	// without a shadow map in the atlas (see ShadowAtlas.hpp)
+	maths::CVector4 lightShadowTiles[MAX_LIGHTS];
+
+	// Light index of the point light whose cube shadow map is in each PointShadowMaps slot, -1 for an empty slot
+	// (see PointLight.cpp). A point light's depth at a distance d along a cube face's axis is x + y / d
+	int pointShadowLights[MAX_POINT_SHADOWS] = { -1, -1, -1, -1 };
+	maths::CVector2 pointShadowDepth;
+	maths::CVector2 padding5;
 };//Structure
 
 static const int MAX_BONES = 64;
@@ -135,10 +162,18 @@ struct PerModelConstants
 {
 	maths::CMatrix4x4 worldMatrix;
 	maths::CVector4   objectColour; // Allows each light model to be tinted to match the light colour they cast
+};//Structure
 
+// Bone palettes for skinned meshes. Kept out of PerModelConstants so rigid models don't upload them, and each
+// skinned mesh only uploads the palette it uses. These must match the constant buffers of the same name in Common.hlsli
+struct PerBoneConstants
+{
+	maths::CMatrix4x4 boneMatrices[MAX_BONES]; // 64 bytes per bone
+};//Structure
 
-	maths::CMatrix4x4 boneMatrices[MAX_BONES];
-
+struct PerBoneDualQuaternionConstants
+{
+	maths::CDualQuaternion boneDualQuaternions[MAX_BONES]; // 32 bytes per bone, the same model space bones as boneMatrices
 };//Structure
 }//Namespace
 //======================================================================================
@@ -328,6 +328,7 @@ bool CDX11Engine::InitDirect3D()
 		mLastError = "Error creating Direct3D device";
 		return false;
 	}
+	mStateContext = std::make_unique<CStateContext>(mD3DContext);
 
 	// Get a "render target view" of back-buffer - standard behaviour
 	ID3D11Texture2D* backBuffer;
@@ -405,7 +406,7 @@ void CDX11Engine::ShutdownDirect3D()
 	// own projects.
 	if (mD3DContext)
 	{
-		mD3DContext->ClearState(); // This line is also needed to reset the GPU before shutting down DirectX
+		mStateContext->ClearState(); // This line is also needed to reset the GPU before shutting down DirectX
 	}
 }
 
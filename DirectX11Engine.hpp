@@ -7,6 +7,7 @@
 //--------------------------------------------------------------------------------------
 
 #include "IEngine.hpp"
+#include "StateContext.hpp"
 #include <memory>
 
 //======================================================================================
@@ -39,6 +40,7 @@ public:
 	ID3D11Buffer* GetModelConstantBuffer()				{ return mPerModelConstantBuffer; }
 	ID3D11Device* GetDevice()							{ return mD3DDevice; }
 	ID3D11DeviceContext* GetContext()					{ return mD3DContext; }
+	CStateContext* GetStateContext()					{ return mStateContext.get(); }
 	ID3D11RenderTargetView* GetBackBufferRenderTarget() { return mBackBufferRenderTarget; }
 	ID3D11DepthStencilView* GetDepthStencil()			{ return mDepthStencil; }
 	ColourRGBA GetBackgroundColour()					{ return mBackgroundColor; }
@@ -86,6 +88,7 @@ private:
 	std::unique_ptr<IScene> myScene;// Rendering of scene
 	std::vector<std::unique_ptr<ILight>> mAllLights; //Cumulative lights
 	std::vector<std::unique_ptr<IMesh>> mAllMeshes;//Cumulative meshes
+	std::unique_ptr<CStateContext> mStateContext;//Filters redundant state changes made through mD3DContext
 
 	//Raw Pointers - "observers"
 	std::vector<IModel*> mAllModels;//Cumulative models
@@ -0,0 +1,35 @@
+//--------------------------------------------------------------------------------------
+// Skinning version of main_vs - dual quaternion blend of the bones in gBoneDualQuaternions
+//--------------------------------------------------------------------------------------
+
+#include "Common.hlsli"
+
+
+//--------------------------------------------------------------------------------------
+// Shader code
+//--------------------------------------------------------------------------------------
+
+// Same as Skinning_vs but the bones are blended as dual quaternions, which keeps volume in twisted joints. Same
+// calculation as maths::SkinVertices on the CPU. Used by models with ESkinning::DualQuaternions (see Model::SetSkinning)
+NormalMappingPixelShaderInput main(SkinningVertex modelVertex)
+{
+    NormalMappingPixelShaderInput output;
+
+    float4 real, dual;
+    BlendBoneDualQuaternions(modelVertex.bones, modelVertex.weights, real, dual);
+
+    float4 modelPosition = float4(DualQuaternionTransformPoint(real, dual, modelVertex.position), 1.0f);
+    float4 worldPosition = mul(gWorldMatrix, modelPosition);
+    float4 viewPosition = mul(gViewMatrix, worldPosition);
+    output.projectedPosition = mul(gProjectionMatrix, viewPosition);
+
+    output.worldPosition = worldPosition.xyz;
+
+    // Directions are only rotated
+    output.modelNormal = QuaternionRotate(real, modelVertex.normal);
+    output.modelTangent = QuaternionRotate(real, modelVertex.tangent);
+
+    output.uv = modelVertex.uv;
+
+    return output;
+}
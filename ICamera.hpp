@@ -9,6 +9,7 @@
 
 #include "Input.hpp"
 #include "Common.hpp"
+#include "Geometry.hpp"
 
 //======================================================================================
 namespace umbra_engine
@@ -46,6 +47,9 @@ public:
 	virtual maths::CMatrix4x4 ViewProjectionMatrix() = 0;
 	virtual maths::CMatrix4x4 WorldMatrix() = 0;
 
+	// The six clip planes of the view-projection matrix in world space, for culling
+	virtual maths::CFrustum Frustum() = 0;
+
 //---------------------------------------
 // Operational Methods
 //---------------------------------------
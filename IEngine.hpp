@@ -19,6 +19,7 @@
 
 //Graphics helpers
 #include "Shader.hpp"
+#include "StateContext.hpp"
 #include "ColourRGBA.hpp" 
 #include "Input.hpp"
 #include "Timer.hpp"
@@ -60,6 +61,8 @@ public:
 	virtual ID3D11Buffer* GetModelConstantBuffer() = 0;
 	virtual ID3D11Device* GetDevice() = 0;
 	virtual ID3D11DeviceContext* GetContext() = 0;
+	// The device context behind a filter that drops state changes which change nothing. Use for all rendering
+	virtual CStateContext* GetStateContext() = 0;
 	virtual ID3D11RenderTargetView* GetBackBufferRenderTarget() = 0;
 	virtual ID3D11DepthStencilView* GetDepthStencil() = 0;
 	virtual ColourRGBA GetBackgroundColour() = 0;
@@ -8,6 +8,7 @@
 
 #include "Common.hpp"
 #include "Shader.hpp"
+#include "Geometry.hpp"
 
 //======================================================================================
 namespace umbra_engine
@@ -19,6 +20,8 @@ class CScene;
 class IEngine;
 class IModel;
 class IMesh;
+class ICamera;
+class CStateContext;
 
 class ILight
 {
@@ -40,6 +43,7 @@ public:
 	virtual maths::CVector3 GetAmbientColour() = 0;
 	virtual float GetLightStrength() = 0;
 	virtual int GetLightNumber() = 0;
+	virtual ELightType GetLightType() = 0;
 
 	//Setters
 	virtual void SetPosition(const maths::CVector4& Pos) = 0;
@@ -57,11 +61,28 @@ public:
 //---------------------------------------
 	virtual void RenderLight(PerFrameConstants& perFrameConstants, PerModelConstants& perModelConstants) = 0;
 	virtual bool ShadowDepthBuffer() = 0;
-	virtual void ClearDepthStencil(ID3D11DeviceContext* context) = 0;
-	virtual void SendShadowMap2Shader(int textureSlot, ID3D11DeviceContext* context) = 0;
+	virtual void ClearDepthStencil(CStateContext* context) = 0;
+	virtual void SendShadowMap2Shader(int textureSlot, CStateContext* context) = 0;
 	virtual void ConstructCubeFaceCameras(maths::CVector3 lightPosition) {}
 	virtual void RenderCubeMap() {}
 
+	// Shadow maps made of several faces: cube faces for point lights (ordered +X, -X, +Y, -Y, +Z, -Z) and cascades
+	// for directional lights (nearest the camera first). Each face gets its own list of the models whose shadow
+	// can reach the camera's view, and is rendered separately with only those models. Faces keep their depth until
+	// their casters or matrices change. Spot lights have a single shadow map that the scene renders, and report
+	// no faces
+	virtual int NumShadowFaces() { return 0; }
+	// Find the casters (and for cascades the matrices) of every face for the current camera view
+	virtual void FindFaceCasters(ICamera* camera) {}
+	// True if a face's depth doesn't match its current casters and needs rendering
+	virtual bool IsFaceOutOfDate(int face) { return false; }
+	// Number of casters for a face, and a box around them
+	virtual unsigned int GetFaceCasterCount(int face) { return 0; }
+	virtual maths::CAABB GetFaceCasterBounds(int face) { return maths::EmptyAABB(); }
+	// Render a face with its casters. Depth-only shaders and states must already be set
+	virtual void RenderShadowFace(int face, PerFrameConstants& perFrameConstants, ID3D11Buffer* frameConstantBuffer,
+		CStateContext* context) {}
+
 	//Get light count - owned by class not object
 	static int mLightCount;
 };//Class
@@ -9,6 +9,8 @@
 #include "CTexture.h"
 
 #include "common.hpp"
+#include "Geometry.hpp"
+#include "CTriangleBVH.hpp"
 
 
 #include <string>
@@ -20,6 +22,21 @@ namespace umbra_engine
 // Class Forward Declarations
 //---------------------------------------
 class IModel;
+class CInstanceBuffer;
+
+// CPU copy of a sub-mesh's geometry, for merging static models into larger buffers (see CStaticGeometry). Positions
+// are float3 at the start of each vertex and normals float3 straight after them
+struct SSubMeshGeometry
+{
+	const unsigned char*      vertices;
+	unsigned int              numVertices;
+	unsigned int              vertexSize;
+	int                       tangentOffset; // Offset of the float3 tangent in each vertex, -1 if none
+	const uint32_t*           indices;
+	unsigned int              numIndices;
+	ID3D11InputLayout*        vertexLayout;
+	ID3D11ShaderResourceView* diffuseTexture; // Sub-mesh's own texture (slot 0), nullptr if none
+};
 class IMesh
 {
 public:
@@ -38,7 +55,26 @@ public:
 //---------------------------------------
 	// The render function assumes shaders, matrices, textures, samplers etc. have been set up already.
 	// It simply draws this mesh with whatever settings the GPU is currently using.
-	virtual void Render(std::vector<maths::CMatrix4x4>& modelMatrices) = 0;
+	// A skinned mesh uploads its bones in the palette for the given skinning, which the vertex shader must read
+	virtual void Render(std::vector<maths::CMatrix4x4>& modelMatrices, ESkinning skinning) = 0;
+
+	// Draw several models using this mesh with one DrawIndexedInstanced call per sub-mesh rather than one draw per
+	// model, with their world matrices in the instance buffer. Needs the instanced vertex shader (main_instanced_vs),
+	// and the per-model world matrix set to identity. Returns the number of draw calls, 0 if the mesh can't be
+	// instanced (see CanInstance)
+	virtual unsigned int RenderInstanced(IModel* const* models, unsigned int numModels, CInstanceBuffer& instances) = 0;
+
+	// True if the mesh can be drawn with RenderInstanced or merged with GetSubMeshGeometry. Skinned meshes can't,
+	// their bones are per model
+	virtual bool CanInstance() = 0;
+
+	// True if the mesh is skinned, so needs a skinning vertex shader (see ESkinning)
+	virtual bool HasBones() = 0;
+
+	// Number of sub-meshes and the CPU copy of one of them. Only for meshes where CanInstance is true
+	virtual unsigned int NumberSubMeshes() = 0;
+	virtual SSubMeshGeometry GetSubMeshGeometry(unsigned int subMesh) = 0;
+
 	virtual std::unique_ptr<IModel> CreateModel(const float x = 0, const float y = 0, const float z = 0,
 		const std::string& psShaderFile = "main_ps", const std::string vsShaderFile = "main_vs") = 0;
 	virtual void AddFolders(std::vector<std::string> mediaFolders) = 0;
@@ -48,6 +84,20 @@ public:
 
 	// The default matrix for a given node - used to set the initial position for a new model
 	virtual maths::CMatrix4x4 GetNodeDefaultMatrix(unsigned int node) = 0;
+
+	// Bounding box around the whole mesh in its default pose, in model space (before the model's world matrix)
+	virtual const maths::CAABB& GetBounds() = 0;
+
+	// Bounding box around the sub-meshes of a given node, in model space like GetBounds (node matrices are not
+	// applied to the sub-meshes when drawn, see Mesh::Render). Empty if the node has no geometry
+	virtual const maths::CAABB& GetNodeBounds(unsigned int node) = 0;
+
+	// Triangles of the mesh in its default pose for exact ray casts, in model space. May be nullptr (skinned meshes)
+	virtual const maths::CTriangleBVH* GetTriangleBVH() = 0;
+
+	// The same triangles as an indexed triangle list in model space, for occlusion culling. May be empty
+	virtual const std::vector<maths::CVector3>& GetPositions() = 0;
+	virtual const std::vector<uint32_t>& GetIndices() = 0;
 };//Class
 }//Namespace
 //======================================================================================
@@ -9,6 +9,7 @@
 #include "Camera.hpp"
 #include "CVector3.hpp"
 #include "CMatrix4x4.hpp"
+#include "Geometry.hpp"
 #include "Input.hpp"
 #include "Common.hpp"
 
@@ -19,6 +20,7 @@ namespace umbra_engine
 // Forward Declarations
 //---------------------------------------
 class Mesh;
+class IMesh;
 class IEngine;
 class IScene;
 
@@ -53,6 +55,12 @@ public:
 	virtual ID3D11Resource* GetDiffuseMap3() = 0;
 	virtual std::string GetTextureFile3() = 0;
 	virtual ID3D11ShaderResourceView* GetDiffuseSRVMap3() = 0;
+	virtual IMesh* GetMesh() = 0;
+	// Occluders are large models (e.g. buildings) drawn into the CPU depth buffer to hide the models behind them
+	virtual bool IsOccluder() = 0;
+	// Static models never move, so their geometry is merged with other static models' (see CStaticGeometry)
+	virtual bool IsStatic() = 0;
+	virtual ESkinning GetSkinning() = 0;
 
 	//Setters
 	virtual void SetMatrix(maths::CMatrix4x4 model) = 0;
@@ -79,6 +87,10 @@ public:
 	virtual void SetAddBlend(const EBlendingType& newBlend) = 0;
 	virtual void AddSecondaryTexture(const std::string& texture2) = 0;
 	virtual void AddThirdTexture(const std::string& texture3) = 0;
+	virtual void SetOccluder(bool occluder) = 0;
+	virtual void SetStatic(bool isStatic) = 0;
+	// Choose how bones are sent to the GPU. For a skinned mesh this also sets the matching vertex shader
+	virtual void SetSkinning(ESkinning skinning) = 0;
 
 //---------------------------------------
 // Operational Methods
@@ -87,6 +99,9 @@ public:
 	// to vertex & pixel shader. Then it calls Mesh:Render, which renders the geometry with current GPU settings.
 	// So all other per-frame constants must have been set already along with shaders, textures, samplers, states etc.
 	virtual void Render() = 0;
+	// Just the last part of Render: set the world matrix and draw the mesh, with whatever shaders, textures and
+	// samplers are already set. For renderers that set those once for many models (see CScene's render queue)
+	virtual void RenderGeometry() = 0;
 
 
 	// Control the model's position and rotation using keys provided. Amount of motion performed depends on frame time
@@ -96,6 +111,13 @@ public:
 	// Read only access to model world matrix, updated on request
 	virtual maths::CMatrix4x4 WorldMatrix() = 0;
 
+	// World space bounding box around the model, the mesh bounds transformed by the world matrix. Used for culling
+	virtual maths::CAABB WorldBounds() = 0;
+
+	// Changes whenever the model moves, rotates or scales. Every model has a different revision, so a (model,
+	// revision) pair identifies a model in a given position - used to tell if cached shadow maps are out of date
+	virtual unsigned int GetRevision() = 0;
+
 	virtual void LookAt(IModel* target) = 0;
 	virtual void LookAtCamera(ICamera * target) = 0;
 
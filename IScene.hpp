@@ -11,6 +11,10 @@
 #include "Shader.hpp"
 #include "DirectX11Engine.hpp"
 #include "ColourRGBA.hpp"
+#include "ShadowScheduler.hpp"
+#include "CQuadtreeAtlas.hpp"
+#include "CRenderQueue.hpp"
+#include "StaticGeometry.hpp"
 #include <vector>
 
 //======================================================================================
@@ -44,10 +48,37 @@ public:
 	virtual ID3D11SamplerState* GetPointSampler() = 0;
 	virtual ID3D11SamplerState* GetAnisotropic4xSampler() = 0;
 
+	// Number of models drawn / rejected by frustum culling in the last call to RenderModels
+	virtual unsigned int GetVisibleModelCount() = 0;
+	virtual unsigned int GetCulledModelCount() = 0;
+
+	// Number of frustum visible models hidden behind occluders, and the milliseconds spent rasterising the
+	// occluders, in the last call to RenderModels
+	virtual unsigned int GetOccludedModelCount() = 0;
+	virtual float GetOcclusionTime() = 0;
+
+	// Number of models drawn into the given light's shadow map in the last frame
+	virtual unsigned int GetShadowCasterCount(int lightIndex) = 0;
+
+	// Shadow maps / cube faces requested, rendered and put off in the last frame
+	virtual const SShadowSchedulerStats& GetShadowSchedulerStats() = 0;
+
+	// Spot light shadow map tiles given out, and how full and fragmented the shadow atlas was, in the last frame
+	virtual const maths::SAtlasStats& GetShadowAtlasStats() = 0;
+
+	// Models drawn in the main pass and the state changes made between them in the last call to RenderModels
+	virtual const maths::SRenderQueueStats& GetRenderQueueStats() = 0;
+
+	// Static models merged, the batches they were merged into, and how many of those were drawn in the last frame
+	virtual const SStaticGeometryStats& GetStaticGeometryStats() = 0;
+
 
 	//Setters
 	virtual void SetFrameConstants(PerFrameConstants& constants) = 0;
 	virtual void SetDayNight(float& dayNight) = 0;
+	// Most shadow maps / point light cube faces to render each frame, and most casters to draw across them (0 = no
+	// limit). Out of date shadows beyond this are rendered in later frames
+	virtual void SetShadowBudget(unsigned int maxUpdates, unsigned int maxDrawCalls) = 0;
 
 //---------------------------------------
 // Opearational Methods
@@ -55,6 +86,10 @@ public:
 	virtual bool InitGeometry() = 0;
 	virtual bool InitScene() = 0;
 
+	// Merge the models marked static into large batches drawn in place of the models. Call once the level is loaded,
+	// the merged models must not move afterwards. Returns false on failure
+	virtual bool BuildStaticGeometry(const std::vector<IModel*>& models) = 0;
+
 	virtual void RenderSceneFromCamera() = 0;
 	virtual void RenderScene(float& frameTime) = 0;
 	virtual void RenderModels(float& frameTime) = 0;
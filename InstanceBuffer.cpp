@@ -0,0 +1,57 @@
+#include "InstanceBuffer.hpp"
+#include "DirectX11Engine.hpp"
+
+#include <cstring>
+
+namespace umbra_engine
+{
+
+CInstanceBuffer::~CInstanceBuffer()
+{
+	if (mBuffer) mBuffer->Release();
+}
+
+// Create the buffer
+bool CInstanceBuffer::Init(IEngine* engine)
+{
+	D3D11_BUFFER_DESC bufferDesc = {};
+	bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	bufferDesc.ByteWidth = mCapacity * Stride();
+	bufferDesc.Usage = D3D11_USAGE_DYNAMIC;             // Written by the CPU every frame
+	bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	bufferDesc.MiscFlags = 0;
+	if (FAILED(engine->GetDevice()->CreateBuffer(&bufferDesc, nullptr, &mBuffer)))
+	{
+		return false;
+	}
+	mNext = mCapacity; // So the first write discards
+	return true;
+}
+
+// Copy matrices into the buffer after the last write, or at the start of a fresh buffer if they don't fit
+unsigned int CInstanceBuffer::Write(const maths::CMatrix4x4* matrices, unsigned int count, ID3D11DeviceContext* context)
+{
+	if (count > mCapacity) count = mCapacity;
+
+	// No overwrite promises the driver that this part of the buffer isn't in use by the GPU, so it needn't wait
+	D3D11_MAP mapType = D3D11_MAP_WRITE_NO_OVERWRITE;
+	if (mNext + count > mCapacity)
+	{
+		mapType = D3D11_MAP_WRITE_DISCARD;
+		mNext = 0;
+	}
+
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	if (FAILED(context->Map(mBuffer, 0, mapType, 0, &mapped)))
+	{
+		return 0;
+	}
+	std::memcpy(static_cast<char*>(mapped.pData) + mNext * Stride(), matrices, count * Stride());
+	context->Unmap(mBuffer, 0);
+
+	unsigned int first = mNext;
+	mNext += count;
+	return first;
+}
+
+}
@@ -0,0 +1,67 @@
+#ifndef _INSTANCE_BUFFER_H_
+#define _INSTANCE_BUFFER_H_
+//======================================================================================
+
+//--------------------------------------------------------------------------------------
+// Dynamic vertex buffer of per-instance world matrices for instanced draws
+//--------------------------------------------------------------------------------------
+// Many models using the same mesh are drawn with one DrawIndexedInstanced call: their world matrices are written
+// here and read by the vertex shader one per instance (see main_instanced_vs.hlsl and Mesh::RenderInstanced)
+// The buffer is used as a ring: each write goes after the last one, so the GPU can still be reading earlier
+// instances while new ones are written. When the end is reached the whole buffer is discarded and writing starts
+// again at the beginning (the driver gives a fresh buffer, the GPU keeps the old one until it is finished)
+
+#include "Common.hpp"
+
+//======================================================================================
+namespace umbra_engine
+{
+//---------------------------------------
+// Class Forward Declarations
+//---------------------------------------
+class IEngine;
+
+class CInstanceBuffer
+{
+public:
+//---------------------------------------
+// Constructors / Destructors
+//---------------------------------------
+	// Number of matrices the buffer holds. Call Init before use
+	CInstanceBuffer(unsigned int capacity = 4096) : mCapacity(capacity) {}
+	~CInstanceBuffer();
+
+	// Owns GPU resources, so no copying
+	CInstanceBuffer(const CInstanceBuffer&) = delete;
+	CInstanceBuffer& operator=(const CInstanceBuffer&) = delete;
+
+	// Create the buffer. Returns false on failure
+	bool Init(IEngine* engine);
+
+//---------------------------------------
+// Data Access
+//---------------------------------------
+	ID3D11Buffer* GetBuffer() { return mBuffer; }
+	unsigned int GetCapacity() { return mCapacity; }
+
+	// Size of one instance in bytes, the stride to use when binding the buffer
+	static unsigned int Stride() { return sizeof(maths::CMatrix4x4); }
+
+//---------------------------------------
+// Operational Methods
+//---------------------------------------
+	// Copy matrices into the buffer and return the index of the first one, to use as the start instance of draw
+	// calls. At most GetCapacity matrices can be written at once
+	unsigned int Write(const maths::CMatrix4x4* matrices, unsigned int count, ID3D11DeviceContext* context);
+
+private:
+//---------------------------------------
+// Private Member Variables
+//---------------------------------------
+	unsigned int  mCapacity;
+	unsigned int  mNext = 0; // Where the next write goes
+	ID3D11Buffer* mBuffer = nullptr;
+};//Class
+}//Namespace
+//======================================================================================
+#endif//Header Guard
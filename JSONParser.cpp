@@ -5,6 +5,7 @@
 #include "IModel.hpp"
 #include "IMesh.hpp"
 #include "ILight.hpp"
+#include "IScene.hpp"
 
 namespace umbra_engine
 {
@@ -42,6 +43,14 @@ void CJSONParser::LoadParser(const std::string& fileName)
 		LoadModels();
 
 		LoadLights();
+
+		//Merge the static models into a few large batches, now they are all in place
+		std::vector<IModel*> models;
+		for (auto& model : allModels) models.push_back(model.get());
+		if (!myEngine->GetScene()->BuildStaticGeometry(models))
+		{
+			std::cout << "error merging static models" << std::endl;
+		}
 	}
 
 	//Close the file as we have finished with it
@@ -110,6 +119,21 @@ void CJSONParser::LoadModels()
 		assert(rotation.IsArray());
 		model->SetRotation({ rotation[0].GetFloat(), rotation[1].GetFloat(), rotation[2].GetFloat() });
 
+		//Optionally use as an occluder for occlusion culling
+		if (models[i].HasMember("occluder")) model->SetOccluder(models[i]["occluder"].GetBool());
+
+		//Optionally mark as never moving, so its geometry is merged with other static models
+		if (models[i].HasMember("static")) model->SetStatic(models[i]["static"].GetBool());
+
+		//Optionally choose how a skinned model's bones are sent to the GPU, "matrices" (the default) or "dualQuaternions"
+		if (models[i].HasMember("skinning"))
+		{
+			std::string skinning = models[i]["skinning"].GetString();
+			if (skinning == "dualQuaternions")  model->SetSkinning(ESkinning::DualQuaternions);
+			else if (skinning == "matrices")    model->SetSkinning(ESkinning::Matrices);
+			else std::cout << "unknown skinning " << skinning << std::endl;
+		}
+
 		//Keep track of all models by adding them to vector
 		allModels.push_back(std::move(model));
 
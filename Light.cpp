@@ -4,6 +4,9 @@
 #include "Scene.hpp"
 
 #include "Model.hpp"
+#include "ICamera.hpp"
+
+#include <algorithm>
 
 namespace umbra_engine
 {
@@ -42,6 +45,10 @@ Light::~Light()
 	if (mShadow) mShadow->Release();
 	if (mShadowDepthStencil) mShadowDepthStencil->Release();
 	if (mShadowSRV) mShadowSRV->Release();
+	for (auto cascadeDepthStencil : mCascadeDepthStencils)
+	{
+		if (cascadeDepthStencil) cascadeDepthStencil->Release();
+	}
 }
 
 IMesh* Light::GetMesh() { return lightMesh; }
@@ -109,6 +116,20 @@ void Light::RenderLight(PerFrameConstants& perFrameConstants, PerModelConstants&
 	perFrameConstants.lightProjectionMatrix[mLightIndex] = lightProjectionMatrix;
 	//perFrameConstants.lightWorldMatrix[mLightIndex] = lightModel->WorldMatrix();
 
+	if (mLightType == Directional)
+	{
+		// Cascades are sampled with the matrices they were rendered with. Only the leading cascades that have been
+		// rendered are used, the nearest is normally rendered first (see CShadowScheduler)
+		int numCascades = 0;
+		while (numCascades < MaxCascades && mCascadeRendered[numCascades])
+		{
+			perFrameConstants.cascadeViewProjMatrix[numCascades] = mRenderedCascades[numCascades].viewProjectionMatrix;
+			++numCascades;
+		}
+		perFrameConstants.numCascades = numCascades;
+		perFrameConstants.cascadeLightIndex = mLightIndex;
+	}
+
 	perModelConstants.objectColour = mLightColour;
 	perFrameConstants.ambientColour = mAmbientColour;
 	perFrameConstants.specularPower = mSpecularPower;
@@ -123,14 +144,17 @@ void Light::SetLightAngle(const float& angle)
 
 bool Light::ShadowDepthBuffer()
 {
+	// Spot lights render into a tile of the scene's shadow atlas (see ShadowAtlas.hpp)
+	if (mLightType == Spot) return true;
+
 	//**** Create Shadow Map texture ****//
 
 // We also need a depth buffer to go with our portal
 	D3D11_TEXTURE2D_DESC textureDesc = {};
-	textureDesc.Width = 1024; // Size of the shadow map determines quality / resolution of shadows
-	textureDesc.Height = 1024;
+	textureDesc.Width = mShadowMapSize; // Size of the shadow map determines quality / resolution of shadows
+	textureDesc.Height = mShadowMapSize;
 	textureDesc.MipLevels = 1; // 1 level, means just the main texture, no additional mip-maps. Usually don't use mip-maps when rendering to textures (or we would have to render every level)
-	textureDesc.ArraySize = 1;
+	textureDesc.ArraySize = (mLightType == Directional) ? MaxCascades : 1; // Directional lights have a slice per cascade
 	textureDesc.Format = DXGI_FORMAT_R32_TYPELESS; // The shadow map contains a single 32-bit value [tech gotcha: have to say typeless because depth buffer and shaders see things slightly differently]
 	textureDesc.SampleDesc.Count = 1;
 	textureDesc.SampleDesc.Quality = 0;
@@ -149,12 +173,38 @@ bool Light::ShadowDepthBuffer()
 	dsvDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
 	dsvDesc.Texture2D.MipSlice = 0;
 	dsvDesc.Flags = 0;
+	if (mLightType == Directional)
+	{
+		// Whole array, so clearing clears every cascade
+		dsvDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2DARRAY;
+		dsvDesc.Texture2DArray.MipSlice = 0;
+		dsvDesc.Texture2DArray.FirstArraySlice = 0;
+		dsvDesc.Texture2DArray.ArraySize = MaxCascades;
+	}
 	if (FAILED(mDevice->CreateDepthStencilView(mShadow, &dsvDesc, &mShadowDepthStencil)))
 	{
 
 		return false;
 	}
 
+	// A depth stencil view for each cascade, so the cascades can be rendered one at a time
+	if (mLightType == Directional)
+	{
+		D3D11_DEPTH_STENCIL_VIEW_DESC cascadeDesc = {};
+		cascadeDesc.Format = DXGI_FORMAT_D32_FLOAT;
+		cascadeDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2DARRAY;
+		cascadeDesc.Texture2DArray.MipSlice = 0;
+		cascadeDesc.Texture2DArray.ArraySize = 1;
+		for (int cascade = 0; cascade < MaxCascades; ++cascade)
+		{
+			cascadeDesc.Texture2DArray.FirstArraySlice = cascade;
+			if (FAILED(mDevice->CreateDepthStencilView(mShadow, &cascadeDesc, &mCascadeDepthStencils[cascade])))
+			{
+				return false;
+			}
+		}
+	}
+
 
 	// We also need to send this texture (resource) to the shaders. To do that we must create a shader-resource "view"
 	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
@@ -163,6 +213,14 @@ bool Light::ShadowDepthBuffer()
 	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
 	srvDesc.Texture2D.MostDetailedMip = 0;
 	srvDesc.Texture2D.MipLevels = 1;
+	if (mLightType == Directional)
+	{
+		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+		srvDesc.Texture2DArray.MostDetailedMip = 0;
+		srvDesc.Texture2DArray.MipLevels = 1;
+		srvDesc.Texture2DArray.FirstArraySlice = 0;
+		srvDesc.Texture2DArray.ArraySize = MaxCascades;
+	}
 	if (FAILED(mDevice->CreateShaderResourceView(mShadow, &srvDesc, &mShadowSRV)))
 	{
 
@@ -170,13 +228,20 @@ bool Light::ShadowDepthBuffer()
 	}
 	return true;
 }
-void Light::ClearDepthStencil(ID3D11DeviceContext* context)
+void Light::ClearDepthStencil(CStateContext* context)
 {
+	if (mShadowDepthStencil == nullptr) return;
 	context->OMSetRenderTargets(0, nullptr, mShadowDepthStencil);
 	context->ClearDepthStencilView(mShadowDepthStencil, D3D11_CLEAR_DEPTH, 1.0f, 0);
+
+	// The cached cascades are gone
+	for (auto& cache : mCascadeCaches)
+	{
+		cache.Invalidate();
+	}
 }
 
-void Light::SendShadowMap2Shader(int textureSlot, ID3D11DeviceContext* context)
+void Light::SendShadowMap2Shader(int textureSlot, CStateContext* context)
 {
 	myScene = myEngine->GetScene();
 	mPointSampler = myScene->GetPointSampler();
@@ -184,4 +249,78 @@ void Light::SendShadowMap2Shader(int textureSlot, ID3D11DeviceContext* context)
 	//myEngine->GetContext()->PSSetSamplers(1, 1, &mPointSampler);
 }
 
+// Fit each cascade to its slice of the camera's view and find its casters: models inside the cascade, which
+// reaches back towards the light from the slice. The light's own model is left out
+void Light::FindFaceCasters(ICamera* camera)
+{
+	if (mLightType != Directional) return;
+
+	maths::CVector3 lightDirection = Normalise(lightModel->WorldMatrix().GetZAxis());
+	maths::CMatrix4x4 cameraWorld = camera->WorldMatrix();
+	maths::CMatrix4x4 cameraProjection = camera->ProjectionMatrix();
+	maths::CascadeSplits(camera->NearClip(), std::min(camera->FarClip(), mShadowDistance), MaxCascades, mCascadeSplitBlend, mCascadeSplits);
+
+	const float casterDistance = 10000.0f; // How far towards the light from a slice to look for casters
+	std::vector<maths::CAABB> casterBounds;
+	for (int i = 0; i < MaxCascades; ++i)
+	{
+		maths::CVector3 corners[8];
+		maths::FrustumSliceCorners(cameraWorld, cameraProjection, mCascadeSplits[i], mCascadeSplits[i + 1], corners);
+
+		// Fit reaching far back towards the light to find the casters, then bring the near plane in to the nearest
+		// of them for better depth precision
+		maths::SCascade& cascade = mCascades[i];
+		cascade = maths::FitCascade(lightDirection, corners, mShadowMapSize, casterDistance);
+
+		auto& casters = mCascadeCasters[i];
+		Model::GetVisibleObjects(maths::FrustumFromMatrix(cascade.viewProjectionMatrix), casters);
+		casters.erase(std::remove(casters.begin(), casters.end(), lightModel), casters.end());
+
+		casterBounds.clear();
+		for (auto model : casters)
+		{
+			casterBounds.push_back(model->WorldBounds());
+		}
+		maths::FitCascadeDepth(cascade, casterBounds.data(), casterBounds.size());
+	}
+}
+
+// Box around the casters of a cascade
+maths::CAABB Light::GetFaceCasterBounds(int face)
+{
+	maths::CAABB bounds = maths::EmptyAABB();
+	for (auto model : mCascadeCasters[face])
+	{
+		bounds = maths::Merge(bounds, model->WorldBounds());
+	}
+	return bounds;
+}
+
+// Render a cascade with its casters
+void Light::RenderShadowFace(int face, PerFrameConstants& perFrameConstants, ID3D11Buffer* frameConstantBuffer,
+	CStateContext* context)
+{
+	D3D11_VIEWPORT vp = {};
+	vp.Width = static_cast<FLOAT>(mShadowMapSize);
+	vp.Height = static_cast<FLOAT>(mShadowMapSize);
+	vp.MaxDepth = 1.0f;
+	context->RSSetViewports(1, &vp);
+	context->OMSetRenderTargets(0, nullptr, mCascadeDepthStencils[face]);
+	context->ClearDepthStencilView(mCascadeDepthStencils[face], D3D11_CLEAR_DEPTH, 1.0f, 0);
+
+	const maths::SCascade& cascade = mCascades[face];
+	mCascadeCaches[face].MarkRendered(cascade.viewProjectionMatrix, mCascadeCasters[face]);
+	mRenderedCascades[face] = cascade;
+	mCascadeRendered[face] = true;
+	if (mCascadeCasters[face].empty()) return;
+
+	// Camera-like matrices for the cascade
+	perFrameConstants.viewMatrix = cascade.viewMatrix;
+	perFrameConstants.projectionMatrix = cascade.projectionMatrix;
+	perFrameConstants.viewProjectionMatrix = cascade.viewProjectionMatrix;
+	UpdateConstantBuffer(frameConstantBuffer, perFrameConstants, context->GetContext());
+
+	Model::RenderShadowCasters(mCascadeCasters[face], context);
+}
+
 }
\ No newline at end of file
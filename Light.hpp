@@ -7,6 +7,8 @@
 //--------------------------------------------------------------------------------------
 
 #include "ILight.hpp"
+#include "ShadowCache.hpp"
+#include "CascadedShadows.hpp"
 
 //======================================================================================
 namespace umbra_engine
@@ -16,6 +18,7 @@ namespace umbra_engine
 //---------------------------------------
 class IScene;
 class IEngine;
+class ICamera;
 
 class Light : public ILight
 {
@@ -38,6 +41,7 @@ public:
 	maths::CVector3 GetAmbientColour();
 	float GetLightStrength();
 	int GetLightNumber();
+	ELightType GetLightType() { return mLightType; }
 
 	//Setters
 	void SetPosition(const maths::CVector4& Pos);
@@ -55,8 +59,17 @@ public:
 //---------------------------------------
 	void RenderLight(PerFrameConstants& perFrameConstants, PerModelConstants& perModelConstants);
 	bool ShadowDepthBuffer();
-	void ClearDepthStencil(ID3D11DeviceContext* context);
-	void SendShadowMap2Shader(int textureSlot, ID3D11DeviceContext* context);
+	void ClearDepthStencil(CStateContext* context);
+	void SendShadowMap2Shader(int textureSlot, CStateContext* context);
+
+	// Directional lights have cascaded shadow maps, one face per cascade (see ILight)
+	int NumShadowFaces() { return mLightType == Directional ? PerFrameConstants::MAX_CASCADES : 0; }
+	void FindFaceCasters(ICamera* camera);
+	bool IsFaceOutOfDate(int face) { return mCascadeCaches[face].IsOutOfDate(mCascades[face].viewProjectionMatrix, mCascadeCasters[face]); }
+	unsigned int GetFaceCasterCount(int face) { return static_cast<unsigned int>(mCascadeCasters[face].size()); }
+	maths::CAABB GetFaceCasterBounds(int face);
+	void RenderShadowFace(int face, PerFrameConstants& perFrameConstants, ID3D11Buffer* frameConstantBuffer,
+		CStateContext* context);
 
 private:
 //---------------------------------------
@@ -91,7 +104,21 @@ private:
 	ID3D11ShaderResourceView* mShadowSRV = nullptr;
 	ID3D11SamplerState* mPointSampler = nullptr;
 	ID3D11RenderTargetView* mShadowRenderTarget = nullptr;
-
+	int mShadowMapSize = 1024;
+
+	// Cascaded shadow maps for directional lights, each cascade is a slice of mShadow. Cascades are fitted to the
+	// camera's view each frame, but may be rendered in a later frame (see CShadowScheduler), so the shaders get
+	// the matrices each cascade was last rendered with
+	static const int MaxCascades = PerFrameConstants::MAX_CASCADES;
+	float mShadowDistance = 1000.0f;  // Distance along the camera's view covered by the cascades
+	float mCascadeSplitBlend = 0.75f; // Between even (0) and logarithmic (1) splits, see maths::CascadeSplits
+	float mCascadeSplits[MaxCascades + 1] = {};
+	ID3D11DepthStencilView* mCascadeDepthStencils[MaxCascades] = {};
+	maths::SCascade mCascades[MaxCascades];
+	maths::SCascade mRenderedCascades[MaxCascades];
+	bool mCascadeRendered[MaxCascades] = {};
+	std::vector<IModel*> mCascadeCasters[MaxCascades];
+	CShadowCache mCascadeCaches[MaxCascades];
 };//Class
 }//Namespace
 //======================================================================================
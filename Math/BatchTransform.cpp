@@ -0,0 +1,366 @@
+//--------------------------------------------------------------------------------------
+// Batch versions of the common vector and matrix operations
+//--------------------------------------------------------------------------------------
+// The SIMD loops perform the same operations in the same order as the scalar ones, so results
+// match calling the single-item functions in a loop. AoS vectors are loaded/stored as exactly
+// 12 bytes so the last element of an array never touches memory beyond it
+
+#include "BatchTransform.hpp"
+#include "MatrixKernels.hpp"
+
+#include <type_traits>
+
+namespace umbra_engine
+{
+namespace maths
+{
+namespace
+{
+// Step a pointer on by a number of bytes (for strided arrays)
+template <typename T>
+inline T* Advance(T* p, size_t bytes)
+{
+	return reinterpret_cast<T*>(reinterpret_cast<typename std::conditional<std::is_const<T>::value, const char, char>::type*>(p) + bytes);
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Scalar versions
+-----------------------------------------------------------------------------------------*/
+
+// Points have w = 1 so add the translation row, directions have w = 0 so leave it out
+template <bool IsPoint>
+inline void TransformScalar(const CMatrix4x4& m, const float* inX, const float* inY, const float* inZ,
+                            float* outX, float* outY, float* outZ)
+{
+	float x = *inX, y = *inY, z = *inZ;
+	float rx = x * m.e00 + y * m.e10 + z * m.e20;
+	float ry = x * m.e01 + y * m.e11 + z * m.e21;
+	float rz = x * m.e02 + y * m.e12 + z * m.e22;
+	if (IsPoint)
+	{
+		rx += m.e30;
+		ry += m.e31;
+		rz += m.e32;
+	}
+	*outX = rx;
+	*outY = ry;
+	*outZ = rz;
+}
+
+template <bool IsPoint>
+void TransformAoSScalar(const CMatrix4x4& m, const CVector3* in, size_t inStride, CVector3* out, size_t outStride, size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		TransformScalar<IsPoint>(m, &in->x, &in->y, &in->z, &out->x, &out->y, &out->z);
+		in = Advance(in, inStride);
+		out = Advance(out, outStride);
+	}
+}
+
+template <bool IsPoint>
+void TransformSoAScalar(const CMatrix4x4& m, const float* inX, const float* inY, const float* inZ,
+                        float* outX, float* outY, float* outZ, size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		TransformScalar<IsPoint>(m, inX + i, inY + i, inZ + i, outX + i, outY + i, outZ + i);
+	}
+}
+
+
+#if defined(UMBRA_MATHS_X86)
+/*-----------------------------------------------------------------------------------------
+	SSE versions
+-----------------------------------------------------------------------------------------*/
+
+// Load/store x, y, z only (w lane is zero on load)
+inline __m128 LoadVector3(const CVector3* v)
+{
+	__m128 xy = _mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64*>(&v->x));
+	return _mm_movelh_ps(xy, _mm_load_ss(&v->z));
+}
+inline void StoreVector3(CVector3* v, __m128 r)
+{
+	_mm_storel_pi(reinterpret_cast<__m64*>(&v->x), r);
+	_mm_store_ss(&v->z, _mm_movehl_ps(r, r));
+}
+
+// Matrix rows. Points add row 3 (w = 1), directions leave it out
+struct SRowsSSE
+{
+	__m128 r0, r1, r2, r3;
+	explicit SRowsSSE(const CMatrix4x4& m)
+		: r0(_mm_loadu_ps(&m.e00)), r1(_mm_loadu_ps(&m.e10)), r2(_mm_loadu_ps(&m.e20)), r3(_mm_loadu_ps(&m.e30)) {}
+};
+
+template <bool IsPoint>
+void TransformAoSSSE(const CMatrix4x4& m, const CVector3* in, size_t inStride, CVector3* out, size_t outStride, size_t count)
+{
+	SRowsSSE rows(m);
+	for (size_t i = 0; i < count; ++i)
+	{
+		__m128 v = LoadVector3(in);
+		__m128 r = _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)), rows.r0);
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)), rows.r1));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2)), rows.r2));
+		if (IsPoint) r = _mm_add_ps(r, rows.r3);
+		StoreVector3(out, r);
+
+		in = Advance(in, inStride);
+		out = Advance(out, outStride);
+	}
+}
+
+template <bool IsPoint>
+void TransformSoASSE(const CMatrix4x4& m, const float* inX, const float* inY, const float* inZ,
+                     float* outX, float* outY, float* outZ, size_t count)
+{
+	const float* e = &m.e00;
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(inX + i);
+		__m128 y = _mm_loadu_ps(inY + i);
+		__m128 z = _mm_loadu_ps(inZ + i);
+		__m128 r[3];
+		for (int col = 0; col < 3; ++col)
+		{
+			r[col] = _mm_mul_ps(x, _mm_set1_ps(e[col]));
+			r[col] = _mm_add_ps(r[col], _mm_mul_ps(y, _mm_set1_ps(e[4 + col])));
+			r[col] = _mm_add_ps(r[col], _mm_mul_ps(z, _mm_set1_ps(e[8 + col])));
+			if (IsPoint) r[col] = _mm_add_ps(r[col], _mm_set1_ps(e[12 + col]));
+		}
+		_mm_storeu_ps(outX + i, r[0]);
+		_mm_storeu_ps(outY + i, r[1]);
+		_mm_storeu_ps(outZ + i, r[2]);
+	}
+	TransformSoAScalar<IsPoint>(m, inX + i, inY + i, inZ + i, outX + i, outY + i, outZ + i, count - i);
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	AVX versions - SoA only, AoS data needs too much shuffling to gain from 8-wide registers
+-----------------------------------------------------------------------------------------*/
+
+template <bool IsPoint>
+UMBRA_TARGET_AVX
+void TransformSoAAVX(const CMatrix4x4& m, const float* inX, const float* inY, const float* inZ,
+                     float* outX, float* outY, float* outZ, size_t count)
+{
+	const float* e = &m.e00;
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 x = _mm256_loadu_ps(inX + i);
+		__m256 y = _mm256_loadu_ps(inY + i);
+		__m256 z = _mm256_loadu_ps(inZ + i);
+		__m256 r[3];
+		for (int col = 0; col < 3; ++col)
+		{
+			r[col] = _mm256_mul_ps(x, _mm256_set1_ps(e[col]));
+			r[col] = _mm256_add_ps(r[col], _mm256_mul_ps(y, _mm256_set1_ps(e[4 + col])));
+			r[col] = _mm256_add_ps(r[col], _mm256_mul_ps(z, _mm256_set1_ps(e[8 + col])));
+			if (IsPoint) r[col] = _mm256_add_ps(r[col], _mm256_set1_ps(e[12 + col]));
+		}
+		_mm256_storeu_ps(outX + i, r[0]);
+		_mm256_storeu_ps(outY + i, r[1]);
+		_mm256_storeu_ps(outZ + i, r[2]);
+	}
+	_mm256_zeroupper();
+	TransformSoASSE<IsPoint>(m, inX + i, inY + i, inZ + i, outX + i, outY + i, outZ + i, count - i);
+}
+#endif
+
+
+// Pick the best AoS/SoA transform for the active instruction set
+template <bool IsPoint>
+void TransformAoS(const CMatrix4x4& m, const CVector3* in, size_t inStride, CVector3* out, size_t outStride, size_t count)
+{
+#if defined(UMBRA_MATHS_X86)
+	if (simd::ActiveInstructionSet() != simd::EInstructionSet::Scalar)
+	{
+		TransformAoSSSE<IsPoint>(m, in, inStride, out, outStride, count);
+		return;
+	}
+#endif
+	TransformAoSScalar<IsPoint>(m, in, inStride, out, outStride, count);
+}
+
+template <bool IsPoint>
+void TransformSoA(const CMatrix4x4& m, const float* inX, const float* inY, const float* inZ,
+                  float* outX, float* outY, float* outZ, size_t count)
+{
+#if defined(UMBRA_MATHS_X86)
+	switch (simd::ActiveInstructionSet())
+	{
+	case simd::EInstructionSet::AVX: TransformSoAAVX<IsPoint>(m, inX, inY, inZ, outX, outY, outZ, count); return;
+	case simd::EInstructionSet::SSE: TransformSoASSE<IsPoint>(m, inX, inY, inZ, outX, outY, outZ, count); return;
+	default: break;
+	}
+#endif
+	TransformSoAScalar<IsPoint>(m, inX, inY, inZ, outX, outY, outZ, count);
+}
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Points and directions
+-----------------------------------------------------------------------------------------*/
+
+// Transform count points (w = 1) by the affine matrix m. Right hand column of m is ignored
+void TransformPoints(const CMatrix4x4& m, const CVector3* in, size_t inStride, CVector3* out, size_t outStride, size_t count)
+{
+	TransformAoS<true>(m, in, inStride, out, outStride, count);
+}
+
+// Transform count directions (w = 0) by the affine matrix m, i.e. rotate/scale but don't translate
+void TransformDirections(const CMatrix4x4& m, const CVector3* in, size_t inStride, CVector3* out, size_t outStride, size_t count)
+{
+	TransformAoS<false>(m, in, inStride, out, outStride, count);
+}
+
+// SoA versions of the above, working on 4 or 8 points at a time
+void TransformPoints(const CMatrix4x4& m, const float* inX, const float* inY, const float* inZ,
+                     float* outX, float* outY, float* outZ, size_t count)
+{
+	TransformSoA<true>(m, inX, inY, inZ, outX, outY, outZ, count);
+}
+void TransformDirections(const CMatrix4x4& m, const float* inX, const float* inY, const float* inZ,
+                         float* outX, float* outY, float* outZ, size_t count)
+{
+	TransformSoA<false>(m, inX, inY, inZ, outX, outY, outZ, count);
+}
+
+
+// out[i] += v[i] * s, e.g. move an array of positions by their velocities over a frame
+void AddScaled(const CVector3* v, size_t vStride, float s, CVector3* out, size_t outStride, size_t count)
+{
+#if defined(UMBRA_MATHS_X86)
+	if (simd::ActiveInstructionSet() != simd::EInstructionSet::Scalar)
+	{
+		const __m128 scale = _mm_set1_ps(s);
+		for (size_t i = 0; i < count; ++i)
+		{
+			StoreVector3(out, _mm_add_ps(LoadVector3(out), _mm_mul_ps(LoadVector3(v), scale)));
+			v = Advance(v, vStride);
+			out = Advance(out, outStride);
+		}
+		return;
+	}
+#endif
+	for (size_t i = 0; i < count; ++i)
+	{
+		*out += *v * s;
+		v = Advance(v, vStride);
+		out = Advance(out, outStride);
+	}
+}
+
+// out[i] = Dot(axis, points[i] - origin), e.g. depth of points along a camera's facing direction
+void ProjectOntoAxis(const CVector3* points, size_t stride, const CVector3& origin, const CVector3& axis,
+                     float* out, size_t outStride, size_t count)
+{
+#if defined(UMBRA_MATHS_X86)
+	if (simd::ActiveInstructionSet() != simd::EInstructionSet::Scalar)
+	{
+		const __m128 o = LoadVector3(&origin);
+		const __m128 a = LoadVector3(&axis);
+		for (size_t i = 0; i < count; ++i)
+		{
+			// Sum (x + y) + z, the same order as Dot
+			__m128 p = _mm_mul_ps(a, _mm_sub_ps(LoadVector3(points), o));
+			__m128 d = _mm_add_ss(_mm_add_ss(p, _mm_shuffle_ps(p, p, _MM_SHUFFLE(1, 1, 1, 1))), _mm_movehl_ps(p, p));
+			_mm_store_ss(out, d);
+			points = Advance(points, stride);
+			out = Advance(out, outStride);
+		}
+		return;
+	}
+#endif
+	for (size_t i = 0; i < count; ++i)
+	{
+		*out = Dot(axis, *points - origin);
+		points = Advance(points, stride);
+		out = Advance(out, outStride);
+	}
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Vertices
+-----------------------------------------------------------------------------------------*/
+
+// Append vertices transformed by m, and their indices moved on past the vertices already there
+void AppendTransformedVertices(const CMatrix4x4& m, const uint8_t* vertices, size_t numVertices, size_t vertexSize, int tangentOffset,
+                               const uint32_t* indices, size_t numIndices, std::vector<uint8_t>& outVertices, std::vector<uint32_t>& outIndices)
+{
+	uint32_t firstVertex = static_cast<uint32_t>(outVertices.size() / vertexSize);
+	for (size_t i = 0; i < numIndices; ++i)
+	{
+		outIndices.push_back(firstVertex + indices[i]);
+	}
+	if (numVertices == 0) return;
+
+	// Copy the vertices, then transform positions, normals and tangents where they lie in the copy
+	size_t start = outVertices.size();
+	outVertices.insert(outVertices.end(), vertices, vertices + numVertices * vertexSize);
+	uint8_t* copy = outVertices.data() + start;
+	auto position = reinterpret_cast<CVector3*>(copy);
+	auto normal = reinterpret_cast<CVector3*>(copy + sizeof(CVector3));
+	auto tangent = (tangentOffset >= 0) ? reinterpret_cast<CVector3*>(copy + tangentOffset) : nullptr;
+	TransformPoints(m, position, vertexSize, position, vertexSize, numVertices);
+	TransformDirections(m, normal, vertexSize, normal, vertexSize, numVertices);
+	if (tangent != nullptr) TransformDirections(m, tangent, vertexSize, tangent, vertexSize, numVertices);
+
+	// Scaled matrices scale normals, the shaders expect unit length ones
+	for (size_t i = 0; i < numVertices; ++i)
+	{
+		*normal = Normalise(*normal);
+		normal = Advance(normal, vertexSize);
+		if (tangent != nullptr)
+		{
+			*tangent = Normalise(*tangent);
+			tangent = Advance(tangent, vertexSize);
+		}
+	}
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Matrices
+-----------------------------------------------------------------------------------------*/
+
+// out[i] = in[i] * m
+void MultiplyMatrices(const CMatrix4x4* in, const CMatrix4x4& m, CMatrix4x4* out, size_t count)
+{
+	// Take a copy in case m is one of the output matrices
+	const CMatrix4x4 mCopy = m;
+	if (count > 0) simd::MatrixKernels().multiplyBatch(&in[0].e00, &mCopy.e00, &out[0].e00, count);
+}
+
+// out[i] = a[i] * b[i]
+void MultiplyMatricesPairwise(const CMatrix4x4* a, const CMatrix4x4* b, CMatrix4x4* out, size_t count)
+{
+	if (count > 0) simd::MatrixKernels().multiplyPairwise(&a[0].e00, &b[0].e00, &out[0].e00, count);
+}
+
+// Convert a hierarchy of local (parent-relative) matrices to absolute ones: absolute[i] = local[i] * absolute[parents[i]]
+void ResolveMatrixChain(const CMatrix4x4* local, const unsigned int* parents, CMatrix4x4* absolute, size_t count)
+{
+	// Each matrix depends on its parent's, so this is a chain of single multiplies
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (parents[i] < i)
+		{
+			simd::MultiplyMatrix(&local[i].e00, &absolute[parents[i]].e00, &absolute[i].e00);
+		}
+		else if (&absolute[i] != &local[i])
+		{
+			absolute[i] = local[i];
+		}
+	}
+}
+
+} } //Namespaces
@@ -0,0 +1,90 @@
+#ifndef _BATCH_TRANSFORM_H_
+#define _BATCH_TRANSFORM_H_
+//======================================================================================
+
+//--------------------------------------------------------------------------------------
+// Batch versions of the common vector and matrix operations
+// Work through whole arrays at once using the widest instruction set available (see SIMD.hpp),
+// so per-frame work on large numbers of points/particles/nodes doesn't pay per-call overhead
+//--------------------------------------------------------------------------------------
+// Arrays of structures (AoS) are passed as a pointer to the first CVector3 and a stride in bytes
+// between elements, so vectors can be read from/written to inside larger structures directly,
+// e.g. the position member of an array of particles. Structures of arrays (SoA) are passed as
+// separate x, y and z arrays. Unless stated otherwise the output may be the same array as the input
+
+#include "CMatrix4x4.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//======================================================================================
+namespace umbra_engine
+{
+
+namespace maths
+{
+/*-----------------------------------------------------------------------------------------
+	Points and directions
+-----------------------------------------------------------------------------------------*/
+
+// Transform count points (w = 1) by the affine matrix m. Right hand column of m is ignored
+void TransformPoints(const CMatrix4x4& m, const CVector3* in, size_t inStride, CVector3* out, size_t outStride, size_t count);
+inline void TransformPoints(const CMatrix4x4& m, const CVector3* in, CVector3* out, size_t count)
+{
+	TransformPoints(m, in, sizeof(CVector3), out, sizeof(CVector3), count);
+}
+
+// Transform count directions (w = 0) by the affine matrix m, i.e. rotate/scale but don't translate
+void TransformDirections(const CMatrix4x4& m, const CVector3* in, size_t inStride, CVector3* out, size_t outStride, size_t count);
+inline void TransformDirections(const CMatrix4x4& m, const CVector3* in, CVector3* out, size_t count)
+{
+	TransformDirections(m, in, sizeof(CVector3), out, sizeof(CVector3), count);
+}
+
+// SoA versions of the above, working on 4 or 8 points at a time
+void TransformPoints(const CMatrix4x4& m, const float* inX, const float* inY, const float* inZ,
+                     float* outX, float* outY, float* outZ, size_t count);
+void TransformDirections(const CMatrix4x4& m, const float* inX, const float* inY, const float* inZ,
+                         float* outX, float* outY, float* outZ, size_t count);
+
+// out[i] += v[i] * s, e.g. move an array of positions by their velocities over a frame
+void AddScaled(const CVector3* v, size_t vStride, float s, CVector3* out, size_t outStride, size_t count);
+
+// out[i] = Dot(axis, points[i] - origin), e.g. depth of points along a camera's facing direction
+// Results are written as floats outStride bytes apart
+void ProjectOntoAxis(const CVector3* points, size_t stride, const CVector3& origin, const CVector3& axis,
+                     float* out, size_t outStride, size_t count);
+
+
+/*-----------------------------------------------------------------------------------------
+	Vertices
+-----------------------------------------------------------------------------------------*/
+
+// Append interleaved vertices of vertexSize bytes to a vertex buffer, transformed by the affine matrix m, and their
+// triangle list indices to an index buffer, e.g. to merge many meshes into one that draws with a single call. Each
+// vertex starts with a float3 position and a float3 normal, with a float3 tangent at tangentOffset bytes (-1 if
+// none). Positions are transformed as points, normals and tangents as directions and normalised (m may scale).
+// Indices are moved on past the vertices already in outVertices. Any other vertex data is copied unchanged
+void AppendTransformedVertices(const CMatrix4x4& m, const uint8_t* vertices, size_t numVertices, size_t vertexSize, int tangentOffset,
+                               const uint32_t* indices, size_t numIndices, std::vector<uint8_t>& outVertices, std::vector<uint32_t>& outIndices);
+
+
+/*-----------------------------------------------------------------------------------------
+	Matrices
+-----------------------------------------------------------------------------------------*/
+
+// out[i] = in[i] * m
+void MultiplyMatrices(const CMatrix4x4* in, const CMatrix4x4& m, CMatrix4x4* out, size_t count);
+
+// out[i] = a[i] * b[i]
+void MultiplyMatricesPairwise(const CMatrix4x4* a, const CMatrix4x4* b, CMatrix4x4* out, size_t count);
+
+// Convert a hierarchy of local (parent-relative) matrices to absolute ones: absolute[i] = local[i] * absolute[parents[i]]
+// Parents must come before their children (e.g. depth-first order). An entry whose parent index is not less
+// than its own index is a root, its local matrix is copied over unchanged. absolute may be the same array as local
+void ResolveMatrixChain(const CMatrix4x4* local, const unsigned int* parents, CMatrix4x4* absolute, size_t count);
+
+} } //Namespaces
+//======================================================================================
+#endif // _BATCH_TRANSFORM_H_
@@ -0,0 +1,161 @@
+//--------------------------------------------------------------------------------------
+// Dual quaternion class, to hold rigid transforms (rotation + translation) for skinning
+//--------------------------------------------------------------------------------------
+// Formulas are the standard ones (Kavan et al.) written in terms of this app's quaternion product,
+// where q1 * q2 is the Hamilton product q2q1. For real part r and dual part d the translation is 2dr*
+
+#include "CDualQuaternion.hpp"
+
+#include <cmath>
+
+namespace umbra_engine
+{
+namespace maths
+{
+namespace
+{
+// Quaternion arithmetic only needed here, component-wise
+inline CQuaternion Add(const CQuaternion& a, const CQuaternion& b)
+{
+	return CQuaternion{ a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w };
+}
+
+inline CQuaternion Scale(const CQuaternion& q, float s)
+{
+	return CQuaternion{ q.x * s, q.y * s, q.z * s, q.w * s };
+}
+
+// Step a pointer on by a number of bytes (for strided arrays)
+template <typename T>
+inline const T* Advance(const T* p, size_t bytes)
+{
+	return reinterpret_cast<const T*>(reinterpret_cast<const char*>(p) + bytes);
+}
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Non-member operators
+-----------------------------------------------------------------------------------------*/
+
+// Combine two transforms, dq1 first then dq2 (same order as matrices)
+CDualQuaternion operator* (const CDualQuaternion& dq1, const CDualQuaternion& dq2)
+{
+	return CDualQuaternion{ dq1.real * dq2.real, Add(dq1.dual * dq2.real, dq1.real * dq2.dual) };
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Non-member functions
+-----------------------------------------------------------------------------------------*/
+
+// Return the transform that applies the given rotation (must be normalised) then the given translation
+CDualQuaternion DualQuaternionFromRotationTranslation(const CQuaternion& rotation, const CVector3& translation)
+{
+	CQuaternion t{ translation.x, translation.y, translation.z, 0.0f };
+	return CDualQuaternion{ rotation, Scale(rotation * t, 0.5f) };
+}
+
+// Return the rigid part of an affine matrix, any scale is removed
+CDualQuaternion DualQuaternionFromMatrix(const CMatrix4x4& m)
+{
+	CQuaternion rotation = QuaternionFromAxes(Normalise(m.GetXAxis()), Normalise(m.GetYAxis()), Normalise(m.GetZAxis()));
+	return DualQuaternionFromRotationTranslation(rotation, m.GetPosition());
+}
+
+// Convert count matrices to dual quaternions
+void DualQuaternionsFromMatrices(const CMatrix4x4* matrices, CDualQuaternion* dualQuaternions, size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		dualQuaternions[i] = DualQuaternionFromMatrix(matrices[i]);
+	}
+}
+
+// Return the matrix holding the same transform as a normalised dual quaternion
+CMatrix4x4 MatrixFromDualQuaternion(const CDualQuaternion& dq)
+{
+	CMatrix4x4 m = MatrixRotation(dq.real);
+	m.SetRow(3, GetTranslation(dq));
+	return m;
+}
+
+// Return the translation held by a normalised dual quaternion: vector part of 2dr*
+CVector3 GetTranslation(const CDualQuaternion& dq)
+{
+	CVector3 r{ dq.real.x, dq.real.y, dq.real.z };
+	CVector3 d{ dq.dual.x, dq.dual.y, dq.dual.z };
+	return (d * dq.real.w - r * dq.dual.w + Cross(r, d)) * 2.0f;
+}
+
+// Return unit length dual quaternion holding the same transform
+CDualQuaternion Normalise(const CDualQuaternion& dq)
+{
+	float invLength = 1.0f / Length(dq.real);
+	CQuaternion real = Scale(dq.real, invLength);
+	CQuaternion dual = Scale(dq.dual, invLength);
+
+	// Remove any part of the dual parallel to the real part (it holds no translation and would distort the matrix)
+	return CDualQuaternion{ real, Add(dual, Scale(real, -Dot(real, dual))) };
+}
+
+// Transform a point by a normalised dual quaternion
+CVector3 TransformPoint(const CDualQuaternion& dq, const CVector3& point)
+{
+	return Rotate(dq.real, point) + GetTranslation(dq);
+}
+
+// Transform a direction by a normalised dual quaternion (rotation only)
+CVector3 TransformDirection(const CDualQuaternion& dq, const CVector3& direction)
+{
+	return Rotate(dq.real, direction);
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Skinning
+-----------------------------------------------------------------------------------------*/
+
+// Return the normalised blend of up to 4 bones from the palette
+CDualQuaternion BlendBones(const CDualQuaternion* palette, const unsigned char* bones, const float* weights)
+{
+	const CDualQuaternion& first = palette[bones[0]];
+	CQuaternion real{ 0.0f, 0.0f, 0.0f, 0.0f };
+	CQuaternion dual{ 0.0f, 0.0f, 0.0f, 0.0f };
+	for (int i = 0; i < 4; ++i)
+	{
+		if (weights[i] == 0.0f)  continue;
+
+		const CDualQuaternion& bone = palette[bones[i]];
+		float weight = Dot(bone.real, first.real) < 0.0f ? -weights[i] : weights[i];
+		real = Add(real, Scale(bone.real, weight));
+		dual = Add(dual, Scale(bone.dual, weight));
+	}
+
+	// Translation is read with GetTranslation, which ignores any dual part parallel to the real part, so
+	// only the real part needs to be made unit length here (as the shader does)
+	float invLength = 1.0f / Length(real);
+	return CDualQuaternion{ Scale(real, invLength), Scale(dual, invLength) };
+}
+
+// Skin count vertices read vertexStride bytes apart, results written to tightly packed arrays
+void SkinVertices(const CDualQuaternion* palette,
+                  const CVector3* positions, const CVector3* normals, const unsigned char* bones, const float* weights, size_t vertexStride,
+                  CVector3* skinnedPositions, CVector3* skinnedNormals, size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		CDualQuaternion blend = BlendBones(palette, bones, weights);
+		skinnedPositions[i] = TransformPoint(blend, *positions);
+		positions = Advance(positions, vertexStride);
+		if (normals != nullptr)
+		{
+			skinnedNormals[i] = TransformDirection(blend, *normals);
+			normals = Advance(normals, vertexStride);
+		}
+		bones = Advance(bones, vertexStride);
+		weights = Advance(weights, vertexStride);
+	}
+}
+
+} } //Namespaces
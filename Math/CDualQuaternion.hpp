@@ -0,0 +1,110 @@
+//--------------------------------------------------------------------------------------
+// Dual quaternion class, to hold rigid transforms (rotation + translation) for skinning
+//--------------------------------------------------------------------------------------
+// Code in .cpp file
+// A dual quaternion is a rotation quaternion (real part) plus a dual part encoding the translation,
+// 8 floats (32 bytes) against 16 for a matrix. Blending dual quaternions and renormalising gives a
+// rigid transform, so skinned joints keep their volume when twisted instead of collapsing to a
+// "candy-wrapper" as blended matrices do. They can't hold scale - see DualQuaternionFromMatrix
+//
+// Same conventions as the matrices and quaternions in this app: dq1 * dq2 is dq1 followed by dq2,
+// so MatrixFromDualQuaternion(dq1 * dq2) == MatrixFromDualQuaternion(dq1) * MatrixFromDualQuaternion(dq2)
+
+#ifndef _CDUALQUATERNION_H_DEFINED_
+#define _CDUALQUATERNION_H_DEFINED_
+
+#include "CVector3.hpp"
+#include "CMatrix4x4.hpp"
+#include "CQuaternion.hpp"
+
+#include <cstddef>
+
+namespace umbra_engine
+{
+namespace maths
+{
+
+class CDualQuaternion
+{
+	// Concrete class - public access
+public:
+	CQuaternion real; // Rotation
+	CQuaternion dual; // Translation, stored as half the translation multiplied by the rotation
+
+	/*-----------------------------------------------------------------------------------------
+		Constructors
+	-----------------------------------------------------------------------------------------*/
+
+	// Default constructor - leaves values uninitialised (for performance)
+	CDualQuaternion() {}
+
+	// Construct from real and dual parts
+	constexpr CDualQuaternion(const CQuaternion& realIn, const CQuaternion& dualIn) : real(realIn), dual(dualIn) {}
+};
+
+// The skinning palette is sent to the GPU as an array of these, two float4s per bone (see Common.hlsli)
+static_assert(sizeof(CDualQuaternion) == 32, "CDualQuaternion must be 32 bytes to match the shader bone palette");
+
+
+/*-----------------------------------------------------------------------------------------
+	Non-member operators
+-----------------------------------------------------------------------------------------*/
+
+// Combine two transforms, dq1 first then dq2 (same order as matrices)
+CDualQuaternion operator* (const CDualQuaternion& dq1, const CDualQuaternion& dq2);
+
+
+/*-----------------------------------------------------------------------------------------
+	Non-member functions
+-----------------------------------------------------------------------------------------*/
+
+// Return the identity dual quaternion (no rotation or translation)
+constexpr CDualQuaternion DualQuaternionIdentity()
+{
+	return CDualQuaternion{ QuaternionIdentity(), CQuaternion{ 0.0f, 0.0f, 0.0f, 0.0f } };
+}
+
+// Return the transform that applies the given rotation (must be normalised) then the given translation
+CDualQuaternion DualQuaternionFromRotationTranslation(const CQuaternion& rotation, const CVector3& translation);
+
+// Return the rigid part of an affine matrix. Any scale is removed, so the result only matches the matrix
+// when the matrix has no scale (or shear). Skinning code should take scale out of the bone matrices first,
+// e.g. by keeping the model's (scaled) world matrix out of the bones and applying it after skinning, as Mesh::Render does
+CDualQuaternion DualQuaternionFromMatrix(const CMatrix4x4& m);
+
+// Convert count matrices to dual quaternions, e.g. absolute bone matrices to a skinning palette
+void DualQuaternionsFromMatrices(const CMatrix4x4* matrices, CDualQuaternion* dualQuaternions, size_t count);
+
+// Return the matrix holding the same transform as a normalised dual quaternion
+CMatrix4x4 MatrixFromDualQuaternion(const CDualQuaternion& dq);
+
+// Return the translation held by a normalised dual quaternion
+CVector3 GetTranslation(const CDualQuaternion& dq);
+
+// Return unit length dual quaternion holding the same transform (real part unit length, dual part perpendicular to it)
+CDualQuaternion Normalise(const CDualQuaternion& dq);
+
+// Transform a point / direction by a normalised dual quaternion, same result as multiplying by MatrixFromDualQuaternion(dq)
+CVector3 TransformPoint(const CDualQuaternion& dq, const CVector3& point);
+CVector3 TransformDirection(const CDualQuaternion& dq, const CVector3& direction);
+
+
+/*-----------------------------------------------------------------------------------------
+	Skinning
+-----------------------------------------------------------------------------------------*/
+// CPU versions of the dual quaternion skinning in Common.hlsli, e.g. to check deformation without a GPU
+// Each vertex has up to 4 bones: 4 byte bone indexes into the palette and 4 float weights, as in the
+// mesh vertex buffers. Bones with zero weight are ignored
+
+// Return the normalised blend of up to 4 bones from the palette. Each bone is flipped if needed to be in the
+// same hemisphere as the first, since q and -q are the same rotation but would cancel out in the blend
+CDualQuaternion BlendBones(const CDualQuaternion* palette, const unsigned char* bones, const float* weights);
+
+// Skin count vertices. positions, normals (optional, can be nullptr), bones and weights are read vertexStride
+// bytes apart, so they can point into an interleaved vertex buffer. Results are written to tightly packed arrays
+void SkinVertices(const CDualQuaternion* palette,
+                  const CVector3* positions, const CVector3* normals, const unsigned char* bones, const float* weights, size_t vertexStride,
+                  CVector3* skinnedPositions, CVector3* skinnedNormals, size_t count);
+
+} } //Namespaces
+#endif // _CDUALQUATERNION_H_DEFINED_
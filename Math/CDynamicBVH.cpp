@@ -0,0 +1,375 @@
+//--------------------------------------------------------------------------------------
+// Dynamic bounding volume hierarchy
+//--------------------------------------------------------------------------------------
+// Follows the well known incremental AABB tree design (as used in Box2D and Bullet): surface area guided
+// insertion, removal by promoting the sibling, and AVL style rotations to keep the tree balanced
+
+#include "CDynamicBVH.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+namespace umbra_engine
+{
+namespace maths
+{
+namespace
+{
+// Half the surface area of a box, proportional to the chance of a random ray or frustum hitting it
+inline float HalfArea(const CAABB& box)
+{
+	CVector3 size = box.maximum - box.minimum;
+	return size.x * size.y + size.y * size.z + size.z * size.x;
+}
+
+// Return the box grown by the given amount on every side
+inline CAABB Grow(const CAABB& box, float amount)
+{
+	CVector3 margin{ amount, amount, amount };
+	return CAABB{ box.minimum - margin, box.maximum + margin };
+}
+
+// True if the inner box is completely inside the outer one
+inline bool Encloses(const CAABB& outer, const CAABB& inner)
+{
+	return outer.minimum.x <= inner.minimum.x && outer.minimum.y <= inner.minimum.y && outer.minimum.z <= inner.minimum.z &&
+	       outer.maximum.x >= inner.maximum.x && outer.maximum.y >= inner.maximum.y && outer.maximum.z >= inner.maximum.z;
+}
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Constructors
+-----------------------------------------------------------------------------------------*/
+
+// Construct an empty tree
+CDynamicBVH::CDynamicBVH(float margin /*= 1.0f*/)
+	: mMargin(margin)
+{
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Member functions
+-----------------------------------------------------------------------------------------*/
+
+// Add an object with the given box to the tree, returns the proxy used to refer to it later
+int CDynamicBVH::Insert(const CAABB& bounds, void* userData)
+{
+	int proxy = AllocateNode();
+	mNodes[proxy].bounds = Grow(bounds, mMargin);
+	mNodes[proxy].userData = userData;
+	mNodes[proxy].height = 0;
+	InsertLeaf(proxy);
+	++mNumProxies;
+	return proxy;
+}
+
+// Remove an object from the tree
+void CDynamicBVH::Remove(int proxy)
+{
+	assert(proxy >= 0 && proxy < static_cast<int>(mNodes.size()) && mNodes[proxy].IsLeaf());
+	RemoveLeaf(proxy);
+	FreeNode(proxy);
+	--mNumProxies;
+}
+
+// Give an object a new box, returns true if the tree changed
+bool CDynamicBVH::Update(int proxy, const CAABB& bounds)
+{
+	assert(proxy >= 0 && proxy < static_cast<int>(mNodes.size()) && mNodes[proxy].IsLeaf());
+
+	// Nothing to do while the object stays in its fat box, unless it has shrunk so much that the fat box is
+	// no longer a good fit (the tree would keep returning it for queries well outside the object)
+	if (Encloses(mNodes[proxy].bounds, bounds) && Encloses(Grow(bounds, 4.0f * mMargin), mNodes[proxy].bounds))
+	{
+		return false;
+	}
+
+	RemoveLeaf(proxy);
+	mNodes[proxy].bounds = Grow(bounds, mMargin);
+	InsertLeaf(proxy);
+	return true;
+}
+
+
+// Append the proxy of every object whose fat box intersects the frustum to results
+void CDynamicBVH::Query(const CFrustum& frustum, std::vector<int>& results) const
+{
+	if (mRoot == NullProxy) return;
+
+	// Each entry records whether its parent was already found to be completely inside the frustum, in which
+	// case everything below is visible and no more tests are needed
+	struct SEntry
+	{
+		int  node;
+		bool inside;
+	};
+	SEntry stack[MaxStackSize];
+	int stackSize = 0;
+	stack[stackSize++] = { mRoot, false };
+
+	while (stackSize > 0)
+	{
+		SEntry entry = stack[--stackSize];
+		const SNode& node = mNodes[entry.node];
+
+		bool inside = entry.inside;
+		if (!inside)
+		{
+			EIntersection intersection = Classify(frustum, node.bounds);
+			if (intersection == EIntersection::Outside) continue;
+			inside = (intersection == EIntersection::Inside);
+		}
+
+		if (node.IsLeaf())
+		{
+			results.push_back(entry.node);
+		}
+		else
+		{
+			assert(stackSize + 2 <= MaxStackSize);
+			stack[stackSize++] = { node.child2, inside };
+			stack[stackSize++] = { node.child1, inside };
+		}
+	}
+}
+
+// Append the proxy of every object whose fat box intersects the box to results
+void CDynamicBVH::Query(const CAABB& box, std::vector<int>& results) const
+{
+	if (mRoot == NullProxy) return;
+
+	int stack[MaxStackSize];
+	int stackSize = 0;
+	stack[stackSize++] = mRoot;
+
+	while (stackSize > 0)
+	{
+		int index = stack[--stackSize];
+		const SNode& node = mNodes[index];
+		if (!Intersects(node.bounds, box)) continue;
+
+		if (node.IsLeaf())
+		{
+			results.push_back(index);
+		}
+		else
+		{
+			assert(stackSize + 2 <= MaxStackSize);
+			stack[stackSize++] = node.child2;
+			stack[stackSize++] = node.child1;
+		}
+	}
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Private member functions
+-----------------------------------------------------------------------------------------*/
+
+// Get a node from the free list, growing the node array if necessary
+// Nodes are referred to by index so growing the array doesn't invalidate anything, but it does invalidate
+// references, so callers must not hold a reference to a node across this call
+int CDynamicBVH::AllocateNode()
+{
+	if (mFreeList == NullProxy)
+	{
+		SNode node;
+		node.parent = NullProxy;
+		node.height = -1;
+		mNodes.push_back(node);
+		mFreeList = static_cast<int>(mNodes.size()) - 1;
+	}
+
+	int index = mFreeList;
+	SNode& node = mNodes[index];
+	mFreeList = node.parent;
+	node.userData = nullptr;
+	node.parent = NullProxy;
+	node.child1 = NullProxy;
+	node.child2 = NullProxy;
+	node.height = 0;
+	return index;
+}
+
+// Return a node to the free list
+void CDynamicBVH::FreeNode(int node)
+{
+	mNodes[node].parent = mFreeList;
+	mNodes[node].height = -1;
+	mFreeList = node;
+}
+
+
+// Link a leaf into the tree, next to the node where it adds least surface area
+void CDynamicBVH::InsertLeaf(int leaf)
+{
+	if (mRoot == NullProxy)
+	{
+		mRoot = leaf;
+		mNodes[leaf].parent = NullProxy;
+		return;
+	}
+
+	// Walk down choosing the cheaper child each time. Pairing the leaf with a node costs the area of the new
+	// parent, and every ancestor grows as well (the inherited cost). Stop when pairing here is cheaper than
+	// going further down
+	const CAABB leafBounds = mNodes[leaf].bounds;
+	int index = mRoot;
+	while (!mNodes[index].IsLeaf())
+	{
+		const SNode& node = mNodes[index];
+		float area = HalfArea(node.bounds);
+		float combinedArea = HalfArea(Merge(node.bounds, leafBounds));
+
+		float cost = 2.0f * combinedArea;
+		float inheritanceCost = 2.0f * (combinedArea - area);
+
+		auto childCost = [&](int child)
+		{
+			const SNode& childNode = mNodes[child];
+			float newArea = HalfArea(Merge(childNode.bounds, leafBounds));
+			if (!childNode.IsLeaf()) newArea -= HalfArea(childNode.bounds);
+			return newArea + inheritanceCost;
+		};
+		float cost1 = childCost(node.child1);
+		float cost2 = childCost(node.child2);
+
+		if (cost < cost1 && cost < cost2) break;
+		index = (cost1 < cost2) ? node.child1 : node.child2;
+	}
+	int sibling = index;
+
+	// Make a new parent for the leaf and its sibling, in the sibling's place
+	int newParent = AllocateNode();
+	int oldParent = mNodes[sibling].parent;
+	mNodes[newParent].parent = oldParent;
+	mNodes[newParent].bounds = Merge(leafBounds, mNodes[sibling].bounds);
+	mNodes[newParent].height = mNodes[sibling].height + 1;
+	mNodes[newParent].child1 = sibling;
+	mNodes[newParent].child2 = leaf;
+	mNodes[sibling].parent = newParent;
+	mNodes[leaf].parent = newParent;
+
+	if (oldParent == NullProxy)
+	{
+		mRoot = newParent;
+	}
+	else if (mNodes[oldParent].child1 == sibling)
+	{
+		mNodes[oldParent].child1 = newParent;
+	}
+	else
+	{
+		mNodes[oldParent].child2 = newParent;
+	}
+
+	RefitAncestors(oldParent);
+}
+
+// Unlink a leaf from the tree, its sibling takes the place of their parent
+void CDynamicBVH::RemoveLeaf(int leaf)
+{
+	if (leaf == mRoot)
+	{
+		mRoot = NullProxy;
+		return;
+	}
+
+	int parent = mNodes[leaf].parent;
+	int grandParent = mNodes[parent].parent;
+	int sibling = (mNodes[parent].child1 == leaf) ? mNodes[parent].child2 : mNodes[parent].child1;
+
+	mNodes[sibling].parent = grandParent;
+	FreeNode(parent);
+	if (grandParent == NullProxy)
+	{
+		mRoot = sibling;
+		return;
+	}
+
+	if (mNodes[grandParent].child1 == parent)
+	{
+		mNodes[grandParent].child1 = sibling;
+	}
+	else
+	{
+		mNodes[grandParent].child2 = sibling;
+	}
+	RefitAncestors(grandParent);
+}
+
+
+// Recalculate boxes and heights from the given node up to the root, rotating where unbalanced
+void CDynamicBVH::RefitAncestors(int node)
+{
+	while (node != NullProxy)
+	{
+		node = Balance(node);
+
+		SNode& n = mNodes[node];
+		const SNode& child1 = mNodes[n.child1];
+		const SNode& child2 = mNodes[n.child2];
+		n.height = 1 + std::max(child1.height, child2.height);
+		n.bounds = Merge(child1.bounds, child2.bounds);
+
+		node = n.parent;
+	}
+}
+
+// Rotate the tree at node A if its children's heights differ by more than one. With B the shorter child and
+// C the taller, C takes A's place with A as its first child. C keeps its taller child and gives the shorter
+// one to A in C's old place, so A ends up with B and C's shorter child. Returns the node now in A's place
+int CDynamicBVH::Balance(int a)
+{
+	SNode& nodeA = mNodes[a];
+	if (nodeA.IsLeaf() || nodeA.height < 2) return a;
+
+	int b = nodeA.child1;
+	int c = nodeA.child2;
+	int balance = mNodes[c].height - mNodes[b].height;
+	if (balance >= -1 && balance <= 1) return a;
+
+	// Rotate the taller child up. Write the rotation once in terms of "short" and "tall" children, which
+	// child slot A's short child is in doesn't matter
+	int tall    = (balance > 1) ? c : b;
+	int shorter = (balance > 1) ? b : c;
+	SNode& nodeTall = mNodes[tall];
+	int f = nodeTall.child1;
+	int g = nodeTall.child2;
+
+	// Tall node takes A's place
+	nodeTall.parent = nodeA.parent;
+	nodeA.parent = tall;
+	if (nodeTall.parent == NullProxy)
+	{
+		mRoot = tall;
+	}
+	else if (mNodes[nodeTall.parent].child1 == a)
+	{
+		mNodes[nodeTall.parent].child1 = tall;
+	}
+	else
+	{
+		mNodes[nodeTall.parent].child2 = tall;
+	}
+
+	// The taller grandchild stays with the tall node, A takes the shorter one
+	int keep = (mNodes[f].height > mNodes[g].height) ? f : g;
+	int move = (keep == f) ? g : f;
+	nodeTall.child1 = a;
+	nodeTall.child2 = keep;
+	nodeA.child1 = shorter;
+	nodeA.child2 = move;
+	mNodes[move].parent = a;
+
+	nodeA.bounds = Merge(mNodes[shorter].bounds, mNodes[move].bounds);
+	nodeA.height = 1 + std::max(mNodes[shorter].height, mNodes[move].height);
+	nodeTall.bounds = Merge(nodeA.bounds, mNodes[keep].bounds);
+	nodeTall.height = 1 + std::max(nodeA.height, mNodes[keep].height);
+
+	return tall;
+}
+
+} } //Namespaces
@@ -0,0 +1,216 @@
+//--------------------------------------------------------------------------------------
+// Dynamic bounding volume hierarchy
+//--------------------------------------------------------------------------------------
+// Code in .cpp file
+// A binary tree of axis-aligned boxes for finding which objects are in a frustum or box without testing
+// every object. Objects (proxies) can be inserted, removed and moved at any time. Each leaf stores a
+// "fat" box, the object's box grown by a margin, so small movements don't change the tree at all. When an
+// object leaves its fat box it is removed and reinserted, which is only a walk down and up one path.
+// New leaves are placed next to the node that adds least surface area (a cheap surface area heuristic) and
+// every node on the way back up is rebalanced with tree rotations, keeping the height close to log2(N).
+// Queries skip any subtree whose box is outside the frustum and don't test anything below a box that is
+// completely inside, so the cost follows the number of visible objects rather than the total
+// Ray casts visit boxes nearest first and let the caller shorten the ray after each exact hit, and nearest
+// queries visit objects in order of distance, so both stop as soon as the answer is known
+
+#ifndef _CDYNAMIC_BVH_H_DEFINED_
+#define _CDYNAMIC_BVH_H_DEFINED_
+
+#include "Geometry.hpp"
+
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+
+namespace umbra_engine
+{
+namespace maths
+{
+
+class CDynamicBVH
+{
+public:
+	/*-----------------------------------------------------------------------------------------
+		Constructors
+	-----------------------------------------------------------------------------------------*/
+
+	// Construct an empty tree. Leaf boxes are grown by margin on every side, larger values mean fewer
+	// reinsertions for moving objects but looser boxes in queries
+	explicit CDynamicBVH(float margin = 1.0f);
+
+
+	/*-----------------------------------------------------------------------------------------
+		Member functions
+	-----------------------------------------------------------------------------------------*/
+
+	// Proxy value that never refers to an object
+	static const int NullProxy = -1;
+
+	// Add an object with the given box to the tree, returns the proxy used to refer to it later. The user data
+	// is returned by queries
+	int Insert(const CAABB& bounds, void* userData);
+
+	// Remove an object from the tree. The proxy may be reused by a later insert
+	void Remove(int proxy);
+
+	// Give an object a new box (e.g. after it has moved). Returns true if the tree changed, false if the new box
+	// still fits in the object's fat box, which is by far the common case for small movements
+	bool Update(int proxy, const CAABB& bounds);
+
+	// Access the data for a proxy
+	void*        GetUserData(int proxy) const  { return mNodes[proxy].userData; }
+	const CAABB& GetFatBounds(int proxy) const { return mNodes[proxy].bounds; }
+
+	// Number of objects in the tree / height of the tree (0 if empty or a single object)
+	size_t Count() const { return mNumProxies; }
+	int    Height() const { return mRoot == NullProxy ? 0 : mNodes[mRoot].height; }
+
+	// Append the proxy of every object whose fat box intersects the frustum / box to results
+	// Objects may be returned that are just outside, as their fat box is larger than their actual box
+	void Query(const CFrustum& frustum, std::vector<int>& results) const;
+	void Query(const CAABB& box, std::vector<int>& results) const;
+
+	// Visit every object whose fat box the ray passes through within maxDistance, nearest boxes first. The
+	// visitor is called as visitor(proxy, maxDistance) and returns the new maximum distance, e.g. the distance
+	// to an exact hit on the object, or maxDistance if it was missed. Return a negative value to stop
+	template <typename TVisitor>
+	void RayCast(const CRay& ray, float maxDistance, TVisitor visitor) const;
+
+	// Visit objects in order of distance from the point to their fat boxes, nearest first. The visitor is called
+	// as visitor(proxy, distanceSquared) and returns false to stop
+	template <typename TVisitor>
+	void Nearest(const CVector3& point, TVisitor visitor) const;
+
+
+private:
+	// A node is a leaf (an object, height 0) or has two children and a box around both
+	// Unused nodes are kept in a free list linked through their parent member
+	struct SNode
+	{
+		CAABB bounds;
+		void* userData;
+		int   parent;
+		int   child1;
+		int   child2;
+		int   height; // -1 for a free node
+		bool  IsLeaf() const { return child1 == NullProxy; }
+	};
+
+	// Get a node from the free list, growing the node array if necessary / return a node to the free list
+	int  AllocateNode();
+	void FreeNode(int node);
+
+	// Link a leaf into the tree / unlink it, without freeing it
+	void InsertLeaf(int leaf);
+	void RemoveLeaf(int leaf);
+
+	// Recalculate boxes and heights from the given node up to the root, rotating where unbalanced
+	void RefitAncestors(int node);
+
+	// Rotate the tree at the given node if its children's heights differ by more than one, returns the node
+	// now in its place
+	int Balance(int node);
+
+	// Queries use a fixed size stack. A depth first walk never holds more than height + 1 nodes and rebalancing
+	// keeps the height below 1.44 * log2(N), so this is far beyond any tree that fits in memory
+	static const int MaxStackSize = 256;
+
+	std::vector<SNode> mNodes;
+	int                mRoot = NullProxy;
+	int                mFreeList = NullProxy;
+	size_t             mNumProxies = 0;
+	float              mMargin;
+};
+
+
+/*-----------------------------------------------------------------------------------------
+	Template member functions
+-----------------------------------------------------------------------------------------*/
+
+// Visit every object whose fat box the ray passes through within maxDistance, nearest boxes first
+template <typename TVisitor>
+void CDynamicBVH::RayCast(const CRay& ray, float maxDistance, TVisitor visitor) const
+{
+	float distance;
+	if (mRoot == NullProxy || !Intersects(ray, mNodes[mRoot].bounds, maxDistance, distance)) return;
+
+	// Boxes are tested when pushed, so each entry holds the distance to its box. An entry further away than the
+	// nearest hit found since it was pushed is skipped
+	struct SEntry
+	{
+		int   node;
+		float distance;
+	};
+	SEntry stack[MaxStackSize];
+	int stackSize = 0;
+	stack[stackSize++] = { mRoot, distance };
+
+	while (stackSize > 0)
+	{
+		SEntry entry = stack[--stackSize];
+		if (entry.distance > maxDistance) continue;
+
+		const SNode& node = mNodes[entry.node];
+		if (node.IsLeaf())
+		{
+			maxDistance = visitor(entry.node, maxDistance);
+			if (maxDistance < 0.0f) return;
+			continue;
+		}
+
+		// Push the further child first so the nearer one is visited first
+		float distance1, distance2;
+		bool hit1 = Intersects(ray, mNodes[node.child1].bounds, maxDistance, distance1);
+		bool hit2 = Intersects(ray, mNodes[node.child2].bounds, maxDistance, distance2);
+		if (hit1 && hit2 && distance1 < distance2)
+		{
+			stack[stackSize++] = { node.child2, distance2 };
+			stack[stackSize++] = { node.child1, distance1 };
+		}
+		else
+		{
+			if (hit1) stack[stackSize++] = { node.child1, distance1 };
+			if (hit2) stack[stackSize++] = { node.child2, distance2 };
+		}
+	}
+}
+
+// Visit objects in order of distance from the point to their fat boxes, nearest first
+template <typename TVisitor>
+void CDynamicBVH::Nearest(const CVector3& point, TVisitor visitor) const
+{
+	if (mRoot == NullProxy) return;
+
+	// Best first search: a heap of nodes ordered by distance to their box. A node's box contains all the boxes
+	// below it, so when a leaf comes off the heap nothing left can be nearer
+	struct SEntry
+	{
+		float distanceSquared;
+		int   node;
+	};
+	auto further = [](const SEntry& a, const SEntry& b) { return a.distanceSquared > b.distanceSquared; };
+
+	std::vector<SEntry> heap;
+	heap.push_back({ DistanceSquared(mNodes[mRoot].bounds, point), mRoot });
+	while (!heap.empty())
+	{
+		std::pop_heap(heap.begin(), heap.end(), further);
+		SEntry entry = heap.back();
+		heap.pop_back();
+
+		const SNode& node = mNodes[entry.node];
+		if (node.IsLeaf())
+		{
+			if (!visitor(entry.node, entry.distanceSquared)) return;
+			continue;
+		}
+
+		heap.push_back({ DistanceSquared(mNodes[node.child1].bounds, point), node.child1 });
+		std::push_heap(heap.begin(), heap.end(), further);
+		heap.push_back({ DistanceSquared(mNodes[node.child2].bounds, point), node.child2 });
+		std::push_heap(heap.begin(), heap.end(), further);
+	}
+}
+
+} } //Namespaces
+#endif // _CDYNAMIC_BVH_H_DEFINED_
@@ -9,6 +9,7 @@
 #include "CVector3.hpp"
 
 #include <cmath>
+#include <cstring>
 #include <algorithm>
 
 //======================================================================================
@@ -18,7 +19,8 @@ namespace umbra_engine
 namespace maths
 {
 // Matrix class
-class CMatrix4x4
+// Aligned to 16 bytes so the SSE/AVX kernels (see MatrixKernels.hpp) can load whole rows efficiently
+class alignas(16) CMatrix4x4
 {
 	// Concrete class - public access
 public:
@@ -42,10 +44,10 @@ public:
 	CVector3 GetRow(int iRow) const;
 
 	// Helper functions
-	CVector3 GetXAxis() const { return GetRow(0); }
-	CVector3 GetYAxis() const { return GetRow(1); }
-	CVector3 GetZAxis() const { return GetRow(2); }
-	CVector3 GetPosition() const { return GetRow(3); }
+	constexpr CVector3 GetXAxis() const { return { e00, e01, e02 }; }
+	constexpr CVector3 GetYAxis() const { return { e10, e11, e12 }; }
+	constexpr CVector3 GetZAxis() const { return { e20, e21, e22 }; }
+	constexpr CVector3 GetPosition() const { return { e30, e31, e32 }; }
 
 	CVector3 GetScale() const { return { Length(GetXAxis()), Length(GetYAxis()) , Length(GetZAxis()) }; }
 
@@ -59,7 +61,7 @@ public:
 	void FaceTarget(const CVector3& target);
 
 	// Make this matrix the identity matrix
-	void MakeIdentity()
+	constexpr void MakeIdentity()
 	{
 		e00 = 1.0f;
 		e01 = 0.0f;
@@ -84,8 +86,8 @@ public:
 	//Flips matrix along diagonals
 	void Transpose();
 
-	// Initialise this matrix with a pointer to 16 floats 
-	void SetValues(float* matrixValues) { *this = *reinterpret_cast<CMatrix4x4*>(matrixValues); }
+	// Initialise this matrix with a pointer to 16 floats. The source doesn't need to be aligned
+	void SetValues(float* matrixValues) { std::memcpy(&e00, matrixValues, 16 * sizeof(float)); }
 };
 
 
@@ -104,12 +106,26 @@ CMatrix4x4 operator*(const CMatrix4x4& m1, const CMatrix4x4& m2);
 // The following functions create a matrix holding a particular transformation
 // They can be used as temporaries in calculations, e.g.
 //     CMatrix4x4 m = MatrixScaling( 3.0f ) * MatrixTranslation( CVector3(10.0f, -10.0f, 20.0f) );
+// The ones that don't need trig are constexpr, so constant matrices can be built at compile time, e.g.
+//     constexpr CMatrix4x4 m = MatrixTranslation( { 0.0f, 10.0f, 0.0f } );
 
 // Return an identity matrix
-CMatrix4x4 MatrixIdentity();
+constexpr CMatrix4x4 MatrixIdentity()
+{
+	return CMatrix4x4{ 1, 0, 0, 0,
+					   0, 1, 0, 0,
+					   0, 0, 1, 0,
+					   0, 0, 0, 1 };
+}
 
 // Return a translation matrix of the given vector
-CMatrix4x4 MatrixTranslation(const CVector3& t);
+constexpr CMatrix4x4 MatrixTranslation(const CVector3& t)
+{
+	return CMatrix4x4{ 1,   0,   0,  0,
+						 0,   1,   0,  0,
+						 0,   0,   1,  0,
+					   t.x, t.y, t.z,  1 };
+}
 
 
 // Return an X-axis rotation matrix of the given angle (in radians)
@@ -121,12 +137,39 @@ CMatrix4x4 MatrixRotationY(float y);
 // Return a Z-axis rotation matrix of the given angle (in radians)
 CMatrix4x4 MatrixRotationZ(float z);
 
+// Versions of the above using the fast SinCos (see FastTrig.hpp). Error is under 1e-7 for angles
+// within +-8192 radians - use when building many rotations each frame
+CMatrix4x4 MatrixRotationXFast(float x);
+CMatrix4x4 MatrixRotationYFast(float y);
+CMatrix4x4 MatrixRotationZFast(float z);
+
 
 // Return a matrix that is a scaling in X,Y and Z of the values in the given vector
-CMatrix4x4 MatrixScaling(const CVector3& s);
+constexpr CMatrix4x4 MatrixScaling(const CVector3& s)
+{
+	return CMatrix4x4{ s.x,   0,   0,  0,
+					   0,   s.y,   0,  0,
+					   0,     0, s.z,  0,
+					   0,     0,   0,  1 };
+}
 
 // Return a matrix that is a uniform scaling of the given amount
-CMatrix4x4 MatrixScaling(const float s);
+constexpr CMatrix4x4 MatrixScaling(const float s)
+{
+	return CMatrix4x4{ s, 0, 0, 0,
+					   0, s, 0, 0,
+					   0, 0, s, 0,
+					   0, 0, 0, 1 };
+}
+
+// Return the transpose of the given matrix (rows become columns)
+constexpr CMatrix4x4 MatrixTranspose(const CMatrix4x4& m)
+{
+	return CMatrix4x4{ m.e00, m.e10, m.e20, m.e30,
+					   m.e01, m.e11, m.e21, m.e31,
+					   m.e02, m.e12, m.e22, m.e32,
+					   m.e03, m.e13, m.e23, m.e33 };
+}
 
 // Test if a float value is approximately 0
 // Epsilon value is the range around zero that is considered equal to zero
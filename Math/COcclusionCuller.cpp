@@ -0,0 +1,385 @@
+//--------------------------------------------------------------------------------------
+// Software occlusion culling - rasterise occluders into a small depth buffer and test boxes against it
+//--------------------------------------------------------------------------------------
+// Pixels are sampled at their centres. A pixel keeps the nearest occluder depth, and a box is hidden if every
+// pixel its screen rectangle touches holds a depth in front of the nearest point of the box
+
+#include "COcclusionCuller.hpp"
+#include "WideFloat.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace umbra_engine
+{
+namespace maths
+{
+namespace
+{
+// Milliseconds since the given time
+inline float MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// Point on the line between two clip space vertices where z = 0 (the near clip plane)
+template <typename Vertex>
+inline Vertex NearPlaneIntersection(const Vertex& a, const Vertex& b)
+{
+	float t = a.z / (a.z - b.z);
+	return Vertex{ a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, 0.0f, a.w + (b.w - a.w) * t };
+}
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Constructors / Destructors
+-----------------------------------------------------------------------------------------*/
+
+// Construct with the given depth buffer size and number of worker threads
+COcclusionCuller::COcclusionCuller(int width /*= 256*/, int height /*= 128*/, int numThreads /*= -1*/)
+{
+	mTilesX = std::max(1, (width  + TileSize - 1) / TileSize);
+	mTilesY = std::max(1, (height + TileSize - 1) / TileSize);
+	mWidth  = mTilesX * TileSize;
+	mHeight = mTilesY * TileSize;
+	mDepth.assign(mWidth * mHeight, 1.0f);
+	mTileDepth.assign(mTilesX * mTilesY, 1.0f);
+
+	if (numThreads < 0)
+	{
+		int hardwareThreads = static_cast<int>(std::thread::hardware_concurrency());
+		numThreads = std::min(std::max(hardwareThreads - 1, 0), 3);
+	}
+
+	// Bands are whole rows of tiles so no two threads write to the same tile
+	mTileRowsPerBand = (mTilesY + numThreads) / (numThreads + 1);
+	mNumBands = (mTilesY + mTileRowsPerBand - 1) / mTileRowsPerBand;
+	for (int i = 1; i < mNumBands; ++i)
+	{
+		mWorkers.emplace_back(&COcclusionCuller::WorkerThread, this);
+	}
+}
+
+COcclusionCuller::~COcclusionCuller()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mQuit = true;
+	}
+	mStart.notify_all();
+	for (auto& worker : mWorkers)
+	{
+		worker.join();
+	}
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Member functions
+-----------------------------------------------------------------------------------------*/
+
+// Start a new frame viewed with the given view-projection matrix
+void COcclusionCuller::BeginFrame(const CMatrix4x4& viewProjection)
+{
+	mViewProjection = viewProjection;
+	mTriangles.clear();
+	std::fill(mDepth.begin(), mDepth.end(), 1.0f);
+	std::fill(mTileDepth.begin(), mTileDepth.end(), 1.0f);
+	mStats = SOcclusionStats();
+}
+
+// Transform, clip and set up the triangles of an occluder
+void COcclusionCuller::AddOccluder(const CVector3* positions, size_t stride, const uint32_t* indices, size_t numIndices,
+                                   const CMatrix4x4& worldMatrix)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	++mStats.numOccluders;
+
+	// Transform every vertex used to clip space. Indices may not use all the vertices, but occluders are whole
+	// meshes so they normally do
+	uint32_t numVertices = 0;
+	for (size_t i = 0; i < numIndices; ++i)
+	{
+		numVertices = std::max(numVertices, indices[i] + 1);
+	}
+	CMatrix4x4 m = worldMatrix * mViewProjection;
+	mClipVertices.resize(numVertices);
+	const char* vertexData = reinterpret_cast<const char*>(positions);
+	for (uint32_t i = 0; i < numVertices; ++i)
+	{
+		const CVector3& p = *reinterpret_cast<const CVector3*>(vertexData + i * stride);
+		mClipVertices[i] = SClipVertex{ p.x * m.e00 + p.y * m.e10 + p.z * m.e20 + m.e30,
+		                                p.x * m.e01 + p.y * m.e11 + p.z * m.e21 + m.e31,
+		                                p.x * m.e02 + p.y * m.e12 + p.z * m.e22 + m.e32,
+		                                p.x * m.e03 + p.y * m.e13 + p.z * m.e23 + m.e33 };
+	}
+
+	for (size_t i = 0; i + 2 < numIndices; i += 3)
+	{
+		const SClipVertex* v[3] = { &mClipVertices[indices[i]], &mClipVertices[indices[i + 1]], &mClipVertices[indices[i + 2]] };
+
+		// Skip triangles completely outside one of the frustum planes. The far plane is not tested, triangles
+		// beyond it are drawn but can't hide anything in front of it
+		if ((v[0]->x >  v[0]->w && v[1]->x >  v[1]->w && v[2]->x >  v[2]->w) ||
+		    (v[0]->x < -v[0]->w && v[1]->x < -v[1]->w && v[2]->x < -v[2]->w) ||
+		    (v[0]->y >  v[0]->w && v[1]->y >  v[1]->w && v[2]->y >  v[2]->w) ||
+		    (v[0]->y < -v[0]->w && v[1]->y < -v[1]->w && v[2]->y < -v[2]->w) ||
+		    (v[0]->z < 0 && v[1]->z < 0 && v[2]->z < 0))
+		{
+			continue;
+		}
+
+		// Clip against the near plane, leaving a triangle or a quad
+		int numBehind = (v[0]->z < 0) + (v[1]->z < 0) + (v[2]->z < 0);
+		if (numBehind == 0)
+		{
+			AddTriangle(*v[0], *v[1], *v[2]);
+			continue;
+		}
+
+		SClipVertex clipped[4];
+		int numClipped = 0;
+		for (int j = 0; j < 3; ++j)
+		{
+			const SClipVertex& a = *v[j];
+			const SClipVertex& b = *v[(j + 1) % 3];
+			if (a.z >= 0) clipped[numClipped++] = a;
+			if ((a.z < 0) != (b.z < 0)) clipped[numClipped++] = NearPlaneIntersection(a, b);
+		}
+		AddTriangle(clipped[0], clipped[1], clipped[2]);
+		if (numClipped == 4) AddTriangle(clipped[0], clipped[2], clipped[3]);
+	}
+
+	mStats.rasterisationTime += MillisecondsSince(start);
+}
+
+// Draw all the occluders added this frame into the depth buffer
+void COcclusionCuller::Rasterise()
+{
+	if (mTriangles.empty()) return;
+	auto start = std::chrono::high_resolution_clock::now();
+	mStats.numTriangles = static_cast<unsigned int>(mTriangles.size());
+
+	if (mNumBands > 1)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mNextBand = 1;
+			mBandsRemaining = mNumBands - 1;
+			++mGeneration;
+		}
+		mStart.notify_all();
+	}
+
+	RasteriseBand(0);
+
+	if (mNumBands > 1)
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		mFinished.wait(lock, [this] { return mBandsRemaining == 0; });
+	}
+
+	mStats.rasterisationTime += MillisecondsSince(start);
+}
+
+// Return true if the world space box is completely hidden behind the occluders
+bool COcclusionCuller::IsOccluded(const CAABB& box)
+{
+	++mStats.numTested;
+	if (box.IsEmpty()) return false;
+
+	// Project the corners to find the box's screen rectangle and nearest depth
+	const CMatrix4x4& m = mViewProjection;
+	float minX = mWidth, minY = mHeight, maxX = 0, maxY = 0, minDepth = 1.0f;
+	for (int corner = 0; corner < 8; ++corner)
+	{
+		CVector3 p{ (corner & 1) ? box.maximum.x : box.minimum.x,
+		            (corner & 2) ? box.maximum.y : box.minimum.y,
+		            (corner & 4) ? box.maximum.z : box.minimum.z };
+		float z = p.x * m.e02 + p.y * m.e12 + p.z * m.e22 + m.e32;
+		if (z < 0) return false; // In front of the near plane, the box surrounds or nearly touches the camera
+
+		float invW = 1.0f / (p.x * m.e03 + p.y * m.e13 + p.z * m.e23 + m.e33);
+		float x = ( (p.x * m.e00 + p.y * m.e10 + p.z * m.e20 + m.e30) * invW * 0.5f + 0.5f) * mWidth;
+		float y = (-(p.x * m.e01 + p.y * m.e11 + p.z * m.e21 + m.e31) * invW * 0.5f + 0.5f) * mHeight;
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		minDepth = std::min(minDepth, z * invW);
+	}
+	if (maxX < 0 || maxY < 0 || minX >= mWidth || minY >= mHeight) return false;
+
+	// Every pixel the rectangle touches
+	int pixelMinX = static_cast<int>(std::max(minX, 0.0f));
+	int pixelMinY = static_cast<int>(std::max(minY, 0.0f));
+	int pixelMaxX = static_cast<int>(std::min(maxX, mWidth - 1.0f));
+	int pixelMaxY = static_cast<int>(std::min(maxY, mHeight - 1.0f));
+
+	// Tiles whose furthest depth is in front of the box need no more work, otherwise check their pixels
+	for (int tileY = pixelMinY / TileSize; tileY <= pixelMaxY / TileSize; ++tileY)
+	{
+		for (int tileX = pixelMinX / TileSize; tileX <= pixelMaxX / TileSize; ++tileX)
+		{
+			if (mTileDepth[tileY * mTilesX + tileX] < minDepth) continue;
+
+			int x0 = std::max(pixelMinX, tileX * TileSize);
+			int x1 = std::min(pixelMaxX, tileX * TileSize + TileSize - 1);
+			int y0 = std::max(pixelMinY, tileY * TileSize);
+			int y1 = std::min(pixelMaxY, tileY * TileSize + TileSize - 1);
+			for (int y = y0; y <= y1; ++y)
+			{
+				const float* row = &mDepth[y * mWidth];
+				for (int x = x0; x <= x1; ++x)
+				{
+					if (row[x] >= minDepth) return false;
+				}
+			}
+		}
+	}
+
+	++mStats.numOccluded;
+	return true;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Private member functions
+-----------------------------------------------------------------------------------------*/
+
+// Set up a triangle from clip space vertices in front of the near plane
+void COcclusionCuller::AddTriangle(const SClipVertex& v0, const SClipVertex& v1, const SClipVertex& v2)
+{
+	// To pixel coordinates, y down the screen
+	float x[3], y[3], z[3];
+	const SClipVertex* v[3] = { &v0, &v1, &v2 };
+	for (int i = 0; i < 3; ++i)
+	{
+		float invW = 1.0f / v[i]->w;
+		x[i] = ( v[i]->x * invW * 0.5f + 0.5f) * mWidth;
+		y[i] = (-v[i]->y * invW * 0.5f + 0.5f) * mHeight;
+		z[i] = v[i]->z * invW;
+	}
+
+	// Pixels whose centres are inside the triangle's bounding rectangle
+	float minX = std::max(std::min({ x[0], x[1], x[2] }), 0.0f);
+	float maxX = std::min(std::max({ x[0], x[1], x[2] }), static_cast<float>(mWidth));
+	float minY = std::max(std::min({ y[0], y[1], y[2] }), 0.0f);
+	float maxY = std::min(std::max({ y[0], y[1], y[2] }), static_cast<float>(mHeight));
+	STriangle triangle;
+	triangle.minX = static_cast<int>(std::ceil(minX - 0.5f));
+	triangle.maxX = static_cast<int>(std::floor(maxX - 0.5f));
+	triangle.minY = static_cast<int>(std::ceil(minY - 0.5f));
+	triangle.maxY = static_cast<int>(std::floor(maxY - 0.5f));
+	if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) return;
+
+	// Twice the area, negative for triangles facing away. Both sides are drawn so flip those to face forwards
+	float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+	if (std::abs(area) < 1e-6f) return;
+	float sign = (area > 0) ? 1.0f : -1.0f;
+
+	// Edge i runs from vertex i to the next, its function is positive on the inside
+	for (int i = 0; i < 3; ++i)
+	{
+		int j = (i + 1) % 3;
+		triangle.edgeA[i] = sign * (y[i] - y[j]);
+		triangle.edgeB[i] = sign * (x[j] - x[i]);
+		triangle.edgeC[i] = sign * (x[i] * y[j] - y[i] * x[j]);
+	}
+
+	// Depth is linear in screen space after the divide by w
+	float invArea = 1.0f / area;
+	triangle.depthA = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) * invArea;
+	triangle.depthB = ((x[1] - x[0]) * (z[2] - z[0]) - (x[2] - x[0]) * (z[1] - z[0])) * invArea;
+	triangle.depthC = z[0] - triangle.depthA * x[0] - triangle.depthB * y[0];
+
+	mTriangles.push_back(triangle);
+}
+
+// Rasterise all triangles into the rows of the given band, then update the band's tile depths
+void COcclusionCuller::RasteriseBand(int band)
+{
+	int firstTileRow = band * mTileRowsPerBand;
+	int endTileRow = std::min(firstTileRow + mTileRowsPerBand, mTilesY);
+	int bandMinY = firstTileRow * TileSize;
+	int bandMaxY = endTileRow * TileSize - 1;
+
+	alignas(16) static const float laneOffsets[4] = { 0.5f, 1.5f, 2.5f, 3.5f };
+	const CFloat4 offsets = CFloat4::Load(laneOffsets);
+	const CFloat4 zero(0.0f);
+
+	for (const auto& triangle : mTriangles)
+	{
+		int minY = std::max(triangle.minY, bandMinY);
+		int maxY = std::min(triangle.maxY, bandMaxY);
+		if (minY > maxY) continue;
+
+		// Work in groups of 4 pixels. The width is a whole number of tiles so groups never pass the end of a
+		// row, and pixels in a group outside the triangle's rectangle are outside the triangle too
+		int minX = triangle.minX & ~3;
+		CFloat4 a0(triangle.edgeA[0]), a1(triangle.edgeA[1]), a2(triangle.edgeA[2]);
+		CFloat4 depthA(triangle.depthA);
+		for (int y = minY; y <= maxY; ++y)
+		{
+			float pixelY = y + 0.5f;
+			CFloat4 c0(triangle.edgeB[0] * pixelY + triangle.edgeC[0]);
+			CFloat4 c1(triangle.edgeB[1] * pixelY + triangle.edgeC[1]);
+			CFloat4 c2(triangle.edgeB[2] * pixelY + triangle.edgeC[2]);
+			CFloat4 depthC(triangle.depthB * pixelY + triangle.depthC);
+
+			float* row = &mDepth[y * mWidth];
+			for (int x = minX; x <= triangle.maxX; x += 4)
+			{
+				CFloat4 pixelX = CFloat4(static_cast<float>(x)) + offsets;
+				CFloat4 inside = (a0 * pixelX + c0 >= zero) & (a1 * pixelX + c1 >= zero) & (a2 * pixelX + c2 >= zero);
+				if (BitMask(inside) == 0) continue;
+
+				CFloat4 depth = CFloat4::Load(row + x);
+				Select(inside, Min(depth, depthA * pixelX + depthC), depth).Store(row + x);
+			}
+		}
+	}
+
+	// Furthest depth in each tile of the band
+	for (int tileY = firstTileRow; tileY < endTileRow; ++tileY)
+	{
+		for (int tileX = 0; tileX < mTilesX; ++tileX)
+		{
+			const float* pixels = &mDepth[tileY * TileSize * mWidth + tileX * TileSize];
+			CFloat4 furthest(0.0f);
+			for (int y = 0; y < TileSize; ++y, pixels += mWidth)
+			{
+				furthest = Max(furthest, Max(CFloat4::Load(pixels), CFloat4::Load(pixels + 4)));
+			}
+			alignas(16) float lanes[4];
+			furthest.Store(lanes);
+			mTileDepth[tileY * mTilesX + tileX] = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+		}
+	}
+}
+
+// Worker thread main loop, rasterises one band each time Rasterise is called
+void COcclusionCuller::WorkerThread()
+{
+	unsigned int generation = 0;
+	for (;;)
+	{
+		int band;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mStart.wait(lock, [&] { return mQuit || mGeneration != generation; });
+			if (mQuit) return;
+			generation = mGeneration;
+			band = mNextBand++;
+		}
+
+		RasteriseBand(band);
+
+		std::lock_guard<std::mutex> lock(mMutex);
+		if (--mBandsRemaining == 0) mFinished.notify_one();
+	}
+}
+
+} } //Namespaces
@@ -0,0 +1,145 @@
+//--------------------------------------------------------------------------------------
+// Software occlusion culling - rasterise occluders into a small depth buffer and test boxes against it
+//--------------------------------------------------------------------------------------
+// Code in .cpp file
+// Each frame a few large models (buildings, terrain features) are chosen as occluders and their triangles are
+// rasterised on the CPU into a low resolution depth buffer. The bounding box of each candidate model is then
+// tested against that buffer, and models completely hidden behind the occluders need not be sent to the GPU
+// The depth buffer is split into 8x8 pixel tiles that also store the furthest depth in the tile, so most boxes
+// are accepted or rejected by looking at a few tiles rather than every pixel they cover. Rasterisation works on
+// 4 pixels at a time (see WideFloat.hpp) and is split into horizontal bands run on worker threads
+// Depths are post-projection z/w values as used by D3D (0 at the near clip plane, 1 at the far)
+// No graphics API is used, so this can run in tools and tests without a window
+
+#ifndef _COCCLUSION_CULLER_H_DEFINED_
+#define _COCCLUSION_CULLER_H_DEFINED_
+
+#include "Geometry.hpp"
+#include "CMatrix4x4.hpp"
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <cstddef>
+
+namespace umbra_engine
+{
+namespace maths
+{
+
+// Work done by the culler since the last BeginFrame
+struct SOcclusionStats
+{
+	unsigned int numOccluders      = 0; // Calls to AddOccluder
+	unsigned int numTriangles      = 0; // Occluder triangles rasterised (after clipping away those off screen)
+	unsigned int numTested         = 0; // Calls to IsOccluded
+	unsigned int numOccluded       = 0; // Boxes found to be hidden
+	float        rasterisationTime = 0; // Milliseconds spent in AddOccluder and Rasterise
+};
+
+class COcclusionCuller
+{
+public:
+	/*-----------------------------------------------------------------------------------------
+		Constructors / Destructors
+	-----------------------------------------------------------------------------------------*/
+
+	// Construct with the given depth buffer size, rounded up to whole tiles. Rasterisation uses the calling
+	// thread and numThreads worker threads, -1 picks a number from the hardware (leaving a core for rendering)
+	explicit COcclusionCuller(int width = 256, int height = 128, int numThreads = -1);
+	~COcclusionCuller();
+
+	// Owns threads, so no copying
+	COcclusionCuller(const COcclusionCuller&) = delete;
+	COcclusionCuller& operator=(const COcclusionCuller&) = delete;
+
+
+	/*-----------------------------------------------------------------------------------------
+		Member functions
+	-----------------------------------------------------------------------------------------*/
+
+	// Start a new frame viewed with the given view-projection matrix. Clears the occluders and the statistics
+	void BeginFrame(const CMatrix4x4& viewProjection);
+
+	// Add the triangles of an occluder from an indexed triangle list in model space (three indices per triangle),
+	// positions are read stride bytes apart. Both sides of each triangle occlude, so meshes needn't be closed
+	// Triangles are transformed and clipped here, but not drawn until Rasterise
+	void AddOccluder(const CVector3* positions, size_t stride, const uint32_t* indices, size_t numIndices,
+	                 const CMatrix4x4& worldMatrix);
+
+	// Draw all the occluders added this frame into the depth buffer. Must be called before IsOccluded
+	void Rasterise();
+
+	// Return true if the world space box is completely hidden behind the occluders. Boxes crossing the near clip
+	// plane or off screen are never hidden. Updates the statistics so must not be called from several threads
+	bool IsOccluded(const CAABB& box);
+
+	// Statistics for the current frame
+	const SOcclusionStats& Stats() const { return mStats; }
+
+	// Access the depth buffer, e.g. to display it for debugging. Row major, Width() floats per row
+	int          Width() const       { return mWidth; }
+	int          Height() const      { return mHeight; }
+	const float* DepthBuffer() const { return mDepth.data(); }
+
+
+private:
+	// Occluder triangle set up for rasterising: three edge functions (a * x + b * y + c, all >= 0 inside),
+	// the depth plane (depth = a * x + b * y + c) and the pixel rectangle it covers
+	struct STriangle
+	{
+		float edgeA[3];
+		float edgeB[3];
+		float edgeC[3];
+		float depthA, depthB, depthC;
+		int   minX, minY, maxX, maxY;
+	};
+
+	// Clip space vertex
+	struct SClipVertex
+	{
+		float x, y, z, w;
+	};
+
+	// Set up a triangle from clip space vertices in front of the near plane, adding it if it covers any pixels
+	void AddTriangle(const SClipVertex& v0, const SClipVertex& v1, const SClipVertex& v2);
+
+	// Rasterise all triangles into the rows of the given band, then update the band's tile depths
+	void RasteriseBand(int band);
+
+	// Worker thread main loop
+	void WorkerThread();
+
+	static const int TileSize = 8;
+
+	int mWidth;
+	int mHeight;
+	int mTilesX;
+	int mTilesY;
+
+	std::vector<float>       mDepth;     // Nearest occluder depth at each pixel
+	std::vector<float>       mTileDepth; // Furthest depth in each tile
+	std::vector<STriangle>   mTriangles;
+	std::vector<SClipVertex> mClipVertices; // Working memory for AddOccluder
+
+	CMatrix4x4      mViewProjection;
+	SOcclusionStats mStats;
+
+	// Rasterisation is split into bands of whole tile rows. The calling thread does band 0 and each worker does
+	// one of the rest. Workers wait for mGeneration to change, then count down mBandsRemaining when finished
+	int                      mNumBands;
+	int                      mTileRowsPerBand;
+	std::vector<std::thread> mWorkers;
+	std::mutex               mMutex;
+	std::condition_variable  mStart;
+	std::condition_variable  mFinished;
+	unsigned int             mGeneration = 0;
+	int                      mNextBand = 0;
+	int                      mBandsRemaining = 0;
+	bool                     mQuit = false;
+};
+
+} } //Namespaces
+#endif // _COCCLUSION_CULLER_H_DEFINED_
@@ -0,0 +1,268 @@
+//--------------------------------------------------------------------------------------
+// Quadtree texture atlas - square power of two tiles of one large texture handed out to keys each frame
+//--------------------------------------------------------------------------------------
+
+#include "CQuadtreeAtlas.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace umbra_engine
+{
+namespace maths
+{
+namespace
+{
+// A key only changes tile size when its ideal size is this far (as a power of two) from its tile's size. Sizes
+// are otherwise rounded to the nearest power of two, so this stops keys near halfway flipping between two sizes
+const float ResizeThreshold = 0.75f;
+
+// Return the largest power of two not greater than the value (at least 1)
+int FloorPowerOfTwo(int value)
+{
+	int result = 1;
+	while (result * 2 <= value) result *= 2;
+	return result;
+}
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Constructors
+-----------------------------------------------------------------------------------------*/
+
+// Construct an empty atlas
+CQuadtreeAtlas::CQuadtreeAtlas(int size /*= 8192*/, int minTileSize /*= 128*/)
+{
+	mSize = FloorPowerOfTwo(std::max(size, 2));
+	minTileSize = std::min(FloorPowerOfTwo(std::max(minTileSize, 1)), mSize / 2);
+	mMaxLevel = 0;
+	while ((mSize >> mMaxLevel) > minTileSize) ++mMaxLevel;
+
+	mNodes.assign(FirstNode(mMaxLevel + 1), ENodeState::Free);
+	mFreeNodes.resize(mMaxLevel + 1);
+	mFreeNodes[0].insert(0);
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Member functions
+-----------------------------------------------------------------------------------------*/
+
+// Start collecting requests for a new frame
+void CQuadtreeAtlas::BeginFrame()
+{
+	mRequests.clear();
+}
+
+// Request a tile for a key this frame
+void CQuadtreeAtlas::Request(int key, float idealSize)
+{
+	mRequests.push_back({ key, idealSize });
+}
+
+// Give tiles to the keys requested since BeginFrame
+void CQuadtreeAtlas::Allocate()
+{
+	mStats = SAtlasStats();
+	mStats.numRequested = static_cast<unsigned int>(mRequests.size());
+
+	// Keys not requested this frame give up their tiles
+	for (auto it = mAllocations.begin(); it != mAllocations.end(); )
+	{
+		bool requested = std::any_of(mRequests.begin(), mRequests.end(), [&](const SRequest& r) { return r.key == it->first; });
+		if (requested)
+		{
+			it->second.changed = false;
+			++it;
+		}
+		else
+		{
+			FreeNode(it->second.node);
+			it = mAllocations.erase(it);
+		}
+	}
+
+	// Keys near their tile's size keep it. Keys that need a smaller tile give theirs up now so the space can be
+	// reused. Keys that need a larger tile keep theirs until they get the larger one
+	struct SPending
+	{
+		int key;
+		int level;
+	};
+	std::vector<SPending> pending;
+	for (const auto& request : mRequests)
+	{
+		int level = LevelForSize(request.idealSize);
+		auto allocation = mAllocations.find(request.key);
+		if (allocation != mAllocations.end())
+		{
+			int currentLevel = NodeLevel(allocation->second.node);
+			float clampedSize = std::min(std::max(request.idealSize, static_cast<float>(MinTileSize())), mSize * 0.5f);
+			float difference = std::log2(clampedSize / static_cast<float>(mSize >> currentLevel));
+			if (level == currentLevel || std::abs(difference) < ResizeThreshold) continue;
+			if (level > currentLevel)
+			{
+				FreeNode(allocation->second.node);
+				mAllocations.erase(allocation);
+			}
+		}
+		pending.push_back({ request.key, level });
+	}
+
+	// Place the largest tiles first, they need the largest free blocks
+	std::stable_sort(pending.begin(), pending.end(), [](const SPending& a, const SPending& b) { return a.level < b.level; });
+	for (const auto& request : pending)
+	{
+		auto previous = mAllocations.find(request.key);
+		int node = AllocateNode(request.level);
+		if (node == -1 && previous != mAllocations.end())
+		{
+			// No room to grow, stay as it is
+			++mStats.numShrunk;
+			continue;
+		}
+
+		// Out of room, try smaller tiles
+		int level = request.level;
+		while (node == -1 && level < mMaxLevel)
+		{
+			node = AllocateNode(++level);
+		}
+		if (node == -1)
+		{
+			++mStats.numFailed;
+			continue;
+		}
+		if (level != request.level) ++mStats.numShrunk;
+
+		if (previous != mAllocations.end()) FreeNode(previous->second.node);
+		mAllocations[request.key] = { node, true };
+	}
+
+	// Statistics
+	long long totalArea = static_cast<long long>(mSize) * mSize;
+	long long usedArea = 0;
+	for (const auto& allocation : mAllocations)
+	{
+		int tileSize = mSize >> NodeLevel(allocation.second.node);
+		usedArea += static_cast<long long>(tileSize) * tileSize;
+		if (allocation.second.changed) ++mStats.numChanged;
+	}
+	mStats.numTiles = static_cast<unsigned int>(mAllocations.size());
+	mStats.occupancy = static_cast<float>(usedArea) / totalArea;
+
+	long long freeArea = totalArea - usedArea;
+	for (int level = 0; level <= mMaxLevel; ++level)
+	{
+		if (mFreeNodes[level].empty()) continue;
+		long long largestFree = static_cast<long long>(mSize >> level) * (mSize >> level);
+		mStats.fragmentation = 1.0f - static_cast<float>(largestFree) / freeArea;
+		break;
+	}
+}
+
+// Get the tile given to a key by the last Allocate
+bool CQuadtreeAtlas::GetTile(int key, SAtlasTile& tile) const
+{
+	auto allocation = mAllocations.find(key);
+	if (allocation == mAllocations.end()) return false;
+	tile = NodeTile(allocation->second.node);
+	return true;
+}
+
+// True if the key's tile changed in the last Allocate
+bool CQuadtreeAtlas::TileChanged(int key) const
+{
+	auto allocation = mAllocations.find(key);
+	return allocation != mAllocations.end() && allocation->second.changed;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Private member functions
+-----------------------------------------------------------------------------------------*/
+
+// Level a node is on
+int CQuadtreeAtlas::NodeLevel(int node) const
+{
+	int level = 0;
+	while (node >= FirstNode(level + 1)) ++level;
+	return level;
+}
+
+// Area of the atlas covered by a node. The index of a node within its level has two bits per level below the
+// root, the quarter chosen at each level (bit 0 right, bit 1 lower), with the root's choice in the highest bits
+SAtlasTile CQuadtreeAtlas::NodeTile(int node) const
+{
+	int level = NodeLevel(node);
+	int index = node - FirstNode(level);
+	SAtlasTile tile{ 0, 0, mSize >> level };
+	for (int bit = 0; bit < level; ++bit)
+	{
+		int quarter = (index >> (2 * bit)) & 3;
+		tile.x += (quarter & 1) * (tile.size << bit);
+		tile.y += (quarter >> 1) * (tile.size << bit);
+	}
+	return tile;
+}
+
+// Take a free node at the given level, splitting larger ones if necessary
+int CQuadtreeAtlas::AllocateNode(int level)
+{
+	if (mFreeNodes[level].empty())
+	{
+		if (level == 0) return -1;
+		int parent = AllocateNode(level - 1);
+		if (parent == -1) return -1;
+
+		mNodes[parent] = ENodeState::Split;
+		for (int child = 4 * parent + 1; child <= 4 * parent + 4; ++child)
+		{
+			mNodes[child] = ENodeState::Free;
+			mFreeNodes[level].insert(child);
+		}
+	}
+
+	int node = *mFreeNodes[level].begin();
+	mFreeNodes[level].erase(mFreeNodes[level].begin());
+	mNodes[node] = ENodeState::Used;
+	return node;
+}
+
+// Return a node to the free nodes, merging it with its siblings when they are all free
+void CQuadtreeAtlas::FreeNode(int node)
+{
+	mNodes[node] = ENodeState::Free;
+	int level = NodeLevel(node);
+	while (level > 0)
+	{
+		int parent = (node - 1) / 4;
+		int firstChild = 4 * parent + 1;
+		bool allFree = true;
+		for (int child = firstChild; child < firstChild + 4; ++child)
+		{
+			allFree = allFree && mNodes[child] == ENodeState::Free;
+		}
+		if (!allFree) break;
+
+		for (int child = firstChild; child < firstChild + 4; ++child)
+		{
+			mFreeNodes[level].erase(child);
+		}
+		mNodes[parent] = ENodeState::Free;
+		node = parent;
+		--level;
+	}
+	mFreeNodes[level].insert(node);
+}
+
+// Level of the tile for an ideal size, between half the atlas (level 1) and the smallest tiles
+int CQuadtreeAtlas::LevelForSize(float idealSize) const
+{
+	float levels = std::log2(static_cast<float>(mSize) / std::max(idealSize, 1.0f));
+	int level = static_cast<int>(std::floor(levels + 0.5f));
+	return std::min(std::max(level, std::min(1, mMaxLevel)), mMaxLevel);
+}
+
+} } //Namespaces
@@ -0,0 +1,127 @@
+//--------------------------------------------------------------------------------------
+// Quadtree texture atlas - square power of two tiles of one large texture handed out to keys each frame
+//--------------------------------------------------------------------------------------
+// Code in .cpp file
+// The atlas is a quadtree: the whole texture is split into four, each quarter into four and so on down to the
+// smallest tile size. A tile is a free or used node, and a free node is split when a smaller tile is needed.
+// When the four quarters of a node are all free again they merge back into one free node
+// Each frame the user requests a tile for every key (e.g. a light) with the resolution it would ideally have.
+// Keys keep the same tile from frame to frame until their ideal resolution moves well away from the tile's size,
+// so tiles aren't reallocated (and their contents rendered again) for small changes. Keys not requested in a
+// frame give up their tile. Larger tiles are placed first, which keeps free space in large blocks
+// No graphics API is used, the user renders into the tiles
+
+#ifndef _CQUADTREE_ATLAS_H_DEFINED_
+#define _CQUADTREE_ATLAS_H_DEFINED_
+
+#include <vector>
+#include <set>
+#include <map>
+#include <cstdint>
+
+namespace umbra_engine
+{
+namespace maths
+{
+
+// A square area of the atlas in texels, from (x, y) to (x + size, y + size)
+struct SAtlasTile
+{
+	int x;
+	int y;
+	int size;
+};
+
+// Allocation in the last call to Allocate
+struct SAtlasStats
+{
+	unsigned int numRequested  = 0; // Calls to Request
+	unsigned int numTiles      = 0; // Keys given a tile
+	unsigned int numChanged    = 0; // Keys given a different tile from the frame before (including new keys)
+	unsigned int numFailed     = 0; // Keys given no tile as the atlas was full
+	unsigned int numShrunk     = 0; // Keys given a smaller tile than they asked for as the atlas was full
+	float        occupancy     = 0; // Fraction of the atlas in use
+	float        fragmentation = 0; // 0 if all free space is one tile, towards 1 as it is split into smaller tiles
+};
+
+class CQuadtreeAtlas
+{
+public:
+	/*-----------------------------------------------------------------------------------------
+		Constructors
+	-----------------------------------------------------------------------------------------*/
+
+	// Construct an empty atlas of the given size with tiles down to minTileSize. Both are rounded to powers of two
+	explicit CQuadtreeAtlas(int size = 8192, int minTileSize = 128);
+
+
+	/*-----------------------------------------------------------------------------------------
+		Member functions
+	-----------------------------------------------------------------------------------------*/
+
+	// Start collecting requests for a new frame
+	void BeginFrame();
+
+	// Request a tile for a key this frame. The ideal size in texels is rounded to a power of two between the
+	// smallest tile and half the atlas
+	void Request(int key, float idealSize);
+
+	// Give tiles to the keys requested since BeginFrame. Keys that kept their tile size keep the same tile
+	void Allocate();
+
+	// Get the tile given to a key by the last Allocate, returns false if it has none
+	bool GetTile(int key, SAtlasTile& tile) const;
+
+	// True if the key's tile is not the one it had before the last Allocate, so its contents must be rendered
+	bool TileChanged(int key) const;
+
+	// Atlas size in texels and statistics for the last Allocate
+	int                Size() const        { return mSize; }
+	int                MinTileSize() const { return mSize >> mMaxLevel; }
+	const SAtlasStats& Stats() const       { return mStats; }
+
+
+private:
+	enum class ENodeState : uint8_t { Free, Split, Used };
+
+	struct SRequest
+	{
+		int   key;
+		float idealSize;
+	};
+
+	struct SAllocation
+	{
+		int  node;
+		bool changed;
+	};
+
+	// Nodes are stored level by level (level 0 is the whole atlas, level 1 its quarters...), the children of node
+	// n are nodes 4n + 1 to 4n + 4
+	int FirstNode(int level) const { return static_cast<int>(((1u << (2 * level)) - 1) / 3); }
+	int NodeLevel(int node) const;
+	SAtlasTile NodeTile(int node) const;
+
+	// Take a free node at the given level, splitting larger ones if necessary. Returns -1 if there are none
+	int AllocateNode(int level);
+
+	// Return a node to the free nodes, merging it with its siblings when they are all free
+	void FreeNode(int node);
+
+	// Level of the tile for an ideal size
+	int LevelForSize(float idealSize) const;
+
+	int mSize;
+	int mMaxLevel; // Level of the smallest tiles
+
+	std::vector<ENodeState>    mNodes;
+	std::vector<std::set<int>> mFreeNodes; // Free nodes at each level, lowest first so tiles pack together
+
+	std::vector<SRequest>      mRequests;
+	std::map<int, SAllocation> mAllocations; // By key
+
+	SAtlasStats mStats;
+};
+
+} } //Namespaces
+#endif // _CQUADTREE_ATLAS_H_DEFINED_
@@ -0,0 +1,204 @@
+//--------------------------------------------------------------------------------------
+// Quaternion class, to hold rotations
+//--------------------------------------------------------------------------------------
+
+#include "CQuaternion.hpp"
+#include "MathHelpers.hpp"
+#include "FastTrig.hpp"
+
+namespace umbra_engine
+{
+namespace maths
+{
+/*-----------------------------------------------------------------------------------------
+	Operators
+-----------------------------------------------------------------------------------------*/
+
+// Follow this rotation by the given one
+CQuaternion& CQuaternion::operator*= (const CQuaternion& q)
+{
+	*this = *this * q;
+	return *this;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Non-member functions
+-----------------------------------------------------------------------------------------*/
+
+// Return an X-axis rotation of the given angle (in radians)
+CQuaternion QuaternionRotationX(float x)
+{
+	return CQuaternion{ std::sin(x * 0.5f), 0.0f, 0.0f, std::cos(x * 0.5f) };
+}
+
+// Return a Y-axis rotation of the given angle (in radians)
+CQuaternion QuaternionRotationY(float y)
+{
+	return CQuaternion{ 0.0f, std::sin(y * 0.5f), 0.0f, std::cos(y * 0.5f) };
+}
+
+// Return a Z-axis rotation of the given angle (in radians)
+CQuaternion QuaternionRotationZ(float z)
+{
+	return CQuaternion{ 0.0f, 0.0f, std::sin(z * 0.5f), std::cos(z * 0.5f) };
+}
+
+// Return a rotation of the given angle (in radians) around the given axis, which must be normalised
+CQuaternion QuaternionRotationAxis(const CVector3& axis, float angle)
+{
+	float s = std::sin(angle * 0.5f);
+	return CQuaternion{ axis.x * s, axis.y * s, axis.z * s, std::cos(angle * 0.5f) };
+}
+
+// Return the rotation given by Euler angles in radians. Z first, then X, then Y
+CQuaternion QuaternionFromEuler(const CVector3& angles)
+{
+	return QuaternionRotationZ(angles.z) * QuaternionRotationX(angles.x) * QuaternionRotationY(angles.y);
+}
+
+// Same as QuaternionFromEuler, with the three sin/cos pairs calculated together
+CQuaternion QuaternionFromEulerFast(const CVector3& angles)
+{
+	const float halfAngles[4] = { angles.x * 0.5f, angles.y * 0.5f, angles.z * 0.5f, 0.0f };
+	float s[4], c[4];
+	SinCos4(halfAngles, s, c);
+
+	return CQuaternion{ 0.0f, 0.0f, s[2], c[2] } * CQuaternion{ s[0], 0.0f, 0.0f, c[0] } * CQuaternion{ 0.0f, s[1], 0.0f, c[1] };
+}
+
+// Return the rotation held in the upper-left 3x3 of the given matrix, which must not contain any scaling
+// Works from the largest of the diagonal / trace to avoid dividing by small numbers
+CQuaternion QuaternionFromMatrix(const CMatrix4x4& m)
+{
+	float trace = m.e00 + m.e11 + m.e22;
+	if (trace > 0.0f)
+	{
+		float s = 0.5f / std::sqrt(trace + 1.0f);
+		return CQuaternion{ (m.e12 - m.e21) * s, (m.e20 - m.e02) * s, (m.e01 - m.e10) * s, 0.25f / s };
+	}
+	else if (m.e00 > m.e11 && m.e00 > m.e22)
+	{
+		float s = 0.5f / std::sqrt(1.0f + m.e00 - m.e11 - m.e22);
+		return CQuaternion{ 0.25f / s, (m.e10 + m.e01) * s, (m.e20 + m.e02) * s, (m.e12 - m.e21) * s };
+	}
+	else if (m.e11 > m.e22)
+	{
+		float s = 0.5f / std::sqrt(1.0f + m.e11 - m.e00 - m.e22);
+		return CQuaternion{ (m.e10 + m.e01) * s, 0.25f / s, (m.e21 + m.e12) * s, (m.e20 - m.e02) * s };
+	}
+	else
+	{
+		float s = 0.5f / std::sqrt(1.0f + m.e22 - m.e00 - m.e11);
+		return CQuaternion{ (m.e20 + m.e02) * s, (m.e21 + m.e12) * s, 0.25f / s, (m.e01 - m.e10) * s };
+	}
+}
+
+// Return the rotation that turns the world axes onto the given ones, which must be orthonormal
+CQuaternion QuaternionFromAxes(const CVector3& axisX, const CVector3& axisY, const CVector3& axisZ)
+{
+	CMatrix4x4 m;
+	m.SetRow(0, axisX);
+	m.SetRow(1, axisY);
+	m.SetRow(2, axisZ);
+	return QuaternionFromMatrix(m);
+}
+
+// Return the Euler angles (Z, then X, then Y) for the given rotation
+// Same calculation as extracting angles from a matrix, only the matrix elements needed are calculated
+CVector3 EulerAngles(const CQuaternion& q)
+{
+	float sX = -2.0f * (q.y * q.z - q.w * q.x); // -e21
+	if (sX > 1.0f)  sX = 1.0f;
+	if (sX < -1.0f) sX = -1.0f;
+	float cX = std::sqrt(1.0f - sX * sX);
+
+	// If no gimbal lock...
+	if (std::abs(cX) > 0.001f)
+	{
+		// atan2 only needs the ratio of sin and cos, so no need to divide by cX
+		float sZ = 2.0f * (q.x * q.y + q.w * q.z);         // e01
+		float cZ = 1.0f - 2.0f * (q.x * q.x + q.z * q.z);  // e11
+		float sY = 2.0f * (q.x * q.z + q.w * q.y);         // e20
+		float cY = 1.0f - 2.0f * (q.x * q.x + q.y * q.y);  // e22
+		return CVector3{ std::atan2(sX, cX), std::atan2(sY, cY), std::atan2(sZ, cZ) };
+	}
+	else
+	{
+		// Gimbal lock - force Z angle to 0
+		float sY = -2.0f * (q.x * q.z - q.w * q.y);        // -e02
+		float cY = 1.0f - 2.0f * (q.y * q.y + q.z * q.z);  // e00
+		return CVector3{ std::atan2(sX, cX), std::atan2(sY, cY), 0.0f };
+	}
+}
+
+// Returns length of a quaternion
+float Length(const CQuaternion& q)
+{
+	return std::sqrt(Dot(q, q));
+}
+
+// Return unit length quaternion holding the same rotation
+CQuaternion Normalise(const CQuaternion& q)
+{
+	float lengthSq = Dot(q, q);
+
+	// Ensure quaternion is not zero length, return no rotation if it is
+	if (IsZero(lengthSq))
+	{
+		return QuaternionIdentity();
+	}
+	else
+	{
+		float invLength = InvSqrt(lengthSq);
+		return CQuaternion{ q.x * invLength, q.y * invLength, q.z * invLength, q.w * invLength };
+	}
+}
+
+// Return the opposite rotation. Works for quaternions of any length
+CQuaternion Inverse(const CQuaternion& q)
+{
+	float invLengthSq = 1.0f / Dot(q, q);
+	return CQuaternion{ -q.x * invLengthSq, -q.y * invLengthSq, -q.z * invLengthSq, q.w * invLengthSq };
+}
+
+// Rotate a vector by a normalised quaternion: v + w*t + (q x t) where t = 2 * (q x v)
+CVector3 Rotate(const CQuaternion& q, const CVector3& v)
+{
+	CVector3 u{ q.x, q.y, q.z };
+	CVector3 t = Cross(u, v) * 2.0f;
+	return v + t * q.w + Cross(u, t);
+}
+
+// Spherical linear interpolation between two rotations (t from 0 to 1), takes the shortest path
+CQuaternion Slerp(const CQuaternion& q1, const CQuaternion& q2, float t)
+{
+	// q and -q are the same rotation, flip one if needed so we go the short way round
+	float cosAngle = Dot(q1, q2);
+	CQuaternion q2Near = q2;
+	if (cosAngle < 0.0f)
+	{
+		cosAngle = -cosAngle;
+		q2Near = CQuaternion{ -q2.x, -q2.y, -q2.z, -q2.w };
+	}
+
+	float t1, t2;
+	if (cosAngle > 0.9995f)
+	{
+		// Very close together, linear interpolation is accurate enough and avoids dividing by ~0
+		t1 = 1.0f - t;
+		t2 = t;
+	}
+	else
+	{
+		float angle = std::acos(cosAngle);
+		float invSin = 1.0f / std::sin(angle);
+		t1 = std::sin((1.0f - t) * angle) * invSin;
+		t2 = std::sin(t * angle) * invSin;
+	}
+
+	return Normalise(CQuaternion{ q1.x * t1 + q2Near.x * t2, q1.y * t1 + q2Near.y * t2,
+	                              q1.z * t1 + q2Near.z * t2, q1.w * t1 + q2Near.w * t2 });
+}
+
+} } //Namespaces
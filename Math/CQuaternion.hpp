@@ -0,0 +1,150 @@
+//--------------------------------------------------------------------------------------
+// Quaternion class, to hold rotations
+//--------------------------------------------------------------------------------------
+// Code in .cpp file
+// Quaternions follow the same conventions as the matrices in this app: q1 * q2 is the rotation q1
+// followed by q2, so MatrixRotation(q1 * q2) == MatrixRotation(q1) * MatrixRotation(q2)
+
+#ifndef _CQUATERNION_H_DEFINED_
+#define _CQUATERNION_H_DEFINED_
+
+#include "CVector3.hpp"
+#include "CMatrix4x4.hpp"
+
+#include <cmath>
+namespace umbra_engine
+{
+namespace maths
+{
+
+class CQuaternion
+{
+	// Concrete class - public access
+public:
+	// Quaternion components, x,y,z is the vector part, w the scalar part
+	float x;
+	float y;
+	float z;
+	float w;
+
+	/*-----------------------------------------------------------------------------------------
+		Constructors
+	-----------------------------------------------------------------------------------------*/
+
+	// Default constructor - leaves values uninitialised (for performance)
+	CQuaternion() {}
+
+	// Construct with 4 values
+	constexpr CQuaternion(const float xIn, const float yIn, const float zIn, const float wIn)
+		: x(xIn), y(yIn), z(zIn), w(wIn) {}
+
+
+	/*-----------------------------------------------------------------------------------------
+		Member functions
+	-----------------------------------------------------------------------------------------*/
+
+	// Follow this rotation by the given one, e.g. Orientation *= QuaternionRotationY(angle)
+	CQuaternion& operator*= (const CQuaternion& q);
+};
+
+
+/*-----------------------------------------------------------------------------------------
+	Non-member operators
+-----------------------------------------------------------------------------------------*/
+
+// The trig-free operators and functions are constexpr so constant rotations can be built at compile time
+
+// Combine two rotations, q1 first then q2 (same order as matrices)
+// Matrices in this app transform row vectors, so this is the standard (Hamilton) product q2 * q1
+constexpr CQuaternion operator* (const CQuaternion& q1, const CQuaternion& q2)
+{
+	return CQuaternion{ q2.w * q1.x + q2.x * q1.w + q2.y * q1.z - q2.z * q1.y,
+	                    q2.w * q1.y - q2.x * q1.z + q2.y * q1.w + q2.z * q1.x,
+	                    q2.w * q1.z + q2.x * q1.y - q2.y * q1.x + q2.z * q1.w,
+	                    q2.w * q1.w - q2.x * q1.x - q2.y * q1.y - q2.z * q1.z };
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Non-member functions
+-----------------------------------------------------------------------------------------*/
+
+// The following functions create a quaternion holding a particular rotation. They match the
+// matrix functions of the same name, e.g. QuaternionRotationX(a) is the same rotation as MatrixRotationX(a)
+
+// Return the identity quaternion (no rotation)
+constexpr CQuaternion QuaternionIdentity()
+{
+	return CQuaternion{ 0.0f, 0.0f, 0.0f, 1.0f };
+}
+
+// Return an X/Y/Z-axis rotation of the given angle (in radians)
+CQuaternion QuaternionRotationX(float x);
+CQuaternion QuaternionRotationY(float y);
+CQuaternion QuaternionRotationZ(float z);
+
+// Return a rotation of the given angle (in radians) around the given axis, which must be normalised
+CQuaternion QuaternionRotationAxis(const CVector3& axis, float angle);
+
+// Return the rotation given by Euler angles in radians, in the order used by the models and camera
+// in this app: Z first, then X, then Y (i.e. MatrixRotationZ(z) * MatrixRotationX(x) * MatrixRotationY(y))
+CQuaternion QuaternionFromEuler(const CVector3& angles);
+
+// Same as QuaternionFromEuler but all three half angles go through one 4-wide SinCos (see FastTrig.hpp)
+// Error is under 1e-7 for angles within +-8192 radians - use when setting up many rotations at once
+CQuaternion QuaternionFromEulerFast(const CVector3& angles);
+
+// Return the rotation held in the upper-left 3x3 of the given matrix, which must not contain any scaling
+CQuaternion QuaternionFromMatrix(const CMatrix4x4& m);
+
+// Return the rotation that turns the world axes onto the given ones, which must be orthonormal
+CQuaternion QuaternionFromAxes(const CVector3& axisX, const CVector3& axisY, const CVector3& axisZ);
+
+// Return the Euler angles (Z, then X, then Y, see QuaternionFromEuler) for the given rotation
+// At gimbal lock (X rotation of +-90 degrees) the Z angle is returned as 0
+CVector3 EulerAngles(const CQuaternion& q);
+
+// Return a rotation matrix for the given quaternion, which must be normalised. No trig, just 12 multiplies
+constexpr CMatrix4x4 MatrixRotation(const CQuaternion& q)
+{
+	const float x2 = q.x + q.x, y2 = q.y + q.y, z2 = q.z + q.z;
+	const float xx = q.x * x2, yy = q.y * y2, zz = q.z * z2;
+	const float xy = q.x * y2, xz = q.x * z2, yz = q.y * z2;
+	const float wx = q.w * x2, wy = q.w * y2, wz = q.w * z2;
+
+	return CMatrix4x4{ 1.0f - (yy + zz),          xy + wz,          xz - wy,  0,
+	                            xy - wz, 1.0f - (xx + zz),          yz + wx,  0,
+	                            xz + wy,          yz - wx, 1.0f - (xx + yy),  0,
+	                                  0,                0,                0,  1 };
+}
+
+
+// Dot product of two quaternions
+constexpr float Dot(const CQuaternion& q1, const CQuaternion& q2)
+{
+	return q1.x * q2.x + q1.y * q2.y + q1.z * q2.z + q1.w * q2.w;
+}
+
+// Returns length of a quaternion
+float Length(const CQuaternion& q);
+
+// Return unit length quaternion holding the same rotation. Use occasionally to remove drift after many multiplies
+CQuaternion Normalise(const CQuaternion& q);
+
+// Return the conjugate of a quaternion, which is the opposite rotation for a normalised quaternion
+constexpr CQuaternion Conjugate(const CQuaternion& q)
+{
+	return CQuaternion{ -q.x, -q.y, -q.z, q.w };
+}
+
+// Return the opposite rotation. Works for quaternions of any length, use Conjugate if already normalised
+CQuaternion Inverse(const CQuaternion& q);
+
+// Rotate a vector by a normalised quaternion, same result as multiplying by MatrixRotation(q)
+CVector3 Rotate(const CQuaternion& q, const CVector3& v);
+
+// Spherical linear interpolation between two rotations (t from 0 to 1), takes the shortest path
+CQuaternion Slerp(const CQuaternion& q1, const CQuaternion& q2, float t);
+
+} } //Namespaces
+#endif // _CQUATERNION_H_DEFINED_
@@ -0,0 +1,160 @@
+//--------------------------------------------------------------------------------------
+// Random number generator class
+//--------------------------------------------------------------------------------------
+// xoshiro128+ (Blackman & Vigna) - fast, small state and good quality in the top bits, which are
+// the only ones used for floats. Seeds are expanded to the full state with splitmix64
+
+#include "CRandom.hpp"
+#include "SIMD.hpp"
+
+#include <functional>
+#include <thread>
+
+namespace umbra_engine
+{
+namespace maths
+{
+namespace
+{
+// Next value of a splitmix64 sequence, used to turn one 64-bit seed into well mixed state
+uint64_t SplitMix64(uint64_t& x)
+{
+	uint64_t z = (x += 0x9e3779b97f4a7c15ull);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+	return z ^ (z >> 31);
+}
+
+// Step a float pointer on by a number of bytes (for strided arrays)
+inline float* Advance(float* p, size_t bytes)
+{
+	return reinterpret_cast<float*>(reinterpret_cast<char*>(p) + bytes);
+}
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Member functions
+-----------------------------------------------------------------------------------------*/
+
+// Restart the sequence from the given seed
+void CRandom::Seed(uint64_t seed)
+{
+	for (int lane = 0; lane < NUM_LANES; ++lane)
+	{
+		uint64_t a = SplitMix64(seed);
+		uint64_t b = SplitMix64(seed);
+		mState[0][lane] = static_cast<uint32_t>(a);
+		mState[1][lane] = static_cast<uint32_t>(a >> 32);
+		mState[2][lane] = static_cast<uint32_t>(b);
+		mState[3][lane] = static_cast<uint32_t>(b >> 32);
+	}
+	mNextResult = NUM_LANES;
+}
+
+// Step all four generators, refilling mResults
+void CRandom::Step()
+{
+	for (int lane = 0; lane < NUM_LANES; ++lane)
+	{
+		uint32_t& s0 = mState[0][lane];
+		uint32_t& s1 = mState[1][lane];
+		uint32_t& s2 = mState[2][lane];
+		uint32_t& s3 = mState[3][lane];
+
+		mResults[lane] = s0 + s3;
+
+		uint32_t t = s1 << 9;
+		s2 ^= s0;
+		s3 ^= s1;
+		s1 ^= s2;
+		s0 ^= s3;
+		s2 ^= t;
+		s3 = (s3 << 11) | (s3 >> 21);
+	}
+	mNextResult = 0;
+}
+
+// Fill count floats with random values in the range [a, b), outStride bytes apart
+// The SSE loop steps the four generators at once and converts the results together. AVX has no 8-wide
+// integer instructions (that needs AVX2), so SSE is used for both
+void CRandom::Fill(float* out, size_t outStride, float a, float b, size_t count)
+{
+	size_t i = 0;
+
+	// Use any results left over from single calls first, so the sequence is the same as calling Range
+	for (; i < count && mNextResult < NUM_LANES; ++i)
+	{
+		*out = Range(a, b);
+		out = Advance(out, outStride);
+	}
+
+#if defined(UMBRA_MATHS_X86)
+	if (simd::ActiveInstructionSet() != simd::EInstructionSet::Scalar && count - i >= NUM_LANES)
+	{
+		__m128i s0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mState[0]));
+		__m128i s1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mState[1]));
+		__m128i s2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mState[2]));
+		__m128i s3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mState[3]));
+		const __m128 rangeMin = _mm_set1_ps(a);
+		const __m128 rangeSize = _mm_set1_ps(b - a);
+		const __m128 toFloat = _mm_set1_ps(1.0f / 16777216.0f);
+
+		for (; i + NUM_LANES <= count; i += NUM_LANES)
+		{
+			__m128i result = _mm_add_epi32(s0, s3);
+
+			__m128i t = _mm_slli_epi32(s1, 9);
+			s2 = _mm_xor_si128(s2, s0);
+			s3 = _mm_xor_si128(s3, s1);
+			s1 = _mm_xor_si128(s1, s2);
+			s0 = _mm_xor_si128(s0, s3);
+			s2 = _mm_xor_si128(s2, t);
+			s3 = _mm_or_si128(_mm_slli_epi32(s3, 11), _mm_srli_epi32(s3, 21));
+
+			__m128 u = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(result, 8)), toFloat);
+			__m128 r = _mm_add_ps(rangeMin, _mm_mul_ps(rangeSize, u));
+			if (outStride == sizeof(float))
+			{
+				_mm_storeu_ps(out, r);
+				out += NUM_LANES;
+			}
+			else
+			{
+				alignas(16) float values[NUM_LANES];
+				_mm_store_ps(values, r);
+				for (int lane = 0; lane < NUM_LANES; ++lane)
+				{
+					*out = values[lane];
+					out = Advance(out, outStride);
+				}
+			}
+		}
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(mState[0]), s0);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(mState[1]), s1);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(mState[2]), s2);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(mState[3]), s3);
+	}
+#endif
+
+	for (; i < count; ++i)
+	{
+		*out = Range(a, b);
+		out = Advance(out, outStride);
+	}
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Non-member functions
+-----------------------------------------------------------------------------------------*/
+
+// Generator for the calling thread, seeded from the thread's ID
+CRandom& ThreadRandom()
+{
+	thread_local CRandom random(std::hash<std::thread::id>()(std::this_thread::get_id()));
+	return random;
+}
+
+} } //Namespaces
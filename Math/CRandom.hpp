@@ -0,0 +1,84 @@
+//--------------------------------------------------------------------------------------
+// Random number generator class
+//--------------------------------------------------------------------------------------
+// Code in .cpp file
+// Each generator holds its own state, so systems (e.g. each particle emitter) can have their own
+// generator and get the same sequence every run for the same seed, without locking or sharing
+// rand()'s hidden global state between threads. Not suitable for cryptography
+//
+// Internally this is four xoshiro128+ generators side by side, stepped together with SSE. Values come
+// out in the same order whether they are requested one at a time or filled in bulk, and whichever
+// instruction set is active, so results only depend on the seed and the number of values taken
+
+#ifndef _CRANDOM_H_DEFINED_
+#define _CRANDOM_H_DEFINED_
+
+#include <cstdint>
+#include <cstddef>
+
+namespace umbra_engine
+{
+namespace maths
+{
+
+class CRandom
+{
+public:
+	/*-----------------------------------------------------------------------------------------
+		Constructors
+	-----------------------------------------------------------------------------------------*/
+
+	// Construct with the given seed. Generators with the same seed produce the same sequence
+	explicit CRandom(uint64_t seed = 0) { Seed(seed); }
+
+
+	/*-----------------------------------------------------------------------------------------
+		Member functions
+	-----------------------------------------------------------------------------------------*/
+
+	// Restart the sequence from the given seed
+	void Seed(uint64_t seed);
+
+	// Return a random 32-bit value
+	uint32_t Next()
+	{
+		if (mNextResult == NUM_LANES) Step();
+		return mResults[mNextResult++];
+	}
+
+	// Return a random float in the range [0, 1). Uses the top 24 bits so every value is equally likely
+	float NextFloat()
+	{
+		return static_cast<float>(Next() >> 8) * (1.0f / 16777216.0f);
+	}
+
+	// Return a random float in the range [a, b)
+	float Range(const float a, const float b)
+	{
+		return a + (b - a) * NextFloat();
+	}
+
+	// Fill count floats with random values in the range [a, b). Values are written outStride bytes apart,
+	// so a member of an array of structures can be filled directly. Same values as calling Range count times
+	void Fill(float* out, size_t outStride, float a, float b, size_t count);
+	void Fill(float* out, float a, float b, size_t count) { Fill(out, sizeof(float), a, b, count); }
+
+
+private:
+	// Step all four generators, refilling mResults
+	void Step();
+
+	static const int NUM_LANES = 4;
+
+	uint32_t mState[4][NUM_LANES]; // xoshiro128+ state words, one column per generator
+	uint32_t mResults[NUM_LANES];  // Results of the last step, handed out in order
+	int      mNextResult;          // Next unused entry in mResults
+};
+
+
+// Generator for the calling thread, seeded from the thread's ID. For code that doesn't need a
+// repeatable sequence or its own generator
+CRandom& ThreadRandom();
+
+} } //Namespaces
+#endif // _CRANDOM_H_DEFINED_
@@ -0,0 +1,152 @@
+//--------------------------------------------------------------------------------------
+// Render queue - draws sorted by 64-bit keys so that state changes between them are few
+//--------------------------------------------------------------------------------------
+
+#include "CRenderQueue.hpp"
+
+#include <cstring>
+
+namespace umbra_engine
+{
+namespace maths
+{
+namespace
+{
+const uint64_t IdMask    = 0xfff;
+const uint64_t DepthMask = 0xffffff;
+const uint64_t BlendMask = 0x3;
+
+// Top 24 bits of a non-negative float. The bits of non-negative floats are in the same order as their values, so
+// these sort like the depth itself with about 5 significant figures, without needing a depth range
+uint64_t DepthBits(float depth)
+{
+	if (!(depth > 0.0f)) return 0; // Also catches NaN
+	uint32_t bits;
+	std::memcpy(&bits, &depth, sizeof(bits));
+	return (bits >> 7) & DepthMask;
+}
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Member functions
+-----------------------------------------------------------------------------------------*/
+
+// Sort the items by key with a least significant byte first radix sort. Stable, so equal keys keep their order
+void CRenderQueue::Sort()
+{
+	const size_t count = mItems.size();
+	if (count < 2) return;
+	mScratch.resize(count);
+
+	// Count every byte of every key in one pass
+	size_t counts[8][256] = {};
+	for (const auto& item : mItems)
+	{
+		for (int byte = 0; byte < 8; ++byte)
+		{
+			++counts[byte][(item.key >> (8 * byte)) & 0xff];
+		}
+	}
+
+	SRenderItem* source = mItems.data();
+	SRenderItem* destination = mScratch.data();
+	for (int byte = 0; byte < 8; ++byte)
+	{
+		// Skip bytes that are the same in every key (e.g. unused ids), they don't change the order
+		size_t* byteCounts = counts[byte];
+		if (byteCounts[(source[0].key >> (8 * byte)) & 0xff] == count) continue;
+
+		size_t offsets[256];
+		size_t total = 0;
+		for (int value = 0; value < 256; ++value)
+		{
+			offsets[value] = total;
+			total += byteCounts[value];
+		}
+		for (size_t i = 0; i < count; ++i)
+		{
+			destination[offsets[(source[i].key >> (8 * byte)) & 0xff]++] = source[i];
+		}
+		std::swap(source, destination);
+	}
+
+	// An odd number of passes leaves the result in the scratch buffer
+	if (source != mItems.data()) mItems.swap(mScratch);
+}
+
+// Id for a pair of pointers
+uint32_t CRenderQueue::Id(IdMap& ids, const void* first, const void* second)
+{
+	auto key = std::make_pair(first, second);
+	auto found = ids.find(key);
+	if (found != ids.end()) return found->second;
+
+	if (ids.size() >= SharedId) return SharedId;
+	uint32_t id = static_cast<uint32_t>(ids.size());
+	ids[key] = id;
+	return id;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Keys
+-----------------------------------------------------------------------------------------*/
+
+// Pack the parts of a draw into a key
+uint64_t CRenderQueue::PackKey(const SRenderKey& key)
+{
+	uint64_t pass = static_cast<uint64_t>(key.pass) & 0x3;
+	uint64_t blend = key.blend & BlendMask;
+	uint64_t state = ((key.shader & IdMask) << 24) | ((key.textures & IdMask) << 12) | (key.mesh & IdMask);
+	uint64_t depth = DepthBits(key.depth);
+
+	if (key.pass == ERenderPass::Opaque)
+	{
+		return (pass << 62) | (blend << 60) | (state << 24) | depth;
+	}
+	return (pass << 62) | ((DepthMask - depth) << 38) | (blend << 36) | state;
+}
+
+// Get the parts of a key back
+SRenderKey CRenderQueue::UnpackKey(uint64_t key)
+{
+	SRenderKey result;
+	result.pass = static_cast<ERenderPass>(key >> 62);
+	result.depth = 0.0f;
+
+	uint64_t state;
+	if (result.pass == ERenderPass::Opaque)
+	{
+		result.blend = static_cast<uint32_t>((key >> 60) & BlendMask);
+		state = key >> 24;
+	}
+	else
+	{
+		result.blend = static_cast<uint32_t>((key >> 36) & BlendMask);
+		state = key;
+	}
+	result.shader = static_cast<uint32_t>((state >> 24) & IdMask);
+	result.textures = static_cast<uint32_t>((state >> 12) & IdMask);
+	result.mesh = static_cast<uint32_t>(state & IdMask);
+	return result;
+}
+
+// True if two keys differ only in depth
+bool CRenderQueue::SameState(uint64_t a, uint64_t b)
+{
+	SRenderKey keyA = UnpackKey(a);
+	SRenderKey keyB = UnpackKey(b);
+	return keyA.pass == keyB.pass && keyA.blend == keyB.blend && keyA.shader == keyB.shader &&
+	       keyA.textures == keyB.textures && keyA.mesh == keyB.mesh;
+}
+
+// Index just past the run of items starting at first with the same state and mesh
+size_t CRenderQueue::BatchEnd(size_t first) const
+{
+	size_t end = first + 1;
+	while (end < mItems.size() && SameState(mItems[first].key, mItems[end].key)) ++end;
+	return end;
+}
+
+} } //Namespaces
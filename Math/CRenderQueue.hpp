@@ -0,0 +1,132 @@
+//--------------------------------------------------------------------------------------
+// Render queue - draws sorted by 64-bit keys so that state changes between them are few
+//--------------------------------------------------------------------------------------
+// Code in .cpp file
+// Each frame the renderer submits one item per draw: a key packing the draw's pass, blend mode, shader, textures,
+// mesh and depth, and the index of whatever it draws. Sorting the keys puts draws sharing state next to each other,
+// so the renderer only changes state where neighbouring keys differ
+// Key layout, most significant bits first:
+//     Opaque pass:  pass (2) | blend (2) | shader (12) | textures (12) | mesh (12) | depth (24)
+//     Blended pass: pass (2) | ~depth (24) | blend (2) | shader (12) | textures (12) | mesh (12)
+// So opaque draws are grouped by state and drawn front to back within each group (nearer models hide more pixels
+// behind them), and blended draws are drawn back to front whatever their state, as blending needs
+// Shaders, textures and meshes are given small ids by the queue. Keys are sorted with a radix sort, which takes
+// the same time whatever the order of the draws. No graphics API is used
+
+#ifndef _CRENDER_QUEUE_H_DEFINED_
+#define _CRENDER_QUEUE_H_DEFINED_
+
+#include <vector>
+#include <map>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+
+namespace umbra_engine
+{
+namespace maths
+{
+
+// Passes in the order they are drawn
+enum class ERenderPass : uint32_t
+{
+	Opaque  = 0, // Writes depth
+	Blended = 1, // Reads depth, drawn after all opaque models
+};
+
+// The parts of a draw that make up its key. Blend is the app's EBlendingType, ids come from the queue's Id functions
+struct SRenderKey
+{
+	ERenderPass pass;
+	uint32_t    blend;
+	uint32_t    shader;
+	uint32_t    textures;
+	uint32_t    mesh;
+	float       depth; // View space depth of the draw, used only for ordering
+};
+
+// A sorted draw: its key and the index given when it was submitted
+struct SRenderItem
+{
+	uint64_t key;
+	uint32_t index;
+};
+
+// Work done by the renderer with the queue in the last frame
+struct SRenderQueueStats
+{
+	unsigned int numDraws        = 0; // Items submitted
+	unsigned int numStateChanges = 0; // Shader, texture, blend and depth state changes made between them
+	unsigned int numBatches      = 0; // Runs of items with the same state and mesh drawn with instancing
+	unsigned int numInstanced    = 0; // Items drawn in those batches
+	std::vector<unsigned int> batchSizes; // Items in each batch
+};
+
+class CRenderQueue
+{
+public:
+	/*-----------------------------------------------------------------------------------------
+		Constants
+	-----------------------------------------------------------------------------------------*/
+
+	// Ids for shaders, textures and meshes have 12 bits. Once they have all been given out, further states share
+	// this id - draws with it must set their state whatever the previous draw's key
+	static const uint32_t SharedId = 0xfff;
+
+
+	/*-----------------------------------------------------------------------------------------
+		Member functions
+	-----------------------------------------------------------------------------------------*/
+
+	// Remove all items, ready for the next frame. Ids are kept so keys are the same from frame to frame
+	void Clear() { mItems.clear(); }
+
+	// Add a draw with the given key and index (e.g. into the list of visible models)
+	void Submit(const SRenderKey& key, uint32_t index) { mItems.push_back({ PackKey(key), index }); }
+
+	// Sort the items by key. Items with equal keys stay in the order they were submitted
+	void Sort();
+
+	// Items submitted since Clear, in key order after Sort
+	const std::vector<SRenderItem>& Items() const { return mItems; }
+
+	// Index just past the run of items starting at first that have the same state and mesh as it (see SameState).
+	// After Sort each opaque state and mesh is a single run, which can be drawn as one instanced batch
+	size_t BatchEnd(size_t first) const;
+
+	// Small ids for a shader pair, a texture pair and a mesh, the same for the same pointers every time
+	uint32_t ShaderId(const void* vertexShader, const void* pixelShader)  { return Id(mShaderIds, vertexShader, pixelShader); }
+	uint32_t TextureId(const void* texture0, const void* texture1)        { return Id(mTextureIds, texture0, texture1); }
+	uint32_t MeshId(const void* mesh)                                     { return Id(mMeshIds, mesh, nullptr); }
+
+
+	/*-----------------------------------------------------------------------------------------
+		Keys
+	-----------------------------------------------------------------------------------------*/
+
+	// Pack the parts of a draw into a key. Negative depths are treated as 0
+	static uint64_t PackKey(const SRenderKey& key);
+
+	// Get the parts of a key back, depth is not recovered (returned as 0)
+	static SRenderKey UnpackKey(uint64_t key);
+
+	// True if two keys differ only in depth, so their draws use the same state and mesh
+	static bool SameState(uint64_t a, uint64_t b);
+
+
+private:
+	typedef std::map<std::pair<const void*, const void*>, uint32_t> IdMap;
+
+	// Id for a pair of pointers, giving out the next id if the pair is new
+	uint32_t Id(IdMap& ids, const void* first, const void* second);
+
+	std::vector<SRenderItem> mItems;
+	std::vector<SRenderItem> mScratch; // Working memory for Sort
+
+	IdMap mShaderIds;
+	IdMap mTextureIds;
+	IdMap mMeshIds;
+};
+
+} } //Namespaces
+#endif // _CRENDER_QUEUE_H_DEFINED_
@@ -0,0 +1,268 @@
+//--------------------------------------------------------------------------------------
+// Spatial queries over a set of objects - frustum, ray, sphere and nearest object queries
+//--------------------------------------------------------------------------------------
+// The tree holds slightly enlarged boxes (see CDynamicBVH), so every object it returns is tested again
+// against its exact bounds, or its triangles for ray casts
+
+#include "CSpatialQuery.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace umbra_engine
+{
+namespace maths
+{
+namespace
+{
+// Transform a point (w = 1) by an affine matrix
+inline CVector3 TransformPoint(const CMatrix4x4& m, const CVector3& p)
+{
+	return CVector3{ p.x * m.e00 + p.y * m.e10 + p.z * m.e20 + m.e30,
+	                 p.x * m.e01 + p.y * m.e11 + p.z * m.e21 + m.e31,
+	                 p.x * m.e02 + p.y * m.e12 + p.z * m.e22 + m.e32 };
+}
+
+// Transform a direction (w = 0) by an affine matrix
+inline CVector3 TransformDirection(const CMatrix4x4& m, const CVector3& d)
+{
+	return CVector3{ d.x * m.e00 + d.y * m.e10 + d.z * m.e20,
+	                 d.x * m.e01 + d.y * m.e11 + d.z * m.e21,
+	                 d.x * m.e02 + d.y * m.e12 + d.z * m.e22 };
+}
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Objects
+-----------------------------------------------------------------------------------------*/
+
+// Add an object with the given world space bounds
+int CSpatialQuery::Insert(const CAABB& bounds, void* userData)
+{
+	int object = mTree.Insert(bounds, userData);
+	if (object >= static_cast<int>(mObjects.size())) mObjects.resize(object + 1);
+	mObjects[object].bounds = bounds;
+	mObjects[object].triangles = nullptr;
+	return object;
+}
+
+// Add an object with a triangle BVH for exact ray casts
+int CSpatialQuery::Insert(const CAABB& bounds, const CTriangleBVH* triangles, const CMatrix4x4& worldMatrix, void* userData)
+{
+	int object = Insert(bounds, userData);
+	mObjects[object].triangles = triangles;
+	if (triangles != nullptr) mObjects[object].invWorldMatrix = InverseAffine(worldMatrix);
+	return object;
+}
+
+// Remove an object
+void CSpatialQuery::Remove(int object)
+{
+	mTree.Remove(object);
+	mObjects[object].triangles = nullptr;
+}
+
+// Give an object new bounds after it has moved
+void CSpatialQuery::Update(int object, const CAABB& bounds)
+{
+	mTree.Update(object, bounds);
+	mObjects[object].bounds = bounds;
+}
+
+// Give an object new bounds and world matrix after it has moved
+void CSpatialQuery::Update(int object, const CAABB& bounds, const CMatrix4x4& worldMatrix)
+{
+	Update(object, bounds);
+	if (mObjects[object].triangles != nullptr) mObjects[object].invWorldMatrix = InverseAffine(worldMatrix);
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Queries
+-----------------------------------------------------------------------------------------*/
+
+// Objects whose bounds intersect the frustum
+void CSpatialQuery::Query(const CFrustum& frustum, std::vector<void*>& results) const
+{
+	results.clear();
+	mProxies.clear();
+	mTree.Query(frustum, mProxies);
+	for (auto object : mProxies)
+	{
+		if (Intersects(frustum, mObjects[object].bounds))  results.push_back(mTree.GetUserData(object));
+	}
+}
+
+// Objects whose bounds intersect the sphere
+void CSpatialQuery::Overlap(const CSphere& sphere, std::vector<void*>& results) const
+{
+	results.clear();
+	AppendOverlaps(sphere, results);
+}
+
+// Find the first object hit by the ray within maxDistance
+bool CSpatialQuery::RayCast(const CRay& ray, float maxDistance, SRayHit& hit) const
+{
+	hit.object = nullptr;
+	int hitObject = CDynamicBVH::NullProxy;
+	int hitTriangle = -1;
+	float hitDistance = maxDistance;
+
+	// Each exact hit shortens the ray, so the tree doesn't visit anything further away
+	mTree.RayCast(ray, maxDistance, [&](int object, float currentMax)
+	{
+		float distance;
+		int triangle;
+		if (!RayCastObject(object, ray, currentMax, distance, triangle)) return currentMax;
+		hitObject = object;
+		hitTriangle = triangle;
+		hitDistance = distance;
+		return distance;
+	});
+	if (hitObject == CDynamicBVH::NullProxy) return false;
+
+	hit.object = mTree.GetUserData(hitObject);
+	hit.distance = hitDistance;
+	hit.point = ray.origin + ray.direction * hit.distance;
+	hit.triangle = hitTriangle;
+	return true;
+}
+
+// Return true if the ray hits any object within maxDistance
+bool CSpatialQuery::RayCastAny(const CRay& ray, float maxDistance) const
+{
+	bool found = false;
+	mTree.RayCast(ray, maxDistance, [&](int object, float currentMax)
+	{
+		float distance;
+		int triangle;
+		if (!RayCastObject(object, ray, currentMax, distance, triangle)) return currentMax;
+		found = true;
+		return -1.0f; // Stop
+	});
+	return found;
+}
+
+// The k objects whose bounds are nearest to the point, nearest first
+void CSpatialQuery::Nearest(const CVector3& point, size_t k, std::vector<void*>& results) const
+{
+	results.assign(k, nullptr);
+	if (k == 0) return;
+	results.resize(FindNearest(point, k, results.data()));
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Batch queries
+-----------------------------------------------------------------------------------------*/
+
+// Ray cast each ray, writing a hit for each. Returns the number of hits
+size_t CSpatialQuery::RayCast(const CRay* rays, float maxDistance, SRayHit* hits, size_t count) const
+{
+	size_t numHits = 0;
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (RayCast(rays[i], maxDistance, hits[i])) ++numHits;
+	}
+	return numHits;
+}
+
+// Test each ray for any hit. Returns the number of rays that hit
+size_t CSpatialQuery::RayCastAny(const CRay* rays, float maxDistance, unsigned char* hit, size_t count) const
+{
+	size_t numHits = 0;
+	for (size_t i = 0; i < count; ++i)
+	{
+		hit[i] = RayCastAny(rays[i], maxDistance) ? 1 : 0;
+		numHits += hit[i];
+	}
+	return numHits;
+}
+
+// Find objects overlapping each sphere, results for sphere i are from offsets[i] to offsets[i + 1]
+void CSpatialQuery::Overlap(const CSphere* spheres, std::vector<void*>& results, size_t* offsets, size_t count) const
+{
+	results.clear();
+	for (size_t i = 0; i < count; ++i)
+	{
+		offsets[i] = results.size();
+		AppendOverlaps(spheres[i], results);
+	}
+	offsets[count] = results.size();
+}
+
+// Find the k nearest objects to each point, k results per point
+void CSpatialQuery::Nearest(const CVector3* points, size_t k, void** results, size_t count) const
+{
+	if (k == 0) return;
+	std::fill(results, results + k * count, nullptr);
+	for (size_t i = 0; i < count; ++i)
+	{
+		FindNearest(points[i], k, results + i * k);
+	}
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Private member functions
+-----------------------------------------------------------------------------------------*/
+
+// Test the ray against a single object
+bool CSpatialQuery::RayCastObject(int object, const CRay& ray, float maxDistance, float& distance, int& triangle) const
+{
+	const SObject& data = mObjects[object];
+	if (!Intersects(ray, data.bounds, maxDistance, distance)) return false;
+
+	triangle = -1;
+	if (data.triangles == nullptr) return true;
+
+	// Test the triangles in model space. The direction is transformed without normalising, so distances along
+	// the model space ray are the same as along the world space ray, even for scaled models
+	CRay modelRay{ TransformPoint(data.invWorldMatrix, ray.origin), TransformDirection(data.invWorldMatrix, ray.direction) };
+	SRayTriangleHit triangleHit;
+	if (!data.triangles->RayCast(modelRay, maxDistance, triangleHit)) return false;
+
+	distance = triangleHit.distance;
+	triangle = static_cast<int>(triangleHit.triangle);
+	return true;
+}
+
+// Append the objects whose bounds intersect the sphere to results
+void CSpatialQuery::AppendOverlaps(const CSphere& sphere, std::vector<void*>& results) const
+{
+	CVector3 radius{ sphere.radius, sphere.radius, sphere.radius };
+	mProxies.clear();
+	mTree.Query(CAABB{ sphere.centre - radius, sphere.centre + radius }, mProxies);
+	for (auto object : mProxies)
+	{
+		if (Intersects(mObjects[object].bounds, sphere))  results.push_back(mTree.GetUserData(object));
+	}
+}
+
+// Write the k nearest objects to the point into results, returns the number written
+size_t CSpatialQuery::FindNearest(const CVector3& point, size_t k, void** results) const
+{
+	// The tree visits objects in order of distance to their enlarged boxes, which is never more than the distance
+	// to their exact bounds. So keep the k best exact distances found, and stop when the next box is further away
+	// than the kth best
+	auto& best = mNearest;
+	best.clear();
+	mTree.Nearest(point, [&](int object, float boxDistanceSquared)
+	{
+		if (best.size() == k && boxDistanceSquared >= best.back().first) return false;
+
+		std::pair<float, int> candidate{ DistanceSquared(mObjects[object].bounds, point), object };
+		best.insert(std::upper_bound(best.begin(), best.end(), candidate), candidate);
+		if (best.size() > k) best.pop_back();
+		return true;
+	});
+
+	for (size_t i = 0; i < best.size(); ++i)
+	{
+		results[i] = mTree.GetUserData(best[i].second);
+	}
+	return best.size();
+}
+
+} } //Namespaces
@@ -0,0 +1,139 @@
+//--------------------------------------------------------------------------------------
+// Spatial queries over a set of objects - frustum, ray, sphere and nearest object queries
+//--------------------------------------------------------------------------------------
+// Code in .cpp file
+// Each object has world space bounds and optionally a triangle BVH with a world matrix for exact ray casts
+// (objects without one are hit on their bounds). Objects are held in a dynamic BVH so queries only visit the
+// parts of the world near them. Objects are referred to by the value returned from Insert, and queries return
+// the user data given to Insert (e.g. a model pointer)
+// No graphics API is used, so queries can run anywhere, e.g. tools and tests without a window
+// Batch versions take arrays of queries and run them all in one call, sharing the working memory. Because of
+// that shared memory, queries on one object must not be run from several threads at once
+
+#ifndef _CSPATIAL_QUERY_H_DEFINED_
+#define _CSPATIAL_QUERY_H_DEFINED_
+
+#include "Geometry.hpp"
+#include "CDynamicBVH.hpp"
+#include "CTriangleBVH.hpp"
+
+#include <vector>
+#include <utility>
+#include <cstddef>
+
+namespace umbra_engine
+{
+namespace maths
+{
+
+// Result of a ray cast against the objects
+struct SRayHit
+{
+	void*    object;   // User data of the object hit, nullptr if nothing was hit
+	float    distance; // Distance along the ray (in world units for a unit length ray direction)
+	CVector3 point;    // World space hit point
+	int      triangle; // Triangle hit in the object's triangle BVH, -1 if the object's bounds were hit
+};
+
+class CSpatialQuery
+{
+public:
+	/*-----------------------------------------------------------------------------------------
+		Constructors
+	-----------------------------------------------------------------------------------------*/
+
+	// Construct with no objects. The margin is used for the BVH (see CDynamicBVH), larger values mean less work
+	// for moving objects but more objects to test exactly in each query
+	explicit CSpatialQuery(float margin = 1.0f) : mTree(margin) {}
+
+
+	/*-----------------------------------------------------------------------------------------
+		Objects
+	-----------------------------------------------------------------------------------------*/
+
+	// Add an object with the given world space bounds, returns the value used to refer to it later
+	// Optionally give a triangle BVH (in model space, must outlive the object) and the object's world matrix for
+	// exact ray casts
+	int Insert(const CAABB& bounds, void* userData);
+	int Insert(const CAABB& bounds, const CTriangleBVH* triangles, const CMatrix4x4& worldMatrix, void* userData);
+
+	// Remove an object
+	void Remove(int object);
+
+	// Give an object new bounds (and world matrix, for objects with a triangle BVH) after it has moved
+	void Update(int object, const CAABB& bounds);
+	void Update(int object, const CAABB& bounds, const CMatrix4x4& worldMatrix);
+
+	// Access object data
+	void*        GetUserData(int object) const { return mTree.GetUserData(object); }
+	const CAABB& GetBounds(int object) const   { return mObjects[object].bounds; }
+	size_t       Count() const                 { return mTree.Count(); }
+
+
+	/*-----------------------------------------------------------------------------------------
+		Queries
+	-----------------------------------------------------------------------------------------*/
+	// Query results are cleared before being filled
+
+	// Objects whose bounds intersect the frustum
+	void Query(const CFrustum& frustum, std::vector<void*>& results) const;
+
+	// Objects whose bounds intersect the sphere
+	void Overlap(const CSphere& sphere, std::vector<void*>& results) const;
+
+	// Find the first object hit by the ray within maxDistance. Returns false (and hit.object = nullptr) if none
+	bool RayCast(const CRay& ray, float maxDistance, SRayHit& hit) const;
+
+	// Return true if the ray hits any object within maxDistance - quicker than finding the first, for line of
+	// sight tests
+	bool RayCastAny(const CRay& ray, float maxDistance) const;
+
+	// The k objects whose bounds are nearest to the point, nearest first (distance is 0 for a point inside).
+	// Fewer are returned if there are fewer than k objects
+	void Nearest(const CVector3& point, size_t k, std::vector<void*>& results) const;
+
+
+	/*-----------------------------------------------------------------------------------------
+		Batch queries
+	-----------------------------------------------------------------------------------------*/
+
+	// Ray cast each ray, writing a hit for each (hits[i].object is nullptr for a miss). Returns the number of hits
+	size_t RayCast(const CRay* rays, float maxDistance, SRayHit* hits, size_t count) const;
+
+	// Test each ray for any hit, hit[i] is set to 1 or 0. Returns the number of rays that hit
+	size_t RayCastAny(const CRay* rays, float maxDistance, unsigned char* hit, size_t count) const;
+
+	// Find objects overlapping each sphere. The results for sphere i are results[offsets[i]] up to
+	// results[offsets[i + 1]], so offsets must have space for count + 1 entries
+	void Overlap(const CSphere* spheres, std::vector<void*>& results, size_t* offsets, size_t count) const;
+
+	// Find the k nearest objects to each point. The results for point i are results[i * k] to results[i * k + k - 1],
+	// with nullptr entries when there are fewer than k objects
+	void Nearest(const CVector3* points, size_t k, void** results, size_t count) const;
+
+
+private:
+	struct SObject
+	{
+		CAABB               bounds;
+		const CTriangleBVH* triangles = nullptr;
+		CMatrix4x4          invWorldMatrix; // Only set if there are triangles
+	};
+
+	// Test the ray against a single object, returns true with the distance and triangle if hit within maxDistance
+	bool RayCastObject(int object, const CRay& ray, float maxDistance, float& distance, int& triangle) const;
+
+	// Single query versions of the batch queries that append to the results rather than clearing them
+	void AppendOverlaps(const CSphere& sphere, std::vector<void*>& results) const;
+	size_t FindNearest(const CVector3& point, size_t k, void** results) const;
+
+	CDynamicBVH          mTree;
+	std::vector<SObject> mObjects; // Indexed by object (the proxy number in the tree)
+
+	// Working memory for queries
+	mutable std::vector<int>                    mProxies;
+	mutable std::vector<std::pair<float, int>> mNearest; // Best (distance squared, object) pairs so far
+};
+
+} } //Namespaces
+#endif // _CSPATIAL_QUERY_H_DEFINED_
@@ -0,0 +1,80 @@
+//--------------------------------------------------------------------------------------
+// Transform class, holds position, rotation and scale (TRS) without the cost of a full matrix
+//--------------------------------------------------------------------------------------
+
+#include "CTransform.hpp"
+#include "MathHelpers.hpp"
+
+namespace umbra_engine
+{
+namespace maths
+{
+/*-----------------------------------------------------------------------------------------
+	Member functions
+-----------------------------------------------------------------------------------------*/
+
+// Return the matrix for this transform. Rotation matrix rows scaled, position in the bottom row
+CMatrix4x4 CTransform::ToMatrix() const
+{
+	CMatrix4x4 m = MatrixRotation(rotation);
+	m.e00 *= scale.x; m.e01 *= scale.x; m.e02 *= scale.x;
+	m.e10 *= scale.y; m.e11 *= scale.y; m.e12 *= scale.y;
+	m.e20 *= scale.z; m.e21 *= scale.z; m.e22 *= scale.z;
+	m.SetRow(3, position);
+	return m;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Operators
+-----------------------------------------------------------------------------------------*/
+
+// Combine two transforms, t1 first then t2 (same order as matrices)
+CTransform operator* (const CTransform& t1, const CTransform& t2)
+{
+	CVector3 scaledPosition{ t1.position.x * t2.scale.x, t1.position.y * t2.scale.y, t1.position.z * t2.scale.z };
+	return CTransform{ Rotate(t2.rotation, scaledPosition) + t2.position,
+	                   t1.rotation * t2.rotation,
+	                   CVector3{ t1.scale.x * t2.scale.x, t1.scale.y * t2.scale.y, t1.scale.z * t2.scale.z } };
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Non-member functions
+-----------------------------------------------------------------------------------------*/
+
+// Split an affine matrix into position, rotation and scale
+CTransform TransformFromMatrix(const CMatrix4x4& m)
+{
+	CVector3 scale = m.GetScale();
+
+	// Remove scale from the axes to leave a pure rotation
+	CVector3 axisX = IsZero(scale.x) ? CVector3{ 1.0f, 0.0f, 0.0f } : m.GetXAxis() * (1.0f / scale.x);
+	CVector3 axisY = IsZero(scale.y) ? CVector3{ 0.0f, 1.0f, 0.0f } : m.GetYAxis() * (1.0f / scale.y);
+	CVector3 axisZ = IsZero(scale.z) ? CVector3{ 0.0f, 0.0f, 1.0f } : m.GetZAxis() * (1.0f / scale.z);
+
+	return CTransform{ m.GetPosition(), Normalise(QuaternionFromAxes(axisX, axisY, axisZ)), scale };
+}
+
+// Return the inverse transform. Exact for uniform scale
+CTransform Inverse(const CTransform& t)
+{
+	CVector3 invScale{ 1.0f / t.scale.x, 1.0f / t.scale.y, 1.0f / t.scale.z };
+	CQuaternion invRotation = Conjugate(t.rotation);
+	CVector3 p = Rotate(invRotation, t.position);
+	return CTransform{ CVector3{ -p.x * invScale.x, -p.y * invScale.y, -p.z * invScale.z }, invRotation, invScale };
+}
+
+// Transform a point, same result as multiplying by ToMatrix() with w = 1
+CVector3 TransformPoint(const CTransform& t, const CVector3& p)
+{
+	return TransformDirection(t, p) + t.position;
+}
+
+// Transform a direction, same result as multiplying by ToMatrix() with w = 0
+CVector3 TransformDirection(const CTransform& t, const CVector3& v)
+{
+	return Rotate(t.rotation, CVector3{ v.x * t.scale.x, v.y * t.scale.y, v.z * t.scale.z });
+}
+
+} } //Namespaces
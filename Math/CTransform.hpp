@@ -0,0 +1,93 @@
+//--------------------------------------------------------------------------------------
+// Transform class, holds position, rotation and scale (TRS) without the cost of a full matrix
+//--------------------------------------------------------------------------------------
+// Code in .cpp file
+// Rotations are stored as a quaternion so they can be combined without trig or re-orthonormalising
+// axes, and converting to a matrix takes no trig either. Same conventions as the matrices in this
+// app: the matrix is MatrixScaling(scale) * MatrixRotation(rotation) * MatrixTranslation(position)
+// and t1 * t2 is the transform t1 followed by t2
+
+#ifndef _CTRANSFORM_H_DEFINED_
+#define _CTRANSFORM_H_DEFINED_
+
+#include "CVector3.hpp"
+#include "CMatrix4x4.hpp"
+#include "CQuaternion.hpp"
+
+namespace umbra_engine
+{
+namespace maths
+{
+
+class CTransform
+{
+	// Concrete class - public access
+public:
+	CVector3    position;
+	CQuaternion rotation; // Kept normalised
+	CVector3    scale;
+
+	/*-----------------------------------------------------------------------------------------
+		Constructors
+	-----------------------------------------------------------------------------------------*/
+
+	// Default constructor - leaves values uninitialised (for performance)
+	CTransform() {}
+
+	// Construct from position, rotation and scale
+	constexpr CTransform(const CVector3& positionIn, const CQuaternion& rotationIn, const CVector3& scaleIn)
+		: position(positionIn), rotation(rotationIn), scale(scaleIn) {}
+
+
+	/*-----------------------------------------------------------------------------------------
+		Member functions
+	-----------------------------------------------------------------------------------------*/
+
+	// Return the matrix for this transform
+	CMatrix4x4 ToMatrix() const;
+
+	// Axes of the transform (including scale), same as the first three rows of the matrix
+	CVector3 GetXAxis() const { return Rotate(rotation, { scale.x, 0.0f, 0.0f }); }
+	CVector3 GetYAxis() const { return Rotate(rotation, { 0.0f, scale.y, 0.0f }); }
+	CVector3 GetZAxis() const { return Rotate(rotation, { 0.0f, 0.0f, scale.z }); }
+
+	// Rotate around the transform's own axes (i.e. the rotation happens before the current one)
+	void RotateLocal(const CQuaternion& q) { rotation = Normalise(q * rotation); }
+
+	// Rotate around the world axes (i.e. the rotation happens after the current one). Position is unchanged
+	void RotateWorld(const CQuaternion& q) { rotation = Normalise(rotation * q); }
+};
+
+
+/*-----------------------------------------------------------------------------------------
+	Non-member operators
+-----------------------------------------------------------------------------------------*/
+
+// Combine two transforms, t1 first then t2 (same order as matrices)
+// Exact when t2 has uniform scale, otherwise the result can't be held in a TRS (it would need shear)
+CTransform operator* (const CTransform& t1, const CTransform& t2);
+
+
+/*-----------------------------------------------------------------------------------------
+	Non-member functions
+-----------------------------------------------------------------------------------------*/
+
+// Return the identity transform
+constexpr CTransform TransformIdentity()
+{
+	return CTransform{ { 0.0f, 0.0f, 0.0f }, QuaternionIdentity(), { 1.0f, 1.0f, 1.0f } };
+}
+
+// Split an affine matrix into position, rotation and scale. The matrix must not contain shear
+// Negative scales can't be recovered (they are returned as a rotation)
+CTransform TransformFromMatrix(const CMatrix4x4& m);
+
+// Return the inverse transform. Exact for uniform scale, which covers cameras and most models
+CTransform Inverse(const CTransform& t);
+
+// Transform a point / direction, same result as multiplying by ToMatrix() with w = 1 / w = 0
+CVector3 TransformPoint(const CTransform& t, const CVector3& p);
+CVector3 TransformDirection(const CTransform& t, const CVector3& v);
+
+} } //Namespaces
+#endif // _CTRANSFORM_H_DEFINED_
@@ -0,0 +1,348 @@
+//--------------------------------------------------------------------------------------
+// Static bounding volume hierarchy over the triangles of a mesh
+//--------------------------------------------------------------------------------------
+// Built with binned SAH: triangle centres are sorted into bins along the longest axis and the split between
+// bins with the lowest "area x triangles" cost on each side is chosen. Rays are tested against triangles with
+// the Moller-Trumbore algorithm
+
+#include "CTriangleBVH.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace umbra_engine
+{
+namespace maths
+{
+namespace
+{
+// Step a pointer on by a number of bytes (for strided arrays)
+inline const CVector3* Advance(const CVector3* p, size_t bytes)
+{
+	return reinterpret_cast<const CVector3*>(reinterpret_cast<const char*>(p) + bytes);
+}
+
+// Half the surface area of a box, proportional to the chance of a ray hitting it
+inline float HalfArea(const CAABB& box)
+{
+	CVector3 size = box.maximum - box.minimum;
+	return size.x * size.y + size.y * size.z + size.z * size.x;
+}
+
+// Ray against box with precalculated reciprocal of the ray direction. Zero direction components give infinite
+// reciprocals, which the comparisons handle correctly
+inline bool RayHitsBox(const CAABB& box, const CVector3& origin, const CVector3& invDirection, float maxDistance, float& distance)
+{
+	float tx1 = (box.minimum.x - origin.x) * invDirection.x, tx2 = (box.maximum.x - origin.x) * invDirection.x;
+	float ty1 = (box.minimum.y - origin.y) * invDirection.y, ty2 = (box.maximum.y - origin.y) * invDirection.y;
+	float tz1 = (box.minimum.z - origin.z) * invDirection.z, tz2 = (box.maximum.z - origin.z) * invDirection.z;
+	float tMin = std::max(std::max(std::min(tx1, tx2), std::min(ty1, ty2)), std::max(std::min(tz1, tz2), 0.0f));
+	float tMax = std::min(std::min(std::max(tx1, tx2), std::max(ty1, ty2)), std::min(std::max(tz1, tz2), maxDistance));
+	distance = tMin;
+	return tMin <= tMax;
+}
+
+// Build parameters
+const int      NUM_BINS = 16;
+const uint32_t MAX_LEAF_TRIANGLES = 4;  // Always split nodes with more triangles than this...
+const int      MAX_SAH_DEPTH = 64;      // ...using SAH down to this depth, then median splits, which halve the count
+
+// Triangle data used while building
+struct SBuildTriangle
+{
+	CAABB    bounds;
+	CVector3 centre;
+	uint32_t index;
+};
+
+struct SBuildBin
+{
+	CAABB    bounds;
+	uint32_t count;
+};
+
+// Return the axis (0-2) on which the box is longest
+inline int LongestAxis(const CAABB& box)
+{
+	CVector3 size = box.maximum - box.minimum;
+	if (size.x >= size.y && size.x >= size.z) return 0;
+	return (size.y >= size.z) ? 1 : 2;
+}
+
+inline float Component(const CVector3& v, int axis)
+{
+	return (&v.x)[axis];
+}
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Member functions
+-----------------------------------------------------------------------------------------*/
+
+// Build the tree from an indexed triangle list, replacing any existing tree
+void CTriangleBVH::Build(const CVector3* positions, size_t stride, const uint32_t* indices, size_t numIndices)
+{
+	mNodes.clear();
+	mTriangles.clear();
+	mTriangleIndices.clear();
+	mBounds = EmptyAABB();
+
+	const uint32_t numTriangles = static_cast<uint32_t>(numIndices / 3);
+	if (numTriangles == 0) return;
+
+	std::vector<SBuildTriangle> buildTriangles(numTriangles);
+	for (uint32_t t = 0; t < numTriangles; ++t)
+	{
+		const CVector3& v0 = *Advance(positions, indices[t * 3 + 0] * stride);
+		const CVector3& v1 = *Advance(positions, indices[t * 3 + 1] * stride);
+		const CVector3& v2 = *Advance(positions, indices[t * 3 + 2] * stride);
+		auto& triangle = buildTriangles[t];
+		triangle.bounds = Merge(Merge(CAABB{ v0, v0 }, v1), v2);
+		triangle.centre = triangle.bounds.Centre();
+		triangle.index = t;
+	}
+
+	// Build depth first with an explicit stack of triangle ranges. A node is added to the array when it is
+	// reached, so its first child is always the next node. The second child's position is filled in later
+	struct SBuildEntry
+	{
+		uint32_t begin;
+		uint32_t end;
+		int      depth;
+		int      parent; // Parent node whose second child this is, or -1 for the root and first children
+	};
+	std::vector<SBuildEntry> stack;
+	stack.push_back({ 0, numTriangles, 0, -1 });
+	mNodes.reserve(2 * numTriangles / MAX_LEAF_TRIANGLES + 1);
+
+	while (!stack.empty())
+	{
+		SBuildEntry entry = stack.back();
+		stack.pop_back();
+
+		uint32_t nodeIndex = static_cast<uint32_t>(mNodes.size());
+		if (entry.parent >= 0) mNodes[entry.parent].first = nodeIndex;
+
+		// Bounds of the triangles and of their centres
+		CAABB bounds = EmptyAABB();
+		CAABB centreBounds = EmptyAABB();
+		for (uint32_t t = entry.begin; t < entry.end; ++t)
+		{
+			bounds = Merge(bounds, buildTriangles[t].bounds);
+			centreBounds = Merge(centreBounds, buildTriangles[t].centre);
+		}
+		mNodes.push_back({ bounds, entry.begin, entry.end - entry.begin });
+
+		uint32_t count = entry.end - entry.begin;
+		if (count <= MAX_LEAF_TRIANGLES) continue; // Leaf
+
+		int axis = LongestAxis(centreBounds);
+		float axisMin = Component(centreBounds.minimum, axis);
+		float axisSize = Component(centreBounds.maximum, axis) - axisMin;
+		auto first = buildTriangles.begin() + entry.begin;
+		auto last  = buildTriangles.begin() + entry.end;
+		auto middle = first;
+
+		if (entry.depth < MAX_SAH_DEPTH && axisSize > 0.0f)
+		{
+			// Sort triangle centres into bins along the axis
+			SBuildBin bins[NUM_BINS];
+			for (auto& bin : bins)
+			{
+				bin.bounds = EmptyAABB();
+				bin.count = 0;
+			}
+			const float binScale = NUM_BINS / axisSize;
+			auto binIndex = [&](const SBuildTriangle& triangle)
+			{
+				int bin = static_cast<int>((Component(triangle.centre, axis) - axisMin) * binScale);
+				return std::min(bin, NUM_BINS - 1);
+			};
+			for (auto t = first; t != last; ++t)
+			{
+				auto& bin = bins[binIndex(*t)];
+				bin.bounds = Merge(bin.bounds, t->bounds);
+				++bin.count;
+			}
+
+			// Sweep from the right to get the area and count on the right of each split, then from the left
+			// to find the cheapest split
+			float rightCost[NUM_BINS];
+			CAABB rightBounds = EmptyAABB();
+			uint32_t rightCount = 0;
+			for (int b = NUM_BINS - 1; b > 0; --b)
+			{
+				rightBounds = Merge(rightBounds, bins[b].bounds);
+				rightCount += bins[b].count;
+				rightCost[b] = (rightCount > 0) ? rightCount * HalfArea(rightBounds) : 0.0f;
+			}
+
+			int bestSplit = 0;
+			float bestCost = count * HalfArea(bounds); // Cost of not splitting
+			CAABB leftBounds = EmptyAABB();
+			uint32_t leftCount = 0;
+			for (int b = 1; b < NUM_BINS; ++b)
+			{
+				leftBounds = Merge(leftBounds, bins[b - 1].bounds);
+				leftCount += bins[b - 1].count;
+				if (leftCount == 0 || leftCount == count) continue;
+				float cost = leftCount * HalfArea(leftBounds) + rightCost[b];
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestSplit = b;
+				}
+			}
+
+			if (bestSplit > 0)
+			{
+				middle = std::partition(first, last, [&](const SBuildTriangle& t) { return binIndex(t) < bestSplit; });
+			}
+		}
+
+		// No useful SAH split (e.g. all centres in one place), or too deep - split the triangles in half
+		if (middle == first || middle == last)
+		{
+			middle = first + count / 2;
+			std::nth_element(first, middle, last, [axis](const SBuildTriangle& a, const SBuildTriangle& b)
+			{
+				return Component(a.centre, axis) < Component(b.centre, axis);
+			});
+		}
+
+		// Interior node, push the second child first so the first child is built next (immediately after this node)
+		uint32_t split = static_cast<uint32_t>(middle - buildTriangles.begin());
+		mNodes[nodeIndex].count = 0;
+		stack.push_back({ split, entry.end, entry.depth + 1, static_cast<int>(nodeIndex) });
+		stack.push_back({ entry.begin, split, entry.depth + 1, -1 });
+	}
+	assert(mNodes.size() < 2 * static_cast<size_t>(numTriangles));
+
+	// Store the triangles in tree order
+	mTriangles.resize(numTriangles);
+	mTriangleIndices.resize(numTriangles);
+	for (uint32_t t = 0; t < numTriangles; ++t)
+	{
+		uint32_t index = buildTriangles[t].index;
+		const CVector3& v0 = *Advance(positions, indices[index * 3 + 0] * stride);
+		const CVector3& v1 = *Advance(positions, indices[index * 3 + 1] * stride);
+		const CVector3& v2 = *Advance(positions, indices[index * 3 + 2] * stride);
+		mTriangles[t] = { v0, v1 - v0, v2 - v0 };
+		mTriangleIndices[t] = index;
+	}
+	mBounds = mNodes[0].bounds;
+}
+
+
+// Find the nearest triangle hit by the ray within maxDistance
+bool CTriangleBVH::RayCast(const CRay& ray, float maxDistance, SRayTriangleHit& hit) const
+{
+	return Traverse(ray, maxDistance, false, hit);
+}
+
+// Return true if the ray hits any triangle within maxDistance
+bool CTriangleBVH::RayCastAny(const CRay& ray, float maxDistance) const
+{
+	SRayTriangleHit hit;
+	return Traverse(ray, maxDistance, true, hit);
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Private member functions
+-----------------------------------------------------------------------------------------*/
+
+// Shared traversal for the two ray casts, stops at the first hit found if anyHit is set
+bool CTriangleBVH::Traverse(const CRay& ray, float maxDistance, bool anyHit, SRayTriangleHit& hit) const
+{
+	if (mNodes.empty()) return false;
+
+	const CVector3 origin = ray.origin;
+	const CVector3 direction = ray.direction;
+	const CVector3 invDirection{ 1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z };
+
+	float distance;
+	if (!RayHitsBox(mNodes[0].bounds, origin, invDirection, maxDistance, distance)) return false;
+
+	// Always step into the nearer child and push the further one. Nothing is pushed at a leaf, so the stack
+	// never holds more entries than the depth of the tree
+	struct SEntry
+	{
+		uint32_t node;
+		float    distance;
+	};
+	SEntry stack[MaxDepth + 1];
+	int stackSize = 0;
+
+	bool found = false;
+	uint32_t nodeIndex = 0;
+	for (;;)
+	{
+		const SNode& node = mNodes[nodeIndex];
+		if (node.count > 0)
+		{
+			for (uint32_t t = node.first; t < node.first + node.count; ++t)
+			{
+				// Moller-Trumbore: solve origin + t * direction = vertex0 + u * edge1 + v * edge2
+				const STriangle& triangle = mTriangles[t];
+				CVector3 p = Cross(direction, triangle.edge2);
+				float determinant = Dot(triangle.edge1, p);
+				if (std::abs(determinant) < 1e-20f) continue; // Ray parallel to triangle
+
+				float invDeterminant = 1.0f / determinant;
+				CVector3 s = origin - triangle.vertex0;
+				float u = Dot(s, p) * invDeterminant;
+				if (u < 0.0f || u > 1.0f) continue;
+
+				CVector3 q = Cross(s, triangle.edge1);
+				float v = Dot(direction, q) * invDeterminant;
+				if (v < 0.0f || u + v > 1.0f) continue;
+
+				float t0 = Dot(triangle.edge2, q) * invDeterminant;
+				if (t0 < 0.0f || t0 > maxDistance) continue;
+
+				maxDistance = t0;
+				hit = { t0, mTriangleIndices[t], u, v };
+				found = true;
+				if (anyHit) return true;
+			}
+		}
+		else
+		{
+			uint32_t child1 = nodeIndex + 1;
+			uint32_t child2 = node.first;
+			float distance1, distance2;
+			bool hit1 = RayHitsBox(mNodes[child1].bounds, origin, invDirection, maxDistance, distance1);
+			bool hit2 = RayHitsBox(mNodes[child2].bounds, origin, invDirection, maxDistance, distance2);
+			if (hit1 && hit2)
+			{
+				if (distance2 < distance1)
+				{
+					std::swap(child1, child2);
+					std::swap(distance1, distance2);
+				}
+				assert(stackSize < MaxDepth + 1);
+				stack[stackSize++] = { child2, distance2 };
+				nodeIndex = child1;
+				continue;
+			}
+			if (hit1 || hit2)
+			{
+				nodeIndex = hit1 ? child1 : child2;
+				continue;
+			}
+		}
+
+		// Pop the next node that is still nearer than the nearest hit
+		do
+		{
+			if (stackSize == 0) return found;
+			--stackSize;
+		} while (stack[stackSize].distance > maxDistance);
+		nodeIndex = stack[stackSize].node;
+	}
+}
+
+} } //Namespaces
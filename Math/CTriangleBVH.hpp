@@ -0,0 +1,104 @@
+//--------------------------------------------------------------------------------------
+// Static bounding volume hierarchy over the triangles of a mesh
+//--------------------------------------------------------------------------------------
+// Code in .cpp file
+// Built once from an indexed triangle list (e.g. when a mesh is loaded) for exact ray casts against the
+// geometry - picking, line of sight, finding the ground below a point. The tree is built top down, splitting
+// each node where the surface area heuristic says rays will test fewest triangles, and stored depth first in
+// a single array so traversal touches memory in order. Works in whatever space the vertices are in, so for
+// a model the ray is transformed into model space first (see CSpatialQuery)
+
+#ifndef _CTRIANGLE_BVH_H_DEFINED_
+#define _CTRIANGLE_BVH_H_DEFINED_
+
+#include "Geometry.hpp"
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace umbra_engine
+{
+namespace maths
+{
+
+// Where a ray hit a triangle. The hit point is (1 - u - v) * vertex0 + u * vertex1 + v * vertex2
+struct SRayTriangleHit
+{
+	float        distance; // Distance along the ray in units of the ray's direction vector
+	unsigned int triangle; // Index of the triangle in the index list the tree was built from (index / 3)
+	float        u;
+	float        v;
+};
+
+class CTriangleBVH
+{
+public:
+	/*-----------------------------------------------------------------------------------------
+		Constructors
+	-----------------------------------------------------------------------------------------*/
+
+	// Construct an empty tree, nothing will be hit
+	CTriangleBVH() {}
+
+	// Construct from an indexed triangle list, see Build
+	CTriangleBVH(const CVector3* positions, size_t stride, const uint32_t* indices, size_t numIndices)
+	{
+		Build(positions, stride, indices, numIndices);
+	}
+
+
+	/*-----------------------------------------------------------------------------------------
+		Member functions
+	-----------------------------------------------------------------------------------------*/
+
+	// Build the tree from an indexed triangle list (three indices per triangle), replacing any existing tree
+	// Vertex positions are read stride bytes apart so they can come straight from a vertex buffer
+	void Build(const CVector3* positions, size_t stride, const uint32_t* indices, size_t numIndices);
+
+	// Find the nearest triangle hit by the ray within maxDistance. Both sides of a triangle are hit. Returns
+	// false if nothing was hit. The ray direction doesn't need to be unit length, distances are measured in
+	// units of its length - so a ray transformed into model space gives the same distances as in world space
+	bool RayCast(const CRay& ray, float maxDistance, SRayTriangleHit& hit) const;
+
+	// Return true if the ray hits any triangle within maxDistance - quicker than finding the nearest, for
+	// line of sight tests
+	bool RayCastAny(const CRay& ray, float maxDistance) const;
+
+	// Box around all the triangles / number of triangles in the tree
+	const CAABB& Bounds() const       { return mBounds; }
+	size_t       NumTriangles() const { return mTriangles.size(); }
+
+
+private:
+	// Triangles are stored in tree order as a vertex and two edges, ready for the ray test
+	struct STriangle
+	{
+		CVector3 vertex0;
+		CVector3 edge1;
+		CVector3 edge2;
+	};
+
+	// Nodes are stored depth first, so the first child of a node is the next node in the array
+	// A leaf holds count triangles starting at first, otherwise count is 0 and first is the second child
+	struct SNode
+	{
+		CAABB    bounds;
+		uint32_t first;
+		uint32_t count;
+	};
+
+	// Shared traversal for the two ray casts, stops at the first hit found if anyHit is set
+	bool Traverse(const CRay& ray, float maxDistance, bool anyHit, SRayTriangleHit& hit) const;
+
+	// Trees are built with a depth limit so traversal can use a fixed size stack
+	static const int MaxDepth = 96;
+
+	std::vector<SNode>     mNodes;
+	std::vector<STriangle> mTriangles;
+	std::vector<uint32_t>  mTriangleIndices; // Original index of each triangle in mTriangles
+	CAABB                  mBounds = EmptyAABB();
+};
+
+} } //Namespaces
+#endif // _CTRIANGLE_BVH_H_DEFINED_
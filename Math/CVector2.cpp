@@ -44,29 +44,10 @@ CVector2& CVector2::operator+ ()
 }
 
 
-// Vector-vector addition
-CVector2 operator+ (const CVector2& v, const CVector2& w)
-{
-	return CVector2{ v.x + w.x, v.y + w.y };
-}
-
-// Vector-vector subtraction
-CVector2 operator- (const CVector2& v, const CVector2& w)
-{
-	return CVector2{ v.x - w.x, v.y - w.y };
-}
-
-
 /*-----------------------------------------------------------------------------------------
 	Non-member functions
 -----------------------------------------------------------------------------------------*/
 
-// Dot product of two given vectors (order not important) - non-member version
-float Dot(const CVector2& v1, const CVector2& v2)
-{
-	return v1.x * v2.x + v1.y * v2.y;
-}
-
 // Return unit length vector in the same direction as given one
 CVector2 Normalise(const CVector2& v)
 {
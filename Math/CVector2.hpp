@@ -31,18 +31,12 @@ public:
 	CVector2() {}
 
 	// Construct with 2 values
-	CVector2(const float xIn, const float yIn)
-	{
-		x = xIn;
-		y = yIn;
-	}
+	constexpr CVector2(const float xIn, const float yIn)
+		: x(xIn), y(yIn) {}
 
 	// Construct using a pointer to 2 floats
-	CVector2(const float* pfElts)
-	{
-		x = pfElts[0];
-		y = pfElts[1];
-	}
+	constexpr CVector2(const float* pfElts)
+		: x(pfElts[0]), y(pfElts[1]) {}
 
 
 	/*-----------------------------------------------------------------------------------------
@@ -67,11 +61,19 @@ public:
 	Non-member operators
 -----------------------------------------------------------------------------------------*/
 
+// The simple operators and functions are constexpr so they can be used to build constant data at compile time
+
 // Vector-vector addition
-CVector2 operator+ (const CVector2& v, const CVector2& w);
+constexpr CVector2 operator+ (const CVector2& v, const CVector2& w)
+{
+	return CVector2{ v.x + w.x, v.y + w.y };
+}
 
 // Vector-vector subtraction
-CVector2 operator- (const CVector2& v, const CVector2& w);
+constexpr CVector2 operator- (const CVector2& v, const CVector2& w)
+{
+	return CVector2{ v.x - w.x, v.y - w.y };
+}
 
 
 /*-----------------------------------------------------------------------------------------
@@ -79,7 +81,10 @@ Non-member functions
 -----------------------------------------------------------------------------------------*/
 
 // Dot product of two given vectors (order not important) - non-member version
-float Dot(const CVector2& v1, const CVector2& v2);
+constexpr float Dot(const CVector2& v1, const CVector2& v2)
+{
+	return v1.x * v2.x + v1.y * v2.y;
+}
 
 // Return unit length vector in the same direction as given one
 CVector2 Normalise(const CVector2& v);
@@ -57,44 +57,10 @@ CVector3& CVector3::operator*= (const float s)
 }
 
 
-// Vector-vector addition
-CVector3 operator+ (const CVector3& v, const CVector3& w)
-{
-	return CVector3{ v.x + w.x, v.y + w.y, v.z + w.z };
-}
-
-// Vector-vector subtraction
-CVector3 operator- (const CVector3& v, const CVector3& w)
-{
-	return CVector3{ v.x - w.x, v.y - w.y, v.z - w.z };
-}
-
-// Vector-scalar multiplication
-CVector3 operator* (const CVector3& v, float s)
-{
-	return CVector3{ v.x * s, v.y * s, v.z * s };
-}
-CVector3 operator* (float s, const CVector3& v)
-{
-	return CVector3{ v.x * s, v.y * s, v.z * s };
-}
-
 /*-----------------------------------------------------------------------------------------
 	Non-member functions
 -----------------------------------------------------------------------------------------*/
 
-// Dot product of two given vectors (order not important) - non-member version
-float Dot(const CVector3& v1, const CVector3& v2)
-{
-	return v1.x * v2.x + v1.y * v2.y + v1.z * v2.z;
-}
-
-// Cross product of two given vectors (order is important) - non-member version
-CVector3 Cross(const CVector3& v1, const CVector3& v2)
-{
-	return CVector3{ v1.y * v2.z - v1.z * v2.y, v1.z * v2.x - v1.x * v2.z, v1.x * v2.y - v1.y * v2.x };
-}
-
 // Return unit length vector in the same direction as given one
 CVector3 Normalise(const CVector3& v)
 {
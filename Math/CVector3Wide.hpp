@@ -0,0 +1,328 @@
+//--------------------------------------------------------------------------------------
+// Wide Vector3 classes (CVector3x4, CVector3x8), to hold 4 or 8 points / vectors at once
+//--------------------------------------------------------------------------------------
+// Code in header so everything inlines down to SSE / AVX instructions (see WideFloat.hpp)
+// Stored as a structure of arrays: all the x values in one register, all the y values in another etc.,
+// so each operation works on every vector at once. The operations match the CVector3 functions of the
+// same name step for step, so each lane gives exactly the result the scalar function would for that vector
+//
+// Typical use - load a batch of vectors from an array, work on them, store them back:
+//     for (; i + 4 <= count; i += 4)
+//     {
+//         CVector3x4 v = CVector3x4::LoadAoS(&particles[i].velocity, sizeof(SParticle));
+//         ...
+//         v.StoreAoS(&particles[i].velocity, sizeof(SParticle));
+//     }
+// then finish any leftovers with the scalar CVector3 functions
+
+#ifndef _CVECTOR3WIDE_H_DEFINED_
+#define _CVECTOR3WIDE_H_DEFINED_
+
+#include "CVector3.hpp"
+#include "WideFloat.hpp"
+#include "MathHelpers.hpp"
+
+#include <cstddef>
+
+namespace umbra_engine
+{
+namespace maths
+{
+
+// TFloat is CFloat4 or CFloat8, use the CVector3x4 / CVector3x8 names below
+template <typename TFloat>
+class CVector3Wide
+{
+	// Concrete class - public access
+public:
+	static const int WIDTH = TFloat::WIDTH;
+
+	// Vector components, one lane per vector
+	TFloat x;
+	TFloat y;
+	TFloat z;
+
+	/*-----------------------------------------------------------------------------------------
+		Constructors
+	-----------------------------------------------------------------------------------------*/
+
+	// Default constructor - leaves values uninitialised (for performance)
+	CVector3Wide() {}
+
+	// Construct from the x, y and z values of every lane
+	CVector3Wide(const TFloat& xIn, const TFloat& yIn, const TFloat& zIn) : x(xIn), y(yIn), z(zIn) {}
+
+	// Set every lane to the same vector
+	explicit CVector3Wide(const CVector3& v) : x(v.x), y(v.y), z(v.z) {}
+
+
+	/*-----------------------------------------------------------------------------------------
+		Loading and storing
+	-----------------------------------------------------------------------------------------*/
+
+	// Load / store WIDTH vectors from an array of CVector3 (AoS), each stride bytes apart. Tightly packed
+	// arrays (stride of sizeof(CVector3)) are loaded with whole-register loads and shuffles. Exactly WIDTH
+	// vectors are read or written, never any memory beyond them
+	static CVector3Wide LoadAoS(const CVector3* in, size_t stride = sizeof(CVector3));
+	void StoreAoS(CVector3* out, size_t stride = sizeof(CVector3)) const;
+
+	// Load / store WIDTH vectors from separate x, y and z arrays (SoA)
+	static CVector3Wide LoadSoA(const float* inX, const float* inY, const float* inZ)
+	{
+		return CVector3Wide{ TFloat::Load(inX), TFloat::Load(inY), TFloat::Load(inZ) };
+	}
+	void StoreSoA(float* outX, float* outY, float* outZ) const
+	{
+		x.Store(outX);
+		y.Store(outY);
+		z.Store(outZ);
+	}
+
+	// The vector in a single lane. Slow, use for debugging or the odd leftover value
+	CVector3 Get(int lane) const { return CVector3{ x[lane], y[lane], z[lane] }; }
+
+
+	/*-----------------------------------------------------------------------------------------
+		Member functions
+	-----------------------------------------------------------------------------------------*/
+
+	CVector3Wide& operator+= (const CVector3Wide& v) { x = x + v.x; y = y + v.y; z = z + v.z; return *this; }
+	CVector3Wide& operator-= (const CVector3Wide& v) { x = x - v.x; y = y - v.y; z = z - v.z; return *this; }
+	CVector3Wide& operator*= (const TFloat& s)       { x = x * s;   y = y * s;   z = z * s;   return *this; }
+};
+
+using CVector3x4 = CVector3Wide<CFloat4>;
+using CVector3x8 = CVector3Wide<CFloat8>;
+
+
+/*-----------------------------------------------------------------------------------------
+	Non-member operators
+-----------------------------------------------------------------------------------------*/
+
+// Vector-vector addition / subtraction
+template <typename TFloat>
+inline CVector3Wide<TFloat> operator+ (const CVector3Wide<TFloat>& v, const CVector3Wide<TFloat>& w)
+{
+	return CVector3Wide<TFloat>{ v.x + w.x, v.y + w.y, v.z + w.z };
+}
+
+template <typename TFloat>
+inline CVector3Wide<TFloat> operator- (const CVector3Wide<TFloat>& v, const CVector3Wide<TFloat>& w)
+{
+	return CVector3Wide<TFloat>{ v.x - w.x, v.y - w.y, v.z - w.z };
+}
+
+template <typename TFloat>
+inline CVector3Wide<TFloat> operator- (const CVector3Wide<TFloat>& v)
+{
+	return CVector3Wide<TFloat>{ -v.x, -v.y, -v.z };
+}
+
+// Vector-scalar multiplication / division. The scalar can differ per lane, or be a single float
+template <typename TFloat>
+inline CVector3Wide<TFloat> operator* (const CVector3Wide<TFloat>& v, const TFloat& s)
+{
+	return CVector3Wide<TFloat>{ v.x * s, v.y * s, v.z * s };
+}
+
+template <typename TFloat>
+inline CVector3Wide<TFloat> operator* (const TFloat& s, const CVector3Wide<TFloat>& v)
+{
+	return CVector3Wide<TFloat>{ v.x * s, v.y * s, v.z * s };
+}
+
+template <typename TFloat>
+inline CVector3Wide<TFloat> operator* (const CVector3Wide<TFloat>& v, float s)
+{
+	return v * TFloat(s);
+}
+
+template <typename TFloat>
+inline CVector3Wide<TFloat> operator* (float s, const CVector3Wide<TFloat>& v)
+{
+	return v * TFloat(s);
+}
+
+template <typename TFloat>
+inline CVector3Wide<TFloat> operator/ (const CVector3Wide<TFloat>& v, const TFloat& s)
+{
+	return CVector3Wide<TFloat>{ v.x / s, v.y / s, v.z / s };
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Non-member functions
+-----------------------------------------------------------------------------------------*/
+
+// Dot product of each pair of vectors
+template <typename TFloat>
+inline TFloat Dot(const CVector3Wide<TFloat>& v1, const CVector3Wide<TFloat>& v2)
+{
+	return v1.x * v2.x + v1.y * v2.y + v1.z * v2.z;
+}
+
+// Cross product of each pair of vectors (order is important)
+template <typename TFloat>
+inline CVector3Wide<TFloat> Cross(const CVector3Wide<TFloat>& v1, const CVector3Wide<TFloat>& v2)
+{
+	return CVector3Wide<TFloat>{ v1.y * v2.z - v1.z * v2.y, v1.z * v2.x - v1.x * v2.z, v1.x * v2.y - v1.y * v2.x };
+}
+
+// Length of each vector
+template <typename TFloat>
+inline TFloat Length(const CVector3Wide<TFloat>& v)
+{
+	return Sqrt(Dot(v, v));
+}
+
+// Unit length vectors in the same directions as the given ones. Lanes with (near) zero length give a zero vector
+template <typename TFloat>
+inline CVector3Wide<TFloat> Normalise(const CVector3Wide<TFloat>& v)
+{
+	TFloat lengthSq = v.x * v.x + v.y * v.y + v.z * v.z;
+	TFloat invLength = TFloat(1.0f) / Sqrt(lengthSq);
+	TFloat isZero = Abs(lengthSq) < TFloat(EPSILON);
+	TFloat zero(0.0f);
+	return CVector3Wide<TFloat>{ Select(isZero, zero, v.x * invLength),
+	                             Select(isZero, zero, v.y * invLength),
+	                             Select(isZero, zero, v.z * invLength) };
+}
+
+// Lane-wise minimum / maximum of each component
+template <typename TFloat>
+inline CVector3Wide<TFloat> Min(const CVector3Wide<TFloat>& v, const CVector3Wide<TFloat>& w)
+{
+	return CVector3Wide<TFloat>{ Min(v.x, w.x), Min(v.y, w.y), Min(v.z, w.z) };
+}
+
+template <typename TFloat>
+inline CVector3Wide<TFloat> Max(const CVector3Wide<TFloat>& v, const CVector3Wide<TFloat>& w)
+{
+	return CVector3Wide<TFloat>{ Max(v.x, w.x), Max(v.y, w.y), Max(v.z, w.z) };
+}
+
+// Vectors from a where the mask is set, otherwise from b. Masks come from comparisons, e.g. Dot(v, n) < 0.0f
+template <typename TFloat>
+inline CVector3Wide<TFloat> Select(const TFloat& mask, const CVector3Wide<TFloat>& a, const CVector3Wide<TFloat>& b)
+{
+	return CVector3Wide<TFloat>{ Select(mask, a.x, b.x), Select(mask, a.y, b.y), Select(mask, a.z, b.z) };
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Loading and storing
+-----------------------------------------------------------------------------------------*/
+
+namespace wide_vector_detail
+{
+// Step a pointer on by a number of bytes (for strided arrays)
+template <typename T>
+inline T* Advance(T* p, size_t bytes)
+{
+	return reinterpret_cast<T*>(reinterpret_cast<char*>(p) + bytes);
+}
+
+template <typename T>
+inline const T* Advance(const T* p, size_t bytes)
+{
+	return reinterpret_cast<const T*>(reinterpret_cast<const char*>(p) + bytes);
+}
+}
+
+#if defined(UMBRA_MATHS_X86)
+
+template <>
+inline CVector3x4 CVector3x4::LoadAoS(const CVector3* in, size_t stride)
+{
+	if (stride == sizeof(CVector3))
+	{
+		// Transpose x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3 to x0 x1 x2 x3 | y0 y1 y2 y3 | z0 z1 z2 z3
+		const float* p = &in->x;
+		__m128 a = _mm_loadu_ps(p);
+		__m128 b = _mm_loadu_ps(p + 4);
+		__m128 c = _mm_loadu_ps(p + 8);
+		__m128 x = _mm_shuffle_ps(a, _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 3, 0));
+		__m128 y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+		__m128 z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)), _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+		return CVector3x4{ x, y, z };
+	}
+
+	const CVector3* v0 = in;
+	const CVector3* v1 = wide_vector_detail::Advance(v0, stride);
+	const CVector3* v2 = wide_vector_detail::Advance(v1, stride);
+	const CVector3* v3 = wide_vector_detail::Advance(v2, stride);
+	return CVector3x4{ _mm_setr_ps(v0->x, v1->x, v2->x, v3->x), _mm_setr_ps(v0->y, v1->y, v2->y, v3->y), _mm_setr_ps(v0->z, v1->z, v2->z, v3->z) };
+}
+
+template <>
+inline void CVector3x4::StoreAoS(CVector3* out, size_t stride) const
+{
+	if (stride == sizeof(CVector3))
+	{
+		// Transpose back to x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3
+		float* p = &out->x;
+		__m128 xy01 = _mm_unpacklo_ps(x.v, y.v);
+		__m128 a = _mm_shuffle_ps(xy01, _mm_shuffle_ps(z.v, x.v, _MM_SHUFFLE(1, 1, 0, 0)), _MM_SHUFFLE(2, 0, 1, 0));
+		__m128 b = _mm_shuffle_ps(_mm_shuffle_ps(y.v, z.v, _MM_SHUFFLE(1, 1, 1, 1)), _mm_shuffle_ps(x.v, y.v, _MM_SHUFFLE(2, 2, 2, 2)), _MM_SHUFFLE(2, 0, 2, 0));
+		__m128 c = _mm_shuffle_ps(_mm_shuffle_ps(z.v, x.v, _MM_SHUFFLE(3, 3, 2, 2)), _mm_shuffle_ps(y.v, z.v, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+		_mm_storeu_ps(p, a);
+		_mm_storeu_ps(p + 4, b);
+		_mm_storeu_ps(p + 8, c);
+		return;
+	}
+
+	alignas(16) float xs[4], ys[4], zs[4];
+	StoreSoA(xs, ys, zs);
+	for (int i = 0; i < 4; ++i)
+	{
+		*out = CVector3{ xs[i], ys[i], zs[i] };
+		out = wide_vector_detail::Advance(out, stride);
+	}
+}
+
+#else
+
+template <>
+inline CVector3x4 CVector3x4::LoadAoS(const CVector3* in, size_t stride)
+{
+	CVector3x4 r;
+	for (int i = 0; i < 4; ++i)
+	{
+		r.x.v[i] = in->x;
+		r.y.v[i] = in->y;
+		r.z.v[i] = in->z;
+		in = wide_vector_detail::Advance(in, stride);
+	}
+	return r;
+}
+
+template <>
+inline void CVector3x4::StoreAoS(CVector3* out, size_t stride) const
+{
+	for (int i = 0; i < 4; ++i)
+	{
+		*out = CVector3{ x.v[i], y.v[i], z.v[i] };
+		out = wide_vector_detail::Advance(out, stride);
+	}
+}
+
+#endif
+
+// 8 vectors are loaded / stored as two sets of 4
+template <>
+inline CVector3x8 CVector3x8::LoadAoS(const CVector3* in, size_t stride)
+{
+	CVector3x4 low = CVector3x4::LoadAoS(in, stride);
+	CVector3x4 high = CVector3x4::LoadAoS(wide_vector_detail::Advance(in, 4 * stride), stride);
+	return CVector3x8{ CFloat8{ low.x, high.x }, CFloat8{ low.y, high.y }, CFloat8{ low.z, high.z } };
+}
+
+template <>
+inline void CVector3x8::StoreAoS(CVector3* out, size_t stride) const
+{
+	CVector3x4{ x.Low(), y.Low(), z.Low() }.StoreAoS(out, stride);
+	CVector3x4{ x.High(), y.High(), z.High() }.StoreAoS(wide_vector_detail::Advance(out, 4 * stride), stride);
+}
+
+} } //Namespaces
+#endif // _CVECTOR3WIDE_H_DEFINED_
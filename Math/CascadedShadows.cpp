@@ -0,0 +1,174 @@
+//--------------------------------------------------------------------------------------
+// Cascaded shadow maps - split distances, per-cascade orthographic fitting and cascade selection
+//--------------------------------------------------------------------------------------
+
+#include "CascadedShadows.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace umbra_engine
+{
+namespace maths
+{
+namespace
+{
+// Transform a point (w = 1) by an affine matrix
+inline CVector3 TransformPoint(const CMatrix4x4& m, const CVector3& p)
+{
+	return CVector3{ p.x * m.e00 + p.y * m.e10 + p.z * m.e20 + m.e30,
+	                 p.x * m.e01 + p.y * m.e11 + p.z * m.e21 + m.e31,
+	                 p.x * m.e02 + p.y * m.e12 + p.z * m.e22 + m.e32 };
+}
+
+// Return the rotation into light space for a light shining along the given direction. Depends only on the
+// direction, so the shadow map grid stays fixed in the world while the camera moves
+CMatrix4x4 LightRotation(const CVector3& lightDirection)
+{
+	CVector3 forward = Normalise(lightDirection);
+	CVector3 up = (std::abs(forward.y) < 0.99f) ? CVector3{ 0.0f, 1.0f, 0.0f } : CVector3{ 0.0f, 0.0f, 1.0f };
+	CVector3 right = Normalise(Cross(up, forward));
+	up = Cross(forward, right);
+
+	// Inverse of the rotation with these axes as rows, which is its transpose
+	return CMatrix4x4{ right.x, up.x, forward.x, 0.0f,
+	                   right.y, up.y, forward.y, 0.0f,
+	                   right.z, up.z, forward.z, 0.0f,
+	                   0.0f,    0.0f, 0.0f,      1.0f };
+}
+
+// Rebuild the projection matrices of a cascade from its volume
+void UpdateProjection(SCascade& cascade)
+{
+	const CAABB& v = cascade.volume;
+	cascade.projectionMatrix = MakeOrthographicMatrix(v.minimum.x, v.maximum.x, v.minimum.y, v.maximum.y, v.minimum.z, v.maximum.z);
+	cascade.viewProjectionMatrix = cascade.viewMatrix * cascade.projectionMatrix;
+}
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Fitting
+-----------------------------------------------------------------------------------------*/
+
+// Write numCascades + 1 distances splitting nearClip to farClip into cascades
+void CascadeSplits(float nearClip, float farClip, int numCascades, float blend, float* splits)
+{
+	splits[0] = nearClip;
+	for (int i = 1; i < numCascades; ++i)
+	{
+		float fraction = static_cast<float>(i) / numCascades;
+		float logSplit = nearClip * std::pow(farClip / nearClip, fraction);
+		float evenSplit = nearClip + (farClip - nearClip) * fraction;
+		splits[i] = blend * logSplit + (1.0f - blend) * evenSplit;
+	}
+	splits[numCascades] = farClip;
+}
+
+// Write the 8 world space corners of the slice of a camera's view between two distances
+void FrustumSliceCorners(const CMatrix4x4& cameraWorld, const CMatrix4x4& cameraProjection, float sliceNear,
+                         float sliceFar, CVector3* corners)
+{
+	// The projection scales x and y by 1 / tan of the half field of view, so a point at distance d along the view
+	// is on the edge of the screen d * tan away from the centre
+	float tanHalfX = 1.0f / cameraProjection.e00;
+	float tanHalfY = 1.0f / cameraProjection.e11;
+
+	CVector3 position = cameraWorld.GetPosition();
+	CVector3 right = Normalise(cameraWorld.GetXAxis());
+	CVector3 up = Normalise(cameraWorld.GetYAxis());
+	CVector3 forward = Normalise(cameraWorld.GetZAxis());
+
+	const float distances[2] = { sliceNear, sliceFar };
+	for (int i = 0; i < 2; ++i)
+	{
+		float d = distances[i];
+		CVector3 centre = position + forward * d;
+		CVector3 x = right * (tanHalfX * d);
+		CVector3 y = up * (tanHalfY * d);
+		corners[i * 4 + 0] = centre - x - y;
+		corners[i * 4 + 1] = centre + x - y;
+		corners[i * 4 + 2] = centre - x + y;
+		corners[i * 4 + 3] = centre + x + y;
+	}
+}
+
+// Return an orthographic projection for the given light space box
+CMatrix4x4 MakeOrthographicMatrix(float left, float right, float bottom, float top, float nearClip, float farClip)
+{
+	return CMatrix4x4{ 2.0f / (right - left),            0.0f,                             0.0f,                            0.0f,
+	                   0.0f,                             2.0f / (top - bottom),            0.0f,                            0.0f,
+	                   0.0f,                             0.0f,                             1.0f / (farClip - nearClip),     0.0f,
+	                   (left + right) / (left - right),  (bottom + top) / (bottom - top),  nearClip / (nearClip - farClip), 1.0f };
+}
+
+// Fit a cascade around the corners of a view slice
+SCascade FitCascade(const CVector3& lightDirection, const CVector3* sliceCorners, int shadowMapSize, float casterDistance)
+{
+	SCascade cascade;
+	cascade.viewMatrix = LightRotation(lightDirection);
+
+	// Bounding sphere of the slice. Its centre is on the view axis and its radius is the same whichever way the
+	// camera faces, so the cascade doesn't change size as the camera turns. The radius is rounded up so
+	// rounding errors as the camera moves don't change it either
+	CVector3 centre{ 0.0f, 0.0f, 0.0f };
+	for (int i = 0; i < 8; ++i)
+	{
+		centre = centre + sliceCorners[i];
+	}
+	centre = centre * (1.0f / 8.0f);
+	float radius = 0.0f;
+	for (int i = 0; i < 8; ++i)
+	{
+		radius = std::max(radius, Length(sliceCorners[i] - centre));
+	}
+	radius = std::ceil(radius * 16.0f) / 16.0f;
+
+	// Move the centre to a whole texel in light space, so as the camera moves the shadow map moves a whole
+	// number of texels and every texel samples the same part of the scene as before. Snapping moves the centre
+	// by up to a texel, so the map is a texel wider than the sphere on each side to keep the whole slice in it
+	CVector3 lightCentre = TransformPoint(cascade.viewMatrix, centre);
+	float texelSize = 2.0f * radius / (shadowMapSize - 2);
+	lightCentre.x = std::floor(lightCentre.x / texelSize) * texelSize;
+	lightCentre.y = std::floor(lightCentre.y / texelSize) * texelSize;
+
+	float halfWidth = radius + texelSize;
+	CVector3 extents{ halfWidth, halfWidth, radius };
+	cascade.volume = CAABB{ lightCentre - extents, lightCentre + extents };
+	cascade.receiverNear = cascade.volume.minimum.z;
+	cascade.volume.minimum.z -= casterDistance;
+	UpdateProjection(cascade);
+	return cascade;
+}
+
+// Bring the near plane of a cascade in to the nearest caster
+void FitCascadeDepth(SCascade& cascade, const CAABB* casterBounds, size_t count)
+{
+	float nearZ = cascade.receiverNear;
+	for (size_t i = 0; i < count; ++i)
+	{
+		nearZ = std::min(nearZ, Transform(casterBounds[i], cascade.viewMatrix).minimum.z);
+	}
+	cascade.volume.minimum.z = std::max(cascade.volume.minimum.z, nearZ);
+	UpdateProjection(cascade);
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Selection
+-----------------------------------------------------------------------------------------*/
+
+// Return the first cascade whose shadow map covers the point
+int SelectCascade(const SCascade* cascades, int numCascades, const CVector3& point, float border /*= 0.0f*/)
+{
+	float limit = 1.0f - border;
+	for (int i = 0; i < numCascades; ++i)
+	{
+		// Orthographic, so no perspective divide
+		CVector3 p = TransformPoint(cascades[i].viewProjectionMatrix, point);
+		if (std::abs(p.x) <= limit && std::abs(p.y) <= limit && p.z >= 0.0f && p.z <= 1.0f) return i;
+	}
+	return -1;
+}
+
+} } //Namespaces
@@ -0,0 +1,74 @@
+//--------------------------------------------------------------------------------------
+// Cascaded shadow maps - split distances, per-cascade orthographic fitting and cascade selection
+//--------------------------------------------------------------------------------------
+// Code in .cpp file
+// A directional light's shadow is split into several maps along the camera's view: each cascade covers one slice
+// of the view frustum with the same map resolution, so nearby shadows get many texels and distant ones few
+// Each cascade is fitted around the bounding sphere of its slice, so its size doesn't change as the camera turns,
+// and is moved in whole shadow map texels, so shadow edges don't shimmer as the camera moves
+// Matrices are in this app's layout (row vectors, D3D depth range 0 to 1). No graphics API is used
+
+#ifndef _CCASCADED_SHADOWS_H_DEFINED_
+#define _CCASCADED_SHADOWS_H_DEFINED_
+
+#include "Geometry.hpp"
+#include "CMatrix4x4.hpp"
+
+#include <cstddef>
+
+namespace umbra_engine
+{
+namespace maths
+{
+
+// One cascade of a directional light's shadow
+struct SCascade
+{
+	CMatrix4x4 viewMatrix;           // Rotation to light space (light looking along +Z), no translation
+	CMatrix4x4 projectionMatrix;     // Orthographic projection of the volume below
+	CMatrix4x4 viewProjectionMatrix;
+	CAABB      volume;               // Light space box covered by the shadow map
+	float      receiverNear;         // Light space z of the front of the slice's sphere, casters may be nearer the light
+};
+
+
+/*-----------------------------------------------------------------------------------------
+	Fitting
+-----------------------------------------------------------------------------------------*/
+
+// Write numCascades + 1 distances along the view splitting nearClip to farClip into cascades (first is nearClip,
+// last is farClip). Blend 0 gives even splits, 1 logarithmic splits (same ratio far / near for every cascade),
+// values in between are the "practical" mix of the two
+void CascadeSplits(float nearClip, float farClip, int numCascades, float blend, float* splits);
+
+// Write the 8 world space corners of the slice of a camera's view between two distances along its view. Takes
+// the camera's world and perspective projection matrices. Near corners first, each as bottom-left, bottom-right,
+// top-left, top-right
+void FrustumSliceCorners(const CMatrix4x4& cameraWorld, const CMatrix4x4& cameraProjection, float sliceNear,
+                         float sliceFar, CVector3* corners);
+
+// Return an orthographic projection for the light space box from left to right, bottom to top and near to far
+CMatrix4x4 MakeOrthographicMatrix(float left, float right, float bottom, float top, float nearClip, float farClip);
+
+// Fit a cascade for a light shining in the given direction around the 8 corners of a view slice, for a square
+// shadow map of the given size. The volume reaches casterDistance further back towards the light than the slice
+// so that casters outside the slice still shade it. The result only moves in whole texels
+SCascade FitCascade(const CVector3& lightDirection, const CVector3* sliceCorners, int shadowMapSize, float casterDistance);
+
+// Bring the near plane of a cascade in to the nearest of the given world space caster boxes, for better depth
+// precision. Never cuts into the slice itself. Use the casters found inside the cascade fitted above
+void FitCascadeDepth(SCascade& cascade, const CAABB* casterBounds, size_t count);
+
+
+/*-----------------------------------------------------------------------------------------
+	Selection
+-----------------------------------------------------------------------------------------*/
+
+// Return the first cascade whose shadow map covers the world space point, -1 if none do. Border is a margin
+// kept clear around the edge of each map in clip space units (2 / shadow map size per texel), e.g. for filtering
+// Cascades are tested by their own matrices rather than by split distance, so a cascade that was rendered with
+// older matrices (see CShadowScheduler) is still only used where it is valid. Mirrored by main_ps.hlsl
+int SelectCascade(const SCascade* cascades, int numCascades, const CVector3& point, float border = 0.0f);
+
+} } //Namespaces
+#endif // _CCASCADED_SHADOWS_H_DEFINED_
@@ -0,0 +1,260 @@
+//--------------------------------------------------------------------------------------
+// Fast sine and cosine, calculated together and 1, 4 or 8 angles at a time
+//--------------------------------------------------------------------------------------
+// Range reduction constants are the Cephes single precision ones, the polynomials are the Cephes
+// sinf/cosf minimax polynomials for [-pi/4, pi/4]. The SIMD versions keep the scalar order of
+// operations (no fused multiply-adds) so every version gives exactly the same results
+
+#include "FastTrig.hpp"
+#include "SIMD.hpp"
+
+#include <cmath>
+
+namespace umbra_engine
+{
+namespace maths
+{
+namespace
+{
+// Angle is reduced by a whole number of quarter turns, q, then r = angle - q * pi/2
+// pi/2 is held in three parts, the first two with few enough bits that q * part is exact
+const float TWO_OVER_PI = 0.636619772367581343f;
+const float HALF_PI_A = 1.5703125f;
+const float HALF_PI_B = 4.837512969970703125e-4f;
+const float HALF_PI_C = 7.54978995489188216e-8f;
+
+// sin(r) = r + r * r^2 * (S1 + r^2 * (S2 + r^2 * S3))
+const float SIN_1 = -1.6666654611e-1f;
+const float SIN_2 = 8.3321608736e-3f;
+const float SIN_3 = -1.9515295891e-4f;
+
+// cos(r) = 1 - r^2 / 2 + r^4 * (C1 + r^2 * (C2 + r^2 * C3))
+const float COS_1 = 4.166664568298827e-2f;
+const float COS_2 = -1.388731625493765e-3f;
+const float COS_3 = 2.443315711809948e-5f;
+
+
+/*-----------------------------------------------------------------------------------------
+	Scalar version
+-----------------------------------------------------------------------------------------*/
+
+inline void SinCosScalar(float angle, float& s, float& c)
+{
+	// Nearest quarter turn, ties to even like the SSE conversion
+	int q = static_cast<int>(std::nearbyint(angle * TWO_OVER_PI));
+	float qf = static_cast<float>(q);
+
+	float r = angle - qf * HALF_PI_A;
+	r = r - qf * HALF_PI_B;
+	r = r - qf * HALF_PI_C;
+	float z = r * r;
+
+	float sr = r + (r * z) * (SIN_1 + z * (SIN_2 + z * SIN_3));
+	float cr = (1.0f - 0.5f * z) + (z * z) * (COS_1 + z * (COS_2 + z * COS_3));
+
+	// Odd quarter turns swap sin and cos, then the quadrant gives the signs
+	if (q & 1)
+	{
+		float t = sr;
+		sr = cr;
+		cr = t;
+	}
+	s = (q & 2) ? -sr : sr;
+	c = ((q + 1) & 2) ? -cr : cr;
+}
+
+
+#if defined(UMBRA_MATHS_X86)
+/*-----------------------------------------------------------------------------------------
+	SSE version
+-----------------------------------------------------------------------------------------*/
+
+// sin and cos of the reduced angle r, which is in [-pi/4, pi/4]
+inline void SinCosReducedSSE(__m128 r, __m128& sr, __m128& cr)
+{
+	__m128 z = _mm_mul_ps(r, r);
+
+	__m128 ps = _mm_add_ps(_mm_set1_ps(SIN_2), _mm_mul_ps(z, _mm_set1_ps(SIN_3)));
+	ps = _mm_add_ps(_mm_set1_ps(SIN_1), _mm_mul_ps(z, ps));
+	sr = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(r, z), ps));
+
+	__m128 pc = _mm_add_ps(_mm_set1_ps(COS_2), _mm_mul_ps(z, _mm_set1_ps(COS_3)));
+	pc = _mm_add_ps(_mm_set1_ps(COS_1), _mm_mul_ps(z, pc));
+	cr = _mm_add_ps(_mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(_mm_set1_ps(0.5f), z)), _mm_mul_ps(_mm_mul_ps(z, z), pc));
+}
+
+inline void SinCosSSE(__m128 angle, __m128& s, __m128& c)
+{
+	__m128i q = _mm_cvtps_epi32(_mm_mul_ps(angle, _mm_set1_ps(TWO_OVER_PI)));
+	__m128 qf = _mm_cvtepi32_ps(q);
+
+	__m128 r = _mm_sub_ps(angle, _mm_mul_ps(qf, _mm_set1_ps(HALF_PI_A)));
+	r = _mm_sub_ps(r, _mm_mul_ps(qf, _mm_set1_ps(HALF_PI_B)));
+	r = _mm_sub_ps(r, _mm_mul_ps(qf, _mm_set1_ps(HALF_PI_C)));
+
+	__m128 sr, cr;
+	SinCosReducedSSE(r, sr, cr);
+
+	// Swap where q is odd, then flip sign bits using bit 1 of q (sin) and q + 1 (cos)
+	const __m128i one = _mm_set1_epi32(1);
+	const __m128i two = _mm_set1_epi32(2);
+	__m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(q, one), one));
+	__m128 sinSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(q, two), 30));
+	__m128 cosSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(q, one), two), 30));
+
+	s = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, cr), _mm_andnot_ps(swap, sr)), sinSign);
+	c = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, sr), _mm_andnot_ps(swap, cr)), cosSign);
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	AVX version
+-----------------------------------------------------------------------------------------*/
+
+// AVX has no 8-wide integer instructions (that's AVX2), so the quadrant is kept as a float. Splitting into
+// 4-wide integer halves instead made this slower than the SSE version.
+// Quarter turns are whole numbers well inside float precision for any angle in the documented range,
+// so the quadrant arithmetic below is exact and gives the same bits as the integer tests
+UMBRA_TARGET_AVX
+inline void SinCosAVX(__m256 angle, __m256& s, __m256& c)
+{
+	// Nearest quarter turn, ties to even as _mm_cvtps_epi32 does
+	__m256 qf = _mm256_round_ps(_mm256_mul_ps(angle, _mm256_set1_ps(TWO_OVER_PI)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+
+	__m256 r = _mm256_sub_ps(angle, _mm256_mul_ps(qf, _mm256_set1_ps(HALF_PI_A)));
+	r = _mm256_sub_ps(r, _mm256_mul_ps(qf, _mm256_set1_ps(HALF_PI_B)));
+	r = _mm256_sub_ps(r, _mm256_mul_ps(qf, _mm256_set1_ps(HALF_PI_C)));
+
+	__m256 z = _mm256_mul_ps(r, r);
+
+	__m256 ps = _mm256_add_ps(_mm256_set1_ps(SIN_2), _mm256_mul_ps(z, _mm256_set1_ps(SIN_3)));
+	ps = _mm256_add_ps(_mm256_set1_ps(SIN_1), _mm256_mul_ps(z, ps));
+	__m256 sr = _mm256_add_ps(r, _mm256_mul_ps(_mm256_mul_ps(r, z), ps));
+
+	__m256 pc = _mm256_add_ps(_mm256_set1_ps(COS_2), _mm256_mul_ps(z, _mm256_set1_ps(COS_3)));
+	pc = _mm256_add_ps(_mm256_set1_ps(COS_1), _mm256_mul_ps(z, pc));
+	__m256 cr = _mm256_add_ps(_mm256_sub_ps(_mm256_set1_ps(1.0f), _mm256_mul_ps(_mm256_set1_ps(0.5f), z)),
+	                          _mm256_mul_ps(_mm256_mul_ps(z, z), pc));
+
+	// Quadrant q & 3 as 0, 1, 2 or 3. Swap where it is odd, negate sin in quadrants 2 and 3 (bit 1 of q)
+	// and cos in quadrants 1 and 2 (bit 1 of q + 1)
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 two = _mm256_set1_ps(2.0f);
+	const __m256 signBit = _mm256_set1_ps(-0.0f);
+	__m256 quadrant = _mm256_sub_ps(qf, _mm256_mul_ps(_mm256_set1_ps(4.0f), _mm256_floor_ps(_mm256_mul_ps(qf, _mm256_set1_ps(0.25f)))));
+	__m256 odd = _mm256_sub_ps(quadrant, _mm256_mul_ps(two, _mm256_floor_ps(_mm256_mul_ps(quadrant, _mm256_set1_ps(0.5f)))));
+	__m256 swapMask = _mm256_cmp_ps(odd, one, _CMP_EQ_OQ);
+	__m256 sinSign = _mm256_and_ps(_mm256_cmp_ps(quadrant, two, _CMP_GE_OQ), signBit);
+	__m256 cosSign = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(quadrant, one, _CMP_GE_OQ), _mm256_cmp_ps(quadrant, two, _CMP_LE_OQ)), signBit);
+
+	// Select with and/or rather than _mm256_blendv_ps, which GCC lowers to element by element code without AVX2
+	s = _mm256_xor_ps(_mm256_or_ps(_mm256_and_ps(swapMask, cr), _mm256_andnot_ps(swapMask, sr)), sinSign);
+	c = _mm256_xor_ps(_mm256_or_ps(_mm256_and_ps(swapMask, sr), _mm256_andnot_ps(swapMask, cr)), cosSign);
+}
+
+UMBRA_TARGET_AVX
+void SinCos8AVX(const float* angles, float* sines, float* cosines)
+{
+	__m256 s, c;
+	SinCosAVX(_mm256_loadu_ps(angles), s, c);
+	_mm256_storeu_ps(sines, s);
+	_mm256_storeu_ps(cosines, c);
+	_mm256_zeroupper();
+}
+
+UMBRA_TARGET_AVX
+void SinCosArrayAVX(const float* angles, float* sines, float* cosines, size_t count)
+{
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 s, c;
+		SinCosAVX(_mm256_loadu_ps(angles + i), s, c);
+		_mm256_storeu_ps(sines + i, s);
+		_mm256_storeu_ps(cosines + i, c);
+	}
+	_mm256_zeroupper();
+	for (; i < count; ++i)
+	{
+		SinCosScalar(angles[i], sines[i], cosines[i]);
+	}
+}
+
+void SinCosArraySSE(const float* angles, float* sines, float* cosines, size_t count)
+{
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 s, c;
+		SinCosSSE(_mm_loadu_ps(angles + i), s, c);
+		_mm_storeu_ps(sines + i, s);
+		_mm_storeu_ps(cosines + i, c);
+	}
+	for (; i < count; ++i)
+	{
+		SinCosScalar(angles[i], sines[i], cosines[i]);
+	}
+}
+#endif
+
+void SinCosArrayScalar(const float* angles, float* sines, float* cosines, size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		SinCosScalar(angles[i], sines[i], cosines[i]);
+	}
+}
+}
+
+
+// Sine and cosine of a single angle (in radians)
+void SinCos(float angle, float& s, float& c)
+{
+	SinCosScalar(angle, s, c);
+}
+
+// Sines and cosines of 4 angles (in radians)
+void SinCos4(const float* angles, float* sines, float* cosines)
+{
+#if defined(UMBRA_MATHS_X86)
+	if (simd::ActiveInstructionSet() != simd::EInstructionSet::Scalar)
+	{
+		__m128 s, c;
+		SinCosSSE(_mm_loadu_ps(angles), s, c);
+		_mm_storeu_ps(sines, s);
+		_mm_storeu_ps(cosines, c);
+		return;
+	}
+#endif
+	SinCosArrayScalar(angles, sines, cosines, 4);
+}
+
+// Sines and cosines of 8 angles (in radians)
+void SinCos8(const float* angles, float* sines, float* cosines)
+{
+#if defined(UMBRA_MATHS_X86)
+	switch (simd::ActiveInstructionSet())
+	{
+	case simd::EInstructionSet::AVX: SinCos8AVX(angles, sines, cosines); return;
+	case simd::EInstructionSet::SSE: SinCosArraySSE(angles, sines, cosines, 8); return;
+	default: break;
+	}
+#endif
+	SinCosArrayScalar(angles, sines, cosines, 8);
+}
+
+// Sines and cosines of count angles (in radians), using the widest instruction set available
+void SinCos(const float* angles, float* sines, float* cosines, size_t count)
+{
+#if defined(UMBRA_MATHS_X86)
+	switch (simd::ActiveInstructionSet())
+	{
+	case simd::EInstructionSet::AVX: SinCosArrayAVX(angles, sines, cosines, count); return;
+	case simd::EInstructionSet::SSE: SinCosArraySSE(angles, sines, cosines, count); return;
+	default: break;
+	}
+#endif
+	SinCosArrayScalar(angles, sines, cosines, count);
+}
+
+} } //Namespaces
@@ -0,0 +1,570 @@
+//--------------------------------------------------------------------------------------
+// Geometric primitives - bounding volumes, planes, frustums and rays - and intersection tests
+//--------------------------------------------------------------------------------------
+// Box against plane: the box is outside if its centre is further behind the plane than the box's
+// "radius" along the plane normal, r = |n.x| * extent.x + |n.y| * extent.y + |n.z| * extent.z
+
+#include "Geometry.hpp"
+#include "MathHelpers.hpp"
+#include "SIMD.hpp"
+
+#include <algorithm>
+#include <cfloat>
+
+namespace umbra_engine
+{
+namespace maths
+{
+namespace
+{
+// Step a pointer on by a number of bytes (for strided arrays)
+template <typename T>
+inline const T* Advance(const T* p, size_t bytes)
+{
+	return reinterpret_cast<const T*>(reinterpret_cast<const char*>(p) + bytes);
+}
+
+// Transform a point (w = 1) by an affine matrix
+inline CVector3 TransformPoint(const CMatrix4x4& m, const CVector3& p)
+{
+	return CVector3{ p.x * m.e00 + p.y * m.e10 + p.z * m.e20 + m.e30,
+	                 p.x * m.e01 + p.y * m.e11 + p.z * m.e21 + m.e31,
+	                 p.x * m.e02 + p.y * m.e12 + p.z * m.e22 + m.e32 };
+}
+
+// Extent of a box along a plane normal
+inline float BoxRadius(const CPlane& plane, const CVector3& extents)
+{
+	return std::abs(plane.normal.x) * extents.x + std::abs(plane.normal.y) * extents.y + std::abs(plane.normal.z) * extents.z;
+}
+
+// Plane from four matrix elements (a column of the view-projection matrix combination), normalised
+inline CPlane MakePlane(float a, float b, float c, float d)
+{
+	return Normalise(CPlane{ { a, b, c }, d });
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Batch frustum tests - scalar version
+-----------------------------------------------------------------------------------------*/
+
+size_t IntersectFrustumBoxesScalar(const CFrustum& frustum,
+                                   const float* centreX, const float* centreY, const float* centreZ,
+                                   const float* extentX, const float* extentY, const float* extentZ,
+                                   unsigned char* visible, size_t count)
+{
+	size_t numVisible = 0;
+	for (size_t i = 0; i < count; ++i)
+	{
+		CVector3 centre{ centreX[i], centreY[i], centreZ[i] };
+		CVector3 extents{ extentX[i], extentY[i], extentZ[i] };
+
+		unsigned char isVisible = 1;
+		for (int p = 0; p < CFrustum::NumPlanes; ++p)
+		{
+			if (Distance(frustum.planes[p], centre) + BoxRadius(frustum.planes[p], extents) < 0.0f)
+			{
+				isVisible = 0;
+				break;
+			}
+		}
+		visible[i] = isVisible;
+		numVisible += isVisible;
+	}
+	return numVisible;
+}
+
+
+#if defined(UMBRA_MATHS_X86)
+/*-----------------------------------------------------------------------------------------
+	Batch frustum tests - SSE version
+-----------------------------------------------------------------------------------------*/
+
+size_t IntersectFrustumBoxesSSE(const CFrustum& frustum,
+                                const float* centreX, const float* centreY, const float* centreZ,
+                                const float* extentX, const float* extentY, const float* extentZ,
+                                unsigned char* visible, size_t count)
+{
+	size_t numVisible = 0;
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 cx = _mm_loadu_ps(centreX + i);
+		__m128 cy = _mm_loadu_ps(centreY + i);
+		__m128 cz = _mm_loadu_ps(centreZ + i);
+		__m128 ex = _mm_loadu_ps(extentX + i);
+		__m128 ey = _mm_loadu_ps(extentY + i);
+		__m128 ez = _mm_loadu_ps(extentZ + i);
+
+		__m128 outside = _mm_setzero_ps();
+		for (int p = 0; p < CFrustum::NumPlanes; ++p)
+		{
+			const CPlane& plane = frustum.planes[p];
+			__m128 distance = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.normal.x), cx), _mm_mul_ps(_mm_set1_ps(plane.normal.y), cy));
+			distance = _mm_add_ps(_mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(plane.normal.z), cz)), _mm_set1_ps(plane.d));
+			__m128 radius = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(std::abs(plane.normal.x)), ex), _mm_mul_ps(_mm_set1_ps(std::abs(plane.normal.y)), ey));
+			radius = _mm_add_ps(radius, _mm_mul_ps(_mm_set1_ps(std::abs(plane.normal.z)), ez));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+		}
+
+		int outsideBits = _mm_movemask_ps(outside);
+		for (int lane = 0; lane < 4; ++lane)
+		{
+			unsigned char isVisible = ((outsideBits >> lane) & 1) ^ 1;
+			visible[i + lane] = isVisible;
+			numVisible += isVisible;
+		}
+	}
+	return numVisible + IntersectFrustumBoxesScalar(frustum, centreX + i, centreY + i, centreZ + i,
+	                                                extentX + i, extentY + i, extentZ + i, visible + i, count - i);
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Batch frustum tests - AVX version
+-----------------------------------------------------------------------------------------*/
+
+UMBRA_TARGET_AVX
+size_t IntersectFrustumBoxesAVX(const CFrustum& frustum,
+                                const float* centreX, const float* centreY, const float* centreZ,
+                                const float* extentX, const float* extentY, const float* extentZ,
+                                unsigned char* visible, size_t count)
+{
+	size_t numVisible = 0;
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 cx = _mm256_loadu_ps(centreX + i);
+		__m256 cy = _mm256_loadu_ps(centreY + i);
+		__m256 cz = _mm256_loadu_ps(centreZ + i);
+		__m256 ex = _mm256_loadu_ps(extentX + i);
+		__m256 ey = _mm256_loadu_ps(extentY + i);
+		__m256 ez = _mm256_loadu_ps(extentZ + i);
+
+		__m256 outside = _mm256_setzero_ps();
+		for (int p = 0; p < CFrustum::NumPlanes; ++p)
+		{
+			const CPlane& plane = frustum.planes[p];
+			__m256 distance = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.normal.x), cx), _mm256_mul_ps(_mm256_set1_ps(plane.normal.y), cy));
+			distance = _mm256_add_ps(_mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(plane.normal.z), cz)), _mm256_set1_ps(plane.d));
+			__m256 radius = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(std::abs(plane.normal.x)), ex), _mm256_mul_ps(_mm256_set1_ps(std::abs(plane.normal.y)), ey));
+			radius = _mm256_add_ps(radius, _mm256_mul_ps(_mm256_set1_ps(std::abs(plane.normal.z)), ez));
+			outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), _mm256_setzero_ps(), _CMP_LT_OQ));
+		}
+
+		int outsideBits = _mm256_movemask_ps(outside);
+		for (int lane = 0; lane < 8; ++lane)
+		{
+			unsigned char isVisible = ((outsideBits >> lane) & 1) ^ 1;
+			visible[i + lane] = isVisible;
+			numVisible += isVisible;
+		}
+	}
+	_mm256_zeroupper();
+	return numVisible + IntersectFrustumBoxesSSE(frustum, centreX + i, centreY + i, centreZ + i,
+	                                             extentX + i, extentY + i, extentZ + i, visible + i, count - i);
+}
+#endif
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Construction
+-----------------------------------------------------------------------------------------*/
+
+// Return an empty box, ready to have points merged in
+CAABB EmptyAABB()
+{
+	return CAABB{ { FLT_MAX, FLT_MAX, FLT_MAX }, { -FLT_MAX, -FLT_MAX, -FLT_MAX } };
+}
+
+// Return the box around count points, each stride bytes apart
+CAABB AABBFromPoints(const CVector3* points, size_t stride, size_t count)
+{
+	CAABB box = EmptyAABB();
+	for (size_t i = 0; i < count; ++i)
+	{
+		box = Merge(box, *points);
+		points = Advance(points, stride);
+	}
+	return box;
+}
+
+// Return the box containing both boxes
+CAABB Merge(const CAABB& a, const CAABB& b)
+{
+	return CAABB{ { std::min(a.minimum.x, b.minimum.x), std::min(a.minimum.y, b.minimum.y), std::min(a.minimum.z, b.minimum.z) },
+	              { std::max(a.maximum.x, b.maximum.x), std::max(a.maximum.y, b.maximum.y), std::max(a.maximum.z, b.maximum.z) } };
+}
+
+// Return the box containing the box and the point
+CAABB Merge(const CAABB& box, const CVector3& point)
+{
+	return CAABB{ { std::min(box.minimum.x, point.x), std::min(box.minimum.y, point.y), std::min(box.minimum.z, point.z) },
+	              { std::max(box.maximum.x, point.x), std::max(box.maximum.y, point.y), std::max(box.maximum.z, point.z) } };
+}
+
+// Return a sphere around the given box
+CSphere SphereFromAABB(const CAABB& box)
+{
+	return CSphere{ box.Centre(), Length(box.Extents()) };
+}
+
+// Return the plane through the given point with the given (unit length) normal
+CPlane PlaneFromPointNormal(const CVector3& point, const CVector3& normal)
+{
+	return CPlane{ normal, -Dot(normal, point) };
+}
+
+// Return the plane through three points
+CPlane PlaneFromPoints(const CVector3& p1, const CVector3& p2, const CVector3& p3)
+{
+	return PlaneFromPointNormal(p1, Normalise(Cross(p2 - p1, p3 - p1)));
+}
+
+// Return the given plane scaled so its normal is unit length
+CPlane Normalise(const CPlane& plane)
+{
+	float lengthSq = Dot(plane.normal, plane.normal);
+	if (IsZero(lengthSq))
+	{
+		return plane;
+	}
+	float invLength = InvSqrt(lengthSq);
+	return CPlane{ plane.normal * invLength, plane.d * invLength };
+}
+
+// Return the frustum for the given view-projection matrix
+// A point p is inside when clip = p * m has -w <= x <= w, -w <= y <= w and 0 <= z <= w. Each of those
+// conditions is a plane made from the columns of the matrix, e.g. the left plane is w + x >= 0
+CFrustum FrustumFromMatrix(const CMatrix4x4& m)
+{
+	CFrustum frustum;
+	frustum.planes[CFrustum::Left]   = MakePlane(m.e03 + m.e00, m.e13 + m.e10, m.e23 + m.e20, m.e33 + m.e30);
+	frustum.planes[CFrustum::Right]  = MakePlane(m.e03 - m.e00, m.e13 - m.e10, m.e23 - m.e20, m.e33 - m.e30);
+	frustum.planes[CFrustum::Bottom] = MakePlane(m.e03 + m.e01, m.e13 + m.e11, m.e23 + m.e21, m.e33 + m.e31);
+	frustum.planes[CFrustum::Top]    = MakePlane(m.e03 - m.e01, m.e13 - m.e11, m.e23 - m.e21, m.e33 - m.e31);
+	frustum.planes[CFrustum::Near]   = MakePlane(m.e02,         m.e12,         m.e22,         m.e32);
+	frustum.planes[CFrustum::Far]    = MakePlane(m.e03 - m.e02, m.e13 - m.e12, m.e23 - m.e22, m.e33 - m.e32);
+	return frustum;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Transforms
+-----------------------------------------------------------------------------------------*/
+
+// Return the box around the given box after transforming by an affine matrix
+// Transform the centre, the new extents are the old ones through the absolute values of the matrix (Arvo's method)
+CAABB Transform(const CAABB& box, const CMatrix4x4& m)
+{
+	if (box.IsEmpty()) return box;
+
+	CVector3 centre = TransformPoint(m, box.Centre());
+	CVector3 e = box.Extents();
+	CVector3 extents{ std::abs(m.e00) * e.x + std::abs(m.e10) * e.y + std::abs(m.e20) * e.z,
+	                  std::abs(m.e01) * e.x + std::abs(m.e11) * e.y + std::abs(m.e21) * e.z,
+	                  std::abs(m.e02) * e.x + std::abs(m.e12) * e.y + std::abs(m.e22) * e.z };
+	return CAABB{ centre - extents, centre + extents };
+}
+
+// Return the given box transformed by an affine matrix as an oriented box
+COBB TransformToOBB(const CAABB& box, const CMatrix4x4& m)
+{
+	CVector3 scale = m.GetScale();
+	CVector3 e = box.Extents();
+
+	COBB obb;
+	obb.centre = TransformPoint(m, box.Centre());
+	obb.axes[0] = Normalise(m.GetXAxis());
+	obb.axes[1] = Normalise(m.GetYAxis());
+	obb.axes[2] = Normalise(m.GetZAxis());
+	obb.extents = CVector3{ e.x * scale.x, e.y * scale.y, e.z * scale.z };
+	return obb;
+}
+
+// Return the sphere after transforming by an affine matrix
+CSphere Transform(const CSphere& sphere, const CMatrix4x4& m)
+{
+	CVector3 scale = m.GetScale();
+	return CSphere{ TransformPoint(m, sphere.centre), sphere.radius * std::max(scale.x, std::max(scale.y, scale.z)) };
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Tests
+-----------------------------------------------------------------------------------------*/
+
+// Test whether a point is inside a box
+bool Contains(const CAABB& box, const CVector3& point)
+{
+	return point.x >= box.minimum.x && point.x <= box.maximum.x &&
+	       point.y >= box.minimum.y && point.y <= box.maximum.y &&
+	       point.z >= box.minimum.z && point.z <= box.maximum.z;
+}
+
+// Test whether a point is inside a sphere
+bool Contains(const CSphere& sphere, const CVector3& point)
+{
+	CVector3 v = point - sphere.centre;
+	return Dot(v, v) <= sphere.radius * sphere.radius;
+}
+
+// Test whether a point is inside a frustum
+bool Contains(const CFrustum& frustum, const CVector3& point)
+{
+	for (int p = 0; p < CFrustum::NumPlanes; ++p)
+	{
+		if (Distance(frustum.planes[p], point) < 0.0f) return false;
+	}
+	return true;
+}
+
+// Test whether two boxes overlap
+bool Intersects(const CAABB& a, const CAABB& b)
+{
+	return a.minimum.x <= b.maximum.x && a.maximum.x >= b.minimum.x &&
+	       a.minimum.y <= b.maximum.y && a.maximum.y >= b.minimum.y &&
+	       a.minimum.z <= b.maximum.z && a.maximum.z >= b.minimum.z;
+}
+
+// Test whether two spheres overlap
+bool Intersects(const CSphere& a, const CSphere& b)
+{
+	CVector3 v = b.centre - a.centre;
+	float radii = a.radius + b.radius;
+	return Dot(v, v) <= radii * radii;
+}
+
+// Test whether a box and sphere overlap - find the nearest point in the box to the sphere centre
+bool Intersects(const CAABB& box, const CSphere& sphere)
+{
+	CVector3 nearest{ std::min(std::max(sphere.centre.x, box.minimum.x), box.maximum.x),
+	                  std::min(std::max(sphere.centre.y, box.minimum.y), box.maximum.y),
+	                  std::min(std::max(sphere.centre.z, box.minimum.z), box.maximum.z) };
+	return Contains(sphere, nearest);
+}
+
+// Test whether a sphere is at least partly inside a cone. With the sphere centre x along the axis and y from it,
+// y * cos - x * sin is its distance from the side of the cone. Behind the apex that is less than the true distance
+// (the distance to the apex), so the test stays conservative there
+bool Intersects(const CCone& cone, const CSphere& sphere)
+{
+	CVector3 v = sphere.centre - cone.apex;
+	float x = Dot(v, cone.axis);
+	float y = std::sqrt(std::max(Dot(v, v) - x * x, 0.0f));
+	float sinHalfAngle = std::sqrt(std::max(1.0f - cone.cosHalfAngle * cone.cosHalfAngle, 0.0f));
+	return y * cone.cosHalfAngle - x * sinHalfAngle <= sphere.radius;
+}
+
+// Test whether a box is at least partly inside a cone, using the box's bounding sphere
+bool Intersects(const CCone& cone, const CAABB& box)
+{
+	if (box.IsEmpty()) return false;
+	return Intersects(cone, SphereFromAABB(box));
+}
+
+// Test whether a box is at least partly inside a frustum
+bool Intersects(const CFrustum& frustum, const CAABB& box)
+{
+	CVector3 centre = box.Centre();
+	CVector3 extents = box.Extents();
+	for (int p = 0; p < CFrustum::NumPlanes; ++p)
+	{
+		if (Distance(frustum.planes[p], centre) + BoxRadius(frustum.planes[p], extents) < 0.0f) return false;
+	}
+	return true;
+}
+
+// Test whether a sphere is at least partly inside a frustum
+bool Intersects(const CFrustum& frustum, const CSphere& sphere)
+{
+	for (int p = 0; p < CFrustum::NumPlanes; ++p)
+	{
+		if (Distance(frustum.planes[p], sphere.centre) < -sphere.radius) return false;
+	}
+	return true;
+}
+
+// Test whether an oriented box is at least partly inside a frustum
+bool Intersects(const CFrustum& frustum, const COBB& box)
+{
+	for (int p = 0; p < CFrustum::NumPlanes; ++p)
+	{
+		const CPlane& plane = frustum.planes[p];
+		float radius = box.extents.x * std::abs(Dot(plane.normal, box.axes[0])) +
+		               box.extents.y * std::abs(Dot(plane.normal, box.axes[1])) +
+		               box.extents.z * std::abs(Dot(plane.normal, box.axes[2]));
+		if (Distance(plane, box.centre) + radius < 0.0f) return false;
+	}
+	return true;
+}
+
+// Test whether a box is outside, partly inside or completely inside a frustum
+EIntersection Classify(const CFrustum& frustum, const CAABB& box)
+{
+	CVector3 centre = box.Centre();
+	CVector3 extents = box.Extents();
+	EIntersection result = EIntersection::Inside;
+	for (int p = 0; p < CFrustum::NumPlanes; ++p)
+	{
+		float distance = Distance(frustum.planes[p], centre);
+		float radius = BoxRadius(frustum.planes[p], extents);
+		if (distance + radius < 0.0f) return EIntersection::Outside;
+		if (distance - radius < 0.0f) result = EIntersection::Intersecting;
+	}
+	return result;
+}
+
+// Test whether the shadow a box casts from a point light could fall inside a frustum
+// The shadow lies within the convex hull of the box and the box's corners pushed away from the light to
+// shadowDistance. The hull is outside the frustum if all 16 of those points are outside any one plane
+bool ShadowIntersects(const CFrustum& frustum, const CAABB& box, const CVector3& lightPosition, float shadowDistance)
+{
+	if (box.IsEmpty()) return false;
+	if (Contains(box, lightPosition)) return true;
+
+	CVector3 points[16];
+	for (int corner = 0; corner < 8; ++corner)
+	{
+		CVector3 p{ (corner & 1) ? box.maximum.x : box.minimum.x,
+		            (corner & 2) ? box.maximum.y : box.minimum.y,
+		            (corner & 4) ? box.maximum.z : box.minimum.z };
+		CVector3 fromLight = p - lightPosition;
+		float distance = Length(fromLight);
+		points[corner] = p;
+		points[corner + 8] = (distance < shadowDistance) ? lightPosition + fromLight * (shadowDistance / distance) : p;
+	}
+
+	for (int p = 0; p < CFrustum::NumPlanes; ++p)
+	{
+		bool outside = true;
+		for (int i = 0; i < 16 && outside; ++i)
+		{
+			outside = Distance(frustum.planes[p], points[i]) < 0.0f;
+		}
+		if (outside) return false;
+	}
+	return true;
+}
+
+// Squared distance from a box to a point - the distance to the nearest point in the box
+float DistanceSquared(const CAABB& box, const CVector3& point)
+{
+	float dx = std::max(std::max(box.minimum.x - point.x, point.x - box.maximum.x), 0.0f);
+	float dy = std::max(std::max(box.minimum.y - point.y, point.y - box.maximum.y), 0.0f);
+	float dz = std::max(std::max(box.minimum.z - point.z, point.z - box.maximum.z), 0.0f);
+	return dx * dx + dy * dy + dz * dz;
+}
+
+// Ray against box using the slab method: clip the ray's distance range against each pair of box faces
+bool Intersects(const CRay& ray, const CAABB& box, float maxDistance, float& distance)
+{
+	const float* origin = &ray.origin.x;
+	const float* direction = &ray.direction.x;
+	const float* boxMin = &box.minimum.x;
+	const float* boxMax = &box.maximum.x;
+
+	float tMin = 0.0f;
+	float tMax = maxDistance;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		if (IsZero(direction[axis]))
+		{
+			// Parallel to these faces, must start between them
+			if (origin[axis] < boxMin[axis] || origin[axis] > boxMax[axis]) return false;
+		}
+		else
+		{
+			float invDirection = 1.0f / direction[axis];
+			float t1 = (boxMin[axis] - origin[axis]) * invDirection;
+			float t2 = (boxMax[axis] - origin[axis]) * invDirection;
+			if (t1 > t2) std::swap(t1, t2);
+			tMin = std::max(tMin, t1);
+			tMax = std::min(tMax, t2);
+			if (tMin > tMax) return false;
+		}
+	}
+	distance = tMin;
+	return true;
+}
+
+// Ray against sphere - solve |origin + t * direction - centre| = radius for t (direction is unit length)
+bool Intersects(const CRay& ray, const CSphere& sphere, float maxDistance, float& distance)
+{
+	CVector3 m = ray.origin - sphere.centre;
+	float b = Dot(m, ray.direction);
+	float c = Dot(m, m) - sphere.radius * sphere.radius;
+
+	// Starts outside and pointing away
+	if (c > 0.0f && b > 0.0f) return false;
+
+	float discriminant = b * b - c;
+	if (discriminant < 0.0f) return false;
+
+	float t = std::max(-b - std::sqrt(discriminant), 0.0f);
+	if (t > maxDistance) return false;
+	distance = t;
+	return true;
+}
+
+// Ray against plane (either side)
+bool Intersects(const CRay& ray, const CPlane& plane, float maxDistance, float& distance)
+{
+	float denominator = Dot(plane.normal, ray.direction);
+	if (IsZero(denominator)) return false;
+
+	float t = -Distance(plane, ray.origin) / denominator;
+	if (t < 0.0f || t > maxDistance) return false;
+	distance = t;
+	return true;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Batch frustum tests
+-----------------------------------------------------------------------------------------*/
+
+// Test one frustum against boxes held as separate arrays of centres and extents
+size_t IntersectFrustumBoxes(const CFrustum& frustum,
+                             const float* centreX, const float* centreY, const float* centreZ,
+                             const float* extentX, const float* extentY, const float* extentZ,
+                             unsigned char* visible, size_t count)
+{
+#if defined(UMBRA_MATHS_X86)
+	switch (simd::ActiveInstructionSet())
+	{
+	case simd::EInstructionSet::AVX: return IntersectFrustumBoxesAVX(frustum, centreX, centreY, centreZ, extentX, extentY, extentZ, visible, count);
+	case simd::EInstructionSet::SSE: return IntersectFrustumBoxesSSE(frustum, centreX, centreY, centreZ, extentX, extentY, extentZ, visible, count);
+	default: break;
+	}
+#endif
+	return IntersectFrustumBoxesScalar(frustum, centreX, centreY, centreZ, extentX, extentY, extentZ, visible, count);
+}
+
+// Test one frustum against an array of boxes. Boxes are converted to centre/extents form a block at a time
+size_t IntersectFrustumBoxes(const CFrustum& frustum, const CAABB* boxes, size_t stride, unsigned char* visible, size_t count)
+{
+	const size_t BLOCK_SIZE = 64;
+	float centreX[BLOCK_SIZE], centreY[BLOCK_SIZE], centreZ[BLOCK_SIZE];
+	float extentX[BLOCK_SIZE], extentY[BLOCK_SIZE], extentZ[BLOCK_SIZE];
+
+	size_t numVisible = 0;
+	for (size_t start = 0; start < count; start += BLOCK_SIZE)
+	{
+		size_t blockCount = std::min(BLOCK_SIZE, count - start);
+		for (size_t i = 0; i < blockCount; ++i)
+		{
+			CVector3 centre = boxes->Centre();
+			CVector3 extents = boxes->Extents();
+			centreX[i] = centre.x;  centreY[i] = centre.y;  centreZ[i] = centre.z;
+			extentX[i] = extents.x; extentY[i] = extents.y; extentZ[i] = extents.z;
+			boxes = Advance(boxes, stride);
+		}
+		numVisible += IntersectFrustumBoxes(frustum, centreX, centreY, centreZ, extentX, extentY, extentZ, visible + start, blockCount);
+	}
+	return numVisible;
+}
+
+} } //Namespaces
@@ -0,0 +1,239 @@
+#ifndef _GEOMETRY_H_
+#define _GEOMETRY_H_
+//======================================================================================
+
+//--------------------------------------------------------------------------------------
+// Geometric primitives - bounding volumes, planes, frustums and rays - and intersection tests
+// The foundation for culling and spatial queries
+//--------------------------------------------------------------------------------------
+// Code in .cpp file
+// Planes face inwards for frustums: a point is inside when its distance to every plane is >= 0
+// Boxes are tested against planes in centre/extents form. The single and batch frustum tests do
+// the same operations in the same order, so they always agree on borderline boxes
+
+#include "CVector3.hpp"
+#include "CMatrix4x4.hpp"
+
+#include <cstddef>
+
+//======================================================================================
+namespace umbra_engine
+{
+
+namespace maths
+{
+
+/*-----------------------------------------------------------------------------------------
+	Types
+-----------------------------------------------------------------------------------------*/
+
+// Axis-aligned bounding box
+class CAABB
+{
+public:
+	CVector3 minimum;
+	CVector3 maximum;
+
+	// Default constructor - leaves values uninitialised (for performance)
+	CAABB() {}
+
+	// Construct from minimum and maximum corners
+	constexpr CAABB(const CVector3& minimumIn, const CVector3& maximumIn) : minimum(minimumIn), maximum(maximumIn) {}
+
+	// Centre of the box and half its size on each axis
+	constexpr CVector3 Centre() const { return (minimum + maximum) * 0.5f; }
+	constexpr CVector3 Extents() const { return (maximum - minimum) * 0.5f; }
+
+	// A box is empty if minimum > maximum on any axis, e.g. EmptyAABB() before any points are added
+	constexpr bool IsEmpty() const { return minimum.x > maximum.x || minimum.y > maximum.y || minimum.z > maximum.z; }
+};
+
+// Bounding sphere
+class CSphere
+{
+public:
+	CVector3 centre;
+	float    radius;
+
+	CSphere() {}
+	constexpr CSphere(const CVector3& centreIn, float radiusIn) : centre(centreIn), radius(radiusIn) {}
+};
+
+// Oriented bounding box. Axes are unit length, extents are half the size along each axis
+class COBB
+{
+public:
+	CVector3 centre;
+	CVector3 axes[3];
+	CVector3 extents;
+};
+
+// Plane holding the points p where Dot(normal, p) + d == 0. Normal is unit length
+class CPlane
+{
+public:
+	CVector3 normal;
+	float    d;
+
+	CPlane() {}
+	constexpr CPlane(const CVector3& normalIn, float dIn) : normal(normalIn), d(dIn) {}
+};
+
+// View frustum, six planes facing inwards
+class CFrustum
+{
+public:
+	enum EPlane { Left, Right, Bottom, Top, Near, Far, NumPlanes };
+	CPlane planes[NumPlanes];
+};
+
+// Infinitely long cone, e.g. the area lit by a spot light. Axis is unit length, the half angle is between the
+// axis and the side of the cone
+class CCone
+{
+public:
+	CVector3 apex;
+	CVector3 axis;
+	float    cosHalfAngle;
+
+	CCone() {}
+	constexpr CCone(const CVector3& apexIn, const CVector3& axisIn, float cosHalfAngleIn)
+		: apex(apexIn), axis(axisIn), cosHalfAngle(cosHalfAngleIn) {}
+};
+
+// Ray (or line segment when used with a maximum distance). Direction should be unit length so
+// distances returned by the intersection tests are in world units
+class CRay
+{
+public:
+	CVector3 origin;
+	CVector3 direction;
+
+	CRay() {}
+	constexpr CRay(const CVector3& originIn, const CVector3& directionIn) : origin(originIn), direction(directionIn) {}
+};
+
+// Result of testing a volume against a frustum
+enum class EIntersection
+{
+	Outside,      // Completely outside
+	Intersecting, // Partly inside (or can't be proven to be outside)
+	Inside,       // Completely inside
+};
+
+
+/*-----------------------------------------------------------------------------------------
+	Construction
+-----------------------------------------------------------------------------------------*/
+
+// Return an empty box, ready to have points merged in
+CAABB EmptyAABB();
+
+// Return the box around count points, each stride bytes apart
+CAABB AABBFromPoints(const CVector3* points, size_t stride, size_t count);
+
+// Return the box containing both boxes / the box and the point
+CAABB Merge(const CAABB& a, const CAABB& b);
+CAABB Merge(const CAABB& box, const CVector3& point);
+
+// Return a sphere around the given box
+CSphere SphereFromAABB(const CAABB& box);
+
+// Return the plane through the given point with the given (unit length) normal
+CPlane PlaneFromPointNormal(const CVector3& point, const CVector3& normal);
+
+// Return the plane through three points, normal in the direction of Cross(p2 - p1, p3 - p1)
+CPlane PlaneFromPoints(const CVector3& p1, const CVector3& p2, const CVector3& p3);
+
+// Return the given plane scaled so its normal is unit length
+CPlane Normalise(const CPlane& plane);
+
+// Return the frustum for the given view-projection matrix (e.g. CCamera::ViewProjectionMatrix())
+// Works for any projection matrix in this app's layout (row vectors, D3D depth range 0 to 1). Use the
+// projection matrix alone to get the frustum in camera space, or world * view * projection for model space
+CFrustum FrustumFromMatrix(const CMatrix4x4& viewProjection);
+
+
+/*-----------------------------------------------------------------------------------------
+	Transforms
+-----------------------------------------------------------------------------------------*/
+
+// Return the box around the given box after transforming by an affine matrix, e.g. model space
+// bounds to world space. The result is the tightest axis-aligned box around the transformed corners
+CAABB Transform(const CAABB& box, const CMatrix4x4& m);
+
+// Return the given box transformed by an affine matrix as an oriented box (no loss of tightness)
+COBB TransformToOBB(const CAABB& box, const CMatrix4x4& m);
+
+// Return the sphere after transforming by an affine matrix. Non-uniform scale uses the largest axis
+CSphere Transform(const CSphere& sphere, const CMatrix4x4& m);
+
+
+/*-----------------------------------------------------------------------------------------
+	Tests
+-----------------------------------------------------------------------------------------*/
+
+// Signed distance from plane to point, positive on the side the normal faces
+inline float Distance(const CPlane& plane, const CVector3& point)
+{
+	return Dot(plane.normal, point) + plane.d;
+}
+
+// Squared distance from a box to a point, zero if the point is inside the box
+float DistanceSquared(const CAABB& box, const CVector3& point);
+
+// Test whether a point is inside a box / sphere / frustum (on the boundary counts as inside)
+bool Contains(const CAABB& box, const CVector3& point);
+bool Contains(const CSphere& sphere, const CVector3& point);
+bool Contains(const CFrustum& frustum, const CVector3& point);
+
+// Overlap tests between volumes
+bool Intersects(const CAABB& a, const CAABB& b);
+bool Intersects(const CSphere& a, const CSphere& b);
+bool Intersects(const CAABB& box, const CSphere& sphere);
+
+// Cone tests. Conservative like the frustum tests below, boxes are tested using their bounding sphere
+bool Intersects(const CCone& cone, const CSphere& sphere);
+bool Intersects(const CCone& cone, const CAABB& box);
+
+// Frustum tests. These are conservative: a volume near a corner of the frustum may be reported
+// as intersecting when it is just outside, but a visible volume is never reported as outside
+bool Intersects(const CFrustum& frustum, const CAABB& box);
+bool Intersects(const CFrustum& frustum, const CSphere& sphere);
+bool Intersects(const CFrustum& frustum, const COBB& box);
+EIntersection Classify(const CFrustum& frustum, const CAABB& box);
+
+// Test whether the shadow a box casts from a point light, out to shadowDistance from the light, could fall
+// inside a frustum - i.e. whether the box needs drawing into the light's shadow map for that view. Also
+// conservative, true if the light is inside the box
+bool ShadowIntersects(const CFrustum& frustum, const CAABB& box, const CVector3& lightPosition, float shadowDistance);
+
+// Ray tests. Return true on a hit between 0 and maxDistance along the ray, with the distance to the first
+// hit in distance. A ray starting inside a box or sphere hits at distance 0
+bool Intersects(const CRay& ray, const CAABB& box, float maxDistance, float& distance);
+bool Intersects(const CRay& ray, const CSphere& sphere, float maxDistance, float& distance);
+bool Intersects(const CRay& ray, const CPlane& plane, float maxDistance, float& distance);
+
+
+/*-----------------------------------------------------------------------------------------
+	Batch frustum tests
+-----------------------------------------------------------------------------------------*/
+// Test one frustum against many boxes using the widest instruction set available (see SIMD.hpp)
+// visible[i] is set to 1 if box i intersects the frustum, 0 if it is outside. Return the number visible
+
+// Boxes as separate arrays of centres and extents (SoA), 4 or 8 boxes tested at a time
+size_t IntersectFrustumBoxes(const CFrustum& frustum,
+                             const float* centreX, const float* centreY, const float* centreZ,
+                             const float* extentX, const float* extentY, const float* extentZ,
+                             unsigned char* visible, size_t count);
+
+// Boxes as an array of CAABB, each stride bytes apart (e.g. a member of a larger structure)
+size_t IntersectFrustumBoxes(const CFrustum& frustum, const CAABB* boxes, size_t stride, unsigned char* visible, size_t count);
+inline size_t IntersectFrustumBoxes(const CFrustum& frustum, const CAABB* boxes, unsigned char* visible, size_t count)
+{
+	return IntersectFrustumBoxes(frustum, boxes, sizeof(CAABB), visible, count);
+}
+
+} } //Namespaces
+//======================================================================================
+#endif // _GEOMETRY_H_
@@ -7,19 +7,20 @@
 
 #include <cmath>
 #include "CMatrix4x4.hpp"
+#include "CRandom.hpp"
 
 namespace umbra_engine
 {
 namespace maths
 {
 // Surprisingly, pi is not *officially* defined anywhere in C++
-const float PI = 3.14159265359f;
+constexpr float PI = 3.14159265359f;
 
 
 
 // Test if a float value is approximately 0
 // Epsilon value is the range around zero that is considered equal to zero
-const float EPSILON = 0.5e-6f; // For 32-bit floats, requires zero to 6 decimal places
+constexpr float EPSILON = 0.5e-6f; // For 32-bit floats, requires zero to 6 decimal places
 inline bool IsZero(const float x)
 {
 	return std::abs(x) < EPSILON;
@@ -34,13 +35,13 @@ inline float InvSqrt(const float x)
 
 
 // Pass an angle in degrees, returns the angle in radians
-inline float ToRadians(float d)
+constexpr float ToRadians(float d)
 {
 	return  d * PI / 180.0f;
 }
 
 // Pass an angle in radians, returns the angle in degrees
-inline float ToDegrees(float r)
+constexpr float ToDegrees(float r)
 {
 	return  r * 180.0f / PI;
 }
@@ -54,11 +55,11 @@ inline float Distance(const CVector3& pos1, const CVector3& pos2)
 	return distance;
 }
 
-// Can only return up to RAND_MAX different values, spread evenly across the given range
-// RAND_MAX is defined in stdlib.h and is compiler-specific (32767 on VS-2005, higher elsewhere)
+// Random float in the range [a, b) from the calling thread's generator (see CRandom.hpp)
+// Systems that want a repeatable sequence or generate many values should hold their own CRandom
 inline float Random(const float a, const float b)
 {
-	return a + (b - a) * (static_cast<float>(rand()) / RAND_MAX);
+	return ThreadRandom().Range(a, b);
 }
 } }//Namespaces
 #endif // _MATH_HELPERS_H_
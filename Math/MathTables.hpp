@@ -0,0 +1,81 @@
+#ifndef _MATH_TABLES_H_
+#define _MATH_TABLES_H_
+//======================================================================================
+
+//--------------------------------------------------------------------------------------
+// Constant tables and the constexpr helpers used to build them
+// Everything here is evaluated at compile time, so the tables live in read-only data and
+// calls with constant arguments fold into the calling code
+//--------------------------------------------------------------------------------------
+
+#include "CVector3.hpp"
+#include "CMatrix4x4.hpp"
+
+//======================================================================================
+namespace umbra_engine
+{
+namespace maths
+{
+
+//---------------------------------------
+// Projection
+//---------------------------------------
+
+// Return a perspective projection matrix. Same as MakeProjectionMatrix (see Camera.hpp) but takes
+// tan(FOVx / 2) rather than the angle, so it can be evaluated at compile time for fixed fields of view
+constexpr CMatrix4x4 MatrixPerspective(float aspectRatio, float tanHalfFOVx, float nearClip, float farClip)
+{
+	return CMatrix4x4{ 1.0f / tanHalfFOVx,                         0.0f,                                                0.0f,  0.0f,
+	                                 0.0f, aspectRatio / tanHalfFOVx,                                                0.0f,  0.0f,
+	                                 0.0f,                         0.0f,               farClip / (farClip - nearClip),  1.0f,
+	                                 0.0f,                         0.0f, -nearClip * (farClip / (farClip - nearClip)),  0.0f };
+}
+
+
+//---------------------------------------
+// Cube maps
+//---------------------------------------
+
+// Axes of the camera for one face of a cube map, in the same layout as rows 0-2 of a world matrix
+struct SCubeFaceBasis
+{
+	CVector3 right;
+	CVector3 up;
+	CVector3 forward;
+};
+
+// Return the basis for a camera looking along forward with the given up vector (must be perpendicular)
+constexpr SCubeFaceBasis MakeCubeFaceBasis(const CVector3& forward, const CVector3& up)
+{
+	return SCubeFaceBasis{ Cross(up, forward), up, forward };
+}
+
+// Cube map faces in D3D order: +X, -X, +Y, -Y, +Z, -Z. The up vectors are the ones D3D uses to
+// sample cube maps, which is why the Y faces use Z as up
+constexpr SCubeFaceBasis CUBE_FACE_BASES[6] =
+{
+	MakeCubeFaceBasis({  1.0f,  0.0f,  0.0f }, { 0.0f, 1.0f,  0.0f }), // +X
+	MakeCubeFaceBasis({ -1.0f,  0.0f,  0.0f }, { 0.0f, 1.0f,  0.0f }), // -X
+	MakeCubeFaceBasis({  0.0f,  1.0f,  0.0f }, { 0.0f, 0.0f, -1.0f }), // +Y
+	MakeCubeFaceBasis({  0.0f, -1.0f,  0.0f }, { 0.0f, 0.0f,  1.0f }), // -Y
+	MakeCubeFaceBasis({  0.0f,  0.0f,  1.0f }, { 0.0f, 1.0f,  0.0f }), // +Z
+	MakeCubeFaceBasis({  0.0f,  0.0f, -1.0f }, { 0.0f, 1.0f,  0.0f }), // -Z
+};
+
+// Return the view matrix for one face of a cube map centred on the given position
+// The inverse of the face's world matrix, which is just the transposed basis as it is orthonormal
+constexpr CMatrix4x4 CubeFaceViewMatrix(int face, const CVector3& position)
+{
+	return CMatrix4x4{ CUBE_FACE_BASES[face].right.x, CUBE_FACE_BASES[face].up.x, CUBE_FACE_BASES[face].forward.x, 0.0f,
+	                   CUBE_FACE_BASES[face].right.y, CUBE_FACE_BASES[face].up.y, CUBE_FACE_BASES[face].forward.y, 0.0f,
+	                   CUBE_FACE_BASES[face].right.z, CUBE_FACE_BASES[face].up.z, CUBE_FACE_BASES[face].forward.z, 0.0f,
+	                   -Dot(position, CUBE_FACE_BASES[face].right),
+	                   -Dot(position, CUBE_FACE_BASES[face].up),
+	                   -Dot(position, CUBE_FACE_BASES[face].forward), 1.0f };
+}
+
+// Projection for a cube map face: 90 degree field of view (tan 45 = 1), square, default clip distances
+constexpr CMatrix4x4 CUBE_FACE_PROJECTION = MatrixPerspective(1.0f, 1.0f, 0.1f, 10000.0f);
+
+} } //Namespaces
+#endif // _MATH_TABLES_H_
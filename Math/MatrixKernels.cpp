@@ -0,0 +1,339 @@
+//--------------------------------------------------------------------------------------
+// Low-level 4x4 matrix kernels (scalar, SSE and AVX) used by CMatrix4x4
+//--------------------------------------------------------------------------------------
+// The SIMD kernels use unaligned loads/stores. CMatrix4x4 is 16-byte aligned so these run at full
+// speed, but matrices can still safely live in containers/buffers that don't honour that alignment
+
+#include "MatrixKernels.hpp"
+
+#include <algorithm>
+
+namespace umbra_engine
+{
+namespace maths
+{
+namespace simd
+{
+namespace
+{
+/*-----------------------------------------------------------------------------------------
+	Scalar reference kernels
+-----------------------------------------------------------------------------------------*/
+
+void MultiplyScalar(const float* a, const float* b, float* out)
+{
+	float r[16];
+	for (int row = 0; row < 4; ++row)
+	{
+		const float* ar = a + row * 4;
+		for (int col = 0; col < 4; ++col)
+		{
+			r[row * 4 + col] = ar[0] * b[col] + ar[1] * b[4 + col] + ar[2] * b[8 + col] + ar[3] * b[12 + col];
+		}
+	}
+	std::copy(r, r + 16, out);
+}
+
+void TransposeScalar(const float* m, float* out)
+{
+	float r[16];
+	for (int row = 0; row < 4; ++row)
+	{
+		for (int col = 0; col < 4; ++col)
+		{
+			r[col * 4 + row] = m[row * 4 + col];
+		}
+	}
+	std::copy(r, r + 16, out);
+}
+
+void InverseAffineScalar(const float* m, float* out)
+{
+	float r[16];
+
+	// Calculate determinant of upper left 3x3
+	float det0 = m[5] * m[10] - m[6] * m[9];
+	float det1 = m[6] * m[8] - m[4] * m[10];
+	float det2 = m[4] * m[9] - m[5] * m[8];
+	float det = m[0] * det0 + m[1] * det1 + m[2] * det2;
+
+	// Calculate inverse of upper left 3x3
+	float invDet = 1.0f / det;
+	r[0] = invDet * det0;
+	r[4] = invDet * det1;
+	r[8] = invDet * det2;
+
+	r[1] = invDet * (m[9] * m[2] - m[10] * m[1]);
+	r[5] = invDet * (m[10] * m[0] - m[8] * m[2]);
+	r[9] = invDet * (m[8] * m[1] - m[9] * m[0]);
+
+	r[2] = invDet * (m[1] * m[6] - m[2] * m[5]);
+	r[6] = invDet * (m[2] * m[4] - m[0] * m[6]);
+	r[10] = invDet * (m[0] * m[5] - m[1] * m[4]);
+
+	// Transform negative translation by inverted 3x3 to get inverse
+	r[12] = -m[12] * r[0] - m[13] * r[4] - m[14] * r[8];
+	r[13] = -m[12] * r[1] - m[13] * r[5] - m[14] * r[9];
+	r[14] = -m[12] * r[2] - m[13] * r[6] - m[14] * r[10];
+
+	// Fill in right column for affine matrix
+	r[3] = 0.0f;
+	r[7] = 0.0f;
+	r[11] = 0.0f;
+	r[15] = 1.0f;
+
+	std::copy(r, r + 16, out);
+}
+
+void MultiplyBatchScalar(const float* a, const float* b, float* out, size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		MultiplyScalar(a + i * 16, b, out + i * 16);
+	}
+}
+
+void MultiplyPairwiseScalar(const float* a, const float* b, float* out, size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		MultiplyScalar(a + i * 16, b + i * 16, out + i * 16);
+	}
+}
+
+const SMatrixKernels gScalarKernels = { MultiplyScalar, TransposeScalar, InverseAffineScalar, MultiplyBatchScalar, MultiplyPairwiseScalar };
+
+
+#if defined(UMBRA_MATHS_X86)
+/*-----------------------------------------------------------------------------------------
+	SSE kernels
+-----------------------------------------------------------------------------------------*/
+
+// One row of a * b: ((a0*b0 + a1*b1) + a2*b2) + a3*b3, matching the scalar evaluation order
+inline __m128 MultiplyRowSSE(__m128 aRow, __m128 b0, __m128 b1, __m128 b2, __m128 b3)
+{
+	__m128 r = _mm_mul_ps(_mm_shuffle_ps(aRow, aRow, _MM_SHUFFLE(0, 0, 0, 0)), b0);
+	r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(aRow, aRow, _MM_SHUFFLE(1, 1, 1, 1)), b1));
+	r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(aRow, aRow, _MM_SHUFFLE(2, 2, 2, 2)), b2));
+	r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(aRow, aRow, _MM_SHUFFLE(3, 3, 3, 3)), b3));
+	return r;
+}
+
+void MultiplySSE(const float* a, const float* b, float* out)
+{
+	// All of b is loaded before anything is stored so out can alias either input
+	__m128 b0 = _mm_loadu_ps(b);
+	__m128 b1 = _mm_loadu_ps(b + 4);
+	__m128 b2 = _mm_loadu_ps(b + 8);
+	__m128 b3 = _mm_loadu_ps(b + 12);
+
+	__m128 r0 = MultiplyRowSSE(_mm_loadu_ps(a), b0, b1, b2, b3);
+	__m128 r1 = MultiplyRowSSE(_mm_loadu_ps(a + 4), b0, b1, b2, b3);
+	__m128 r2 = MultiplyRowSSE(_mm_loadu_ps(a + 8), b0, b1, b2, b3);
+	__m128 r3 = MultiplyRowSSE(_mm_loadu_ps(a + 12), b0, b1, b2, b3);
+
+	_mm_storeu_ps(out, r0);
+	_mm_storeu_ps(out + 4, r1);
+	_mm_storeu_ps(out + 8, r2);
+	_mm_storeu_ps(out + 12, r3);
+}
+
+void TransposeSSE(const float* m, float* out)
+{
+	__m128 r0 = _mm_loadu_ps(m);
+	__m128 r1 = _mm_loadu_ps(m + 4);
+	__m128 r2 = _mm_loadu_ps(m + 8);
+	__m128 r3 = _mm_loadu_ps(m + 12);
+	_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+	_mm_storeu_ps(out, r0);
+	_mm_storeu_ps(out + 4, r1);
+	_mm_storeu_ps(out + 8, r2);
+	_mm_storeu_ps(out + 12, r3);
+}
+
+// Cross product of the x,y,z parts of two rows: a.yzx * b.zxy - a.zxy * b.yzx (w is garbage)
+inline __m128 CrossSSE(__m128 a, __m128 b)
+{
+	__m128 aYZX = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+	__m128 aZXY = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 1, 0, 2));
+	__m128 bYZX = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+	__m128 bZXY = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 1, 0, 2));
+	return _mm_sub_ps(_mm_mul_ps(aYZX, bZXY), _mm_mul_ps(aZXY, bYZX));
+}
+
+void InverseAffineSSE(const float* m, float* out)
+{
+	__m128 row0 = _mm_loadu_ps(m);
+	__m128 row1 = _mm_loadu_ps(m + 4);
+	__m128 row2 = _mm_loadu_ps(m + 8);
+	__m128 row3 = _mm_loadu_ps(m + 12);
+
+	// The inverse of a 3x3 matrix has the cross products of pairs of rows as its columns (the adjugate)
+	__m128 col0 = CrossSSE(row1, row2); // det0, det1, det2 in the scalar version
+	__m128 col1 = CrossSSE(row2, row0);
+	__m128 col2 = CrossSSE(row0, row1);
+
+	// Determinant is row0 . (row1 x row2), summed in the same order as the scalar version
+	__m128 p = _mm_mul_ps(row0, col0);
+	__m128 det = _mm_add_ss(_mm_add_ss(p, _mm_shuffle_ps(p, p, _MM_SHUFFLE(1, 1, 1, 1))), _mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 2, 2, 2)));
+	__m128 invDet = _mm_div_ps(_mm_set1_ps(1.0f), _mm_shuffle_ps(det, det, _MM_SHUFFLE(0, 0, 0, 0)));
+
+	col0 = _mm_mul_ps(invDet, col0);
+	col1 = _mm_mul_ps(invDet, col1);
+	col2 = _mm_mul_ps(invDet, col2);
+
+	// Columns to rows. Transposing against a zero row gives the zero right hand column of an affine
+	// matrix, and the unused w lanes of the cross products end up in r3, which is discarded
+	__m128 r0 = col0, r1 = col1, r2 = col2, r3 = _mm_setzero_ps();
+	_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+	// Transform negative translation by inverted 3x3 to get inverse. Negating by flipping the sign bit
+	// gives exactly the scalar (-x) * y, including the sign of zero
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	const __m128 xyzMask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+	__m128 t = _mm_xor_ps(_mm_mul_ps(_mm_shuffle_ps(row3, row3, _MM_SHUFFLE(0, 0, 0, 0)), r0), signMask);
+	t = _mm_sub_ps(t, _mm_mul_ps(_mm_shuffle_ps(row3, row3, _MM_SHUFFLE(1, 1, 1, 1)), r1));
+	t = _mm_sub_ps(t, _mm_mul_ps(_mm_shuffle_ps(row3, row3, _MM_SHUFFLE(2, 2, 2, 2)), r2));
+	t = _mm_or_ps(_mm_and_ps(t, xyzMask), _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f));
+
+	_mm_storeu_ps(out, r0);
+	_mm_storeu_ps(out + 4, r1);
+	_mm_storeu_ps(out + 8, r2);
+	_mm_storeu_ps(out + 12, t);
+}
+
+// The rows of b stay in registers across the whole batch
+void MultiplyBatchSSE(const float* a, const float* b, float* out, size_t count)
+{
+	__m128 b0 = _mm_loadu_ps(b);
+	__m128 b1 = _mm_loadu_ps(b + 4);
+	__m128 b2 = _mm_loadu_ps(b + 8);
+	__m128 b3 = _mm_loadu_ps(b + 12);
+	for (size_t i = 0; i < count; ++i, a += 16, out += 16)
+	{
+		__m128 r0 = MultiplyRowSSE(_mm_loadu_ps(a), b0, b1, b2, b3);
+		__m128 r1 = MultiplyRowSSE(_mm_loadu_ps(a + 4), b0, b1, b2, b3);
+		__m128 r2 = MultiplyRowSSE(_mm_loadu_ps(a + 8), b0, b1, b2, b3);
+		__m128 r3 = MultiplyRowSSE(_mm_loadu_ps(a + 12), b0, b1, b2, b3);
+		_mm_storeu_ps(out, r0);
+		_mm_storeu_ps(out + 4, r1);
+		_mm_storeu_ps(out + 8, r2);
+		_mm_storeu_ps(out + 12, r3);
+	}
+}
+
+void MultiplyPairwiseSSE(const float* a, const float* b, float* out, size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		MultiplySSE(a + i * 16, b + i * 16, out + i * 16);
+	}
+}
+
+const SMatrixKernels gSSEKernels = { MultiplySSE, TransposeSSE, InverseAffineSSE, MultiplyBatchSSE, MultiplyPairwiseSSE };
+
+
+/*-----------------------------------------------------------------------------------------
+	AVX kernels - two rows per register, batches only
+-----------------------------------------------------------------------------------------*/
+
+// Rows 0,1 and rows 2,3 of a * b, where b0..b3 hold each row of b repeated in both 128-bit halves.
+// Broadcasts within each half pick out element k of row 0 / row 1 (or row 2 / row 3)
+UMBRA_TARGET_AVX
+inline void MultiplyRowsAVX(const float* a, __m256 b0, __m256 b1, __m256 b2, __m256 b3, float* out)
+{
+	__m256 a01 = _mm256_loadu_ps(a);
+	__m256 a23 = _mm256_loadu_ps(a + 8);
+
+	__m256 r01 = _mm256_mul_ps(_mm256_permute_ps(a01, _MM_SHUFFLE(0, 0, 0, 0)), b0);
+	__m256 r23 = _mm256_mul_ps(_mm256_permute_ps(a23, _MM_SHUFFLE(0, 0, 0, 0)), b0);
+	r01 = _mm256_add_ps(r01, _mm256_mul_ps(_mm256_permute_ps(a01, _MM_SHUFFLE(1, 1, 1, 1)), b1));
+	r23 = _mm256_add_ps(r23, _mm256_mul_ps(_mm256_permute_ps(a23, _MM_SHUFFLE(1, 1, 1, 1)), b1));
+	r01 = _mm256_add_ps(r01, _mm256_mul_ps(_mm256_permute_ps(a01, _MM_SHUFFLE(2, 2, 2, 2)), b2));
+	r23 = _mm256_add_ps(r23, _mm256_mul_ps(_mm256_permute_ps(a23, _MM_SHUFFLE(2, 2, 2, 2)), b2));
+	r01 = _mm256_add_ps(r01, _mm256_mul_ps(_mm256_permute_ps(a01, _MM_SHUFFLE(3, 3, 3, 3)), b3));
+	r23 = _mm256_add_ps(r23, _mm256_mul_ps(_mm256_permute_ps(a23, _MM_SHUFFLE(3, 3, 3, 3)), b3));
+
+	_mm256_storeu_ps(out, r01);
+	_mm256_storeu_ps(out + 8, r23);
+}
+
+UMBRA_TARGET_AVX
+void MultiplyBatchAVX(const float* a, const float* b, float* out, size_t count)
+{
+	__m256 b0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(b));
+	__m256 b1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(b + 4));
+	__m256 b2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(b + 8));
+	__m256 b3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(b + 12));
+	for (size_t i = 0; i < count; ++i)
+	{
+		MultiplyRowsAVX(a + i * 16, b0, b1, b2, b3, out + i * 16);
+	}
+	_mm256_zeroupper();
+}
+
+UMBRA_TARGET_AVX
+void MultiplyPairwiseAVX(const float* a, const float* b, float* out, size_t count)
+{
+	for (size_t i = 0; i < count; ++i, b += 16)
+	{
+		// All of b is loaded before anything is stored so out can alias it
+		__m256 b0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(b));
+		__m256 b1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(b + 4));
+		__m256 b2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(b + 8));
+		__m256 b3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(b + 12));
+		MultiplyRowsAVX(a + i * 16, b0, b1, b2, b3, out + i * 16);
+	}
+	_mm256_zeroupper();
+}
+
+// Single matrix kernels are the SSE ones, see header
+const SMatrixKernels gAVXKernels = { MultiplySSE, TransposeSSE, InverseAffineSSE, MultiplyBatchAVX, MultiplyPairwiseAVX };
+#endif
+}
+
+
+// Kernels for a particular instruction set. Asking for an unsupported one returns the scalar kernels
+const SMatrixKernels& MatrixKernels(EInstructionSet instructionSet)
+{
+#if defined(UMBRA_MATHS_X86)
+	switch (instructionSet)
+	{
+	case EInstructionSet::AVX: return gAVXKernels;
+	case EInstructionSet::SSE: return gSSEKernels;
+	default: break;
+	}
+#endif
+	return gScalarKernels;
+}
+
+
+// Single matrix kernels used by CMatrix4x4, chosen at compile time
+void MultiplyMatrix(const float* a, const float* b, float* out)
+{
+#if defined(UMBRA_MATHS_X86)
+	MultiplySSE(a, b, out);
+#else
+	MultiplyScalar(a, b, out);
+#endif
+}
+
+void TransposeMatrix(const float* m, float* out)
+{
+#if defined(UMBRA_MATHS_X86)
+	TransposeSSE(m, out);
+#else
+	TransposeScalar(m, out);
+#endif
+}
+
+void InverseAffineMatrix(const float* m, float* out)
+{
+#if defined(UMBRA_MATHS_X86)
+	InverseAffineSSE(m, out);
+#else
+	InverseAffineScalar(m, out);
+#endif
+}
+
+} } } //Namespaces
@@ -0,0 +1,66 @@
+#ifndef _MATRIX_KERNELS_H_
+#define _MATRIX_KERNELS_H_
+//======================================================================================
+
+//--------------------------------------------------------------------------------------
+// Low-level 4x4 matrix kernels (scalar, SSE and AVX) used by CMatrix4x4
+// Each kernel works on 16 floats stored by rows (the CMatrix4x4 layout). The SIMD versions
+// perform the same operations in the same order as the scalar ones, so results are bit-identical
+//--------------------------------------------------------------------------------------
+
+#include "SIMD.hpp"
+
+#include <cstddef>
+
+//======================================================================================
+namespace umbra_engine
+{
+
+namespace maths
+{
+
+namespace simd
+{
+// out = a * b. out may alias a or b
+typedef void (*MatrixMultiplyFn)(const float* a, const float* b, float* out);
+
+// out = transpose of m. out may alias m
+typedef void (*MatrixTransposeFn)(const float* m, float* out);
+
+// out = inverse of affine matrix m. out may alias m
+typedef void (*MatrixInverseAffineFn)(const float* m, float* out);
+
+// out[i] = a[i] * b for count matrices of 16 floats. out may alias a but not b
+typedef void (*MatrixMultiplyBatchFn)(const float* a, const float* b, float* out, size_t count);
+
+// out[i] = a[i] * b[i] for count matrices of 16 floats. out may alias a or b
+typedef void (*MatrixMultiplyPairwiseFn)(const float* a, const float* b, float* out, size_t count);
+
+// One implementation of each matrix kernel
+struct SMatrixKernels
+{
+	MatrixMultiplyFn         multiply;
+	MatrixTransposeFn        transpose;
+	MatrixInverseAffineFn    inverseAffine;
+	MatrixMultiplyBatchFn    multiplyBatch;
+	MatrixMultiplyPairwiseFn multiplyPairwise;
+};
+
+// Kernels for a particular instruction set. Asking for an unsupported one returns the scalar kernels
+// The AVX set only differs from the SSE one in the batch kernels: a single 4x4 multiply is too small to
+// gain from 8-wide registers, it only pays off when one matrix's rows stay loaded across many multiplies
+const SMatrixKernels& MatrixKernels(EInstructionSet instructionSet);
+
+// Kernels for the instruction set currently selected (see ActiveInstructionSet)
+inline const SMatrixKernels& MatrixKernels() { return MatrixKernels(ActiveInstructionSet()); }
+
+// Single matrix kernels used by CMatrix4x4. These are called directly rather than through MatrixKernels():
+// SSE2 is part of every x86/x64 target the engine is built for, so there is nothing to choose at runtime and
+// each operator avoids a dispatch lookup and an indirect call. Other targets use the scalar kernels
+void MultiplyMatrix(const float* a, const float* b, float* out);
+void TransposeMatrix(const float* m, float* out);
+void InverseAffineMatrix(const float* m, float* out);
+
+} } } //Namespaces
+//======================================================================================
+#endif // _MATRIX_KERNELS_H_
@@ -0,0 +1,100 @@
+//--------------------------------------------------------------------------------------
+// SIMD support for the maths library
+//--------------------------------------------------------------------------------------
+
+#include "SIMD.hpp"
+
+#if defined(UMBRA_MATHS_X86)
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+	#else
+		#include <cpuid.h>
+	#endif
+#endif
+
+namespace umbra_engine
+{
+namespace maths
+{
+namespace simd
+{
+namespace
+{
+#if defined(UMBRA_MATHS_X86)
+// Read CPUID leaf into regs (eax, ebx, ecx, edx)
+void CpuId(int leaf, unsigned int regs[4])
+{
+#if defined(_MSC_VER)
+	int r[4];
+	__cpuid(r, leaf);
+	for (int i = 0; i < 4; ++i) regs[i] = static_cast<unsigned int>(r[i]);
+#else
+	__cpuid(leaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// Read the extended control register that says which register states the OS saves on a context switch
+unsigned long long ReadXCR0()
+{
+#if defined(_MSC_VER)
+	return _xgetbv(0);
+#else
+	unsigned int lo, hi;
+	__asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+	return (static_cast<unsigned long long>(hi) << 32) | lo;
+#endif
+}
+#endif
+
+// The instruction set in use, initialised on first use so other static initialisers can safely use the maths routines
+EInstructionSet& ActiveStorage()
+{
+	static EInstructionSet active = DetectInstructionSet();
+	return active;
+}
+}
+
+
+// Return the widest instruction set supported by this CPU and operating system
+EInstructionSet DetectInstructionSet()
+{
+#if defined(UMBRA_MATHS_X86)
+	unsigned int regs[4];
+	CpuId(1, regs);
+
+	const bool hasSSE2    = (regs[3] & (1u << 26)) != 0;
+	const bool hasOSXSave = (regs[2] & (1u << 27)) != 0;
+	const bool hasAVX     = (regs[2] & (1u << 28)) != 0;
+
+	// AVX also needs the OS to save the upper halves of the YMM registers (XCR0 bits 1 and 2)
+	if (hasAVX && hasOSXSave && (ReadXCR0() & 0x6) == 0x6) return EInstructionSet::AVX;
+	if (hasSSE2) return EInstructionSet::SSE;
+#endif
+	return EInstructionSet::Scalar;
+}
+
+// Return the instruction set currently used by the maths routines. Defaults to DetectInstructionSet()
+EInstructionSet ActiveInstructionSet()
+{
+	return ActiveStorage();
+}
+
+// Force the maths routines to use a particular instruction set. Requests wider than the CPU supports are clamped
+void SetInstructionSet(EInstructionSet instructionSet)
+{
+	EInstructionSet supported = DetectInstructionSet();
+	ActiveStorage() = (static_cast<int>(instructionSet) > static_cast<int>(supported)) ? supported : instructionSet;
+}
+
+// Readable name for an instruction set, e.g. for logging
+const char* InstructionSetName(EInstructionSet instructionSet)
+{
+	switch (instructionSet)
+	{
+	case EInstructionSet::SSE: return "SSE";
+	case EInstructionSet::AVX: return "AVX";
+	default:                   return "Scalar";
+	}
+}
+
+} } } //Namespaces
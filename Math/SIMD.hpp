@@ -0,0 +1,59 @@
+#ifndef _SIMD_H_
+#define _SIMD_H_
+//======================================================================================
+
+//--------------------------------------------------------------------------------------
+// SIMD support for the maths library
+// Detects which instruction sets the CPU supports and lets the hot maths routines pick
+// the widest available implementation at runtime
+//--------------------------------------------------------------------------------------
+
+// SSE/AVX intrinsics are only available when building for x86 or x64
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+	#define UMBRA_MATHS_X86 1
+	#include <immintrin.h>
+#endif
+
+// MSVC allows AVX intrinsics in any function, GCC/Clang need each AVX function marked up so
+// the rest of the engine can still be built for plain SSE2 (and run on CPUs without AVX)
+#if defined(_MSC_VER)
+	#define UMBRA_TARGET_AVX
+	#define UMBRA_TARGET_AVX2
+#else
+	#define UMBRA_TARGET_AVX  __attribute__((target("avx")))
+	#define UMBRA_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
+//======================================================================================
+namespace umbra_engine
+{
+
+namespace maths
+{
+
+namespace simd
+{
+// Instruction sets the maths library has implementations for, from narrowest to widest
+enum class EInstructionSet
+{
+	Scalar, // Plain C++, always available
+	SSE,    // 4-wide float (SSE2 is guaranteed on x64)
+	AVX,    // 8-wide float
+};
+
+// Return the widest instruction set supported by this CPU and operating system
+EInstructionSet DetectInstructionSet();
+
+// Return the instruction set currently used by the maths routines. Defaults to DetectInstructionSet()
+EInstructionSet ActiveInstructionSet();
+
+// Force the maths routines to use a particular instruction set - used to compare implementations
+// against the scalar reference. Requests wider than the CPU supports are clamped to what is available
+void SetInstructionSet(EInstructionSet instructionSet);
+
+// Readable name for an instruction set, e.g. for logging
+const char* InstructionSetName(EInstructionSet instructionSet);
+
+} } } //Namespaces
+//======================================================================================
+#endif // _SIMD_H_
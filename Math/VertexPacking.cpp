@@ -0,0 +1,573 @@
+//--------------------------------------------------------------------------------------
+// Compact formats for vertex and animation data
+//--------------------------------------------------------------------------------------
+// Half float conversions are the branch-light versions by Fabian Giesen, which round to nearest even
+// using integer arithmetic and let the FPU handle denormals. The SSE versions do both sides of each
+// branch and select, with the same operations as the scalar code so results are bit-identical.
+// Rounding to integers uses the current rounding mode (nearest even by default) in both the scalar
+// code (std::lrint) and SSE code (cvtps2dq). AVX has no 8-wide integer instructions (that needs AVX2)
+// so SSE is used for both
+
+#include "VertexPacking.hpp"
+#include "SIMD.hpp"
+
+#include <cmath>
+#include <cstring>
+
+namespace umbra_engine
+{
+namespace maths
+{
+namespace
+{
+// Reinterpret the bits of a float as an integer and back
+inline uint32_t AsUint(float f)
+{
+	uint32_t u;
+	std::memcpy(&u, &f, sizeof(u));
+	return u;
+}
+
+inline float AsFloat(uint32_t u)
+{
+	float f;
+	std::memcpy(&f, &u, sizeof(f));
+	return f;
+}
+
+// Step a pointer on by a number of bytes (for strided arrays)
+template <typename T>
+inline T* Advance(T* p, size_t bytes)
+{
+	return reinterpret_cast<T*>(reinterpret_cast<char*>(p) + bytes);
+}
+
+template <typename T>
+inline const T* Advance(const T* p, size_t bytes)
+{
+	return reinterpret_cast<const T*>(reinterpret_cast<const char*>(p) + bytes);
+}
+
+// Clamp to -1 to 1 or 0 to 1. Written to match SSE max/min exactly (NaN becomes the lower limit)
+inline float ClampSigned(float f)
+{
+	f = f > -1.0f ? f : -1.0f;
+	return f < 1.0f ? f : 1.0f;
+}
+
+inline float ClampUnsigned(float f)
+{
+	f = f > 0.0f ? f : 0.0f;
+	return f < 1.0f ? f : 1.0f;
+}
+
+// Float to half constants (as float bit patterns)
+const uint32_t FLOAT_INFINITY   = 255 << 23;
+const uint32_t HALF_OVERFLOW    = (127 + 16) << 23;              // 65536, values from here up become infinity
+const uint32_t HALF_MIN_NORMAL  = 113 << 23;                     // 2^-14, values below become half denormals
+const uint32_t DENORMAL_MAGIC   = ((127 - 15) + (23 - 10) + 1) << 23;
+const uint32_t REBIAS_AND_ROUND = 0xc8000fff;                    // ((15 - 127) << 23) + 0xfff
+
+// Half to float constants
+const uint32_t SHIFTED_EXPONENT = 0x7c00 << 13;                  // Half exponent mask after shifting into place
+const uint32_t EXPONENT_ADJUST  = (127 - 15) << 23;
+const uint32_t INFINITY_ADJUST  = (128 - 16) << 23;
+const uint32_t DENORMAL_ADJUST  = 113 << 23;
+
+
+/*-----------------------------------------------------------------------------------------
+	Octahedral encoding
+-----------------------------------------------------------------------------------------*/
+
+// Encode to the -1 to 1 square: project onto the octahedron |x| + |y| + |z| = 1, then fold the lower half
+// (z < 0) out over the diagonals to the corners of the square
+inline void OctahedralEncodeScalar(float vx, float vy, float vz, float& ex, float& ey)
+{
+	float invSum = 1.0f / ((std::abs(vx) + std::abs(vy)) + std::abs(vz));
+	float x = vx * invSum;
+	float y = vy * invSum;
+	if (vz < 0.0f)
+	{
+		float foldedX = (1.0f - std::abs(y)) * std::copysign(1.0f, x);
+		float foldedY = (1.0f - std::abs(x)) * std::copysign(1.0f, y);
+		x = foldedX;
+		y = foldedY;
+	}
+	ex = x;
+	ey = y;
+}
+
+
+#if defined(UMBRA_MATHS_X86)
+/*-----------------------------------------------------------------------------------------
+	SSE versions
+-----------------------------------------------------------------------------------------*/
+
+// Per-lane select, mask lanes are all ones or all zeros
+inline __m128i Select(__m128i mask, __m128i a, __m128i b)
+{
+	return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+inline __m128 Select(__m128 mask, __m128 a, __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// Pack the low 16 bits of each 32-bit lane into 4 uint16s (sign-extend first so packs doesn't saturate)
+inline __m128i PackLow16(__m128i v)
+{
+	v = _mm_srai_epi32(_mm_slli_epi32(v, 16), 16);
+	return _mm_packs_epi32(v, v);
+}
+
+void FloatsToHalvesSSE(const float* in, uint16_t* out, size_t count)
+{
+	const __m128i signMask = _mm_set1_epi32(static_cast<int>(0x80000000u));
+	const __m128i floatInfinity = _mm_set1_epi32(FLOAT_INFINITY);
+	const __m128i halfOverflow = _mm_set1_epi32(HALF_OVERFLOW - 1);
+	const __m128i halfMinNormal = _mm_set1_epi32(HALF_MIN_NORMAL);
+	const __m128i denormalMagic = _mm_set1_epi32(DENORMAL_MAGIC);
+	const __m128i rebiasAndRound = _mm_set1_epi32(static_cast<int>(REBIAS_AND_ROUND));
+	const __m128i halfNaN = _mm_set1_epi32(0x7e00);
+	const __m128i halfInfinity = _mm_set1_epi32(0x7c00);
+	const __m128i one = _mm_set1_epi32(1);
+
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i v = _mm_castps_si128(_mm_loadu_ps(in + i));
+		__m128i sign = _mm_and_si128(v, signMask);
+		v = _mm_xor_si128(v, sign); // Sign removed so signed integer comparisons work
+
+		__m128i nanOrInfinity = Select(_mm_cmpgt_epi32(v, floatInfinity), halfNaN, halfInfinity);
+		__m128i denormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(v), _mm_castsi128_ps(denormalMagic))), denormalMagic);
+		__m128i mantissaOdd = _mm_and_si128(_mm_srli_epi32(v, 13), one);
+		__m128i normal = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(v, rebiasAndRound), mantissaOdd), 13);
+
+		__m128i h = Select(_mm_cmplt_epi32(v, halfMinNormal), denormal, normal);
+		h = Select(_mm_cmpgt_epi32(v, halfOverflow), nanOrInfinity, h);
+		h = _mm_or_si128(h, _mm_srli_epi32(sign, 16));
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(out + i), PackLow16(h));
+	}
+
+	for (; i < count; ++i)  out[i] = FloatToHalf(in[i]);
+}
+
+void HalvesToFloatsSSE(const uint16_t* in, float* out, size_t count)
+{
+	const __m128i magnitudeMask = _mm_set1_epi32(0x7fff);
+	const __m128i halfSignMask = _mm_set1_epi32(0x8000);
+	const __m128i shiftedExponent = _mm_set1_epi32(SHIFTED_EXPONENT);
+	const __m128i exponentAdjust = _mm_set1_epi32(EXPONENT_ADJUST);
+	const __m128i infinityAdjust = _mm_set1_epi32(INFINITY_ADJUST);
+	const __m128i denormalExponent = _mm_set1_epi32(1 << 23);
+	const __m128 denormalAdjust = _mm_castsi128_ps(_mm_set1_epi32(DENORMAL_ADJUST));
+	const __m128i zero = _mm_setzero_si128();
+
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i h = _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(in + i)), zero);
+
+		__m128i f = _mm_slli_epi32(_mm_and_si128(h, magnitudeMask), 13);
+		__m128i exponent = _mm_and_si128(f, shiftedExponent);
+		f = _mm_add_epi32(f, exponentAdjust);
+
+		__m128i infinityOrNaN = _mm_add_epi32(f, infinityAdjust);
+		__m128i zeroOrDenormal = _mm_castps_si128(_mm_sub_ps(_mm_castsi128_ps(_mm_add_epi32(f, denormalExponent)), denormalAdjust));
+		f = Select(_mm_cmpeq_epi32(exponent, shiftedExponent), infinityOrNaN, f);
+		f = Select(_mm_cmpeq_epi32(exponent, zero), zeroOrDenormal, f);
+
+		f = _mm_or_si128(f, _mm_slli_epi32(_mm_and_si128(h, halfSignMask), 16));
+		_mm_storeu_ps(out + i, _mm_castsi128_ps(f));
+	}
+
+	for (; i < count; ++i)  out[i] = HalfToFloat(in[i]);
+}
+
+// Clamp and scale 4 floats, then round to integers
+inline __m128i ToSnormSSE(__m128 v, float scale)
+{
+	v = _mm_min_ps(_mm_max_ps(v, _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f));
+	return _mm_cvtps_epi32(_mm_mul_ps(v, _mm_set1_ps(scale)));
+}
+
+inline __m128i ToUnormSSE(__m128 v, float scale)
+{
+	v = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+	return _mm_cvtps_epi32(_mm_mul_ps(v, _mm_set1_ps(scale)));
+}
+
+void FloatsToSnorm16SSE(const float* in, int16_t* out, size_t count)
+{
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i v = ToSnormSSE(_mm_loadu_ps(in + i), 32767.0f);
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(out + i), _mm_packs_epi32(v, v));
+	}
+	for (; i < count; ++i)  out[i] = FloatToSnorm16(in[i]);
+}
+
+void FloatsToSnorm8SSE(const float* in, int8_t* out, size_t count)
+{
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		__m128i a = _mm_packs_epi32(ToSnormSSE(_mm_loadu_ps(in + i     ), 127.0f), ToSnormSSE(_mm_loadu_ps(in + i +  4), 127.0f));
+		__m128i b = _mm_packs_epi32(ToSnormSSE(_mm_loadu_ps(in + i +  8), 127.0f), ToSnormSSE(_mm_loadu_ps(in + i + 12), 127.0f));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packs_epi16(a, b));
+	}
+	for (; i < count; ++i)  out[i] = FloatToSnorm8(in[i]);
+}
+
+void FloatsToUnorm16SSE(const float* in, uint16_t* out, size_t count)
+{
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i v = ToUnormSSE(_mm_loadu_ps(in + i), 65535.0f);
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(out + i), PackLow16(v));
+	}
+	for (; i < count; ++i)  out[i] = FloatToUnorm16(in[i]);
+}
+
+void FloatsToUnorm8SSE(const float* in, uint8_t* out, size_t count)
+{
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		__m128i a = _mm_packs_epi32(ToUnormSSE(_mm_loadu_ps(in + i     ), 255.0f), ToUnormSSE(_mm_loadu_ps(in + i +  4), 255.0f));
+		__m128i b = _mm_packs_epi32(ToUnormSSE(_mm_loadu_ps(in + i +  8), 255.0f), ToUnormSSE(_mm_loadu_ps(in + i + 12), 255.0f));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packus_epi16(a, b));
+	}
+	for (; i < count; ++i)  out[i] = FloatToUnorm8(in[i]);
+}
+
+// Octahedral encode 4 vectors, returning the rounded snorm values of each lane
+inline void OctahedralEncodeSSE(const CVector3* in, size_t inStride, float scale, __m128i& outX, __m128i& outY)
+{
+	const CVector3* v0 = in;
+	const CVector3* v1 = Advance(v0, inStride);
+	const CVector3* v2 = Advance(v1, inStride);
+	const CVector3* v3 = Advance(v2, inStride);
+	__m128 vx = _mm_setr_ps(v0->x, v1->x, v2->x, v3->x);
+	__m128 vy = _mm_setr_ps(v0->y, v1->y, v2->y, v3->y);
+	__m128 vz = _mm_setr_ps(v0->z, v1->z, v2->z, v3->z);
+
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	const __m128 one = _mm_set1_ps(1.0f);
+	__m128 sum = _mm_add_ps(_mm_add_ps(_mm_andnot_ps(signMask, vx), _mm_andnot_ps(signMask, vy)), _mm_andnot_ps(signMask, vz));
+	__m128 invSum = _mm_div_ps(one, sum);
+	__m128 x = _mm_mul_ps(vx, invSum);
+	__m128 y = _mm_mul_ps(vy, invSum);
+
+	__m128 foldedX = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, y)), _mm_or_ps(_mm_and_ps(signMask, x), one));
+	__m128 foldedY = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, x)), _mm_or_ps(_mm_and_ps(signMask, y), one));
+	__m128 lowerHalf = _mm_cmplt_ps(vz, _mm_setzero_ps());
+	outX = ToSnormSSE(Select(lowerHalf, foldedX, x), scale);
+	outY = ToSnormSSE(Select(lowerHalf, foldedY, y), scale);
+}
+
+void PackOctahedral16SSE(const CVector3* in, size_t inStride, uint32_t* out, size_t outStride, size_t count)
+{
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i x, y;
+		OctahedralEncodeSSE(in, inStride, 32767.0f, x, y);
+		alignas(16) uint32_t packed[4];
+		_mm_store_si128(reinterpret_cast<__m128i*>(packed), _mm_or_si128(_mm_and_si128(x, _mm_set1_epi32(0xffff)), _mm_slli_epi32(y, 16)));
+		for (int lane = 0; lane < 4; ++lane)
+		{
+			*out = packed[lane];
+			out = Advance(out, outStride);
+		}
+		in = Advance(in, 4 * inStride);
+	}
+	for (; i < count; ++i)
+	{
+		*out = PackOctahedral16(*in);
+		in = Advance(in, inStride);
+		out = Advance(out, outStride);
+	}
+}
+
+void PackOctahedral8SSE(const CVector3* in, size_t inStride, uint16_t* out, size_t outStride, size_t count)
+{
+	const __m128i byteMask = _mm_set1_epi32(0xff);
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i x, y;
+		OctahedralEncodeSSE(in, inStride, 127.0f, x, y);
+		alignas(16) uint32_t packed[4];
+		_mm_store_si128(reinterpret_cast<__m128i*>(packed), _mm_or_si128(_mm_and_si128(x, byteMask), _mm_slli_epi32(_mm_and_si128(y, byteMask), 8)));
+		for (int lane = 0; lane < 4; ++lane)
+		{
+			*out = static_cast<uint16_t>(packed[lane]);
+			out = Advance(out, outStride);
+		}
+		in = Advance(in, 4 * inStride);
+	}
+	for (; i < count; ++i)
+	{
+		*out = PackOctahedral8(*in);
+		in = Advance(in, inStride);
+		out = Advance(out, outStride);
+	}
+}
+#endif
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Half floats
+-----------------------------------------------------------------------------------------*/
+
+// Convert a float to a half float, rounding to nearest even
+uint16_t FloatToHalf(float f)
+{
+	uint32_t u = AsUint(f);
+	uint32_t sign = u & 0x80000000u;
+	u ^= sign;
+
+	uint32_t h;
+	if (u >= HALF_OVERFLOW)
+	{
+		h = (u > FLOAT_INFINITY) ? 0x7e00 : 0x7c00; // NaN stays NaN (quiet), everything else becomes infinity
+	}
+	else if (u < HALF_MIN_NORMAL)
+	{
+		// Half denormal or zero - adding the magic number lines the mantissa up with the half's and the FPU rounds it
+		h = AsUint(AsFloat(u) + AsFloat(DENORMAL_MAGIC)) - DENORMAL_MAGIC;
+	}
+	else
+	{
+		// Rebias the exponent and round to nearest even (add 0xfff, plus one more if the result would be odd)
+		uint32_t mantissaOdd = (u >> 13) & 1;
+		h = (u + REBIAS_AND_ROUND + mantissaOdd) >> 13;
+	}
+	return static_cast<uint16_t>(h | (sign >> 16));
+}
+
+// Convert a half float to a float
+float HalfToFloat(uint16_t h)
+{
+	uint32_t u = static_cast<uint32_t>(h & 0x7fff) << 13;
+	uint32_t exponent = u & SHIFTED_EXPONENT;
+	u += EXPONENT_ADJUST;
+
+	if (exponent == SHIFTED_EXPONENT)
+	{
+		u += INFINITY_ADJUST; // Infinity or NaN
+	}
+	else if (exponent == 0)
+	{
+		u = AsUint(AsFloat(u + (1 << 23)) - AsFloat(DENORMAL_ADJUST)); // Zero or denormal, let the FPU renormalise
+	}
+	return AsFloat(u | static_cast<uint32_t>(h & 0x8000) << 16);
+}
+
+// Batch float to half conversion
+void FloatsToHalves(const float* in, uint16_t* out, size_t count)
+{
+#if defined(UMBRA_MATHS_X86)
+	if (simd::ActiveInstructionSet() != simd::EInstructionSet::Scalar)
+	{
+		FloatsToHalvesSSE(in, out, count);
+		return;
+	}
+#endif
+	for (size_t i = 0; i < count; ++i)  out[i] = FloatToHalf(in[i]);
+}
+
+// Batch half to float conversion
+void HalvesToFloats(const uint16_t* in, float* out, size_t count)
+{
+#if defined(UMBRA_MATHS_X86)
+	if (simd::ActiveInstructionSet() != simd::EInstructionSet::Scalar)
+	{
+		HalvesToFloatsSSE(in, out, count);
+		return;
+	}
+#endif
+	for (size_t i = 0; i < count; ++i)  out[i] = HalfToFloat(in[i]);
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Normalised integers
+-----------------------------------------------------------------------------------------*/
+
+int16_t FloatToSnorm16(float f)
+{
+	return static_cast<int16_t>(std::lrint(ClampSigned(f) * 32767.0f));
+}
+
+int8_t FloatToSnorm8(float f)
+{
+	return static_cast<int8_t>(std::lrint(ClampSigned(f) * 127.0f));
+}
+
+uint16_t FloatToUnorm16(float f)
+{
+	return static_cast<uint16_t>(std::lrint(ClampUnsigned(f) * 65535.0f));
+}
+
+uint8_t FloatToUnorm8(float f)
+{
+	return static_cast<uint8_t>(std::lrint(ClampUnsigned(f) * 255.0f));
+}
+
+float Snorm16ToFloat(int16_t i)
+{
+	float f = static_cast<float>(i) / 32767.0f;
+	return f > -1.0f ? f : -1.0f;
+}
+
+float Snorm8ToFloat(int8_t i)
+{
+	float f = static_cast<float>(i) / 127.0f;
+	return f > -1.0f ? f : -1.0f;
+}
+
+float Unorm16ToFloat(uint16_t i)
+{
+	return static_cast<float>(i) / 65535.0f;
+}
+
+float Unorm8ToFloat(uint8_t i)
+{
+	return static_cast<float>(i) / 255.0f;
+}
+
+void FloatsToSnorm16(const float* in, int16_t* out, size_t count)
+{
+#if defined(UMBRA_MATHS_X86)
+	if (simd::ActiveInstructionSet() != simd::EInstructionSet::Scalar)
+	{
+		FloatsToSnorm16SSE(in, out, count);
+		return;
+	}
+#endif
+	for (size_t i = 0; i < count; ++i)  out[i] = FloatToSnorm16(in[i]);
+}
+
+void FloatsToSnorm8(const float* in, int8_t* out, size_t count)
+{
+#if defined(UMBRA_MATHS_X86)
+	if (simd::ActiveInstructionSet() != simd::EInstructionSet::Scalar)
+	{
+		FloatsToSnorm8SSE(in, out, count);
+		return;
+	}
+#endif
+	for (size_t i = 0; i < count; ++i)  out[i] = FloatToSnorm8(in[i]);
+}
+
+void FloatsToUnorm16(const float* in, uint16_t* out, size_t count)
+{
+#if defined(UMBRA_MATHS_X86)
+	if (simd::ActiveInstructionSet() != simd::EInstructionSet::Scalar)
+	{
+		FloatsToUnorm16SSE(in, out, count);
+		return;
+	}
+#endif
+	for (size_t i = 0; i < count; ++i)  out[i] = FloatToUnorm16(in[i]);
+}
+
+void FloatsToUnorm8(const float* in, uint8_t* out, size_t count)
+{
+#if defined(UMBRA_MATHS_X86)
+	if (simd::ActiveInstructionSet() != simd::EInstructionSet::Scalar)
+	{
+		FloatsToUnorm8SSE(in, out, count);
+		return;
+	}
+#endif
+	for (size_t i = 0; i < count; ++i)  out[i] = FloatToUnorm8(in[i]);
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Octahedral unit vectors
+-----------------------------------------------------------------------------------------*/
+
+// Encode a unit vector to a point in the square -1 to 1
+CVector2 OctahedralEncode(const CVector3& v)
+{
+	float x, y;
+	OctahedralEncodeScalar(v.x, v.y, v.z, x, y);
+	return CVector2{ x, y };
+}
+
+// Decode a point in the square -1 to 1 to a unit vector: unfold the corners back under the octahedron, then normalise
+CVector3 OctahedralDecode(const CVector2& e)
+{
+	CVector3 v{ e.x, e.y, 1.0f - std::abs(e.x) - std::abs(e.y) };
+	float fold = v.z < 0.0f ? -v.z : 0.0f;
+	v.x += v.x >= 0.0f ? -fold : fold;
+	v.y += v.y >= 0.0f ? -fold : fold;
+	return Normalise(v);
+}
+
+uint32_t PackOctahedral16(const CVector3& v)
+{
+	CVector2 e = OctahedralEncode(v);
+	return static_cast<uint16_t>(FloatToSnorm16(e.x)) | static_cast<uint32_t>(static_cast<uint16_t>(FloatToSnorm16(e.y))) << 16;
+}
+
+CVector3 UnpackOctahedral16(uint32_t packed)
+{
+	return OctahedralDecode({ Snorm16ToFloat(static_cast<int16_t>(packed & 0xffff)), Snorm16ToFloat(static_cast<int16_t>(packed >> 16)) });
+}
+
+uint16_t PackOctahedral8(const CVector3& v)
+{
+	CVector2 e = OctahedralEncode(v);
+	return static_cast<uint16_t>(static_cast<uint8_t>(FloatToSnorm8(e.x)) | static_cast<uint8_t>(FloatToSnorm8(e.y)) << 8);
+}
+
+CVector3 UnpackOctahedral8(uint16_t packed)
+{
+	return OctahedralDecode({ Snorm8ToFloat(static_cast<int8_t>(packed & 0xff)), Snorm8ToFloat(static_cast<int8_t>(packed >> 8)) });
+}
+
+void PackOctahedral16(const CVector3* in, size_t inStride, uint32_t* out, size_t outStride, size_t count)
+{
+#if defined(UMBRA_MATHS_X86)
+	if (simd::ActiveInstructionSet() != simd::EInstructionSet::Scalar)
+	{
+		PackOctahedral16SSE(in, inStride, out, outStride, count);
+		return;
+	}
+#endif
+	for (size_t i = 0; i < count; ++i)
+	{
+		*out = PackOctahedral16(*in);
+		in = Advance(in, inStride);
+		out = Advance(out, outStride);
+	}
+}
+
+void PackOctahedral8(const CVector3* in, size_t inStride, uint16_t* out, size_t outStride, size_t count)
+{
+#if defined(UMBRA_MATHS_X86)
+	if (simd::ActiveInstructionSet() != simd::EInstructionSet::Scalar)
+	{
+		PackOctahedral8SSE(in, inStride, out, outStride, count);
+		return;
+	}
+#endif
+	for (size_t i = 0; i < count; ++i)
+	{
+		*out = PackOctahedral8(*in);
+		in = Advance(in, inStride);
+		out = Advance(out, outStride);
+	}
+}
+
+} } //Namespaces
@@ -0,0 +1,105 @@
+#ifndef _VERTEX_PACKING_H_
+#define _VERTEX_PACKING_H_
+//======================================================================================
+
+//--------------------------------------------------------------------------------------
+// Compact formats for vertex and animation data
+// Half floats, normalised integers (snorm / unorm) and octahedral unit vectors, with the
+// single value conversions and batch versions for converting whole vertex buffers
+//--------------------------------------------------------------------------------------
+// Code in .cpp file
+// Each packed format matches a DXGI format that the GPU unpacks for free when reading vertices:
+//     half           - DXGI_FORMAT_R16_FLOAT etc. (1 sign, 5 exponent, 10 mantissa bits)
+//     snorm16/snorm8 - DXGI_FORMAT_R16_SNORM / R8_SNORM, -1 to 1 in steps of 1/32767 or 1/127
+//     unorm16/unorm8 - DXGI_FORMAT_R16_UNORM / R8_UNORM, 0 to 1 in steps of 1/65535 or 1/255
+//     octahedral     - unit vector folded onto a square, stored as 2 snorm16 (R16G16_SNORM) or 2 snorm8 (R8G8_SNORM).
+//                      The shader must call the decode function to get the vector back (see OctahedralDecode)
+// Values are rounded to nearest (ties to even) and out of range values are clamped - half floats become infinity
+// Batch functions use SSE when available, with exactly the same results as the single value functions. The input
+// and output of the vector functions are strided (see BatchTransform.hpp) so they can work inside vertex structures
+
+#include "CVector2.hpp"
+#include "CVector3.hpp"
+
+#include <cstdint>
+#include <cstddef>
+
+//======================================================================================
+namespace umbra_engine
+{
+
+namespace maths
+{
+/*-----------------------------------------------------------------------------------------
+	Half floats
+-----------------------------------------------------------------------------------------*/
+
+// Convert a float to a half float (stored in a uint16_t). Handles denormals, infinity and NaN
+uint16_t FloatToHalf(float f);
+
+// Convert a half float to a float. Exact, every half float is representable as a float
+float HalfToFloat(uint16_t h);
+
+// Batch versions of the above. Output may not be the same array as the input
+void FloatsToHalves(const float* in, uint16_t* out, size_t count);
+void HalvesToFloats(const uint16_t* in, float* out, size_t count);
+
+
+/*-----------------------------------------------------------------------------------------
+	Normalised integers
+-----------------------------------------------------------------------------------------*/
+
+// Convert a float to a normalised integer, clamping to the range of the format (-1 to 1 or 0 to 1)
+int16_t  FloatToSnorm16(float f);
+int8_t   FloatToSnorm8(float f);
+uint16_t FloatToUnorm16(float f);
+uint8_t  FloatToUnorm8(float f);
+
+// Convert back, the same way as the GPU does (the most negative snorm value is treated as -1)
+float Snorm16ToFloat(int16_t i);
+float Snorm8ToFloat(int8_t i);
+float Unorm16ToFloat(uint16_t i);
+float Unorm8ToFloat(uint8_t i);
+
+// Batch versions of the float to normalised integer conversions
+void FloatsToSnorm16(const float* in, int16_t* out, size_t count);
+void FloatsToSnorm8(const float* in, int8_t* out, size_t count);
+void FloatsToUnorm16(const float* in, uint16_t* out, size_t count);
+void FloatsToUnorm8(const float* in, uint8_t* out, size_t count);
+
+
+/*-----------------------------------------------------------------------------------------
+	Octahedral unit vectors
+-----------------------------------------------------------------------------------------*/
+// Normals and tangents are unit length so only need two values. Projecting onto an octahedron and folding
+// the lower half out to the corners spreads the precision evenly over the sphere: 2 x snorm16 has a worst
+// case error of about 0.004 degrees, 2 x snorm8 about 1 degree. Tangents use the same encoding (the
+// shaders in this app rebuild the bitangent from the normal and tangent, so no handedness is stored)
+
+// Encode a unit vector to a point in the square -1 to 1 / decode it again (result is normalised)
+CVector2 OctahedralEncode(const CVector3& v);
+CVector3 OctahedralDecode(const CVector2& e);
+
+// Encode a unit vector to 2 snorm16 values packed as x | y << 16 (DXGI_FORMAT_R16G16_SNORM) and back
+uint32_t PackOctahedral16(const CVector3& v);
+CVector3 UnpackOctahedral16(uint32_t packed);
+
+// Encode a unit vector to 2 snorm8 values packed as x | y << 8 (DXGI_FORMAT_R8G8_SNORM) and back
+uint16_t PackOctahedral8(const CVector3& v);
+CVector3 UnpackOctahedral8(uint16_t packed);
+
+// Batch versions of the above. Vectors are read inStride bytes apart and the packed values written outStride bytes apart
+void PackOctahedral16(const CVector3* in, size_t inStride, uint32_t* out, size_t outStride, size_t count);
+void PackOctahedral8(const CVector3* in, size_t inStride, uint16_t* out, size_t outStride, size_t count);
+inline void PackOctahedral16(const CVector3* in, uint32_t* out, size_t count)
+{
+	PackOctahedral16(in, sizeof(CVector3), out, sizeof(uint32_t), count);
+}
+inline void PackOctahedral8(const CVector3* in, uint16_t* out, size_t count)
+{
+	PackOctahedral8(in, sizeof(CVector3), out, sizeof(uint16_t), count);
+}
+
+} } //Namespaces
+//======================================================================================
+#endif // _VERTEX_PACKING_H_
@@ -0,0 +1,289 @@
+#ifndef _WIDE_FLOAT_H_
+#define _WIDE_FLOAT_H_
+//======================================================================================
+
+//--------------------------------------------------------------------------------------
+// 4 and 8-wide float types for data-parallel code
+// Thin wrappers over SSE / AVX registers so vectorised loops can be written with normal
+// operators, and still build (as plain loops) where the intrinsics aren't available
+//--------------------------------------------------------------------------------------
+// Code in header so everything inlines down to the intrinsics
+// Comparisons return masks: the same type with every bit of a lane set where the comparison is true and
+// clear where it is false. Combine masks with & and |, use them with Select, or test them with Any / All
+//
+// CFloat4 uses SSE (always available on x64). CFloat8 uses AVX when the compiler targets it (/arch:AVX,
+// -mavx), otherwise it is a pair of CFloat4s - which gives the same results, just 4 lanes at a time. Code
+// that picks an instruction set at runtime (see SIMD.hpp) should use CFloat4, or compile its AVX path with
+// AVX enabled. Every operation is correctly rounded per lane so results match the scalar calculation exactly
+
+#include "SIMD.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+//======================================================================================
+namespace umbra_engine
+{
+
+namespace maths
+{
+/*-----------------------------------------------------------------------------------------
+	CFloat4
+-----------------------------------------------------------------------------------------*/
+
+#if defined(UMBRA_MATHS_X86)
+
+class CFloat4
+{
+public:
+	static const int WIDTH = 4;
+
+	__m128 v;
+
+	// Default constructor - leaves values uninitialised (for performance)
+	CFloat4() {}
+	CFloat4(__m128 vIn) : v(vIn) {}
+
+	// Set all lanes to the same value
+	CFloat4(float f) : v(_mm_set1_ps(f)) {}
+
+	// Load / store 4 floats, no alignment needed
+	static CFloat4 Load(const float* p) { return _mm_loadu_ps(p); }
+	void Store(float* p) const { _mm_storeu_ps(p, v); }
+
+	// Value of a single lane. Slow, use for debugging or the odd leftover value
+	float operator[](int lane) const { alignas(16) float f[WIDTH]; _mm_store_ps(f, v); return f[lane]; }
+};
+
+inline CFloat4 operator+ (const CFloat4& a, const CFloat4& b) { return _mm_add_ps(a.v, b.v); }
+inline CFloat4 operator- (const CFloat4& a, const CFloat4& b) { return _mm_sub_ps(a.v, b.v); }
+inline CFloat4 operator* (const CFloat4& a, const CFloat4& b) { return _mm_mul_ps(a.v, b.v); }
+inline CFloat4 operator/ (const CFloat4& a, const CFloat4& b) { return _mm_div_ps(a.v, b.v); }
+inline CFloat4 operator- (const CFloat4& a) { return _mm_xor_ps(a.v, _mm_set1_ps(-0.0f)); }
+
+inline CFloat4 operator<  (const CFloat4& a, const CFloat4& b) { return _mm_cmplt_ps(a.v, b.v); }
+inline CFloat4 operator<= (const CFloat4& a, const CFloat4& b) { return _mm_cmple_ps(a.v, b.v); }
+inline CFloat4 operator>  (const CFloat4& a, const CFloat4& b) { return _mm_cmpgt_ps(a.v, b.v); }
+inline CFloat4 operator>= (const CFloat4& a, const CFloat4& b) { return _mm_cmpge_ps(a.v, b.v); }
+inline CFloat4 operator== (const CFloat4& a, const CFloat4& b) { return _mm_cmpeq_ps(a.v, b.v); }
+inline CFloat4 operator!= (const CFloat4& a, const CFloat4& b) { return _mm_cmpneq_ps(a.v, b.v); }
+inline CFloat4 operator&  (const CFloat4& a, const CFloat4& b) { return _mm_and_ps(a.v, b.v); }
+inline CFloat4 operator|  (const CFloat4& a, const CFloat4& b) { return _mm_or_ps(a.v, b.v); }
+
+// Lane-wise minimum / maximum. If either lane is NaN, the lane from b is returned
+inline CFloat4 Min(const CFloat4& a, const CFloat4& b) { return _mm_min_ps(a.v, b.v); }
+inline CFloat4 Max(const CFloat4& a, const CFloat4& b) { return _mm_max_ps(a.v, b.v); }
+
+inline CFloat4 Sqrt(const CFloat4& a) { return _mm_sqrt_ps(a.v); }
+inline CFloat4 Abs(const CFloat4& a)  { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v); }
+
+// Lanes from a where the mask is set, otherwise from b
+inline CFloat4 Select(const CFloat4& mask, const CFloat4& a, const CFloat4& b)
+{
+	return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v));
+}
+
+// One bit per lane of a mask, lane 0 in bit 0
+inline int BitMask(const CFloat4& mask) { return _mm_movemask_ps(mask.v); }
+
+#else
+
+// Plain C++ version with the same behaviour. Masks are held as float bit patterns, as in SSE
+class CFloat4
+{
+public:
+	static const int WIDTH = 4;
+
+	float v[WIDTH];
+
+	CFloat4() {}
+	CFloat4(float f) { for (int i = 0; i < WIDTH; ++i) v[i] = f; }
+
+	static CFloat4 Load(const float* p) { CFloat4 r; for (int i = 0; i < WIDTH; ++i) r.v[i] = p[i]; return r; }
+	void Store(float* p) const { for (int i = 0; i < WIDTH; ++i) p[i] = v[i]; }
+
+	float operator[](int lane) const { return v[lane]; }
+};
+
+namespace wide_float_detail
+{
+inline uint32_t Bits(float f) { uint32_t u; std::memcpy(&u, &f, sizeof(u)); return u; }
+inline float FromBits(uint32_t u) { float f; std::memcpy(&f, &u, sizeof(f)); return f; }
+inline float MaskLane(bool b) { return FromBits(b ? 0xffffffffu : 0u); }
+
+// Apply an operation to each lane
+template <typename Op>
+inline CFloat4 Map(const CFloat4& a, const CFloat4& b, Op op)
+{
+	CFloat4 r;
+	for (int i = 0; i < CFloat4::WIDTH; ++i) r.v[i] = op(a.v[i], b.v[i]);
+	return r;
+}
+}
+
+inline CFloat4 operator+ (const CFloat4& a, const CFloat4& b) { return wide_float_detail::Map(a, b, [](float x, float y) { return x + y; }); }
+inline CFloat4 operator- (const CFloat4& a, const CFloat4& b) { return wide_float_detail::Map(a, b, [](float x, float y) { return x - y; }); }
+inline CFloat4 operator* (const CFloat4& a, const CFloat4& b) { return wide_float_detail::Map(a, b, [](float x, float y) { return x * y; }); }
+inline CFloat4 operator/ (const CFloat4& a, const CFloat4& b) { return wide_float_detail::Map(a, b, [](float x, float y) { return x / y; }); }
+inline CFloat4 operator- (const CFloat4& a) { return wide_float_detail::Map(a, a, [](float x, float) { return -x; }); }
+
+inline CFloat4 operator<  (const CFloat4& a, const CFloat4& b) { return wide_float_detail::Map(a, b, [](float x, float y) { return wide_float_detail::MaskLane(x <  y); }); }
+inline CFloat4 operator<= (const CFloat4& a, const CFloat4& b) { return wide_float_detail::Map(a, b, [](float x, float y) { return wide_float_detail::MaskLane(x <= y); }); }
+inline CFloat4 operator>  (const CFloat4& a, const CFloat4& b) { return wide_float_detail::Map(a, b, [](float x, float y) { return wide_float_detail::MaskLane(x >  y); }); }
+inline CFloat4 operator>= (const CFloat4& a, const CFloat4& b) { return wide_float_detail::Map(a, b, [](float x, float y) { return wide_float_detail::MaskLane(x >= y); }); }
+inline CFloat4 operator== (const CFloat4& a, const CFloat4& b) { return wide_float_detail::Map(a, b, [](float x, float y) { return wide_float_detail::MaskLane(x == y); }); }
+inline CFloat4 operator!= (const CFloat4& a, const CFloat4& b) { return wide_float_detail::Map(a, b, [](float x, float y) { return wide_float_detail::MaskLane(x != y); }); }
+inline CFloat4 operator&  (const CFloat4& a, const CFloat4& b)
+{
+	return wide_float_detail::Map(a, b, [](float x, float y) { return wide_float_detail::FromBits(wide_float_detail::Bits(x) & wide_float_detail::Bits(y)); });
+}
+inline CFloat4 operator|  (const CFloat4& a, const CFloat4& b)
+{
+	return wide_float_detail::Map(a, b, [](float x, float y) { return wide_float_detail::FromBits(wide_float_detail::Bits(x) | wide_float_detail::Bits(y)); });
+}
+
+inline CFloat4 Min(const CFloat4& a, const CFloat4& b) { return wide_float_detail::Map(a, b, [](float x, float y) { return x < y ? x : y; }); }
+inline CFloat4 Max(const CFloat4& a, const CFloat4& b) { return wide_float_detail::Map(a, b, [](float x, float y) { return x > y ? x : y; }); }
+
+inline CFloat4 Sqrt(const CFloat4& a) { return wide_float_detail::Map(a, a, [](float x, float) { return std::sqrt(x); }); }
+inline CFloat4 Abs(const CFloat4& a)  { return wide_float_detail::Map(a, a, [](float x, float) { return std::abs(x); }); }
+
+inline CFloat4 Select(const CFloat4& mask, const CFloat4& a, const CFloat4& b)
+{
+	CFloat4 r;
+	for (int i = 0; i < CFloat4::WIDTH; ++i) r.v[i] = (wide_float_detail::Bits(mask.v[i]) & 0x80000000u) ? a.v[i] : b.v[i];
+	return r;
+}
+
+inline int BitMask(const CFloat4& mask)
+{
+	int bits = 0;
+	for (int i = 0; i < CFloat4::WIDTH; ++i) bits |= static_cast<int>(wide_float_detail::Bits(mask.v[i]) >> 31) << i;
+	return bits;
+}
+
+#endif
+
+
+/*-----------------------------------------------------------------------------------------
+	CFloat8
+-----------------------------------------------------------------------------------------*/
+
+#if defined(UMBRA_MATHS_X86) && defined(__AVX__)
+
+class CFloat8
+{
+public:
+	static const int WIDTH = 8;
+
+	__m256 v;
+
+	CFloat8() {}
+	CFloat8(__m256 vIn) : v(vIn) {}
+	CFloat8(float f) : v(_mm256_set1_ps(f)) {}
+
+	// Build from / split into two halves, lanes 0-3 and 4-7
+	CFloat8(const CFloat4& low, const CFloat4& high) : v(_mm256_insertf128_ps(_mm256_castps128_ps256(low.v), high.v, 1)) {}
+	CFloat4 Low() const  { return _mm256_castps256_ps128(v); }
+	CFloat4 High() const { return _mm256_extractf128_ps(v, 1); }
+
+	static CFloat8 Load(const float* p) { return _mm256_loadu_ps(p); }
+	void Store(float* p) const { _mm256_storeu_ps(p, v); }
+
+	float operator[](int lane) const { alignas(32) float f[WIDTH]; _mm256_store_ps(f, v); return f[lane]; }
+};
+
+inline CFloat8 operator+ (const CFloat8& a, const CFloat8& b) { return _mm256_add_ps(a.v, b.v); }
+inline CFloat8 operator- (const CFloat8& a, const CFloat8& b) { return _mm256_sub_ps(a.v, b.v); }
+inline CFloat8 operator* (const CFloat8& a, const CFloat8& b) { return _mm256_mul_ps(a.v, b.v); }
+inline CFloat8 operator/ (const CFloat8& a, const CFloat8& b) { return _mm256_div_ps(a.v, b.v); }
+inline CFloat8 operator- (const CFloat8& a) { return _mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f)); }
+
+inline CFloat8 operator<  (const CFloat8& a, const CFloat8& b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); }
+inline CFloat8 operator<= (const CFloat8& a, const CFloat8& b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ); }
+inline CFloat8 operator>  (const CFloat8& a, const CFloat8& b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ); }
+inline CFloat8 operator>= (const CFloat8& a, const CFloat8& b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ); }
+inline CFloat8 operator== (const CFloat8& a, const CFloat8& b) { return _mm256_cmp_ps(a.v, b.v, _CMP_EQ_OQ); }
+inline CFloat8 operator!= (const CFloat8& a, const CFloat8& b) { return _mm256_cmp_ps(a.v, b.v, _CMP_NEQ_UQ); }
+inline CFloat8 operator&  (const CFloat8& a, const CFloat8& b) { return _mm256_and_ps(a.v, b.v); }
+inline CFloat8 operator|  (const CFloat8& a, const CFloat8& b) { return _mm256_or_ps(a.v, b.v); }
+
+inline CFloat8 Min(const CFloat8& a, const CFloat8& b) { return _mm256_min_ps(a.v, b.v); }
+inline CFloat8 Max(const CFloat8& a, const CFloat8& b) { return _mm256_max_ps(a.v, b.v); }
+
+inline CFloat8 Sqrt(const CFloat8& a) { return _mm256_sqrt_ps(a.v); }
+inline CFloat8 Abs(const CFloat8& a)  { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v); }
+
+inline CFloat8 Select(const CFloat8& mask, const CFloat8& a, const CFloat8& b) { return _mm256_blendv_ps(b.v, a.v, mask.v); }
+
+inline int BitMask(const CFloat8& mask) { return _mm256_movemask_ps(mask.v); }
+
+#else
+
+// Two CFloat4s, for compilers not targeting AVX
+class CFloat8
+{
+public:
+	static const int WIDTH = 8;
+
+	CFloat4 low;
+	CFloat4 high;
+
+	CFloat8() {}
+	CFloat8(float f) : low(f), high(f) {}
+
+	CFloat8(const CFloat4& lowIn, const CFloat4& highIn) : low(lowIn), high(highIn) {}
+	CFloat4 Low() const  { return low; }
+	CFloat4 High() const { return high; }
+
+	static CFloat8 Load(const float* p) { return CFloat8{ CFloat4::Load(p), CFloat4::Load(p + 4) }; }
+	void Store(float* p) const { low.Store(p); high.Store(p + 4); }
+
+	float operator[](int lane) const { return lane < 4 ? low[lane] : high[lane - 4]; }
+};
+
+inline CFloat8 operator+ (const CFloat8& a, const CFloat8& b) { return CFloat8{ a.low + b.low, a.high + b.high }; }
+inline CFloat8 operator- (const CFloat8& a, const CFloat8& b) { return CFloat8{ a.low - b.low, a.high - b.high }; }
+inline CFloat8 operator* (const CFloat8& a, const CFloat8& b) { return CFloat8{ a.low * b.low, a.high * b.high }; }
+inline CFloat8 operator/ (const CFloat8& a, const CFloat8& b) { return CFloat8{ a.low / b.low, a.high / b.high }; }
+inline CFloat8 operator- (const CFloat8& a) { return CFloat8{ -a.low, -a.high }; }
+
+inline CFloat8 operator<  (const CFloat8& a, const CFloat8& b) { return CFloat8{ a.low <  b.low, a.high <  b.high }; }
+inline CFloat8 operator<= (const CFloat8& a, const CFloat8& b) { return CFloat8{ a.low <= b.low, a.high <= b.high }; }
+inline CFloat8 operator>  (const CFloat8& a, const CFloat8& b) { return CFloat8{ a.low >  b.low, a.high >  b.high }; }
+inline CFloat8 operator>= (const CFloat8& a, const CFloat8& b) { return CFloat8{ a.low >= b.low, a.high >= b.high }; }
+inline CFloat8 operator== (const CFloat8& a, const CFloat8& b) { return CFloat8{ a.low == b.low, a.high == b.high }; }
+inline CFloat8 operator!= (const CFloat8& a, const CFloat8& b) { return CFloat8{ a.low != b.low, a.high != b.high }; }
+inline CFloat8 operator&  (const CFloat8& a, const CFloat8& b) { return CFloat8{ a.low & b.low, a.high & b.high }; }
+inline CFloat8 operator|  (const CFloat8& a, const CFloat8& b) { return CFloat8{ a.low | b.low, a.high | b.high }; }
+
+inline CFloat8 Min(const CFloat8& a, const CFloat8& b) { return CFloat8{ Min(a.low, b.low), Min(a.high, b.high) }; }
+inline CFloat8 Max(const CFloat8& a, const CFloat8& b) { return CFloat8{ Max(a.low, b.low), Max(a.high, b.high) }; }
+
+inline CFloat8 Sqrt(const CFloat8& a) { return CFloat8{ Sqrt(a.low), Sqrt(a.high) }; }
+inline CFloat8 Abs(const CFloat8& a)  { return CFloat8{ Abs(a.low), Abs(a.high) }; }
+
+inline CFloat8 Select(const CFloat8& mask, const CFloat8& a, const CFloat8& b)
+{
+	return CFloat8{ Select(mask.low, a.low, b.low), Select(mask.high, a.high, b.high) };
+}
+
+inline int BitMask(const CFloat8& mask) { return BitMask(mask.low) | BitMask(mask.high) << 4; }
+
+#endif
+
+
+/*-----------------------------------------------------------------------------------------
+	Mask tests
+-----------------------------------------------------------------------------------------*/
+
+// True if any / all lanes of a mask are set
+inline bool Any(const CFloat4& mask) { return BitMask(mask) != 0; }
+inline bool Any(const CFloat8& mask) { return BitMask(mask) != 0; }
+inline bool All(const CFloat4& mask) { return BitMask(mask) == 0xf; }
+inline bool All(const CFloat8& mask) { return BitMask(mask) == 0xff; }
+
+} } //Namespaces
+//======================================================================================
+#endif // _WIDE_FLOAT_H_
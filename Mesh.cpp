@@ -11,8 +11,12 @@
 #include "Shader.hpp" // Needed for helper function CreateSignatureForVertexLayout
 #include "CVector2.hpp" 
 #include "CVector3.hpp" 
+#include "BatchTransform.hpp"
+#include "CDualQuaternion.hpp"
 #include "ITexture.h"
 #include "CTexture.h"
+#include "IModel.hpp"
+#include "InstanceBuffer.hpp"
 
 #include <assimp/Importer.hpp>
 #include <assimp/DefaultLogger.hpp>
@@ -20,6 +24,7 @@
 #include <assimp/scene.h>
 
 #include <memory>
+#include <algorithm>
 
 #include "DirectX11Engine.hpp"
 
@@ -104,6 +109,13 @@ Mesh::Mesh(const std::string& fileName, IEngine * engine = nullptr, bool require
 	mNodes.resize(CountNodes(scene->mRootNode));
 	ReadNodes(scene->mRootNode, 0, 0);
 
+	// Keep the parent indexes in one array so the absolute matrices can be calculated in a batch when rendering
+	mNodeParents.resize(mNodes.size());
+	for (unsigned int nodeIndex = 0; nodeIndex < mNodes.size(); ++nodeIndex)
+	{
+		mNodeParents[nodeIndex] = mNodes[nodeIndex].parentIndex;
+	}
+
 
 
 	//******************************************//
@@ -176,6 +188,22 @@ Mesh::Mesh(const std::string& fileName, IEngine * engine = nullptr, bool require
 		if (shaderSignature)  shaderSignature->Release();
 		if (FAILED(hr))  throw std::runtime_error("Failure creating input layout for " + fileName);
 
+		// The instanced layout adds the four rows of a world matrix, read once per instance from vertex buffer 1
+		// Must match InstancedTangentVertex in Common.hlsli
+		if (!mHasBones)
+		{
+			for (UINT row = 0; row < 4; ++row)
+			{
+				vertexElements.push_back({ "instanceWorld", row, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, row * 16, D3D11_INPUT_PER_INSTANCE_DATA, 1 });
+			}
+			shaderSignature = CreateSignatureForVertexLayout(vertexElements.data(), static_cast<int>(vertexElements.size()));
+			hr = myEngine->GetDevice()->CreateInputLayout(vertexElements.data(), static_cast<UINT>(vertexElements.size()),
+				shaderSignature->GetBufferPointer(), shaderSignature->GetBufferSize(),
+				&subMesh.instancedVertexLayout);
+			if (shaderSignature)  shaderSignature->Release();
+			if (FAILED(hr))  throw std::runtime_error("Failure creating instanced input layout for " + fileName);
+		}
+
 
 
 		//-----------------------------------
@@ -193,6 +221,7 @@ Mesh::Mesh(const std::string& fileName, IEngine * engine = nullptr, bool require
 		// Copy mesh data from assimp to our CPU-side vertex buffer
 
 		maths::CVector3* assimpPosition = reinterpret_cast<maths::CVector3*>(assimpMesh->mVertices);
+		subMesh.bounds = maths::AABBFromPoints(assimpPosition, sizeof(maths::CVector3), subMesh.numVertices);
 		unsigned char* position = vertices.get() + positionOffset;
 		unsigned char* positionEnd = position + subMesh.numVertices * subMesh.vertexSize;
 		while (position != positionEnd)
@@ -367,6 +396,74 @@ Mesh::Mesh(const std::string& fileName, IEngine * engine = nullptr, bool require
 		hr = myEngine->GetDevice()->CreateBuffer(&bufferDesc, &initData, &subMesh.indexBuffer);
 		if (FAILED(hr))  throw std::runtime_error("Failure creating index buffer for " + fileName);
 
+		// Keep a CPU copy so static models using this mesh can be merged (see CStaticGeometry)
+		if (!mHasBones)
+		{
+			subMesh.tangentOffset = requireTangents ? static_cast<int>(tangentOffset) : -1;
+			subMesh.vertices.assign(vertices.get(), vertices.get() + subMesh.numVertices * subMesh.vertexSize);
+			const uint32_t* firstIndex = reinterpret_cast<const uint32_t*>(indices.get());
+			subMesh.indices.assign(firstIndex, firstIndex + subMesh.numIndices);
+		}
+
+	}
+
+	// Bounding boxes for culling. Each node's box surrounds its own sub-meshes, the mesh box surrounds every node.
+	// Rigid sub-meshes are drawn with the model's world matrix alone, the node matrices are not applied (see
+	// Render), so their boxes are merged as they are, the same as skinned sub-meshes which are already in mesh
+	// space (bind pose). The triangles below are kept in the same space, so culling, ray casts and occlusion see
+	// the geometry where it is drawn
+	mBounds = maths::EmptyAABB();
+	for (auto& node : mNodes)
+	{
+		for (auto& subMeshIndex : node.subMeshes)
+		{
+			node.bounds = maths::Merge(node.bounds, mSubMeshes[subMeshIndex].bounds);
+		}
+	}
+	for (auto& subMesh : mSubMeshes)
+	{
+		mBounds = maths::Merge(mBounds, subMesh.bounds);
+	}
+
+	// Triangle BVH for exact ray casts, in model space the same as the bounds. Not built for skinned meshes as
+	// their triangles move with the bones, ray casts against them use the bounds instead. The triangles are kept
+	// for models that are used as occluders
+	if (!mHasBones)
+	{
+		for (auto& node : mNodes)
+		{
+			for (auto& subMeshIndex : node.subMeshes)
+			{
+				aiMesh* assimpMesh = scene->mMeshes[subMeshIndex];
+				uint32_t firstVertex = static_cast<uint32_t>(mPositions.size());
+				const maths::CVector3* vertices = reinterpret_cast<const maths::CVector3*>(assimpMesh->mVertices);
+				mPositions.insert(mPositions.end(), vertices, vertices + assimpMesh->mNumVertices);
+				for (unsigned int face = 0; face < assimpMesh->mNumFaces; ++face)
+				{
+					mIndices.push_back(firstVertex + assimpMesh->mFaces[face].mIndices[0]);
+					mIndices.push_back(firstVertex + assimpMesh->mFaces[face].mIndices[1]);
+					mIndices.push_back(firstVertex + assimpMesh->mFaces[face].mIndices[2]);
+				}
+			}
+		}
+		mTriangleBVH = std::make_unique<maths::CTriangleBVH>(mPositions.data(), sizeof(maths::CVector3), mIndices.data(), mIndices.size());
+	}
+
+	// Bone offset matrices are all read now, keep them in one array for batch multiplication when rendering
+	if (mHasBones)
+	{
+		mOffsetMatrices.resize(mNodes.size());
+		for (unsigned int nodeIndex = 0; nodeIndex < mNodes.size(); ++nodeIndex)
+		{
+			mOffsetMatrices[nodeIndex] = mNodes[nodeIndex].offsetMatrix;
+		}
+
+		mBoneConstantBuffer = CreateConstantBuffer(sizeof(mBoneConstants), myEngine);
+		mBoneDualQuaternionConstantBuffer = CreateConstantBuffer(sizeof(mBoneDualQuaternionConstants), myEngine);
+		if (mBoneConstantBuffer == nullptr || mBoneDualQuaternionConstantBuffer == nullptr)
+		{
+			throw std::runtime_error("Failure creating bone constant buffers for " + fileName);
+		}
 	}
 
 
@@ -447,7 +544,10 @@ Mesh::~Mesh()
 		if (subMesh.indexBuffer)   subMesh.indexBuffer->Release();
 		if (subMesh.vertexBuffer)  subMesh.vertexBuffer->Release();
 		if (subMesh.vertexLayout)  subMesh.vertexLayout->Release();
+		if (subMesh.instancedVertexLayout)  subMesh.instancedVertexLayout->Release();
 	}
+	if (mBoneConstantBuffer)  mBoneConstantBuffer->Release();
+	if (mBoneDualQuaternionConstantBuffer)  mBoneDualQuaternionConstantBuffer->Release();
 	//if (diffuseMap.texture) diffuseMap.texture->Release();
 	//if (diffuseMap.textureSRV) diffuseMap.textureSRV->Release();
 }
@@ -460,6 +560,9 @@ std::unique_ptr<IModel> Mesh::CreateModel(const float x, const float y, const fl
 	newModel->SetPSShader(psShaderFile);
 	newModel->SetVSShader(vsShaderFile);
 
+	// Skinned meshes need a vertex shader that reads the bones. Keep any shader other than the default
+	if (mHasBones && vsShaderFile == "main_vs") newModel->SetSkinning(ESkinning::Matrices);
+
 	for (int i = 0; i < mTextures.size(); ++i)
 	{
 		if (i == 0)
@@ -494,69 +597,137 @@ void Mesh::RenderSubMesh(const SubMesh& subMesh)
 	if (subMesh.diffuseTexture != nullptr)
 	{
 		mSrvTexture = subMesh.diffuseTexture->GetTextureSRV();
-		myEngine->GetContext()->PSSetShaderResources(0, 1, &mSrvTexture); // First parameter must match texture slot number in the shader
+		myEngine->GetStateContext()->PSSetShaderResources(0, 1, &mSrvTexture); // First parameter must match texture slot number in the shader
 	}
 
 	// Set vertex buffer as next data source for GPU
 	UINT stride = subMesh.vertexSize;
 	UINT offset = 0;
 	
-	myEngine->GetContext()->IASetVertexBuffers(0, 1, &subMesh.vertexBuffer, &stride, &offset);
+	myEngine->GetStateContext()->IASetVertexBuffers(0, 1, &subMesh.vertexBuffer, &stride, &offset);
 
 	// Indicate the layout of vertex buffer
-	myEngine->GetContext()->IASetInputLayout(subMesh.vertexLayout);
+	myEngine->GetStateContext()->IASetInputLayout(subMesh.vertexLayout);
 
 	// Set index buffer as next data source for GPU, indicate it uses 32-bit integers
-	myEngine->GetContext()->IASetIndexBuffer(subMesh.indexBuffer, DXGI_FORMAT_R32_UINT, 0);
+	myEngine->GetStateContext()->IASetIndexBuffer(subMesh.indexBuffer, DXGI_FORMAT_R32_UINT, 0);
 
 	// Using triangle lists only in this class
-	myEngine->GetContext()->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	myEngine->GetStateContext()->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
 	// Render mesh
-	myEngine->GetContext()->DrawIndexed(subMesh.numIndices, 0, 0);
+	myEngine->GetStateContext()->DrawIndexed(subMesh.numIndices, 0, 0);
 }
 
-// The render function assumes shaders, matrices, textures, samplers etc. have been set up already.
-// It simply draws this mesh with whatever settings the GPU is currently using.
-void Mesh::Render(std::vector<maths::CMatrix4x4>& modelMatrices)
+// Instanced version of RenderSubMesh, draws numInstances copies of the sub-mesh with world matrices from the
+// instance buffer
+void Mesh::RenderSubMeshInstanced(const SubMesh& subMesh, CInstanceBuffer& instances, unsigned int numInstances, unsigned int firstInstance)
 {
-	// Skinning needs all matrices available in the shader at the same time, so first calculate all the absolute
-	// matrices before rendering anything
-	std::vector<maths::CMatrix4x4> absoluteMatrices(modelMatrices.size());
-	absoluteMatrices[0] = modelMatrices[0]; // First matrix for a model is the root matrix, already in world space
-	for (unsigned int nodeIndex = 1; nodeIndex < mNodes.size(); ++nodeIndex)
+	if (subMesh.diffuseTexture != nullptr)
 	{
-		// Multiply each model matrix by its parent's absolute world matrix (already calculated earlier in this loop)
-		// Same process as for rigid bodies, simply done prior to rendering now
-		absoluteMatrices[nodeIndex] = modelMatrices[nodeIndex] * absoluteMatrices[mNodes[nodeIndex].parentIndex];
+		mSrvTexture = subMesh.diffuseTexture->GetTextureSRV();
+		myEngine->GetStateContext()->PSSetShaderResources(0, 1, &mSrvTexture); // First parameter must match texture slot number in the shader
 	}
 
+	// Vertices from buffer 0 and world matrices from buffer 1
+	ID3D11Buffer* buffers[] = { subMesh.vertexBuffer, instances.GetBuffer() };
+	UINT strides[] = { subMesh.vertexSize, CInstanceBuffer::Stride() };
+	UINT offsets[] = { 0, 0 };
+	myEngine->GetStateContext()->IASetVertexBuffers(0, 2, buffers, strides, offsets);
+	myEngine->GetStateContext()->IASetInputLayout(subMesh.instancedVertexLayout);
+	myEngine->GetStateContext()->IASetIndexBuffer(subMesh.indexBuffer, DXGI_FORMAT_R32_UINT, 0);
+	myEngine->GetStateContext()->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+	myEngine->GetStateContext()->DrawIndexedInstanced(subMesh.numIndices, numInstances, 0, 0, firstInstance);
+}
+
+// CPU copy of a sub-mesh's geometry
+SSubMeshGeometry Mesh::GetSubMeshGeometry(unsigned int subMesh)
+{
+	const SubMesh& source = mSubMeshes[subMesh];
+	SSubMeshGeometry geometry;
+	geometry.vertices = source.vertices.empty() ? nullptr : source.vertices.data();
+	geometry.numVertices = source.vertices.empty() ? 0 : source.numVertices;
+	geometry.vertexSize = source.vertexSize;
+	geometry.tangentOffset = source.tangentOffset;
+	geometry.indices = source.indices.empty() ? nullptr : source.indices.data();
+	geometry.numIndices = source.indices.empty() ? 0 : source.numIndices;
+	geometry.vertexLayout = source.vertexLayout;
+	geometry.diffuseTexture = source.diffuseTexture != nullptr ? source.diffuseTexture->GetTextureSRV() : nullptr;
+	return geometry;
+}
+
+// Draw several models using this mesh with one instanced draw per sub-mesh
+unsigned int Mesh::RenderInstanced(IModel* const* models, unsigned int numModels, CInstanceBuffer& instances)
+{
+	if (mHasBones || numModels == 0)  return 0;
+
+	// Every sub-mesh of a model is drawn with the model's world matrix, as in Model::Render. Models that don't fit in
+	// the instance buffer at once are drawn in several groups
+	unsigned int numDrawCalls = 0;
+	for (unsigned int first = 0; first < numModels; first += instances.GetCapacity())
+	{
+		const unsigned int count = std::min(instances.GetCapacity(), numModels - first);
+		mInstanceMatrices.resize(count);
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			mInstanceMatrices[i] = models[first + i]->WorldMatrix();
+		}
+		unsigned int firstInstance = instances.Write(mInstanceMatrices.data(), count, myEngine->GetContext());
+
+		for (auto& subMesh : mSubMeshes)
+		{
+			RenderSubMeshInstanced(subMesh, instances, count, firstInstance);
+			++numDrawCalls;
+		}
+	}
+	return numDrawCalls;
+}
+
+// The render function assumes shaders, matrices, textures, samplers etc. have been set up already.
+// It simply draws this mesh with whatever settings the GPU is currently using.
+void Mesh::Render(std::vector<maths::CMatrix4x4>& modelMatrices, ESkinning skinning)
+{
 	if (mHasBones) // Render a mesh that uses skinning
 	{
+		// Skinning needs all matrices available in the shader at the same time, so first calculate all the absolute
+		// matrices before rendering anything
+		// Multiply each model matrix by its parent's absolute matrix. The bones end up in model space, the model's
+		// world matrix is applied by the shader after skinning
+		std::vector<maths::CMatrix4x4> absoluteMatrices(modelMatrices.size());
+		maths::ResolveMatrixChain(modelMatrices.data(), mNodeParents.data(), absoluteMatrices.data(), mNodes.size());
+
 		// Advanced point: the above loop will get the absolute world matrices **of the bones**. However, they are
 		// not actually rendered, they merely influence the skinned mesh, which has its origin at a particular node.
 		// So for each bone there is a fixed offset (transform) between where that bone is and where the root of the
 		// skinned mesh is. We need to apply that offset to each of the bone matrices calculated in the last loop to make
 		// the bone influences work on the skinned mesh.
 		// These offset matrices are fixed for the model and have been calculated when the mesh was imported
-		for (unsigned int nodeIndex = 0; nodeIndex < mNodes.size(); ++nodeIndex)
+		maths::MultiplyMatricesPairwise(mOffsetMatrices.data(), absoluteMatrices.data(), absoluteMatrices.data(), mNodes.size());
+
+		// Send the bones over to the GPU for skinning via a constant buffer - each one can influence nearby vertices
+		// Each palette has its own buffer, so only the one in use is uploaded
+		const size_t numBones = std::min(mNodes.size(), static_cast<size_t>(MAX_BONES));
+		ID3D11Buffer* boneConstantBuffer;
+		if (skinning == ESkinning::DualQuaternions)
 		{
-			absoluteMatrices[nodeIndex] = mNodes[nodeIndex].offsetMatrix * absoluteMatrices[nodeIndex];
+			// The same bones as the matrix palette. They are in model space (the model's world matrix, which may be
+			// scaled, is gWorldMatrix and is applied by the shader after skinning), so only scale within the node
+			// hierarchy itself is lost
+			maths::DualQuaternionsFromMatrices(absoluteMatrices.data(), mBoneDualQuaternionConstants.boneDualQuaternions, numBones);
+			UpdateConstantBuffer(mBoneDualQuaternionConstantBuffer, mBoneDualQuaternionConstants, myEngine->GetContext()); // Send to GPU
+			boneConstantBuffer = mBoneDualQuaternionConstantBuffer;
 		}
-
-		// Send all matrices over to the GPU for skinning via a constant buffer - each matrix can represent a bone which influences nearby vertices
-		// MISSING - code to fill the gPerModelConstants.boneMatrices array with the contents of the absoluteMatrices vector
-		for (unsigned int nodeIndex = 0; nodeIndex < mNodes.size(); ++nodeIndex)
+		else
 		{
-			myEngine->GetModelConstants().boneMatrices[nodeIndex] = absoluteMatrices[nodeIndex];
+			std::copy(absoluteMatrices.begin(), absoluteMatrices.begin() + numBones, mBoneConstants.boneMatrices);
+			UpdateConstantBuffer(mBoneConstantBuffer, mBoneConstants, myEngine->GetContext()); // Send to GPU
+			boneConstantBuffer = mBoneConstantBuffer;
 		}
-		UpdateConstantBuffer(myEngine->GetModelConstantBuffer(), myEngine->GetModelConstants(), myEngine->GetContext()); // Send to GPU
 
-		ID3D11Buffer* modelConstantBuffer = myEngine->GetModelConstantBuffer();
-		// Indicate that the constant buffer we just updated is for use in the vertex shader (VS), geometry shader (GS) and pixel shader (PS)
-		myEngine->GetContext()->VSSetConstantBuffers(1, 1, &modelConstantBuffer); // First parameter must match constant buffer number in the shader
-		myEngine->GetContext()->GSSetConstantBuffers(1, 1, &modelConstantBuffer); // First parameter must match constant buffer number in the shader
-		myEngine->GetContext()->PSSetConstantBuffers(1, 1, &modelConstantBuffer);
+		// Bone palettes are only needed by the vertex shader. Slot numbers must match the constant buffers in Common.hlsli
+		const UINT boneSlot = (skinning == ESkinning::DualQuaternions) ? 3 : 2;
+		myEngine->GetStateContext()->VSSetConstantBuffers(boneSlot, 1, &boneConstantBuffer);
 
 		// Already sent over all the absolute matrices for the entire mesh so we can render sub-meshes directly
 		// rather than iterating through the nodes. 
@@ -567,23 +738,12 @@ void Mesh::Render(std::vector<maths::CMatrix4x4>& modelMatrices)
 	}
 	else
 	{
-		// Render a mesh without skinning. Although slightly reorganised to use the matrices calculated
-		// above, this is basically the same code as the rigid body animation lab
-		// Iterate through each node
-		for (unsigned int nodeIndex = 0; nodeIndex < mNodes.size(); ++nodeIndex)
+		// Render a mesh without skinning. Every sub-mesh is drawn with the model's world matrix, which the model has
+		// already sent to the GPU - the node matrices are not applied, so a node's sub-meshes are drawn in model
+		// space. The mesh bounds, triangle BVH and static geometry merging all use the same space
+		for (auto& node : mNodes)
 		{
-			// Send this node's matrix to the GPU via a constant buffer
-			myEngine->GetModelConstants().worldMatrix = absoluteMatrices[nodeIndex];
-			UpdateConstantBuffer(myEngine->GetModelConstantBuffer(), myEngine->GetModelConstants(), myEngine->GetContext()); // Send to GPU
-
-			ID3D11Buffer* modelConstantBuffer = myEngine->GetModelConstantBuffer();
-			// Indicate that the constant buffer we just updated is for use in the vertex shader (VS), geometry shader (GS) and pixel shader (PS)
-			myEngine->GetContext()->VSSetConstantBuffers(1, 1, &modelConstantBuffer); // First parameter must match constant buffer number in the shader
-			myEngine->GetContext()->GSSetConstantBuffers(1, 1, &modelConstantBuffer); // First parameter must match constant buffer number in the shader
-			myEngine->GetContext()->PSSetConstantBuffers(1, 1, &modelConstantBuffer);
-
-			// Render the sub-meshes attached to this node (no bones - rigid movement)
-			for (auto& subMeshIndex : mNodes[nodeIndex].subMeshes)
+			for (auto& subMeshIndex : node.subMeshes)
 			{
 				RenderSubMesh(mSubMeshes[subMeshIndex]);
 			}
@@ -8,6 +8,8 @@
 #define NOMINMAX // Use this to stop Windows headers defining "min" and "max", which breaks some libraries (e.g. assimp)
 #include "IMesh.hpp"
 #include "CMatrix4x4.hpp"
+#include "Geometry.hpp"
+#include "CTriangleBVH.hpp"
 #include <assimp/scene.h>
 
 //======================================================================================
@@ -48,8 +50,17 @@ public:
 		const std::string& psShaderFile = "main_ps", const std::string vsShaderFile = "main_vs");
 
 	// The render function assumes shaders, matrices, textures, samplers etc. have been set up already.
-	// It simply draws this mesh with whatever settings the GPU is currently using.
-	void Render(std::vector<maths::CMatrix4x4>& modelMatrices);
+	// It simply draws this mesh with whatever settings the GPU is currently using. See IMesh
+	void Render(std::vector<maths::CMatrix4x4>& modelMatrices, ESkinning skinning);
+
+	// Draw several models using this mesh with one instanced draw per sub-mesh. See IMesh
+	unsigned int RenderInstanced(IModel* const* models, unsigned int numModels, CInstanceBuffer& instances);
+	bool CanInstance() { return !mHasBones; }
+	bool HasBones() { return mHasBones; }
+
+	// CPU copies of the sub-meshes, for merging static models. See IMesh
+	unsigned int NumberSubMeshes() { return static_cast<unsigned int>(mSubMeshes.size()); }
+	SSubMeshGeometry GetSubMeshGeometry(unsigned int subMesh);
 
 	// How many nodes are in the hierarchy for this mesh. Nodes can control individual parts (rigid body animation),
 	// or bones (skinned animation), or they can be dummy nodes to create child parts in a more convenient way
@@ -58,6 +69,22 @@ public:
 	// The default matrix for a given node - used to set the initial position for a new model
 	maths::CMatrix4x4 GetNodeDefaultMatrix(unsigned int node) { return mNodes[node].defaultMatrix; }
 
+	// Bounding box around the whole mesh in its default pose, in model space. For skinned meshes this is the bind
+	// pose, animation that moves vertices outside it will not be accounted for
+	const maths::CAABB& GetBounds() { return mBounds; }
+
+	// Bounding box around the sub-meshes of a given node, in model space like GetBounds (node matrices are not
+	// applied to the sub-meshes when drawn, see Mesh::Render). Empty if the node has no geometry
+	const maths::CAABB& GetNodeBounds(unsigned int node) { return mNodes[node].bounds; }
+
+	// Triangles of the mesh in its default pose for exact ray casts, in model space. nullptr for skinned meshes
+	const maths::CTriangleBVH* GetTriangleBVH() { return mTriangleBVH.get(); }
+
+	// CPU copy of the triangles in the default pose as an indexed triangle list in model space, used for occlusion
+	// culling. Empty for skinned meshes
+	const std::vector<maths::CVector3>& GetPositions() { return mPositions; }
+	const std::vector<uint32_t>& GetIndices() { return mIndices; }
+
 private:
 //---------------------------------------
 // Private Types
@@ -68,6 +95,8 @@ private:
 	{
 		unsigned int       vertexSize = 0;         // Size in bytes of a single vertex (depends on what it contains, uvs, tangents etc.)
 		ID3D11InputLayout* vertexLayout = nullptr; // DirectX specification of data held in a single vertex
+		ID3D11InputLayout* instancedVertexLayout = nullptr; // The same plus a world matrix per instance from a second
+		                                                    // buffer, for RenderInstanced. Not created for skinned meshes
 
 		// GPU-side vertex and index buffers
 		unsigned int       numVertices = 0;
@@ -77,7 +106,12 @@ private:
 		ID3D11Buffer*      indexBuffer = nullptr;
 
 		std::unique_ptr<ITexture> diffuseTexture = nullptr;
-			   
+		// CPU copies of the buffers above for GetSubMeshGeometry, not kept for skinned meshes
+		int                   tangentOffset = -1;
+		std::vector<uint8_t>  vertices;
+		std::vector<uint32_t> indices;
+
+		maths::CAABB       bounds = maths::EmptyAABB(); // Box around the vertex positions, calculated at load time
 	};
 
 
@@ -97,6 +131,8 @@ private:
 
 		std::vector<unsigned int> childNodes; // Child nodes that are controlled by this node (indexes into the mNodes vector below)
 		std::vector<unsigned int> subMeshes;  // The geometry representing this node (indexes into the mSubMeshes vector below)
+
+		maths::CAABB bounds = maths::EmptyAABB(); // Box around all the sub-meshes above, in model space
 	};
 
 //---------------------------------------
@@ -110,6 +146,8 @@ private:
 
 	// Helper function for Render function - renders a given sub-mesh. World matrices / textures / states etc. must already be set
 	void RenderSubMesh(const SubMesh& subMesh);
+	// Instanced version of the above, world matrices come from the instance buffer starting at firstInstance
+	void RenderSubMeshInstanced(const SubMesh& subMesh, CInstanceBuffer& instances, unsigned int numInstances, unsigned int firstInstance);
 
 //---------------------------------------
 // Private Member Variables
@@ -133,8 +171,24 @@ private:
 	std::vector<SubMesh> mSubMeshes; // The mesh geometry. Nodes refer to sub-meshes in this vector
 	std::vector<Node>    mNodes;     // The mesh hierarchy. First entry is root. remainder aree stored in depth-first order
 
+	// Copies of the node parent indexes and bone offset matrices in contiguous arrays for the batch matrix functions
+	std::vector<unsigned int>      mNodeParents;
+	std::vector<maths::CMatrix4x4> mOffsetMatrices; // Only filled in if the mesh has bones
+
+	maths::CAABB mBounds; // Box around the whole mesh in its default pose, used for culling models
+	std::unique_ptr<maths::CTriangleBVH> mTriangleBVH; // Only built for meshes without bones
+	std::vector<maths::CVector3> mPositions; // Triangles the BVH was built from, kept for occlusion culling
+	std::vector<uint32_t>        mIndices;
+	std::vector<maths::CMatrix4x4> mInstanceMatrices; // Working memory for RenderInstanced, kept to save allocations
+
 	bool mHasBones; // If any submesh has bones, then all submeshes are given bones - makes rendering easier (one shader for the whole mesh)
 
+	// Bone palettes and their GPU constant buffers, only created if the mesh has bones
+	PerBoneConstants               mBoneConstants;
+	PerBoneDualQuaternionConstants mBoneDualQuaternionConstants;
+	ID3D11Buffer*                  mBoneConstantBuffer = nullptr;
+	ID3D11Buffer*                  mBoneDualQuaternionConstantBuffer = nullptr;
+
 };//Class
 }//Namespace
 //======================================================================================
@@ -12,14 +12,21 @@
 
 #include "DirectX11Engine.hpp"
 
+#include <algorithm>
+
 namespace umbra_engine
 {
 
 std::vector<IModel*> Model::objectList;
 std::vector<std::string> Model::mMediaFolders;
+maths::CSpatialQuery Model::spatialIndex;
+std::vector<Model*> Model::movedObjects;
+std::vector<void*> Model::queryResults;
+unsigned int Model::numCreated = 0;
+unsigned int Model::numRevisions = 0;
 
 Model::Model(IMesh* mesh, IEngine * engine = nullptr, maths::CVector3 position /*= { 0,0,0 }*/, maths::CVector3 rotation /*= { 0,0,0 }*/, float scale /*= 1*/)
-	: mMesh(mesh), mPosition(position), mRotation(rotation), mScale({ scale, scale, scale })
+	: mMesh(mesh), mTransform(position, maths::QuaternionFromEulerFast(rotation), { scale, scale, scale })
 {
 	addBlending = false;
 	blend = None;
@@ -34,6 +41,9 @@ Model::Model(IMesh* mesh, IEngine * engine = nullptr, maths::CVector3 position /
 		mWorldMatrices[i] = mesh->GetNodeDefaultMatrix(i);
 	}
 
+	mCreationIndex = numCreated++;
+	mRevision = ++numRevisions;
+	mSpatialProxy = spatialIndex.Insert(WorldBounds(), mMesh->GetTriangleBVH(), WorldMatrix(), static_cast<IModel*>(this));
 }
 
 std::vector<IModel*> Model::GetAllObjects()
@@ -41,6 +51,72 @@ std::vector<IModel*> Model::GetAllObjects()
 	return objectList;
 }
 
+// Fill visible with the models whose bounds intersect the frustum, in the order the spatial index finds them
+void Model::GetVisibleObjects(const maths::CFrustum& frustum, std::vector<IModel*>& visible)
+{
+	UpdateSpatialIndex();
+	spatialIndex.Query(frustum, queryResults);
+
+	visible.clear();
+	for (auto object : queryResults)
+	{
+		visible.push_back(static_cast<IModel*>(object));
+	}
+}
+
+// Put models in the order they were created, the same order as GetAllObjects
+void Model::SortInCreationOrder(std::vector<IModel*>& models)
+{
+	std::sort(models.begin(), models.end(), [](IModel* a, IModel* b)
+	{
+		return static_cast<Model*>(a)->mCreationIndex < static_cast<Model*>(b)->mCreationIndex;
+	});
+}
+
+// Draw shadow casters with the depth-only shaders already set
+void Model::RenderShadowCasters(const std::vector<IModel*>& casters, CStateContext* context)
+{
+	for (auto model : casters)
+	{
+		if (!model->GetMesh()->HasBones()) model->RenderGeometry();
+	}
+	for (auto model : casters)
+	{
+		if (!model->GetMesh()->HasBones()) continue;
+		context->VSSetShader(model->GetVSShader(), nullptr, 0);
+		model->RenderGeometry();
+	}
+}
+
+// Refit the spatial index for every model that has moved, rotated or scaled since the last update
+void Model::UpdateSpatialIndex()
+{
+	for (auto model : movedObjects)
+	{
+		spatialIndex.Update(model->mSpatialProxy, model->WorldBounds(), model->WorldMatrix());
+		model->mMoved = false;
+	}
+	movedObjects.clear();
+}
+
+// Ray casts, sphere overlaps and nearest model queries over all models
+const maths::CSpatialQuery& Model::SpatialQuery()
+{
+	UpdateSpatialIndex();
+	return spatialIndex;
+}
+
+// Take the model out of the spatial index and the queue of moved models
+void Model::RemoveFromSpatialIndex()
+{
+	spatialIndex.Remove(mSpatialProxy);
+	if (mMoved)
+	{
+		movedObjects.erase(std::find(movedObjects.begin(), movedObjects.end(), this));
+	}
+}
+
+// Turn the model so its Z axis faces the target. The axes are turned into a rotation, so scale is kept
 void Model::LookAt(IModel* target)
 {
 	maths::CVector3 yAxis = { 0.0f, 1.0f, 0.0f };
@@ -48,16 +124,8 @@ void Model::LookAt(IModel* target)
 	maths::CVector3 vecX = Normalise(Cross(yAxis, vecZ));
 	maths::CVector3 vecY = Normalise(Cross(vecZ, vecX));
 
-	maths::CMatrix4x4 newMatrix;
-	newMatrix.MakeIdentity();
-
-	newMatrix.SetRow(0, vecX);
-	newMatrix.SetRow(1, vecY);
-	newMatrix.SetRow(2, vecZ);
-	newMatrix.SetRow(3, Position());
-
-	mWorldMatrix = newMatrix;
-	lookingAt = true;
+	mTransform.rotation = maths::Normalise(maths::QuaternionFromAxes(vecX, vecY, vecZ));
+	MarkMoved();
 }
 
 void Model::LookAtCamera(ICamera * target)
@@ -67,16 +135,8 @@ void Model::LookAtCamera(ICamera * target)
 	maths::CVector3 vecX = Normalise(Cross(yAxis, vecZ));
 	maths::CVector3 vecY = Normalise(Cross(vecZ, vecX));
 
-	maths::CMatrix4x4 newMatrix;
-	newMatrix.MakeIdentity();
-
-	newMatrix.SetRow(0, vecX);
-	newMatrix.SetRow(1, vecY);
-	newMatrix.SetRow(2, vecZ);
-	newMatrix.SetRow(3, Position());
-
-	mWorldMatrix = newMatrix;
-	lookingAt = true;
+	mTransform.rotation = maths::Normalise(maths::QuaternionFromAxes(vecX, vecY, vecZ));
+	MarkMoved();
 }
 
 void Model::SetTextureFile(const std::string& file)
@@ -102,31 +162,29 @@ std::string Model::GetTextureFile()
 void Model::Render()
 {
 	//Set the correct vs and ps for each model
-	myEngine->GetContext()->PSSetShader(associatedPSShader, nullptr, 0);
-	myEngine->GetContext()->VSSetShader(associatedVSShader, nullptr, 0);
+	myEngine->GetStateContext()->PSSetShader(associatedPSShader, nullptr, 0);
+	myEngine->GetStateContext()->VSSetShader(associatedVSShader, nullptr, 0);
 
 	// Select the approriate textures and sampler to use in the pixel shader
 	//myEngine->GetContext()->PSSetShaderResources(0, 1, &diffuseSpecularMapSRV); // First parameter must match texture slot number in the shader
-	myEngine->GetContext()->PSSetShaderResources(1, 1, &diffuseSpecularMap2SRV);
-	myEngine->GetContext()->PSSetShaderResources(3, 1, &diffuseSpecularMap3SRV);
+	myEngine->GetStateContext()->PSSetShaderResources(1, 1, &diffuseSpecularMap2SRV);
+	myEngine->GetStateContext()->PSSetShaderResources(3, 1, &diffuseSpecularMap3SRV);
 
 	myScene = myEngine->GetScene();
 	ID3D11SamplerState* mAnisotropic4xSampler = myScene->GetAnisotropic4xSampler();
 
-	myEngine->GetContext()->PSSetSamplers(0, 1, &mAnisotropic4xSampler);
+	myEngine->GetStateContext()->PSSetSamplers(0, 1, &mAnisotropic4xSampler);
 
+	RenderGeometry();
+}
 
+// Set the world matrix and draw the mesh with the current shaders, textures and samplers
+void Model::RenderGeometry()
+{
 	mPerModelConstants = myEngine->GetModelConstants();
 
 
-	if (!lookingAt)
-	{
-		UpdateWorldMatrix();
-	}
-	else
-	{
-		UpdateScale();
-	}
+	UpdateWorldMatrix();
 
 
 
@@ -137,12 +195,12 @@ void Model::Render()
 	mPerModelConstantBuffer = myEngine->GetModelConstantBuffer();
 	
 	// Indicate that the constant buffer we just updated is for use in the vertex shader (VS) and pixel shader (PS)
-	myEngine->GetContext()->VSSetConstantBuffers(1, 1, &mPerModelConstantBuffer); // First parameter must match constant buffer number in the shader
-	myEngine->GetContext()->PSSetConstantBuffers(1, 1, &mPerModelConstantBuffer);
+	myEngine->GetStateContext()->VSSetConstantBuffers(1, 1, &mPerModelConstantBuffer); // First parameter must match constant buffer number in the shader
+	myEngine->GetStateContext()->PSSetConstantBuffers(1, 1, &mPerModelConstantBuffer);
 
 
 
-	mMesh->Render(mWorldMatrices);
+	mMesh->Render(mWorldMatrices, mSkinning);
 
 }
 
@@ -217,106 +275,111 @@ void Model::Control(float frameTime, KeyCode turnUp, KeyCode turnDown, KeyCode t
 
 	if (KeyHeld(turnDown))
 	{
-		mRotation.x += ROTATION_SPEED * frameTime;
+		RotateX(frameTime);
 	}
 	if (KeyHeld(turnUp))
 	{
-		mRotation.x -= ROTATION_SPEED * frameTime;
+		RotateX(-frameTime);
 	}
 	if (KeyHeld(turnRight))
 	{
-		mRotation.y += ROTATION_SPEED * frameTime;
+		RotateY(frameTime);
 	}
 	if (KeyHeld(turnLeft))
 	{
-		mRotation.y -= ROTATION_SPEED * frameTime;
+		RotateY(-frameTime);
 	}
 	if (KeyHeld(turnCW))
 	{
-		mRotation.z += ROTATION_SPEED * frameTime;
+		RotateZ(-frameTime);
 	}
 	if (KeyHeld(turnCCW))
 	{
-		mRotation.z -= ROTATION_SPEED * frameTime;
+		RotateZ(frameTime);
 	}
 
 	// Local Z movement - move in the direction of the Z axis, get axis from world matrix
 	if (KeyHeld(moveForward))
 	{
-		mPosition.x += mWorldMatrix.e20 * MOVEMENT_SPEED * frameTime;
-		mPosition.y += mWorldMatrix.e21 * MOVEMENT_SPEED * frameTime;
-		mPosition.z += mWorldMatrix.e22 * MOVEMENT_SPEED * frameTime;
+		MoveLocalZ(MOVEMENT_SPEED * frameTime);
 	}
 	if (KeyHeld(moveBackward))
 	{
-		mPosition.x -= mWorldMatrix.e20 * MOVEMENT_SPEED * frameTime;
-		mPosition.y -= mWorldMatrix.e21 * MOVEMENT_SPEED * frameTime;
-		mPosition.z -= mWorldMatrix.e22 * MOVEMENT_SPEED * frameTime;
+		MoveLocalZ(-MOVEMENT_SPEED * frameTime);
 	}
 }
 
 void Model::MoveLocalX(float speed)
 {
-	if (!lookingAt)
-	{
-		UpdateWorldMatrix();
-	}
-	mPosition.x += mWorldMatrix.e00 * speed;
-	mPosition.y += mWorldMatrix.e01 * speed;
-	mPosition.z += mWorldMatrix.e02 * speed;
+	UpdateWorldMatrix();
+	mTransform.position.x += mWorldMatrix.e00 * speed;
+	mTransform.position.y += mWorldMatrix.e01 * speed;
+	mTransform.position.z += mWorldMatrix.e02 * speed;
+	MarkMoved();
 }
 void Model::MoveLocalY(float speed)
 {
-	if (!lookingAt)
-	{
-		UpdateWorldMatrix();
-	}
-	mPosition.x += mWorldMatrix.e10 * speed;
-	mPosition.y += mWorldMatrix.e11 * speed;
-	mPosition.z += mWorldMatrix.e12 * speed;
+	UpdateWorldMatrix();
+	mTransform.position.x += mWorldMatrix.e10 * speed;
+	mTransform.position.y += mWorldMatrix.e11 * speed;
+	mTransform.position.z += mWorldMatrix.e12 * speed;
+	MarkMoved();
 }
 void Model::MoveLocalZ(float speed)
 {
-	if (!lookingAt)
-	{
-		UpdateWorldMatrix();
-	}
-	mPosition.x += mWorldMatrix.e20 * speed;
-	mPosition.y += mWorldMatrix.e21 * speed;
-	mPosition.z += mWorldMatrix.e22 * speed;
+	UpdateWorldMatrix();
+	mTransform.position.x += mWorldMatrix.e20 * speed;
+	mTransform.position.y += mWorldMatrix.e21 * speed;
+	mTransform.position.z += mWorldMatrix.e22 * speed;
+	MarkMoved();
 }
 
 void Model::MoveX(float speed)
 {
-	mPosition.x += speed;
+	mTransform.position.x += speed;
+	MarkMoved();
 }
 void Model::MoveY(float speed)
 {
-	mPosition.y += speed;
+	mTransform.position.y += speed;
+	MarkMoved();
 }
 void Model::MoveZ(float speed)
 {
-	mPosition.z += speed;
+	mTransform.position.z += speed;
+	MarkMoved();
 }
 void Model::Move(float x, float y, float z)
 {
-	mPosition.x += x;
-	mPosition.y += y;
-	mPosition.z += z;
+	mTransform.position.x += x;
+	mTransform.position.y += y;
+	mTransform.position.z += z;
+	MarkMoved();
 }
 
 
+// Rotations are applied to the quaternion directly, so no Euler angles to rebuild and no gimbal lock
+// X and Z turn around the model's own axes, Y turns around the world Y axis (i.e. models stay upright when turning)
 void Model::RotateX(float angle)
 {
-	mRotation.x += ROTATION_SPEED * angle;
+	mTransform.RotateLocal(maths::QuaternionRotationX(ROTATION_SPEED * angle));
+	MarkMoved();
 }
 void Model::RotateY(float angle)
 {
-	mRotation.y += ROTATION_SPEED * angle;
+	mTransform.RotateWorld(maths::QuaternionRotationY(ROTATION_SPEED * angle));
+	MarkMoved();
 }
 void Model::RotateZ(float angle)
 {
-	mRotation.z -= ROTATION_SPEED * angle;
+	mTransform.RotateLocal(maths::QuaternionRotationZ(-ROTATION_SPEED * angle));
+	MarkMoved();
+}
+
+// World space bounding box around the model, the mesh bounds transformed by the world matrix
+maths::CAABB Model::WorldBounds()
+{
+	return maths::Transform(mMesh->GetBounds(), WorldMatrix());
 }
 
 maths::CMatrix4x4 Model::GetMatrix()
@@ -328,89 +391,67 @@ maths::CMatrix4x4 Model::GetMatrix()
 void Model::SetMatrix(maths::CMatrix4x4 model)
 {
 	//Need to set pos, rot and scale in order to acutally change the models position relative to another
-	UpdateWorldMatrix();
-
-	// Calculate matrix scaling
-	float scaleX = sqrt(model.e00*model.e00 + model.e01*model.e01 + model.e02*model.e02);
-	float scaleY = sqrt(model.e10*model.e10 + model.e11*model.e11 + model.e12*model.e12);
-	float scaleZ = sqrt(model.e20*model.e20 + model.e21*model.e21 + model.e22*model.e22);
-
-	// Calculate inverse scaling to extract rotational values only
-	float invScaleX = 1.0f / scaleX;
-	float invScaleY = 1.0f / scaleY;
-	float invScaleZ = 1.0f / scaleZ;
-
-	float sX, cX, sY, cY, sZ, cZ;
-
-	sX = -model.e21 * invScaleZ;
-	cX = sqrt(1.0f - sX * sX);
-
-	// If no gimbal lock...
-	if (abs(cX) > 0.001f)
-	{
-		float invCX = 1.0f / cX;
-		sZ = model.e01 * invCX * invScaleX;
-		cZ = model.e11 * invCX * invScaleY;
-		sY = model.e20 * invCX * invScaleZ;
-		cY = model.e22 * invCX * invScaleZ;
-	}
-	else
-	{
-		// Gimbal lock - force Z angle to 0
-		sZ = 0.0f;
-		cZ = 1.0f;
-		sY = -model.e02 * invScaleX;
-		cY = model.e00 * invScaleX;
-	}
-
-	mRotation = { atan2(sX, cX), atan2(sY, cY), atan2(sZ, cZ) };
-	mPosition = { model.e30, model.e31, model.e32 };
-	mScale = { scaleX, scaleY, scaleZ };
+	mTransform = maths::TransformFromMatrix(model);
+	MarkMoved();
 }
 
+// Rebuild the world matrix from position, rotation and scale, only if any of them have changed
 void Model::UpdateWorldMatrix()
 {
-	mWorldMatrix = maths::MatrixScaling(mScale) * maths::MatrixRotationZ(mRotation.z) * maths::MatrixRotationX(mRotation.x) * maths::MatrixRotationY(mRotation.y) * maths::MatrixTranslation(mPosition);
-}
+	if (!mWorldMatrixDirty) return;
 
-void Model::UpdateScale()
-{
-	mWorldMatrix = maths::MatrixScaling(mScale) * maths::MatrixTranslation(mPosition);
+	mWorldMatrix = mTransform.ToMatrix();
+	mWorldMatrixDirty = false;
 }
 
 void Model::SetX(float pos)
 {
-	mPosition.x = pos;
+	mTransform.position.x = pos;
+	MarkMoved();
 }
 void Model::SetY(float pos)
 {
-	mPosition.y = pos;
+	mTransform.position.y = pos;
+	MarkMoved();
 }
 void Model::SetZ(float pos)
 {
-	mPosition.z = pos;
+	mTransform.position.z = pos;
+	MarkMoved();
 }
 
 float Model::GetX()
 {
-	return mWorldMatrix.e30;
+	return mTransform.position.x;
 }
 float Model::GetY()
 {
-	return mWorldMatrix.e31;
+	return mTransform.position.y;
 }
 float Model::GetZ()
 {
-	return mWorldMatrix.e32;
+	return mTransform.position.z;
 }
 
 void Model::SetPSShader(const std::string& shaderFile)
 {
-	associatedPSShader = LoadPixelShader(shaderFile, myEngine);
+	if (associatedPSShader) associatedPSShader->Release();
+	associatedPSShader = LoadSharedPixelShader(shaderFile, myEngine);
 }
 void Model::SetVSShader(const std::string& shaderFile)
 {
-	associatedVSShader = LoadVertexShader(shaderFile, myEngine);
+	if (associatedVSShader) associatedVSShader->Release();
+	associatedVSShader = LoadSharedVertexShader(shaderFile, myEngine);
+}
+
+// Choose how bones are sent to the GPU. For a skinned mesh this also sets the matching vertex shader
+void Model::SetSkinning(ESkinning skinning)
+{
+	mSkinning = skinning;
+	if (mMesh->HasBones())
+	{
+		SetVSShader(skinning == ESkinning::DualQuaternions ? "DualQuaternionSkinning_vs" : "Skinning_vs");
+	}
 }
 
 ID3D11PixelShader* Model::GetPSShader()
@@ -9,6 +9,8 @@
 //--------------------------------------------------------------------------------------
 
 #include "IModel.hpp"
+#include "CTransform.hpp"
+#include "CSpatialQuery.hpp"
 
 //======================================================================================
 namespace umbra_engine
@@ -20,6 +22,7 @@ class IMesh;
 class IEngine;
 class IScene;
 class ITexture;
+class CStateContext;
 
 class Model : public IModel
 {
@@ -36,18 +39,23 @@ public:
 		if (textureShader) textureShader->Release();
 		if (associatedPSShader) associatedPSShader->Release();
 		if (associatedVSShader) associatedVSShader->Release();
+		RemoveFromSpatialIndex();
 	}
 
 //---------------------------------------
 // Data Access
 //---------------------------------------
 	// Getters
-	maths::CVector3 Position() { return mPosition; }
-	maths::CVector3 Rotation() { return mRotation; }
-	maths::CVector3 Scale() { return mScale; }
+	maths::CVector3 Position() { return mTransform.position; }
+	maths::CVector3 Rotation() { return maths::EulerAngles(mTransform.rotation); }
+	maths::CVector3 Scale() { return mTransform.scale; }
 	maths::CMatrix4x4 GetMatrix();
 	// Read only access to model world matrix, updated on request
 	maths::CMatrix4x4 WorldMatrix() { UpdateWorldMatrix();  return mWorldMatrix; }
+	// World space bounding box around the model, the mesh bounds transformed by the world matrix
+	maths::CAABB WorldBounds();
+	// Changes whenever the model moves, rotates or scales, unique across all models
+	unsigned int GetRevision() { return mRevision; }
 	float GetX();
 	float GetY();
 	float GetZ();
@@ -63,16 +71,38 @@ public:
 	std::string GetTextureFile3();
 	ID3D11ShaderResourceView* GetDiffuseSRVMap3();
 	EBlendingType GetAddBlend() { return blend; }
+	IMesh* GetMesh() { return mMesh; }
+	// Occluders are large models (e.g. buildings) drawn into the CPU depth buffer to hide the models behind them
+	bool IsOccluder() { return mOccluder; }
+	// Static models never move, so their geometry is merged with other static models' (see CStaticGeometry)
+	bool IsStatic() { return mStatic; }
+	ESkinning GetSkinning() { return mSkinning; }
 	//HOLD ALL OBJECTS IN THIS CLASS
 	static std::vector<IModel*> GetAllObjects();
+	// Fill visible with the models whose bounds intersect the frustum. Uses the spatial index, so the cost depends
+	// on the number of visible models rather than the total. The order depends on the shape of the index, which
+	// changes as models move, so use SortInCreationOrder where the order matters
+	static void GetVisibleObjects(const maths::CFrustum& frustum, std::vector<IModel*>& visible);
+	// Put models (all of this class) in the order they were created, the same order as GetAllObjects
+	static void SortInCreationOrder(std::vector<IModel*>& models);
+	// Refit the spatial index for every model that has moved, rotated or scaled since the last update. Called
+	// automatically by GetVisibleObjects and SpatialQuery
+	static void UpdateSpatialIndex();
+	// Ray casts, sphere overlaps and nearest model queries over all models. Results are IModel pointers stored as
+	// void*. Ray casts hit the triangles of models whose mesh has a triangle BVH, otherwise their bounds
+	static const maths::CSpatialQuery& SpatialQuery();
+	// Draw shadow casters with the depth-only shaders already set, using RenderGeometry so the models' own shaders
+	// and textures aren't bound. Skinned models are drawn last with their skinning vertex shader so their shadows
+	// follow their pose, which leaves that shader set
+	static void RenderShadowCasters(const std::vector<IModel*>& casters, CStateContext* context);
 
 	//Setters
 	void SetMatrix(maths::CMatrix4x4 model);
-	void SetPosition(maths::CVector3 position) { mPosition = position; }
-	void SetRotation(maths::CVector3 rotation) { mRotation = rotation; }
+	void SetPosition(maths::CVector3 position) { mTransform.position = position; MarkMoved(); }
+	void SetRotation(maths::CVector3 rotation) { mTransform.rotation = maths::QuaternionFromEulerFast(rotation); MarkMoved(); }
 	// Two ways to set scale: x,y,z separately, or all to the same value
-	void SetScale(maths::CVector3 scale) { mScale = scale; }
-	void SetScale(float scale) { mScale = { scale, scale, scale }; }
+	void SetScale(maths::CVector3 scale) { mTransform.scale = scale; MarkMoved(); }
+	void SetScale(float scale) { mTransform.scale = { scale, scale, scale }; MarkMoved(); }
 	void SetX(float pos);
 	void SetY(float pos);
 	void SetZ(float pos);
@@ -91,6 +121,11 @@ public:
 	void SetAddBlend(const EBlendingType& newBlend) { blend = newBlend; }
 	void AddSecondaryTexture(const std::string& texture2);
 	void AddThirdTexture(const std::string& texture3);
+	void SetOccluder(bool occluder) { mOccluder = occluder; }
+	void SetStatic(bool isStatic) { mStatic = isStatic; }
+	// Choose how bones are sent to the GPU. For a skinned mesh this also sets the matching vertex shader,
+	// Skinning_vs or DualQuaternionSkinning_vs
+	void SetSkinning(ESkinning skinning);
 
 //---------------------------------------
 // Operational Methods
@@ -99,6 +134,9 @@ public:
 	// to vertex & pixel shader. Then it calls Mesh:Render, which renders the geometry with current GPU settings.
 	// So all other per-frame constants must have been set already along with shaders, textures, samplers, states etc.
 	void Render();
+	// Just the last part of Render: set the world matrix and draw the mesh, with whatever shaders, textures and
+	// samplers are already set. For renderers that set those once for many models (see CScene's render queue)
+	void RenderGeometry();
 	// Control the model's position and rotation using keys provided. Amount of motion performed depends on frame time
 	void Control(float frameTime, KeyCode turnUp, KeyCode turnDown, KeyCode turnLeft, KeyCode turnRight,
 		KeyCode turnCW, KeyCode turnCCW, KeyCode moveForward, KeyCode moveBackward);
@@ -141,16 +179,41 @@ private:
 	ID3D11DepthStencilView* depthStencil = nullptr;
 	ID3D11ShaderResourceView* textureShader = nullptr;
 	void UpdateWorldMatrix();
-	void UpdateScale();
-	bool lookingAt = false;
+	void RemoveFromSpatialIndex();
 	IMesh* mMesh = nullptr;
 	static std::vector<std::string> mMediaFolders;
 	// Position, rotation and scaling for the model
-	maths::CVector3 mPosition;
-	maths::CVector3 mRotation;
-	maths::CVector3 mScale;
-	// World matrix for the model - built from the above
+	maths::CTransform mTransform;
+	// World matrix for the model - built from the above, only when it has changed
 	maths::CMatrix4x4 mWorldMatrix;
+	bool mWorldMatrixDirty = true;
+	bool mOccluder = false;
+	bool mStatic = false;
+	ESkinning mSkinning = ESkinning::Matrices;
+
+	// Flag the world matrix for rebuilding and queue the model to have its bounds updated in the spatial index
+	void MarkMoved()
+	{
+		mWorldMatrixDirty = true;
+		mRevision = ++numRevisions;
+		if (!mMoved)
+		{
+			mMoved = true;
+			movedObjects.push_back(this);
+		}
+	}
+
+	// All models are held in a spatial index (a bounding volume hierarchy) for culling and queries. Models that
+	// have moved since the last update are queued up and refitted in one go before the next query
+	static maths::CSpatialQuery spatialIndex;
+	static std::vector<Model*>  movedObjects;
+	static std::vector<void*>   queryResults; // Reused between queries to save allocations
+	static unsigned int        numCreated;
+	static unsigned int        numRevisions;
+	int          mSpatialProxy;
+	bool         mMoved = false;
+	unsigned int mCreationIndex; // Position in the order models were created, see SortInCreationOrder
+	unsigned int mRevision;
 
 	PerModelConstants mPerModelConstants;
 	ID3D11Buffer* mPerModelConstantBuffer;
@@ -4,6 +4,9 @@
 #include "Scene.hpp"
 #include "ICamera.hpp"
 #include "Model.hpp"
+#include "MathTables.hpp"
+
+#include <algorithm>
 
 namespace umbra_engine
 {
@@ -45,6 +48,10 @@ CPointLight::~CPointLight()
 	if (mCubeShadow) mCubeShadow->Release();
 	if (mShadowDepthStencil) mShadowDepthStencil->Release();
 	if (mShadowSRV) mShadowSRV->Release();
+	for (auto faceDepthStencil : mFaceDepthStencils)
+	{
+		if (faceDepthStencil) faceDepthStencil->Release();
+	}
 }
 
 IMesh* CPointLight::GetMesh() { return lightMesh; }
@@ -103,7 +110,7 @@ void CPointLight::SetModel(IModel* newModel)
 
 void CPointLight::RenderLight(PerFrameConstants& perFrameConstants, PerModelConstants& perModelConstants)
 {
-	myEngine->GetContext()->RSSetViewports(1, &mCubeMapViewport);
+	myEngine->GetStateContext()->RSSetViewports(1, &mCubeMapViewport);
 	perFrameConstants.lightCount = mLightCount;
 	perFrameConstants.lightColours[mLightIndex] = mLightColour * mLightStrength;
 	perFrameConstants.lightColours[mLightIndex].w = static_cast<float>(mLightType);//Pass the light type to shaders, 
@@ -133,6 +140,15 @@ void CPointLight::RenderLight(PerFrameConstants& perFrameConstants, PerModelCons
 		perFrameConstants.cubeViewProj[i] = mCubeViewProj[i];
 	}
 
+	// The first MAX_POINT_SHADOWS point lights each have a slot for their cube shadow map (see CScene::RenderLights).
+	// A slot stays empty, so the light unshadowed, until all six faces have been rendered
+	if (mPointLightIndex < PerFrameConstants::MAX_POINT_SHADOWS)
+	{
+		bool allFacesRendered = std::all_of(std::begin(mFaceRendered), std::end(mFaceRendered), [](bool rendered) { return rendered; });
+		perFrameConstants.pointShadowLights[mPointLightIndex] = allFacesRendered ? mLightIndex : -1;
+		perFrameConstants.pointShadowDepth = { maths::CUBE_FACE_PROJECTION.e22, maths::CUBE_FACE_PROJECTION.e32 };
+	}
+
 	//int viewMatrixIndex = mPointLightIndex * (mLightModels.size() - 1);//0,4,8,12
 	//for (int modelIndex = 1; modelIndex < 5; ++modelIndex)
 	//{
@@ -236,6 +252,21 @@ bool CPointLight::ShadowDepthBuffer()
 		return false;
 	}
 
+	// A depth stencil view for each face, so the faces can be rendered one at a time
+	D3D11_DEPTH_STENCIL_VIEW_DESC faceDesc = {};
+	faceDesc.Format = DXGI_FORMAT_D32_FLOAT;
+	faceDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2DARRAY;
+	faceDesc.Texture2DArray.MipSlice = 0;
+	faceDesc.Texture2DArray.ArraySize = 1;
+	for (int face = 0; face < 6; ++face)
+	{
+		faceDesc.Texture2DArray.FirstArraySlice = face;
+		if (FAILED(mDevice->CreateDepthStencilView(mCubeShadow, &faceDesc, &mFaceDepthStencils[face])))
+		{
+			return false;
+		}
+	}
+
 
 	// We also need to send this texture (resource) to the shaders. To do that we must create a shader-resource "view"
 	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
@@ -284,50 +315,35 @@ bool CPointLight::ShadowDepthBuffer()
 	return true;
 }
 
-void CPointLight::ClearDepthStencil(ID3D11DeviceContext* context)
+void CPointLight::ClearDepthStencil(CStateContext* context)
 {
-	myEngine->GetContext()->OMSetRenderTargets(0, nullptr, mShadowDepthStencil);
-	myEngine->GetContext()->ClearDepthStencilView(mShadowDepthStencil, D3D11_CLEAR_DEPTH, 1.0f, 0);
+	myEngine->GetStateContext()->OMSetRenderTargets(0, nullptr, mShadowDepthStencil);
+	myEngine->GetStateContext()->ClearDepthStencilView(mShadowDepthStencil, D3D11_CLEAR_DEPTH, 1.0f, 0);
+
+	// The cached faces are gone
+	for (auto& cache : mFaceCaches)
+	{
+		cache.Invalidate();
+	}
+	std::fill(std::begin(mFaceRendered), std::end(mFaceRendered), false);
 }
-void CPointLight::SendShadowMap2Shader(int textureSlot, ID3D11DeviceContext* context)
+void CPointLight::SendShadowMap2Shader(int textureSlot, CStateContext* context)
 {
 	myScene = myEngine->GetScene();
 	mPointSampler = myScene->GetPointSampler();
-	myEngine->GetContext()->PSSetShaderResources(2, 1, &mShadowSRV);
-	myEngine->GetContext()->PSSetSamplers(1, 1, &mPointSampler);
+	context->PSSetShaderResources(textureSlot, 1, &mShadowSRV);
+	context->PSSetSamplers(1, 1, &mPointSampler);
 }
 
 void CPointLight::ConstructCubeFaceCameras(maths::CVector3 lightPosition)
 {
 	//Light position used to generate the cameras for each face of cube map
-	maths::CVector3 center = lightPosition;
-	maths::CVector3 worldUp{ 0.0f, 1.0f, 0.0f };
-
-	//Face each axes
-	maths::CVector3 axes[6] =
-	{
-		maths::CVector3{lightPosition.x + 1.0f, lightPosition.y, lightPosition.z},//Face to the RIGHT +X
-		maths::CVector3{lightPosition.x - 1.0f, lightPosition.y, lightPosition.z},//Face to the LEFT -X
-		maths::CVector3{lightPosition.x, lightPosition.y + 1.0f, lightPosition.z},//Face UP +Y 
-		maths::CVector3{lightPosition.x, lightPosition.y - 1.0f, lightPosition.z},//Face DOWN -Y
-		maths::CVector3{lightPosition.x, lightPosition.y, lightPosition.z + 1.0f},//Face FORWARD +Z
-		maths::CVector3{lightPosition.x, lightPosition.y, lightPosition.z - 1.0f},//Face BACKWARD -Z
-	};
-
-	//Up vectors
-	maths::CVector3 ups[6] =
-	{
-		maths::CVector3{0.0f, 1.0f, 0.0f}, //+X
-		maths::CVector3{0.0f, 1.0f, 0.0f}, //-X
-		maths::CVector3{0.0f, 0.0f, -1.0f}, //+Y need different up vector when facing in y axes
-		maths::CVector3{0.0f, 0.0f, 1.0f}, //-Y
-		maths::CVector3{0.0f, 1.0f, 0.0f}, //+Z
-		maths::CVector3{0.0f, 1.0f, 0.0f}, //+Z
-	};
-
+	//Face directions and up vectors are constant, see CUBE_FACE_BASES
 	for (int i = 0; i < 6; ++i)
 	{
-		mCubeMapCameras[i] = new CCamera(center, axes[i], maths::PI * 0.5f, 1.0f, 0.1f, 1000.0f);
+		const maths::SCubeFaceBasis& face = maths::CUBE_FACE_BASES[i];
+		maths::CVector3 rotation = EulerAngles(maths::QuaternionFromAxes(face.right, face.up, face.forward));
+		mCubeMapCameras[i] = new CCamera(lightPosition, rotation, maths::PI * 0.5f, 1.0f, 0.1f, 1000.0f);
 	}
 }
 
@@ -336,69 +352,87 @@ void CPointLight::RenderCubeMap()
 	ID3D11RenderTargetView* renderTargets[1];
 
 	//Render to each cube map face
-	myEngine->GetContext()->RSSetViewports(1, &mCubeMapViewport);
+	myEngine->GetStateContext()->RSSetViewports(1, &mCubeMapViewport);
 	for (int i = 0; i < 6; ++i)
 	{
 		//Clear face and depth buffer
-		myEngine->GetContext()->ClearRenderTargetView(mCubeMapRTV[i], 0);
-		myEngine->GetContext()->ClearDepthStencilView(mShadowDepthStencil, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
+		myEngine->GetStateContext()->ClearRenderTargetView(mCubeMapRTV[i], 0);
+		myEngine->GetStateContext()->ClearDepthStencilView(mShadowDepthStencil, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
 
 		//bind face as render target
 		renderTargets[0] = mCubeMapRTV[i];
-		myEngine->GetContext()->OMSetRenderTargets(1, renderTargets, mShadowDepthStencil);
+		myEngine->GetStateContext()->OMSetRenderTargets(1, renderTargets, mShadowDepthStencil);
 	}
 
 
-	myEngine->GetContext()->GenerateMips(mShadowSRV);
+	myEngine->GetStateContext()->GenerateMips(mShadowSRV);
 
 
 }
 
-//Create the cube view projection matrices for each face
-void CPointLight::GetCubeViewProjection()
+// Fill the caster list for each cube face: models inside the face's frustum (found with the models' spatial
+// index) whose shadow can reach the camera's view. The light's own model surrounds the light, so is left out
+// Used instead of PointShadow_gs, which sends every triangle to all six faces
+void CPointLight::FindFaceCasters(ICamera* camera)
 {
+	maths::CFrustum cameraFrustum = camera->Frustum();
+	const float shadowDistance = 10000.0f; // Far clip of CUBE_FACE_PROJECTION
+	maths::CVector3 worldPos = lightModel->Position();
+	for (int face = 0; face < 6; ++face)
+	{
+		auto& casters = mFaceCasters[face];
+		mFaceViewProj[face] = maths::CubeFaceViewMatrix(face, worldPos) * maths::CUBE_FACE_PROJECTION;
+		Model::GetVisibleObjects(maths::FrustumFromMatrix(mFaceViewProj[face]), casters);
+		casters.erase(std::remove_if(casters.begin(), casters.end(), [&](IModel* model)
+		{
+			return model == lightModel || !maths::ShadowIntersects(cameraFrustum, model->WorldBounds(), worldPos, shadowDistance);
+		}), casters.end());
+	}
+}
 
-	maths::CMatrix4x4 lightProjection, position, spotView, toShadow;
+// Box around the casters of a face
+maths::CAABB CPointLight::GetFaceCasterBounds(int face)
+{
+	maths::CAABB bounds = maths::EmptyAABB();
+	for (auto model : mFaceCasters[face])
+	{
+		bounds = maths::Merge(bounds, model->WorldBounds());
+	}
+	return bounds;
+}
 
+// Render a face of the cube shadow map with its casters
+void CPointLight::RenderShadowFace(int face, PerFrameConstants& perFrameConstants, ID3D11Buffer* frameConstantBuffer,
+	CStateContext* context)
+{
+	context->RSSetViewports(1, &mCubeMapViewport);
+	context->OMSetRenderTargets(0, nullptr, mFaceDepthStencils[face]);
+	context->ClearDepthStencilView(mFaceDepthStencils[face], D3D11_CLEAR_DEPTH, 1.0f, 0);
+	mFaceCaches[face].MarkRendered(mFaceViewProj[face], mFaceCasters[face]);
+	mFaceRendered[face] = true;
+	if (mFaceCasters[face].empty()) return;
+
+	// Camera-like matrices for the face
+	perFrameConstants.viewMatrix = maths::CubeFaceViewMatrix(face, lightModel->Position());
+	perFrameConstants.projectionMatrix = maths::CUBE_FACE_PROJECTION;
+	perFrameConstants.viewProjectionMatrix = mFaceViewProj[face];
+	UpdateConstantBuffer(frameConstantBuffer, perFrameConstants, context->GetContext());
+
+	Model::RenderShadowCasters(mFaceCasters[face], context);
+}
+
+//Create the cube view projection matrices for each face
+void CPointLight::GetCubeViewProjection()
+{
 	//Position of light in world space
 	maths::CVector3 worldPos = lightModel->Position();
 
-	position = MatrixTranslation(-worldPos);
-	lightProjection = MakeProjectionMatrix(1.0f, maths::ToRadians(90));
-
-	//Cube +X
-	spotView = maths::MatrixRotationY(maths::PI + maths::PI * 0.5f);
-	toShadow = position * spotView * lightProjection;
-	toShadow.Transpose();
-	mCubeViewProj[0] = toShadow;
-
-	//Cube -X
-	spotView = maths::MatrixRotationY(maths::PI * 0.5f);
-	toShadow = position * spotView * lightProjection;
-	toShadow.Transpose();
-	mCubeViewProj[1] = toShadow;
-
-	//Cube +Y
-	spotView = maths::MatrixRotationY(maths::PI * 0.5f);
-	toShadow = position * spotView * lightProjection;
-	toShadow.Transpose();
-	mCubeViewProj[2] = toShadow;
-
-	//Cube -Y
-	spotView = maths::MatrixRotationY(maths::PI + maths::PI * 0.5f);
-	toShadow = position * spotView * lightProjection;
-	toShadow.Transpose();
-	mCubeViewProj[3] = toShadow;
-
-	//Cube +Z
-	toShadow = position * lightProjection;
-	toShadow.Transpose();
-	mCubeViewProj[4] = toShadow;
-
-	//Cube -Z
-	spotView = maths::MatrixRotationY(maths::PI);
-	toShadow = position * spotView * lightProjection;
-	toShadow.Transpose();
-	mCubeViewProj[5] = toShadow;
+	//Face order +X, -X, +Y, -Y, +Z, -Z. Bases and projection are compile-time constants
+	for (int i = 0; i < 6; ++i)
+	{
+		maths::CMatrix4x4 toShadow = maths::CubeFaceViewMatrix(i, worldPos) * maths::CUBE_FACE_PROJECTION;
+		toShadow.Transpose();
+		mCubeViewProj[i] = toShadow;
+	}
 }
 }
\ No newline at end of file
@@ -7,6 +7,7 @@
 //--------------------------------------------------------------------------------------
 
 #include "ILight.hpp"
+#include "ShadowCache.hpp"
 
 //======================================================================================
 namespace umbra_engine
@@ -41,6 +42,7 @@ public:
 	maths::CVector3 GetAmbientColour();
 	float GetLightStrength();
 	int GetLightNumber();
+	ELightType GetLightType() { return mLightType; }
 
 	//Setters
 	void SetPosition(const maths::CVector4& Pos);
@@ -58,10 +60,17 @@ public:
 //---------------------------------------
 	void RenderLight(PerFrameConstants& perFrameConstants, PerModelConstants& perModelConstants);
 	bool ShadowDepthBuffer();
-	void ClearDepthStencil(ID3D11DeviceContext* context);
-	void SendShadowMap2Shader(int textureSlot, ID3D11DeviceContext* context);
+	void ClearDepthStencil(CStateContext* context);
+	void SendShadowMap2Shader(int textureSlot, CStateContext* context);
 	void ConstructCubeFaceCameras(maths::CVector3 lightPosition);
 	void RenderCubeMap();
+	int NumShadowFaces() { return 6; }
+	void FindFaceCasters(ICamera* camera);
+	bool IsFaceOutOfDate(int face) { return mFaceCaches[face].IsOutOfDate(mFaceViewProj[face], mFaceCasters[face]); }
+	unsigned int GetFaceCasterCount(int face) { return static_cast<unsigned int>(mFaceCasters[face].size()); }
+	maths::CAABB GetFaceCasterBounds(int face);
+	void RenderShadowFace(int face, PerFrameConstants& perFrameConstants, ID3D11Buffer* frameConstantBuffer,
+		CStateContext* context);
 
 private:
 //---------------------------------------
@@ -102,6 +111,14 @@ private:
 	D3D11_VIEWPORT mCubeMapViewport;
 	ID3D11RenderTargetView* mCubeMapRTV[6];//Create render target for each face
 	maths::CMatrix4x4 mCubeViewProj[6];
+
+	// Per-face shadow casters, each face is rendered into its own slice of the cube map through its own view.
+	// A face is only rendered again when the light or its casters have changed
+	ID3D11DepthStencilView* mFaceDepthStencils[6] = {};
+	maths::CMatrix4x4 mFaceViewProj[6]; // As mCubeViewProj but not transposed, for the CPU
+	std::vector<IModel*> mFaceCasters[6];
+	CShadowCache mFaceCaches[6];
+	bool mFaceRendered[6] = {}; // The cube map is only sampled once every face has been rendered
 };//Class
 }//Namespace
 #endif//Header Guard
\ No newline at end of file
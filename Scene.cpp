@@ -2,6 +2,7 @@
 #include "DirectX11Engine.hpp"
 #include "Light.hpp"
 #include "Model.hpp"
+#include <algorithm>
 
 namespace umbra_engine
 {
@@ -10,7 +11,7 @@ CScene::CScene(IEngine* engine)
 {
 	mEngine = engine;
 
-	mD3DContext = mEngine->GetContext();
+	mD3DContext = mEngine->GetStateContext();
 	mD3DDevice = mEngine->GetDevice();
 }
 
@@ -18,6 +19,8 @@ CScene::~CScene()
 {
 	ImGui_ImplDX11_Shutdown();
 	ImGui::DestroyContext();
+	if (mMainVS) mMainVS->Release();
+	if (mInstancedVS) mInstancedVS->Release();
 }
 
 bool CScene::InitGeometry()
@@ -63,6 +66,21 @@ bool CScene::InitScene()
 	mlightModelps = LoadPixelShader("LightModel_ps", mEngine);
 	mlightModelvs = LoadVertexShader("LightModel_vs", mEngine);
 
+	if (!mShadowAtlas.Init(mEngine))
+	{
+		mLastError = "Error creating shadow atlas";
+		return false;
+	}
+
+	// Instanced rendering of models sharing a mesh. Models draw one at a time if the instanced shader is missing
+	if (!mInstanceBuffer.Init(mEngine))
+	{
+		mLastError = "Error creating instance buffer";
+		return false;
+	}
+	mMainVS = LoadSharedVertexShader("main_vs", mEngine);
+	mInstancedVS = LoadVertexShader("main_instanced_vs", mEngine);
+
 	//// Set up cameras ////
 	camera = std::make_unique<CCamera>();
 	camera->SetPosition({ 200, 10, 20 });
@@ -87,6 +105,19 @@ bool CScene::InitScene()
 	return true;
 }
 
+// Merge the models marked static into large batches drawn in place of the models
+bool CScene::BuildStaticGeometry(const std::vector<IModel*>& models)
+{
+	if (!mStaticGeometry.Build(models, mEngine))
+	{
+		// Draw the models one by one instead
+		for (auto model : models) model->SetStatic(false);
+		mLastError = "Error creating static geometry buffers";
+		return false;
+	}
+	return true;
+}
+
 //--------------------------------------------------------------------------------------
 // State creation / destruction
 //--------------------------------------------------------------------------------------
@@ -346,7 +377,7 @@ void CScene::RenderSceneFromCamera()
 	mPerFrameConstants.projectionMatrix = camera->ProjectionMatrix();
 	mPerFrameConstants.viewProjectionMatrix = camera->ViewProjectionMatrix();
 
-	UpdateConstantBuffer(mPerFrameConstantBuffer.Get(), mPerFrameConstants, mD3DContext);
+	UpdateConstantBuffer(mPerFrameConstantBuffer.Get(), mPerFrameConstants, mD3DContext->GetContext());
 
 	//mPerFrameConstantBuffer = mEngine->GetFrameConstantBuffer();
 
@@ -371,6 +402,10 @@ void CScene::RenderScene(float& frameTime)
 	//ImGui_ImplWin32_NewFrame();//
 	//ImGui::NewFrame();
 
+	// Count this frame's state changes from here, and bind everything afresh - the GUI and last frame's sprite
+	// batch change state without going through the state context
+	mD3DContext->NewFrame();
+
 	D3D11_VIEWPORT vp;
 	allModels = mEngine->GetAllModels();
 	allModels = Model::GetAllObjects();
@@ -383,33 +418,35 @@ void CScene::RenderScene(float& frameTime)
 
 	// Select the shadow map texture as the current depth buffer. We will not be rendering any pixel colours
 	// Also clear the the shadow map depth buffer to the far distance
-	//Only first light is casting shadows at this moment in time
-	//mLights[3]->ClearDepthStencil(mD3DContext);
-	//RenderDepthBufferFromLight(3);
-
+	//Only the first light, spot lights, directional lights and the first few point lights cast shadows (see mShadowingLights)
+	UpdateShadowMaps();
 
-	mLights[0]->ClearDepthStencil(mD3DContext);
-	RenderDepthBufferFromLight(0);
-
-	std::vector<IModel*> allCurrentModels = mEngine->GetAllModels();
-	// Render models - no state changes required between each object in this situation (no textures used in this step)
-	for (unsigned int i = 0; i < allCurrentModels.size(); ++i)
+	//// Render lights ////
+	// Rendered with different shaders, textures, states from other models. Point lights fill the cube shadow map
+	// slots that are ready
+	for (auto& pointShadowLight : mPerFrameConstants.pointShadowLights)
 	{
-		if (i == 0)
-		{
-			//This line effectively means, don't use any pixel shaders
-			mD3DContext->PSSetShader(NULL, NULL, 0);//Get's rid of warning about pixel shader expecting render target view bound to 0...
-		}
-		allCurrentModels[i]->Render();
+		pointShadowLight = -1;
 	}
-
-	//// Render lights ////
-	// Rendered with different shaders, textures, states from other models
 	for (unsigned int i = 0; i < mLights.size(); ++i)
 	{
 		mLights[i]->RenderLight(mPerFrameConstants, mPerModelConstants);
 	}
 
+	// Shadow maps may be a few frames old, sample them with the matrices they were rendered with. Lights without
+	// a rendered tile in the shadow atlas are unshadowed (zero tile)
+	for (auto& tile : mPerFrameConstants.lightShadowTiles)
+	{
+		tile = { 0, 0, 0, 0 };
+	}
+	for (auto lightIndex : mShadowingLights)
+	{
+		if (lightIndex >= static_cast<int>(mShadowMaps.size()) || !mShadowMaps[lightIndex].rendered) continue;
+		mPerFrameConstants.lightViewMatrix[lightIndex] = mShadowMaps[lightIndex].renderedViewMatrix;
+		mPerFrameConstants.lightProjectionMatrix[lightIndex] = mShadowMaps[lightIndex].renderedProjectionMatrix;
+		mPerFrameConstants.lightShadowTiles[lightIndex] = mShadowAtlas.TileUVRect(lightIndex);
+	}
+
 	//// Main scene rendering ////
 
 	// Now set the back buffer as the target for rendering and select the main depth buffer.
@@ -441,7 +478,17 @@ void CScene::RenderScene(float& frameTime)
 	// Render the scene for the main window
 
 	//mLights[3]->SendShadowMap2Shader(5, mD3DContext);
-	mLights[0]->SendShadowMap2Shader(2, mD3DContext);
+	ID3D11ShaderResourceView* shadowAtlas = mShadowAtlas.GetSRV();
+	mD3DContext->PSSetShaderResources(2, 1, &shadowAtlas);
+	if (mPerFrameConstants.numCascades > 0)
+	{
+		mLights[mPerFrameConstants.cascadeLightIndex]->SendShadowMap2Shader(6, mD3DContext);
+	}
+	for (int slot = 0; slot < PerFrameConstants::MAX_POINT_SHADOWS; ++slot)
+	{
+		int lightIndex = mPerFrameConstants.pointShadowLights[slot];
+		if (lightIndex >= 0) mLights[lightIndex]->SendShadowMap2Shader(7 + slot, mD3DContext); // PointShadowMaps in main_ps
+	}
 
 	RenderSceneFromCamera();
 	RenderModels(frameTime);
@@ -451,6 +498,11 @@ void CScene::RenderScene(float& frameTime)
 	CComPtr<ID3D11ShaderResourceView> nullView = nullptr;
 	CComPtr<ID3D11SamplerState> nullSampler = nullptr;
 	mD3DContext->PSSetShaderResources(2, 1, &nullView);
+	mD3DContext->PSSetShaderResources(6, 1, &nullView);
+	for (int slot = 0; slot < PerFrameConstants::MAX_POINT_SHADOWS; ++slot)
+	{
+		mD3DContext->PSSetShaderResources(7 + slot, 1, &nullView);
+	}
 	mD3DContext->PSSetSamplers(1, 1, &nullSampler);
 	   
 	UpdateScene(frameTime);
@@ -486,6 +538,7 @@ void CScene::RenderScene(float& frameTime)
 		mFont->DrawString(mSpriteBatch.get(), L"CAUTION! EXTREME FLASHING LIGHTS", DirectX::XMFLOAT2(gViewportWidth / 3, gViewportHeight / 3));
 		mFont->DrawString(mSpriteBatch.get(), L"This may cause seizures. Continue at your own risk!", DirectX::XMFLOAT2((gViewportWidth / 3) - 200, (gViewportHeight / 3) + 50));
 		mSpriteBatch->End();
+		mD3DContext->Invalidate(); // The sprite batch sets its own states
 	}
 
 	mEngine->GetSwapChain()->Present(0, 0);
@@ -493,79 +546,188 @@ void CScene::RenderScene(float& frameTime)
 
 void CScene::RenderModels(float& frameTime)
 {
-	//Add blending to models if required - Blending needs to be done last
-	//Render each model
-	for (unsigned int j = 0; j < allModels.size(); ++j)
-	{
-		float distFromCam = maths::Distance(allModels[j]->Position(), camera->Position());
-		float maxRenderDist = 400.0f;
-		//To ensure frame time doesn't drop too low models will only render within
-		//a certain range and models should be loaded in order of importantance hence
-		//the j < 3 part as they will be rendered no matter what
-		if ( j < 15 || distFromCam < maxRenderDist)
+	// Models are culled against the camera frustum using their world space bounding boxes, so off-screen
+	// models cost no state changes or draw calls, and large models stay visible while any part is on screen
+	// The models' spatial index skips whole groups of off-screen models without visiting them
+	// Visible models are put in creation order so models with equal sort keys are drawn in the same order each frame
+	Model::GetVisibleObjects(camera->Frustum(), mVisibleModels);
+	Model::SortInCreationOrder(mVisibleModels);
+	mNumCulledModels = static_cast<unsigned int>(allModels.size() - mVisibleModels.size());
+
+	// Then occlusion culling - draw the visible occluders into a small CPU depth buffer and drop any model whose
+	// bounds are hidden behind them. Occluders are tested too, one building can hide another
+	mOcclusionCuller.BeginFrame(camera->ViewProjectionMatrix());
+	for (auto model : mVisibleModels)
+	{
+		if (!model->IsOccluder()) continue;
+		const auto& positions = model->GetMesh()->GetPositions();
+		const auto& indices = model->GetMesh()->GetIndices();
+		if (indices.empty()) continue;
+		mOcclusionCuller.AddOccluder(positions.data(), sizeof(maths::CVector3), indices.data(), indices.size(), model->WorldMatrix());
+	}
+	mOcclusionCuller.Rasterise();
+	mVisibleModels.erase(std::remove_if(mVisibleModels.begin(), mVisibleModels.end(),
+	                                    [this](IModel* model) { return mOcclusionCuller.IsOccluded(model->WorldBounds()); }),
+	                     mVisibleModels.end());
+	mNumVisibleModels = static_cast<unsigned int>(mVisibleModels.size());
+
+	// Queue a draw for each model, keyed by its state and its distance along the view (see CRenderQueue.hpp), and
+	// sort them so that models sharing state are drawn together. Blended models are drawn last, back to front
+	// Static models are drawn through their merged batches below, so they are not queued
+	maths::CMatrix4x4 cameraMatrix = camera->WorldMatrix();
+	maths::CVector3 cameraPosition = cameraMatrix.GetPosition();
+	maths::CVector3 cameraForward = maths::Normalise(cameraMatrix.GetZAxis());
+	bool showBlendingDebug = KeyHeld(Key_F1);
+
+	mRenderQueue.Clear();
+	for (unsigned int i = 0; i < mVisibleModels.size(); ++i)
+	{
+		IModel* model = mVisibleModels[i];
+		if (model->IsStatic()) continue;
+		maths::CAABB bounds = model->WorldBounds();
+
+		maths::SRenderKey key;
+		key.blend = model->GetAddBlend();
+		key.pass = (key.blend == None) ? maths::ERenderPass::Opaque : maths::ERenderPass::Blended;
+		key.shader = mRenderQueue.ShaderId(model->GetVSShader(), model->GetPSShader());
+		key.textures = mRenderQueue.TextureId(model->GetDiffuseSRVMap2(), model->GetDiffuseSRVMap3());
+		key.mesh = mRenderQueue.MeshId(model->GetMesh());
+		key.depth = maths::Dot((bounds.minimum + bounds.maximum) * 0.5f - cameraPosition, cameraForward);
+		mRenderQueue.Submit(key, i);
+
+		// Holding F1 draws additive models again unblended, and opaque models again alpha blended
+		if (showBlendingDebug && (key.blend == Add || key.blend == None))
 		{
-			if (allModels[j]->GetAddBlend() == Add)
-			{
-				// States - additive blending, read-only depth buffer and no culling (standard set-up for blending
-				mD3DContext->OMSetBlendState(mAdditiveBlendingState, nullptr, 0xffffff);
-				mD3DContext->OMSetDepthStencilState(mDepthReadOnlyState, 0);
-				mD3DContext->RSSetState(mCullBackState);
-				allModels[j]->Render();
-
-
-				//Change blending for the flare models.  (Additive by default)
-				if (KeyHeld(Key_F1))
-				{
-					//NO BLENDING
-					// States - additive blending, read-only depth buffer and no culling (standard set-up for blending
-					mD3DContext->OMSetBlendState(mNoBlendingState, nullptr, 0xffffff);
-					mD3DContext->OMSetDepthStencilState(mDepthReadOnlyState, 0);
-					mD3DContext->RSSetState(mCullBackState);
-					allModels[j]->Render();
-				}
-			}
-			else if (allModels[j]->GetAddBlend() == Multi)
-			{
-				//MULTIPLICATIVE BLENDING
-				// States - additive blending, read-only depth buffer and no culling (standard set-up for blending
-				mD3DContext->OMSetBlendState(mMultiplicativeBlendingState, nullptr, 0xffffff);
-				mD3DContext->OMSetDepthStencilState(mDepthReadOnlyState, 0);
-				mD3DContext->RSSetState(mCullBackState);
-				allModels[j]->Render();
-			}
-			else if (allModels[j]->GetAddBlend() == Alpha)
+			key.blend = (key.blend == Add) ? None : Alpha;
+			key.pass = maths::ERenderPass::Blended;
+			mRenderQueue.Submit(key, i);
+		}
+	}
+	mRenderQueue.Sort();
+
+	// Draw in key order, only setting the states that differ from the previous draw's. All models use the same
+	// sampler and per-model constant buffer slot, so those are set once
+	ID3D11BlendState* blendStates[] = { mNoBlendingState, mAdditiveBlendingState, mMultiplicativeBlendingState, mAlphaBlendingState };
+	mD3DContext->PSSetSamplers(0, 1, &mAnisotropic4xSampler);
+	mD3DContext->RSSetState(mCullBackState);
+
+	// Merged static geometry first, it is opaque and usually covers much of the screen. Batches are culled a
+	// chunk at a time against the frustum and the occluders rasterised above
+	mD3DContext->OMSetDepthStencilState(mUseDepthBufferState, 0);
+	mD3DContext->OMSetBlendState(mNoBlendingState, nullptr, 0xffffff);
+	mStaticGeometry.Render(camera->Frustum(), &mOcclusionCuller, mEngine);
+
+	mRenderQueueStats.numDraws = static_cast<unsigned int>(mRenderQueue.Items().size());
+	mRenderQueueStats.numStateChanges = 0;
+	mRenderQueueStats.numBatches = 0;
+	mRenderQueueStats.numInstanced = 0;
+	mRenderQueueStats.batchSizes.clear();
+
+	const auto& items = mRenderQueue.Items();
+	maths::SRenderKey previous = {};
+	bool first = true;
+	bool instancedVSSet = false;
+	for (size_t i = 0; i < items.size(); )
+	{
+		maths::SRenderKey key = maths::CRenderQueue::UnpackKey(items[i].key);
+		IModel* model = mVisibleModels[items[i].index];
+
+		// Models after this one with the same state and mesh are drawn with it in one instanced draw. Only models
+		// using main_vs, which has an instanced version, and never models whose state has a shared id
+		bool canInstance = mInstancedVS != nullptr && model->GetVSShader() == mMainVS && model->GetMesh()->CanInstance() &&
+		                   key.shader != maths::CRenderQueue::SharedId && key.textures != maths::CRenderQueue::SharedId &&
+		                   key.mesh != maths::CRenderQueue::SharedId;
+		size_t end = canInstance ? mRenderQueue.BatchEnd(i) : i + 1;
+
+		// Opaque models write depth, blended models only read it (standard set-up for blending)
+		if (first || key.pass != previous.pass)
+		{
+			mD3DContext->OMSetDepthStencilState(key.pass == maths::ERenderPass::Opaque ? mUseDepthBufferState : mDepthReadOnlyState, 0);
+			++mRenderQueueStats.numStateChanges;
+		}
+		if (first || key.blend != previous.blend)
+		{
+			mD3DContext->OMSetBlendState(blendStates[key.blend], nullptr, 0xffffff);
+			++mRenderQueueStats.numStateChanges;
+		}
+
+		// Ids shared by several states don't say whether the state changed, so always set them. An instanced draw
+		// changes the vertex shader, so the next draw sets its shaders too
+		if (first || key.shader != previous.shader || key.shader == maths::CRenderQueue::SharedId || instancedVSSet)
+		{
+			mD3DContext->VSSetShader(model->GetVSShader(), nullptr, 0);
+			mD3DContext->PSSetShader(model->GetPSShader(), nullptr, 0);
+			instancedVSSet = false;
+			++mRenderQueueStats.numStateChanges;
+		}
+		if (first || key.textures != previous.textures || key.textures == maths::CRenderQueue::SharedId)
+		{
+			ID3D11ShaderResourceView* textures[] = { model->GetDiffuseSRVMap2(), model->GetDiffuseSRVMap3() };
+			mD3DContext->PSSetShaderResources(1, 1, &textures[0]); // Slots must match the shaders, as in Model::Render
+			mD3DContext->PSSetShaderResources(3, 1, &textures[1]);
+			++mRenderQueueStats.numStateChanges;
+		}
+
+		if (end - i >= MinInstances)
+		{
+			mInstancedModels.clear();
+			for (size_t j = i; j < end; ++j)
 			{
-				//Alpha BLENDING
-				// States - additive blending, read-only depth buffer and no culling (standard set-up for blending
-				mD3DContext->OMSetBlendState(mAlphaBlendingState, nullptr, 0xffffff);
-				mD3DContext->OMSetDepthStencilState(mDepthReadOnlyState, 0);
-				mD3DContext->RSSetState(mCullBackState);
-				allModels[j]->Render();
+				mInstancedModels.push_back(mVisibleModels[items[j].index]);
 			}
-			else
+
+			// World matrices come from the instance buffer, so the constant buffer's one is the identity
+			PerModelConstants modelConstants = mEngine->GetModelConstants();
+			modelConstants.worldMatrix = maths::MatrixIdentity();
+			mEngine->SetModelConstants(modelConstants);
+			UpdateConstantBuffer(mEngine->GetModelConstantBuffer(), modelConstants, mD3DContext->GetContext());
+			ID3D11Buffer* modelConstantBuffer = mEngine->GetModelConstantBuffer();
+			mD3DContext->VSSetConstantBuffers(1, 1, &modelConstantBuffer);
+			mD3DContext->PSSetConstantBuffers(1, 1, &modelConstantBuffer);
+
+			mD3DContext->VSSetShader(mInstancedVS, nullptr, 0);
+			instancedVSSet = true;
+			model->GetMesh()->RenderInstanced(mInstancedModels.data(), static_cast<unsigned int>(mInstancedModels.size()), mInstanceBuffer);
+
+			++mRenderQueueStats.numBatches;
+			mRenderQueueStats.numInstanced += static_cast<unsigned int>(end - i);
+			mRenderQueueStats.batchSizes.push_back(static_cast<unsigned int>(end - i));
+		}
+		else
+		{
+			for (size_t j = i; j < end; ++j)
 			{
-				UpdateConstantBuffer(mEngine->GetModelConstantBuffer(), mEngine->GetModelConstants(), mD3DContext); // Send to GPU
-				allModels[j]->Render();
-				mD3DContext->RSSetState(mCullBackState);
-
-				//Change blending for the flare models.  (Additive by default)
-				if (KeyHeld(Key_F1))
-				{
-					//NO BLENDING
-					// States - additive blending, read-only depth buffer and no culling (standard set-up for blending
-					mD3DContext->OMSetBlendState(mAlphaBlendingState, nullptr, 0xffffff);
-					mD3DContext->OMSetDepthStencilState(mDepthReadOnlyState, 0);
-					mD3DContext->RSSetState(mCullBackState);
-					allModels[j]->Render();
-				}
+				mVisibleModels[items[j].index]->RenderGeometry();
 			}
 		}
+
+		previous = key;
+		first = false;
+		i = end;
 	}
 }
 
 void CScene::RenderLights(std::vector<ILight*> lights)
 {
 	mLights = mEngine->GetAllLights();
+
+	// Directional lights always cast shadows, through their cascades, and spot lights through the shadow atlas.
+	// Only the first MAX_POINT_SHADOWS point lights have a cube shadow map slot in the shaders, so only they cast
+	// shadows. Lights past the end of the per-frame constant arrays aren't lit in the shaders, so never cast shadows
+	int numPointLights = 0;
+	for (unsigned int i = 0; i < mLights.size() && i < PerFrameConstants::MAX_LIGHTS; ++i)
+	{
+		int lightIndex = static_cast<int>(i);
+		ELightType type = mLights[i]->GetLightType();
+		bool castsShadows = type == Directional || type == Spot ||
+			(type == Point && numPointLights < PerFrameConstants::MAX_POINT_SHADOWS);
+		if (type == Point) ++numPointLights;
+		if (castsShadows &&
+			std::find(mShadowingLights.begin(), mShadowingLights.end(), lightIndex) == mShadowingLights.end())
+		{
+			mShadowingLights.push_back(lightIndex);
+		}
+	}
 }
 
 void CScene::RenderShadow(D3D11_VIEWPORT& vp)
@@ -576,7 +738,7 @@ void CScene::RenderShadow(D3D11_VIEWPORT& vp)
 	vp.MaxDepth = 1.0f;
 	vp.TopLeftX = 0;
 	vp.TopLeftY = 0;
-	mEngine->GetContext()->RSSetViewports(1, &vp);
+	mEngine->GetStateContext()->RSSetViewports(1, &vp);
 }
 
 void CScene::UpdateScene(float frameTime)
@@ -585,7 +747,18 @@ void CScene::UpdateScene(float frameTime)
 
 	// Control camera (will update its view matrix)
 	camera->Control(frameTime, Key_Up, Key_Down, Key_Left, Key_Right, Key_W, Key_S, Key_A, Key_D);
-	camera->SetPosition({ camera->Position().x, 10, camera->Position().z });
+
+	// Keep the camera at eye height above whatever is below it. The ray starts at eye level, so the camera steps up
+	// onto anything lower than that. With nothing below it stays at eye height above 0
+	const float eyeHeight = 10.0f;
+	maths::CVector3 cameraPosition = camera->Position();
+	maths::SRayHit ground;
+	float groundHeight = 0.0f;
+	if (Model::SpatialQuery().RayCast(maths::CRay{ cameraPosition, { 0.0f, -1.0f, 0.0f } }, 1000.0f, ground))
+	{
+		groundHeight = ground.point.y;
+	}
+	camera->SetPosition({ cameraPosition.x, groundHeight + eyeHeight, cameraPosition.z });
 
 	// Show frame time / FPS in the window title //
 	const float fpsUpdateTime = 0.5f; // How long between updates (in seconds)
@@ -608,14 +781,123 @@ void CScene::UpdateScene(float frameTime)
 	}
 }
 
+// Find out which shadow maps (or point light cube faces) are out of date and render as many as the budget allows.
+// The rest are requested again next frame, with a higher priority the longer they wait
+void CScene::UpdateShadowMaps()
+{
+	if (mShadowMaps.size() < mLights.size()) mShadowMaps.resize(mLights.size());
+
+	maths::CVector3 cameraPosition = camera->Position();
+
+	// Give each spot light with casters a tile in the shadow atlas, sized by how large its casters are on screen.
+	// A light whose tile moved must be rendered again, one without a tile is unshadowed this frame
+	mShadowAtlas.BeginFrame();
+	for (auto lightIndex : mShadowingLights)
+	{
+		if (mLights[lightIndex]->NumShadowFaces() > 0) continue;
+		FindShadowCasters(lightIndex);
+		const SShadowMap& shadowMap = mShadowMaps[lightIndex];
+		if (shadowMap.casters.empty()) continue;
+
+		maths::CAABB bounds = maths::EmptyAABB();
+		for (auto model : shadowMap.casters)
+		{
+			bounds = maths::Merge(bounds, model->WorldBounds());
+		}
+		float resolution = CShadowAtlas::ShadowResolution(bounds, cameraPosition, static_cast<float>(gViewportHeight),
+			1.0f / camera->ProjectionMatrix().e11, mMaxShadowResolution);
+		mShadowAtlas.Request(lightIndex, resolution);
+	}
+	mShadowAtlas.Allocate();
+
+	mShadowScheduler.BeginFrame();
+	for (auto lightIndex : mShadowingLights)
+	{
+		ILight* light = mLights[lightIndex];
+		if (light->NumShadowFaces() > 0)
+		{
+			light->FindFaceCasters(camera.get());
+			for (int face = 0; face < light->NumShadowFaces(); ++face)
+			{
+				if (!light->IsFaceOutOfDate(face)) continue;
+				float contribution = CShadowScheduler::ScreenContribution(light->GetFaceCasterBounds(face), cameraPosition);
+				mShadowScheduler.Request(lightIndex, face, contribution, light->GetFaceCasterCount(face));
+			}
+		}
+		else
+		{
+			SShadowMap& shadowMap = mShadowMaps[lightIndex];
+			if (!mShadowAtlas.HasTile(lightIndex))
+			{
+				shadowMap.rendered = false;
+				continue;
+			}
+			if (mShadowAtlas.TileChanged(lightIndex))
+			{
+				shadowMap.cache.Invalidate();
+				shadowMap.rendered = false;
+			}
+			if (!shadowMap.cache.IsOutOfDate(shadowMap.viewMatrix * shadowMap.projectionMatrix, shadowMap.casters)) continue;
+
+			maths::CAABB bounds = maths::EmptyAABB();
+			for (auto model : shadowMap.casters)
+			{
+				bounds = maths::Merge(bounds, model->WorldBounds());
+			}
+			float contribution = CShadowScheduler::ScreenContribution(bounds, cameraPosition);
+			mShadowScheduler.Request(lightIndex, 0, contribution, static_cast<unsigned int>(shadowMap.casters.size()));
+		}
+	}
+
+	for (const auto& update : mShadowScheduler.Schedule())
+	{
+		if (mLights[update.light]->NumShadowFaces() > 0)
+		{
+			RenderDepthBufferFromLightFace(update.light, update.face);
+		}
+		else
+		{
+			RenderDepthBufferFromLight(update.light);
+		}
+	}
+}
+
+// Shadow casters are the models lit by the spot light (inside the frustum of its projection, found with the
+// spatial index, then inside its cone) whose shadow can reach the camera's view. A model outside the light
+// can't cast a shadow, and one whose shadow falls off screen doesn't need to be in the shadow map
+void CScene::FindShadowCasters(int lightIndex)
+{
+	SShadowMap& shadowMap = mShadowMaps[lightIndex];
+
+	// Get camera-like matrices from the spotlight
+	maths::CMatrix4x4 lightMatrix = mLights[lightIndex]->GetModel()->WorldMatrix();
+	shadowMap.viewMatrix = InverseAffine(lightMatrix);
+	shadowMap.projectionMatrix = MakeProjectionMatrix(1.0f, acos(mPerFrameConstants.lightFacings[lightIndex].w) * 2.0f, 0.1f, mShadowDistance); // Helper function in Utility\GraphicsHelpers.cpp
+
+	auto& casters = shadowMap.casters;
+	Model::GetVisibleObjects(maths::FrustumFromMatrix(shadowMap.viewMatrix * shadowMap.projectionMatrix), casters);
+
+	maths::CVector3 lightPosition = lightMatrix.GetPosition();
+	maths::CCone lightCone{ lightPosition, maths::Normalise(lightMatrix.GetZAxis()), mPerFrameConstants.lightFacings[lightIndex].w };
+	maths::CFrustum cameraFrustum = camera->Frustum();
+	casters.erase(std::remove_if(casters.begin(), casters.end(), [&](IModel* model)
+	{
+		maths::CAABB bounds = model->WorldBounds();
+		return !maths::Intersects(lightCone, bounds) || !maths::ShadowIntersects(cameraFrustum, bounds, lightPosition, mShadowDistance);
+	}), casters.end());
+}
+
+// Render a light's shadow map with the casters found by FindShadowCasters this frame
 void CScene::RenderDepthBufferFromLight(int lightIndex)
 {
-	// Get camera-like matrices from the spotlight, seet in the constant buffer and send over to GPU
-	mPerFrameConstants.viewMatrix = InverseAffine(mLights[lightIndex]->GetModel()->WorldMatrix());
-	mPerFrameConstants.projectionMatrix = MakeProjectionMatrix(1.0f, acos(mPerFrameConstants.lightFacings[lightIndex].w) * 2.0f); // Helper function in Utility\GraphicsHelpers.cpp
+	SShadowMap& shadowMap = mShadowMaps[lightIndex];
+
+	// Camera-like matrices from the spotlight, set in the constant buffer and send over to GPU
+	mPerFrameConstants.viewMatrix = shadowMap.viewMatrix;
+	mPerFrameConstants.projectionMatrix = shadowMap.projectionMatrix;
 	mPerFrameConstants.viewProjectionMatrix = mPerFrameConstants.viewMatrix * mPerFrameConstants.projectionMatrix;
 
-	UpdateConstantBuffer(mPerFrameConstantBuffer.Get(), mPerFrameConstants, mD3DContext);
+	UpdateConstantBuffer(mPerFrameConstantBuffer.Get(), mPerFrameConstants, mD3DContext->GetContext());
 
 	// Indicate that the constant buffer we just updated is for use in the vertex shader (VS) and pixel shader (PS)
 	mD3DContext->VSSetConstantBuffers(0, 1, mPerFrameConstantBuffer.GetAddressOf()); // First parameter must match constant buffer number in the shader 
@@ -623,17 +905,48 @@ void CScene::RenderDepthBufferFromLight(int lightIndex)
 	
 	//// Only render models that cast shadows ////
 
+	// Select the light's tile of the shadow atlas as the current depth buffer and viewport, and clear it to the far
+	// distance. This changes shaders and states, so comes first
+	mD3DContext->OMSetBlendState(mNoBlendingState, nullptr, 0xffffff);
+	mShadowAtlas.BeginTile(lightIndex, mD3DContext);
+
 	// Use special depth-only rendering shaders
 	mD3DContext->VSSetShader(mBasicPixel, nullptr, 0);
 	mD3DContext->PSSetShader(mDepthOnly, nullptr, 0);
 
 	// States - no blending, normal depth buffer and culling
-	mD3DContext->OMSetBlendState(mNoBlendingState, nullptr, 0xffffff);
 	mD3DContext->OMSetDepthStencilState(mUseDepthBufferState, 0);
 	mD3DContext->RSSetState(mCullBackState);
 
 	mD3DContext->PSSetSamplers(0, 1, &mAnisotropic4xSampler);
 	mD3DContext->PSSetSamplers(1, 1, &mPointSampler);
+
+	shadowMap.cache.MarkRendered(mPerFrameConstants.viewProjectionMatrix, shadowMap.casters);
+	shadowMap.rendered = true;
+	shadowMap.renderedViewMatrix = shadowMap.viewMatrix;
+	shadowMap.renderedProjectionMatrix = shadowMap.projectionMatrix;
+
+	// Render models - no state changes required between each object in this situation (no textures used in this step)
+	//This line effectively means, don't use any pixel shaders
+	mD3DContext->PSSetShader(NULL, NULL, 0);//Get's rid of warning about pixel shader expecting render target view bound to 0...
+	Model::RenderShadowCasters(shadowMap.casters, mD3DContext);
+}
+
+// Render a face of a light's shadow map (point light cube face or directional light cascade) with the casters the
+// light found for it this frame
+void CScene::RenderDepthBufferFromLightFace(int lightIndex, int face)
+{
+	mD3DContext->VSSetConstantBuffers(0, 1, mPerFrameConstantBuffer.GetAddressOf());
+	mD3DContext->PSSetConstantBuffers(0, 1, mPerFrameConstantBuffer.GetAddressOf());
+
+	// Same depth-only shaders and states as spot lights
+	mD3DContext->VSSetShader(mBasicPixel, nullptr, 0);
+	mD3DContext->PSSetShader(NULL, NULL, 0);
+	mD3DContext->OMSetBlendState(mNoBlendingState, nullptr, 0xffffff);
+	mD3DContext->OMSetDepthStencilState(mUseDepthBufferState, 0);
+	mD3DContext->RSSetState(mCullBackState);
+
+	mLights[lightIndex]->RenderShadowFace(face, mPerFrameConstants, mPerFrameConstantBuffer.Get(), mD3DContext);
 }
 
 void CScene::ReleaseResources()
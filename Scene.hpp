@@ -8,6 +8,14 @@
 
 #include "IScene.hpp"
 #include "CParticleSystem.hpp"
+#include "COcclusionCuller.hpp"
+#include "ShadowCache.hpp"
+#include "ShadowScheduler.hpp"
+#include "ShadowAtlas.hpp"
+#include "CRenderQueue.hpp"
+#include "InstanceBuffer.hpp"
+#include "StaticGeometry.hpp"
+#include "StateContext.hpp"
 #include <cmath>
 #include <SpriteBatch.h>
 #include <SpriteFont.h>
@@ -53,16 +61,30 @@ public:
 	ID3D11DepthStencilState* GetDepthReadOnlyState() { return mDepthReadOnlyState; }
 	ID3D11SamplerState* GetPointSampler()			 { return mPointSampler; }
 	ID3D11SamplerState* GetAnisotropic4xSampler()	 { return mAnisotropic4xSampler; }
+	unsigned int GetVisibleModelCount()				 { return mNumVisibleModels; }
+	unsigned int GetCulledModelCount()				 { return mNumCulledModels; }
+	unsigned int GetOccludedModelCount()			 { return mOcclusionCuller.Stats().numOccluded; }
+	float GetOcclusionTime()						 { return mOcclusionCuller.Stats().rasterisationTime; }
+	unsigned int GetShadowCasterCount(int lightIndex)
+	{
+		return lightIndex < static_cast<int>(mShadowMaps.size()) ? static_cast<unsigned int>(mShadowMaps[lightIndex].casters.size()) : 0;
+	}
+	const SShadowSchedulerStats& GetShadowSchedulerStats() { return mShadowScheduler.GetStats(); }
+	const maths::SAtlasStats& GetShadowAtlasStats()		 { return mShadowAtlas.GetStats(); }
+	const maths::SRenderQueueStats& GetRenderQueueStats() { return mRenderQueueStats; }
+	const SStaticGeometryStats& GetStaticGeometryStats() { return mStaticGeometry.GetStats(); }
 
 
 	//Setters
 	void SetFrameConstants(PerFrameConstants& constants) { mPerFrameConstants = constants; } 
 	void SetDayNight(float& dayNight) { mPerFrameConstants.dayNightCycle = dayNight; }
+	void SetShadowBudget(unsigned int maxUpdates, unsigned int maxDrawCalls) { mShadowScheduler.SetBudget(maxUpdates, maxDrawCalls); }
 //---------------------------------------
 //Operational Methods
 //---------------------------------------
 	bool InitGeometry();
 	bool InitScene();
+	bool BuildStaticGeometry(const std::vector<IModel*>& models);
 	bool CreateStates();
 	void RenderSceneFromCamera();
 	void RenderScene(float& frameTime);
@@ -70,7 +92,10 @@ public:
 	void RenderLights(std::vector<ILight*> lights);
 	void RenderShadow(D3D11_VIEWPORT& vp);
 	void UpdateScene(float frameTime);
+	void UpdateShadowMaps();
+	void FindShadowCasters(int lightIndex);
 	void RenderDepthBufferFromLight(int lightIndex);
+	void RenderDepthBufferFromLightFace(int lightIndex, int face);
 	void ReleaseResources();
 
 private:
@@ -82,6 +107,51 @@ private:
 
 	float mTotalTime = 0.0f;
 
+	// Frustum culling results from the last call to RenderModels. The visible list is kept to reuse its memory
+	std::vector<IModel*> mVisibleModels;
+	maths::CRenderQueue mRenderQueue; // Draws for mVisibleModels sorted by state and depth, see RenderModels
+	maths::SRenderQueueStats mRenderQueueStats;
+
+	// Instancing - runs of at least MinInstances queued models with the same state and mesh are drawn in one call
+	// per sub-mesh, with their world matrices in the instance buffer. Only for models using main_vs
+	static const size_t MinInstances = 2;
+	CInstanceBuffer mInstanceBuffer;
+	ID3D11VertexShader* mMainVS = nullptr;      // Shared main_vs, see LoadSharedVertexShader
+	ID3D11VertexShader* mInstancedVS = nullptr; // Instanced version of main_vs, no instancing if it failed to load
+	std::vector<IModel*> mInstancedModels;     // Working memory for RenderModels
+	unsigned int mNumVisibleModels = 0;
+	unsigned int mNumCulledModels = 0;
+
+	// Models marked static, merged into a few large batches by material and chunk. Drawn in the main pass instead
+	// of the models themselves, which are still used for shadows and occlusion
+	CStaticGeometry mStaticGeometry;
+
+	// Occlusion culling, models marked as occluders are rasterised on the CPU to hide the models behind them
+	maths::COcclusionCuller mOcclusionCuller;
+
+	// Shadow map of each spot light, indexed by light. Point and directional lights keep their own cube faces or
+	// cascades (see ILight)
+	struct SShadowMap
+	{
+		std::vector<IModel*> casters;          // Models whose shadow can reach the camera's view, from FindShadowCasters
+		maths::CMatrix4x4    viewMatrix;       // Light matrices for the casters above
+		maths::CMatrix4x4    projectionMatrix;
+		CShadowCache         cache;            // What the map was last rendered with
+
+		// Matrices the map was last rendered with. Updates can be put off for a few frames, so the main pass
+		// samples the map with these rather than the light's current matrices
+		bool                 rendered = false;
+		maths::CMatrix4x4    renderedViewMatrix;
+		maths::CMatrix4x4    renderedProjectionMatrix;
+	};
+	std::vector<SShadowMap> mShadowMaps;
+	std::vector<int> mShadowingLights = { 0 }; // Lights with shadow maps. Spot, directional and the first few point
+	                                           // lights are added in RenderLights, all below PerFrameConstants::MAX_LIGHTS
+	CShadowScheduler mShadowScheduler;         // Limits the shadow maps / cube faces rendered each frame
+	CShadowAtlas     mShadowAtlas;             // Holds the shadow maps of all spot lights, sized by their screen size
+	float mMaxShadowResolution = 2048.0f;      // Largest shadow map tile a spot light can have
+	float mShadowDistance = 10000.0f; // Far clip of the shadow maps, shadows are not cast further than this
+
 	//Raw pointers "observers"
 	IEngine* mEngine;
 	std::vector<IModel*> allModels;
@@ -98,7 +168,7 @@ private:
 	Microsoft::WRL::ComPtr<ID3D11Buffer> mPerFrameConstantBuffer = nullptr; // This variable controls the GPU-side constant buffer matching to the above structure
 	Microsoft::WRL::ComPtr<ID3D11Buffer>   mPerModelConstantBuffer = nullptr;  // This variable controls the GPU-side constant buffer related to the above structure
 	ID3D11RenderTargetView* mBackBufferRenderTarget = nullptr;
-	CComPtr<ID3D11DeviceContext> mD3DContext = nullptr;
+	CStateContext* mD3DContext = nullptr; // Owned by the engine, filters out state changes that change nothing
 	CComPtr<ID3D11Device> mD3DDevice = nullptr;
 
 	CComPtr<ID3D11Texture2D> mCubicShadowTexture = nullptr;
@@ -6,6 +6,7 @@
 #include "Shader.hpp"
 #include <fstream>
 #include <vector>
+#include <map>
 #include <d3dcompiler.h>
 
 #include "DirectX11Engine.hpp"
@@ -122,6 +123,39 @@ ID3D11PixelShader* LoadPixelShader(std::string shaderName, IEngine * engine)
 	return shader;
 }
 
+// Shaders loaded by LoadSharedVertexShader / LoadSharedPixelShader by name. The maps hold a reference to each shader
+// for the life of the app
+namespace
+{
+	std::map<std::string, ID3D11VertexShader*> sharedVertexShaders;
+	std::map<std::string, ID3D11PixelShader*>  sharedPixelShaders;
+
+	// Return the shader of the given name from the map, loading it on first use. Adds a reference for the caller
+	template <class Shader, class Loader>
+	Shader* LoadShared(std::map<std::string, Shader*>& shaders, const std::string& shaderName, IEngine* engine, Loader load)
+	{
+		auto found = shaders.find(shaderName);
+		if (found == shaders.end())
+		{
+			Shader* shader = load(shaderName, engine);
+			if (shader == nullptr)  return nullptr;
+			found = shaders.emplace(shaderName, shader).first;
+		}
+		found->second->AddRef();
+		return found->second;
+	}
+}
+
+ID3D11VertexShader* LoadSharedVertexShader(const std::string& shaderName, IEngine * engine)
+{
+	return LoadShared(sharedVertexShaders, shaderName, engine, LoadVertexShader);
+}
+
+ID3D11PixelShader* LoadSharedPixelShader(const std::string& shaderName, IEngine * engine)
+{
+	return LoadShared(sharedPixelShaders, shaderName, engine, LoadPixelShader);
+}
+
 // Very advanced topic: When creating a vertex layout for geometry (see Scene.cpp), you need the signature
 // (bytecode) of a shader that uses that vertex layout. This is an annoying requirement and tends to create
 // unnecessary coupling between shaders and vertex buffers.
@@ -31,6 +31,12 @@ ID3D11VertexShader* LoadVertexShader(std::string shaderName, IEngine * engine);
 ID3D11PixelShader*  LoadPixelShader(std::string shaderName, IEngine * engine);
 ID3D11GeometryShader* LoadGeometryShader(std::string shaderName, IEngine * engine);
 
+// As above, but every call with the same name returns the same shader object, loaded on the first call. Models using
+// the same shader files then have the same shaders, so they can be drawn together (see CRenderQueue). Each call
+// adds a reference, release the returned pointer as above. Returns nullptr on failure
+ID3D11VertexShader* LoadSharedVertexShader(const std::string& shaderName, IEngine * engine);
+ID3D11PixelShader*  LoadSharedPixelShader(const std::string& shaderName, IEngine * engine);
+
 // Helper function. Returns nullptr on failure.
 ID3DBlob* CreateSignatureForVertexLayout(const D3D11_INPUT_ELEMENT_DESC vertexLayout[], int numElements);
 
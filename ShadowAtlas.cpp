@@ -0,0 +1,142 @@
+#include "ShadowAtlas.hpp"
+#include "Shader.hpp"
+#include "DirectX11Engine.hpp"
+
+#include <algorithm>
+
+namespace umbra_engine
+{
+
+CShadowAtlas::~CShadowAtlas()
+{
+	if (mTexture) mTexture->Release();
+	if (mDepthStencil) mDepthStencil->Release();
+	if (mSRV) mSRV->Release();
+	if (mClearShader) mClearShader->Release();
+	if (mClearDepthState) mClearDepthState->Release();
+	if (mClearRasterState) mClearRasterState->Release();
+}
+
+// Create the depth texture and the resources used to clear tiles
+bool CShadowAtlas::Init(IEngine* engine)
+{
+	ID3D11Device* device = engine->GetDevice();
+
+	// Same formats as the single shadow maps (see Light::ShadowDepthBuffer)
+	D3D11_TEXTURE2D_DESC textureDesc = {};
+	textureDesc.Width = mAllocator.Size();
+	textureDesc.Height = mAllocator.Size();
+	textureDesc.MipLevels = 1;
+	textureDesc.ArraySize = 1;
+	textureDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+	textureDesc.SampleDesc.Count = 1;
+	textureDesc.SampleDesc.Quality = 0;
+	textureDesc.Usage = D3D11_USAGE_DEFAULT;
+	textureDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL | D3D11_BIND_SHADER_RESOURCE;
+	if (FAILED(device->CreateTexture2D(&textureDesc, NULL, &mTexture)))
+	{
+		return false;
+	}
+
+	D3D11_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
+	dsvDesc.Format = DXGI_FORMAT_D32_FLOAT;
+	dsvDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
+	dsvDesc.Texture2D.MipSlice = 0;
+	if (FAILED(device->CreateDepthStencilView(mTexture, &dsvDesc, &mDepthStencil)))
+	{
+		return false;
+	}
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = DXGI_FORMAT_R32_FLOAT;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+	srvDesc.Texture2D.MostDetailedMip = 0;
+	srvDesc.Texture2D.MipLevels = 1;
+	if (FAILED(device->CreateShaderResourceView(mTexture, &srvDesc, &mSRV)))
+	{
+		return false;
+	}
+
+	// Tile clearing: the triangle is at the far distance and must overwrite whatever depth is there
+	mClearShader = LoadVertexShader("ShadowTileClear_vs", engine);
+	if (mClearShader == nullptr)
+	{
+		return false;
+	}
+
+	D3D11_DEPTH_STENCIL_DESC depthDesc = {};
+	depthDesc.DepthEnable = TRUE;
+	depthDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ALL;
+	depthDesc.DepthFunc = D3D11_COMPARISON_ALWAYS;
+	depthDesc.StencilEnable = FALSE;
+	if (FAILED(device->CreateDepthStencilState(&depthDesc, &mClearDepthState)))
+	{
+		return false;
+	}
+
+	D3D11_RASTERIZER_DESC rasterDesc = {};
+	rasterDesc.FillMode = D3D11_FILL_SOLID;
+	rasterDesc.CullMode = D3D11_CULL_NONE;
+	rasterDesc.DepthClipEnable = TRUE;
+	if (FAILED(device->CreateRasterizerState(&rasterDesc, &mClearRasterState)))
+	{
+		return false;
+	}
+
+	// Nothing has been rendered, start with the whole atlas at the far distance
+	engine->GetStateContext()->ClearDepthStencilView(mDepthStencil, D3D11_CLEAR_DEPTH, 1.0f, 0);
+	return true;
+}
+
+// UV offset and scale of the light's tile
+maths::CVector4 CShadowAtlas::TileUVRect(int light) const
+{
+	maths::SAtlasTile tile;
+	if (!mAllocator.GetTile(light, tile)) return { 0, 0, 0, 0 };
+
+	float size = static_cast<float>(mAllocator.Size());
+	return { tile.x / size, tile.y / size, tile.size / size, tile.size / size };
+}
+
+// Select the light's tile as the depth buffer and viewport, and clear it
+void CShadowAtlas::BeginTile(int light, CStateContext* context)
+{
+	maths::SAtlasTile tile;
+	if (!mAllocator.GetTile(light, tile)) return;
+
+	D3D11_VIEWPORT vp = {};
+	vp.TopLeftX = static_cast<FLOAT>(tile.x);
+	vp.TopLeftY = static_cast<FLOAT>(tile.y);
+	vp.Width = static_cast<FLOAT>(tile.size);
+	vp.Height = static_cast<FLOAT>(tile.size);
+	vp.MinDepth = 0.0f;
+	vp.MaxDepth = 1.0f;
+	context->RSSetViewports(1, &vp);
+	context->OMSetRenderTargets(0, nullptr, mDepthStencil);
+
+	// The clearing shader makes the triangle from the vertex number, no vertex buffer is needed
+	context->IASetInputLayout(nullptr);
+	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	context->VSSetShader(mClearShader, nullptr, 0);
+	context->PSSetShader(nullptr, nullptr, 0);
+	context->OMSetDepthStencilState(mClearDepthState, 0);
+	context->RSSetState(mClearRasterState);
+	context->Draw(3, 0);
+}
+
+// Resolution for the shadow map of casters seen from the view point
+float CShadowAtlas::ShadowResolution(const maths::CAABB& casterBounds, const maths::CVector3& viewPoint, float screenHeight,
+	float tanHalfFOVy, float maxResolution)
+{
+	if (casterBounds.IsEmpty()) return 0.0f;
+
+	// Projected diameter of the casters' bounding sphere in pixels. A viewer inside the sphere sees it fill the
+	// screen, so it gets the full resolution
+	maths::CSphere sphere = maths::SphereFromAABB(casterBounds);
+	float distance = maths::Length(sphere.centre - viewPoint);
+	if (distance <= sphere.radius) return maxResolution;
+	float pixels = screenHeight * sphere.radius / (distance * tanHalfFOVy);
+	return std::min(pixels, maxResolution);
+}
+
+}//Namespace
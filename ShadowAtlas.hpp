@@ -0,0 +1,100 @@
+#ifndef _SHADOW_ATLAS_H_
+#define _SHADOW_ATLAS_H_
+//======================================================================================
+
+//--------------------------------------------------------------------------------------
+// One large depth texture shared by the shadow maps of many lights
+//--------------------------------------------------------------------------------------
+// Each frame every shadowing light asks for a tile with the resolution its shadows deserve (see ShadowResolution),
+// and the atlas hands out square tiles of the texture (see maths::CQuadtreeAtlas). Lights keep the same tile
+// while their resolution stays about the same, so cached shadow maps stay valid. Memory is fixed however many
+// lights there are: when the atlas is full, lights get smaller tiles or none
+// Tiles are rendered through their own viewport and cleared on their own, leaving the rest of the atlas alone.
+// Shaders sample a tile through a UV offset and scale (see TileUVRect)
+
+#include "Common.hpp"
+#include "Geometry.hpp"
+#include "CQuadtreeAtlas.hpp"
+
+//======================================================================================
+namespace umbra_engine
+{
+//---------------------------------------
+// Class Forward Declarations
+//---------------------------------------
+class IEngine;
+class CStateContext;
+
+class CShadowAtlas
+{
+public:
+//---------------------------------------
+// Constructors / Destructors
+//---------------------------------------
+	// Atlas size and smallest tile in texels, powers of two. Call Init before use
+	CShadowAtlas(int size = 4096, int minTileSize = 128) : mAllocator(size, minTileSize) {}
+	~CShadowAtlas();
+
+	// Owns GPU resources, so no copying
+	CShadowAtlas(const CShadowAtlas&) = delete;
+	CShadowAtlas& operator=(const CShadowAtlas&) = delete;
+
+	// Create the depth texture and the resources used to clear tiles. Returns false on failure
+	bool Init(IEngine* engine);
+
+//---------------------------------------
+// Data Access
+//---------------------------------------
+	ID3D11ShaderResourceView* GetSRV() { return mSRV; }
+	int GetSize() { return mAllocator.Size(); }
+	const maths::SAtlasStats& GetStats() const { return mAllocator.Stats(); }
+
+	// True if the light has a tile this frame
+	bool HasTile(int light) const { maths::SAtlasTile tile; return mAllocator.GetTile(light, tile); }
+
+	// True if the light's tile is new this frame, so its contents are not its shadow map
+	bool TileChanged(int light) const { return mAllocator.TileChanged(light); }
+
+	// UV offset (x, y) and scale (z, w) of the light's tile within the atlas, all 0 if it has none
+	maths::CVector4 TileUVRect(int light) const;
+
+//---------------------------------------
+// Operational Methods
+//---------------------------------------
+	// Start collecting requests for a new frame
+	void BeginFrame() { mAllocator.BeginFrame(); }
+
+	// Ask for a tile for a light, with the resolution it would ideally have
+	void Request(int light, float idealResolution) { mAllocator.Request(light, idealResolution); }
+
+	// Give tiles to the lights requested since BeginFrame. Lights not requested lose their tiles
+	void Allocate() { mAllocator.Allocate(); }
+
+	// Select the light's tile as the depth buffer and viewport, and clear it to the far distance. Leaves the tile
+	// clearing shader and states set, so set the shadow rendering shaders and states afterwards
+	void BeginTile(int light, CStateContext* context);
+
+	// Resolution for the shadow map of casters with the given bounds seen from the view point: their size in pixels
+	// on a screen of the given height, for a camera with the given tan(FOVy / 2). Clamped to maxResolution
+	static float ShadowResolution(const maths::CAABB& casterBounds, const maths::CVector3& viewPoint, float screenHeight,
+		float tanHalfFOVy, float maxResolution);
+
+private:
+//---------------------------------------
+// Private Member Variables
+//---------------------------------------
+	maths::CQuadtreeAtlas mAllocator;
+
+	ID3D11Texture2D*          mTexture = nullptr;
+	ID3D11DepthStencilView*   mDepthStencil = nullptr;
+	ID3D11ShaderResourceView* mSRV = nullptr;
+
+	// D3D can only clear a whole depth buffer, so tiles are cleared by drawing a triangle over the tile's
+	// viewport at the far distance
+	ID3D11VertexShader*      mClearShader = nullptr;
+	ID3D11DepthStencilState* mClearDepthState = nullptr;
+	ID3D11RasterizerState*   mClearRasterState = nullptr;
+};//Class
+}//Namespace
+//======================================================================================
+#endif//Header Guard
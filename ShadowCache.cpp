@@ -0,0 +1,15 @@
+#include "ShadowCache.hpp"
+
+#include <cstring>
+
+namespace umbra_engine
+{
+
+// Return true if the matrix differs from the one last rendered with
+bool CShadowCache::MatrixChanged(const maths::CMatrix4x4& viewProjection) const
+{
+	// Matrices are compared exactly, a light that hasn't moved produces exactly the same matrix each frame
+	return std::memcmp(&viewProjection, &mViewProjection, sizeof(mViewProjection)) != 0;
+}
+
+}//Namespace
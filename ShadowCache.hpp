@@ -0,0 +1,75 @@
+#ifndef _SHADOW_CACHE_H_
+#define _SHADOW_CACHE_H_
+//======================================================================================
+
+//--------------------------------------------------------------------------------------
+// Tracks what was last rendered into a shadow map, so it is only rendered again when it would change
+//--------------------------------------------------------------------------------------
+// A shadow map depends on the light's view-projection matrix and on the casters drawn into it. Each caster is
+// recorded with its revision (see IModel::GetRevision), so a caster moving, or a model arriving in or leaving the
+// caster list, makes the map out of date. Lights that don't move, with nothing moving near them, keep their map
+// Caster lists come from spatial queries, which can return the same models in a different order from one frame
+// to the next, so they are compared as sets. A list must not hold the same caster twice
+
+#include "CMatrix4x4.hpp"
+#include <vector>
+#include <unordered_map>
+
+//======================================================================================
+namespace umbra_engine
+{
+class CShadowCache
+{
+public:
+//---------------------------------------
+// Operational Methods
+//---------------------------------------
+	// Return true if a shadow map rendered from the given matrix with the given casters would differ from the one
+	// last rendered, or nothing has been rendered yet. Casters are models, or anything with a GetRevision method
+	template <typename TCaster>
+	bool IsOutOfDate(const maths::CMatrix4x4& viewProjection, const std::vector<TCaster*>& casters) const
+	{
+		if (!mValid || MatrixChanged(viewProjection) || casters.size() != mCasters.size()) return true;
+
+		// With no repeats, the same number of casters all found with their revisions means the same set
+		for (auto caster : casters)
+		{
+			auto recorded = mCasters.find(caster);
+			if (recorded == mCasters.end() || recorded->second != caster->GetRevision()) return true;
+		}
+		return false;
+	}
+
+	// Record the state a shadow map has just been rendered with
+	template <typename TCaster>
+	void MarkRendered(const maths::CMatrix4x4& viewProjection, const std::vector<TCaster*>& casters)
+	{
+		mValid = true;
+		mViewProjection = viewProjection;
+		mCasters.clear();
+		for (auto caster : casters)
+		{
+			mCasters[caster] = caster->GetRevision();
+		}
+	}
+
+	// Make the shadow map out of date whatever it is compared with, e.g. after it has been cleared elsewhere
+	void Invalidate() { mValid = false; }
+
+private:
+//---------------------------------------
+// Private Member Methods
+//---------------------------------------
+	// Return true if the matrix differs from the one last rendered with
+	bool MatrixChanged(const maths::CMatrix4x4& viewProjection) const;
+
+//---------------------------------------
+// Private Member Variables
+//---------------------------------------
+	bool mValid = false;
+	maths::CMatrix4x4 mViewProjection;
+	std::unordered_map<const void*, unsigned int> mCasters; // Each caster with its revision when last rendered
+};//Class
+}//Namespace
+//======================================================================================
+#endif//Header Guard
@@ -0,0 +1,72 @@
+#include "ShadowScheduler.hpp"
+
+#include <algorithm>
+
+namespace umbra_engine
+{
+
+// Start collecting requests for a new frame
+void CShadowScheduler::BeginFrame()
+{
+	mRequests.clear();
+	mScheduled.clear();
+	mStats = SShadowSchedulerStats();
+}
+
+// Request an update for an out of date shadow map / face
+void CShadowScheduler::Request(int light, int face, float contribution, unsigned int drawCalls)
+{
+	auto waiting = mWaiting.find({ light, face });
+	unsigned int wait = (waiting != mWaiting.end()) ? waiting->second : 0;
+
+	// Each frame waiting adds to the priority, so anything left waiting soon beats even shadows covering the
+	// whole screen (contribution 1), and updates that keep missing the budget take turns
+	float priority = contribution + wait * WaitPriority;
+	mRequests.push_back({ { light, face }, priority, drawCalls, wait });
+	++mStats.numRequested;
+}
+
+// Pick the updates to render this frame, highest priority first
+const std::vector<SShadowUpdate>& CShadowScheduler::Schedule()
+{
+	std::stable_sort(mRequests.begin(), mRequests.end(), [](const SRequest& a, const SRequest& b)
+	{
+		return a.priority > b.priority;
+	});
+
+	// Fill the budget in priority order. An update that doesn't fit the draw call budget is passed over, a
+	// smaller one further down may still fit
+	std::map<std::pair<int, int>, unsigned int> waiting;
+	for (const auto& request : mRequests)
+	{
+		bool fits = (mMaxUpdates == 0 || mScheduled.size() < mMaxUpdates) &&
+		            (mMaxDrawCalls == 0 || mScheduled.empty() || mStats.numDrawCalls + request.drawCalls <= mMaxDrawCalls);
+		if (fits)
+		{
+			mScheduled.push_back(request.update);
+			mStats.numDrawCalls += request.drawCalls;
+		}
+		else
+		{
+			waiting[{ request.update.light, request.update.face }] = request.wait + 1;
+			++mStats.numDeferred;
+		}
+		mStats.maxWait = std::max(mStats.maxWait, request.wait);
+	}
+	mWaiting.swap(waiting);
+
+	mStats.numScheduled = static_cast<unsigned int>(mScheduled.size());
+	return mScheduled;
+}
+
+// Rough fraction of the screen covered by a box seen from the given point
+float CShadowScheduler::ScreenContribution(const maths::CAABB& bounds, const maths::CVector3& viewPoint)
+{
+	if (bounds.IsEmpty()) return 0.0f;
+	maths::CSphere sphere = maths::SphereFromAABB(bounds);
+	float distance = maths::Length(sphere.centre - viewPoint);
+	if (distance <= sphere.radius) return 1.0f;
+	return sphere.radius / distance;
+}
+
+}//Namespace
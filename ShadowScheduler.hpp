@@ -0,0 +1,109 @@
+#ifndef _SHADOW_SCHEDULER_H_
+#define _SHADOW_SCHEDULER_H_
+//======================================================================================
+
+//--------------------------------------------------------------------------------------
+// Spreads shadow map updates over several frames to keep within a per-frame budget
+//--------------------------------------------------------------------------------------
+// Each frame the scene requests an update for every shadow map (or point light cube face) that is out of date,
+// then renders the ones Schedule picks. Updates are ordered by how much of the screen their shadows could cover,
+// plus a little for each frame they have been waiting, so small or distant shadows are not put off forever -
+// updates that don't fit the budget come round again in later frames
+// No graphics API is used, the caller does the rendering
+
+#include "Geometry.hpp"
+#include <vector>
+#include <map>
+#include <utility>
+
+//======================================================================================
+namespace umbra_engine
+{
+//---------------------------------------
+// Structures
+//---------------------------------------
+// A shadow map to render this frame. Face is 0 for lights with a single shadow map, 0-5 for point light cube faces
+struct SShadowUpdate
+{
+	int light;
+	int face;
+};
+
+// Scheduling for the last frame
+struct SShadowSchedulerStats
+{
+	unsigned int numRequested = 0; // Out of date shadow maps / faces
+	unsigned int numScheduled = 0; // Picked to render this frame
+	unsigned int numDeferred  = 0; // Left for later frames
+	unsigned int numDrawCalls = 0; // Casters in the scheduled updates
+	unsigned int maxWait      = 0; // Frames the longest waiting update has been out of date
+};
+
+class CShadowScheduler
+{
+public:
+//---------------------------------------
+// Constructors
+//---------------------------------------
+	// Budget per frame: the most shadow maps / cube faces to render, and the most casters to draw across them.
+	// 0 means no limit. At least one update is scheduled each frame if any are requested, however large
+	CShadowScheduler(unsigned int maxUpdates = 2, unsigned int maxDrawCalls = 0)
+		: mMaxUpdates(maxUpdates), mMaxDrawCalls(maxDrawCalls) {}
+
+//---------------------------------------
+// Data Access
+//---------------------------------------
+	void SetBudget(unsigned int maxUpdates, unsigned int maxDrawCalls) { mMaxUpdates = maxUpdates; mMaxDrawCalls = maxDrawCalls; }
+	unsigned int GetMaxUpdates() { return mMaxUpdates; }
+	unsigned int GetMaxDrawCalls() { return mMaxDrawCalls; }
+	const SShadowSchedulerStats& GetStats() const { return mStats; }
+
+//---------------------------------------
+// Operational Methods
+//---------------------------------------
+	// Start collecting requests for a new frame
+	void BeginFrame();
+
+	// Request an update for an out of date shadow map / face. Contribution is how much of the screen its
+	// shadows could cover (see ScreenContribution), drawCalls the number of casters it would draw
+	void Request(int light, int face, float contribution, unsigned int drawCalls);
+
+	// Pick the updates to render this frame from the requests since BeginFrame, highest priority first
+	const std::vector<SShadowUpdate>& Schedule();
+
+	// Rough fraction of the screen covered by a box seen from the given point - the box's bounding sphere
+	// radius over its distance, 1 if the point is inside the sphere. 0 for an empty box
+	static float ScreenContribution(const maths::CAABB& bounds, const maths::CVector3& viewPoint);
+
+private:
+//---------------------------------------
+// Private Types
+//---------------------------------------
+	struct SRequest
+	{
+		SShadowUpdate update;
+		float         priority;
+		unsigned int  drawCalls;
+		unsigned int  wait;
+	};
+
+//---------------------------------------
+// Private Member Variables
+//---------------------------------------
+	static constexpr float WaitPriority = 0.1f; // Priority added per frame waiting, contributions are 0 to 1
+
+	unsigned int mMaxUpdates;
+	unsigned int mMaxDrawCalls;
+
+	std::vector<SRequest>      mRequests;
+	std::vector<SShadowUpdate> mScheduled;
+
+	// Frames each deferred update has been waiting, by (light, face). Entries are dropped when an update is
+	// rendered or is no longer requested (e.g. its casters moved back to how they were)
+	std::map<std::pair<int, int>, unsigned int> mWaiting;
+
+	SShadowSchedulerStats mStats;
+};//Class
+}//Namespace
+//======================================================================================
+#endif//Header Guard
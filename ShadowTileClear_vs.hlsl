@@ -0,0 +1,12 @@
+//--------------------------------------------------------------------------------------
+// Shadow atlas tile clearing vertex shader
+//--------------------------------------------------------------------------------------
+// D3D can only clear a whole depth buffer, so a tile of the shadow atlas is cleared by drawing one triangle over
+// its viewport at the far distance (see ShadowAtlas.cpp). No vertex buffer, the corners come from the vertex number
+
+float4 main(uint vertexId : SV_VertexID) : SV_Position
+{
+    // Vertices 0, 1, 2 give (-1, -1), (3, -1), (-1, 3) - a triangle covering the whole viewport
+    float2 position = float2((vertexId << 1) & 2, vertexId & 2) * 2.0f - 1.0f;
+    return float4(position, 1.0f, 1.0f);
+}
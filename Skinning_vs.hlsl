@@ -0,0 +1,38 @@
+//--------------------------------------------------------------------------------------
+// Skinning version of main_vs - linear blend of the bone matrices in gBoneMatrices
+//--------------------------------------------------------------------------------------
+
+#include "Common.hlsli"
+
+
+//--------------------------------------------------------------------------------------
+// Shader code
+//--------------------------------------------------------------------------------------
+
+// Same as main_vs but each vertex is first moved by a weighted blend of its bones. The bones are in model space, so
+// gWorldMatrix is applied afterwards as for a rigid model. Used by models with ESkinning::Matrices (see Model::SetSkinning)
+NormalMappingPixelShaderInput main(SkinningVertex modelVertex)
+{
+    NormalMappingPixelShaderInput output;
+
+    // Constant buffer matrices arrive transposed, so they are on the left as in main_vs
+    float4x4 boneMatrix = gBoneMatrices[modelVertex.bones.x] * modelVertex.weights.x +
+                          gBoneMatrices[modelVertex.bones.y] * modelVertex.weights.y +
+                          gBoneMatrices[modelVertex.bones.z] * modelVertex.weights.z +
+                          gBoneMatrices[modelVertex.bones.w] * modelVertex.weights.w;
+
+    float4 modelPosition = mul(boneMatrix, float4(modelVertex.position, 1.0f));
+    float4 worldPosition = mul(gWorldMatrix, modelPosition);
+    float4 viewPosition = mul(gViewMatrix, worldPosition);
+    output.projectedPosition = mul(gProjectionMatrix, viewPosition);
+
+    output.worldPosition = worldPosition.xyz;
+
+    // Normals and tangents stay in model space for the pixel shader, which normalises them
+    output.modelNormal = mul(boneMatrix, float4(modelVertex.normal, 0.0f)).xyz;
+    output.modelTangent = mul(boneMatrix, float4(modelVertex.tangent, 0.0f)).xyz;
+
+    output.uv = modelVertex.uv;
+
+    return output;
+}
@@ -0,0 +1,211 @@
+#include "StateContext.hpp"
+
+namespace umbra_engine
+{
+
+// Start a new frame
+void CStateContext::NewFrame()
+{
+	mLastFrameStats = mStats;
+	mStats = SStateContextStats();
+
+	// Anything outside the engine (sprite batches, the GUI) may have changed state since the last frame
+	Invalidate();
+}
+
+// Forget what is bound
+void CStateContext::Invalidate()
+{
+	mVertexShader.known = false;
+	mGeometryShader.known = false;
+	mPixelShader.known = false;
+	for (auto& slot : mVSConstantBuffers) slot.known = false;
+	for (auto& slot : mGSConstantBuffers) slot.known = false;
+	for (auto& slot : mPSConstantBuffers) slot.known = false;
+	for (auto& slot : mPSShaderResources) slot.known = false;
+	for (auto& slot : mPSSamplers)        slot.known = false;
+	mBlendState.known = false;
+	mDepthStencilState.known = false;
+	mRasterizerState.known = false;
+	mInputLayout.known = false;
+	for (auto& slot : mVertexBuffers) slot.known = false;
+	mIndexBuffer.known = false;
+	mTopology.known = false;
+}
+
+// Reset all the context's state
+void CStateContext::ClearState()
+{
+	mContext->ClearState();
+	Invalidate();
+}
+
+
+//--------------------------------------------------------------------------------------
+// Filtering
+//--------------------------------------------------------------------------------------
+
+// Record new values for a range of slots
+template <typename T, size_t N>
+bool CStateContext::UpdateSlots(STracked<T> (&slots)[N], UINT startSlot, UINT count, const T* values)
+{
+	// Untracked slots can't be compared, forget the tracked part of the range and let the call through
+	if (startSlot + count > N)
+	{
+		for (UINT slot = startSlot; slot < N; ++slot) slots[slot].known = false;
+		return true;
+	}
+
+	// A call that goes through binds the whole range, so every slot is updated
+	bool changed = false;
+	for (UINT i = 0; i < count; ++i)
+	{
+		if (slots[startSlot + i].Update(values[i])) changed = true;
+	}
+	return changed;
+}
+
+// Count a call
+bool CStateContext::Issue(bool changed)
+{
+	if (changed) ++mStats.numIssued;
+	else         ++mStats.numFiltered;
+	return changed;
+}
+
+bool CStateContext::SBlendBinding::operator==(const SBlendBinding& other) const
+{
+	return state == other.state && sampleMask == other.sampleMask && factor[0] == other.factor[0] &&
+	       factor[1] == other.factor[1] && factor[2] == other.factor[2] && factor[3] == other.factor[3];
+}
+
+
+//--------------------------------------------------------------------------------------
+// Shaders
+//--------------------------------------------------------------------------------------
+
+// Class instances aren't tracked, shaders using them are always set and leave the shader unknown
+void CStateContext::VSSetShader(ID3D11VertexShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances)
+{
+	bool changed = (numClassInstances > 0) ? true : mVertexShader.Update(shader);
+	if (numClassInstances > 0) mVertexShader.known = false;
+	if (Issue(changed)) mContext->VSSetShader(shader, classInstances, numClassInstances);
+}
+
+void CStateContext::GSSetShader(ID3D11GeometryShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances)
+{
+	bool changed = (numClassInstances > 0) ? true : mGeometryShader.Update(shader);
+	if (numClassInstances > 0) mGeometryShader.known = false;
+	if (Issue(changed)) mContext->GSSetShader(shader, classInstances, numClassInstances);
+}
+
+void CStateContext::PSSetShader(ID3D11PixelShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances)
+{
+	bool changed = (numClassInstances > 0) ? true : mPixelShader.Update(shader);
+	if (numClassInstances > 0) mPixelShader.known = false;
+	if (Issue(changed)) mContext->PSSetShader(shader, classInstances, numClassInstances);
+}
+
+
+//--------------------------------------------------------------------------------------
+// Shader resources
+//--------------------------------------------------------------------------------------
+
+void CStateContext::VSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers)
+{
+	if (Issue(UpdateSlots(mVSConstantBuffers, startSlot, numBuffers, buffers))) mContext->VSSetConstantBuffers(startSlot, numBuffers, buffers);
+}
+
+void CStateContext::GSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers)
+{
+	if (Issue(UpdateSlots(mGSConstantBuffers, startSlot, numBuffers, buffers))) mContext->GSSetConstantBuffers(startSlot, numBuffers, buffers);
+}
+
+void CStateContext::PSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers)
+{
+	if (Issue(UpdateSlots(mPSConstantBuffers, startSlot, numBuffers, buffers))) mContext->PSSetConstantBuffers(startSlot, numBuffers, buffers);
+}
+
+void CStateContext::PSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views)
+{
+	if (Issue(UpdateSlots(mPSShaderResources, startSlot, numViews, views))) mContext->PSSetShaderResources(startSlot, numViews, views);
+}
+
+void CStateContext::PSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers)
+{
+	if (Issue(UpdateSlots(mPSSamplers, startSlot, numSamplers, samplers))) mContext->PSSetSamplers(startSlot, numSamplers, samplers);
+}
+
+
+//--------------------------------------------------------------------------------------
+// Output merger / rasterizer
+//--------------------------------------------------------------------------------------
+
+// A null blend factor means 1 for every channel, so compare it as that
+void CStateContext::OMSetBlendState(ID3D11BlendState* state, const FLOAT blendFactor[4], UINT sampleMask)
+{
+	SBlendBinding binding = { state, { 1.0f, 1.0f, 1.0f, 1.0f }, sampleMask };
+	if (blendFactor != nullptr)
+	{
+		for (int i = 0; i < 4; ++i) binding.factor[i] = blendFactor[i];
+	}
+	if (Issue(mBlendState.Update(binding))) mContext->OMSetBlendState(state, blendFactor, sampleMask);
+}
+
+void CStateContext::OMSetDepthStencilState(ID3D11DepthStencilState* state, UINT stencilRef)
+{
+	if (Issue(mDepthStencilState.Update({ state, stencilRef }))) mContext->OMSetDepthStencilState(state, stencilRef);
+}
+
+void CStateContext::RSSetState(ID3D11RasterizerState* state)
+{
+	if (Issue(mRasterizerState.Update(state))) mContext->RSSetState(state);
+}
+
+// Shader resources may have been unbound by the runtime, see header
+void CStateContext::OMSetRenderTargets(UINT numViews, ID3D11RenderTargetView* const* renderTargets, ID3D11DepthStencilView* depthStencil)
+{
+	mContext->OMSetRenderTargets(numViews, renderTargets, depthStencil);
+	for (auto& slot : mPSShaderResources) slot.known = false;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Input assembler
+//--------------------------------------------------------------------------------------
+
+void CStateContext::IASetInputLayout(ID3D11InputLayout* layout)
+{
+	if (Issue(mInputLayout.Update(layout))) mContext->IASetInputLayout(layout);
+}
+
+void CStateContext::IASetVertexBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets)
+{
+	bool changed = true;
+	if (startSlot + numBuffers <= VertexBufferSlots)
+	{
+		SVertexBinding bindings[VertexBufferSlots];
+		for (UINT i = 0; i < numBuffers; ++i)
+		{
+			bindings[i] = { buffers[i], strides[i], offsets[i] };
+		}
+		changed = UpdateSlots(mVertexBuffers, startSlot, numBuffers, bindings);
+	}
+	else
+	{
+		for (UINT slot = startSlot; slot < VertexBufferSlots; ++slot) mVertexBuffers[slot].known = false;
+	}
+	if (Issue(changed)) mContext->IASetVertexBuffers(startSlot, numBuffers, buffers, strides, offsets);
+}
+
+void CStateContext::IASetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset)
+{
+	if (Issue(mIndexBuffer.Update({ buffer, format, offset }))) mContext->IASetIndexBuffer(buffer, format, offset);
+}
+
+void CStateContext::IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology)
+{
+	if (Issue(mTopology.Update(topology))) mContext->IASetPrimitiveTopology(topology);
+}
+
+}
@@ -0,0 +1,202 @@
+#ifndef _STATE_CONTEXT_H_
+#define _STATE_CONTEXT_H_
+//======================================================================================
+
+//--------------------------------------------------------------------------------------
+// Device context wrapper that drops state changes which change nothing
+//--------------------------------------------------------------------------------------
+// Models, meshes, lights and the scene each set the states they need before drawing, without knowing what the
+// previous draw left bound, so the same shaders, textures, samplers and buffers are set over and over. Every
+// call through the D3D runtime and driver costs CPU time even when nothing changes. All engine rendering goes
+// through this class instead of the device context: it remembers what is bound and only passes on calls that
+// bind something different. Calls that aren't state changes (draws, clears) are passed straight on
+// Code that uses the device context directly (sprite batches, the GUI, ClearState) leaves the remembered state
+// out of date, so call Invalidate afterwards. NewFrame does so at the start of each frame
+
+#include <d3d11.h>
+
+//======================================================================================
+namespace umbra_engine
+{
+
+// State calls made through the context in the last frame
+struct SStateContextStats
+{
+	unsigned int numIssued   = 0; // Passed on to the device context
+	unsigned int numFiltered = 0; // Dropped because they would have bound what was already bound
+};
+
+class CStateContext
+{
+public:
+//---------------------------------------
+// Constructors / Destructors
+//---------------------------------------
+	// Wrap the given device context, which must outlive this object. Nothing is assumed to be bound to start with
+	CStateContext(ID3D11DeviceContext* context) : mContext(context) {}
+
+//---------------------------------------
+// Data Access
+//---------------------------------------
+	// The wrapped device context, for calls that don't bind state (e.g. Map / Unmap, UpdateConstantBuffer)
+	ID3D11DeviceContext* GetContext() { return mContext; }
+
+	// Calls issued and filtered in the last frame
+	const SStateContextStats& GetStats() const { return mLastFrameStats; }
+
+//---------------------------------------
+// Operational Methods
+//---------------------------------------
+	// Start a new frame: keep the last frame's statistics and forget what is bound
+	void NewFrame();
+
+	// Forget what is bound, so the next call of each kind is passed on whatever it binds. Use after anything
+	// changes state without going through this class
+	void Invalidate();
+
+	// Reset all the context's state, as ID3D11DeviceContext::ClearState
+	void ClearState();
+
+	// Filtered state changes, the same as the device context functions of the same name
+	void VSSetShader(ID3D11VertexShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances);
+	void GSSetShader(ID3D11GeometryShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances);
+	void PSSetShader(ID3D11PixelShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances);
+
+	void VSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers);
+	void GSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers);
+	void PSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers);
+	void PSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views);
+	void PSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers);
+
+	void OMSetBlendState(ID3D11BlendState* state, const FLOAT blendFactor[4], UINT sampleMask);
+	void OMSetDepthStencilState(ID3D11DepthStencilState* state, UINT stencilRef);
+	void RSSetState(ID3D11RasterizerState* state);
+
+	void IASetInputLayout(ID3D11InputLayout* layout);
+	void IASetVertexBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets);
+	void IASetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset);
+	void IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology);
+
+	// Render targets are passed on. Binding a resource as a target unbinds it from shader slots, so the shader
+	// resources are forgotten too
+	void OMSetRenderTargets(UINT numViews, ID3D11RenderTargetView* const* renderTargets, ID3D11DepthStencilView* depthStencil);
+
+	// Not state changes, passed straight on
+	void RSSetViewports(UINT numViewports, const D3D11_VIEWPORT* viewports) { mContext->RSSetViewports(numViewports, viewports); }
+	void ClearRenderTargetView(ID3D11RenderTargetView* renderTarget, const FLOAT colour[4]) { mContext->ClearRenderTargetView(renderTarget, colour); }
+	void ClearDepthStencilView(ID3D11DepthStencilView* depthStencil, UINT flags, FLOAT depth, UINT8 stencil)
+	{
+		mContext->ClearDepthStencilView(depthStencil, flags, depth, stencil);
+	}
+	void GenerateMips(ID3D11ShaderResourceView* view) { mContext->GenerateMips(view); }
+	void Draw(UINT vertexCount, UINT startVertex) { mContext->Draw(vertexCount, startVertex); }
+	void DrawIndexed(UINT indexCount, UINT startIndex, INT baseVertex) { mContext->DrawIndexed(indexCount, startIndex, baseVertex); }
+	void DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance)
+	{
+		mContext->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+	}
+
+private:
+//---------------------------------------
+// Private Types
+//---------------------------------------
+	// A bound value, which is only compared against once it is known
+	template <typename T>
+	struct STracked
+	{
+		T    value = T();
+		bool known = false;
+
+		// Record a new value, returns false if it was already bound
+		bool Update(const T& newValue)
+		{
+			if (known && value == newValue) return false;
+			value = newValue;
+			known = true;
+			return true;
+		}
+	};
+
+	struct SBlendBinding
+	{
+		ID3D11BlendState* state;
+		FLOAT             factor[4];
+		UINT              sampleMask;
+		bool operator==(const SBlendBinding& other) const;
+	};
+
+	struct SDepthBinding
+	{
+		ID3D11DepthStencilState* state;
+		UINT                     stencilRef;
+		bool operator==(const SDepthBinding& other) const { return state == other.state && stencilRef == other.stencilRef; }
+	};
+
+	struct SVertexBinding
+	{
+		ID3D11Buffer* buffer;
+		UINT          stride;
+		UINT          offset;
+		bool operator==(const SVertexBinding& other) const
+		{
+			return buffer == other.buffer && stride == other.stride && offset == other.offset;
+		}
+	};
+
+	struct SIndexBinding
+	{
+		ID3D11Buffer* buffer;
+		DXGI_FORMAT   format;
+		UINT          offset;
+		bool operator==(const SIndexBinding& other) const
+		{
+			return buffer == other.buffer && format == other.format && offset == other.offset;
+		}
+	};
+
+	// Slots tracked for each kind of binding. Calls reaching beyond these are always passed on
+	static const UINT ConstantBufferSlots = D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT;
+	static const UINT ShaderResourceSlots = 16;
+	static const UINT SamplerSlots = D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT;
+	static const UINT VertexBufferSlots = 16;
+
+//---------------------------------------
+// Private Member Methods
+//---------------------------------------
+	// Record new values for a range of slots, returns false if they were all already bound
+	template <typename T, size_t N>
+	static bool UpdateSlots(STracked<T> (&slots)[N], UINT startSlot, UINT count, const T* values);
+
+	// Count a call, returns whether to pass it on
+	bool Issue(bool changed);
+
+//---------------------------------------
+// Private Member Variables
+//---------------------------------------
+	ID3D11DeviceContext* mContext;
+
+	STracked<ID3D11VertexShader*>   mVertexShader;
+	STracked<ID3D11GeometryShader*> mGeometryShader;
+	STracked<ID3D11PixelShader*>    mPixelShader;
+
+	STracked<ID3D11Buffer*>             mVSConstantBuffers[ConstantBufferSlots];
+	STracked<ID3D11Buffer*>             mGSConstantBuffers[ConstantBufferSlots];
+	STracked<ID3D11Buffer*>             mPSConstantBuffers[ConstantBufferSlots];
+	STracked<ID3D11ShaderResourceView*> mPSShaderResources[ShaderResourceSlots];
+	STracked<ID3D11SamplerState*>       mPSSamplers[SamplerSlots];
+
+	STracked<SBlendBinding>          mBlendState;
+	STracked<SDepthBinding>          mDepthStencilState;
+	STracked<ID3D11RasterizerState*> mRasterizerState;
+
+	STracked<ID3D11InputLayout*>       mInputLayout;
+	STracked<SVertexBinding>           mVertexBuffers[VertexBufferSlots];
+	STracked<SIndexBinding>            mIndexBuffer;
+	STracked<D3D11_PRIMITIVE_TOPOLOGY> mTopology;
+
+	SStateContextStats mStats;          // This frame so far
+	SStateContextStats mLastFrameStats;
+};//Class
+}//Namespace
+//======================================================================================
+#endif//Header Guard
@@ -0,0 +1,221 @@
+#include "StaticGeometry.hpp"
+#include "DirectX11Engine.hpp"
+#include "IModel.hpp"
+#include "IMesh.hpp"
+#include "COcclusionCuller.hpp"
+#include "BatchTransform.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <tuple>
+
+namespace umbra_engine
+{
+
+namespace
+{
+// Sub-meshes are merged when they are in the same chunk and would be drawn with the same state and vertex format
+typedef std::tuple<int, int, int, ID3D11VertexShader*, ID3D11PixelShader*, ID3D11ShaderResourceView*,
+                   ID3D11ShaderResourceView*, ID3D11ShaderResourceView*, unsigned int, int> BatchKey;
+
+// Geometry gathered for one batch before its buffers are created
+struct SMergedGeometry
+{
+	std::vector<uint8_t>  vertices;
+	std::vector<uint32_t> indices;
+	maths::CAABB          bounds;
+	ID3D11InputLayout*    vertexLayout = nullptr;
+};
+
+// Create an immutable buffer holding the given data
+ID3D11Buffer* CreateStaticBuffer(ID3D11Device* device, UINT bindFlags, const void* data, size_t size)
+{
+	D3D11_BUFFER_DESC bufferDesc = {};
+	bufferDesc.BindFlags = bindFlags;
+	bufferDesc.ByteWidth = static_cast<UINT>(size);
+	bufferDesc.Usage = D3D11_USAGE_IMMUTABLE; // Never changes, so the driver can put it where the GPU reads it fastest
+	bufferDesc.CPUAccessFlags = 0;
+	bufferDesc.MiscFlags = 0;
+	D3D11_SUBRESOURCE_DATA initData = {};
+	initData.pSysMem = data;
+
+	ID3D11Buffer* buffer = nullptr;
+	if (FAILED(device->CreateBuffer(&bufferDesc, &initData, &buffer))) return nullptr;
+	return buffer;
+}
+}
+
+
+CStaticGeometry::~CStaticGeometry()
+{
+	Release();
+}
+
+// Release all batches
+void CStaticGeometry::Release()
+{
+	for (auto& batch : mBatches)
+	{
+		if (batch.vertexBuffer) batch.vertexBuffer->Release();
+		if (batch.indexBuffer)  batch.indexBuffer->Release();
+		if (batch.vertexLayout) batch.vertexLayout->Release();
+	}
+	mBatches.clear();
+	mStats = SStaticGeometryStats();
+}
+
+// Merge the static models in the list
+bool CStaticGeometry::Build(const std::vector<IModel*>& models, IEngine* engine)
+{
+	Release();
+
+	// Gather each sub-mesh of each static model into its batch, transformed into world space. A model belongs to
+	// the chunk holding the centre of its bounds, so chunks can overlap a little but no model is split
+	std::map<BatchKey, SMergedGeometry> merged;
+	std::map<std::tuple<int, int, int>, bool> chunks;
+	for (auto model : models)
+	{
+		if (!model->IsStatic()) continue;
+		IMesh* mesh = model->GetMesh();
+		if (model->GetAddBlend() != None || !mesh->CanInstance())
+		{
+			model->SetStatic(false);
+			continue;
+		}
+
+		maths::CMatrix4x4 worldMatrix = model->WorldMatrix();
+		maths::CAABB bounds = model->WorldBounds();
+		maths::CVector3 centre = bounds.Centre();
+		int cellX = static_cast<int>(std::floor(centre.x / mChunkSize));
+		int cellY = static_cast<int>(std::floor(centre.y / mChunkSize));
+		int cellZ = static_cast<int>(std::floor(centre.z / mChunkSize));
+		chunks[std::make_tuple(cellX, cellY, cellZ)] = true;
+
+		for (unsigned int i = 0; i < mesh->NumberSubMeshes(); ++i)
+		{
+			SSubMeshGeometry subMesh = mesh->GetSubMeshGeometry(i);
+			if (subMesh.vertices == nullptr || subMesh.indices == nullptr) continue;
+
+			BatchKey key(cellX, cellY, cellZ, model->GetVSShader(), model->GetPSShader(), subMesh.diffuseTexture,
+			             model->GetDiffuseSRVMap2(), model->GetDiffuseSRVMap3(), subMesh.vertexSize, subMesh.tangentOffset);
+			auto found = merged.find(key);
+			if (found == merged.end())
+			{
+				found = merged.emplace(key, SMergedGeometry()).first;
+				found->second.bounds = bounds;
+				found->second.vertexLayout = subMesh.vertexLayout;
+			}
+			SMergedGeometry& batch = found->second;
+			batch.bounds = maths::Merge(batch.bounds, bounds);
+
+			// Into world space, with indices continuing from the vertices already in the batch
+			maths::AppendTransformedVertices(worldMatrix, subMesh.vertices, subMesh.numVertices, subMesh.vertexSize, subMesh.tangentOffset,
+			                                 subMesh.indices, subMesh.numIndices, batch.vertices, batch.indices);
+
+			++mStats.numSubMeshes;
+		}
+		++mStats.numModels;
+	}
+
+	// Create the buffers. The map is ordered by chunk first, so sort by material afterwards to draw batches sharing
+	// shaders and textures one after another
+	ID3D11Device* device = engine->GetDevice();
+	for (auto& entry : merged)
+	{
+		const BatchKey& key = entry.first;
+		SMergedGeometry& geometry = entry.second;
+
+		SBatch batch;
+		batch.bounds = geometry.bounds;
+		batch.vertexSize = std::get<8>(key);
+		batch.numIndices = static_cast<unsigned int>(geometry.indices.size());
+		batch.vertexShader = std::get<3>(key);
+		batch.pixelShader = std::get<4>(key);
+		batch.diffuseTexture = std::get<5>(key);
+		batch.textures[0] = std::get<6>(key);
+		batch.textures[1] = std::get<7>(key);
+		batch.vertexLayout = geometry.vertexLayout;
+		if (batch.vertexLayout) batch.vertexLayout->AddRef();
+		batch.vertexBuffer = CreateStaticBuffer(device, D3D11_BIND_VERTEX_BUFFER, geometry.vertices.data(), geometry.vertices.size());
+		batch.indexBuffer = CreateStaticBuffer(device, D3D11_BIND_INDEX_BUFFER, geometry.indices.data(), geometry.indices.size() * sizeof(uint32_t));
+		mBatches.push_back(batch);
+		if (batch.vertexBuffer == nullptr || batch.indexBuffer == nullptr)
+		{
+			Release();
+			return false;
+		}
+
+		mStats.numVertices += static_cast<unsigned int>(geometry.vertices.size() / batch.vertexSize);
+		mStats.numIndices += batch.numIndices;
+
+		geometry = SMergedGeometry(); // Free the CPU copy as soon as it is on the GPU
+	}
+	std::stable_sort(mBatches.begin(), mBatches.end(), [](const SBatch& a, const SBatch& b)
+	{
+		return std::tie(a.vertexShader, a.pixelShader, a.textures[0], a.textures[1], a.diffuseTexture) <
+		       std::tie(b.vertexShader, b.pixelShader, b.textures[0], b.textures[1], b.diffuseTexture);
+	});
+
+	mStats.numChunks = static_cast<unsigned int>(chunks.size());
+	mStats.numBatches = static_cast<unsigned int>(mBatches.size());
+	return true;
+}
+
+// Draw the visible batches
+void CStaticGeometry::Render(const maths::CFrustum& frustum, maths::COcclusionCuller* occlusionCuller, IEngine* engine)
+{
+	mStats.numDrawn = 0;
+	mStats.numCulled = 0;
+	if (mBatches.empty()) return;
+
+	// Vertices are already in world space
+	CStateContext* context = engine->GetStateContext();
+	PerModelConstants modelConstants = engine->GetModelConstants();
+	modelConstants.worldMatrix = maths::MatrixIdentity();
+	engine->SetModelConstants(modelConstants);
+	UpdateConstantBuffer(engine->GetModelConstantBuffer(), modelConstants, context->GetContext());
+	ID3D11Buffer* modelConstantBuffer = engine->GetModelConstantBuffer();
+	context->VSSetConstantBuffers(1, 1, &modelConstantBuffer);
+	context->PSSetConstantBuffers(1, 1, &modelConstantBuffer);
+	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+	const SBatch* previous = nullptr;
+	for (const auto& batch : mBatches)
+	{
+		if (!maths::Intersects(frustum, batch.bounds) ||
+		    (occlusionCuller != nullptr && occlusionCuller->IsOccluded(batch.bounds)))
+		{
+			++mStats.numCulled;
+			continue;
+		}
+
+		// Batches are sorted by material, so only set what differs from the last batch drawn
+		if (previous == nullptr || batch.vertexShader != previous->vertexShader || batch.pixelShader != previous->pixelShader)
+		{
+			context->VSSetShader(batch.vertexShader, nullptr, 0);
+			context->PSSetShader(batch.pixelShader, nullptr, 0);
+		}
+		if (previous == nullptr || batch.textures[0] != previous->textures[0] || batch.textures[1] != previous->textures[1])
+		{
+			context->PSSetShaderResources(1, 1, &batch.textures[0]); // Slots must match the shaders, as in Model::Render
+			context->PSSetShaderResources(3, 1, &batch.textures[1]);
+		}
+		if (batch.diffuseTexture != nullptr && (previous == nullptr || batch.diffuseTexture != previous->diffuseTexture))
+		{
+			context->PSSetShaderResources(0, 1, &batch.diffuseTexture);
+		}
+
+		UINT stride = batch.vertexSize;
+		UINT offset = 0;
+		context->IASetVertexBuffers(0, 1, &batch.vertexBuffer, &stride, &offset);
+		context->IASetInputLayout(batch.vertexLayout);
+		context->IASetIndexBuffer(batch.indexBuffer, DXGI_FORMAT_R32_UINT, 0);
+		context->DrawIndexed(batch.numIndices, 0, 0);
+
+		previous = &batch;
+		++mStats.numDrawn;
+	}
+}
+
+}
@@ -0,0 +1,109 @@
+#ifndef _STATIC_GEOMETRY_H_
+#define _STATIC_GEOMETRY_H_
+//======================================================================================
+
+//--------------------------------------------------------------------------------------
+// Static models merged into a few large vertex / index buffers
+//--------------------------------------------------------------------------------------
+// Models that never move (buildings, ground, props) are marked static in the level file. Once loaded, their
+// sub-meshes are transformed into world space and appended to shared buffers, one per material, so a street of
+// houses is drawn with a handful of draw calls instead of one per sub-mesh per model
+// The world is split into a grid of chunks and each chunk has its own buffers, so merged geometry can still be
+// frustum and occlusion culled a chunk at a time. Bigger chunks mean fewer draw calls but coarser culling
+// Static models keep their own meshes for shadow maps, occlusion and picking, only the main pass uses the merge
+
+#include "Common.hpp"
+#include "Geometry.hpp"
+
+#include <vector>
+
+//======================================================================================
+namespace umbra_engine
+{
+namespace maths
+{
+class COcclusionCuller;
+}
+//---------------------------------------
+// Class Forward Declarations
+//---------------------------------------
+class IEngine;
+class IModel;
+
+// What the merge did and how much of it was drawn in the last frame
+struct SStaticGeometryStats
+{
+	unsigned int numModels     = 0; // Static models merged
+	unsigned int numSubMeshes  = 0; // Sub-mesh draws the merged models would have made on their own
+	unsigned int numChunks     = 0; // Grid cells holding merged geometry
+	unsigned int numBatches    = 0; // Merged buffers, one per material per chunk, each a single draw call
+	unsigned int numVertices   = 0;
+	unsigned int numIndices    = 0;
+	unsigned int numDrawn      = 0; // Batches drawn in the last frame
+	unsigned int numCulled     = 0; // Batches outside the frustum or hidden behind occluders in the last frame
+};
+
+class CStaticGeometry
+{
+public:
+//---------------------------------------
+// Constructors / Destructors
+//---------------------------------------
+	// Width of the grid cells that merged geometry is split into, in world units
+	CStaticGeometry(float chunkSize = 250.0f) : mChunkSize(chunkSize) {}
+	~CStaticGeometry();
+
+	// Owns GPU resources, so no copying
+	CStaticGeometry(const CStaticGeometry&) = delete;
+	CStaticGeometry& operator=(const CStaticGeometry&) = delete;
+
+//---------------------------------------
+// Data Access
+//---------------------------------------
+	const SStaticGeometryStats& GetStats() const { return mStats; }
+
+//---------------------------------------
+// Operational Methods
+//---------------------------------------
+	// Merge the static models in the list, replacing any previous merge. Static models that can't be merged
+	// (blended or skinned) are marked not static so they are drawn as usual. Returns false on failure
+	bool Build(const std::vector<IModel*>& models, IEngine* engine);
+
+	// Draw the batches in the frustum and not hidden behind the occluders (pass nullptr to skip occlusion culling).
+	// Expects the depth, blend, raster and sampler states to be set. Sets the world matrix to the identity
+	void Render(const maths::CFrustum& frustum, maths::COcclusionCuller* occlusionCuller, IEngine* engine);
+
+private:
+//---------------------------------------
+// Private Types
+//---------------------------------------
+	// Merged geometry of one material in one chunk
+	struct SBatch
+	{
+		maths::CAABB              bounds;
+		ID3D11Buffer*             vertexBuffer = nullptr;
+		ID3D11Buffer*             indexBuffer = nullptr;
+		ID3D11InputLayout*        vertexLayout = nullptr; // Borrowed from the first sub-mesh, with a reference added
+		unsigned int              vertexSize = 0;
+		unsigned int              numIndices = 0;
+
+		// Material, shared with the source models
+		ID3D11VertexShader*       vertexShader = nullptr;
+		ID3D11PixelShader*        pixelShader = nullptr;
+		ID3D11ShaderResourceView* diffuseTexture = nullptr; // Slot 0, from the sub-mesh
+		ID3D11ShaderResourceView* textures[2] = {};         // Slots 1 and 3, from the model
+	};
+
+	// Release all batches
+	void Release();
+
+//---------------------------------------
+// Private Member Variables
+//---------------------------------------
+	float                mChunkSize;
+	std::vector<SBatch>  mBatches; // Sorted by material so neighbouring batches share state
+	SStaticGeometryStats mStats;
+};//Class
+}//Namespace
+//======================================================================================
+#endif//Header Guard
@@ -0,0 +1,257 @@
+//--------------------------------------------------------------------------------------
+// Batch transform tests
+//--------------------------------------------------------------------------------------
+// Checks the point and vector functions in BatchTransform.hpp with every instruction set the CPU supports
+// against a plain loop doing the same sums one vector at a time:
+//     - TransformPoints / TransformDirections on arrays of structures with strides, and on separate x, y, z arrays
+//     - AddScaled and ProjectOntoAxis
+//     - AppendTransformedVertices, merging meshes the way static geometry is merged: positions, unit normals and
+//       tangents in world space, other vertex data untouched, and indices still pointing at the same vertices
+// for counts that don't fill the SIMD width, and with the output written over the input
+// The matrix functions are checked in MatrixKernelsTest.cpp
+//
+// Build from the repository root, e.g. on Linux:
+//     g++ -std=c++14 -O2 -IMath -I. Tests/BatchTransformTest.cpp Math/*.cpp CVector4.cpp -pthread -o BatchTransformTest
+// or with Visual Studio (x64 Native Tools prompt):
+//     cl /std:c++14 /O2 /EHsc /IMath /I. Tests\BatchTransformTest.cpp Math\*.cpp CVector4.cpp /Fe:BatchTransformTest.exe
+// Exit code is 0 if all checks pass
+
+#include "Check.hpp"
+#include "BatchTransform.hpp"
+#include "MathHelpers.hpp"
+#include "CRandom.hpp"
+#include "SIMD.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+using namespace umbra_engine;
+using namespace umbra_engine::maths;
+
+namespace
+{
+const size_t NUM_POINTS = 1003; // Not a multiple of 4 or 8, so the remainder loops run
+const float TOLERANCE = 1e-4f;  // Relative, the SIMD versions may add in a different order
+
+CRandom gRandom(25);
+
+// A point inside a larger structure, to check strides
+struct SParticle
+{
+	float    life;
+	CVector3 position;
+	CVector3 velocity;
+};
+
+CVector3 RandomVector(float range)
+{
+	return { gRandom.Range(-range, range), gRandom.Range(-range, range), gRandom.Range(-range, range) };
+}
+
+CMatrix4x4 RandomAffine()
+{
+	return MatrixScaling({ gRandom.Range(0.1f, 10.0f), gRandom.Range(0.1f, 10.0f), gRandom.Range(0.1f, 10.0f) }) *
+	       MatrixRotationZ(gRandom.Range(-PI, PI)) * MatrixRotationX(gRandom.Range(-PI, PI)) *
+	       MatrixRotationY(gRandom.Range(-PI, PI)) * MatrixTranslation(RandomVector(100.0f));
+}
+
+// The reference sums, one vector at a time
+CVector3 ScalarTransform(const CMatrix4x4& m, const CVector3& v, float w)
+{
+	return { v.x * m.e00 + v.y * m.e10 + v.z * m.e20 + w * m.e30,
+	         v.x * m.e01 + v.y * m.e11 + v.z * m.e21 + w * m.e31,
+	         v.x * m.e02 + v.y * m.e12 + v.z * m.e22 + w * m.e32 };
+}
+
+// TransformPoints for w = 1, TransformDirections for w = 0
+void BatchTransform(const CMatrix4x4& m, float w, const CVector3* in, size_t inStride, CVector3* out, size_t outStride, size_t count)
+{
+	if (w == 1.0f) TransformPoints(m, in, inStride, out, outStride, count);
+	else           TransformDirections(m, in, inStride, out, outStride, count);
+}
+
+bool Same(const CVector3& a, const CVector3& b)
+{
+	return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+bool Near(float expected, float actual)
+{
+	return std::abs(expected - actual) <= TOLERANCE * std::max(1.0f, std::abs(expected));
+}
+
+bool Near(const CVector3& expected, const CVector3& actual)
+{
+	return Near(expected.x, actual.x) && Near(expected.y, actual.y) && Near(expected.z, actual.z);
+}
+
+// Instruction sets supported by this CPU, narrowest first
+std::vector<simd::EInstructionSet> SupportedInstructionSets()
+{
+	std::vector<simd::EInstructionSet> sets;
+	for (int i = 0; i <= static_cast<int>(simd::DetectInstructionSet()); ++i)
+	{
+		sets.push_back(static_cast<simd::EInstructionSet>(i));
+	}
+	return sets;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Tests
+-----------------------------------------------------------------------------------------*/
+
+void TestTransforms(const std::vector<SParticle>& particles, const CMatrix4x4& m)
+{
+	int problems = 0;
+	for (size_t count : { size_t(0), size_t(1), size_t(3), size_t(9), NUM_POINTS })
+	{
+		for (float w : { 1.0f, 0.0f })
+		{
+			// From inside a structure to a packed array, then in place inside the structures
+			std::vector<CVector3> packed(count + 1);
+			const CVector3 guard = { 12345.0f, 0.0f, 0.0f };
+			packed[count] = guard;
+			BatchTransform(m, w, &particles[0].position, sizeof(SParticle), packed.data(), sizeof(CVector3), count);
+			std::vector<SParticle> inPlace(particles.begin(), particles.begin() + count);
+			if (count > 0) BatchTransform(m, w, &inPlace[0].position, sizeof(SParticle), &inPlace[0].position, sizeof(SParticle), count);
+			for (size_t i = 0; i < count; ++i)
+			{
+				CVector3 expected = ScalarTransform(m, particles[i].position, w);
+				if (!Near(expected, packed[i]) || !Near(expected, inPlace[i].position)) ++problems;
+				if (inPlace[i].life != particles[i].life || !Same(inPlace[i].velocity, particles[i].velocity)) ++problems;
+			}
+			if (!Same(packed[count], guard)) ++problems; // Nothing written past the end
+
+			// Separate x, y, z arrays
+			std::vector<float> x(count), y(count), z(count);
+			for (size_t i = 0; i < count; ++i)
+			{
+				x[i] = particles[i].position.x;
+				y[i] = particles[i].position.y;
+				z[i] = particles[i].position.z;
+			}
+			if (w == 1.0f) TransformPoints(m, x.data(), y.data(), z.data(), x.data(), y.data(), z.data(), count);
+			else           TransformDirections(m, x.data(), y.data(), z.data(), x.data(), y.data(), z.data(), count);
+			for (size_t i = 0; i < count; ++i)
+			{
+				if (!Near(ScalarTransform(m, particles[i].position, w), CVector3{ x[i], y[i], z[i] })) ++problems;
+			}
+		}
+	}
+	CHECK(problems == 0);
+}
+
+void TestAddScaledAndProject(const std::vector<SParticle>& particles)
+{
+	const float frameTime = 0.016f;
+	const CVector3 origin = RandomVector(10.0f);
+	const CVector3 axis = Normalise(RandomVector(1.0f));
+
+	int problems = 0;
+	for (size_t count : { size_t(0), size_t(1), size_t(5), NUM_POINTS })
+	{
+		std::vector<SParticle> moved(particles.begin(), particles.begin() + count);
+		if (count > 0) AddScaled(&moved[0].velocity, sizeof(SParticle), frameTime, &moved[0].position, sizeof(SParticle), count);
+
+		std::vector<float> depths(count + 1, -1.0f);
+		ProjectOntoAxis(&particles[0].position, sizeof(SParticle), origin, axis, depths.data(), sizeof(float), count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			const SParticle& p = particles[i];
+			if (!Near(p.position + p.velocity * frameTime, moved[i].position) || !Same(moved[i].velocity, p.velocity)) ++problems;
+			if (!Near(Dot(axis, p.position - origin), depths[i])) ++problems;
+		}
+		if (depths[count] != -1.0f) ++problems;
+	}
+	CHECK(problems == 0);
+}
+
+// Several meshes merged into one vertex / index buffer, as CStaticGeometry::Build does
+void TestAppendVertices()
+{
+	// Position, normal, texture coordinates, then a tangent in vertex formats that have one
+	struct SVertex { CVector3 position; CVector3 normal; float u, v; CVector3 tangent; };
+	const size_t tangentOffset = offsetof(SVertex, tangent);
+
+	int problems = 0;
+	for (bool hasTangents : { true, false })
+	{
+		size_t vertexSize = hasTangents ? sizeof(SVertex) : tangentOffset;
+		std::vector<uint8_t> merged;
+		std::vector<uint32_t> mergedIndices;
+		std::vector<SVertex> expected;       // Each merged vertex in world space
+		std::vector<size_t> expectedIndices; // The merged vertex each merged index should point at
+		for (int mesh = 0; mesh < 4; ++mesh)
+		{
+			size_t numVertices = (mesh == 2) ? 0 : 1 + gRandom.Next() % 50; // An empty mesh in the middle
+			CMatrix4x4 m = RandomAffine();
+			size_t first = expected.size();
+
+			std::vector<uint8_t> vertices(numVertices * vertexSize);
+			for (size_t i = 0; i < numVertices; ++i)
+			{
+				SVertex vertex = { RandomVector(10.0f), Normalise(RandomVector(1.0f)), gRandom.NextFloat(), gRandom.NextFloat(), Normalise(RandomVector(1.0f)) };
+				std::memcpy(&vertices[i * vertexSize], &vertex, vertexSize);
+				vertex.position = ScalarTransform(m, vertex.position, 1.0f);
+				vertex.normal = Normalise(ScalarTransform(m, vertex.normal, 0.0f));
+				vertex.tangent = Normalise(ScalarTransform(m, vertex.tangent, 0.0f));
+				expected.push_back(vertex);
+			}
+			std::vector<uint32_t> indices;
+			for (size_t i = 0; i < numVertices * 3; ++i)
+			{
+				indices.push_back(static_cast<uint32_t>(gRandom.Next() % numVertices));
+				expectedIndices.push_back(first + indices.back());
+			}
+
+			AppendTransformedVertices(m, vertices.data(), numVertices, vertexSize, hasTangents ? static_cast<int>(tangentOffset) : -1,
+			                          indices.data(), indices.size(), merged, mergedIndices);
+		}
+
+		// Every index points at the vertex it did in its own mesh, now in world space
+		if (merged.size() != expected.size() * vertexSize || mergedIndices.size() != expectedIndices.size()) ++problems;
+		for (size_t i = 0; i < std::min(mergedIndices.size(), expectedIndices.size()); ++i)
+		{
+			if (mergedIndices[i] != expectedIndices[i]) ++problems;
+		}
+		for (size_t i = 0; i < std::min(merged.size() / vertexSize, expected.size()); ++i)
+		{
+			SVertex vertex = {};
+			std::memcpy(&vertex, &merged[i * vertexSize], vertexSize);
+			const SVertex& world = expected[i];
+			if (!Near(world.position, vertex.position) || !Near(world.normal, vertex.normal)) ++problems;
+			if (hasTangents && !Near(world.tangent, vertex.tangent)) ++problems;
+			if (std::abs(Length(vertex.normal) - 1.0f) > TOLERANCE || vertex.u != world.u || vertex.v != world.v) ++problems;
+		}
+	}
+	CHECK(problems == 0);
+}
+}
+
+
+int main()
+{
+	std::vector<SParticle> particles(NUM_POINTS);
+	for (auto& particle : particles)
+	{
+		particle.life = gRandom.NextFloat();
+		particle.position = RandomVector(100.0f);
+		particle.velocity = RandomVector(10.0f);
+	}
+	CMatrix4x4 m = RandomAffine();
+
+	for (simd::EInstructionSet set : SupportedInstructionSets())
+	{
+		simd::SetInstructionSet(set);
+		std::printf("%s\n", simd::InstructionSetName(set));
+		TestTransforms(particles, m);
+		TestAddScaledAndProject(particles);
+		TestAppendVertices();
+	}
+	simd::SetInstructionSet(simd::DetectInstructionSet());
+	return test::TestResult();
+}
@@ -0,0 +1,230 @@
+//--------------------------------------------------------------------------------------
+// Cascaded shadow map tests
+//--------------------------------------------------------------------------------------
+// Checks the cascade fitting in CascadedShadows.hpp for random camera positions and light directions:
+//     - split distances run from the near to the far clip, evenly for blend 0 and in a constant ratio for 1
+//     - every corner of a view slice lands inside its cascade's shadow map, and SelectCascade picks that
+//       cascade or an earlier one for it
+//     - a cascade keeps its size (up to rounding) as the camera turns, and moves by whole shadow map texels as
+//       it moves
+//     - fitting the depth to the casters brings the near plane in to the nearest caster but never into the slice
+//
+// Build from the repository root, e.g. on Linux:
+//     g++ -std=c++14 -O2 -IMath -I. Tests/CascadedShadowsTest.cpp Math/*.cpp CVector4.cpp -pthread -o CascadedShadowsTest
+// or with Visual Studio (x64 Native Tools prompt):
+//     cl /std:c++14 /O2 /EHsc /IMath /I. Tests\CascadedShadowsTest.cpp Math\*.cpp CVector4.cpp /Fe:CascadedShadowsTest.exe
+// Exit code is 0 if all checks pass
+
+#include "Check.hpp"
+#include "CascadedShadows.hpp"
+#include "BatchTransform.hpp"
+#include "MathTables.hpp"
+#include "MathHelpers.hpp"
+#include "CRandom.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace umbra_engine;
+using namespace umbra_engine::maths;
+
+namespace
+{
+const int NUM_CASCADES = 4;
+const int SHADOW_MAP_SIZE = 2048;
+const float NEAR_CLIP = 1.0f;
+const float FAR_CLIP = 1000.0f;
+const float CASTER_DISTANCE = 500.0f;
+const int NUM_POSES = 500;
+
+// Clip space tolerance for points on the edge of a shadow map
+const float CLIP_TOLERANCE = 1e-5f;
+
+CRandom gRandom(20);
+
+const CMatrix4x4 CAMERA_PROJECTION = MatrixPerspective(16.0f / 9.0f, std::tan(0.6f), NEAR_CLIP, FAR_CLIP);
+
+CMatrix4x4 CameraWorld(const CVector3& position, float yaw, float pitch)
+{
+	return MatrixRotationX(pitch) * MatrixRotationY(yaw) * MatrixTranslation(position);
+}
+
+CVector3 RandomLightDirection()
+{
+	return Normalise(CVector3{ gRandom.Range(-1.0f, 1.0f), gRandom.Range(-1.0f, -0.1f), gRandom.Range(-1.0f, 1.0f) });
+}
+
+CVector3 Transform(const CMatrix4x4& m, const CVector3& p)
+{
+	CVector3 result;
+	TransformPoints(m, &p, &result, 1);
+	return result;
+}
+
+// Fit every cascade for a camera
+void FitCascades(const CMatrix4x4& cameraWorld, const CVector3& lightDirection, SCascade* cascades, CVector3 (*corners)[8])
+{
+	float splits[NUM_CASCADES + 1];
+	CascadeSplits(NEAR_CLIP, FAR_CLIP, NUM_CASCADES, 0.75f, splits);
+	for (int i = 0; i < NUM_CASCADES; ++i)
+	{
+		FrustumSliceCorners(cameraWorld, CAMERA_PROJECTION, splits[i], splits[i + 1], corners[i]);
+		cascades[i] = FitCascade(lightDirection, corners[i], SHADOW_MAP_SIZE, CASTER_DISTANCE);
+	}
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Tests
+-----------------------------------------------------------------------------------------*/
+
+void TestSplits()
+{
+	float even[NUM_CASCADES + 1], logarithmic[NUM_CASCADES + 1], practical[NUM_CASCADES + 1];
+	CascadeSplits(NEAR_CLIP, FAR_CLIP, NUM_CASCADES, 0.0f, even);
+	CascadeSplits(NEAR_CLIP, FAR_CLIP, NUM_CASCADES, 1.0f, logarithmic);
+	CascadeSplits(NEAR_CLIP, FAR_CLIP, NUM_CASCADES, 0.75f, practical);
+
+	CHECK(even[0] == NEAR_CLIP && logarithmic[0] == NEAR_CLIP && practical[0] == NEAR_CLIP);
+	CHECK(even[NUM_CASCADES] == FAR_CLIP && logarithmic[NUM_CASCADES] == FAR_CLIP && practical[NUM_CASCADES] == FAR_CLIP);
+	float ratio = std::pow(FAR_CLIP / NEAR_CLIP, 1.0f / NUM_CASCADES);
+	for (int i = 1; i <= NUM_CASCADES; ++i)
+	{
+		CHECK(std::abs((even[i] - even[i - 1]) - (FAR_CLIP - NEAR_CLIP) / NUM_CASCADES) < 1e-3f);
+		CHECK(std::abs(logarithmic[i] / logarithmic[i - 1] - ratio) < 1e-3f * ratio);
+		CHECK(practical[i] > practical[i - 1] && practical[i] >= logarithmic[i] && practical[i] <= even[i]);
+	}
+}
+
+// Slice corners are inside their cascade and select it (or an earlier one that also covers them)
+void TestCoverage()
+{
+	int outside = 0, wrongSelection = 0;
+	float worstEdge = 0.0f;
+	for (int pose = 0; pose < NUM_POSES; ++pose)
+	{
+		CVector3 position{ gRandom.Range(-5000.0f, 5000.0f), gRandom.Range(0.0f, 200.0f), gRandom.Range(-5000.0f, 5000.0f) };
+		CMatrix4x4 cameraWorld = CameraWorld(position, gRandom.Range(-PI, PI), gRandom.Range(-1.2f, 1.2f));
+		CVector3 lightDirection = RandomLightDirection();
+
+		SCascade cascades[NUM_CASCADES];
+		CVector3 corners[NUM_CASCADES][8];
+		FitCascades(cameraWorld, lightDirection, cascades, corners);
+		for (int i = 0; i < NUM_CASCADES; ++i)
+		{
+			for (int c = 0; c < 8; ++c)
+			{
+				CVector3 p = Transform(cascades[i].viewProjectionMatrix, corners[i][c]);
+				worstEdge = std::max(worstEdge, std::max(std::abs(p.x), std::abs(p.y)));
+				if (std::abs(p.x) > 1.0f + CLIP_TOLERANCE || std::abs(p.y) > 1.0f + CLIP_TOLERANCE ||
+				    p.z < -CLIP_TOLERANCE || p.z > 1.0f + CLIP_TOLERANCE)
+				{
+					++outside;
+				}
+
+				// Pull the corner a little into the slice so rounding can't put it just outside every cascade
+				CVector3 centre = (corners[i][0] + corners[i][7]) * 0.5f;
+				CVector3 inside = corners[i][c] + (centre - corners[i][c]) * 0.001f;
+				int selected = SelectCascade(cascades, NUM_CASCADES, inside);
+				if (selected < 0 || selected > i) ++wrongSelection;
+			}
+		}
+
+		// Nothing covers a point far beyond the last slice
+		CVector3 beyond = Transform(cameraWorld, { 0.0f, 0.0f, FAR_CLIP * 3.0f });
+		if (SelectCascade(cascades, NUM_CASCADES, beyond) != -1) ++wrongSelection;
+	}
+	std::printf("Slice corners reach %.6f of the shadow map half width\n", worstEdge);
+	CHECK(outside == 0);
+	CHECK(wrongSelection == 0);
+}
+
+// Turning the camera keeps the cascade's size, moving it shifts the cascade by whole texels
+void TestStability()
+{
+	int sizeChanges = 0, partTexelMoves = 0;
+	for (int pose = 0; pose < NUM_POSES / 10; ++pose)
+	{
+		CVector3 position{ gRandom.Range(-1000.0f, 1000.0f), gRandom.Range(0.0f, 200.0f), gRandom.Range(-1000.0f, 1000.0f) };
+		CVector3 lightDirection = RandomLightDirection();
+		float pitch = gRandom.Range(-1.0f, 1.0f);
+
+		SCascade first[NUM_CASCADES];
+		CVector3 corners[NUM_CASCADES][8];
+		FitCascades(CameraWorld(position, 0.0f, pitch), lightDirection, first, corners);
+		for (int step = 0; step < 50; ++step)
+		{
+			SCascade cascades[NUM_CASCADES];
+			CVector3 moved = position + CVector3{ gRandom.Range(-5.0f, 5.0f), gRandom.Range(-1.0f, 1.0f), gRandom.Range(-5.0f, 5.0f) };
+			FitCascades(CameraWorld(moved, gRandom.Range(-PI, PI), pitch), lightDirection, cascades, corners);
+			for (int i = 0; i < NUM_CASCADES; ++i)
+			{
+				float width = first[i].volume.maximum.x - first[i].volume.minimum.x;
+				float texelSize = width / SHADOW_MAP_SIZE;
+				if (std::abs(cascades[i].volume.maximum.x - cascades[i].volume.minimum.x - width) > texelSize * 0.01f) ++sizeChanges;
+
+				for (float shift : { cascades[i].volume.minimum.x - first[i].volume.minimum.x,
+				                     cascades[i].volume.minimum.y - first[i].volume.minimum.y })
+				{
+					float texels = shift / texelSize;
+					if (std::abs(texels - std::round(texels)) > 0.01f) ++partTexelMoves;
+				}
+			}
+		}
+	}
+	CHECK(sizeChanges == 0);
+	CHECK(partTexelMoves == 0);
+}
+
+// The near plane comes in to the nearest caster, and no further than the slice
+void TestDepthFitting()
+{
+	CMatrix4x4 cameraWorld = CameraWorld({ 0.0f, 50.0f, 0.0f }, 0.3f, 0.1f);
+	CVector3 lightDirection = Normalise(CVector3{ 0.3f, -1.0f, 0.2f });
+	SCascade cascades[NUM_CASCADES];
+	CVector3 corners[NUM_CASCADES][8];
+	FitCascades(cameraWorld, lightDirection, cascades, corners);
+	SCascade cascade = cascades[1];
+	float fullNear = cascade.volume.minimum.z;
+
+	// A caster above the slice, towards the light
+	CVector3 centre = (corners[1][0] + corners[1][7]) * 0.5f;
+	CVector3 casterCentre = centre - lightDirection * (cascade.receiverNear - fullNear) * 0.5f;
+	CAABB caster(casterCentre - CVector3{ 1.0f, 1.0f, 1.0f }, casterCentre + CVector3{ 1.0f, 1.0f, 1.0f });
+	float casterNear = Transform(caster, cascade.viewMatrix).minimum.z;
+
+	SCascade fitted = cascade;
+	FitCascadeDepth(fitted, &caster, 1);
+	CHECK(fitted.volume.minimum.z == casterNear);
+	CHECK(fitted.volume.minimum.z > fullNear && fitted.volume.minimum.z < cascade.receiverNear);
+	CHECK(std::abs(Transform(fitted.viewProjectionMatrix, casterCentre).z -
+	               (Transform(cascade.viewMatrix, casterCentre).z - casterNear) / (fitted.volume.maximum.z - casterNear)) < 1e-5f);
+
+	// With no casters, or only casters inside the slice, the near plane stops at the front of the slice
+	fitted = cascade;
+	FitCascadeDepth(fitted, nullptr, 0);
+	CHECK(fitted.volume.minimum.z == cascade.receiverNear);
+	CAABB inside(centre - CVector3{ 1.0f, 1.0f, 1.0f }, centre + CVector3{ 1.0f, 1.0f, 1.0f });
+	fitted = cascade;
+	FitCascadeDepth(fitted, &inside, 1);
+	CHECK(fitted.volume.minimum.z == cascade.receiverNear);
+
+	// Casters beyond the caster distance are clipped as before
+	CVector3 farCentre = centre - lightDirection * (cascade.receiverNear - fullNear) * 3.0f;
+	CAABB farCaster(farCentre - CVector3{ 1.0f, 1.0f, 1.0f }, farCentre + CVector3{ 1.0f, 1.0f, 1.0f });
+	fitted = cascade;
+	FitCascadeDepth(fitted, &farCaster, 1);
+	CHECK(fitted.volume.minimum.z == fullNear);
+}
+}
+
+
+int main()
+{
+	TestSplits();
+	TestCoverage();
+	TestStability();
+	TestDepthFitting();
+	return test::TestResult();
+}
@@ -0,0 +1,48 @@
+#ifndef _CHECK_H_
+#define _CHECK_H_
+//======================================================================================
+
+//--------------------------------------------------------------------------------------
+// Minimal checks for the standalone test programs in this folder
+//--------------------------------------------------------------------------------------
+// Each test program is a single main() built the same way as Benchmarks/MathBenchmark.cpp (see the
+// top of each file). CHECK reports failures and carries on so one run lists every problem, and
+// TestResult() gives the exit code: 0 if every check passed, 1 otherwise
+
+#include <cstdio>
+
+//======================================================================================
+namespace umbra_engine
+{
+
+namespace test
+{
+// Checks made and failed so far
+inline int& NumChecks()   { static int count = 0; return count; }
+inline int& NumFailures() { static int count = 0; return count; }
+
+// Record a check, printing where it failed
+inline bool Check(bool passed, const char* expression, const char* file, int line)
+{
+	++NumChecks();
+	if (!passed)
+	{
+		++NumFailures();
+		std::printf("FAILED %s(%d): %s\n", file, line, expression);
+	}
+	return passed;
+}
+
+// Print a summary and return the exit code for main
+inline int TestResult()
+{
+	std::printf("%d checks, %d failed\n", NumChecks(), NumFailures());
+	return NumFailures() == 0 ? 0 : 1;
+}
+
+} } //Namespaces
+
+#define CHECK(expression) umbra_engine::test::Check((expression), #expression, __FILE__, __LINE__)
+
+//======================================================================================
+#endif // _CHECK_H_
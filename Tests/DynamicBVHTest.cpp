@@ -0,0 +1,230 @@
+//--------------------------------------------------------------------------------------
+// Dynamic BVH tests
+//--------------------------------------------------------------------------------------
+// Compares the CDynamicBVH culling queries with testing every object one at a time:
+//     - frustum and box queries return exactly the objects whose fat boxes pass the single box test, and
+//       never miss an object whose actual box is visible, while objects are inserted, moved and removed
+//     - the tree stays balanced (height below 1.44 * log2(N) + 2), even when objects are inserted in order
+//       along a line, which gives a chain without rebalancing, and after removing many of them
+//     - inserting after removals gives a new proxy that doesn't clash with those still in the tree
+// The batch frustum test (IntersectFrustumBoxes) is checked in GeometryTest.cpp
+//
+// Build from the repository root, e.g. on Linux:
+//     g++ -std=c++14 -O2 -IMath -I. Tests/DynamicBVHTest.cpp Math/*.cpp CVector4.cpp -pthread -o DynamicBVHTest
+// or with Visual Studio (x64 Native Tools prompt):
+//     cl /std:c++14 /O2 /EHsc /IMath /I. Tests\DynamicBVHTest.cpp Math\*.cpp CVector4.cpp /Fe:DynamicBVHTest.exe
+// Exit code is 0 if all checks pass
+
+#include "Check.hpp"
+#include "CDynamicBVH.hpp"
+#include "Geometry.hpp"
+#include "MathTables.hpp"
+#include "MathHelpers.hpp"
+#include "CRandom.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace umbra_engine;
+using namespace umbra_engine::maths;
+
+namespace
+{
+const int NUM_OBJECTS = 5000;
+const float WORLD_SIZE = 1000.0f;
+const int NUM_ROUNDS = 20;
+const int NUM_QUERIES = 20; // Per round
+
+CRandom gRandom(42);
+
+// Objects in the test world, with a proxy of -1 when not in the tree
+struct SObject
+{
+	CAABB bounds;
+	int   proxy;
+};
+
+// A box of random size somewhere in the world, mostly small with some large ones
+CAABB RandomBox()
+{
+	CVector3 centre{ gRandom.Range(-WORLD_SIZE, WORLD_SIZE), gRandom.Range(-50.0f, 50.0f), gRandom.Range(-WORLD_SIZE, WORLD_SIZE) };
+	float size = (gRandom.Next() % 20 == 0) ? gRandom.Range(20.0f, 200.0f) : gRandom.Range(0.5f, 10.0f);
+	CVector3 extents{ size * gRandom.Range(0.2f, 1.0f), size * gRandom.Range(0.2f, 1.0f), size * gRandom.Range(0.2f, 1.0f) };
+	return CAABB(centre - extents, centre + extents);
+}
+
+// The frustum of a camera at a random place and direction
+CFrustum RandomFrustum()
+{
+	CVector3 position{ gRandom.Range(-WORLD_SIZE, WORLD_SIZE), gRandom.Range(0.0f, 100.0f), gRandom.Range(-WORLD_SIZE, WORLD_SIZE) };
+	CMatrix4x4 world = MatrixRotationX(gRandom.Range(-0.5f, 0.5f)) * MatrixRotationY(gRandom.Range(-PI, PI)) * MatrixTranslation(position);
+	CMatrix4x4 projection = MatrixPerspective(16.0f / 9.0f, std::tan(gRandom.Range(0.3f, 0.8f)), 1.0f, gRandom.Range(100.0f, 1500.0f));
+	return FrustumFromMatrix(InverseAffine(world) * projection);
+}
+
+bool BoxesEqual(const CAABB& a, const CAABB& b)
+{
+	return a.minimum.x == b.minimum.x && a.minimum.y == b.minimum.y && a.minimum.z == b.minimum.z &&
+	       a.maximum.x == b.maximum.x && a.maximum.y == b.maximum.y && a.maximum.z == b.maximum.z;
+}
+
+/*-----------------------------------------------------------------------------------------
+	Tests
+-----------------------------------------------------------------------------------------*/
+
+// Compare one query's results against the brute force list of objects, both as proxies. Returns false on the
+// first difference so one bad query doesn't flood the output
+template <typename TFatTest, typename TExactTest>
+bool CompareQuery(const CDynamicBVH& tree, const std::vector<SObject>& objects, std::vector<int> results,
+                  TFatTest fatTest, TExactTest exactTest)
+{
+	std::vector<int> expected;
+	bool missed = false;
+	for (const auto& object : objects)
+	{
+		if (object.proxy == CDynamicBVH::NullProxy) continue;
+		if (fatTest(tree.GetFatBounds(object.proxy))) expected.push_back(object.proxy);
+		else if (exactTest(object.bounds)) missed = true; // A fat box always contains the actual box
+	}
+	std::sort(results.begin(), results.end());
+	std::sort(expected.begin(), expected.end());
+	return CHECK(!missed) && CHECK(results == expected);
+}
+
+void TestQueries()
+{
+	CDynamicBVH tree(2.0f);
+	std::vector<SObject> objects(NUM_OBJECTS);
+	for (int i = 0; i < NUM_OBJECTS; ++i)
+	{
+		objects[i].bounds = RandomBox();
+		objects[i].proxy = tree.Insert(objects[i].bounds, &objects[i]);
+	}
+
+	size_t totalVisible = 0, totalQueried = 0;
+	for (int round = 0; round < NUM_ROUNDS; ++round)
+	{
+		// Check the tree's bookkeeping
+		size_t count = 0;
+		bool boundsOk = true, userDataOk = true;
+		for (const auto& object : objects)
+		{
+			if (object.proxy == CDynamicBVH::NullProxy) continue;
+			++count;
+			const CAABB& fat = tree.GetFatBounds(object.proxy);
+			boundsOk = boundsOk && fat.minimum.x <= object.bounds.minimum.x && fat.maximum.x >= object.bounds.maximum.x &&
+			                       fat.minimum.y <= object.bounds.minimum.y && fat.maximum.y >= object.bounds.maximum.y &&
+			                       fat.minimum.z <= object.bounds.minimum.z && fat.maximum.z >= object.bounds.maximum.z;
+			userDataOk = userDataOk && tree.GetUserData(object.proxy) == &object;
+		}
+		CHECK(boundsOk && userDataOk);
+		CHECK(tree.Count() == count);
+		CHECK(tree.Height() <= static_cast<int>(1.44f * std::log2(static_cast<float>(count)) + 2.0f));
+
+		for (int query = 0; query < NUM_QUERIES; ++query)
+		{
+			CFrustum frustum = RandomFrustum();
+			std::vector<int> results;
+			tree.Query(frustum, results);
+			if (!CompareQuery(tree, objects, results, [&](const CAABB& box) { return Intersects(frustum, box); },
+			                                          [&](const CAABB& box) { return Intersects(frustum, box); })) return;
+			totalVisible += results.size();
+			totalQueried += count;
+
+			CAABB region = RandomBox();
+			results.clear();
+			tree.Query(region, results);
+			if (!CompareQuery(tree, objects, results, [&](const CAABB& box) { return Intersects(region, box); },
+			                                          [&](const CAABB& box) { return Intersects(region, box); })) return;
+		}
+
+		// Move a third of the objects (mostly a little, some a long way), remove and add some
+		int moved = 0, changed = 0, fatBoxErrors = 0;
+		for (auto& object : objects)
+		{
+			unsigned int action = gRandom.Next() % 30;
+			if (object.proxy == CDynamicBVH::NullProxy)
+			{
+				if (action < 5)
+				{
+					object.bounds = RandomBox();
+					object.proxy = tree.Insert(object.bounds, &object);
+				}
+			}
+			else if (action < 10)
+			{
+				CVector3 offset = (action < 8) ? CVector3{ gRandom.Range(-1.0f, 1.0f), 0.0f, gRandom.Range(-1.0f, 1.0f) }
+				                               : CVector3{ gRandom.Range(-100.0f, 100.0f), 0.0f, gRandom.Range(-100.0f, 100.0f) };
+				object.bounds = CAABB(object.bounds.minimum + offset, object.bounds.maximum + offset);
+				CAABB fatBefore = tree.GetFatBounds(object.proxy);
+				bool treeChanged = tree.Update(object.proxy, object.bounds);
+				if (!treeChanged && !BoxesEqual(fatBefore, tree.GetFatBounds(object.proxy))) ++fatBoxErrors;
+				++moved;
+				if (treeChanged) ++changed;
+			}
+			else if (action < 12)
+			{
+				tree.Remove(object.proxy);
+				object.proxy = CDynamicBVH::NullProxy;
+			}
+		}
+		CHECK(fatBoxErrors == 0);
+		CHECK(changed < moved); // Small moves stay inside the fat boxes
+	}
+	std::printf("Frustum queries returned %.1f%% of the objects on average\n", 100.0 * totalVisible / totalQueried);
+
+	// Empty the tree
+	for (auto& object : objects)
+	{
+		if (object.proxy != CDynamicBVH::NullProxy) tree.Remove(object.proxy);
+	}
+	std::vector<int> results;
+	tree.Query(RandomFrustum(), results);
+	CHECK(tree.Count() == 0 && tree.Height() == 0 && results.empty());
+}
+
+// Objects inserted in order along a line, the worst case for a tree that isn't rebalanced
+void TestBalance()
+{
+	CDynamicBVH tree;
+	std::vector<int> proxies;
+	for (int i = 0; i < NUM_OBJECTS; ++i)
+	{
+		CVector3 centre{ i * 3.0f, 0.0f, 0.0f };
+		CVector3 extents{ 1.0f, 1.0f, 1.0f };
+		proxies.push_back(tree.Insert(CAABB(centre - extents, centre + extents), nullptr));
+	}
+	CHECK(tree.Count() == static_cast<size_t>(NUM_OBJECTS));
+	CHECK(tree.Height() <= static_cast<int>(1.44f * std::log2(static_cast<float>(NUM_OBJECTS)) + 2.0f));
+
+	// Remove the first three quarters, leaving one end of the line
+	for (int i = 0; i < NUM_OBJECTS * 3 / 4; ++i)
+	{
+		tree.Remove(proxies[i]);
+	}
+	size_t remaining = NUM_OBJECTS - NUM_OBJECTS * 3 / 4;
+	CHECK(tree.Count() == remaining);
+	CHECK(tree.Height() <= static_cast<int>(1.44f * std::log2(static_cast<float>(remaining)) + 2.0f));
+
+	// A box query along the line still finds every remaining object, and only those
+	std::vector<int> results;
+	tree.Query(CAABB({ -10.0f, -10.0f, -10.0f }, { NUM_OBJECTS * 3.0f, 10.0f, 10.0f }), results);
+	std::sort(results.begin(), results.end());
+	std::vector<int> expected(proxies.begin() + NUM_OBJECTS * 3 / 4, proxies.end());
+	std::sort(expected.begin(), expected.end());
+	CHECK(results == expected);
+
+	// Inserting after removals (which reuses their nodes) gives a proxy distinct from those still in the tree
+	int reused = tree.Insert(CAABB({ 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f }), &tree);
+	CHECK(std::find(expected.begin(), expected.end(), reused) == expected.end() && tree.GetUserData(reused) == &tree);
+}
+}
+
+
+int main()
+{
+	TestQueries();
+	TestBalance();
+	return test::TestResult();
+}
@@ -0,0 +1,474 @@
+//--------------------------------------------------------------------------------------
+// Geometry tests
+//--------------------------------------------------------------------------------------
+// Checks the primitives and tests in Geometry.hpp for random shapes, mostly against points sampled in them:
+//     - boxes built from points and merged boxes hold every point and touch the outermost ones, and bounding
+//       spheres and transformed boxes, spheres and oriented boxes hold every transformed point of the original
+//     - a frustum holds the points that project inside the view, and planes hold the points they were made from
+//     - the overlap tests agree with the exact answers, and the frustum tests are conservative: never outside
+//       when a sampled point is inside, and Classify agrees with Intersects and with the box's corners
+//     - the spot light cone tests and ShadowIntersects (used to cull shadow casters) are conservative too: a box
+//       or sphere with a sampled point inside the cone, or casting a sampled shadow point into the frustum, is
+//       never culled, empty boxes are always culled, and a box holding the light never is
+//     - rays hit the surface of boxes, spheres and planes at the distance returned, and miss when every point
+//       along them is outside
+//     - the batch frustum test (IntersectFrustumBoxes) matches the single box test with every instruction set
+//
+// Build from the repository root, e.g. on Linux:
+//     g++ -std=c++14 -O2 -IMath -I. Tests/GeometryTest.cpp Math/*.cpp CVector4.cpp -pthread -o GeometryTest
+// or with Visual Studio (x64 Native Tools prompt):
+//     cl /std:c++14 /O2 /EHsc /IMath /I. Tests\GeometryTest.cpp Math\*.cpp CVector4.cpp /Fe:GeometryTest.exe
+// Exit code is 0 if all checks pass
+
+#include "Check.hpp"
+#include "Geometry.hpp"
+#include "MathTables.hpp"
+#include "MathHelpers.hpp"
+#include "CRandom.hpp"
+#include "SIMD.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace umbra_engine;
+using namespace umbra_engine::maths;
+
+namespace
+{
+const int NUM_SHAPES = 2000;
+const int NUM_SAMPLES = 64; // Points sampled in each shape
+const int NUM_FRUSTUMS = 20;
+const float WORLD_SIZE = 100.0f;
+const float TOLERANCE = 1e-3f; // World units, for points on a surface
+
+CRandom gRandom(7);
+
+CVector3 RandomVector(float range)
+{
+	return { gRandom.Range(-range, range), gRandom.Range(-range, range), gRandom.Range(-range, range) };
+}
+
+CVector3 RandomPointIn(const CAABB& box)
+{
+	return { gRandom.Range(box.minimum.x, box.maximum.x), gRandom.Range(box.minimum.y, box.maximum.y),
+	         gRandom.Range(box.minimum.z, box.maximum.z) };
+}
+
+CAABB RandomBox()
+{
+	CVector3 centre = RandomVector(WORLD_SIZE);
+	CVector3 extents = { gRandom.Range(0.1f, 20.0f), gRandom.Range(0.1f, 20.0f), gRandom.Range(0.1f, 20.0f) };
+	return CAABB(centre - extents, centre + extents);
+}
+
+CMatrix4x4 RandomAffine()
+{
+	return MatrixScaling({ gRandom.Range(0.2f, 3.0f), gRandom.Range(0.2f, 3.0f), gRandom.Range(0.2f, 3.0f) }) *
+	       MatrixRotationZ(gRandom.Range(-PI, PI)) * MatrixRotationX(gRandom.Range(-PI, PI)) *
+	       MatrixRotationY(gRandom.Range(-PI, PI)) * MatrixTranslation(RandomVector(WORLD_SIZE));
+}
+
+CVector3 TransformPoint(const CMatrix4x4& m, const CVector3& p)
+{
+	return { p.x * m.e00 + p.y * m.e10 + p.z * m.e20 + m.e30,
+	         p.x * m.e01 + p.y * m.e11 + p.z * m.e21 + m.e31,
+	         p.x * m.e02 + p.y * m.e12 + p.z * m.e22 + m.e32 };
+}
+
+// Clip space position of a point
+void Project(const CMatrix4x4& m, const CVector3& p, float& x, float& y, float& z, float& w)
+{
+	x = p.x * m.e00 + p.y * m.e10 + p.z * m.e20 + m.e30;
+	y = p.x * m.e01 + p.y * m.e11 + p.z * m.e21 + m.e31;
+	z = p.x * m.e02 + p.y * m.e12 + p.z * m.e22 + m.e32;
+	w = p.x * m.e03 + p.y * m.e13 + p.z * m.e23 + m.e33;
+}
+
+// View-projection of a camera at a random place and direction in the world
+CMatrix4x4 RandomViewProjection()
+{
+	CMatrix4x4 world = MatrixRotationX(gRandom.Range(-1.0f, 1.0f)) * MatrixRotationY(gRandom.Range(-PI, PI)) *
+	                   MatrixTranslation(RandomVector(WORLD_SIZE));
+	CMatrix4x4 projection = MatrixPerspective(16.0f / 9.0f, std::tan(gRandom.Range(0.3f, 0.8f)), 1.0f, gRandom.Range(50.0f, 300.0f));
+	return InverseAffine(world) * projection;
+}
+
+CVector3 Corner(const CAABB& box, int corner)
+{
+	return { (corner & 1) ? box.maximum.x : box.minimum.x, (corner & 2) ? box.maximum.y : box.minimum.y,
+	         (corner & 4) ? box.maximum.z : box.minimum.z };
+}
+
+// Grow a box a little, for points that should be inside but may be just outside after rounding
+CAABB Grow(const CAABB& box)
+{
+	CVector3 margin = { TOLERANCE, TOLERANCE, TOLERANCE };
+	return CAABB(box.minimum - margin, box.maximum + margin);
+}
+
+bool InsideOBB(const COBB& box, const CVector3& point)
+{
+	CVector3 v = point - box.centre;
+	return std::abs(Dot(v, box.axes[0])) <= box.extents.x + TOLERANCE &&
+	       std::abs(Dot(v, box.axes[1])) <= box.extents.y + TOLERANCE &&
+	       std::abs(Dot(v, box.axes[2])) <= box.extents.z + TOLERANCE;
+}
+
+// Instruction sets supported by this CPU, narrowest first
+std::vector<simd::EInstructionSet> SupportedInstructionSets()
+{
+	std::vector<simd::EInstructionSet> sets;
+	for (int i = 0; i <= static_cast<int>(simd::DetectInstructionSet()); ++i)
+	{
+		sets.push_back(static_cast<simd::EInstructionSet>(i));
+	}
+	return sets;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Tests
+-----------------------------------------------------------------------------------------*/
+
+void TestConstruction()
+{
+	CHECK(EmptyAABB().IsEmpty() && !Merge(EmptyAABB(), CVector3{ 1.0f, 2.0f, 3.0f }).IsEmpty());
+
+	int problems = 0;
+	for (int i = 0; i < NUM_SHAPES; ++i)
+	{
+		// Points inside a structure, to check the stride
+		struct SVertex { CVector3 position; float u, v; };
+		SVertex vertices[NUM_SAMPLES];
+		for (auto& vertex : vertices) vertex.position = RandomVector(WORLD_SIZE);
+		CAABB box = AABBFromPoints(&vertices[0].position, sizeof(SVertex), NUM_SAMPLES);
+
+		CAABB merged = EmptyAABB();
+		bool touchesMin[3] = {}, touchesMax[3] = {};
+		for (const auto& vertex : vertices)
+		{
+			const CVector3& p = vertex.position;
+			if (!Contains(box, p)) ++problems;
+			merged = Merge(merged, p);
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				touchesMin[axis] = touchesMin[axis] || (&p.x)[axis] == (&box.minimum.x)[axis];
+				touchesMax[axis] = touchesMax[axis] || (&p.x)[axis] == (&box.maximum.x)[axis];
+			}
+		}
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			if (!touchesMin[axis] || !touchesMax[axis]) ++problems; // Tight
+		}
+		if (!(merged.minimum.x == box.minimum.x && merged.maximum.z == box.maximum.z)) ++problems;
+
+		CAABB other = RandomBox();
+		CAABB both = Merge(box, other);
+		if (!Contains(both, box.minimum) || !Contains(both, box.maximum) || !Contains(both, other.minimum) || !Contains(both, other.maximum)) ++problems;
+
+		CSphere sphere = SphereFromAABB(box);
+		sphere.radius += TOLERANCE;
+		for (int corner = 0; corner < 8; ++corner)
+		{
+			if (!Contains(sphere, Corner(box, corner))) ++problems;
+		}
+
+		// Planes hold the points they were made from, and face the way their normal does
+		CVector3 p1 = RandomVector(WORLD_SIZE), p2 = RandomVector(WORLD_SIZE), p3 = RandomVector(WORLD_SIZE);
+		if (Length(Cross(p2 - p1, p3 - p1)) < 1.0f) continue;
+		CPlane plane = PlaneFromPoints(p1, p2, p3);
+		if (std::abs(Distance(plane, p1)) > TOLERANCE || std::abs(Distance(plane, p2)) > TOLERANCE || std::abs(Distance(plane, p3)) > TOLERANCE) ++problems;
+		if (std::abs(Length(plane.normal) - 1.0f) > 1e-5f || Distance(plane, p1 + plane.normal) <= 0.0f) ++problems;
+		CPlane scaled = { plane.normal * 3.0f, plane.d * 3.0f };
+		CPlane normalised = Normalise(scaled);
+		if (std::abs(normalised.d - plane.d) > TOLERANCE || std::abs(Dot(normalised.normal, plane.normal) - 1.0f) > 1e-5f) ++problems;
+	}
+	CHECK(problems == 0);
+}
+
+void TestTransforms()
+{
+	int problems = 0, loose = 0;
+	for (int i = 0; i < NUM_SHAPES; ++i)
+	{
+		CAABB box = RandomBox();
+		CMatrix4x4 m = RandomAffine();
+		CAABB transformed = Grow(Transform(box, m));
+		COBB obb = TransformToOBB(box, m);
+		CSphere sphere = SphereFromAABB(box);
+		CSphere transformedSphere = Transform(sphere, m);
+		transformedSphere.radius += TOLERANCE;
+
+		// Corners of the box hold the box to the tightest axis-aligned box
+		CAABB cornerBox = EmptyAABB();
+		for (int corner = 0; corner < 8; ++corner)
+		{
+			CVector3 p = TransformPoint(m, Corner(box, corner));
+			cornerBox = Merge(cornerBox, p);
+			if (!Contains(transformed, p) || !InsideOBB(obb, p)) ++problems;
+		}
+		if (std::abs(cornerBox.maximum.x - transformed.maximum.x) > 2.0f * TOLERANCE ||
+		    std::abs(cornerBox.minimum.y - transformed.minimum.y) > 2.0f * TOLERANCE) ++loose;
+
+		for (int sample = 0; sample < NUM_SAMPLES; ++sample)
+		{
+			CVector3 p = sphere.centre + Normalise(RandomVector(1.0f)) * (sphere.radius * gRandom.NextFloat());
+			if (!Contains(transformedSphere, TransformPoint(m, p))) ++problems;
+		}
+	}
+	CHECK(problems == 0);
+	CHECK(loose == 0);
+}
+
+// The exact overlap tests, against points sampled in both shapes and the separating axes
+void TestOverlaps()
+{
+	int problems = 0;
+	for (int i = 0; i < NUM_SHAPES; ++i)
+	{
+		CAABB a = RandomBox(), b = RandomBox();
+		bool separated = a.maximum.x < b.minimum.x || b.maximum.x < a.minimum.x || a.maximum.y < b.minimum.y ||
+		                 b.maximum.y < a.minimum.y || a.maximum.z < b.minimum.z || b.maximum.z < a.minimum.z;
+		if (Intersects(a, b) == separated || Intersects(a, b) != Intersects(b, a)) ++problems;
+
+		CSphere s1(RandomVector(WORLD_SIZE), gRandom.Range(1.0f, 30.0f)), s2(RandomVector(WORLD_SIZE), gRandom.Range(1.0f, 30.0f));
+		if (Intersects(s1, s2) != (Length(s1.centre - s2.centre) <= s1.radius + s2.radius)) ++problems;
+
+		// Box against sphere: the distance from the box to the sphere's centre
+		float distanceSq = DistanceSquared(a, s1.centre);
+		if (Intersects(a, s1) != (distanceSq <= s1.radius * s1.radius)) ++problems;
+		CVector3 nearest = { std::min(std::max(s1.centre.x, a.minimum.x), a.maximum.x), std::min(std::max(s1.centre.y, a.minimum.y), a.maximum.y),
+		                     std::min(std::max(s1.centre.z, a.minimum.z), a.maximum.z) };
+		CVector3 toNearest = nearest - s1.centre;
+		if (std::abs(Dot(toNearest, toNearest) - distanceSq) > TOLERANCE * std::max(1.0f, distanceSq)) ++problems;
+		if (Contains(a, s1.centre) != (distanceSq == 0.0f)) ++problems;
+	}
+	CHECK(problems == 0);
+}
+
+void TestFrustums()
+{
+	int containProblems = 0, missed = 0, classifyProblems = 0, visible = 0, outside = 0;
+	for (int f = 0; f < NUM_FRUSTUMS; ++f)
+	{
+		CMatrix4x4 viewProjection = RandomViewProjection();
+		CFrustum frustum = FrustumFromMatrix(viewProjection);
+
+		// Points projecting inside the view volume (away from its edges) are inside, others outside
+		for (int i = 0; i < NUM_SHAPES; ++i)
+		{
+			CVector3 p = RandomVector(WORLD_SIZE * 2.0f);
+			float x, y, z, w;
+			Project(viewProjection, p, x, y, z, w);
+			const float margin = 1e-3f;
+			bool inside = w > 0.0f && std::abs(x) < w * (1.0f - margin) && std::abs(y) < w * (1.0f - margin) && z > w * margin && z < w * (1.0f - margin);
+			bool outsideView = w <= 0.0f || std::abs(x) > w * (1.0f + margin) || std::abs(y) > w * (1.0f + margin) || z < -w * margin || z > w * (1.0f + margin);
+			if ((inside && !Contains(frustum, p)) || (outsideView && Contains(frustum, p))) ++containProblems;
+		}
+
+		for (int i = 0; i < NUM_SHAPES; ++i)
+		{
+			CAABB box = RandomBox();
+			CSphere sphere = SphereFromAABB(box);
+			CMatrix4x4 m = RandomAffine();
+			COBB obb = TransformToOBB(box, m);
+
+			bool boxVisible = Intersects(frustum, box);
+			bool sphereVisible = Intersects(frustum, sphere);
+			bool obbVisible = Intersects(frustum, obb);
+			visible += boxVisible ? 1 : 0;
+
+			// Conservative: a sampled point inside means the shape must be visible
+			for (int sample = 0; sample < NUM_SAMPLES; ++sample)
+			{
+				CVector3 p = RandomPointIn(box);
+				if (Contains(frustum, p) && !boxVisible) ++missed;
+				if (Contains(frustum, TransformPoint(m, p)) && !obbVisible) ++missed;
+				CVector3 q = sphere.centre + Normalise(RandomVector(1.0f)) * (sphere.radius * gRandom.NextFloat());
+				if (Contains(frustum, q) && !sphereVisible) ++missed;
+			}
+
+			EIntersection classification = Classify(frustum, box);
+			if ((classification == EIntersection::Outside) == boxVisible) ++classifyProblems;
+			if (classification == EIntersection::Outside) ++outside;
+			if (classification == EIntersection::Inside)
+			{
+				for (int corner = 0; corner < 8; ++corner)
+				{
+					if (!Contains(frustum, Corner(box, corner))) ++classifyProblems;
+				}
+			}
+		}
+	}
+	CHECK(containProblems == 0);
+	CHECK(missed == 0);
+	CHECK(classifyProblems == 0);
+	CHECK(visible > 0 && outside > 0);
+}
+
+// Spot light cones and shadow volumes, used to cull shadow casters
+void TestShadowCulling()
+{
+	int missed = 0, culled = 0, problems = 0;
+	for (int f = 0; f < NUM_FRUSTUMS; ++f)
+	{
+		CFrustum frustum = FrustumFromMatrix(RandomViewProjection());
+		CVector3 lightPosition = RandomVector(WORLD_SIZE);
+		CCone cone(lightPosition, Normalise(RandomVector(1.0f)), std::cos(gRandom.Range(0.2f, 1.2f)));
+		float shadowDistance = gRandom.Range(20.0f, 200.0f);
+
+		for (int i = 0; i < NUM_SHAPES; ++i)
+		{
+			CAABB box = RandomBox();
+			CSphere sphere(RandomVector(WORLD_SIZE), gRandom.Range(1.0f, 30.0f));
+			bool boxLit = Intersects(cone, box);
+			bool sphereLit = Intersects(cone, sphere);
+			bool castsShadow = ShadowIntersects(frustum, box, lightPosition, shadowDistance);
+			culled += castsShadow ? 0 : 1;
+
+			// A visible box always casts a shadow that may be visible
+			if (Intersects(frustum, box) && !castsShadow) ++problems;
+
+			for (int sample = 0; sample < NUM_SAMPLES; ++sample)
+			{
+				CVector3 p = RandomPointIn(box);
+				CVector3 fromLight = p - lightPosition;
+				float distance = Length(fromLight);
+				if (distance > 0.0f && Dot(fromLight, cone.axis) >= distance * cone.cosHalfAngle && !boxLit) ++missed;
+
+				CVector3 q = sphere.centre + Normalise(RandomVector(1.0f)) * (sphere.radius * gRandom.NextFloat());
+				CVector3 qFromLight = q - lightPosition;
+				float qDistance = Length(qFromLight);
+				if (qDistance > 0.0f && Dot(qFromLight, cone.axis) >= qDistance * cone.cosHalfAngle && !sphereLit) ++missed;
+
+				// A point of the shadow behind p, out to the shadow distance
+				if (distance <= 0.0f || distance >= shadowDistance) continue;
+				CVector3 shadow = lightPosition + fromLight * (gRandom.Range(distance, shadowDistance) / distance);
+				if ((Contains(frustum, p) || Contains(frustum, shadow)) && !castsShadow) ++missed;
+			}
+		}
+
+		CHECK(!Intersects(cone, EmptyAABB()) && !ShadowIntersects(frustum, EmptyAABB(), lightPosition, shadowDistance));
+		CVector3 around = { 1.0f, 1.0f, 1.0f };
+		CHECK(ShadowIntersects(frustum, CAABB(lightPosition - around, lightPosition + around), lightPosition, shadowDistance));
+		CHECK(Intersects(cone, CSphere(lightPosition + cone.axis * 50.0f, 1.0f)));
+		CHECK(!Intersects(cone, CSphere(lightPosition - cone.axis * 50.0f, 1.0f)));
+	}
+	CHECK(missed == 0);
+	CHECK(problems == 0);
+	CHECK(culled > 0);
+}
+
+void TestRays()
+{
+	int problems = 0, hits = 0, misses = 0;
+	for (int i = 0; i < NUM_SHAPES; ++i)
+	{
+		CRay ray(RandomVector(WORLD_SIZE), Normalise(RandomVector(1.0f)));
+		float maxDistance = gRandom.Range(10.0f, 400.0f);
+
+		CAABB box = RandomBox();
+		float distance = -1.0f;
+		if (Intersects(ray, box, maxDistance, distance))
+		{
+			++hits;
+			CVector3 hit = ray.origin + ray.direction * distance;
+			if (distance < 0.0f || distance > maxDistance || !Contains(Grow(box), hit)) ++problems;
+			if (distance > 0.0f && Contains(box, ray.origin)) ++problems; // Inside hits at 0
+			if (distance > TOLERANCE && Contains(box, ray.origin + ray.direction * (distance - TOLERANCE * 10.0f))) ++problems; // First hit
+		}
+		else
+		{
+			++misses;
+			for (int step = 0; step <= 200; ++step)
+			{
+				if (Contains(box, ray.origin + ray.direction * (maxDistance * step / 200))) ++problems;
+			}
+		}
+
+		CSphere sphere(RandomVector(WORLD_SIZE), gRandom.Range(1.0f, 30.0f));
+		if (Intersects(ray, sphere, maxDistance, distance))
+		{
+			CVector3 hit = ray.origin + ray.direction * distance;
+			bool startsInside = Contains(sphere, ray.origin);
+			if (distance < 0.0f || distance > maxDistance) ++problems;
+			if (startsInside ? distance != 0.0f : std::abs(Length(hit - sphere.centre) - sphere.radius) > TOLERANCE) ++problems;
+		}
+		else
+		{
+			for (int step = 0; step <= 200; ++step)
+			{
+				if (Contains(sphere, ray.origin + ray.direction * (maxDistance * step / 200))) ++problems;
+			}
+		}
+
+		CPlane plane = PlaneFromPointNormal(RandomVector(WORLD_SIZE), Normalise(RandomVector(1.0f)));
+		bool crosses = Distance(plane, ray.origin) * Distance(plane, ray.origin + ray.direction * maxDistance) <= 0.0f;
+		if (Intersects(ray, plane, maxDistance, distance))
+		{
+			if (!crosses || std::abs(Distance(plane, ray.origin + ray.direction * distance)) > TOLERANCE) ++problems;
+		}
+		else if (crosses)
+		{
+			++problems;
+		}
+	}
+	CHECK(problems == 0);
+	CHECK(hits > 0 && misses > 0);
+}
+
+// Batch frustum tests against the single box test
+void TestBatchFrustumTests()
+{
+	std::vector<CAABB> boxes(NUM_SHAPES + 5); // Odd count for the scalar tail
+	for (auto& box : boxes) box = RandomBox();
+
+	// The same boxes as separate arrays
+	std::vector<float> centreX, centreY, centreZ, extentX, extentY, extentZ;
+	for (const auto& box : boxes)
+	{
+		centreX.push_back(box.Centre().x);  centreY.push_back(box.Centre().y);  centreZ.push_back(box.Centre().z);
+		extentX.push_back(box.Extents().x); extentY.push_back(box.Extents().y); extentZ.push_back(box.Extents().z);
+	}
+
+	for (int query = 0; query < NUM_FRUSTUMS; ++query)
+	{
+		CFrustum frustum = FrustumFromMatrix(RandomViewProjection());
+		std::vector<unsigned char> expected(boxes.size());
+		size_t expectedCount = 0;
+		for (size_t i = 0; i < boxes.size(); ++i)
+		{
+			expected[i] = Intersects(frustum, boxes[i]) ? 1 : 0;
+			expectedCount += expected[i];
+		}
+
+		for (simd::EInstructionSet set : SupportedInstructionSets())
+		{
+			simd::SetInstructionSet(set);
+			std::vector<unsigned char> visible(boxes.size(), 2);
+			size_t visibleCount = IntersectFrustumBoxes(frustum, boxes.data(), visible.data(), boxes.size());
+			CHECK(visibleCount == expectedCount && visible == expected);
+
+			std::fill(visible.begin(), visible.end(), 2);
+			visibleCount = IntersectFrustumBoxes(frustum, centreX.data(), centreY.data(), centreZ.data(),
+			                                     extentX.data(), extentY.data(), extentZ.data(), visible.data(), boxes.size());
+			CHECK(visibleCount == expectedCount && visible == expected);
+		}
+		simd::SetInstructionSet(simd::DetectInstructionSet());
+	}
+}
+}
+
+
+int main()
+{
+	TestConstruction();
+	TestTransforms();
+	TestOverlaps();
+	TestFrustums();
+	TestShadowCulling();
+	TestRays();
+	TestBatchFrustumTests();
+	return test::TestResult();
+}
@@ -0,0 +1,149 @@
+//--------------------------------------------------------------------------------------
+// Maths benchmark tests
+//--------------------------------------------------------------------------------------
+// Checks the parts of Benchmarks/MathBenchmark.cpp that decide whether an optimisation helped, rather than
+// the timings themselves (which depend on the machine):
+//     - Time gives a positive, finite ns per item, and scales with the work done per call
+//     - the benchmarks record a result for every instruction set the CPU supports
+//     - results saved as CSV read back as the baseline with no changes, and CompareBaseline counts only the
+//       results slower than the baseline by more than the tolerance, ignoring ones missing from the baseline
+//     - a missing baseline is reported, the JSON lists every result, and bad arguments give exit code 2
+// The benchmark is built into this program with its main renamed, so only its own source is needed
+//
+// Build from the repository root, e.g. on Linux:
+//     g++ -std=c++14 -O2 -IMath -I. Tests/MathBenchmarkTest.cpp Math/*.cpp CVector4.cpp -pthread -o MathBenchmarkTest
+// or with Visual Studio (x64 Native Tools prompt):
+//     cl /std:c++14 /O2 /EHsc /IMath /I. Tests\MathBenchmarkTest.cpp Math\*.cpp CVector4.cpp /Fe:MathBenchmarkTest.exe
+// Exit code is 0 if all checks pass
+
+#include "Check.hpp"
+
+#define main BenchmarkMain
+#include "../Benchmarks/MathBenchmark.cpp"
+#undef main
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace
+{
+const char* CSV_FILE = "MathBenchmarkTest.csv";
+const char* BASELINE_FILE = "MathBenchmarkTest_baseline.csv";
+const char* JSON_FILE = "MathBenchmarkTest.json";
+
+std::string ReadFile(const std::string& fileName)
+{
+	std::ifstream file(fileName);
+	return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+// Save the current results as a baseline with every time multiplied by scale
+void SaveScaledBaseline(double scale)
+{
+	std::vector<SResult> results = gResults;
+	for (SResult& r : gResults) r.nsPerItem *= scale;
+	SaveCSV(BASELINE_FILE);
+	gResults = results;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Tests
+-----------------------------------------------------------------------------------------*/
+
+void TestTiming()
+{
+	gMinRunTime = 0.002;
+
+	// The same work per call reported over ten times as many items is about a tenth of the time per item
+	std::vector<float> values(4096, 1.0f);
+	auto work = [&]
+	{
+		float sum = 0.0f;
+		for (float v : values) sum += std::sqrt(v + sum);
+		gSink = sum;
+	};
+	double perItem = Time(work, 1);
+	double perTenItems = Time(work, 10);
+	CHECK(perItem > 0.0 && std::isfinite(perItem));
+	CHECK(perTenItems < perItem * 0.3);
+
+	// One result per instruction set for each benchmark
+	gResults.clear();
+	MatrixThroughput(16);
+	std::set<std::string> benchmarks, sets;
+	bool positive = true;
+	for (const SResult& r : gResults)
+	{
+		benchmarks.insert(r.benchmark);
+		sets.insert(r.instructionSet);
+		positive = positive && r.nsPerItem > 0.0 && r.batch == 16 && r.mode == "throughput";
+	}
+	CHECK(positive);
+	CHECK(sets.size() == SupportedInstructionSets().size());
+	CHECK(gResults.size() == benchmarks.size() * sets.size());
+}
+
+void TestBaseline()
+{
+	gResults.clear();
+	MatrixThroughput(16);
+	CHECK(gResults.size() >= 4);
+
+	// Against itself nothing has changed
+	CHECK(SaveCSV(CSV_FILE));
+	CHECK(CompareBaseline(CSV_FILE, 10.0) == 0);
+
+	// Everything 50% slower than a baseline, then faster, then slower but within the tolerance
+	SaveScaledBaseline(1.0 / 1.5);
+	CHECK(CompareBaseline(BASELINE_FILE, 10.0) == static_cast<int>(gResults.size()));
+	CHECK(CompareBaseline(BASELINE_FILE, 60.0) == 0);
+	SaveScaledBaseline(2.0);
+	CHECK(CompareBaseline(BASELINE_FILE, 10.0) == 0);
+
+	// Only the first result slower, and a result the baseline doesn't have is ignored
+	std::vector<SResult> results = gResults;
+	gResults[0].nsPerItem *= 2.0;
+	gResults.push_back({ "New benchmark", gResults[0].instructionSet, "throughput", 16, 1000.0 });
+	CHECK(CompareBaseline(CSV_FILE, 10.0) == 1);
+	gResults = results;
+
+	CHECK(CompareBaseline("MathBenchmarkTest_missing.csv", 10.0) == -1);
+}
+
+void TestOutput()
+{
+	CHECK(SaveJSON(JSON_FILE));
+	std::string json = ReadFile(JSON_FILE);
+	size_t numEntries = 0;
+	for (size_t at = json.find("\"benchmark\""); at != std::string::npos; at = json.find("\"benchmark\"", at + 1)) ++numEntries;
+	CHECK(numEntries == gResults.size());
+	CHECK(json.find(gResults.back().benchmark) != std::string::npos && json.find("},\n  ]") == std::string::npos);
+
+	std::string csv = ReadFile(CSV_FILE);
+	CHECK(csv.find("benchmark,instruction_set,mode,batch,ns_per_item\n") == 0);
+
+	char name[] = "MathBenchmarkTest";
+	char badArgument[] = "--unknown";
+	char* argv[] = { name, badArgument };
+	CHECK(BenchmarkMain(2, argv) == 2);
+
+	std::remove(CSV_FILE);
+	std::remove(BASELINE_FILE);
+	std::remove(JSON_FILE);
+}
+}
+
+
+int main()
+{
+	TestTiming();
+	TestBaseline();
+	TestOutput();
+	return test::TestResult();
+}
@@ -0,0 +1,180 @@
+//--------------------------------------------------------------------------------------
+// Compile-time maths tests
+//--------------------------------------------------------------------------------------
+// The static_asserts below check that the constexpr vector, matrix and quaternion functions and the tables in
+// MathTables.hpp really are evaluated at compile time - this file doesn't build if they aren't. Then checks that:
+//     - the constexpr builders give the same matrices as multiplying out the equivalent runtime ones
+//     - each cube face basis is orthonormal, the six faces look along +X, -X, +Y, -Y, +Z, -Z in that order, and
+//       their right and up axes are the ones D3D samples cube maps with
+//     - CubeFaceViewMatrix is the inverse of the face's world matrix
+//     - CUBE_FACE_PROJECTION maps the near and far clip distances to depths 0 and 1 and covers 90 degrees
+//
+// Build from the repository root, e.g. on Linux:
+//     g++ -std=c++14 -O2 -IMath -I. Tests/MathTablesTest.cpp Math/*.cpp CVector4.cpp -pthread -o MathTablesTest
+// or with Visual Studio (x64 Native Tools prompt):
+//     cl /std:c++14 /O2 /EHsc /IMath /I. Tests\MathTablesTest.cpp Math\*.cpp CVector4.cpp /Fe:MathTablesTest.exe
+// Exit code is 0 if all checks pass
+
+#include "Check.hpp"
+#include "MathTables.hpp"
+#include "MathHelpers.hpp"
+#include "CQuaternion.hpp"
+#include "CTransform.hpp"
+#include "CVector4.hpp"
+#include "CRandom.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace umbra_engine;
+using namespace umbra_engine::maths;
+
+namespace
+{
+const float TOLERANCE = 1e-5f;
+
+CRandom gRandom(4);
+
+/*-----------------------------------------------------------------------------------------
+	Compile-time checks
+-----------------------------------------------------------------------------------------*/
+
+constexpr CVector3 X_AXIS = { 1.0f, 0.0f, 0.0f };
+constexpr CVector3 Y_AXIS = { 0.0f, 1.0f, 0.0f };
+constexpr CVector3 Z_AXIS = { 0.0f, 0.0f, 1.0f };
+
+static_assert(Dot(X_AXIS, Y_AXIS) == 0.0f && Dot(X_AXIS + Y_AXIS, X_AXIS * 2.0f) == 2.0f, "constexpr vector operators");
+static_assert(Cross(X_AXIS, Y_AXIS).z == 1.0f && (Z_AXIS - X_AXIS).x == -1.0f, "constexpr Cross");
+static_assert(CVector4{ 1.0f, 2.0f, 3.0f, 4.0f }.w == 4.0f, "constexpr CVector4");
+
+constexpr CMatrix4x4 MOVE = MatrixTranslation({ 1.0f, 2.0f, 3.0f }); // Used at runtime below
+static_assert(MatrixTranslation({ 1.0f, 2.0f, 3.0f }).GetPosition().y == 2.0f, "constexpr MatrixTranslation");
+static_assert(MatrixScaling({ 1.0f, 2.0f, 3.0f }).e22 == 3.0f && MatrixScaling(5.0f).e11 == 5.0f, "constexpr MatrixScaling");
+static_assert(MatrixTranspose(MatrixTranslation({ 1.0f, 2.0f, 3.0f })).e03 == 1.0f, "constexpr MatrixTranspose");
+static_assert(MatrixIdentity().GetZAxis().z == 1.0f, "constexpr MatrixIdentity");
+
+static_assert(Dot(QuaternionIdentity(), QuaternionIdentity()) == 1.0f, "constexpr QuaternionIdentity");
+static_assert(Conjugate(CQuaternion{ 1.0f, 0.0f, 0.0f, 0.0f }).x == -1.0f, "constexpr Conjugate");
+static_assert((CQuaternion{ 1.0f, 0.0f, 0.0f, 0.0f } * CQuaternion{ 1.0f, 0.0f, 0.0f, 0.0f }).w == -1.0f, "constexpr quaternion product");
+static_assert(MatrixRotation(QuaternionIdentity()).e11 == 1.0f, "constexpr MatrixRotation");
+static_assert(TransformIdentity().scale.y == 1.0f, "constexpr TransformIdentity");
+
+static_assert(ToDegrees(PI) == 180.0f && ToRadians(180.0f) == PI, "constexpr angle conversions");
+
+static_assert(CUBE_FACE_BASES[2].forward.y == 1.0f && CUBE_FACE_BASES[2].right.x == 1.0f, "constexpr cube face bases");
+static_assert(CubeFaceViewMatrix(0, { 5.0f, 0.0f, 0.0f }).e32 == -5.0f, "constexpr CubeFaceViewMatrix");
+static_assert(CUBE_FACE_PROJECTION.e23 == 1.0f && CUBE_FACE_PROJECTION.e33 == 0.0f, "constexpr CUBE_FACE_PROJECTION");
+
+
+/*-----------------------------------------------------------------------------------------
+	Helpers
+-----------------------------------------------------------------------------------------*/
+
+bool Near(float a, float b, float tolerance = TOLERANCE)
+{
+	return std::abs(a - b) <= tolerance * std::max(1.0f, std::abs(a));
+}
+
+bool Near(const CVector3& a, const CVector3& b)
+{
+	return Near(a.x, b.x) && Near(a.y, b.y) && Near(a.z, b.z);
+}
+
+bool Near(const CMatrix4x4& a, const CMatrix4x4& b)
+{
+	const float* ea = &a.e00;
+	const float* eb = &b.e00;
+	for (int i = 0; i < 16; ++i)
+	{
+		if (!Near(ea[i], eb[i])) return false;
+	}
+	return true;
+}
+
+// Depth and x of a view space point after projection
+CVector3 Project(const CMatrix4x4& m, const CVector3& v)
+{
+	float x = v.x * m.e00 + v.y * m.e10 + v.z * m.e20 + m.e30;
+	float z = v.x * m.e02 + v.y * m.e12 + v.z * m.e22 + m.e32;
+	float w = v.x * m.e03 + v.y * m.e13 + v.z * m.e23 + m.e33;
+	return { x / w, 0.0f, z / w };
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Tests
+-----------------------------------------------------------------------------------------*/
+
+void TestBuilders()
+{
+	int problems = 0;
+	for (int i = 0; i < 100; ++i)
+	{
+		CVector3 t = { gRandom.Range(-100.0f, 100.0f), gRandom.Range(-100.0f, 100.0f), gRandom.Range(-100.0f, 100.0f) };
+		CVector3 s = { gRandom.Range(0.1f, 10.0f), gRandom.Range(0.1f, 10.0f), gRandom.Range(0.1f, 10.0f) };
+		CMatrix4x4 rotation = MatrixRotationY(gRandom.Range(-PI, PI));
+
+		CMatrix4x4 expected = rotation;
+		expected.e00 *= s.x; expected.e01 *= s.x; expected.e02 *= s.x;
+		expected.e10 *= s.y; expected.e11 *= s.y; expected.e12 *= s.y;
+		expected.e20 *= s.z; expected.e21 *= s.z; expected.e22 *= s.z;
+		expected.e30 = t.x; expected.e31 = t.y; expected.e32 = t.z;
+		if (!Near(MatrixScaling(s) * rotation * MatrixTranslation(t), expected)) ++problems;
+
+		CMatrix4x4 transposed = expected;
+		transposed.Transpose();
+		if (!Near(MatrixTranspose(expected), transposed)) ++problems;
+
+		CMatrix4x4 identity = expected;
+		identity.MakeIdentity();
+		if (!Near(identity, MatrixIdentity()) || !Near(expected * MatrixIdentity(), expected)) ++problems;
+	}
+	CHECK(problems == 0);
+	CHECK(Near(MOVE.GetPosition(), { 1.0f, 2.0f, 3.0f }) && Near(MOVE * MatrixIdentity(), MOVE));
+}
+
+void TestCubeFaces()
+{
+	// Right and up of each face when D3D samples a cube map (u to the right, v down)
+	const CVector3 forwards[6] = { X_AXIS, X_AXIS * -1.0f, Y_AXIS, Y_AXIS * -1.0f, Z_AXIS, Z_AXIS * -1.0f };
+	const CVector3 rights[6]   = { Z_AXIS * -1.0f, Z_AXIS, X_AXIS, X_AXIS, X_AXIS, X_AXIS * -1.0f };
+	const CVector3 ups[6]      = { Y_AXIS, Y_AXIS, Z_AXIS * -1.0f, Z_AXIS, Y_AXIS, Y_AXIS };
+
+	for (int face = 0; face < 6; ++face)
+	{
+		const SCubeFaceBasis& basis = CUBE_FACE_BASES[face];
+		CHECK(Near(basis.forward, forwards[face]) && Near(basis.right, rights[face]) && Near(basis.up, ups[face]));
+		CHECK(Near(Dot(basis.right, basis.up), 0.0f) && Near(Dot(basis.up, basis.forward), 0.0f) && Near(Dot(basis.forward, basis.right), 0.0f));
+		CHECK(Near(Cross(basis.right, basis.up), basis.forward)); // Same winding as the world axes
+
+		// The view matrix undoes the face's world matrix
+		CVector3 position = { gRandom.Range(-100.0f, 100.0f), gRandom.Range(-100.0f, 100.0f), gRandom.Range(-100.0f, 100.0f) };
+		CMatrix4x4 world = MatrixIdentity();
+		world.e00 = basis.right.x;   world.e01 = basis.right.y;   world.e02 = basis.right.z;
+		world.e10 = basis.up.x;      world.e11 = basis.up.y;      world.e12 = basis.up.z;
+		world.e20 = basis.forward.x; world.e21 = basis.forward.y; world.e22 = basis.forward.z;
+		world.e30 = position.x;      world.e31 = position.y;      world.e32 = position.z;
+		CHECK(Near(CubeFaceViewMatrix(face, position), InverseAffine(world)));
+	}
+}
+
+void TestCubeFaceProjection()
+{
+	CHECK(Near(Project(CUBE_FACE_PROJECTION, { 0.0f, 0.0f, 0.1f }).z, 0.0f));
+	CHECK(Near(Project(CUBE_FACE_PROJECTION, { 0.0f, 0.0f, 10000.0f }).z, 1.0f));
+
+	// 45 degrees either side of the face's axis is the edge of the face
+	CHECK(Near(Project(CUBE_FACE_PROJECTION, { 50.0f, 0.0f, 50.0f }).x, 1.0f));
+	CHECK(Near(Project(CUBE_FACE_PROJECTION, { -3.0f, 0.0f, 3.0f }).x, -1.0f));
+	CHECK(Near(CUBE_FACE_PROJECTION.e00, CUBE_FACE_PROJECTION.e11));
+}
+}
+
+
+int main()
+{
+	TestBuilders();
+	TestCubeFaces();
+	TestCubeFaceProjection();
+	return test::TestResult();
+}
@@ -0,0 +1,248 @@
+//--------------------------------------------------------------------------------------
+// Matrix kernel tests
+//--------------------------------------------------------------------------------------
+// Checks every SSE/AVX matrix kernel the CPU supports, and the CMatrix4x4 / batch functions built on
+// them, against the scalar reference kernels. The SIMD kernels keep the scalar operation order, so
+// results must be bit-identical, including when the output aliases an input
+//
+// Build from the repository root, e.g. on Linux:
+//     g++ -std=c++14 -O2 -IMath -I. Tests/MatrixKernelsTest.cpp Math/*.cpp CVector4.cpp -pthread -o MatrixKernelsTest
+// or with Visual Studio (x64 Native Tools prompt):
+//     cl /std:c++14 /O2 /EHsc /IMath /I. Tests\MatrixKernelsTest.cpp Math\*.cpp CVector4.cpp /Fe:MatrixKernelsTest.exe
+// Exit code is 0 if all checks pass
+
+#include "Check.hpp"
+#include "CMatrix4x4.hpp"
+#include "BatchTransform.hpp"
+#include "MatrixKernels.hpp"
+#include "MathHelpers.hpp"
+#include "CRandom.hpp"
+#include "SIMD.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+using namespace umbra_engine;
+using namespace umbra_engine::maths;
+
+namespace
+{
+const int NUM_MATRICES = 1000;
+
+CRandom gRandom(2024);
+
+// A random rotation, scale and translation
+CMatrix4x4 RandomAffine()
+{
+	CVector3 position{ gRandom.Range(-100.0f, 100.0f), gRandom.Range(-100.0f, 100.0f), gRandom.Range(-100.0f, 100.0f) };
+	return MatrixScaling({ gRandom.Range(0.1f, 10.0f), gRandom.Range(0.1f, 10.0f), gRandom.Range(0.1f, 10.0f) }) *
+	       MatrixRotationZ(gRandom.Range(-PI, PI)) * MatrixRotationX(gRandom.Range(-PI, PI)) *
+	       MatrixRotationY(gRandom.Range(-PI, PI)) * MatrixTranslation(position);
+}
+
+// A matrix of random values, not necessarily affine
+CMatrix4x4 RandomGeneral()
+{
+	CMatrix4x4 m;
+	float* e = &m.e00;
+	for (int i = 0; i < 16; ++i) e[i] = gRandom.Range(-10.0f, 10.0f);
+	return m;
+}
+
+bool BitIdentical(const CMatrix4x4& a, const CMatrix4x4& b)
+{
+	return std::memcmp(&a.e00, &b.e00, sizeof(float) * 16) == 0;
+}
+
+bool NearlyIdentity(const CMatrix4x4& m, float tolerance)
+{
+	const float* e = &m.e00;
+	for (int i = 0; i < 16; ++i)
+	{
+		float expected = (i % 5 == 0) ? 1.0f : 0.0f;
+		if (std::abs(e[i] - expected) > tolerance) return false;
+	}
+	return true;
+}
+
+// Instruction sets supported by this CPU, narrowest first
+std::vector<simd::EInstructionSet> SupportedInstructionSets()
+{
+	std::vector<simd::EInstructionSet> sets;
+	for (int i = 0; i <= static_cast<int>(simd::DetectInstructionSet()); ++i)
+	{
+		sets.push_back(static_cast<simd::EInstructionSet>(i));
+	}
+	return sets;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Tests
+-----------------------------------------------------------------------------------------*/
+
+void TestKernels(simd::EInstructionSet set, const std::vector<CMatrix4x4>& a, const std::vector<CMatrix4x4>& b)
+{
+	const simd::SMatrixKernels& scalar = simd::MatrixKernels(simd::EInstructionSet::Scalar);
+	const simd::SMatrixKernels& kernels = simd::MatrixKernels(set);
+	std::printf("%s kernels\n", simd::InstructionSetName(set));
+
+	int multiplyMismatches = 0, transposeMismatches = 0, inverseMismatches = 0, aliasMismatches = 0;
+	for (size_t i = 0; i < a.size(); ++i)
+	{
+		CMatrix4x4 expected, actual;
+		scalar.multiply(&a[i].e00, &b[i].e00, &expected.e00);
+		kernels.multiply(&a[i].e00, &b[i].e00, &actual.e00);
+		if (!BitIdentical(expected, actual)) ++multiplyMismatches;
+
+		// In place, both ways round
+		CMatrix4x4 inPlace = a[i];
+		kernels.multiply(&inPlace.e00, &b[i].e00, &inPlace.e00);
+		if (!BitIdentical(expected, inPlace)) ++aliasMismatches;
+		inPlace = b[i];
+		kernels.multiply(&a[i].e00, &inPlace.e00, &inPlace.e00);
+		if (!BitIdentical(expected, inPlace)) ++aliasMismatches;
+
+		scalar.transpose(&a[i].e00, &expected.e00);
+		actual = a[i];
+		kernels.transpose(&actual.e00, &actual.e00);
+		if (!BitIdentical(expected, actual)) ++transposeMismatches;
+
+		scalar.inverseAffine(&a[i].e00, &expected.e00);
+		actual = a[i];
+		kernels.inverseAffine(&actual.e00, &actual.e00);
+		if (!BitIdentical(expected, actual)) ++inverseMismatches;
+	}
+	CHECK(multiplyMismatches == 0);
+	CHECK(aliasMismatches == 0);
+	CHECK(transposeMismatches == 0);
+	CHECK(inverseMismatches == 0);
+
+	// Batch kernels, including odd counts and output over the input
+	for (size_t count : { size_t(0), size_t(1), size_t(7), a.size() })
+	{
+		std::vector<CMatrix4x4> expected(count), actual(count);
+		for (size_t i = 0; i < count; ++i) scalar.multiply(&a[i].e00, &b[0].e00, &expected[i].e00);
+		if (count > 0) kernels.multiplyBatch(&a[0].e00, &b[0].e00, &actual[0].e00, count);
+		bool same = true;
+		for (size_t i = 0; i < count; ++i) same = same && BitIdentical(expected[i], actual[i]);
+		CHECK(same);
+
+		std::vector<CMatrix4x4> inPlace(a.begin(), a.begin() + count);
+		if (count > 0) kernels.multiplyBatch(&inPlace[0].e00, &b[0].e00, &inPlace[0].e00, count);
+		same = true;
+		for (size_t i = 0; i < count; ++i) same = same && BitIdentical(expected[i], inPlace[i]);
+		CHECK(same);
+
+		for (size_t i = 0; i < count; ++i) scalar.multiply(&a[i].e00, &b[i].e00, &expected[i].e00);
+		if (count > 0) kernels.multiplyPairwise(&a[0].e00, &b[0].e00, &actual[0].e00, count);
+		same = true;
+		for (size_t i = 0; i < count; ++i) same = same && BitIdentical(expected[i], actual[i]);
+		CHECK(same);
+
+		inPlace.assign(b.begin(), b.begin() + count);
+		if (count > 0) kernels.multiplyPairwise(&a[0].e00, &inPlace[0].e00, &inPlace[0].e00, count);
+		same = true;
+		for (size_t i = 0; i < count; ++i) same = same && BitIdentical(expected[i], inPlace[i]);
+		CHECK(same);
+	}
+}
+
+// CMatrix4x4 operators and the batch functions, with the given instruction set selected
+void TestMatrixFunctions(simd::EInstructionSet set, const std::vector<CMatrix4x4>& a, const std::vector<CMatrix4x4>& b)
+{
+	const simd::SMatrixKernels& scalar = simd::MatrixKernels(simd::EInstructionSet::Scalar);
+	simd::SetInstructionSet(set);
+	std::printf("%s matrix functions\n", simd::InstructionSetName(set));
+
+	int mismatches = 0, inverseErrors = 0;
+	for (size_t i = 0; i < a.size(); ++i)
+	{
+		CMatrix4x4 expected;
+		scalar.multiply(&a[i].e00, &b[i].e00, &expected.e00);
+		if (!BitIdentical(expected, a[i] * b[i])) ++mismatches;
+		CMatrix4x4 m = a[i];
+		m *= b[i];
+		if (!BitIdentical(expected, m)) ++mismatches;
+
+		scalar.inverseAffine(&a[i].e00, &expected.e00);
+		CMatrix4x4 inverse = InverseAffine(a[i]);
+		if (!BitIdentical(expected, inverse)) ++mismatches;
+		if (!NearlyIdentity(a[i] * inverse, 1e-4f)) ++inverseErrors;
+
+		scalar.transpose(&a[i].e00, &expected.e00);
+		m = a[i];
+		m.Transpose();
+		if (!BitIdentical(expected, m)) ++mismatches;
+	}
+	CHECK(mismatches == 0);
+	CHECK(inverseErrors == 0);
+
+	// Batch functions against the scalar kernel one matrix at a time
+	std::vector<CMatrix4x4> expected(a.size()), actual(a.size());
+	for (size_t i = 0; i < a.size(); ++i) scalar.multiply(&a[i].e00, &b[0].e00, &expected[i].e00);
+	MultiplyMatrices(a.data(), b[0], actual.data(), a.size());
+	bool same = true;
+	for (size_t i = 0; i < a.size(); ++i) same = same && BitIdentical(expected[i], actual[i]);
+	CHECK(same);
+
+	// Multiplying by one of the outputs uses the matrix from before the call
+	actual = a;
+	CMatrix4x4 first = actual[0];
+	MultiplyMatrices(actual.data(), actual[0], actual.data(), actual.size());
+	same = true;
+	for (size_t i = 0; i < a.size(); ++i)
+	{
+		CMatrix4x4 e;
+		scalar.multiply(&a[i].e00, &first.e00, &e.e00);
+		same = same && BitIdentical(e, actual[i]);
+	}
+	CHECK(same);
+
+	for (size_t i = 0; i < a.size(); ++i) scalar.multiply(&a[i].e00, &b[i].e00, &expected[i].e00);
+	MultiplyMatricesPairwise(a.data(), b.data(), actual.data(), a.size());
+	same = true;
+	for (size_t i = 0; i < a.size(); ++i) same = same && BitIdentical(expected[i], actual[i]);
+	CHECK(same);
+
+	// A hierarchy where each node's parent is a random earlier node (the first is the root)
+	std::vector<unsigned int> parents(a.size());
+	for (size_t i = 0; i < a.size(); ++i)
+	{
+		parents[i] = (i == 0) ? 0 : static_cast<unsigned int>(gRandom.Next() % i);
+	}
+	for (size_t i = 0; i < a.size(); ++i)
+	{
+		if (parents[i] < i) scalar.multiply(&a[i].e00, &expected[parents[i]].e00, &expected[i].e00);
+		else                expected[i] = a[i];
+	}
+	ResolveMatrixChain(a.data(), parents.data(), actual.data(), a.size());
+	same = true;
+	for (size_t i = 0; i < a.size(); ++i) same = same && BitIdentical(expected[i], actual[i]);
+	CHECK(same);
+
+	simd::SetInstructionSet(simd::DetectInstructionSet());
+}
+}
+
+
+int main()
+{
+	std::vector<CMatrix4x4> affineA, affineB, generalA, generalB;
+	for (int i = 0; i < NUM_MATRICES; ++i)
+	{
+		affineA.push_back(RandomAffine());
+		affineB.push_back(RandomAffine());
+		generalA.push_back(RandomGeneral());
+		generalB.push_back(RandomGeneral());
+	}
+
+	for (simd::EInstructionSet set : SupportedInstructionSets())
+	{
+		TestKernels(set, affineA, affineB);
+		TestKernels(set, generalA, generalB);
+		TestMatrixFunctions(set, affineA, affineB);
+	}
+	return test::TestResult();
+}
@@ -0,0 +1,91 @@
+#ifndef _MOCK_D3D11_H_
+#define _MOCK_D3D11_H_
+//======================================================================================
+
+//--------------------------------------------------------------------------------------
+// Stand-in for <d3d11.h> in the standalone tests
+//--------------------------------------------------------------------------------------
+// Just enough of the D3D11 types for StateContext.hpp / .cpp to build without Windows. The interfaces are
+// empty structs, only compared by address, and the device context records the name of every call made on it
+// so a test can see which calls were passed on. Put this folder first on the include path (-ITests/Mock)
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+typedef unsigned int  UINT;
+typedef int           INT;
+typedef unsigned char UINT8;
+typedef float         FLOAT;
+
+enum DXGI_FORMAT
+{
+	DXGI_FORMAT_R32_UINT = 42,
+	DXGI_FORMAT_R16_UINT = 57,
+};
+
+enum D3D11_PRIMITIVE_TOPOLOGY
+{
+	D3D11_PRIMITIVE_TOPOLOGY_POINTLIST    = 1,
+	D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST = 4,
+};
+
+#define D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT 14
+#define D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT             16
+
+struct D3D11_VIEWPORT
+{
+	FLOAT TopLeftX, TopLeftY, Width, Height, MinDepth, MaxDepth;
+};
+
+struct ID3D11VertexShader {};
+struct ID3D11GeometryShader {};
+struct ID3D11PixelShader {};
+struct ID3D11ClassInstance {};
+struct ID3D11Buffer {};
+struct ID3D11ShaderResourceView {};
+struct ID3D11SamplerState {};
+struct ID3D11BlendState {};
+struct ID3D11DepthStencilState {};
+struct ID3D11RasterizerState {};
+struct ID3D11InputLayout {};
+struct ID3D11RenderTargetView {};
+struct ID3D11DepthStencilView {};
+
+// Records each call by name, in order
+struct ID3D11DeviceContext
+{
+	std::vector<std::string> log;
+
+	void VSSetShader(ID3D11VertexShader*, ID3D11ClassInstance* const*, UINT)   { log.push_back("VSSetShader"); }
+	void GSSetShader(ID3D11GeometryShader*, ID3D11ClassInstance* const*, UINT) { log.push_back("GSSetShader"); }
+	void PSSetShader(ID3D11PixelShader*, ID3D11ClassInstance* const*, UINT)    { log.push_back("PSSetShader"); }
+
+	void VSSetConstantBuffers(UINT, UINT, ID3D11Buffer* const*)             { log.push_back("VSSetConstantBuffers"); }
+	void GSSetConstantBuffers(UINT, UINT, ID3D11Buffer* const*)             { log.push_back("GSSetConstantBuffers"); }
+	void PSSetConstantBuffers(UINT, UINT, ID3D11Buffer* const*)             { log.push_back("PSSetConstantBuffers"); }
+	void PSSetShaderResources(UINT, UINT, ID3D11ShaderResourceView* const*) { log.push_back("PSSetShaderResources"); }
+	void PSSetSamplers(UINT, UINT, ID3D11SamplerState* const*)              { log.push_back("PSSetSamplers"); }
+
+	void OMSetBlendState(ID3D11BlendState*, const FLOAT*, UINT)       { log.push_back("OMSetBlendState"); }
+	void OMSetDepthStencilState(ID3D11DepthStencilState*, UINT)        { log.push_back("OMSetDepthStencilState"); }
+	void RSSetState(ID3D11RasterizerState*)                            { log.push_back("RSSetState"); }
+	void OMSetRenderTargets(UINT, ID3D11RenderTargetView* const*, ID3D11DepthStencilView*) { log.push_back("OMSetRenderTargets"); }
+
+	void IASetInputLayout(ID3D11InputLayout*)                                           { log.push_back("IASetInputLayout"); }
+	void IASetVertexBuffers(UINT, UINT, ID3D11Buffer* const*, const UINT*, const UINT*) { log.push_back("IASetVertexBuffers"); }
+	void IASetIndexBuffer(ID3D11Buffer*, DXGI_FORMAT, UINT)                             { log.push_back("IASetIndexBuffer"); }
+	void IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY)                               { log.push_back("IASetPrimitiveTopology"); }
+
+	void RSSetViewports(UINT, const D3D11_VIEWPORT*)                           { log.push_back("RSSetViewports"); }
+	void ClearRenderTargetView(ID3D11RenderTargetView*, const FLOAT*)          { log.push_back("ClearRenderTargetView"); }
+	void ClearDepthStencilView(ID3D11DepthStencilView*, UINT, FLOAT, UINT8)    { log.push_back("ClearDepthStencilView"); }
+	void GenerateMips(ID3D11ShaderResourceView*)                               { log.push_back("GenerateMips"); }
+	void Draw(UINT, UINT)                                                      { log.push_back("Draw"); }
+	void DrawIndexed(UINT, UINT, INT)                                          { log.push_back("DrawIndexed"); }
+	void DrawIndexedInstanced(UINT, UINT, UINT, INT, UINT)                     { log.push_back("DrawIndexedInstanced"); }
+	void ClearState()                                                          { log.push_back("ClearState"); }
+};
+
+//======================================================================================
+#endif//Header Guard
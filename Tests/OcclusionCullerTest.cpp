@@ -0,0 +1,213 @@
+//--------------------------------------------------------------------------------------
+// Occlusion culler tests
+//--------------------------------------------------------------------------------------
+// A camera at the origin looks down +Z at a single wall, so whether a box is hidden can be worked out
+// exactly from its corners' screen positions. COcclusionCuller is checked against that:
+//     - boxes reported hidden really are behind the wall and inside its outline (to within a pixel)
+//     - boxes well inside the outline and behind the wall are reported hidden
+//     - boxes in front of the wall, beside it, crossing the near plane or off screen are never hidden
+//     - the statistics count occluders, triangles, tests and hidden boxes, and BeginFrame resets them
+//     - the depth buffer is the same whatever the number of worker threads
+//
+// Build from the repository root, e.g. on Linux:
+//     g++ -std=c++14 -O2 -IMath -I. Tests/OcclusionCullerTest.cpp Math/*.cpp CVector4.cpp -pthread -o OcclusionCullerTest
+// or with Visual Studio (x64 Native Tools prompt):
+//     cl /std:c++14 /O2 /EHsc /IMath /I. Tests\OcclusionCullerTest.cpp Math\*.cpp CVector4.cpp /Fe:OcclusionCullerTest.exe
+// Exit code is 0 if all checks pass
+
+#include "Check.hpp"
+#include "COcclusionCuller.hpp"
+#include "MathTables.hpp"
+#include "CRandom.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+using namespace umbra_engine;
+using namespace umbra_engine::maths;
+
+namespace
+{
+// Depth buffer 256 x 128 covering x / z from -1 to 1 and y / z from -0.5 to 0.5, so a pixel is 1/128 on both
+const int WIDTH = 256;
+const int HEIGHT = 128;
+const float PIXEL = 1.0f / 128.0f;
+const CMatrix4x4 VIEW_PROJECTION = MatrixPerspective(2.0f, 1.0f, 1.0f, 1000.0f); // Camera at the origin facing +Z
+
+// A 60 x 30 wall facing the camera at a distance of 50, as two triangles centred on its model space origin
+const float WALL_DISTANCE = 50.0f;
+const float WALL_HALF_WIDTH = 30.0f;
+const float WALL_HALF_HEIGHT = 15.0f;
+const CVector3 WALL_POSITIONS[4] = { { -WALL_HALF_WIDTH, -WALL_HALF_HEIGHT, 0.0f }, {  WALL_HALF_WIDTH, -WALL_HALF_HEIGHT, 0.0f },
+                                     {  WALL_HALF_WIDTH,  WALL_HALF_HEIGHT, 0.0f }, { -WALL_HALF_WIDTH,  WALL_HALF_HEIGHT, 0.0f } };
+const uint32_t WALL_INDICES[6] = { 0, 1, 2, 0, 2, 3 };
+
+const int NUM_BOXES = 20000;
+
+CRandom gRandom(5);
+
+// Where a box lies compared with the wall
+enum class EExpected
+{
+	Hidden,    // Behind the wall and inside its outline by at least two pixels - must be reported hidden
+	Visible,   // In front of the wall or outside its outline by at least a pixel - must not be reported hidden
+	Uncertain, // Within a pixel or two of the outline, either answer is fine
+};
+
+// Work out whether a box is hidden from the screen rectangle of its corners
+EExpected Expected(const CAABB& box)
+{
+	if (box.minimum.z <= WALL_DISTANCE) return EExpected::Visible;
+
+	float minX = 1e10f, maxX = -1e10f, minY = 1e10f, maxY = -1e10f;
+	for (int corner = 0; corner < 8; ++corner)
+	{
+		float x = (corner & 1) ? box.maximum.x : box.minimum.x;
+		float y = (corner & 2) ? box.maximum.y : box.minimum.y;
+		float z = (corner & 4) ? box.maximum.z : box.minimum.z;
+		minX = std::min(minX, x / z);
+		maxX = std::max(maxX, x / z);
+		minY = std::min(minY, y / z);
+		maxY = std::max(maxY, y / z);
+	}
+	const float wallX = WALL_HALF_WIDTH / WALL_DISTANCE;
+	const float wallY = WALL_HALF_HEIGHT / WALL_DISTANCE;
+	auto inside = [&](float margin)
+	{
+		return minX >= -wallX + margin && maxX <= wallX - margin && minY >= -wallY + margin && maxY <= wallY - margin;
+	};
+	if (inside(2.0f * PIXEL))  return EExpected::Hidden;
+	if (!inside(-PIXEL))       return EExpected::Visible;
+	return EExpected::Uncertain;
+}
+
+// A random box on screen, in front of or behind the wall, from small to large
+CAABB RandomBox()
+{
+	float z = gRandom.Range(10.0f, 300.0f);
+	CVector3 centre{ gRandom.Range(-0.9f, 0.9f) * z, gRandom.Range(-0.45f, 0.45f) * z, z };
+	float size = gRandom.Range(0.01f, 0.3f) * z;
+	CVector3 extents{ size * gRandom.Range(0.2f, 1.0f), size * gRandom.Range(0.2f, 1.0f), size * gRandom.Range(0.2f, 1.0f) };
+	return CAABB(centre - extents, centre + extents);
+}
+
+// Draw the wall into a culler
+void DrawWall(COcclusionCuller& culler)
+{
+	culler.BeginFrame(VIEW_PROJECTION);
+	culler.AddOccluder(WALL_POSITIONS, sizeof(CVector3), WALL_INDICES, 6, MatrixTranslation({ 0.0f, 0.0f, WALL_DISTANCE }));
+	culler.Rasterise();
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Tests
+-----------------------------------------------------------------------------------------*/
+
+void TestRandomBoxes()
+{
+	COcclusionCuller culler(WIDTH, HEIGHT);
+	DrawWall(culler);
+	CHECK(culler.Stats().numOccluders == 1 && culler.Stats().numTriangles == 2);
+
+	// Pixels inside the wall hold its depth, the rest are clear
+	float wallDepth = (1000.0f / 999.0f) * (1.0f - 1.0f / WALL_DISTANCE);
+	CHECK(std::abs(culler.DepthBuffer()[(HEIGHT / 2) * WIDTH + WIDTH / 2] - wallDepth) < 1e-5f);
+	CHECK(culler.DepthBuffer()[0] == 1.0f);
+
+	int numHidden = 0, numOccluded = 0, wrongHidden = 0, wrongVisible = 0;
+	for (int i = 0; i < NUM_BOXES; ++i)
+	{
+		CAABB box = RandomBox();
+		EExpected expected = Expected(box);
+		bool occluded = culler.IsOccluded(box);
+		if (expected == EExpected::Hidden) ++numHidden;
+		if (expected == EExpected::Hidden && !occluded) ++wrongHidden;
+		if (expected == EExpected::Visible && occluded) ++wrongVisible;
+		if (occluded) ++numOccluded;
+	}
+	std::printf("%d of %d boxes hidden, %d reported hidden\n", numHidden, NUM_BOXES, numOccluded);
+	CHECK(numHidden > NUM_BOXES / 20);
+	CHECK(wrongHidden == 0);
+	CHECK(wrongVisible == 0);
+	CHECK(culler.Stats().numTested == static_cast<unsigned int>(NUM_BOXES));
+	CHECK(culler.Stats().numOccluded == static_cast<unsigned int>(numOccluded));
+	CHECK(culler.Stats().rasterisationTime >= 0.0f);
+}
+
+void TestSpecialBoxes()
+{
+	COcclusionCuller culler(WIDTH, HEIGHT);
+	DrawWall(culler);
+
+	// Directly behind the wall
+	CHECK(culler.IsOccluded(CAABB({ -5.0f, -5.0f, 100.0f }, { 5.0f, 5.0f, 110.0f })));
+	// Touching the wall's plane from in front, and in front
+	CHECK(!culler.IsOccluded(CAABB({ -5.0f, -5.0f, 40.0f }, { 5.0f, 5.0f, 50.0f })));
+	CHECK(!culler.IsOccluded(CAABB({ -5.0f, -5.0f, 20.0f }, { 5.0f, 5.0f, 30.0f })));
+	// Behind but sticking out of the side
+	CHECK(!culler.IsOccluded(CAABB({ 50.0f, -5.0f, 100.0f }, { 70.0f, 5.0f, 110.0f })));
+	// Crossing the near plane and behind the camera
+	CHECK(!culler.IsOccluded(CAABB({ -1.0f, -1.0f, 0.5f }, { 1.0f, 1.0f, 200.0f })));
+	CHECK(!culler.IsOccluded(CAABB({ -1.0f, -1.0f, -20.0f }, { 1.0f, 1.0f, -10.0f })));
+	// Completely off screen
+	CHECK(!culler.IsOccluded(CAABB({ 500.0f, -5.0f, 100.0f }, { 510.0f, 5.0f, 110.0f })));
+	// Empty box
+	CHECK(!culler.IsOccluded(CAABB({ 1.0f, 1.0f, 100.0f }, { -1.0f, -1.0f, 110.0f })));
+	CHECK(culler.Stats().numTested == 8 && culler.Stats().numOccluded == 1);
+
+	// A new frame with no occluders hides nothing and starts counting again
+	culler.BeginFrame(VIEW_PROJECTION);
+	culler.Rasterise();
+	CHECK(culler.Stats().numOccluders == 0 && culler.Stats().numTested == 0);
+	CHECK(!culler.IsOccluded(CAABB({ -5.0f, -5.0f, 100.0f }, { 5.0f, 5.0f, 110.0f })));
+	CHECK(culler.Stats().numTested == 1 && culler.Stats().numOccluded == 0);
+
+	// A wall partly behind the camera is clipped to the near plane rather than lost
+	const CVector3 floor[4] = { { -30.0f, -2.0f, -50.0f }, { 30.0f, -2.0f, -50.0f }, { 30.0f, -2.0f, 60.0f }, { -30.0f, -2.0f, 60.0f } };
+	culler.AddOccluder(floor, sizeof(CVector3), WALL_INDICES, 6, MatrixIdentity());
+	culler.Rasterise();
+	CHECK(culler.Stats().numOccluders == 1 && culler.Stats().numTriangles > 0);
+	CHECK(culler.IsOccluded(CAABB({ -1.0f, -10.0f, 20.0f }, { 1.0f, -5.0f, 22.0f }))); // Under the floor
+	CHECK(!culler.IsOccluded(CAABB({ -1.0f, 0.0f, 20.0f }, { 1.0f, 2.0f, 22.0f })));   // Above it
+}
+
+// Rasterising on different numbers of threads gives the same depth buffer
+void TestThreads()
+{
+	std::vector<CVector3> positions;
+	std::vector<uint32_t> indices;
+	for (int i = 0; i < 300; ++i)
+	{
+		CVector3 centre{ gRandom.Range(-100.0f, 100.0f), gRandom.Range(-50.0f, 50.0f), gRandom.Range(20.0f, 200.0f) };
+		for (int v = 0; v < 3; ++v)
+		{
+			indices.push_back(static_cast<uint32_t>(positions.size()));
+			positions.push_back(centre + CVector3{ gRandom.Range(-20.0f, 20.0f), gRandom.Range(-20.0f, 20.0f), gRandom.Range(-5.0f, 5.0f) });
+		}
+	}
+
+	std::vector<float> reference;
+	for (int numThreads : { 0, 1, 3, 7 })
+	{
+		COcclusionCuller culler(WIDTH, HEIGHT, numThreads);
+		culler.BeginFrame(VIEW_PROJECTION);
+		culler.AddOccluder(positions.data(), sizeof(CVector3), indices.data(), indices.size(), MatrixIdentity());
+		culler.Rasterise();
+		std::vector<float> depth(culler.DepthBuffer(), culler.DepthBuffer() + culler.Width() * culler.Height());
+		if (reference.empty()) reference = depth;
+		CHECK(std::memcmp(depth.data(), reference.data(), depth.size() * sizeof(float)) == 0);
+	}
+}
+}
+
+
+int main()
+{
+	TestRandomBoxes();
+	TestSpecialBoxes();
+	TestThreads();
+	return test::TestResult();
+}
@@ -0,0 +1,202 @@
+//--------------------------------------------------------------------------------------
+// Quadtree atlas tests
+//--------------------------------------------------------------------------------------
+// Runs CQuadtreeAtlas through many frames of changing requests (keys appearing and disappearing, sizes
+// drifting and jumping, more asked for than fits) and checks after every Allocate that:
+//     - tiles never overlap and lie inside the atlas, at a power of two size aligned to that size
+//     - only keys requested this frame have tiles, and no tile is larger than its key asked for
+//     - the statistics agree with the tiles handed out
+//     - repeating a frame's requests keeps every tile where it is
+// and that the whole atlas can be handed out again once every tile has been freed
+//
+// Build from the repository root, e.g. on Linux:
+//     g++ -std=c++14 -O2 -IMath -I. Tests/QuadtreeAtlasTest.cpp Math/*.cpp CVector4.cpp -pthread -o QuadtreeAtlasTest
+// or with Visual Studio (x64 Native Tools prompt):
+//     cl /std:c++14 /O2 /EHsc /IMath /I. Tests\QuadtreeAtlasTest.cpp Math\*.cpp CVector4.cpp /Fe:QuadtreeAtlasTest.exe
+// Exit code is 0 if all checks pass
+
+#include "Check.hpp"
+#include "CQuadtreeAtlas.hpp"
+#include "CRandom.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace umbra_engine;
+using namespace umbra_engine::maths;
+
+namespace
+{
+const int ATLAS_SIZE = 4096;
+const int MIN_TILE_SIZE = 64;
+const int NUM_KEYS = 120;
+const int NUM_FRAMES = 2000;
+
+CRandom gRandom(21);
+
+// The largest new tile a key can be given for an ideal size: the nearest power of two, between the smallest tile
+// and half the atlas. A key keeping the tile it had can be further from its ideal size
+int LargestTileFor(float idealSize)
+{
+	float clamped = std::min(std::max(idealSize, static_cast<float>(MIN_TILE_SIZE)), ATLAS_SIZE * 0.5f);
+	return static_cast<int>(std::exp2(std::floor(std::log2(clamped) + 0.5f)));
+}
+
+bool IsPowerOfTwo(int value)
+{
+	return value > 0 && (value & (value - 1)) == 0;
+}
+
+// Check the tiles handed out for one frame's requests (ideal size per key, negative if not requested)
+// Returns the number of problems found
+int CheckFrame(const CQuadtreeAtlas& atlas, const std::vector<float>& requests, const std::vector<SAtlasTile>& previousTiles,
+               const std::vector<bool>& hadTile)
+{
+	int problems = 0;
+	std::vector<SAtlasTile> tiles;
+	std::vector<int> tileKeys;
+	unsigned int numRequested = 0, numChanged = 0;
+	long long usedArea = 0;
+	for (int key = 0; key < NUM_KEYS; ++key)
+	{
+		SAtlasTile tile;
+		bool hasTile = atlas.GetTile(key, tile);
+		if (requests[key] < 0.0f)
+		{
+			if (hasTile) ++problems;
+			continue;
+		}
+		++numRequested;
+		if (!hasTile) continue;
+
+		// Inside the atlas, a power of two and aligned
+		if (tile.x < 0 || tile.y < 0 || tile.x + tile.size > ATLAS_SIZE || tile.y + tile.size > ATLAS_SIZE ||
+		    !IsPowerOfTwo(tile.size) || tile.size < MIN_TILE_SIZE || tile.size > ATLAS_SIZE / 2 ||
+		    tile.x % tile.size != 0 || tile.y % tile.size != 0)
+		{
+			++problems;
+		}
+
+		// Not larger than asked for, unless the key kept a tile it already had
+		bool kept = hadTile[key] && previousTiles[key].x == tile.x && previousTiles[key].y == tile.y && previousTiles[key].size == tile.size;
+		if (!kept && tile.size > LargestTileFor(requests[key])) ++problems;
+		if (kept == atlas.TileChanged(key)) ++problems;
+		if (!kept) ++numChanged;
+
+		tiles.push_back(tile);
+		tileKeys.push_back(key);
+		usedArea += static_cast<long long>(tile.size) * tile.size;
+	}
+
+	// No two tiles overlap
+	for (size_t a = 0; a < tiles.size(); ++a)
+	{
+		for (size_t b = a + 1; b < tiles.size(); ++b)
+		{
+			if (tiles[a].x < tiles[b].x + tiles[b].size && tiles[b].x < tiles[a].x + tiles[a].size &&
+			    tiles[a].y < tiles[b].y + tiles[b].size && tiles[b].y < tiles[a].y + tiles[a].size)
+			{
+				std::printf("Keys %d and %d overlap\n", tileKeys[a], tileKeys[b]);
+				++problems;
+			}
+		}
+	}
+
+	const SAtlasStats& stats = atlas.Stats();
+	float occupancy = static_cast<float>(usedArea) / (static_cast<float>(ATLAS_SIZE) * ATLAS_SIZE);
+	if (stats.numRequested != numRequested || stats.numTiles != tiles.size() || stats.numChanged != numChanged ||
+	    stats.numTiles + stats.numFailed != numRequested || std::abs(stats.occupancy - occupancy) > 1e-6f ||
+	    stats.fragmentation < 0.0f || stats.fragmentation > 1.0f)
+	{
+		++problems;
+	}
+	return problems;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Tests
+-----------------------------------------------------------------------------------------*/
+
+void TestFrames()
+{
+	CQuadtreeAtlas atlas(ATLAS_SIZE, MIN_TILE_SIZE);
+	CHECK(atlas.Size() == ATLAS_SIZE && atlas.MinTileSize() == MIN_TILE_SIZE);
+
+	// Each key has a base size that drifts a little every frame and sometimes jumps
+	std::vector<float> baseSizes(NUM_KEYS);
+	std::vector<bool> active(NUM_KEYS);
+	for (int key = 0; key < NUM_KEYS; ++key)
+	{
+		baseSizes[key] = std::exp2(gRandom.Range(5.0f, 11.5f));
+		active[key] = gRandom.Next() % 2 == 0;
+	}
+
+	std::vector<SAtlasTile> previousTiles(NUM_KEYS);
+	std::vector<bool> hadTile(NUM_KEYS, false);
+	int problems = 0, fullFrames = 0, unchangedRepeats = 0;
+	for (int frame = 0; frame < NUM_FRAMES; ++frame)
+	{
+		// Some frames ask for far more than fits, most for a reasonable amount
+		bool crowded = frame % 100 >= 80;
+		std::vector<float> requests(NUM_KEYS, -1.0f);
+		atlas.BeginFrame();
+		for (int key = 0; key < NUM_KEYS; ++key)
+		{
+			if (gRandom.Next() % 20 == 0) active[key] = !active[key];
+			if (gRandom.Next() % 50 == 0) baseSizes[key] = std::exp2(gRandom.Range(5.0f, 11.5f));
+			baseSizes[key] *= std::exp2(gRandom.Range(-0.05f, 0.05f));
+			if (!active[key] && !crowded) continue;
+
+			requests[key] = crowded ? baseSizes[key] * 4.0f : baseSizes[key] * 0.5f;
+			atlas.Request(key, requests[key]);
+		}
+		atlas.Allocate();
+		problems += CheckFrame(atlas, requests, previousTiles, hadTile);
+		if (atlas.Stats().numFailed > 0 || atlas.Stats().numShrunk > 0) ++fullFrames;
+
+		for (int key = 0; key < NUM_KEYS; ++key) hadTile[key] = atlas.GetTile(key, previousTiles[key]);
+
+		// The same requests again change nothing
+		if (frame % 10 == 0)
+		{
+			atlas.BeginFrame();
+			for (int key = 0; key < NUM_KEYS; ++key)
+			{
+				if (requests[key] >= 0.0f) atlas.Request(key, requests[key]);
+			}
+			atlas.Allocate();
+			problems += CheckFrame(atlas, requests, previousTiles, hadTile);
+			if (atlas.Stats().numChanged == 0) ++unchangedRepeats;
+			for (int key = 0; key < NUM_KEYS; ++key) hadTile[key] = atlas.GetTile(key, previousTiles[key]);
+		}
+	}
+	std::printf("%d of %d frames ran out of room\n", fullFrames, NUM_FRAMES);
+	CHECK(problems == 0);
+	CHECK(fullFrames > 0);
+	CHECK(unchangedRepeats == NUM_FRAMES / 10);
+
+	// Freeing everything merges the tiles back, so the largest tiles fit again
+	atlas.BeginFrame();
+	atlas.Allocate();
+	CHECK(atlas.Stats().numTiles == 0 && atlas.Stats().occupancy == 0.0f && atlas.Stats().fragmentation == 0.0f);
+	atlas.BeginFrame();
+	for (int key = 0; key < 4; ++key) atlas.Request(key, static_cast<float>(ATLAS_SIZE));
+	atlas.Allocate();
+	CHECK(atlas.Stats().numTiles == 4 && atlas.Stats().numShrunk == 0 && atlas.Stats().occupancy == 1.0f);
+
+	// A fifth key has nowhere to go
+	atlas.BeginFrame();
+	for (int key = 0; key < 5; ++key) atlas.Request(key, static_cast<float>(ATLAS_SIZE));
+	atlas.Allocate();
+	CHECK(atlas.Stats().numTiles == 4 && atlas.Stats().numFailed == 1 && atlas.Stats().numChanged == 0);
+}
+}
+
+
+int main()
+{
+	TestFrames();
+	return test::TestResult();
+}
@@ -0,0 +1,217 @@
+//--------------------------------------------------------------------------------------
+// Quaternion and transform tests
+//--------------------------------------------------------------------------------------
+// Checks CQuaternion and CTransform against the matrices they stand in for, for random rotations:
+//     - axis and Euler rotations give the same matrix as the matrix builders, including the fast Euler version
+//     - q1 * q2 matches the matrix product, and Rotate matches multiplying by the matrix
+//     - matrix -> quaternion and quaternion -> Euler angles round trip, as do Inverse and Conjugate
+//     - Slerp starts and ends on its rotations and turns at a constant rate in between
+//     - a transform's matrix is scale * rotation * translation, splitting that matrix gives the transform back,
+//       and combining, inverting and transforming points match the matrices
+//
+// Build from the repository root, e.g. on Linux:
+//     g++ -std=c++14 -O2 -IMath -I. Tests/QuaternionTest.cpp Math/*.cpp CVector4.cpp -pthread -o QuaternionTest
+// or with Visual Studio (x64 Native Tools prompt):
+//     cl /std:c++14 /O2 /EHsc /IMath /I. Tests\QuaternionTest.cpp Math\*.cpp CVector4.cpp /Fe:QuaternionTest.exe
+// Exit code is 0 if all checks pass
+
+#include "Check.hpp"
+#include "CQuaternion.hpp"
+#include "CTransform.hpp"
+#include "MathHelpers.hpp"
+#include "CRandom.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace umbra_engine;
+using namespace umbra_engine::maths;
+
+namespace
+{
+const int NUM_ROTATIONS = 1000;
+const float TOLERANCE = 1e-4f;
+
+CRandom gRandom(3);
+
+CVector3 RandomVector(float range)
+{
+	return { gRandom.Range(-range, range), gRandom.Range(-range, range), gRandom.Range(-range, range) };
+}
+
+// Euler angles away from gimbal lock, so they can be recovered
+CVector3 RandomEuler()
+{
+	return { gRandom.Range(-1.5f, 1.5f), gRandom.Range(-PI, PI), gRandom.Range(-PI, PI) };
+}
+
+CQuaternion RandomRotation()
+{
+	return QuaternionFromEuler({ gRandom.Range(-PI, PI), gRandom.Range(-PI, PI), gRandom.Range(-PI, PI) });
+}
+
+CVector3 MatrixTransform(const CMatrix4x4& m, const CVector3& v, float w)
+{
+	return { v.x * m.e00 + v.y * m.e10 + v.z * m.e20 + w * m.e30,
+	         v.x * m.e01 + v.y * m.e11 + v.z * m.e21 + w * m.e31,
+	         v.x * m.e02 + v.y * m.e12 + v.z * m.e22 + w * m.e32 };
+}
+
+bool Near(float a, float b, float tolerance = TOLERANCE)
+{
+	return std::abs(a - b) <= tolerance * std::max(1.0f, std::abs(a));
+}
+
+bool Near(const CVector3& a, const CVector3& b, float tolerance = TOLERANCE)
+{
+	return Near(a.x, b.x, tolerance) && Near(a.y, b.y, tolerance) && Near(a.z, b.z, tolerance);
+}
+
+bool Near(const CMatrix4x4& a, const CMatrix4x4& b, float tolerance = TOLERANCE)
+{
+	const float* ea = &a.e00;
+	const float* eb = &b.e00;
+	for (int i = 0; i < 16; ++i)
+	{
+		if (!Near(ea[i], eb[i], tolerance)) return false;
+	}
+	return true;
+}
+
+// q and -q are the same rotation
+bool SameRotation(const CQuaternion& a, const CQuaternion& b)
+{
+	return std::abs(std::abs(Dot(a, b)) - 1.0f) < TOLERANCE;
+}
+
+// Angle between two rotations
+float AngleBetween(const CQuaternion& a, const CQuaternion& b)
+{
+	return 2.0f * std::acos(std::min(std::abs(Dot(a, b)), 1.0f));
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Tests
+-----------------------------------------------------------------------------------------*/
+
+void TestRotations()
+{
+	int builderErrors = 0, productErrors = 0, roundTripErrors = 0, inverseErrors = 0;
+	for (int i = 0; i < NUM_ROTATIONS; ++i)
+	{
+		float angle = gRandom.Range(-PI, PI);
+		if (!Near(MatrixRotation(QuaternionRotationX(angle)), MatrixRotationX(angle))) ++builderErrors;
+		if (!Near(MatrixRotation(QuaternionRotationY(angle)), MatrixRotationY(angle))) ++builderErrors;
+		if (!Near(MatrixRotation(QuaternionRotationZ(angle)), MatrixRotationZ(angle))) ++builderErrors;
+		if (!SameRotation(QuaternionRotationAxis({ 0.0f, 1.0f, 0.0f }, angle), QuaternionRotationY(angle))) ++builderErrors;
+
+		CVector3 euler = RandomEuler();
+		CMatrix4x4 eulerMatrix = MatrixRotationZ(euler.z) * MatrixRotationX(euler.x) * MatrixRotationY(euler.y);
+		CQuaternion q = QuaternionFromEuler(euler);
+		if (!Near(MatrixRotation(q), eulerMatrix)) ++builderErrors;
+		if (!SameRotation(QuaternionFromEulerFast(euler), q)) ++builderErrors;
+		if (!Near(MatrixRotation(QuaternionFromAxes(eulerMatrix.GetXAxis(), eulerMatrix.GetYAxis(), eulerMatrix.GetZAxis())), eulerMatrix)) ++builderErrors;
+
+		// Combining, rotating and assigning
+		CQuaternion r = RandomRotation();
+		if (!Near(MatrixRotation(q * r), MatrixRotation(q) * MatrixRotation(r))) ++productErrors;
+		CQuaternion combined = q;
+		combined *= r;
+		if (!SameRotation(combined, q * r)) ++productErrors;
+		CVector3 v = RandomVector(10.0f);
+		if (!Near(Rotate(q, v), MatrixTransform(MatrixRotation(q), v, 0.0f))) ++productErrors;
+
+		// Round trips
+		if (!SameRotation(QuaternionFromMatrix(MatrixRotation(q)), q)) ++roundTripErrors;
+		if (!Near(EulerAngles(q), euler)) ++roundTripErrors;
+		if (!Near(Length(q), 1.0f)) ++roundTripErrors;
+		CQuaternion scaled = { q.x * 3.0f, q.y * 3.0f, q.z * 3.0f, q.w * 3.0f };
+		if (!SameRotation(Normalise(scaled), q)) ++roundTripErrors;
+
+		if (!SameRotation(q * Conjugate(q), QuaternionIdentity())) ++inverseErrors;
+		if (!SameRotation(scaled * Inverse(scaled), QuaternionIdentity())) ++inverseErrors;
+		if (!Near(Rotate(Conjugate(q), Rotate(q, v)), v)) ++inverseErrors;
+	}
+	CHECK(builderErrors == 0);
+	CHECK(productErrors == 0);
+	CHECK(roundTripErrors == 0);
+	CHECK(inverseErrors == 0);
+}
+
+void TestSlerp()
+{
+	int problems = 0;
+	for (int i = 0; i < NUM_ROTATIONS; ++i)
+	{
+		CQuaternion q1 = RandomRotation();
+		CQuaternion q2 = RandomRotation();
+		if (!SameRotation(Slerp(q1, q2, 0.0f), q1) || !SameRotation(Slerp(q1, q2, 1.0f), q2)) ++problems;
+
+		// Constant rate the short way round, even when q2 is given as -q2
+		float total = AngleBetween(q1, q2);
+		float t = gRandom.NextFloat();
+		CQuaternion negated = { -q2.x, -q2.y, -q2.z, -q2.w };
+		CQuaternion q = Slerp(q1, negated, t);
+		if (!Near(Length(q), 1.0f)) ++problems;
+		if (std::abs(AngleBetween(q1, q) - t * total) > 1e-3f || std::abs(AngleBetween(q, q2) - (1.0f - t) * total) > 1e-3f) ++problems;
+	}
+	CHECK(problems == 0);
+
+	// Nearly equal rotations take the linear path without dividing by ~0
+	CQuaternion q = RandomRotation();
+	CQuaternion nearQ = Normalise(q * QuaternionRotationX(1e-4f));
+	CQuaternion halfway = Slerp(q, nearQ, 0.5f);
+	CHECK(std::isfinite(halfway.w) && SameRotation(halfway, q));
+}
+
+void TestTransforms()
+{
+	int matrixErrors = 0, combineErrors = 0, inverseErrors = 0, pointErrors = 0;
+	for (int i = 0; i < NUM_ROTATIONS; ++i)
+	{
+		CVector3 scale = { gRandom.Range(0.1f, 5.0f), gRandom.Range(0.1f, 5.0f), gRandom.Range(0.1f, 5.0f) };
+		CTransform t(RandomVector(100.0f), RandomRotation(), scale);
+		CMatrix4x4 m = MatrixScaling(scale) * MatrixRotation(t.rotation) * MatrixTranslation(t.position);
+		if (!Near(t.ToMatrix(), m)) ++matrixErrors;
+		if (!Near(t.GetXAxis(), m.GetXAxis()) || !Near(t.GetYAxis(), m.GetYAxis()) || !Near(t.GetZAxis(), m.GetZAxis())) ++matrixErrors;
+
+		CTransform split = TransformFromMatrix(m);
+		if (!Near(split.position, t.position) || !SameRotation(split.rotation, t.rotation) || !Near(split.scale, t.scale, 1e-3f)) ++matrixErrors;
+
+		// Combining with a uniformly scaled transform is exact
+		float uniform = gRandom.Range(0.1f, 5.0f);
+		CTransform u(RandomVector(100.0f), RandomRotation(), { uniform, uniform, uniform });
+		if (!Near((t * u).ToMatrix(), t.ToMatrix() * u.ToMatrix(), 1e-3f)) ++combineErrors;
+		if (!Near((u * TransformIdentity()).ToMatrix(), u.ToMatrix())) ++combineErrors;
+
+		CTransform inverse = Inverse(u);
+		CVector3 p = RandomVector(100.0f);
+		if (!Near(TransformPoint(inverse, TransformPoint(u, p)), p, 1e-3f)) ++inverseErrors;
+		if (!Near(inverse.ToMatrix(), InverseAffine(u.ToMatrix()), 1e-3f)) ++inverseErrors;
+
+		if (!Near(TransformPoint(t, p), MatrixTransform(m, p, 1.0f), 1e-3f)) ++pointErrors;
+		if (!Near(TransformDirection(t, p), MatrixTransform(m, p, 0.0f), 1e-3f)) ++pointErrors;
+
+		// Local rotations happen before the current rotation, world ones after
+		CQuaternion r = RandomRotation();
+		CTransform local = t, world = t;
+		local.RotateLocal(r);
+		world.RotateWorld(r);
+		if (!SameRotation(local.rotation, r * t.rotation) || !SameRotation(world.rotation, t.rotation * r)) ++pointErrors;
+	}
+	CHECK(matrixErrors == 0);
+	CHECK(combineErrors == 0);
+	CHECK(inverseErrors == 0);
+	CHECK(pointErrors == 0);
+}
+}
+
+
+int main()
+{
+	TestRotations();
+	TestSlerp();
+	TestTransforms();
+	return test::TestResult();
+}
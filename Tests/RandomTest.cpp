@@ -0,0 +1,198 @@
+//--------------------------------------------------------------------------------------
+// Random number generator tests
+//--------------------------------------------------------------------------------------
+// Checks CRandom:
+//     - the same seed always gives the same sequence, Seed restarts it, and different seeds give different ones
+//     - NextFloat stays in [0, 1) and Range in [a, b], spread evenly across the range, with every bit of Next
+//       set about half the time
+//     - Fill gives exactly the values calling Range would, with every instruction set the CPU supports, for
+//       strided output and after values have already been taken one at a time
+//     - ThreadRandom gives each thread its own generator
+//
+// Build from the repository root, e.g. on Linux:
+//     g++ -std=c++14 -O2 -IMath -I. Tests/RandomTest.cpp Math/*.cpp CVector4.cpp -pthread -o RandomTest
+// or with Visual Studio (x64 Native Tools prompt):
+//     cl /std:c++14 /O2 /EHsc /IMath /I. Tests\RandomTest.cpp Math\*.cpp CVector4.cpp /Fe:RandomTest.exe
+// Exit code is 0 if all checks pass
+
+#include "Check.hpp"
+#include "CRandom.hpp"
+#include "SIMD.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+using namespace umbra_engine;
+using namespace umbra_engine::maths;
+
+namespace
+{
+const int NUM_VALUES = 200000;
+const int NUM_BUCKETS = 16;
+
+bool BitIdentical(float a, float b)
+{
+	return std::memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+// Instruction sets supported by this CPU, narrowest first
+std::vector<simd::EInstructionSet> SupportedInstructionSets()
+{
+	std::vector<simd::EInstructionSet> sets;
+	for (int i = 0; i <= static_cast<int>(simd::DetectInstructionSet()); ++i)
+	{
+		sets.push_back(static_cast<simd::EInstructionSet>(i));
+	}
+	return sets;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Tests
+-----------------------------------------------------------------------------------------*/
+
+void TestSequences()
+{
+	CRandom a(1234), b(1234), c(1235);
+	int differences = 0, sameAsOtherSeed = 0;
+	std::vector<uint32_t> first;
+	for (int i = 0; i < 1000; ++i)
+	{
+		uint32_t value = a.Next();
+		first.push_back(value);
+		if (b.Next() != value) ++differences;
+		if (c.Next() == value) ++sameAsOtherSeed;
+	}
+	CHECK(differences == 0);
+	CHECK(sameAsOtherSeed < 3);
+
+	// Seeding again restarts the sequence
+	a.Seed(1234);
+	differences = 0;
+	for (auto value : first)
+	{
+		if (a.Next() != value) ++differences;
+	}
+	CHECK(differences == 0);
+
+	// Seed 0 (the default) isn't stuck
+	CRandom zero;
+	uint32_t firstZero = zero.Next();
+	bool changes = false;
+	for (int i = 0; i < 10; ++i) changes = changes || zero.Next() != firstZero;
+	CHECK(changes);
+}
+
+void TestDistribution()
+{
+	CRandom random(99);
+	int buckets[NUM_BUCKETS] = {};
+	int bitCounts[32] = {};
+	int outOfRange = 0;
+	double sum = 0.0;
+	for (int i = 0; i < NUM_VALUES; ++i)
+	{
+		float f = random.NextFloat();
+		if (!(f >= 0.0f && f < 1.0f)) ++outOfRange;
+		sum += f;
+		++buckets[static_cast<int>(f * NUM_BUCKETS)];
+
+		float r = random.Range(-3.0f, 5.0f);
+		if (!(r >= -3.0f && r <= 5.0f)) ++outOfRange;
+
+		uint32_t bits = random.Next();
+		for (int bit = 0; bit < 32; ++bit) bitCounts[bit] += (bits >> bit) & 1;
+	}
+	CHECK(outOfRange == 0);
+	CHECK(std::abs(sum / NUM_VALUES - 0.5) < 0.005);
+
+	// Each bucket within 5% of its share, each bit set within 2% of half the time
+	bool even = true;
+	for (int count : buckets) even = even && std::abs(count - NUM_VALUES / NUM_BUCKETS) < NUM_VALUES / NUM_BUCKETS / 20;
+	CHECK(even);
+	bool balanced = true;
+	for (int count : bitCounts) balanced = balanced && std::abs(count - NUM_VALUES / 2) < NUM_VALUES / 50;
+	CHECK(balanced);
+}
+
+// Fill gives the values Range would, in the same order
+void TestFill(simd::EInstructionSet set)
+{
+	simd::SetInstructionSet(set);
+	std::printf("%s fill\n", simd::InstructionSetName(set));
+
+	int mismatches = 0;
+	for (size_t count : { size_t(0), size_t(1), size_t(3), size_t(4), size_t(9), size_t(1001) })
+	{
+		for (int taken = 0; taken < 5; ++taken) // Values already taken one at a time, leaving some of a step unused
+		{
+			CRandom sequential(7), filled(7);
+			for (int i = 0; i < taken; ++i)
+			{
+				sequential.Next();
+				filled.Next();
+			}
+
+			std::vector<float> expected(count), packed(count);
+			for (auto& value : expected) value = sequential.Range(-2.0f, 10.0f);
+			filled.Fill(packed.data(), -2.0f, 10.0f, count);
+			for (size_t i = 0; i < count; ++i)
+			{
+				if (!BitIdentical(expected[i], packed[i])) ++mismatches;
+			}
+
+			// Both carry on with the same sequence afterwards
+			if (sequential.Next() != filled.Next()) ++mismatches;
+
+			// Into a member of a structure, leaving the rest alone
+			struct SParticle { float life; float size; };
+			std::vector<SParticle> particles(count, SParticle{ -1.0f, -1.0f });
+			CRandom strided(7);
+			for (int i = 0; i < taken; ++i) strided.Next();
+			if (count > 0) strided.Fill(&particles[0].size, sizeof(SParticle), -2.0f, 10.0f, count);
+			for (size_t i = 0; i < count; ++i)
+			{
+				if (!BitIdentical(expected[i], particles[i].size) || particles[i].life != -1.0f) ++mismatches;
+			}
+		}
+	}
+	CHECK(mismatches == 0);
+
+	simd::SetInstructionSet(simd::DetectInstructionSet());
+}
+
+void TestThreadRandom()
+{
+	CRandom* mainGenerator = &ThreadRandom();
+	CHECK(mainGenerator == &ThreadRandom());
+
+	CRandom* otherGenerator = nullptr;
+	uint32_t otherValues[4] = {};
+	std::thread other([&]()
+	{
+		otherGenerator = &ThreadRandom();
+		for (auto& value : otherValues) value = otherGenerator->Next();
+	});
+	other.join();
+
+	CHECK(otherGenerator != mainGenerator);
+	uint32_t mainValues[4];
+	for (auto& value : mainValues) value = mainGenerator->Next();
+	CHECK(std::memcmp(mainValues, otherValues, sizeof(mainValues)) != 0);
+}
+}
+
+
+int main()
+{
+	TestSequences();
+	TestDistribution();
+	for (simd::EInstructionSet set : SupportedInstructionSets())
+	{
+		TestFill(set);
+	}
+	TestThreadRandom();
+	return test::TestResult();
+}
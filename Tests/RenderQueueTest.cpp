@@ -0,0 +1,277 @@
+//--------------------------------------------------------------------------------------
+// Render queue tests
+//--------------------------------------------------------------------------------------
+// Checks the keys and sorting of CRenderQueue:
+//     - unpacking a packed key gives back its pass, blend and ids
+//     - after Sort, opaque draws come first, grouped by state and front to back within each group, and
+//       blended draws come after them back to front whatever their state
+//     - the radix sort gives the same order as std::stable_sort by key for random keys, so equal keys keep
+//       the order they were submitted in
+//     - BatchEnd splits the sorted queue into runs of one state and mesh, one run per opaque state and mesh however
+//       many draws share it, so instanced draw calls grow with the number of unique meshes, not of models
+//     - zero, negative and NaN depths sort as 0 and the largest depths sort last, as do queues of 0 and 1
+//       items and queues where every key is the same
+//
+// Build from the repository root, e.g. on Linux:
+//     g++ -std=c++14 -O2 -IMath -I. Tests/RenderQueueTest.cpp Math/*.cpp CVector4.cpp -pthread -o RenderQueueTest
+// or with Visual Studio (x64 Native Tools prompt):
+//     cl /std:c++14 /O2 /EHsc /IMath /I. Tests\RenderQueueTest.cpp Math\*.cpp CVector4.cpp /Fe:RenderQueueTest.exe
+// Exit code is 0 if all checks pass
+
+#include "Check.hpp"
+#include "CRenderQueue.hpp"
+#include "CRandom.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+using namespace umbra_engine;
+using namespace umbra_engine::maths;
+
+namespace
+{
+const int NUM_DRAWS = 5000;
+const int NUM_STATES = 6; // Few states, so many draws share each one
+
+// Keys keep about 5 significant figures of depth, so nearly equal depths can be in either order
+const float DEPTH_TOLERANCE = 1e-4f;
+
+CRandom gRandom(23);
+
+uint32_t RandomId(uint32_t count)
+{
+	return gRandom.Next() % count;
+}
+
+SRenderKey RandomKey(ERenderPass pass, uint32_t numStates)
+{
+	return { pass, RandomId(4), RandomId(numStates), RandomId(numStates), RandomId(numStates), gRandom.Range(0.1f, 1000.0f) };
+}
+
+bool SameParts(const SRenderKey& a, const SRenderKey& b)
+{
+	return a.pass == b.pass && a.blend == b.blend && a.shader == b.shader && a.textures == b.textures && a.mesh == b.mesh;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Tests
+-----------------------------------------------------------------------------------------*/
+
+void TestPackUnpack()
+{
+	int problems = 0;
+	for (int i = 0; i < NUM_DRAWS; ++i)
+	{
+		ERenderPass pass = (i % 2 == 0) ? ERenderPass::Opaque : ERenderPass::Blended;
+		SRenderKey key = RandomKey(pass, CRenderQueue::SharedId + 1);
+		SRenderKey unpacked = CRenderQueue::UnpackKey(CRenderQueue::PackKey(key));
+		if (!SameParts(key, unpacked) || unpacked.depth != 0.0f) ++problems;
+
+		// Depth doesn't change the state
+		SRenderKey moved = key;
+		moved.depth *= 2.0f;
+		if (!CRenderQueue::SameState(CRenderQueue::PackKey(key), CRenderQueue::PackKey(moved))) ++problems;
+		moved.mesh = (key.mesh + 1) & CRenderQueue::SharedId;
+		if (CRenderQueue::SameState(CRenderQueue::PackKey(key), CRenderQueue::PackKey(moved))) ++problems;
+	}
+	CHECK(problems == 0);
+}
+
+// Opaque draws grouped by state, front to back in each group, then blended draws back to front
+void TestDrawOrder()
+{
+	CRenderQueue queue;
+	std::vector<SRenderKey> keys;
+	for (int i = 0; i < NUM_DRAWS; ++i)
+	{
+		keys.push_back(RandomKey(gRandom.NextFloat() < 0.7f ? ERenderPass::Opaque : ERenderPass::Blended, NUM_STATES));
+		queue.Submit(keys.back(), i);
+	}
+	queue.Sort();
+
+	const auto& items = queue.Items();
+	CHECK(items.size() == keys.size());
+
+	int problems = 0;
+	std::vector<SRenderKey> finishedStates; // Opaque states whose run of draws has ended
+	for (size_t i = 1; i < items.size(); ++i)
+	{
+		const SRenderKey& previous = keys[items[i - 1].index];
+		const SRenderKey& current = keys[items[i].index];
+		if (previous.pass == ERenderPass::Blended)
+		{
+			// Back to front, whatever the state
+			if (current.pass != ERenderPass::Blended || current.depth > previous.depth * (1.0f + DEPTH_TOLERANCE)) ++problems;
+		}
+		else if (current.pass == ERenderPass::Opaque)
+		{
+			if (SameParts(previous, current))
+			{
+				if (current.depth < previous.depth * (1.0f - DEPTH_TOLERANCE)) ++problems; // Front to back
+			}
+			else
+			{
+				// A state never comes back once its run has ended
+				finishedStates.push_back(previous);
+				for (const auto& finished : finishedStates)
+				{
+					if (SameParts(finished, current)) ++problems;
+				}
+			}
+		}
+	}
+	CHECK(problems == 0);
+	CHECK(finishedStates.size() > 1);
+}
+
+// The radix sort orders items as a stable sort by key does
+void TestMatchesStableSort()
+{
+	int problems = 0;
+	for (int run = 0; run < 20; ++run)
+	{
+		// Few states in some runs, so there are many equal keys, many in others, so most bytes vary
+		uint32_t numStates = (run % 2 == 0) ? 2 : CRenderQueue::SharedId + 1;
+		CRenderQueue queue;
+		std::vector<SRenderItem> expected;
+		for (int i = 0; i < NUM_DRAWS; ++i)
+		{
+			SRenderKey key = RandomKey(gRandom.NextFloat() < 0.5f ? ERenderPass::Opaque : ERenderPass::Blended, numStates);
+			if (numStates == 2) key.depth = static_cast<float>(RandomId(4)); // Repeated depths, including 0
+			queue.Submit(key, i);
+			expected.push_back({ CRenderQueue::PackKey(key), static_cast<uint32_t>(i) });
+		}
+		queue.Sort();
+		std::stable_sort(expected.begin(), expected.end(), [](const SRenderItem& a, const SRenderItem& b) { return a.key < b.key; });
+
+		const auto& items = queue.Items();
+		for (size_t i = 0; i < expected.size(); ++i)
+		{
+			if (items[i].key != expected[i].key || items[i].index != expected[i].index) ++problems;
+		}
+	}
+	CHECK(problems == 0);
+}
+
+// Sorted opaque draws make one instanced batch per state and mesh
+void TestBatches()
+{
+	for (int numStates : { 1, NUM_STATES, 40 })
+	{
+		CRenderQueue queue;
+		std::vector<SRenderKey> keys;
+		std::vector<std::vector<uint32_t>> opaqueStates; // Distinct blend, shader, textures, mesh
+		for (int i = 0; i < NUM_DRAWS; ++i)
+		{
+			keys.push_back(RandomKey(i % 4 == 0 ? ERenderPass::Blended : ERenderPass::Opaque, numStates));
+			queue.Submit(keys.back(), i);
+			const SRenderKey& key = keys.back();
+			std::vector<uint32_t> state = { key.blend, key.shader, key.textures, key.mesh };
+			if (key.pass == ERenderPass::Opaque && std::find(opaqueStates.begin(), opaqueStates.end(), state) == opaqueStates.end())
+			{
+				opaqueStates.push_back(state);
+			}
+		}
+		queue.Sort();
+
+		const auto& items = queue.Items();
+		int problems = 0, numOpaqueBatches = 0;
+		size_t covered = 0;
+		for (size_t first = 0; first < items.size(); first = queue.BatchEnd(first))
+		{
+			size_t end = queue.BatchEnd(first);
+			if (end <= first || end > items.size() || first != covered) ++problems;
+			covered = end;
+			for (size_t i = first + 1; i < end; ++i)
+			{
+				if (!SameParts(keys[items[first].index], keys[items[i].index])) ++problems;
+			}
+			if (end < items.size() && SameParts(keys[items[first].index], keys[items[end].index])) ++problems; // Runs are as long as they can be
+			if (keys[items[first].index].pass == ERenderPass::Opaque) ++numOpaqueBatches;
+		}
+		CHECK(problems == 0);
+		CHECK(covered == items.size());
+		CHECK(numOpaqueBatches == static_cast<int>(opaqueStates.size()));
+	}
+
+	CRenderQueue single;
+	single.Submit(RandomKey(ERenderPass::Opaque, NUM_STATES), 0);
+	single.Sort();
+	CHECK(single.BatchEnd(0) == 1);
+}
+
+void TestEdgeCases()
+{
+	SRenderKey key = { ERenderPass::Opaque, 1, 2, 3, 4, 0.0f };
+	uint64_t zeroDepth = CRenderQueue::PackKey(key);
+	key.depth = -5.0f;
+	CHECK(CRenderQueue::PackKey(key) == zeroDepth);
+	key.depth = std::numeric_limits<float>::quiet_NaN();
+	CHECK(CRenderQueue::PackKey(key) == zeroDepth);
+	key.depth = std::numeric_limits<float>::denorm_min(); // Below the depth bits kept
+	CHECK(CRenderQueue::PackKey(key) == zeroDepth);
+
+	// The largest depths are still in order, and don't spill into the state bits
+	key.depth = std::numeric_limits<float>::max();
+	uint64_t maxDepth = CRenderQueue::PackKey(key);
+	key.depth = std::numeric_limits<float>::infinity();
+	uint64_t infiniteDepth = CRenderQueue::PackKey(key);
+	CHECK(zeroDepth < maxDepth && maxDepth <= infiniteDepth);
+	CHECK(CRenderQueue::SameState(zeroDepth, infiniteDepth));
+
+	key.pass = ERenderPass::Blended;
+	key.depth = 0.0f;
+	uint64_t blendedNear = CRenderQueue::PackKey(key);
+	key.depth = std::numeric_limits<float>::infinity();
+	uint64_t blendedFar = CRenderQueue::PackKey(key);
+	CHECK(blendedFar < blendedNear && blendedFar > infiniteDepth);
+	CHECK(CRenderQueue::SameState(blendedNear, blendedFar));
+
+	// Empty and single item queues
+	CRenderQueue queue;
+	queue.Sort();
+	CHECK(queue.Items().empty());
+	queue.Submit(key, 7);
+	queue.Sort();
+	CHECK(queue.Items().size() == 1 && queue.Items()[0].index == 7);
+
+	// Every key the same, so every byte is skipped and the submitted order is kept
+	queue.Clear();
+	for (uint32_t i = 0; i < 100; ++i)
+	{
+		queue.Submit(key, i);
+	}
+	queue.Sort();
+	bool inOrder = true;
+	for (uint32_t i = 0; i < 100; ++i)
+	{
+		inOrder = inOrder && queue.Items()[i].index == i;
+	}
+	CHECK(inOrder);
+
+	// Ids are the same for the same pointers, and shared once they run out
+	int a = 0, b = 0;
+	CHECK(queue.MeshId(&a) == 0 && queue.MeshId(&b) == 1 && queue.MeshId(&a) == 0);
+	CHECK(queue.ShaderId(&a, &b) != queue.ShaderId(&b, &a));
+	std::vector<char> meshes(CRenderQueue::SharedId + 10);
+	for (auto& mesh : meshes)
+	{
+		queue.MeshId(&mesh);
+	}
+	CHECK(queue.MeshId(&meshes.back()) == CRenderQueue::SharedId);
+}
+}
+
+
+int main()
+{
+	TestPackUnpack();
+	TestDrawOrder();
+	TestMatchesStableSort();
+	TestBatches();
+	TestEdgeCases();
+	return test::TestResult();
+}
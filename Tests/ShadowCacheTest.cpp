@@ -0,0 +1,157 @@
+//--------------------------------------------------------------------------------------
+// Shadow cache tests
+//--------------------------------------------------------------------------------------
+// Checks that CShadowCache only reports a shadow map as out of date when rendering it again would change it:
+//     - nothing rendered yet is out of date, and marking a map rendered brings it up to date
+//     - the same casters in any order, with the same matrix, keep the map up to date
+//     - a caster's revision changing, a caster arriving or leaving, or the matrix changing (even slightly)
+//       makes it out of date, until it is marked rendered again
+//     - Invalidate makes it out of date whatever it is compared with
+//
+// Build from the repository root, e.g. on Linux:
+//     g++ -std=c++14 -O2 -IMath -I. Tests/ShadowCacheTest.cpp ShadowCache.cpp Math/*.cpp CVector4.cpp -pthread -o ShadowCacheTest
+// or with Visual Studio (x64 Native Tools prompt):
+//     cl /std:c++14 /O2 /EHsc /IMath /I. Tests\ShadowCacheTest.cpp ShadowCache.cpp Math\*.cpp CVector4.cpp /Fe:ShadowCacheTest.exe
+// Exit code is 0 if all checks pass
+
+#include "Check.hpp"
+#include "ShadowCache.hpp"
+#include "MathTables.hpp"
+#include "MathHelpers.hpp"
+#include "CRandom.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace umbra_engine;
+using namespace umbra_engine::maths;
+
+namespace
+{
+const int NUM_CASTERS = 20;
+const int NUM_ROUNDS = 200;
+
+CRandom gRandom(18);
+
+// Stands in for a model: moving it bumps its revision
+class CFakeCaster
+{
+public:
+	unsigned int GetRevision() const { return mRevision; }
+	void Move() { ++mRevision; }
+
+private:
+	unsigned int mRevision = 0;
+};
+
+CMatrix4x4 RandomViewProjection()
+{
+	CVector3 position = { gRandom.Range(-100.0f, 100.0f), gRandom.Range(-100.0f, 100.0f), gRandom.Range(-100.0f, 100.0f) };
+	CMatrix4x4 world = MatrixRotationX(gRandom.Range(-1.0f, 1.0f)) * MatrixRotationY(gRandom.Range(-PI, PI)) * MatrixTranslation(position);
+	return InverseAffine(world) * MatrixPerspective(1.0f, 1.0f, 1.0f, 500.0f);
+}
+
+// The same casters in a random order
+std::vector<CFakeCaster*> Shuffled(std::vector<CFakeCaster*> casters)
+{
+	for (size_t i = casters.size(); i > 1; --i)
+	{
+		std::swap(casters[i - 1], casters[gRandom.Next() % i]);
+	}
+	return casters;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Tests
+-----------------------------------------------------------------------------------------*/
+
+void TestUpToDate()
+{
+	std::vector<CFakeCaster> models(NUM_CASTERS);
+	std::vector<CFakeCaster*> casters;
+	for (auto& model : models) casters.push_back(&model);
+	CMatrix4x4 viewProjection = RandomViewProjection();
+
+	CShadowCache cache;
+	CHECK(cache.IsOutOfDate(viewProjection, casters));
+	CHECK(cache.IsOutOfDate(viewProjection, std::vector<CFakeCaster*>()));
+
+	cache.MarkRendered(viewProjection, casters);
+	CHECK(!cache.IsOutOfDate(viewProjection, casters));
+
+	// Spatial queries return casters in any order
+	int problems = 0;
+	for (int round = 0; round < NUM_ROUNDS; ++round)
+	{
+		if (cache.IsOutOfDate(viewProjection, Shuffled(casters))) ++problems;
+	}
+	CHECK(problems == 0);
+
+	// No casters at all is a valid shadow map too
+	CShadowCache empty;
+	empty.MarkRendered(viewProjection, std::vector<CFakeCaster*>());
+	CHECK(!empty.IsOutOfDate(viewProjection, std::vector<CFakeCaster*>()));
+	CHECK(empty.IsOutOfDate(viewProjection, casters));
+}
+
+void TestInvalidation()
+{
+	std::vector<CFakeCaster> models(NUM_CASTERS + 1);
+	std::vector<CFakeCaster*> casters;
+	for (int i = 0; i < NUM_CASTERS; ++i) casters.push_back(&models[i]);
+	CFakeCaster* outsider = &models[NUM_CASTERS];
+
+	int missed = 0, stale = 0;
+	for (int round = 0; round < NUM_ROUNDS; ++round)
+	{
+		CMatrix4x4 viewProjection = RandomViewProjection();
+		CShadowCache cache;
+		cache.MarkRendered(viewProjection, casters);
+
+		// A caster moving
+		CFakeCaster* moved = casters[gRandom.Next() % casters.size()];
+		moved->Move();
+		if (!cache.IsOutOfDate(viewProjection, Shuffled(casters))) ++missed;
+		cache.MarkRendered(viewProjection, casters);
+		if (cache.IsOutOfDate(viewProjection, casters)) ++stale;
+
+		// A caster arriving in the light's volume, and one leaving it
+		std::vector<CFakeCaster*> arrived = casters;
+		arrived.push_back(outsider);
+		if (!cache.IsOutOfDate(viewProjection, Shuffled(arrived))) ++missed;
+		std::vector<CFakeCaster*> left(casters.begin() + 1, casters.end());
+		if (!cache.IsOutOfDate(viewProjection, left)) ++missed;
+
+		// One leaving as another arrives, keeping the count the same
+		std::vector<CFakeCaster*> swapped = casters;
+		swapped[gRandom.Next() % swapped.size()] = outsider;
+		if (!cache.IsOutOfDate(viewProjection, Shuffled(swapped))) ++missed;
+
+		// The light moving the smallest amount
+		CMatrix4x4 nudged = viewProjection;
+		nudged.e30 = std::nextafter(nudged.e30, 1e10f);
+		if (!cache.IsOutOfDate(nudged, casters)) ++missed;
+		if (!cache.IsOutOfDate(RandomViewProjection(), casters)) ++missed;
+
+		// None of the checks above changed what was recorded
+		if (cache.IsOutOfDate(viewProjection, Shuffled(casters))) ++stale;
+
+		cache.Invalidate();
+		if (!cache.IsOutOfDate(viewProjection, casters)) ++missed;
+		cache.MarkRendered(viewProjection, casters);
+		if (cache.IsOutOfDate(viewProjection, casters)) ++stale;
+	}
+	CHECK(missed == 0);
+	CHECK(stale == 0);
+}
+}
+
+
+int main()
+{
+	TestUpToDate();
+	TestInvalidation();
+	return test::TestResult();
+}
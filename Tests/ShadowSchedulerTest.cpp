@@ -0,0 +1,290 @@
+//--------------------------------------------------------------------------------------
+// Shadow scheduler tests
+//--------------------------------------------------------------------------------------
+// Runs CShadowScheduler the way CScene::UpdateShadowMaps does - each frame every out of date shadow map / cube
+// face is requested and the scheduled ones are rendered - and checks that:
+//     - updates are scheduled in order of screen contribution, requests with equal contributions in the order
+//       they were made, up to the update budget
+//     - the draw call budget passes over updates too large to fit while smaller ones after them still fit, and
+//       one update is always scheduled however large it is
+//     - an update kept waiting gains priority each frame until it beats even a full screen contribution, and
+//       forgets its wait when it is no longer requested
+//     - the stats add up, and ScreenContribution falls with distance and is 1 inside the bounds, 0 for none
+//     - all six cube faces of a point light are scheduled, each once, within the frames the budget allows,
+//       alongside other lights' shadow maps
+//     - the depth main_ps works out for a point light (pointShadowDepth and the largest axis of the direction
+//       from the light) is the depth CUBE_FACE_PROJECTION gives the face the direction falls in
+//
+// Build from the repository root, e.g. on Linux:
+//     g++ -std=c++14 -O2 -IMath -I. Tests/ShadowSchedulerTest.cpp ShadowScheduler.cpp Math/*.cpp CVector4.cpp -pthread -o ShadowSchedulerTest
+// or with Visual Studio (x64 Native Tools prompt):
+//     cl /std:c++14 /O2 /EHsc /IMath /I. Tests\ShadowSchedulerTest.cpp ShadowScheduler.cpp Math\*.cpp CVector4.cpp /Fe:ShadowSchedulerTest.exe
+// Exit code is 0 if all checks pass
+
+#include "Check.hpp"
+#include "ShadowScheduler.hpp"
+#include "MathTables.hpp"
+#include "CVector4.hpp"
+#include "CRandom.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace umbra_engine;
+using namespace umbra_engine::maths;
+
+namespace
+{
+const int NUM_FACES = 6;
+const int NUM_POSES = 1000;
+
+CRandom gRandom(22);
+
+// Clip space position of a point, before the perspective divide
+CVector4 Project(const CMatrix4x4& m, const CVector3& p)
+{
+	return { p.x * m.e00 + p.y * m.e10 + p.z * m.e20 + m.e30,
+	         p.x * m.e01 + p.y * m.e11 + p.z * m.e21 + m.e31,
+	         p.x * m.e02 + p.y * m.e12 + p.z * m.e22 + m.e32,
+	         p.x * m.e03 + p.y * m.e13 + p.z * m.e23 + m.e33 };
+}
+
+// A light with some out of date shadow maps / faces, as the scene sees it. Rendering a face brings it up to date
+struct SFakeLight
+{
+	int index;
+	std::vector<bool> outOfDate;
+	std::vector<int> timesRendered;
+
+	SFakeLight(int lightIndex, int numFaces)
+		: index(lightIndex), outOfDate(numFaces, true), timesRendered(numFaces, 0) {}
+};
+
+// One frame of CScene::UpdateShadowMaps. Returns the number of updates rendered
+int RunFrame(CShadowScheduler& scheduler, std::vector<SFakeLight>& lights)
+{
+	scheduler.BeginFrame();
+	for (const auto& light : lights)
+	{
+		for (int face = 0; face < static_cast<int>(light.outOfDate.size()); ++face)
+		{
+			if (light.outOfDate[face]) scheduler.Request(light.index, face, 0.5f, 10);
+		}
+	}
+
+	const auto& updates = scheduler.Schedule();
+	for (const auto& update : updates)
+	{
+		auto light = std::find_if(lights.begin(), lights.end(), [&](const SFakeLight& l) { return l.index == update.light; });
+		if (!CHECK(light != lights.end() && update.face >= 0 && update.face < static_cast<int>(light->outOfDate.size())))
+		{
+			continue;
+		}
+		CHECK(light->outOfDate[update.face]);
+		light->outOfDate[update.face] = false;
+		++light->timesRendered[update.face];
+	}
+	return static_cast<int>(updates.size());
+}
+
+
+// Schedule one frame of requests given as (light, contribution, drawCalls), returning the lights scheduled in order
+std::vector<int> ScheduleFrame(CShadowScheduler& scheduler, const std::vector<std::vector<float>>& requests)
+{
+	scheduler.BeginFrame();
+	for (const auto& request : requests)
+	{
+		scheduler.Request(static_cast<int>(request[0]), 0, request[1], static_cast<unsigned int>(request[2]));
+	}
+	std::vector<int> lights;
+	for (const auto& update : scheduler.Schedule()) lights.push_back(update.light);
+	return lights;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Tests
+-----------------------------------------------------------------------------------------*/
+
+// Highest contributions first, up to the update budget
+void TestPriority()
+{
+	int problems = 0;
+	for (int round = 0; round < 100; ++round)
+	{
+		const unsigned int maxUpdates = 1 + gRandom.Next() % 5;
+		CShadowScheduler scheduler(maxUpdates);
+		std::vector<std::vector<float>> requests;
+		std::vector<std::pair<float, int>> expected; // Contribution, light
+		int numRequests = static_cast<int>(gRandom.Next() % 12);
+		for (int light = 0; light < numRequests; ++light)
+		{
+			float contribution = static_cast<float>(gRandom.Next() % 4) * 0.25f; // Some equal contributions
+			requests.push_back({ static_cast<float>(light), contribution, 10.0f });
+			expected.push_back({ contribution, light });
+		}
+		std::stable_sort(expected.begin(), expected.end(), [](const std::pair<float, int>& a, const std::pair<float, int>& b) { return a.first > b.first; });
+		expected.resize(std::min<size_t>(expected.size(), maxUpdates));
+
+		std::vector<int> scheduled = ScheduleFrame(scheduler, requests);
+		if (scheduled.size() != expected.size()) ++problems;
+		for (size_t i = 0; i < std::min(scheduled.size(), expected.size()); ++i)
+		{
+			if (scheduled[i] != expected[i].second) ++problems;
+		}
+
+		const SShadowSchedulerStats& stats = scheduler.GetStats();
+		if (stats.numRequested != static_cast<unsigned int>(numRequests) || stats.numScheduled != scheduled.size() ||
+		    stats.numScheduled + stats.numDeferred != stats.numRequested || stats.numDrawCalls != 10 * scheduled.size()) ++problems;
+	}
+	CHECK(problems == 0);
+
+	// No budget at all schedules everything
+	CShadowScheduler unlimited(0, 0);
+	CHECK(ScheduleFrame(unlimited, { { 0, 0.1f, 500 }, { 1, 0.2f, 500 }, { 2, 0.3f, 500 } }) == std::vector<int>({ 2, 1, 0 }));
+	CHECK(ScheduleFrame(unlimited, {}).empty() && unlimited.GetStats().numRequested == 0);
+}
+
+// Updates too large for the draw call budget are passed over for smaller ones
+void TestDrawCallBudget()
+{
+	CShadowScheduler scheduler(0, 100);
+	CHECK(ScheduleFrame(scheduler, { { 0, 0.9f, 50 }, { 1, 0.8f, 60 }, { 2, 0.7f, 30 }, { 3, 0.6f, 25 }, { 4, 0.5f, 20 } }) == std::vector<int>({ 0, 2, 4 }));
+	CHECK(scheduler.GetStats().numDrawCalls == 100 && scheduler.GetStats().numDeferred == 2);
+
+	// One update over the whole budget still renders, alone (new lights, so none have been waiting)
+	CHECK(ScheduleFrame(scheduler, { { 5, 0.9f, 500 }, { 6, 0.8f, 10 } }) == std::vector<int>({ 5 }));
+	CHECK(scheduler.GetStats().numDrawCalls == 500);
+
+	// Both budgets at once, the update budget running out first
+	scheduler.SetBudget(2, 100);
+	CHECK(scheduler.GetMaxUpdates() == 2 && scheduler.GetMaxDrawCalls() == 100);
+	CHECK(ScheduleFrame(scheduler, { { 0, 0.9f, 10 }, { 1, 0.8f, 10 }, { 2, 0.7f, 10 } }) == std::vector<int>({ 0, 1 }));
+}
+
+// Waiting updates gain priority until they are scheduled
+void TestWaiting()
+{
+	// A distant light always requested alongside one covering the whole screen, with room for one update a frame
+	CShadowScheduler scheduler(1);
+	const std::vector<std::vector<float>> requests = { { 0, 1.0f, 10 }, { 1, 0.05f, 10 } };
+	int frame = 0;
+	while (ScheduleFrame(scheduler, requests) == std::vector<int>({ 0 }) && frame < 100) ++frame;
+	CHECK(frame == 10); // 0.05 + 10 frames * 0.1 beats 1.0
+	CHECK(scheduler.GetStats().maxWait == 10);
+
+	// Rendered, so it starts waiting again from nothing. The bright light only waited the one frame
+	CHECK(ScheduleFrame(scheduler, requests) == std::vector<int>({ 0 }));
+	CHECK(scheduler.GetStats().maxWait == 1);
+
+	// A wait is forgotten when the update stops being requested
+	for (int i = 0; i < 5; ++i) ScheduleFrame(scheduler, requests);
+	CHECK(scheduler.GetStats().maxWait == 5);
+	ScheduleFrame(scheduler, { { 0, 1.0f, 10 } });
+	ScheduleFrame(scheduler, requests);
+	CHECK(scheduler.GetStats().maxWait == 0);
+}
+
+void TestScreenContribution()
+{
+	const CVector3 origin = { 0.0f, 0.0f, 0.0f };
+	CHECK(CShadowScheduler::ScreenContribution(EmptyAABB(), origin) == 0.0f);
+	CHECK(CShadowScheduler::ScreenContribution(CAABB({ -1.0f, -1.0f, -1.0f }, { 1.0f, 1.0f, 1.0f }), origin) == 1.0f);
+
+	int problems = 0;
+	float last = 1.0f;
+	for (float distance = 2.0f; distance < 1000.0f; distance *= 1.5f)
+	{
+		CAABB bounds({ distance - 1.0f, -1.0f, -1.0f }, { distance + 1.0f, 1.0f, 1.0f });
+		float contribution = CShadowScheduler::ScreenContribution(bounds, origin);
+		if (!(contribution > 0.0f && contribution <= 1.0f && contribution <= last)) ++problems;
+		if (distance > 10.0f && std::abs(contribution - std::sqrt(3.0f) / distance) > 1e-5f) ++problems;
+		last = contribution;
+	}
+	CHECK(problems == 0);
+}
+
+// A point light's six faces all get rendered, sharing the budget with a spot light's shadow map
+void TestPointLightFaces()
+{
+	const int maxUpdates = 2;
+	CShadowScheduler scheduler(maxUpdates);
+	std::vector<SFakeLight> lights = { SFakeLight(0, 1), SFakeLight(3, NUM_FACES) };
+
+	const int numUpdates = 1 + NUM_FACES;
+	const int framesNeeded = (numUpdates + maxUpdates - 1) / maxUpdates;
+	for (int frame = 0; frame < framesNeeded; ++frame)
+	{
+		CHECK(RunFrame(scheduler, lights) == std::min(maxUpdates, numUpdates - frame * maxUpdates));
+	}
+	for (const auto& light : lights)
+	{
+		for (int times : light.timesRendered)
+		{
+			CHECK(times == 1);
+		}
+	}
+
+	// Nothing left to do
+	CHECK(RunFrame(scheduler, lights) == 0);
+	CHECK(scheduler.GetStats().numRequested == 0);
+
+	// A single face going out of date (e.g. a caster moving past one side of the light) only renders that face
+	lights[1].outOfDate[4] = true;
+	CHECK(RunFrame(scheduler, lights) == 1);
+	CHECK(lights[1].timesRendered[4] == 2);
+
+	// With only a draw call budget, the faces are still all rendered, one frame per face when each fills it
+	scheduler.SetBudget(0, 10);
+	std::fill(lights[1].outOfDate.begin(), lights[1].outOfDate.end(), true);
+	for (int frame = 0; frame < NUM_FACES; ++frame)
+	{
+		CHECK(RunFrame(scheduler, lights) == 1);
+	}
+	CHECK(std::none_of(lights[1].outOfDate.begin(), lights[1].outOfDate.end(), [](bool outOfDate) { return outOfDate; }));
+}
+
+// The depth main_ps compares with the cube map matches the depth rendered into the face
+void TestPointShadowDepth()
+{
+	const float depthScale = CUBE_FACE_PROJECTION.e22, depthOffset = CUBE_FACE_PROJECTION.e32; // pointShadowDepth
+	int problems = 0;
+	for (int i = 0; i < NUM_POSES; ++i)
+	{
+		CVector3 lightPosition = { gRandom.Range(-100.0f, 100.0f), gRandom.Range(-100.0f, 100.0f), gRandom.Range(-100.0f, 100.0f) };
+		CVector3 lightToPixel = { gRandom.Range(-50.0f, 50.0f), gRandom.Range(-50.0f, 50.0f), gRandom.Range(-50.0f, 50.0f) };
+		float faceDistance = std::max(std::abs(lightToPixel.x), std::max(std::abs(lightToPixel.y), std::abs(lightToPixel.z)));
+		if (faceDistance < 1.0f) continue;
+		float shaderDepth = depthScale + depthOffset / faceDistance;
+
+		// The face the cube map is sampled from is the one whose projection holds the pixel
+		CVector3 pixel = lightPosition + lightToPixel;
+		int facesHolding = 0;
+		for (int face = 0; face < NUM_FACES; ++face)
+		{
+			CVector4 projected = Project(CubeFaceViewMatrix(face, lightPosition) * CUBE_FACE_PROJECTION, pixel);
+			if (projected.w <= 0.0f) continue;
+			float x = projected.x / projected.w, y = projected.y / projected.w;
+			if (std::abs(x) > 1.0f || std::abs(y) > 1.0f) continue;
+
+			++facesHolding;
+			if (std::abs(projected.z / projected.w - shaderDepth) > 1e-5f) ++problems;
+		}
+		if (facesHolding == 0) ++problems;
+	}
+	CHECK(problems == 0);
+}
+}
+
+
+int main()
+{
+	TestPriority();
+	TestDrawCallBudget();
+	TestWaiting();
+	TestScreenContribution();
+	TestPointLightFaces();
+	TestPointShadowDepth();
+	return test::TestResult();
+}
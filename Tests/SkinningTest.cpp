@@ -0,0 +1,358 @@
+//--------------------------------------------------------------------------------------
+// Dual quaternion skinning tests
+//--------------------------------------------------------------------------------------
+// Builds bone palettes for a small posed hierarchy the same way Mesh::Render does, then checks the CPU
+// dual quaternion skinning (maths::SkinVertices) against linear blend skinning with the matrix palette
+// (the calculation in Skinning_vs.hlsl):
+//     - vertices on a single bone, and blends of bones with the same rotation, land in the same place
+//       with either palette, including under a rotated and translated root node
+//     - blending a 180 degree twist keeps the vertex's distance from the twist axis, where blended
+//       matrices collapse it to the axis ("candy-wrapper")
+//     - skinned normals stay unit length
+//     - converting rigid matrices to dual quaternions and back, combining them, normalising them and
+//       transforming points and directions with them all match the same operations on the matrices
+//
+// Build from the repository root, e.g. on Linux:
+//     g++ -std=c++14 -O2 -IMath -I. Tests/SkinningTest.cpp Math/*.cpp CVector4.cpp -pthread -o SkinningTest
+// or with Visual Studio (x64 Native Tools prompt):
+//     cl /std:c++14 /O2 /EHsc /IMath /I. Tests\SkinningTest.cpp Math\*.cpp CVector4.cpp /Fe:SkinningTest.exe
+// Exit code is 0 if all checks pass
+
+#include "Check.hpp"
+#include "CDualQuaternion.hpp"
+#include "CMatrix4x4.hpp"
+#include "BatchTransform.hpp"
+#include "MathHelpers.hpp"
+#include "CRandom.hpp"
+
+#include <cmath>
+#include <vector>
+
+using namespace umbra_engine;
+using namespace umbra_engine::maths;
+
+namespace
+{
+const float TOLERANCE = 1e-4f;
+
+CRandom gRandom(7);
+
+// Same layout as a skinned mesh vertex with tangents (see Mesh::Mesh)
+struct SVertex
+{
+	CVector3      position;
+	CVector3      normal;
+	CVector3      tangent;
+	float         uv[2];
+	unsigned char bones[4];
+	float         weights[4];
+};
+
+// A hierarchy of nodes in its bind pose and in a posed state, with parent indexes as in Mesh
+struct SSkeleton
+{
+	std::vector<unsigned int> parents;
+	std::vector<CMatrix4x4>   bindLocal;
+	std::vector<CMatrix4x4>   posedLocal;
+};
+
+// A chain of nodes along the Y axis under a rotated and translated root, as many exported meshes have
+SSkeleton MakeChain(int numBones, float boneLength)
+{
+	SSkeleton skeleton;
+	for (int i = 0; i < numBones; ++i)
+	{
+		skeleton.parents.push_back(i == 0 ? 0 : i - 1);
+		CMatrix4x4 bind = (i == 0) ? MatrixRotationX(-PI * 0.5f) * MatrixTranslation({ 5.0f, -2.0f, 3.0f })
+		                           : MatrixTranslation({ 0.0f, boneLength, 0.0f });
+		skeleton.bindLocal.push_back(bind);
+		skeleton.posedLocal.push_back(bind);
+	}
+	return skeleton;
+}
+
+// Resolve a set of local matrices to absolute ones, as Mesh::Render does
+std::vector<CMatrix4x4> Absolute(const SSkeleton& skeleton, const std::vector<CMatrix4x4>& local)
+{
+	std::vector<CMatrix4x4> absolute(local.size());
+	ResolveMatrixChain(local.data(), skeleton.parents.data(), absolute.data(), local.size());
+	return absolute;
+}
+
+// Matrix palette exactly as Mesh::Render builds it: bone offset (inverse bind pose) times posed absolute matrix
+std::vector<CMatrix4x4> MatrixPalette(const SSkeleton& skeleton)
+{
+	std::vector<CMatrix4x4> offsets = Absolute(skeleton, skeleton.bindLocal);
+	for (auto& offset : offsets) offset = InverseAffine(offset);
+	std::vector<CMatrix4x4> palette = Absolute(skeleton, skeleton.posedLocal);
+	MultiplyMatricesPairwise(offsets.data(), palette.data(), palette.data(), palette.size());
+	return palette;
+}
+
+// Dual quaternion palette exactly as Mesh::Render builds it, the same bones as the matrix palette
+std::vector<CDualQuaternion> DualQuaternionPalette(const std::vector<CMatrix4x4>& matrices)
+{
+	std::vector<CDualQuaternion> palette(matrices.size());
+	DualQuaternionsFromMatrices(matrices.data(), palette.data(), matrices.size());
+	return palette;
+}
+
+// Linear blend skinning of one vertex with the matrix palette, as Skinning_vs
+void SkinVertexMatrices(const std::vector<CMatrix4x4>& palette, const SVertex& vertex, CVector3& position, CVector3& normal)
+{
+	CMatrix4x4 blend;
+	float* b = &blend.e00;
+	for (int e = 0; e < 16; ++e) b[e] = 0.0f;
+	for (int i = 0; i < 4; ++i)
+	{
+		const float* bone = &palette[vertex.bones[i]].e00;
+		for (int e = 0; e < 16; ++e) b[e] += bone[e] * vertex.weights[i];
+	}
+	TransformPoints(blend, &vertex.position, &position, 1);
+	TransformDirections(blend, &vertex.normal, &normal, 1);
+}
+
+// Skin vertices with both palettes, returning the largest distance between the results
+float CompareSkinning(const SSkeleton& skeleton, const std::vector<SVertex>& vertices)
+{
+	std::vector<CMatrix4x4> matrices = MatrixPalette(skeleton);
+	std::vector<CDualQuaternion> dualQuaternions = DualQuaternionPalette(matrices);
+
+	std::vector<CVector3> positions(vertices.size()), normals(vertices.size());
+	SkinVertices(dualQuaternions.data(), &vertices[0].position, &vertices[0].normal, vertices[0].bones, vertices[0].weights,
+	             sizeof(SVertex), positions.data(), normals.data(), vertices.size());
+
+	float maxDistance = 0.0f;
+	for (size_t i = 0; i < vertices.size(); ++i)
+	{
+		CVector3 position, normal;
+		SkinVertexMatrices(matrices, vertices[i], position, normal);
+		maxDistance = std::max(maxDistance, Length(position - positions[i]));
+		maxDistance = std::max(maxDistance, Length(Normalise(normal) - normals[i]));
+	}
+	return maxDistance;
+}
+
+// A random rotation followed by a random translation
+CMatrix4x4 RandomRigidMatrix()
+{
+	return MatrixRotationZ(gRandom.Range(-PI, PI)) * MatrixRotationX(gRandom.Range(-PI, PI)) * MatrixRotationY(gRandom.Range(-PI, PI)) *
+	       MatrixTranslation({ gRandom.Range(-20.0f, 20.0f), gRandom.Range(-20.0f, 20.0f), gRandom.Range(-20.0f, 20.0f) });
+}
+
+// Largest difference between corresponding elements of two matrices
+float MatrixDifference(const CMatrix4x4& m1, const CMatrix4x4& m2)
+{
+	float difference = 0.0f;
+	for (int e = 0; e < 16; ++e) difference = std::max(difference, std::abs((&m1.e00)[e] - (&m2.e00)[e]));
+	return difference;
+}
+
+SVertex RandomVertex(int numBones, float boneLength)
+{
+	SVertex vertex = {};
+	vertex.position = { gRandom.Range(-1.0f, 1.0f), gRandom.Range(0.0f, numBones * boneLength), gRandom.Range(-1.0f, 1.0f) };
+	vertex.normal = Normalise(CVector3{ gRandom.Range(-1.0f, 1.0f), gRandom.Range(-1.0f, 1.0f), gRandom.Range(-1.0f, 1.0f) });
+	return vertex;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Tests
+-----------------------------------------------------------------------------------------*/
+
+// Vertices on one bone each: both methods must agree exactly (up to rounding) for any rigid pose
+void TestSingleBone()
+{
+	const int numBones = 4;
+	const float boneLength = 2.0f;
+	for (int pose = 0; pose < 100; ++pose)
+	{
+		SSkeleton skeleton = MakeChain(numBones, boneLength);
+
+		// Move the root too, the palette must not depend on where the mesh's root node is
+		skeleton.posedLocal[0] = MatrixRotationY(gRandom.Range(-PI, PI)) * skeleton.bindLocal[0] *
+		                         MatrixTranslation({ gRandom.Range(-10.0f, 10.0f), 0.0f, gRandom.Range(-10.0f, 10.0f) });
+		for (int i = 1; i < numBones; ++i)
+		{
+			skeleton.posedLocal[i] = MatrixRotationZ(gRandom.Range(-1.0f, 1.0f)) * MatrixRotationX(gRandom.Range(-1.0f, 1.0f)) *
+			                         skeleton.bindLocal[i];
+		}
+
+		std::vector<SVertex> vertices;
+		for (int i = 0; i < 200; ++i)
+		{
+			SVertex vertex = RandomVertex(numBones, boneLength);
+			vertex.bones[0] = static_cast<unsigned char>(gRandom.Next() % numBones);
+			vertex.weights[0] = 1.0f;
+			vertices.push_back(vertex);
+		}
+		if (!CHECK(CompareSkinning(skeleton, vertices) < TOLERANCE)) return;
+	}
+}
+
+// Blends of bones that differ only by translation: both methods blend the translation linearly
+void TestTranslationBlend()
+{
+	const int numBones = 3;
+	SSkeleton skeleton = MakeChain(numBones, 2.0f);
+	skeleton.posedLocal[0] = MatrixRotationY(0.7f) * skeleton.bindLocal[0];
+	skeleton.posedLocal[1] = MatrixTranslation({ 0.5f, 2.5f, -0.25f });
+	skeleton.posedLocal[2] = MatrixTranslation({ -0.5f, 1.0f, 0.75f });
+
+	std::vector<SVertex> vertices;
+	for (int i = 0; i < 500; ++i)
+	{
+		SVertex vertex = RandomVertex(numBones, 2.0f);
+		float sum = 0.0f;
+		for (int b = 0; b < 4; ++b)
+		{
+			vertex.bones[b] = static_cast<unsigned char>(gRandom.Next() % numBones);
+			vertex.weights[b] = gRandom.Range(0.0f, 1.0f);
+			sum += vertex.weights[b];
+		}
+		for (int b = 0; b < 4; ++b) vertex.weights[b] /= sum;
+		vertices.push_back(vertex);
+	}
+	CHECK(CompareSkinning(skeleton, vertices) < TOLERANCE);
+}
+
+// Half way through a 180 degree twist: blended matrices pull the vertex onto the twist axis, dual
+// quaternions turn it 90 degrees and keep its distance
+void TestTwist()
+{
+	SSkeleton skeleton = MakeChain(2, 2.0f);
+	skeleton.posedLocal[1] = MatrixRotationY(PI) * skeleton.bindLocal[1];
+	std::vector<CMatrix4x4> matrices = MatrixPalette(skeleton);
+	std::vector<CDualQuaternion> dualQuaternions = DualQuaternionPalette(matrices);
+
+	// A vertex at the joint, 1 unit from the Y axis of the chain, half on each bone. The chain lies along
+	// the root node's Y axis, so place the vertex relative to the root in its bind pose
+	CMatrix4x4 bindRoot = Absolute(skeleton, skeleton.bindLocal)[0];
+	CVector3 jointPosition = { 1.0f, 2.0f, 0.0f };
+	CVector3 jointNormal = { 1.0f, 0.0f, 0.0f };
+	SVertex vertex = {};
+	TransformPoints(bindRoot, &jointPosition, &vertex.position, 1);
+	TransformDirections(bindRoot, &jointNormal, &vertex.normal, 1);
+	vertex.bones[0] = 0;
+	vertex.bones[1] = 1;
+	vertex.weights[0] = 0.5f;
+	vertex.weights[1] = 0.5f;
+
+	// Distance from the chain's axis, measured in the space of the root node
+	CMatrix4x4 toRoot = InverseAffine(Absolute(skeleton, skeleton.posedLocal)[0]);
+	auto radius = [&](const CVector3& p)
+	{
+		CVector3 local;
+		TransformPoints(toRoot, &p, &local, 1);
+		return std::sqrt(local.x * local.x + local.z * local.z);
+	};
+
+	CVector3 matrixPosition, matrixNormal, dqPosition, dqNormal;
+	SkinVertexMatrices(matrices, vertex, matrixPosition, matrixNormal);
+	SkinVertices(dualQuaternions.data(), &vertex.position, &vertex.normal, vertex.bones, vertex.weights, sizeof(SVertex),
+	             &dqPosition, &dqNormal, 1);
+
+	std::printf("Twist radius: matrices %.4f, dual quaternions %.4f\n", radius(matrixPosition), radius(dqPosition));
+	CHECK(radius(matrixPosition) < TOLERANCE);
+	CHECK(std::abs(radius(dqPosition) - 1.0f) < TOLERANCE);
+	CHECK(std::abs(Length(dqNormal) - 1.0f) < TOLERANCE);
+}
+
+// Normals of arbitrary blends stay unit length, so the shader's normalise has nothing to fix
+void TestNormals()
+{
+	const int numBones = 4;
+	SSkeleton skeleton = MakeChain(numBones, 1.5f);
+	for (int i = 1; i < numBones; ++i)
+	{
+		skeleton.posedLocal[i] = MatrixRotationY(gRandom.Range(-PI, PI)) * MatrixRotationZ(gRandom.Range(-1.5f, 1.5f)) *
+		                         skeleton.bindLocal[i];
+	}
+	std::vector<CDualQuaternion> palette = DualQuaternionPalette(MatrixPalette(skeleton));
+
+	float maxError = 0.0f;
+	for (int i = 0; i < 1000; ++i)
+	{
+		SVertex vertex = RandomVertex(numBones, 1.5f);
+		vertex.bones[0] = static_cast<unsigned char>(gRandom.Next() % numBones);
+		vertex.bones[1] = static_cast<unsigned char>(gRandom.Next() % numBones);
+		vertex.weights[0] = gRandom.Range(0.0f, 1.0f);
+		vertex.weights[1] = 1.0f - vertex.weights[0];
+
+		CVector3 position, normal;
+		SkinVertices(palette.data(), &vertex.position, &vertex.normal, vertex.bones, vertex.weights, sizeof(SVertex),
+		             &position, &normal, 1);
+		maxError = std::max(maxError, std::abs(Length(normal) - 1.0f));
+	}
+	CHECK(maxError < TOLERANCE);
+}
+
+// Dual quaternions hold the same transforms as rigid matrices
+void TestConversions()
+{
+	const int numTransforms = 500;
+	std::vector<CMatrix4x4> matrices;
+	for (int i = 0; i < numTransforms; ++i) matrices.push_back(RandomRigidMatrix());
+	std::vector<CDualQuaternion> palette = DualQuaternionPalette(matrices);
+
+	int problems = 0;
+	for (int i = 0; i < numTransforms; ++i)
+	{
+		const CMatrix4x4& m = matrices[i];
+		CDualQuaternion dq = DualQuaternionFromMatrix(m);
+
+		// The batch conversion gives the same result as one at a time
+		const float* batch = &palette[i].real.x;
+		const float* single = &dq.real.x;
+		for (int c = 0; c < 8; ++c)
+		{
+			if (std::abs(batch[c] - single[c]) > TOLERANCE) ++problems;
+		}
+
+		if (MatrixDifference(MatrixFromDualQuaternion(dq), m) > TOLERANCE) ++problems;
+		if (Length(GetTranslation(dq) - CVector3{ m.e30, m.e31, m.e32 }) > TOLERANCE) ++problems;
+
+		// From the rotation and translation separately
+		CDualQuaternion parts = DualQuaternionFromRotationTranslation(QuaternionFromMatrix(m), { m.e30, m.e31, m.e32 });
+		if (MatrixDifference(MatrixFromDualQuaternion(parts), m) > TOLERANCE) ++problems;
+
+		// Transforming agrees with the matrix
+		CVector3 point = { gRandom.Range(-10.0f, 10.0f), gRandom.Range(-10.0f, 10.0f), gRandom.Range(-10.0f, 10.0f) };
+		CVector3 direction = Normalise(CVector3{ gRandom.Range(-1.0f, 1.0f), gRandom.Range(-1.0f, 1.0f), gRandom.Range(-1.0f, 1.0f) });
+		CVector3 matrixPoint, matrixDirection;
+		TransformPoints(m, &point, &matrixPoint, 1);
+		TransformDirections(m, &direction, &matrixDirection, 1);
+		if (Length(TransformPoint(dq, point) - matrixPoint) > TOLERANCE) ++problems;
+		if (Length(TransformDirection(dq, direction) - matrixDirection) > TOLERANCE) ++problems;
+
+		// Combining in the same order as matrices
+		const CMatrix4x4& next = matrices[(i + 1) % numTransforms];
+		if (MatrixDifference(MatrixFromDualQuaternion(dq * DualQuaternionFromMatrix(next)), m * next) > TOLERANCE) ++problems;
+
+		// Scaling both parts changes nothing once normalised
+		CDualQuaternion scaled = dq;
+		float scale = gRandom.Range(0.1f, 10.0f);
+		float* s = &scaled.real.x;
+		for (int c = 0; c < 8; ++c) s[c] *= scale;
+		if (MatrixDifference(MatrixFromDualQuaternion(Normalise(scaled)), m) > TOLERANCE) ++problems;
+	}
+	CHECK(problems == 0);
+
+	// The identity leaves points where they are
+	CVector3 point = { 3.0f, -4.0f, 5.0f };
+	CHECK(Length(TransformPoint(DualQuaternionIdentity(), point) - point) == 0.0f);
+	CHECK(MatrixDifference(MatrixFromDualQuaternion(DualQuaternionIdentity()), MatrixIdentity()) == 0.0f);
+}
+}
+
+
+int main()
+{
+	TestSingleBone();
+	TestTranslationBlend();
+	TestTwist();
+	TestNormals();
+	TestConversions();
+	return test::TestResult();
+}
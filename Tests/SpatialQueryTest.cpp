@@ -0,0 +1,298 @@
+//--------------------------------------------------------------------------------------
+// Spatial query tests
+//--------------------------------------------------------------------------------------
+// Compares every CSpatialQuery query with testing each object one at a time, on a world of boxes and
+// meshes (objects with a triangle BVH under a rotated, scaled and translated world matrix):
+//     - first hit ray casts find the nearest hit, testing every world space triangle of the meshes
+//     - any hit ray casts agree with first hit ray casts
+//     - sphere overlaps return exactly the objects whose bounds touch the sphere
+//     - k nearest queries return the k smallest distances in order
+//     - batch queries give the same results as single ones
+// The checks are repeated after moving some of the objects
+//
+// Build from the repository root, e.g. on Linux:
+//     g++ -std=c++14 -O2 -IMath -I. Tests/SpatialQueryTest.cpp Math/*.cpp CVector4.cpp -pthread -o SpatialQueryTest
+// or with Visual Studio (x64 Native Tools prompt):
+//     cl /std:c++14 /O2 /EHsc /IMath /I. Tests\SpatialQueryTest.cpp Math\*.cpp CVector4.cpp /Fe:SpatialQueryTest.exe
+// Exit code is 0 if all checks pass
+
+#include "Check.hpp"
+#include "CSpatialQuery.hpp"
+#include "BatchTransform.hpp"
+#include "MathHelpers.hpp"
+#include "CRandom.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace umbra_engine;
+using namespace umbra_engine::maths;
+
+namespace
+{
+const int NUM_OBJECTS = 2000;
+const int NUM_TRIANGLES = 40; // In the test mesh
+const float WORLD_SIZE = 300.0f;
+const int NUM_QUERIES = 2000;
+const float MAX_DISTANCE = 400.0f;
+const size_t K = 8;
+
+// Distances found by different routes (world space against model space) may differ by rounding
+const float DISTANCE_TOLERANCE = 1e-3f;
+
+CRandom gRandom(314);
+
+// An object in the test world. Meshes have their triangles in world space for the brute force ray casts
+struct SObject
+{
+	CAABB                 bounds;
+	bool                  isMesh;
+	CMatrix4x4            worldMatrix;
+	std::vector<CVector3> worldVertices; // 3 per triangle
+	int                   handle;
+};
+
+// A shared test mesh: a soup of random triangles in the box -1 to 1
+struct STestMesh
+{
+	std::vector<CVector3> positions;
+	std::vector<uint32_t> indices;
+	CTriangleBVH          bvh;
+};
+
+STestMesh MakeMesh()
+{
+	STestMesh mesh;
+	for (int i = 0; i < NUM_TRIANGLES; ++i)
+	{
+		CVector3 centre{ gRandom.Range(-0.8f, 0.8f), gRandom.Range(-0.8f, 0.8f), gRandom.Range(-0.8f, 0.8f) };
+		for (int v = 0; v < 3; ++v)
+		{
+			mesh.indices.push_back(static_cast<uint32_t>(mesh.positions.size()));
+			mesh.positions.push_back(centre + CVector3{ gRandom.Range(-0.2f, 0.2f), gRandom.Range(-0.2f, 0.2f), gRandom.Range(-0.2f, 0.2f) });
+		}
+	}
+	mesh.bvh.Build(mesh.positions.data(), sizeof(CVector3), mesh.indices.data(), mesh.indices.size());
+	return mesh;
+}
+
+CVector3 RandomPoint()
+{
+	return { gRandom.Range(-WORLD_SIZE, WORLD_SIZE), gRandom.Range(-20.0f, 20.0f), gRandom.Range(-WORLD_SIZE, WORLD_SIZE) };
+}
+
+// Place an object at a random position, as a mesh with a random rotation and scale or as a box of random size
+void PlaceObject(SObject& object, const STestMesh& mesh)
+{
+	CVector3 position = RandomPoint();
+	if (object.isMesh)
+	{
+		float scale = gRandom.Range(0.5f, 8.0f);
+		object.worldMatrix = MatrixScaling({ scale, scale * gRandom.Range(0.5f, 2.0f), scale }) *
+		                     MatrixRotationX(gRandom.Range(-PI, PI)) * MatrixRotationY(gRandom.Range(-PI, PI)) * MatrixTranslation(position);
+		object.bounds = Transform(mesh.bvh.Bounds(), object.worldMatrix);
+		object.worldVertices.resize(mesh.indices.size());
+		for (size_t i = 0; i < mesh.indices.size(); ++i)
+		{
+			TransformPoints(object.worldMatrix, &mesh.positions[mesh.indices[i]], &object.worldVertices[i], 1);
+		}
+	}
+	else
+	{
+		CVector3 extents{ gRandom.Range(0.5f, 6.0f), gRandom.Range(0.5f, 6.0f), gRandom.Range(0.5f, 6.0f) };
+		object.bounds = CAABB(position - extents, position + extents);
+	}
+}
+
+// Ray against a triangle (both sides), as in any textbook
+bool RayTriangle(const CRay& ray, const CVector3& v0, const CVector3& v1, const CVector3& v2, float& distance)
+{
+	CVector3 edge1 = v1 - v0;
+	CVector3 edge2 = v2 - v0;
+	CVector3 p = Cross(ray.direction, edge2);
+	float determinant = Dot(edge1, p);
+	if (std::abs(determinant) < 1e-12f) return false;
+	float invDeterminant = 1.0f / determinant;
+	CVector3 t = ray.origin - v0;
+	float u = Dot(t, p) * invDeterminant;
+	if (u < 0.0f || u > 1.0f) return false;
+	CVector3 q = Cross(t, edge1);
+	float v = Dot(ray.direction, q) * invDeterminant;
+	if (v < 0.0f || u + v > 1.0f) return false;
+	distance = Dot(edge2, q) * invDeterminant;
+	return distance >= 0.0f;
+}
+
+// Distance to an object along a ray by brute force, or a negative value if it isn't hit within MAX_DISTANCE
+float RayDistance(const SObject& object, const CRay& ray)
+{
+	float distance;
+	if (!object.isMesh) return Intersects(ray, object.bounds, MAX_DISTANCE, distance) ? distance : -1.0f;
+
+	float nearest = -1.0f;
+	for (size_t i = 0; i < object.worldVertices.size(); i += 3)
+	{
+		if (RayTriangle(ray, object.worldVertices[i], object.worldVertices[i + 1], object.worldVertices[i + 2], distance) &&
+		    distance <= MAX_DISTANCE && (nearest < 0.0f || distance < nearest))
+		{
+			nearest = distance;
+		}
+	}
+	return nearest;
+}
+
+CRay RandomRay()
+{
+	CVector3 direction;
+	do
+	{
+		direction = { gRandom.Range(-1.0f, 1.0f), gRandom.Range(-0.2f, 0.2f), gRandom.Range(-1.0f, 1.0f) };
+	} while (Length(direction) < 0.1f);
+	return CRay(RandomPoint(), Normalise(direction));
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Tests
+-----------------------------------------------------------------------------------------*/
+
+void TestQueries(const CSpatialQuery& query, const std::vector<SObject>& objects)
+{
+	// Ray casts
+	std::vector<CRay> rays(NUM_QUERIES);
+	for (auto& ray : rays) ray = RandomRay();
+	std::vector<SRayHit> hits(rays.size());
+	std::vector<unsigned char> anyHits(rays.size());
+	size_t numHits = query.RayCast(rays.data(), MAX_DISTANCE, hits.data(), rays.size());
+	size_t numAnyHits = query.RayCastAny(rays.data(), MAX_DISTANCE, anyHits.data(), rays.size());
+
+	int wrongHits = 0, wrongAnyHits = 0, wrongBatch = 0, meshHits = 0;
+	size_t expectedHits = 0;
+	for (size_t i = 0; i < rays.size(); ++i)
+	{
+		float nearest = -1.0f;
+		for (const auto& object : objects)
+		{
+			float distance = RayDistance(object, rays[i]);
+			if (distance >= 0.0f && (nearest < 0.0f || distance < nearest)) nearest = distance;
+		}
+
+		SRayHit hit;
+		bool found = query.RayCast(rays[i], MAX_DISTANCE, hit);
+		if (found != (nearest >= 0.0f)) ++wrongHits;
+		else if (found)
+		{
+			// Several objects may be at nearly the same distance, so check the one returned is really hit there
+			const SObject& object = *static_cast<const SObject*>(hit.object);
+			float objectDistance = RayDistance(object, rays[i]);
+			if (std::abs(hit.distance - nearest) > DISTANCE_TOLERANCE || std::abs(objectDistance - hit.distance) > DISTANCE_TOLERANCE ||
+			    Length(hit.point - (rays[i].origin + rays[i].direction * hit.distance)) > DISTANCE_TOLERANCE ||
+			    (hit.triangle >= 0) != object.isMesh)
+			{
+				++wrongHits;
+			}
+			if (object.isMesh) ++meshHits;
+		}
+		if (found) ++expectedHits;
+
+		if (query.RayCastAny(rays[i], MAX_DISTANCE) != found || (anyHits[i] != 0) != found) ++wrongAnyHits;
+		if (hits[i].object != hit.object || (found && hits[i].distance != hit.distance)) ++wrongBatch;
+	}
+	std::printf("%zu of %zu rays hit, %d of them meshes\n", expectedHits, rays.size(), meshHits);
+	CHECK(wrongHits == 0);
+	CHECK(wrongAnyHits == 0);
+	CHECK(wrongBatch == 0);
+	CHECK(numHits == expectedHits && numAnyHits == expectedHits);
+	CHECK(meshHits > 0);
+
+	// Sphere overlaps, single and batched
+	std::vector<CSphere> spheres(NUM_QUERIES / 4);
+	for (auto& sphere : spheres) sphere = CSphere(RandomPoint(), gRandom.Range(1.0f, 40.0f));
+	std::vector<void*> batchResults;
+	std::vector<size_t> offsets(spheres.size() + 1);
+	query.Overlap(spheres.data(), batchResults, offsets.data(), spheres.size());
+
+	int wrongOverlaps = 0;
+	for (size_t i = 0; i < spheres.size(); ++i)
+	{
+		std::vector<void*> expected, results;
+		for (const auto& object : objects)
+		{
+			if (Intersects(object.bounds, spheres[i])) expected.push_back(const_cast<SObject*>(&object));
+		}
+		query.Overlap(spheres[i], results);
+		std::vector<void*> batch(batchResults.begin() + offsets[i], batchResults.begin() + offsets[i + 1]);
+		std::sort(expected.begin(), expected.end());
+		std::sort(results.begin(), results.end());
+		std::sort(batch.begin(), batch.end());
+		if (results != expected || batch != expected) ++wrongOverlaps;
+	}
+	CHECK(wrongOverlaps == 0);
+
+	// k nearest. Compare distances rather than objects, as objects can be equally near (e.g. both containing the point)
+	std::vector<CVector3> points(NUM_QUERIES / 4);
+	for (auto& point : points) point = RandomPoint();
+	std::vector<void*> nearestBatch(points.size() * K);
+	query.Nearest(points.data(), K, nearestBatch.data(), points.size());
+
+	int wrongNearest = 0;
+	for (size_t i = 0; i < points.size(); ++i)
+	{
+		std::vector<float> expected;
+		for (const auto& object : objects) expected.push_back(DistanceSquared(object.bounds, points[i]));
+		std::sort(expected.begin(), expected.end());
+
+		std::vector<void*> results;
+		query.Nearest(points[i], K, results);
+		if (results.size() != std::min(K, objects.size())) { ++wrongNearest; continue; }
+		for (size_t r = 0; r < results.size(); ++r)
+		{
+			float distance = DistanceSquared(static_cast<SObject*>(results[r])->bounds, points[i]);
+			if (distance != expected[r] || nearestBatch[i * K + r] != results[r]) ++wrongNearest;
+		}
+	}
+	CHECK(wrongNearest == 0);
+}
+}
+
+
+int main()
+{
+	STestMesh mesh = MakeMesh();
+	CSpatialQuery query(2.0f);
+
+	std::vector<SObject> objects(NUM_OBJECTS);
+	for (auto& object : objects)
+	{
+		object.isMesh = (gRandom.Next() % 3 == 0);
+		PlaceObject(object, mesh);
+		object.handle = object.isMesh ? query.Insert(object.bounds, &mesh.bvh, object.worldMatrix, &object)
+		                              : query.Insert(object.bounds, &object);
+	}
+	CHECK(query.Count() == objects.size());
+	TestQueries(query, objects);
+
+	// Move a quarter of the objects and check again
+	for (auto& object : objects)
+	{
+		if (gRandom.Next() % 4 != 0) continue;
+		PlaceObject(object, mesh);
+		if (object.isMesh) query.Update(object.handle, object.bounds, object.worldMatrix);
+		else               query.Update(object.handle, object.bounds);
+	}
+	TestQueries(query, objects);
+
+	// Fewer objects than k
+	CSpatialQuery small;
+	SObject a, b;
+	a.bounds = CAABB({ 0, 0, 0 }, { 1, 1, 1 });
+	b.bounds = CAABB({ 5, 0, 0 }, { 6, 1, 1 });
+	small.Insert(a.bounds, &a);
+	small.Insert(b.bounds, &b);
+	std::vector<void*> results;
+	small.Nearest({ 4.0f, 0.5f, 0.5f }, K, results);
+	CHECK(results.size() == 2 && results[0] == &b && results[1] == &a);
+
+	return test::TestResult();
+}
@@ -0,0 +1,296 @@
+//--------------------------------------------------------------------------------------
+// State context tests
+//--------------------------------------------------------------------------------------
+// Drives CStateContext with a recording device context (Tests/Mock/d3d11.h) and checks which calls reach it:
+//     - setting what is already bound is filtered, for every kind of state, and anything different is passed on
+//     - a call binding a range of slots is passed on if any slot in it changes
+//     - OMSetRenderTargets forgets the shader resources (the runtime may have unbound them) but nothing else
+//     - calls reaching past the tracked slots are always passed on, and forget the tracked slots they cover
+//     - draws, clears and viewports are never filtered
+//     - NewFrame and Invalidate forget everything bound, and NewFrame keeps the frame's issued / filtered counts
+//
+// Build from the repository root, e.g. on Linux:
+//     g++ -std=c++14 -O2 -ITests/Mock -I. Tests/StateContextTest.cpp StateContext.cpp -o StateContextTest
+// or with Visual Studio (x64 Native Tools prompt):
+//     cl /std:c++14 /O2 /EHsc /ITests\Mock /I. Tests\StateContextTest.cpp StateContext.cpp /Fe:StateContextTest.exe
+// Exit code is 0 if all checks pass
+
+#include "Check.hpp"
+#include "StateContext.hpp"
+
+#include <string>
+#include <vector>
+
+using namespace umbra_engine;
+
+namespace
+{
+// Objects to bind, only their addresses matter
+ID3D11VertexShader       gVertexShaders[2];
+ID3D11GeometryShader     gGeometryShader;
+ID3D11PixelShader        gPixelShaders[2];
+ID3D11ClassInstance      gClassInstance;
+ID3D11Buffer             gBuffers[4];
+ID3D11ShaderResourceView gViews[4];
+ID3D11SamplerState       gSamplers[2];
+ID3D11BlendState         gBlendState;
+ID3D11DepthStencilState  gDepthStencilState;
+ID3D11RasterizerState    gRasterizerStates[2];
+ID3D11InputLayout        gInputLayout;
+ID3D11RenderTargetView   gRenderTarget;
+ID3D11DepthStencilView   gDepthStencil;
+
+// The calls the device context has received since the last time this was called
+std::vector<std::string> TakeCalls(ID3D11DeviceContext& device)
+{
+	std::vector<std::string> calls;
+	calls.swap(device.log);
+	return calls;
+}
+
+// Bind one of everything through the context
+void BindEverything(CStateContext& context)
+{
+	ID3D11Buffer* buffer = &gBuffers[0];
+	ID3D11ShaderResourceView* view = &gViews[0];
+	ID3D11SamplerState* sampler = &gSamplers[0];
+	const FLOAT factor[4] = { 0.5f, 0.5f, 0.5f, 0.5f };
+	UINT stride = 32, offset = 0;
+
+	context.VSSetShader(&gVertexShaders[0], nullptr, 0);
+	context.GSSetShader(&gGeometryShader, nullptr, 0);
+	context.PSSetShader(&gPixelShaders[0], nullptr, 0);
+	context.VSSetConstantBuffers(0, 1, &buffer);
+	context.GSSetConstantBuffers(0, 1, &buffer);
+	context.PSSetConstantBuffers(0, 1, &buffer);
+	context.PSSetShaderResources(0, 1, &view);
+	context.PSSetSamplers(0, 1, &sampler);
+	context.OMSetBlendState(&gBlendState, factor, 0xffffffff);
+	context.OMSetDepthStencilState(&gDepthStencilState, 1);
+	context.RSSetState(&gRasterizerStates[0]);
+	context.IASetInputLayout(&gInputLayout);
+	context.IASetVertexBuffers(0, 1, &buffer, &stride, &offset);
+	context.IASetIndexBuffer(&gBuffers[1], DXGI_FORMAT_R32_UINT, 0);
+	context.IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+}
+const size_t NUM_BIND_CALLS = 15;
+
+
+/*-----------------------------------------------------------------------------------------
+	Tests
+-----------------------------------------------------------------------------------------*/
+
+// Binding the same thing twice reaches the device once, binding something else reaches it again
+void TestFiltering()
+{
+	ID3D11DeviceContext device;
+	CStateContext context(&device);
+
+	BindEverything(context);
+	CHECK(TakeCalls(device).size() == NUM_BIND_CALLS);
+	BindEverything(context);
+	CHECK(TakeCalls(device).empty());
+
+	// Each kind of state is passed on when it changes
+	ID3D11Buffer* otherBuffer = &gBuffers[2];
+	ID3D11ShaderResourceView* otherView = &gViews[1];
+	ID3D11SamplerState* otherSampler = &gSamplers[1];
+	const FLOAT otherFactor[4] = { 0.5f, 0.5f, 0.5f, 1.0f };
+	UINT stride = 32, otherStride = 16, offset = 0, otherOffset = 64;
+	ID3D11Buffer* vertexBuffer = &gBuffers[0];
+
+	context.VSSetShader(&gVertexShaders[1], nullptr, 0);
+	context.GSSetShader(nullptr, nullptr, 0);
+	context.PSSetShader(&gPixelShaders[1], nullptr, 0);
+	context.VSSetConstantBuffers(0, 1, &otherBuffer);
+	context.GSSetConstantBuffers(0, 1, &otherBuffer);
+	context.PSSetConstantBuffers(0, 1, &otherBuffer);
+	context.PSSetShaderResources(0, 1, &otherView);
+	context.PSSetSamplers(0, 1, &otherSampler);
+	context.OMSetBlendState(&gBlendState, otherFactor, 0xffffffff);
+	context.OMSetBlendState(&gBlendState, otherFactor, 0x0000ffff);
+	context.OMSetDepthStencilState(&gDepthStencilState, 2);
+	context.RSSetState(&gRasterizerStates[1]);
+	context.IASetInputLayout(nullptr);
+	context.IASetVertexBuffers(0, 1, &vertexBuffer, &otherStride, &offset);
+	context.IASetVertexBuffers(0, 1, &vertexBuffer, &otherStride, &otherOffset);
+	context.IASetIndexBuffer(&gBuffers[1], DXGI_FORMAT_R16_UINT, 0);
+	context.IASetIndexBuffer(&gBuffers[1], DXGI_FORMAT_R16_UINT, 12);
+	context.IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_POINTLIST);
+	std::vector<std::string> expected = { "VSSetShader", "GSSetShader", "PSSetShader", "VSSetConstantBuffers",
+		"GSSetConstantBuffers", "PSSetConstantBuffers", "PSSetShaderResources", "PSSetSamplers", "OMSetBlendState",
+		"OMSetBlendState", "OMSetDepthStencilState", "RSSetState", "IASetInputLayout", "IASetVertexBuffers",
+		"IASetVertexBuffers", "IASetIndexBuffer", "IASetIndexBuffer", "IASetPrimitiveTopology" };
+	CHECK(TakeCalls(device) == expected);
+
+	// Constant buffers are tracked per stage, so binding the VS buffer to the PS is passed on
+	ID3D11Buffer* buffer = &gBuffers[3];
+	context.VSSetConstantBuffers(1, 1, &buffer);
+	context.PSSetConstantBuffers(1, 1, &buffer);
+	context.PSSetConstantBuffers(1, 1, &buffer);
+	CHECK(TakeCalls(device).size() == 2);
+
+	// A null blend factor is the same as a factor of 1
+	const FLOAT one[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	context.OMSetBlendState(nullptr, nullptr, 0xffffffff);
+	context.OMSetBlendState(nullptr, one, 0xffffffff);
+	CHECK(TakeCalls(device).size() == 1);
+
+	// A range is passed on if any slot in it changes, and then binds all of it
+	ID3D11ShaderResourceView* views[3] = { &gViews[0], &gViews[1], &gViews[2] };
+	context.PSSetShaderResources(4, 3, views);
+	context.PSSetShaderResources(5, 2, &views[1]);
+	context.PSSetShaderResources(4, 1, &views[0]);
+	CHECK(TakeCalls(device).size() == 1);
+	ID3D11ShaderResourceView* changedViews[3] = { &gViews[0], &gViews[3], &gViews[2] };
+	context.PSSetShaderResources(4, 3, changedViews);
+	context.PSSetShaderResources(5, 1, &changedViews[1]);
+	CHECK(TakeCalls(device).size() == 1);
+
+	ID3D11Buffer* vertexBuffers[2] = { &gBuffers[0], &gBuffers[1] };
+	UINT strides[2] = { stride, stride }, offsets[2] = { 0, 0 };
+	context.IASetVertexBuffers(0, 2, vertexBuffers, strides, offsets);
+	context.IASetVertexBuffers(1, 1, &vertexBuffers[1], &strides[1], &offsets[1]);
+	CHECK(TakeCalls(device).size() == 1);
+
+	// Shaders with class instances are always set, and leave the shader unknown
+	ID3D11ClassInstance* instance = &gClassInstance;
+	context.PSSetShader(&gPixelShaders[1], &instance, 1);
+	context.PSSetShader(&gPixelShaders[1], &instance, 1);
+	context.PSSetShader(&gPixelShaders[1], nullptr, 0);
+	context.PSSetShader(&gPixelShaders[1], nullptr, 0);
+	CHECK(TakeCalls(device).size() == 3);
+
+	// Calls that aren't state changes are never filtered
+	D3D11_VIEWPORT viewport = { 0.0f, 0.0f, 640.0f, 480.0f, 0.0f, 1.0f };
+	for (int i = 0; i < 2; ++i)
+	{
+		context.RSSetViewports(1, &viewport);
+		context.ClearRenderTargetView(&gRenderTarget, one);
+		context.ClearDepthStencilView(&gDepthStencil, 0, 1.0f, 0);
+		context.GenerateMips(&gViews[0]);
+		context.Draw(3, 0);
+		context.DrawIndexed(3, 0, 0);
+		context.DrawIndexedInstanced(3, 2, 0, 0, 0);
+	}
+	CHECK(TakeCalls(device).size() == 14);
+}
+
+// Changing render targets forgets the shader resources, but the rest stays filtered
+void TestRenderTargets()
+{
+	ID3D11DeviceContext device;
+	CStateContext context(&device);
+	BindEverything(context);
+	TakeCalls(device);
+
+	ID3D11RenderTargetView* renderTarget = &gRenderTarget;
+	context.OMSetRenderTargets(1, &renderTarget, &gDepthStencil);
+	context.OMSetRenderTargets(1, &renderTarget, &gDepthStencil);
+	CHECK(TakeCalls(device).size() == 2);
+
+	BindEverything(context);
+	std::vector<std::string> expected = { "PSSetShaderResources" };
+	CHECK(TakeCalls(device) == expected);
+
+	// Every shader resource slot is forgotten, not just the first
+	ID3D11ShaderResourceView* views[2] = { &gViews[2], &gViews[3] };
+	context.PSSetShaderResources(14, 2, views);
+	context.OMSetRenderTargets(1, &renderTarget, nullptr);
+	context.PSSetShaderResources(15, 1, &views[1]);
+	CHECK(TakeCalls(device).size() == 3);
+}
+
+// Calls reaching past the tracked slots are passed on, and the tracked slots they cover are forgotten
+void TestUntrackedSlots()
+{
+	ID3D11DeviceContext device;
+	CStateContext context(&device);
+
+	// 16 shader resource and vertex buffer slots, 14 constant buffer slots are tracked
+	ID3D11ShaderResourceView* views[2] = { &gViews[0], &gViews[1] };
+	context.PSSetShaderResources(15, 1, views);
+	context.PSSetShaderResources(15, 1, views);
+	CHECK(TakeCalls(device).size() == 1);
+	context.PSSetShaderResources(15, 2, views);
+	context.PSSetShaderResources(15, 2, views);
+	CHECK(TakeCalls(device).size() == 2);
+	context.PSSetShaderResources(15, 1, views);
+	context.PSSetShaderResources(15, 1, views);
+	CHECK(TakeCalls(device).size() == 1);
+	context.PSSetShaderResources(16, 1, views);
+	context.PSSetShaderResources(16, 1, views);
+	CHECK(TakeCalls(device).size() == 2);
+
+	ID3D11Buffer* buffers[2] = { &gBuffers[0], &gBuffers[1] };
+	context.VSSetConstantBuffers(13, 1, buffers);
+	context.VSSetConstantBuffers(13, 2, buffers);
+	context.VSSetConstantBuffers(13, 1, buffers);
+	context.VSSetConstantBuffers(13, 1, buffers);
+	CHECK(TakeCalls(device).size() == 3);
+
+	UINT strides[2] = { 16, 16 }, offsets[2] = { 0, 0 };
+	context.IASetVertexBuffers(15, 1, buffers, strides, offsets);
+	context.IASetVertexBuffers(15, 2, buffers, strides, offsets);
+	context.IASetVertexBuffers(15, 1, buffers, strides, offsets);
+	context.IASetVertexBuffers(15, 1, buffers, strides, offsets);
+	CHECK(TakeCalls(device).size() == 3);
+
+	ID3D11SamplerState* samplers[2] = { &gSamplers[0], &gSamplers[1] };
+	context.PSSetSamplers(15, 2, samplers);
+	context.PSSetSamplers(15, 2, samplers);
+	CHECK(TakeCalls(device).size() == 2);
+
+	// Untracked calls count as issued
+	context.NewFrame();
+	CHECK(context.GetStats().numIssued == 14 && context.GetStats().numFiltered == 4);
+}
+
+// NewFrame and Invalidate forget what is bound, NewFrame keeps the frame's counts
+void TestInvalidation()
+{
+	ID3D11DeviceContext device;
+	CStateContext context(&device);
+	CHECK(context.GetStats().numIssued == 0 && context.GetStats().numFiltered == 0);
+
+	BindEverything(context);
+	BindEverything(context);
+	BindEverything(context);
+	context.Draw(3, 0);
+	TakeCalls(device);
+	CHECK(context.GetStats().numIssued == 0); // Counts only show once the frame is over
+
+	context.NewFrame();
+	CHECK(context.GetStats().numIssued == NUM_BIND_CALLS && context.GetStats().numFiltered == 2 * NUM_BIND_CALLS);
+	BindEverything(context);
+	CHECK(TakeCalls(device).size() == NUM_BIND_CALLS);
+
+	context.NewFrame();
+	CHECK(context.GetStats().numIssued == NUM_BIND_CALLS && context.GetStats().numFiltered == 0);
+
+	context.Invalidate();
+	BindEverything(context);
+	CHECK(TakeCalls(device).size() == NUM_BIND_CALLS);
+
+	// ClearState is passed on and forgets everything too
+	context.ClearState();
+	BindEverything(context);
+	std::vector<std::string> calls = TakeCalls(device);
+	CHECK(calls.size() == NUM_BIND_CALLS + 1 && calls.front() == "ClearState");
+
+	// An empty frame has nothing to count
+	context.NewFrame();
+	context.NewFrame();
+	CHECK(context.GetStats().numIssued == 0 && context.GetStats().numFiltered == 0);
+}
+}
+
+
+int main()
+{
+	TestFiltering();
+	TestRenderTargets();
+	TestUntrackedSlots();
+	TestInvalidation();
+	return test::TestResult();
+}
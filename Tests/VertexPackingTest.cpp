@@ -0,0 +1,286 @@
+//--------------------------------------------------------------------------------------
+// Vertex packing tests
+//--------------------------------------------------------------------------------------
+// Round trips every packed format in VertexPacking.hpp and checks the error stays within what the format
+// can hold:
+//     - half floats: every half survives half -> float -> half, normal range floats come back within
+//       2^-11 relative error (0.049%), out of range values become infinity and NaN stays NaN
+//     - snorm / unorm: within half a step (plus float rounding), clamped at the ends of the range
+//     - octahedral unit vectors: within 6.5e-5 (2 x snorm16) and 0.0175 (2 x snorm8) of the original vector
+//     - the batch (SSE) versions give exactly the same bits as the single value functions, with strides
+//
+// Build from the repository root, e.g. on Linux:
+//     g++ -std=c++14 -O2 -IMath -I. Tests/VertexPackingTest.cpp Math/*.cpp CVector4.cpp -pthread -o VertexPackingTest
+// or with Visual Studio (x64 Native Tools prompt):
+//     cl /std:c++14 /O2 /EHsc /IMath /I. Tests\VertexPackingTest.cpp Math\*.cpp CVector4.cpp /Fe:VertexPackingTest.exe
+// Exit code is 0 if all checks pass
+
+#include "Check.hpp"
+#include "VertexPacking.hpp"
+#include "MathHelpers.hpp"
+#include "CRandom.hpp"
+#include "SIMD.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+using namespace umbra_engine;
+using namespace umbra_engine::maths;
+
+namespace
+{
+// Error bounds
+const float HALF_MAX_RELATIVE_ERROR = 4.9e-4f;    // 2^-11, half of a 10 bit mantissa step
+const float HALF_MAX_DENORMAL_ERROR = 2.99e-8f;   // 2^-25, half of the denormal step
+const float OCTAHEDRAL16_MAX_ERROR = 6.5e-5f;     // About 0.0037 degrees, the worst found in 10 million vectors is 6.44e-5
+const float OCTAHEDRAL8_MAX_ERROR = 0.0175f;      // About 1 degree
+
+// Half float limits
+const float HALF_MAX = 65504.0f;
+const float HALF_MIN_NORMAL = 6.103515625e-5f; // 2^-14
+
+const size_t NUM_VALUES = 1000000;
+
+CRandom gRandom(1234);
+
+// Instruction sets supported by this CPU, narrowest first
+std::vector<simd::EInstructionSet> SupportedInstructionSets()
+{
+	std::vector<simd::EInstructionSet> sets;
+	for (int i = 0; i <= static_cast<int>(simd::DetectInstructionSet()); ++i)
+	{
+		sets.push_back(static_cast<simd::EInstructionSet>(i));
+	}
+	return sets;
+}
+
+template <typename T>
+bool SameBits(const std::vector<T>& a, const std::vector<T>& b)
+{
+	return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0;
+}
+
+// A random unit vector, with some exactly on the axes, planes and octahedron edges where the folding is decided
+CVector3 RandomUnitVector(size_t i)
+{
+	static const CVector3 special[] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 },
+	                                    { 1, 1, 0 }, { 1, -1, 0 }, { -1, 1, 0 }, { -1, -1, 0 }, { 1, 0, -1 }, { 0, -1, -1 },
+	                                    { 1, 1, 1 }, { -1, -1, -1 }, { 1, -1, -1 }, { -1, 1, -1 } };
+	const size_t numSpecial = sizeof(special) / sizeof(special[0]);
+	if (i < numSpecial) return Normalise(special[i]);
+
+	CVector3 v;
+	do
+	{
+		v = { gRandom.Range(-1.0f, 1.0f), gRandom.Range(-1.0f, 1.0f), gRandom.Range(-1.0f, 1.0f) };
+	} while (Length(v) < 0.01f || Length(v) > 1.0f);
+	return Normalise(v);
+}
+
+// Floats spread over many exponents, both signs, and the values at and around each half float boundary
+std::vector<float> HalfTestValues()
+{
+	std::vector<float> values;
+	for (size_t i = 0; i < NUM_VALUES; ++i)
+	{
+		float magnitude = std::exp2(gRandom.Range(-26.0f, 17.0f));
+		values.push_back(gRandom.Next() % 2 ? magnitude : -magnitude);
+	}
+	for (float f : { 0.0f, HALF_MIN_NORMAL, HALF_MAX, 65519.99f, 65520.0f, 1.0f, 1.0f + 1.0f / 2048.0f, 2049.0f, 2051.0f })
+	{
+		values.push_back(f);
+		values.push_back(-f);
+		values.push_back(std::nextafter(f, 0.0f));
+		values.push_back(std::nextafter(f, 1e10f));
+	}
+	return values;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Tests
+-----------------------------------------------------------------------------------------*/
+
+void TestHalves()
+{
+	// Every half float converts to a float and back unchanged (NaNs stay NaN, though the payload may not)
+	int mismatches = 0;
+	for (uint32_t h = 0; h <= 0xffff; ++h)
+	{
+		float f = HalfToFloat(static_cast<uint16_t>(h));
+		uint16_t back = FloatToHalf(f);
+		if (std::isnan(f)) { if (!std::isnan(HalfToFloat(back))) ++mismatches; }
+		else if (back != h) ++mismatches;
+	}
+	CHECK(mismatches == 0);
+
+	// Floats to halves: relative error for normal halves, absolute error for denormals, infinity beyond the range
+	std::vector<float> values = HalfTestValues();
+	float maxRelativeError = 0.0f, maxDenormalError = 0.0f;
+	int rangeErrors = 0;
+	for (float f : values)
+	{
+		float back = HalfToFloat(FloatToHalf(f));
+		float magnitude = std::abs(f);
+		if (magnitude >= 65520.0f) // Rounds up past HALF_MAX
+		{
+			if (!std::isinf(back) || (back < 0.0f) != (f < 0.0f)) ++rangeErrors;
+		}
+		else if (magnitude >= HALF_MIN_NORMAL)
+		{
+			maxRelativeError = std::max(maxRelativeError, std::abs(back - f) / magnitude);
+		}
+		else
+		{
+			maxDenormalError = std::max(maxDenormalError, std::abs(back - f));
+		}
+	}
+	std::printf("Half max relative error %.3g, denormal max error %.3g\n", maxRelativeError, maxDenormalError);
+	CHECK(maxRelativeError <= HALF_MAX_RELATIVE_ERROR);
+	CHECK(maxDenormalError <= HALF_MAX_DENORMAL_ERROR);
+	CHECK(rangeErrors == 0);
+
+	// Ties round to even
+	CHECK(FloatToHalf(1.0f + 1.0f / 2048.0f) == FloatToHalf(1.0f));
+	CHECK(FloatToHalf(1.0f + 3.0f / 2048.0f) == FloatToHalf(1.0f) + 2);
+
+	const float nan = std::numeric_limits<float>::quiet_NaN();
+	const float infinity = std::numeric_limits<float>::infinity();
+	CHECK(std::isnan(HalfToFloat(FloatToHalf(nan))));
+	CHECK(HalfToFloat(FloatToHalf(infinity)) == infinity && HalfToFloat(FloatToHalf(-infinity)) == -infinity);
+	CHECK(FloatToHalf(-0.0f) == 0x8000);
+
+	// Batch versions give the same bits, including a scalar tail
+	std::vector<uint16_t> reference(values.size());
+	for (size_t i = 0; i < values.size(); ++i) reference[i] = FloatToHalf(values[i]);
+	std::vector<float> referenceBack(values.size());
+	for (size_t i = 0; i < values.size(); ++i) referenceBack[i] = HalfToFloat(reference[i]);
+	for (simd::EInstructionSet set : SupportedInstructionSets())
+	{
+		simd::SetInstructionSet(set);
+		std::vector<uint16_t> halves(values.size());
+		FloatsToHalves(values.data(), halves.data(), values.size());
+		CHECK(SameBits(halves, reference));
+		std::vector<float> back(values.size());
+		HalvesToFloats(halves.data(), back.data(), values.size());
+		CHECK(SameBits(back, referenceBack));
+	}
+	simd::SetInstructionSet(simd::DetectInstructionSet());
+}
+
+// Round trip a normalised integer format: within half a step inside the range, clamped outside it
+template <typename T>
+void TestNormalised(const char* name, T (*pack)(float), float (*unpack)(T), void (*batch)(const float*, T*, size_t),
+                    float low, float steps)
+{
+	std::vector<float> values;
+	for (size_t i = 0; i < NUM_VALUES; ++i) values.push_back(gRandom.Range(low - 0.5f, 1.5f));
+	for (float f : { low, 0.0f, 1.0f, -1.0f, 1.0f / steps, 0.5f / steps, -0.5f / steps }) values.push_back(f);
+
+	float maxError = 0.0f;
+	int clampErrors = 0;
+	for (float f : values)
+	{
+		float back = unpack(pack(f));
+		if      (f < low)  { if (back != low)  ++clampErrors; }
+		else if (f > 1.0f) { if (back != 1.0f) ++clampErrors; }
+		else    maxError = std::max(maxError, std::abs(back - f));
+	}
+	std::printf("%-7s max error %.3g (%.3f steps)\n", name, maxError, maxError * steps);
+	CHECK(maxError <= 0.5f / steps + 1e-7f); // Scaling to the integer range rounds a little too
+	CHECK(clampErrors == 0);
+	CHECK(unpack(pack(low)) == low && unpack(pack(1.0f)) == 1.0f && unpack(pack(0.0f)) == 0.0f);
+
+	std::vector<T> reference(values.size());
+	for (size_t i = 0; i < values.size(); ++i) reference[i] = pack(values[i]);
+	for (simd::EInstructionSet set : SupportedInstructionSets())
+	{
+		simd::SetInstructionSet(set);
+		std::vector<T> packed(values.size());
+		batch(values.data(), packed.data(), values.size());
+		CHECK(SameBits(packed, reference));
+	}
+	simd::SetInstructionSet(simd::DetectInstructionSet());
+}
+
+void TestNormalisedIntegers()
+{
+	TestNormalised<int16_t>("snorm16", FloatToSnorm16, Snorm16ToFloat, FloatsToSnorm16, -1.0f, 32767.0f);
+	TestNormalised<int8_t>("snorm8", FloatToSnorm8, Snorm8ToFloat, FloatsToSnorm8, -1.0f, 127.0f);
+	TestNormalised<uint16_t>("unorm16", FloatToUnorm16, Unorm16ToFloat, FloatsToUnorm16, 0.0f, 65535.0f);
+	TestNormalised<uint8_t>("unorm8", FloatToUnorm8, Unorm8ToFloat, FloatsToUnorm8, 0.0f, 255.0f);
+
+	// The most negative value is -1, as on the GPU
+	CHECK(Snorm16ToFloat(-32768) == -1.0f && Snorm8ToFloat(-128) == -1.0f);
+}
+
+void TestOctahedral()
+{
+	std::vector<CVector3> vectors;
+	for (size_t i = 0; i < NUM_VALUES; ++i) vectors.push_back(RandomUnitVector(i));
+
+	float maxError16 = 0.0f, maxError8 = 0.0f, maxLengthError = 0.0f, maxEncodeError = 0.0f;
+	for (const auto& v : vectors)
+	{
+		CVector3 back16 = UnpackOctahedral16(PackOctahedral16(v));
+		CVector3 back8 = UnpackOctahedral8(PackOctahedral8(v));
+		maxError16 = std::max(maxError16, Length(back16 - v));
+		maxError8 = std::max(maxError8, Length(back8 - v));
+		maxLengthError = std::max(maxLengthError, std::abs(Length(back16) - 1.0f));
+
+		// Unquantised, the encoding is exact up to rounding and stays inside the square
+		CVector2 e = OctahedralEncode(v);
+		maxEncodeError = std::max(maxEncodeError, Length(OctahedralDecode(e) - v));
+		if (std::abs(e.x) > 1.0f || std::abs(e.y) > 1.0f) maxEncodeError = 1.0f;
+	}
+	std::printf("Octahedral max error: unquantised %.3g, 16 bit %.3g, 8 bit %.3g (%.2f degrees)\n",
+	            maxEncodeError, maxError16, maxError8, 2.0f * std::asin(maxError8 * 0.5f) * 180.0f / PI);
+	CHECK(maxEncodeError < 1e-6f);
+	CHECK(maxError16 <= OCTAHEDRAL16_MAX_ERROR);
+	CHECK(maxError8 <= OCTAHEDRAL8_MAX_ERROR);
+	CHECK(maxLengthError < 1e-6f);
+
+	// Batch versions, reading normals from inside a vertex structure and writing into another
+	struct SVertex    { CVector3 position; CVector3 normal; float uv[2]; };
+	struct SPacked    { float position[3]; uint32_t normal16; uint16_t normal8; uint16_t pad; };
+	std::vector<SVertex> vertices(vectors.size() + 3); // Odd count leaves a scalar tail
+	for (size_t i = 0; i < vertices.size(); ++i) vertices[i].normal = vectors[i % vectors.size()];
+	std::vector<uint32_t> reference16(vertices.size());
+	std::vector<uint16_t> reference8(vertices.size());
+	for (size_t i = 0; i < vertices.size(); ++i)
+	{
+		reference16[i] = PackOctahedral16(vertices[i].normal);
+		reference8[i] = PackOctahedral8(vertices[i].normal);
+	}
+	for (simd::EInstructionSet set : SupportedInstructionSets())
+	{
+		simd::SetInstructionSet(set);
+		std::vector<SPacked> packed(vertices.size());
+		PackOctahedral16(&vertices[0].normal, sizeof(SVertex), &packed[0].normal16, sizeof(SPacked), vertices.size());
+		PackOctahedral8(&vertices[0].normal, sizeof(SVertex), &packed[0].normal8, sizeof(SPacked), vertices.size());
+		int mismatches = 0;
+		for (size_t i = 0; i < packed.size(); ++i)
+		{
+			if (packed[i].normal16 != reference16[i] || packed[i].normal8 != reference8[i]) ++mismatches;
+		}
+		CHECK(mismatches == 0);
+
+		std::vector<uint32_t> tight16(vectors.size());
+		PackOctahedral16(vectors.data(), tight16.data(), vectors.size());
+		CHECK(std::equal(tight16.begin(), tight16.end(), reference16.begin()));
+	}
+	simd::SetInstructionSet(simd::DetectInstructionSet());
+}
+}
+
+
+int main()
+{
+	TestHalves();
+	TestNormalisedIntegers();
+	TestOctahedral();
+	return test::TestResult();
+}
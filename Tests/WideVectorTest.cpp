@@ -0,0 +1,246 @@
+//--------------------------------------------------------------------------------------
+// Wide float and vector tests
+//--------------------------------------------------------------------------------------
+// Checks CFloat4 / CFloat8 (WideFloat.hpp) and CVector3x4 / CVector3x8 (CVector3Wide.hpp) lane by lane against
+// the scalar calculation, which they promise to match exactly:
+//     - arithmetic, Sqrt, Abs, Min and Max give bit-identical results in each lane
+//     - comparisons give all-bits masks that BitMask, Any, All and Select read correctly, including for NaNs
+//     - LoadAoS / StoreAoS round trip for packed and strided arrays without touching the memory around them,
+//       as do LoadSoA / StoreSoA
+//     - the vector operators, Dot, Cross, Length, Normalise (including zero vectors), Min, Max and Select give
+//       in each lane exactly what the CVector3 functions give for that vector
+// Build a second time with -mavx (or /arch:AVX) to check the AVX version of CFloat8 as well as the CFloat4 pair
+//
+// Build from the repository root, e.g. on Linux:
+//     g++ -std=c++14 -O2 -IMath -I. Tests/WideVectorTest.cpp Math/*.cpp CVector4.cpp -pthread -o WideVectorTest
+// or with Visual Studio (x64 Native Tools prompt):
+//     cl /std:c++14 /O2 /EHsc /IMath /I. Tests\WideVectorTest.cpp Math\*.cpp CVector4.cpp /Fe:WideVectorTest.exe
+// Exit code is 0 if all checks pass
+
+#include "Check.hpp"
+#include "CVector3Wide.hpp"
+#include "WideFloat.hpp"
+#include "CRandom.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+using namespace umbra_engine;
+using namespace umbra_engine::maths;
+
+namespace
+{
+const int NUM_ROUNDS = 1000;
+
+CRandom gRandom(11);
+
+bool BitIdentical(float a, float b)
+{
+	return std::memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+bool BitIdentical(const CVector3& a, const CVector3& b)
+{
+	return BitIdentical(a.x, b.x) && BitIdentical(a.y, b.y) && BitIdentical(a.z, b.z);
+}
+
+// A lane of a mask must have every bit set or every bit clear
+bool IsMaskLane(float lane, bool expected)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &lane, sizeof(bits));
+	return bits == (expected ? 0xffffffffu : 0u);
+}
+
+CVector3 RandomVector(float range)
+{
+	return { gRandom.Range(-range, range), gRandom.Range(-range, range), gRandom.Range(-range, range) };
+}
+
+// Values with a few equal pairs and zeros mixed in, so comparisons and Normalise see their edge cases
+float RandomValue()
+{
+	int kind = static_cast<int>(gRandom.Next() % 8);
+	if (kind == 0) return 0.0f;
+	if (kind == 1) return 1.0f;
+	return gRandom.Range(-100.0f, 100.0f);
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Tests
+-----------------------------------------------------------------------------------------*/
+
+template <typename TFloat>
+void TestWideFloat()
+{
+	const int W = TFloat::WIDTH;
+	int arithmetic = 0, masks = 0;
+	for (int round = 0; round < NUM_ROUNDS; ++round)
+	{
+		float a[W], b[W], out[W];
+		for (int i = 0; i < W; ++i)
+		{
+			a[i] = RandomValue();
+			b[i] = RandomValue();
+		}
+		b[round % W] = 1.0f; // Not every lane of b is 0
+		TFloat wa = TFloat::Load(a), wb = TFloat::Load(b);
+
+		(wa + wb).Store(out);
+		for (int i = 0; i < W; ++i) if (!BitIdentical(out[i], a[i] + b[i])) ++arithmetic;
+		(wa - wb).Store(out);
+		for (int i = 0; i < W; ++i) if (!BitIdentical(out[i], a[i] - b[i])) ++arithmetic;
+		(wa * wb).Store(out);
+		for (int i = 0; i < W; ++i) if (!BitIdentical(out[i], a[i] * b[i])) ++arithmetic;
+		(wa / wb).Store(out);
+		for (int i = 0; i < W; ++i) if (b[i] != 0.0f && !BitIdentical(out[i], a[i] / b[i])) ++arithmetic;
+		for (int i = 0; i < W; ++i)
+		{
+			if (!BitIdentical((-wa)[i], -a[i]) || !BitIdentical(Abs(wa)[i], std::abs(a[i]))) ++arithmetic;
+			if (!BitIdentical(Sqrt(Abs(wa))[i], std::sqrt(std::abs(a[i])))) ++arithmetic;
+			if (Min(wa, wb)[i] != std::min(a[i], b[i]) || Max(wa, wb)[i] != std::max(a[i], b[i])) ++arithmetic;
+			if (TFloat(a[0])[i] != a[0]) ++arithmetic;
+		}
+
+		// Masks
+		TFloat less = wa < wb, lessEqual = wa <= wb, greater = wa > wb, greaterEqual = wa >= wb, equal = wa == wb, notEqual = wa != wb;
+		int expectedBits = 0;
+		for (int i = 0; i < W; ++i)
+		{
+			if (!IsMaskLane(less[i], a[i] < b[i]) || !IsMaskLane(lessEqual[i], a[i] <= b[i]) || !IsMaskLane(greater[i], a[i] > b[i]) ||
+			    !IsMaskLane(greaterEqual[i], a[i] >= b[i]) || !IsMaskLane(equal[i], a[i] == b[i]) || !IsMaskLane(notEqual[i], a[i] != b[i])) ++masks;
+			if (!IsMaskLane((less | equal)[i], a[i] <= b[i]) || !IsMaskLane((lessEqual & greaterEqual)[i], a[i] == b[i])) ++masks;
+			if (Select(less, wa, wb)[i] != (a[i] < b[i] ? a[i] : b[i])) ++masks;
+			expectedBits |= (a[i] < b[i] ? 1 : 0) << i;
+		}
+		if (BitMask(less) != expectedBits || Any(less) != (expectedBits != 0) || All(less) != (expectedBits == (1 << W) - 1)) ++masks;
+	}
+	CHECK(arithmetic == 0);
+	CHECK(masks == 0);
+
+	// NaN lanes compare false, except !=
+	const float nan = std::numeric_limits<float>::quiet_NaN();
+	TFloat n(nan), one(1.0f);
+	CHECK(!Any(n < one) && !Any(n <= one) && !Any(n > one) && !Any(n >= one) && !Any(n == n) && All(n != n));
+	CHECK(All(one == one) && !Any(one != one) && BitMask(one == one) == (1 << TFloat::WIDTH) - 1);
+}
+
+template <typename TFloat>
+void TestLoadStore()
+{
+	using TVector = CVector3Wide<TFloat>;
+	const int W = TVector::WIDTH;
+
+	// Vectors in the middle of a structure, with guard values around the ones used
+	struct SParticle { float life; CVector3 position; float size; };
+	const CVector3 guard = { -1.0f, -2.0f, -3.0f };
+	int problems = 0;
+	for (int round = 0; round < NUM_ROUNDS / 10; ++round)
+	{
+		std::vector<CVector3> packed(W + 2, guard);
+		std::vector<SParticle> strided(W + 2, SParticle{ 5.0f, guard, 6.0f });
+		for (int i = 1; i <= W; ++i)
+		{
+			packed[i] = RandomVector(100.0f);
+			strided[i].position = packed[i];
+		}
+
+		TVector fromPacked = TVector::LoadAoS(&packed[1]);
+		TVector fromStrided = TVector::LoadAoS(&strided[1].position, sizeof(SParticle));
+		for (int i = 0; i < W; ++i)
+		{
+			if (!BitIdentical(fromPacked.Get(i), packed[i + 1]) || !BitIdentical(fromStrided.Get(i), packed[i + 1])) ++problems;
+		}
+
+		// Store the vectors in reverse order, then check nothing else was written
+		std::vector<CVector3> reversedIn(packed.rbegin() + 1, packed.rend() - 1);
+		TVector reversed = TVector::LoadAoS(reversedIn.data());
+		std::vector<CVector3> packedOut(W + 2, guard);
+		std::vector<SParticle> stridedOut(W + 2, SParticle{ 5.0f, guard, 6.0f });
+		reversed.StoreAoS(&packedOut[1]);
+		reversed.StoreAoS(&stridedOut[1].position, sizeof(SParticle));
+		for (int i = 1; i <= W; ++i)
+		{
+			if (!BitIdentical(packedOut[i], packed[W + 1 - i]) || !BitIdentical(stridedOut[i].position, packed[W + 1 - i])) ++problems;
+			if (stridedOut[i].life != 5.0f || stridedOut[i].size != 6.0f) ++problems;
+		}
+		if (!BitIdentical(packedOut[0], guard) || !BitIdentical(packedOut[W + 1], guard)) ++problems;
+		if (!BitIdentical(stridedOut[0].position, guard) || !BitIdentical(stridedOut[W + 1].position, guard)) ++problems;
+
+		// Separate arrays
+		float x[W], y[W], z[W];
+		fromPacked.StoreSoA(x, y, z);
+		TVector fromSoA = TVector::LoadSoA(x, y, z);
+		for (int i = 0; i < W; ++i)
+		{
+			if (!BitIdentical(CVector3{ x[i], y[i], z[i] }, packed[i + 1]) || !BitIdentical(fromSoA.Get(i), packed[i + 1])) ++problems;
+		}
+	}
+	CHECK(problems == 0);
+}
+
+template <typename TFloat>
+void TestWideVector()
+{
+	using TVector = CVector3Wide<TFloat>;
+	const int W = TVector::WIDTH;
+	int problems = 0, zeroLanes = 0;
+	for (int round = 0; round < NUM_ROUNDS; ++round)
+	{
+		CVector3 a[W], b[W];
+		float s[W];
+		for (int i = 0; i < W; ++i)
+		{
+			a[i] = RandomVector(100.0f);
+			b[i] = RandomVector(100.0f);
+			s[i] = gRandom.Range(0.5f, 2.0f);
+		}
+		a[round % W] = round % 3 == 0 ? CVector3{ 0.0f, 0.0f, 0.0f } : a[round % W]; // Zero vectors for Normalise
+		a[(round + 1) % W] = round % 5 == 0 ? CVector3{ 1e-4f, 0.0f, 0.0f } : a[(round + 1) % W]; // Below the zero epsilon when squared
+
+		TVector va = TVector::LoadAoS(a), vb = TVector::LoadAoS(b);
+		TFloat ws = TFloat::Load(s);
+		TVector sum = va + vb, difference = va - vb, negated = -va, scaled = va * ws, scaledFloat = 2.0f * va, divided = va / ws;
+		TVector cross = Cross(va, vb), normalised = Normalise(va), minimum = Min(va, vb), maximum = Max(va, vb);
+		TVector accumulated = va;
+		accumulated += vb;
+		accumulated -= va;
+		accumulated *= ws;
+		TFloat dot = Dot(va, vb), length = Length(va);
+		TFloat closer = Dot(va, va) < Dot(vb, vb);
+		TVector shorter = Select(closer, va, vb);
+
+		for (int i = 0; i < W; ++i)
+		{
+			if (!BitIdentical(sum.Get(i), a[i] + b[i]) || !BitIdentical(difference.Get(i), a[i] - b[i])) ++problems;
+			if (!BitIdentical(negated.Get(i), a[i] * -1.0f) || !BitIdentical(scaled.Get(i), a[i] * s[i]) || !BitIdentical(scaledFloat.Get(i), a[i] * 2.0f)) ++problems;
+			if (!BitIdentical(divided.Get(i), CVector3{ a[i].x / s[i], a[i].y / s[i], a[i].z / s[i] })) ++problems;
+			if (!BitIdentical(accumulated.Get(i), (a[i] + b[i] - a[i]) * s[i])) ++problems;
+			if (!BitIdentical(dot[i], Dot(a[i], b[i])) || !BitIdentical(length[i], Length(a[i]))) ++problems;
+			if (!BitIdentical(cross.Get(i), Cross(a[i], b[i])) || !BitIdentical(normalised.Get(i), Normalise(a[i]))) ++problems;
+			if (minimum.Get(i).x != std::min(a[i].x, b[i].x) || maximum.Get(i).z != std::max(a[i].z, b[i].z)) ++problems;
+			if (!BitIdentical(shorter.Get(i), Dot(a[i], a[i]) < Dot(b[i], b[i]) ? a[i] : b[i])) ++problems;
+			if (!BitIdentical(TVector(a[0]).Get(i), a[0])) ++problems;
+			if (normalised.Get(i).x == 0.0f && normalised.Get(i).y == 0.0f && normalised.Get(i).z == 0.0f) ++zeroLanes;
+		}
+	}
+	CHECK(problems == 0);
+	CHECK(zeroLanes > 0);
+}
+}
+
+
+int main()
+{
+	TestWideFloat<CFloat4>();
+	TestWideFloat<CFloat8>();
+	TestLoadStore<CFloat4>();
+	TestLoadStore<CFloat8>();
+	TestWideVector<CFloat4>();
+	TestWideVector<CFloat8>();
+	return test::TestResult();
+}
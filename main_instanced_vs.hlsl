@@ -0,0 +1,37 @@
+//--------------------------------------------------------------------------------------
+// Instanced version of main_vs - many models sharing a mesh in one draw call
+//--------------------------------------------------------------------------------------
+
+#include "Common.hlsli"
+
+
+//--------------------------------------------------------------------------------------
+// Shader code
+//--------------------------------------------------------------------------------------
+
+// Same as main_vs but the world matrix comes from the instance data rather than gWorldMatrix, which C++ sets to the
+// identity matrix for instanced draws
+NormalMappingPixelShaderInput main(InstancedTangentVertex modelVertex)
+{
+    NormalMappingPixelShaderInput output;
+
+    // The instance data holds the rows of the C++ matrix, so the vector goes on the left. Constant buffer matrices
+    // arrive transposed, which is why the other shaders multiply the other way round
+    float4x4 worldMatrix = float4x4(modelVertex.world0, modelVertex.world1, modelVertex.world2, modelVertex.world3);
+
+    float4 modelPosition = float4(modelVertex.position, 1.0f);
+    float4 worldPosition = mul(modelPosition, worldMatrix);
+    float4 viewPosition = mul(gViewMatrix, worldPosition);
+    output.projectedPosition = mul(gProjectionMatrix, viewPosition);
+
+    output.worldPosition = worldPosition.xyz;
+
+    // The pixel shader moves normals from model space to world space with gWorldMatrix. That is the identity here, so
+    // send them already in world space
+    output.modelNormal = mul(float4(modelVertex.normal, 0.0f), worldMatrix).xyz;
+    output.modelTangent = mul(float4(modelVertex.tangent, 0.0f), worldMatrix).xyz;
+
+    output.uv = modelVertex.uv;
+
+    return output;
+}
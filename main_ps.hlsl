@@ -13,23 +13,36 @@
 //****| INFO | Normal map, now contains per pixel heights in the alpha channel ****//
 Texture2D DiffuseSpecularMap : register(t0); // Diffuse map (main colour) in rgb and specular map (shininess level) in alpha - C++ must load this into slot 0
 Texture2D NormalHeightMap : register(t1); // Normal map in rgb and height maps in alpha - C++ must load this into slot 1
-Texture2D ShadowMapLight1 : register(t2); // Texture holding the view of the scene from a light
+Texture2D ShadowAtlas : register(t2); // Shadow maps of the spot lights, each in its own tile (see lightShadowTiles and ShadowAtlas.hpp)
 
 Texture2D DiffuseSpecularMap2 : register(t3);
 Texture2D HeightMap2 : register(t4);
 
 Texture2D ShadowMapLight2 : register(t5); // Texture holding the view of the scene from a light
 
+Texture2DArray CascadeShadowMap : register(t6); // Cascaded shadow maps of the directional light, a slice per cascade
+
+TextureCube PointShadowMaps[4] : register(t7); // Cube shadow maps of point lights, slots t7 to t10 (see pointShadowLights)
+
 SamplerState TexSampler : register(s0); // A sampler is a filter for a texture like bilinear, trilinear or anisotropic
 SamplerState PointClamp : register(s1); // No filtering for shadow maps (you might think you could use trilinear or similar, but it will filter light depths not the shadows cast...)
 
 
 static int shadowLightIndex = 0;
 
-float PCF(int sampleSize, float lightDepth, float2 shadowUVCoords)
+// Convert a 0->1 UV in a light's shadow map to the shadow atlas, staying inside the light's tile so samples never
+// read a neighbouring light's shadow map. Tile is the light's entry in lightShadowTiles
+float2 AtlasUV(float2 shadowUVCoords, float4 tile, float texelSize)
+{
+    return clamp(tile.xy + shadowUVCoords * tile.zw, tile.xy, tile.xy + tile.zw - texelSize);
+}
+
+float PCF(int sampleSize, float lightDepth, float2 shadowUVCoords, float4 tile)
 {
     float shadow = 0.0f;
-    float offSet = 1.0f / 1024; //How much each sample will diverage from map
+    float atlasWidth, atlasHeight;
+    ShadowAtlas.GetDimensions(atlasWidth, atlasHeight);
+    float offSet = 1.0f / atlasWidth; //How much each sample will diverage from map, one texel
         
     [unroll]
     for (int x = 0; x < sampleSize; ++x)
@@ -39,7 +52,7 @@ float PCF(int sampleSize, float lightDepth, float2 shadowUVCoords)
         {
             float pcfDepth = 0.0f;
 
-            pcfDepth += ShadowMapLight1.Sample(PointClamp, shadowUVCoords + float2(x * offSet, y * offSet)).r;
+            pcfDepth += ShadowAtlas.Sample(PointClamp, AtlasUV(shadowUVCoords + float2(x * offSet, y * offSet) / tile.zw, tile, offSet)).r;
 
             if (lightDepth < pcfDepth)//Checks the light depth against the sample calculated from an offest from shadow map
             {
@@ -52,10 +65,12 @@ float PCF(int sampleSize, float lightDepth, float2 shadowUVCoords)
     return shadow;
 }
 
-float ZBuffer(float lightDepth, float2 shadowUVCoords)
+float ZBuffer(float lightDepth, float2 shadowUVCoords, float4 tile)
 {
+    float atlasWidth, atlasHeight;
+    ShadowAtlas.GetDimensions(atlasWidth, atlasHeight);
     float shadowMapDepthValue = 0.0f;
-    shadowMapDepthValue += ShadowMapLight1.Sample(PointClamp, shadowUVCoords).r;    
+    shadowMapDepthValue += ShadowAtlas.Sample(PointClamp, AtlasUV(shadowUVCoords, tile, 1.0f / atlasWidth)).r;
     
     if (lightDepth > shadowMapDepthValue)
     {
@@ -64,6 +79,72 @@ float ZBuffer(float lightDepth, float2 shadowUVCoords)
     return shadowMapDepthValue;
 }
 
+// Shadow from the directional light's cascades, 1 = lit. Uses the first cascade whose map covers the pixel, keeping
+// clear of the edges for the PCF samples. Same selection as maths::SelectCascade
+float CascadeShadow(float3 worldPosition)
+{
+    const float Border = 8.0f / 1024; // 4 texels in clip space units
+    const float DepthAdjust = 0.0005f; // Cascades are orthographic, so depth is linear and needs a larger adjustment
+    for (int c = 0; c < numCascades; ++c)
+    {
+        // Orthographic, so no perspective divide
+        float4 lightProjection = mul(cascadeViewProj[c], float4(worldPosition, 1));
+        if (all(abs(lightProjection.xy) <= 1.0f - Border) && lightProjection.z >= 0.0f && lightProjection.z <= 1.0f)
+        {
+            float2 shadowMapUV = 0.5f * lightProjection.xy + float2(0.5f, 0.5f);
+            shadowMapUV.y = 1.0f - shadowMapUV.y;
+            float depthFromLight = lightProjection.z - DepthAdjust;
+
+            if (shadowEffect != 0)
+            {
+                return depthFromLight < CascadeShadowMap.Sample(PointClamp, float3(shadowMapUV, c)).r ? 1.0f : 0.0f;
+            }
+
+            // PCF as above
+            float shadow = 0.0f;
+            float offSet = 1.0f / 1024;
+            [unroll]
+            for (int x = 0; x < 4; ++x)
+            {
+                [unroll]
+                for (int y = 0; y < 4; ++y)
+                {
+                    float pcfDepth = CascadeShadowMap.Sample(PointClamp, float3(shadowMapUV + float2(x * offSet, y * offSet), c)).r;
+                    if (depthFromLight < pcfDepth)
+                    {
+                        shadow += 1.0f;
+                    }
+                }
+            }
+            return shadow / 16;
+        }
+    }
+    return 1.0f; // Beyond the cascades
+}
+
+// Shadow from a point light's cube shadow map, 1 = lit. Lights without a cube shadow map slot are unshadowed.
+// The depth in the cube map comes from the face the pixel is in, whose axis is the largest component of the
+// direction from the light
+float PointShadow(int lightIndex, float3 worldPosition)
+{
+    const float DepthAdjust = 0.00009f;
+    [unroll]
+    for (int s = 0; s < 4; ++s) // Textures can only be indexed by constants, so check each slot
+    {
+        if (pointShadowLights[s] == lightIndex)
+        {
+            float3 lightToPixel = worldPosition - lightPositions[lightIndex].xyz;
+            float3 axisDistances = abs(lightToPixel);
+            float faceDistance = max(axisDistances.x, max(axisDistances.y, axisDistances.z));
+            float depthFromLight = pointShadowDepth.x + pointShadowDepth.y / faceDistance - DepthAdjust;
+
+            // Single sample with no mip-maps, so no gradients are needed inside this branch
+            return depthFromLight < PointShadowMaps[s].SampleLevel(PointClamp, lightToPixel, 0).r ? 1.0f : 0.0f;
+        }
+    }
+    return 1.0f;
+}
+
 float4 main(NormalMappingPixelShaderInput input) : SV_Target0
 {
     const float PI = 3.14159265f;
@@ -173,7 +254,8 @@ float4 main(NormalMappingPixelShaderInput input) : SV_Target0
             float3 light1Vector = lightPositions[i].xyz - input.worldPosition;
             float light1Distance = length(light1Vector);
             float3 light1Direction = light1Vector / light1Distance; // Quicker than normalising as we have length for attenuation
-            diffuseLight = lightColours[i].xyz * max(dot(worldNormal, light1Direction), 0) / light1Distance;
+            float shadow = PointShadow(i, input.worldPosition);
+            diffuseLight = lightColours[i].xyz * max(dot(worldNormal, light1Direction), 0) * shadow / light1Distance;
 
             halfway = normalize(light1Direction + cameraDirection);
             specularLight = diffuseLight * pow(max(dot(worldNormal, halfway), 0), gSpecularPower);
@@ -197,6 +279,8 @@ float4 main(NormalMappingPixelShaderInput input) : SV_Target0
             // Check if pixel is within light cone
             if (dot(lightFacings[i].xyz, -light2Direction) > cos(lightFacings[i].w))
             {
+                float4 shadowTile = lightShadowTiles[i];
+
                 // Using the world position of the current pixel and the matrices of the light (as a camera), find the 2D position of the
 	            // pixel *as seen from the light*. Will use this to find which part of the shadow map to look at.
 	            // These are the same as the view / projection matrix multiplies in a vertex shader (can improve performance by putting these lines in vertex shader)
@@ -213,13 +297,17 @@ float4 main(NormalMappingPixelShaderInput input) : SV_Target0
 		
                 //User chooses shadow effect based on shadowEffect integer.  Would've been nice to use enums here but they're not supported by HLSL
                 float shadow = 0.0f;
-                if (shadowEffect == 0)
+                if (shadowTile.z == 0.0f)
+                {
+                    shadow = 1.0f; // No shadow map this frame (no casters, or no room in the shadow atlas)
+                }
+                else if (shadowEffect == 0)
                 {
-                    shadow = PCF(4, depthFromLight, shadowMapUV);
+                    shadow = PCF(4, depthFromLight, shadowMapUV, shadowTile);
                 }
                 else if (shadowEffect == 1)
                 {
-                    shadow = ZBuffer(depthFromLight, shadowMapUV);
+                    shadow = ZBuffer(depthFromLight, shadowMapUV, shadowTile);
                 }
     
         
@@ -234,52 +322,13 @@ float4 main(NormalMappingPixelShaderInput input) : SV_Target0
         //Directional light = 2
         if (int(lightColours[i].w) == 2)
         {
-            
-            float3 light2Vector = lightPositions[i].xyz - input.worldPosition;
-            float light2Distance = length(light2Vector);
-            float3 light2Direction = light2Vector / light2Distance;
+            // Shines along the light's facing from far away, so no position or fall off with distance
+            float3 lightDirection = -lightFacings[i].xyz;
+            float shadow = (i == cascadeLightIndex) ? CascadeShadow(input.worldPosition) : 1.0f;
 
-            diffuseLight = 0.0f; //   lightColours[0] * max(dot(worldNormal, light2Direction), 0) / light2Distance;
-
-            //halfway = normalize(light2Direction + cameraDirection);
-            specularLight = 0.0f; // = diffuseLight2 * pow(max(dot(worldNormal, halfway), 0), gSpecularPower);
-
-            const float DepthAdjust = 0.000009f;
-            // Check if pixel is within light cone
-            if (dot(lightFacings[i].xyz, -light2Direction) > cos(lightFacings[i].w))
-            {
-                
-                // Using the world position of the current pixel and the matrices of the light (as a camera), find the 2D position of the
-	            // pixel *as seen from the light*. Will use this to find which part of the shadow map to look at.
-	            // These are the same as the view / projection matrix multiplies in a vertex shader (can improve performance by putting these lines in vertex shader)
-                float4 light1ViewPosition = mul(lightViewMatrix[i], float4(input.worldPosition, 1));
-                float4 light1Projection = mul(lightProjectionMatrix[i], light1ViewPosition);
-
-		        // Convert 2D pixel position as viewed from light into texture coordinates for shadow map - an advanced topic related to the projection step
-		        // Detail: 2D position x & y get perspective divide, then converted from range -1->1 to UV range 0->1. Also flip V axis
-                float2 shadowMapUV = 0.5f * light1Projection.xy / light1Projection.w + float2(0.5f, 0.5f);
-                shadowMapUV.y = 1.0f - shadowMapUV.y; // Check if pixel is within light cone
-
-		        // Get depth of this pixel if it were visible from the light (another advanced projection step)
-                float depthFromLight = light1Projection.z / light1Projection.w - DepthAdjust; //*** Adjustment so polygons don't shadow themselves
-		
-                //User chooses shadow effect based on shadowEffect integer.  Would've been nice to use enums here but they're not supported by HLSL
-                float shadow = 0.0f;
-                if (shadowEffect == 0)
-                {
-                   shadow = PCF(4, depthFromLight, shadowMapUV);
-                }
-                else if (shadowEffect == 1)
-                {         
-                   shadow = ZBuffer(depthFromLight, shadowMapUV);
-                }
-        
-                float3 light1Dist = length(lightPositions[i].xyz - input.worldPosition);
-                diffuseLight = ((lightColours[i].xyz * max(dot(worldNormal, light2Direction), 0)) * shadow); // Equations from lighting lecture
-                halfway = normalize(light2Direction + cameraDirection);
-                specularLight = diffuseLight * pow(max(dot(worldNormal, halfway), 0), gSpecularPower); // Multiplying by diffuseLight instead of light colour - my own personal preference
-                //++shadowLightIndex;
-            }
+            diffuseLight = lightColours[i].xyz * max(dot(worldNormal, lightDirection), 0) * shadow;
+            halfway = normalize(lightDirection + cameraDirection);
+            specularLight = diffuseLight * pow(max(dot(worldNormal, halfway), 0), gSpecularPower);
         }
         totalDiffuseLight += diffuseLight;
         totalSpecularLight += specularLight;